@@ -411,6 +411,7 @@ _PUBLIC_ NTSTATUS emsmdb_transaction(struct emsmdb_context *emsmdb_ctx,
 	uint16_t		*length;
 	NTSTATUS		status;
 	struct EcDoRpc_MAPI_REQ	*multi_req;
+	uint32_t		count;
 	uint8_t			i = 0;
 
 start:
@@ -424,18 +425,20 @@ start:
 	talloc_set_destructor((void *)mapi_response, (int (*)(void *))mapi_response_destructor);
 	r.out.mapi_response = mapi_response;
 
-	/* process cached data */
+	/* process cached data, requests may hold more than one ROP
+	   when built by a batch */
+	count = talloc_array_length(req->mapi_req);
 	if (emsmdb_ctx->cache_count) {
-		multi_req = talloc_array(mem_ctx, struct EcDoRpc_MAPI_REQ, emsmdb_ctx->cache_count + 2);
+		multi_req = talloc_array(mem_ctx, struct EcDoRpc_MAPI_REQ, emsmdb_ctx->cache_count + count + 1);
 		for (i = 0; i < emsmdb_ctx->cache_count; i++) {
 			multi_req[i] = *emsmdb_ctx->cache_requests[i];
 		}
-		multi_req[i] = req->mapi_req[0];
+		memcpy(&multi_req[i], req->mapi_req, count * sizeof (struct EcDoRpc_MAPI_REQ));
 		req->mapi_req = multi_req;
 	}
 
-	req->mapi_req = talloc_realloc(mem_ctx, req->mapi_req, struct EcDoRpc_MAPI_REQ, emsmdb_ctx->cache_count + 2);
-	req->mapi_req[i+1].opnum = 0;
+	req->mapi_req = talloc_realloc(mem_ctx, req->mapi_req, struct EcDoRpc_MAPI_REQ, emsmdb_ctx->cache_count + count + 1);
+	req->mapi_req[emsmdb_ctx->cache_count + count].opnum = 0;
 
 	r.in.mapi_request = req;
 	r.in.mapi_request->mapi_len += emsmdb_ctx->cache_size;
@@ -513,48 +516,29 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
 	ndr_push_mapi_request(ndr_uncomp_rgbIn, NDR_SCALARS|NDR_BUFFERS, req);
 
 	/* Step 2. Compress the blob */
-	/* 	ndr_comp_rgbIn = ndr_push_init_ctx(mem_ctx); */
-	/* 	ndr_push_lzxpress_compress(ndr_comp_rgbIn, ndr_uncomp_rgbIn); */
+	ndr_comp_rgbIn = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr_comp_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
+	ndr_err = ndr_push_lzxpress_compress(ndr_comp_rgbIn, ndr_uncomp_rgbIn);
 
-	/* If the compressed blob is larger than the uncompressed one, use obfuscation */
-	/* 	if (ndr_comp_rgbIn->offset > ndr_uncomp_rgbIn->offset) { */
-	/* 		talloc_free(ndr_comp_rgbIn); */
-	ndr_comp_rgbIn = ndr_uncomp_rgbIn;
-	obfuscate_data(ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset, 0xA5);
-		
 	RPC_HEADER_EXT.Version = 0x0000;
-	RPC_HEADER_EXT.Flags = RHEF_XorMagic|RHEF_Last;
+	if (ndr_err == NDR_ERR_SUCCESS && ndr_comp_rgbIn->offset < ndr_uncomp_rgbIn->offset) {
+		RPC_HEADER_EXT.Flags = RHEF_Compressed|RHEF_XorMagic|RHEF_Last;
+	} else {
+		/* If the compressed blob is larger than the uncompressed one, only use obfuscation */
+		talloc_free(ndr_comp_rgbIn);
+		ndr_comp_rgbIn = ndr_uncomp_rgbIn;
+		RPC_HEADER_EXT.Flags = RHEF_XorMagic|RHEF_Last;
+	}
+	obfuscate_data(ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset, 0xA5);
+
 	RPC_HEADER_EXT.Size = ndr_comp_rgbIn->offset;
-	RPC_HEADER_EXT.SizeActual = ndr_comp_rgbIn->offset;
+	RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset;
 
+	/* Step 3. Push the complete rgbIn */
 	ndr_rgbIn = ndr_push_init_ctx(mem_ctx);
 	ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
 	ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
 	ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset);
-		/* 	} else { */
-		/* 		RPC_HEADER_EXT.Version = 0x0000; */
-		/* 		RPC_HEADER_EXT.Flags = RHEF_Compressed|RHEF_Last; */
-		/* 		RPC_HEADER_EXT.Size = ndr_comp_rgbIn->offset; */
-		/* 		RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset; */
-
-		/* 		ndr_rgbIn = ndr_push_init_ctx(mem_ctx); */
-		/* 		ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN); */
-		/* 		ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT); */
-		/* 		ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset); */
-		/* 	} */
-
-		/* Plain request (no obfuscation or compression) */
-		/* ndr_comp_rgbIn = ndr_uncomp_rgbIn; */
-		/* RPC_HEADER_EXT.Version = 0x0000; */
-		/* RPC_HEADER_EXT.Flags = RHEF_Last; */
-		/* RPC_HEADER_EXT.Size = ndr_uncomp_rgbIn->offset; */
-		/* RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset; */
-
-		/* Pull the complete rgbIn */
-		/* ndr_rgbIn = ndr_push_init_ctx(mem_ctx); */
-		/* ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN); */
-		/* ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT); */
-		/* ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset); */
 
 	r.in.rgbIn = ndr_rgbIn->data;
 	r.in.cbIn = ndr_rgbIn->offset;
@@ -569,7 +553,10 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
 
 	status = dcerpc_EcDoRpcExt2_r(emsmdb_ctx->rpc_connection->binding_handle, mem_ctx, &r);
 	talloc_free(ndr_rgbIn);
-	talloc_free(ndr_comp_rgbIn);
+	if (ndr_comp_rgbIn != ndr_uncomp_rgbIn) {
+		talloc_free(ndr_comp_rgbIn);
+	}
+	talloc_free(ndr_uncomp_rgbIn);
 
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
@@ -599,13 +586,23 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_wrapper(struct mapi_session *session,
 					     struct mapi_request *req,
 					     struct mapi_response **repl)
 {
+	struct emsmdb_context	*emsmdb_ctx;
+
 	if (session->emsmdb->ctx == NULL) return NT_STATUS_INVALID_PARAMETER;
+	emsmdb_ctx = (struct emsmdb_context *)session->emsmdb->ctx;
+
+	/* ROPs queued in a batch must reach the server first */
+	if (session->batch) {
+		mapi_batch_send(session->batch);
+	}
+
+	emsmdb_ctx->transaction_count++;
 	switch (session->profile->exchange_version) {
 	case 0x0:
-	  return emsmdb_transaction((struct emsmdb_context *)session->emsmdb->ctx, mem_ctx, req, repl);
+	  return emsmdb_transaction(emsmdb_ctx, mem_ctx, req, repl);
 	case 0x1:
 	case 0x2:
-	  return emsmdb_transaction_ext2((struct emsmdb_context *)session->emsmdb->ctx, mem_ctx, req, repl);
+	  return emsmdb_transaction_ext2(emsmdb_ctx, mem_ctx, req, repl);
 		break;
 	}
 
@@ -970,6 +967,36 @@ enum MAPISTATUS emsmdb_get_SPropValue(TALLOC_CTX *mem_ctx,
 				      struct SPropValue **propvals, 
 				      uint32_t *cn_propvals,
 				      uint8_t flag)
+{
+	return emsmdb_get_SPropValue_ex(mem_ctx, content, tags, propvals, cn_propvals, flag, NULL);
+}
+
+
+/**
+   \details Get a SPropValue array from a DATA blob and report how
+   many bytes of the blob were used
+
+   GetProps replies do not carry their own length. When the reply is
+   followed by other ROP replies in the same response, the blob holds
+   them too and the consumed size tells where the next one starts.
+
+   \param mem_ctx pointer to the memory context
+   \param content pointer to the DATA blob content
+   \param tags pointer to a list of property tags to lookup
+   \param propvals pointer on pointer to the returned SPropValues
+   \param cn_propvals pointer to the number of propvals
+   \param flag describes the type data
+   \param consumed pointer to the number of bytes read, may be NULL
+
+   \return MAPI_E_SUCCESS on success
+ */
+enum MAPISTATUS emsmdb_get_SPropValue_ex(TALLOC_CTX *mem_ctx,
+					 DATA_BLOB *content,
+					 struct SPropTagArray *tags,
+					 struct SPropValue **propvals,
+					 uint32_t *cn_propvals,
+					 uint8_t flag,
+					 uint32_t *consumed)
 {
 	struct SPropValue	*p_propval;
 	uint32_t		i_propval;
@@ -1010,6 +1037,9 @@ enum MAPISTATUS emsmdb_get_SPropValue(TALLOC_CTX *mem_ctx,
 
 	(*propvals)[i_propval].ulPropTag = (enum MAPITAGS) 0x0;
 	*cn_propvals = i_propval;
+	if (consumed) {
+		*consumed = offset;
+	}
 	return MAPI_E_SUCCESS;
 }
 
@@ -1031,6 +1061,28 @@ _PUBLIC_ void emsmdb_get_SRowSet(TALLOC_CTX *mem_ctx,
 				 struct SRowSet *rowset, 
 				 struct SPropTagArray *proptags, 
 				 DATA_BLOB *content)
+{
+	emsmdb_get_SRowSet_ex(mem_ctx, rowset, proptags, content, NULL);
+}
+
+
+/**
+   \details Get a SRowSet from a DATA blob and report how many bytes
+   of the blob were used
+
+   \param mem_ctx pointer on the memory context
+   \param rowset pointer on the returned SRowSet
+   \param proptags pointer on a list of property tags to lookup
+   \param content pointer on the DATA blob content
+   \param consumed pointer to the number of bytes read, may be NULL
+
+   \sa emsmdb_get_SRowSet, emsmdb_get_SPropValue_ex
+ */
+void emsmdb_get_SRowSet_ex(TALLOC_CTX *mem_ctx,
+			   struct SRowSet *rowset,
+			   struct SPropTagArray *proptags,
+			   DATA_BLOB *content,
+			   uint32_t *consumed)
 {
 	struct SRow		*rows;
 	struct SPropValue	*lpProps;
@@ -1097,6 +1149,10 @@ _PUBLIC_ void emsmdb_get_SRowSet(TALLOC_CTX *mem_ctx,
 		rows[idx].cValues = proptags->cValues;
 		rows[idx].lpProps = lpProps;
 	}
+
+	if (consumed) {
+		*consumed = offset;
+	}
 }
 
 
@@ -44,6 +44,7 @@ struct emsmdb_context {
 	enum MAPITAGS	       	*properties;
 	uint16_t     	       	max_data;
 	bool		       	setup;
+	uint32_t		transaction_count; ///< Number of EcDoRpc/EcDoRpcExt2 calls made
 	struct emsmdb_info	info;
 	struct policy_handle	async_handle; ///< The handle to use for Async notification requests
 	struct dcerpc_pipe	*async_rpc_connection;
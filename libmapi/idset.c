@@ -40,7 +40,8 @@ struct GLOBSET_parser {
 	uint8_t				total_stack_size;
 	bool				error;
 	uint32_t			range_count;
-	struct globset_range	*ranges;
+	uint32_t			range_max;
+	struct globset_range		*ranges;
 };
 
 /**
@@ -122,6 +123,23 @@ static DATA_BLOB *GLOBSET_parser_stack_combine(TALLOC_CTX *mem_ctx, struct GLOBS
 	return combined;
 }
 
+static struct globset_range *GLOBSET_parser_new_range(struct GLOBSET_parser *parser)
+{
+	struct globset_range *ranges;
+
+	if (parser->range_count == parser->range_max) {
+		parser->range_max = parser->range_max ? parser->range_max * 2 : 16;
+		ranges = talloc_realloc(parser, parser->ranges, struct globset_range, parser->range_max);
+		if (!ranges) {
+			parser->error = true;
+			return NULL;
+		}
+		parser->ranges = ranges;
+	}
+
+	return &parser->ranges[parser->range_count++];
+}
+
 static uint64_t GLOBSET_parser_range_value(DATA_BLOB *combined)
 {
 	uint64_t value = 0, base = 1;
@@ -142,9 +160,11 @@ static void GLOBSET_parser_do_range(struct GLOBSET_parser *parser)
 	DATA_BLOB *combined, *additional;
 	void *mem_ctx;
 
+	range = GLOBSET_parser_new_range(parser);
+	if (!range) return;
+
 	mem_ctx = talloc_zero(NULL, void);
 
-	range = talloc_zero(parser, struct globset_range);
 	count = 6 - parser->total_stack_size;
 
 	if (count > 0) {
@@ -170,13 +190,7 @@ static void GLOBSET_parser_do_range(struct GLOBSET_parser *parser)
 		range->high = GLOBSET_parser_range_value(combined);
 	}
 
-	DLIST_ADD_END(parser->ranges, range, void);
-	/* DEBUG(5, ("  added range: [%.16"PRIx64":%.16"PRIx64"] %p  %p %p\n", range->low, range->high, range, range->prev, range->next)); */
-	parser->range_count++;
-
-	if (!parser->ranges) {
-		abort();
-	}
+	/* DEBUG(5, ("  added range: [%.16"PRIx64":%.16"PRIx64"]\n", range->low, range->high)); */
 
 	talloc_free(mem_ctx);
 }
@@ -213,11 +227,10 @@ static inline void GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser)
 		}
 		else {
 			if ((mask & bit) == 0) {
-				range = talloc_zero(parser, struct globset_range);
+				range = GLOBSET_parser_new_range(parser);
+				if (!range) return;
 				range->low = lowValue;
 				range->high = highValue;
-				DLIST_ADD_END(parser->ranges, range, void);
-				parser->range_count++;
 				blank = true;
 			}
 			else {
@@ -227,21 +240,22 @@ static inline void GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser)
 	}
 
 	if (!blank) {
-		range = talloc_zero(parser, struct globset_range);
+		range = GLOBSET_parser_new_range(parser);
+		if (!range) return;
 		range->low = lowValue;
 		range->high = highValue;
-		DLIST_ADD_END(parser->ranges, range, void);
-		parser->range_count++;
 	}
 }
 
 /**
   \details deserialize a GLOBSET following the format described in [OXCFXICS - 2.2.2.5]
+
+  \return array of *countP ranges allocated on mem_ctx, in wire order
 */
 _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buffer, uint32_t *countP, uint32_t *byte_countP)
 {
 	struct GLOBSET_parser *parser;
-	struct globset_range *ranges, *range;
+	struct globset_range *ranges;
 	bool end = false;
 	uint8_t command;
 
@@ -291,20 +305,17 @@ _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buff
 		/* abort(); */
 	}
 	else {
-		ranges = parser->ranges;
+		ranges = NULL;
+		if (parser->range_count) {
+			ranges = talloc_realloc(parser, parser->ranges, struct globset_range, parser->range_count);
+			(void) talloc_steal(mem_ctx, ranges);
+		}
 		if (countP) {
 			*countP = parser->range_count;
 		}
 		if (byte_countP) {
 			*byte_countP = parser->buffer_position;
 		}
-		if (ranges) {
-			range = ranges;
-			while (range) {
-				(void) talloc_reference(mem_ctx, range);
-				range = range->next;
-			}
-		}
 	}
 	talloc_free(parser);
 
@@ -315,7 +326,6 @@ _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buff
 static void check_idset(const struct idset *idset)
 {
 	uint32_t i;
-	struct globset_range *range, *last_range;
 
 	while (idset) {
 		if (!idset->idbased && GUID_all_zero(&idset->repl.guid)) {
@@ -323,29 +333,16 @@ static void check_idset(const struct idset *idset)
 			abort();
 		}
 
-		i = 0;
-		if (idset->ranges) {
-			range = idset->ranges;
-			while (range) {
-				/* DEBUG(5, ("range %d: [%.16Lx:%.16Lx] prev: %p; next: %p\n", i, range->low, range->high, range->prev, range->next)); */
-				if (range->prev == NULL) {
-					DEBUG(5, ("range %d has a NULL prev\n", i));
-					abort();
-				}
-				i++;
-				last_range = range;
-				range = range->next;
-			}
-			
-			if (idset->ranges->prev != last_range) {
-				DEBUG(5, ("idset: last element of linked list is not the expected one\n"));
-				abort();
-			}
+		if (idset->range_count && !idset->ranges) {
+			DEBUG(5, ("idset: %d elements reported but no range array\n", idset->range_count));
+			abort();
 		}
 
-		if (i != idset->range_count) {
-			DEBUG(5, ("idset: elements count does not match the reported value (%d and %d)\n", i, idset->range_count));
-			abort();
+		for (i = 1; i < idset->range_count; i++) {
+			if (exchange_globcnt(idset->ranges[i].low) <= exchange_globcnt(idset->ranges[i-1].high)) {
+				DEBUG(5, ("idset: range %d overlaps or precedes the previous one\n", i));
+				abort();
+			}
 		}
 		idset = idset->next;
 	}
@@ -354,6 +351,8 @@ static void check_idset(const struct idset *idset)
 #define check_idset(x) {}
 #endif
 
+static void IDSET_normalize_ranges(struct idset *);
+
 /**
   \details deserialize an IDSET following the format described in [OXCFXICS - 2.2.2.4]
 */
@@ -386,7 +385,8 @@ _PUBLIC_ struct idset *IDSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buffer, bool i
 		globset.length = buffer.length - 16;
 		globset.data = (uint8_t *) buffer.data + 16;
 		idset->ranges = GLOBSET_parse(idset, globset, &idset->range_count, &byte_count);
-		
+		IDSET_normalize_ranges(idset);
+
 		total_bytes += byte_count;
 
 		check_idset(idset);
@@ -455,8 +455,8 @@ static int IDSET_range_compar(const void *vap, const void *vbp)
 {
 	const struct globset_range *ap, *bp;
 
-	ap = *(const struct globset_range **) vap;
-	bp = *(const struct globset_range **) vbp;
+	ap = (const struct globset_range *) vap;
+	bp = (const struct globset_range *) vbp;
 
 	return IDSET_globcnt_compar(&ap->low, &bp->low);
 }
@@ -482,14 +482,17 @@ static struct idset *IDSET_make(TALLOC_CTX *mem_ctx, bool idbased, uint16_t base
 	}
 	idset->single = single;
 
-	current_globset = talloc_zero(idset, struct globset_range);
-	DLIST_ADD_END(idset->ranges, current_globset, end);
-	idset->range_count = 1;
-
 	if (length == 0) {
+		idset->ranges = talloc_zero(idset, struct globset_range);
+		idset->range_count = 1;
 		return idset;
 	}
 
+	/* There are never more ranges than ids */
+	idset->ranges = talloc_zero_array(idset, struct globset_range, (single || length < 3) ? 1 : length);
+	idset->range_count = 1;
+	current_globset = idset->ranges;
+
 	work_array = talloc_memdup(NULL, array, sizeof(uint64_t) * length);
 	qsort(work_array, length, sizeof(uint64_t), IDSET_globcnt_compar);
 
@@ -510,14 +513,14 @@ static struct idset *IDSET_make(TALLOC_CTX *mem_ctx, bool idbased, uint16_t base
 		for (i = 1; i < length; i++) {
 			if ((exchange_globcnt(work_array[i]) != last_consequent) && (exchange_globcnt(work_array[i]) != (last_consequent + 1))) {
 				current_globset->high = exchange_globcnt(last_consequent);
-				current_globset = talloc_zero(idset, struct globset_range);
-				DLIST_ADD_END(idset->ranges, current_globset, void);
+				current_globset = idset->ranges + idset->range_count;
 				idset->range_count++;
 				current_globset->low = work_array[i];
 			}
 			last_consequent = exchange_globcnt(work_array[i]);
 		}
 		current_globset->high = exchange_globcnt(last_consequent);
+		idset->ranges = talloc_realloc(idset, idset->ranges, struct globset_range, idset->range_count);
 	}
 
 	talloc_free(work_array);
@@ -627,98 +630,110 @@ static void IDSET_reorder_idset(struct idset **idsetP)
 	talloc_free(idsets);
 }
 
-static void IDSET_reorder_ranges(struct idset *idset)
+static bool IDSET_ranges_sorted(const struct idset *idset)
 {
-	struct globset_range *range;
-	struct globset_range **ranges;
 	uint32_t i;
 
-	if (!idset || idset->range_count < 2) return;
-
-	ranges = talloc_array(NULL, struct globset_range *, idset->range_count);
-	range = idset->ranges;
-	for (i = 0; i < idset->range_count; i++) {
-		ranges[i] = range;
-		range = range->next;
+	for (i = 1; i < idset->range_count; i++) {
+		if (exchange_globcnt(idset->ranges[i].low) < exchange_globcnt(idset->ranges[i-1].low)) {
+			return false;
+		}
 	}
 
-	qsort(ranges, idset->range_count, sizeof(struct globset_range *), IDSET_range_compar);
-
-	idset->ranges = ranges[0];
-	ranges[0]->prev = ranges[idset->range_count-1];
-	for (i = 0; i < idset->range_count - 1; i++) {
-		ranges[i]->next = ranges[i+1];
-		ranges[i+1]->prev = ranges[i];
-	}
-	ranges[idset->range_count-1]->next = NULL;
+	return true;
+}
 
-	check_idset(idset);
+static void IDSET_reorder_ranges(struct idset *idset)
+{
+	if (!idset || idset->range_count < 2) return;
+	if (IDSET_ranges_sorted(idset)) return;
 
-	talloc_free(ranges);
+	qsort(idset->ranges, idset->range_count, sizeof(struct globset_range), IDSET_range_compar);
 }
 
+/**
+  \details merge the overlapping and adjacent ranges of an idset, or all
+  of them if the idset is a single range one. Ranges must be sorted.
+*/
 static void IDSET_compact_ranges(struct idset *idset)
 {
-	struct globset_range *range, *next_range, *prev_range;
+	struct globset_range *range, *next_range;
+	uint32_t i;
 
 	if (!idset || idset->range_count < 2) return;
 
+	range = idset->ranges;
 	if (idset->single) {
-		range = idset->ranges;
-		next_range = range->next;
-		while (next_range) {
+		for (i = 1; i < idset->range_count; i++) {
+			next_range = idset->ranges + i;
 			if (exchange_globcnt(next_range->low) < exchange_globcnt(range->low)) {
 				range->low = next_range->low;
 			}
 			if (exchange_globcnt(next_range->high) > exchange_globcnt(range->high)) {
 				range->high = next_range->high;
 			}
-			prev_range = next_range;
-			next_range = next_range->next;
-			talloc_free(prev_range);
 		}
-		range->next = NULL;
-		range->prev = range;
-		idset->range_count = 1;
 	}
 	else {
-		range = idset->ranges;
-		while (range) {
-			next_range = range->next;
-			while (next_range) {
-				if (exchange_globcnt(next_range->low) >= exchange_globcnt(range->low)
-				    && exchange_globcnt(next_range->low) <= exchange_globcnt(range->high)) {		/* A[  B[...  ]A */
-					if (exchange_globcnt(next_range->high) > exchange_globcnt(range->high)) {	/* A[  B[  ]A  ]B -> A[  B[  ]AB */
-						range->high = next_range->high;
-					}
-					range->next = next_range->next;
-					if (range->next) {
-						range->next->prev = range;
-					}
-					if (idset->ranges->prev == next_range) {
-						idset->ranges->prev = range;
-					}
-					idset->range_count--;
-					talloc_free(next_range);
-					next_range = range->next;
-				}
-				else {
-					next_range = NULL;
+		for (i = 1; i < idset->range_count; i++) {
+			next_range = idset->ranges + i;
+			if (exchange_globcnt(next_range->low) <= exchange_globcnt(range->high) + 1) {		/* A[  B[...  ]A or A[  ]A B[ */
+				if (exchange_globcnt(next_range->high) > exchange_globcnt(range->high)) {	/* A[  B[  ]A  ]B -> A[  B[  ]AB */
+					range->high = next_range->high;
 				}
 			}
-			range = range->next;
+			else {
+				range++;
+				*range = *next_range;
+			}
 		}
 	}
+	idset->range_count = range - idset->ranges + 1;
 
 	check_idset(idset);
 }
 
+/**
+  \details sort and compact the ranges of an idset received from the
+  wire, so that lookups can rely on a sorted array of disjoint ranges
+*/
+static void IDSET_normalize_ranges(struct idset *idset)
+{
+	IDSET_reorder_ranges(idset);
+	IDSET_compact_ranges(idset);
+}
+
+/**
+  \details returns an exact but totally distinct copy of the first
+  element of an idset list
+*/
+static struct idset *IDSET_clone_one(TALLOC_CTX *mem_ctx, const struct idset *source_idset)
+{
+	struct idset *idset;
+
+	idset = talloc_zero(mem_ctx, struct idset);
+	idset->idbased = source_idset->idbased;
+	if (idset->idbased) {
+		idset->repl.id = source_idset->repl.id;
+	}
+	else {
+		idset->repl.guid = source_idset->repl.guid;
+	}
+	idset->single = source_idset->single;
+	idset->range_count = source_idset->range_count;
+	if (source_idset->range_count) {
+		idset->ranges = talloc_memdup(idset, source_idset->ranges,
+					      sizeof(struct globset_range) * source_idset->range_count);
+	}
+
+	return idset;
+}
+
 /**
   \details returns an exact but totally distinct copy of an idset structure
 */
 static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source_idset)
 {
-	struct globset_range *range, *clone;
 	struct idset *idset = NULL, *head_idset = NULL, *tail_idset;
 
 	if (!source_idset) return NULL;
@@ -727,26 +742,7 @@ static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source
 
 	while (source_idset) {
 		tail_idset = idset;
-		idset = talloc_zero(mem_ctx, struct idset);
-		idset->idbased = source_idset->idbased;
-		if (idset->idbased) {
-			idset->repl.id = source_idset->repl.id;
-		}
-		else {
-			idset->repl.guid = source_idset->repl.guid;
-		}
-		idset->single = source_idset->single;
-		idset->range_count = source_idset->range_count;
-
-		range = source_idset->ranges;
-		while (range) {
-			clone = talloc_zero(idset, struct globset_range);
-			clone->low = range->low;
-			clone->high = range->high;
-			DLIST_ADD_END(idset->ranges, clone, void);
-			range = range->next;
-		}
-
+		idset = IDSET_clone_one(mem_ctx, source_idset);
 		if (!head_idset) {
 			head_idset = idset;
 		}
@@ -761,75 +757,98 @@ static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source
 	return head_idset;
 }
 
+static bool IDSET_same_repl(const struct idset *a, const struct idset *b)
+{
+	if (a->idbased) {
+		return a->repl.id == b->repl.id;
+	}
+
+	return GUID_equal(&a->repl.guid, &b->repl.guid);
+}
+
+/**
+  \details merge the ranges of source into idset, both sharing the
+  same replica. Sorted inputs are merged in linear time.
+*/
+static void IDSET_merge_ranges(struct idset *idset, const struct idset *source)
+{
+	struct globset_range *ranges, *left, *right;
+	struct idset *sorted_source = NULL;
+	uint32_t i = 0, j = 0, k = 0;
+
+	if (!source->range_count) return;
+
+	IDSET_reorder_ranges(idset);
+	if (!IDSET_ranges_sorted(source)) {
+		sorted_source = IDSET_clone_one(NULL, source);
+		IDSET_reorder_ranges(sorted_source);
+		source = sorted_source;
+	}
+
+	ranges = talloc_array(idset, struct globset_range, idset->range_count + source->range_count);
+	left = idset->ranges;
+	right = source->ranges;
+	while (i < idset->range_count || j < source->range_count) {
+		if (j == source->range_count
+		    || (i < idset->range_count && exchange_globcnt(left[i].low) <= exchange_globcnt(right[j].low))) {
+			ranges[k++] = left[i++];
+		}
+		else {
+			ranges[k++] = right[j++];
+		}
+	}
+
+	talloc_free(idset->ranges);
+	idset->ranges = ranges;
+	idset->range_count = k;
+	talloc_free(sorted_source);
+
+	IDSET_compact_ranges(idset);
+}
+
 /**
   \details merge two idsets structures into a third one
 */
 _PUBLIC_ struct idset *IDSET_merge_idsets(TALLOC_CTX *mem_ctx, const struct idset *left, const struct idset *right)
 {
-	struct idset *merged_idset, *clone_right, *current, *next;
-	uint16_t current_id = 0, next_id;
-	struct GUID *current_guid = NULL, *next_guid;
-	bool added_ranges = false, same_id, idbased;
-	struct globset_range *range;
+	struct idset *merged_idset = NULL, *tail_idset = NULL, *current;
+	const struct idset *source;
+	bool right_side = false;
 
 	if (!left || left->range_count == 0) return IDSET_clone(mem_ctx, right);
 	if (!right || right->range_count == 0) return IDSET_clone(mem_ctx, left);
 
-	merged_idset = IDSET_clone(mem_ctx, left);
-	clone_right = IDSET_clone(mem_ctx, right);
-
-	current = merged_idset;
-	while (current->next) {
-		current = current->next;
-	}
-	current->next = clone_right;
-
-	IDSET_reorder_idset(&merged_idset);
-
-	current = merged_idset;
-	idbased = current->idbased;
-	if (idbased) {
-		current_id = current->repl.id;
-	} else {
-		current_guid = &current->repl.guid;
-	}
-	while (current->next) {
-		next = current->next;
-
-		if (idbased) {
-			next_id = next->repl.id;
-			same_id = (current_id == next_id);
-		} else {
-			next_guid = &next->repl.guid;
-			same_id = GUID_equal(current_guid, next_guid);
+	source = left;
+	while (source) {
+		for (current = merged_idset; current; current = current->next) {
+			if (IDSET_same_repl(current, source)) break;
 		}
-		
-		if (same_id) {
-			added_ranges = true;
-			current->range_count += next->range_count;
-			range = next->ranges;
-			current->ranges->prev->next = range;
-			while (range) {
-				(void) talloc_reference(current, range);
-				range = range->next;
-			}
-			current->next = next->next;
-			talloc_free(next);
+
+		if (current) {
+			IDSET_merge_ranges(current, source);
 		}
 		else {
-			current = next;
+			current = IDSET_clone_one(mem_ctx, source);
+			if (tail_idset) {
+				tail_idset->next = current;
+			}
+			else {
+				merged_idset = current;
+			}
+			tail_idset = current;
 		}
-	}
 
-	if (added_ranges) {
-		current = merged_idset;
-		while (current) {
-			IDSET_reorder_ranges(current);
-			IDSET_compact_ranges(current);
-			current = current->next;
+		source = source->next;
+		if (!source && !right_side) {
+			source = right;
+			right_side = true;
 		}
 	}
 
+	IDSET_reorder_idset(&merged_idset);
+
+	check_idset(merged_idset);
+
 	return merged_idset;
 }
 
@@ -839,8 +858,8 @@ _PUBLIC_ struct idset *IDSET_merge_idsets(TALLOC_CTX *mem_ctx, const struct idse
 _PUBLIC_ struct Binary_r *IDSET_serialize(TALLOC_CTX *mem_ctx, const struct idset *idset)
 {
 	struct ndr_push	*ndr;
-	struct globset_range *current_range;
 	struct Binary_r *data;
+	uint32_t i;
 
 	check_idset(idset);
 
@@ -855,10 +874,8 @@ _PUBLIC_ struct Binary_r *IDSET_serialize(TALLOC_CTX *mem_ctx, const struct idse
 			ndr_push_GUID(ndr, NDR_SCALARS, &idset->repl.guid);
 		}
 
-		current_range = idset->ranges;
-		while (current_range) {
-			GLOBSET_ndr_push_globset_range(ndr, current_range);
-			current_range = current_range->next;
+		for (i = 0; i < idset->range_count; i++) {
+			GLOBSET_ndr_push_globset_range(ndr, idset->ranges + i);
 		}
 		ndr_push_uint8(ndr, NDR_SCALARS, 0x00); /* end */
 		idset = idset->next;
@@ -873,12 +890,50 @@ _PUBLIC_ struct Binary_r *IDSET_serialize(TALLOC_CTX *mem_ctx, const struct idse
 	return data;
 }
 
+/**
+  \details binary search of the range including a globcnt
+
+  \param idset pointer to the idset, whose ranges are sorted and disjoint
+  \param globcnt the globcnt to look for, as stored in the ranges
+  \param indexP pointer to the index of the range the function returns
+
+  \return true if a range includes globcnt, otherwise false
+*/
+static bool IDSET_ranges_find(const struct idset *idset, uint64_t globcnt, uint32_t *indexP)
+{
+	uint64_t value;
+	uint32_t low, high, middle;
+
+	value = exchange_globcnt(globcnt);
+
+	/* find the first range starting after value */
+	low = 0;
+	high = idset->range_count;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (exchange_globcnt(idset->ranges[middle].low) <= value) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	if (low == 0 || exchange_globcnt(idset->ranges[low - 1].high) < value) {
+		return false;
+	}
+	if (indexP) {
+		*indexP = low - 1;
+	}
+
+	return true;
+}
+
 /**
   \details tests the presence of a specific id in the ranges of a ReplID-based idset structure
 */
 _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 {
-	struct globset_range *range;
 	uint16_t eid_id;
 	uint64_t eid_globcnt;
 
@@ -890,15 +945,8 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 	eid_globcnt = eid >> 16;
 
 	while (idset) {
-		if (idset->repl.id == eid_id) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(eid_globcnt)
-				    && exchange_globcnt(range->high) >= exchange_globcnt(eid_globcnt)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (idset->repl.id == eid_id && IDSET_ranges_find(idset, eid_globcnt, NULL)) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -911,8 +959,6 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 */
 _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *replica_guid, uint64_t id)
 {
-	struct globset_range *range;
-
 	if (!idset || idset->idbased) {
 		return false;
 	}
@@ -921,14 +967,8 @@ _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *r
 	}
 
 	while (idset) {
-		if (GUID_equal(&idset->repl.guid, replica_guid)) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(id) && exchange_globcnt(range->high) >= exchange_globcnt(id)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (GUID_equal(&idset->repl.guid, replica_guid) && IDSET_ranges_find(idset, id, NULL)) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -937,49 +977,40 @@ _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *r
 }
 
 static void IDSET_ranges_remove_globcnt(struct idset *idset, uint64_t eid) {
-	struct globset_range *range, *new_range;
-	bool done = false;
+	struct globset_range *range, *ranges;
 	uint64_t work_eid;
+	uint32_t i;
 
-	work_eid = exchange_globcnt(eid);
+	if (!IDSET_ranges_find(idset, eid, &i)) {
+		return;
+	}
 
-	range = idset->ranges;
-	while (!done && range) {
-		if (range->low == eid) {
-			if (range->high == eid) {
-				DLIST_REMOVE(idset->ranges, range);
-				idset->range_count--;
-				if (range->next == NULL && idset->ranges != NULL) {
-					idset->ranges->prev = range->prev;
-				}
-				talloc_free(range);
-			}
-			else {
-				range->low = exchange_globcnt(work_eid + 1);
-			}
-			done = true;
-		}
-		else if (range->high == eid) {
-			range->high = exchange_globcnt(work_eid + 1);
-			done = true;
-		}
-		else if ((exchange_globcnt(range->low) < work_eid) && (exchange_globcnt(range->high) > work_eid)) {
-			new_range = talloc_zero(idset, struct globset_range);
-			new_range->low = exchange_globcnt(work_eid + 1);
-			new_range->high = range->high;
-			range->high = exchange_globcnt(work_eid - 1);
-			new_range->next = range->next;
-			range->next = new_range;
-			if (new_range->next == NULL) {
-				idset->ranges->prev = new_range;
-			}
-			idset->range_count++;
-			done = true;
+	work_eid = exchange_globcnt(eid);
+	range = idset->ranges + i;
+	if (range->low == eid) {
+		if (range->high == eid) {
+			memmove(range, range + 1, sizeof(struct globset_range) * (idset->range_count - i - 1));
+			idset->range_count--;
 		}
 		else {
-			range = range->next;
+			range->low = exchange_globcnt(work_eid + 1);
 		}
 	}
+	else if (range->high == eid) {
+		range->high = exchange_globcnt(work_eid - 1);
+	}
+	else {
+		/* split the range in two */
+		ranges = talloc_realloc(idset, idset->ranges, struct globset_range, idset->range_count + 1);
+		if (!ranges) return;
+		idset->ranges = ranges;
+		range = ranges + i;
+		memmove(range + 2, range + 1, sizeof(struct globset_range) * (idset->range_count - i - 1));
+		range[1].low = exchange_globcnt(work_eid + 1);
+		range[1].high = range->high;
+		range->high = exchange_globcnt(work_eid - 1);
+		idset->range_count++;
+	}
 }
 
 _PUBLIC_ void IDSET_remove_rawidset(struct idset *idset, const struct rawidset *rawidset)
@@ -1029,7 +1060,7 @@ _PUBLIC_ void IDSET_remove_rawidset(struct idset *idset, const struct rawidset *
 */
 _PUBLIC_ void IDSET_dump(const struct idset *idset, const char *label)
 {
-	struct globset_range *range;
+	const struct globset_range *range;
 	uint32_t i;
 	char *guid_str;
 
@@ -1044,13 +1075,12 @@ _PUBLIC_ void IDSET_dump(const struct idset *idset, const char *label)
 			talloc_free(guid_str);
 		}
 
-		range = idset->ranges;
 		for (i = 0; i < idset->range_count; i++) {
+			range = idset->ranges + i;
 			if (exchange_globcnt(range->low) > exchange_globcnt(range->high)) {
 				abort();
 			}
 			DEBUG(0, ("  [0x%.12" PRIx64 ":0x%.12" PRIx64 "]\n", range->low, range->high));
-			range = range->next;
 		}
 
 		idset = idset->next;
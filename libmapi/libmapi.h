@@ -209,6 +209,20 @@ void			mapi_object_debug(mapi_object_t *);
 enum MAPISTATUS		mapi_object_bookmark_get_count(mapi_object_t *, uint32_t *);
 enum MAPISTATUS		mapi_object_bookmark_debug(mapi_object_t *);
 
+/* The following public definitions come from libmapi/mapi_batch.c */
+enum MAPISTATUS		mapi_batch_begin(struct mapi_session *);
+enum MAPISTATUS		mapi_batch_flush(struct mapi_session *);
+enum MAPISTATUS		mapi_batch_end(struct mapi_session *);
+enum MAPISTATUS		mapi_batch_OpenFolder(mapi_object_t *, mapi_id_t, mapi_object_t *);
+enum MAPISTATUS		mapi_batch_OpenMessage(mapi_object_t *, mapi_id_t, mapi_id_t, mapi_object_t *, uint8_t);
+enum MAPISTATUS		mapi_batch_GetHierarchyTable(mapi_object_t *, mapi_object_t *, uint8_t, uint32_t *);
+enum MAPISTATUS		mapi_batch_GetContentsTable(mapi_object_t *, mapi_object_t *, uint8_t, uint32_t *);
+enum MAPISTATUS		mapi_batch_GetAttachmentTable(mapi_object_t *, mapi_object_t *);
+enum MAPISTATUS		mapi_batch_GetProps(mapi_object_t *, uint32_t, struct SPropTagArray *, struct SPropValue **, uint32_t *);
+enum MAPISTATUS		mapi_batch_SetColumns(mapi_object_t *, struct SPropTagArray *);
+enum MAPISTATUS		mapi_batch_QueryRows(mapi_object_t *, uint16_t, enum QueryRowsFlags, struct SRowSet *);
+enum MAPISTATUS		mapi_batch_Release(mapi_object_t *);
+
 /* The following public definitions come from libmapi/mapi_id_array.c */
 enum MAPISTATUS		mapi_id_array_init(TALLOC_CTX *, mapi_id_array_t *);
 enum MAPISTATUS		mapi_id_array_release(mapi_id_array_t *);
@@ -505,6 +519,10 @@ enum MAPISTATUS		uncompress_rtf(TALLOC_CTX *, uint8_t *, uint32_t, DATA_BLOB *);
 uint32_t		calculateCRC(uint8_t *, uint32_t, uint32_t);
 enum MAPISTATUS		compress_rtf(TALLOC_CTX *, const char*, const size_t, uint8_t **, size_t *);
 
+/* The following public definitions come from libmapi/lzxpress.c */
+ssize_t			compress_lzxpress(const uint8_t *, uint32_t, uint8_t *, uint32_t);
+ssize_t			uncompress_lzxpress(const uint8_t *, uint32_t, uint8_t *, uint32_t);
+
 /* The following public definitions come from libmapi/utils.c */
 char			*guid_delete_dash(TALLOC_CTX *, const char *);
 struct Binary_r		*generate_recipient_entryid(TALLOC_CTX *, const char *);
@@ -60,6 +60,7 @@ __BEGIN_DECLS
 void obfuscate_data(uint8_t *, uint32_t, uint8_t);
 enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *, struct ndr_pull **, ssize_t);
 enum ndr_err_code ndr_push_lzxpress_compress(struct ndr_push *, struct ndr_push *);
+enum ndr_err_code ndr_push_mapi2k7_chunks(struct ndr_push *, struct ndr_push *, uint16_t);
 enum ndr_err_code ndr_push_ExtendedException(struct ndr_push *, int, uint16_t, const struct ExceptionInfo *, const struct ExtendedException *);
 enum ndr_err_code ndr_pull_ExtendedException(struct ndr_pull *, int, uint16_t, const struct ExceptionInfo *, struct ExtendedException *);
 enum ndr_err_code ndr_push_AppointmentRecurrencePattern(struct ndr_push *, int, const struct AppointmentRecurrencePattern *);
@@ -78,6 +79,8 @@ NTSTATUS		emsmdb_register_notification(struct mapi_session *, struct NOTIFKEY *)
 void			free_emsmdb_property(struct SPropValue *, void *);
 const void		*pull_emsmdb_property(TALLOC_CTX *, uint32_t *, enum MAPITAGS, DATA_BLOB *);
 enum MAPISTATUS		emsmdb_get_SPropValue(TALLOC_CTX *, DATA_BLOB *, struct SPropTagArray *, struct SPropValue **, uint32_t *, uint8_t);
+enum MAPISTATUS		emsmdb_get_SPropValue_ex(TALLOC_CTX *, DATA_BLOB *, struct SPropTagArray *, struct SPropValue **, uint32_t *, uint8_t, uint32_t *);
+void			emsmdb_get_SRowSet_ex(TALLOC_CTX *, struct SRowSet *, struct SPropTagArray *, DATA_BLOB *, uint32_t *);
 void			emsmdb_get_SRow(TALLOC_CTX *, struct SRow *, struct SPropTagArray *, uint16_t, DATA_BLOB *, uint8_t, uint8_t);
 enum MAPISTATUS		emsmdb_async_connect(struct emsmdb_context *);
 bool 			server_version_at_least(struct emsmdb_context *, uint16_t, uint16_t, uint16_t, uint16_t);
@@ -93,12 +96,17 @@ void			mapi_get_language_list(void);
 
 /* The following private definitions come from libmapi/mapi_object.c */
 int			mapi_object_is_invalid(mapi_object_t *);
+void			mapi_object_cleanup(mapi_object_t *);
 void			mapi_object_set_id(mapi_object_t *, mapi_id_t);
 mapi_handle_t		mapi_object_get_handle(mapi_object_t *);
 void			mapi_object_set_handle(mapi_object_t *, mapi_handle_t);
 void			mapi_object_table_init(TALLOC_CTX *, mapi_object_t *);
 enum MAPISTATUS		mapi_object_bookmark_find(mapi_object_t *, uint32_t,struct SBinary_short *);
 
+/* The following private definitions come from libmapi/mapi_batch.c */
+void			mapi_batch_send(struct mapi_batch *);
+bool			mapi_batch_pending(struct mapi_batch *, mapi_object_t *);
+
 /* The following private definitions come from libmapi/property.c */
 enum MAPITAGS		*get_MAPITAGS_SRow(TALLOC_CTX *, struct SRow *, uint32_t *);
 uint32_t		MAPITAGS_delete_entries(enum MAPITAGS *, uint32_t, uint32_t, ...);
@@ -117,6 +125,9 @@ uint32_t		get_mapi_SRestriction_size(struct mapi_SRestriction *);
 enum MAPISTATUS		Logon(struct mapi_session *, struct mapi_provider *, enum PROVIDER_ID);
 enum MAPISTATUS		GetNewLogonId(struct mapi_session *, uint8_t *);
 
+/* The following private definitions come from libmapi/IStoreFolder.c */
+void			mapi_object_message_init(struct mapi_session *, mapi_object_t *, struct OpenMessage_repl *);
+
 /* The following private definitions come from libmapi/IMessage.c */
 uint8_t			mapi_recipients_get_org_length(struct mapi_profile *);
 uint16_t		mapi_recipients_RecipientFlags(struct SRow *);
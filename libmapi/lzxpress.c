@@ -0,0 +1,333 @@
+/*
+   OpenChange MAPI implementation.
+
+   Copyright (C) agent 2026.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+/**
+   \file lzxpress.c
+
+   \brief LZ77 (Xpress) compression used by EcDoRpcExt2 payloads
+
+   This is the plain LZ77 algorithm described in [MS-XCA] section 2.3
+   and referenced by [MS-OXCRPC] section 3.1.4.11.1: literals and
+   matches are interleaved with 32-bit flag words (most significant
+   bit first, 1 for a match), matches are encoded on 16 bits as
+   (offset - 1) << 3 | min(length - 3, 7) and longer lengths are
+   continued on shared nibbles, bytes, 16-bit and 32-bit words.
+ */
+
+#ifndef MIN
+#define	MIN(a,b) ((a)<(b)?(a):(b))
+#endif
+
+#define	LZXPRESS_WINDOW_SIZE	8192
+#define	LZXPRESS_WINDOW_MASK	(LZXPRESS_WINDOW_SIZE - 1)
+#define	LZXPRESS_MIN_MATCH	3
+#define	LZXPRESS_HASH_BITS	13
+#define	LZXPRESS_HASH_SIZE	(1 << LZXPRESS_HASH_BITS)
+#define	LZXPRESS_MAX_CHAIN	64
+
+#define	LZXPRESS_HASH(p)	((((p)[0] << 10) ^ ((p)[1] << 5) ^ (p)[2]) & (LZXPRESS_HASH_SIZE - 1))
+
+#define	LZXPRESS_PUT_UINT16(buf, pos, val)	do {		\
+		(buf)[(pos)] = (val) & 0xFF;			\
+		(buf)[(pos) + 1] = ((val) >> 8) & 0xFF;		\
+	} while (0)
+
+#define	LZXPRESS_PUT_UINT32(buf, pos, val)	do {		\
+		(buf)[(pos)] = (val) & 0xFF;			\
+		(buf)[(pos) + 1] = ((val) >> 8) & 0xFF;		\
+		(buf)[(pos) + 2] = ((val) >> 16) & 0xFF;	\
+		(buf)[(pos) + 3] = ((val) >> 24) & 0xFF;	\
+	} while (0)
+
+#define	LZXPRESS_GET_UINT16(buf, pos)	((uint32_t)(buf)[(pos)] | ((uint32_t)(buf)[(pos) + 1] << 8))
+
+#define	LZXPRESS_GET_UINT32(buf, pos)	((uint32_t)(buf)[(pos)] |		\
+					 ((uint32_t)(buf)[(pos) + 1] << 8) |	\
+					 ((uint32_t)(buf)[(pos) + 2] << 16) |	\
+					 ((uint32_t)(buf)[(pos) + 3] << 24))
+
+/* Hash chains over the sliding window: head holds the most recent
+   position for a given 3-byte hash, prev links a position to the
+   previous one sharing its hash */
+struct lzxpress_state {
+	int32_t		head[LZXPRESS_HASH_SIZE];
+	int32_t		prev[LZXPRESS_WINDOW_SIZE];
+};
+
+
+static inline void lzxpress_insert(struct lzxpress_state *state,
+				   const uint8_t *input, uint32_t pos)
+{
+	uint32_t	hash = LZXPRESS_HASH(input + pos);
+
+	state->prev[pos & LZXPRESS_WINDOW_MASK] = state->head[hash];
+	state->head[hash] = pos;
+}
+
+
+static uint32_t lzxpress_find_match(struct lzxpress_state *state,
+				    const uint8_t *input, uint32_t input_size,
+				    uint32_t pos, uint32_t *match_offset)
+{
+	int32_t		candidate;
+	int32_t		next;
+	uint32_t	best_length = 0;
+	uint32_t	max_length = input_size - pos;
+	uint32_t	length;
+	uint32_t	chain = 0;
+
+	candidate = state->head[LZXPRESS_HASH(input + pos)];
+	while (candidate >= 0 && (pos - candidate) <= LZXPRESS_WINDOW_SIZE && chain < LZXPRESS_MAX_CHAIN) {
+		if (input[candidate + best_length] == input[pos + best_length]) {
+			for (length = 0; length < max_length && input[candidate + length] == input[pos + length]; length++);
+			if (length > best_length) {
+				best_length = length;
+				*match_offset = pos - candidate;
+				if (length == max_length) break;
+			}
+		}
+
+		next = state->prev[candidate & LZXPRESS_WINDOW_MASK];
+		if (next >= candidate) break;
+		candidate = next;
+		chain++;
+	}
+
+	return (best_length >= LZXPRESS_MIN_MATCH) ? best_length : 0;
+}
+
+
+/**
+   \details Compress a buffer using the LZ77 (Xpress) algorithm
+
+   \param input pointer to the uncompressed data
+   \param input_size size of the uncompressed data
+   \param output pointer to the buffer receiving compressed data
+   \param max_output_size size of the output buffer
+
+   \return size of the compressed data on success, otherwise -1 if
+   the output buffer is too small
+ */
+_PUBLIC_ ssize_t compress_lzxpress(const uint8_t *input, uint32_t input_size,
+				   uint8_t *output, uint32_t max_output_size)
+{
+	struct lzxpress_state	*state;
+	uint32_t		input_pos = 0;
+	uint32_t		output_pos = 4;
+	uint32_t		flag_pos = 0;
+	uint32_t		nibble_pos = 0;
+	uint32_t		flag_count = 0;
+	uint64_t		flags = 0;
+	uint32_t		match_length;
+	uint32_t		match_offset = 0;
+	uint32_t		length;
+	uint32_t		i;
+
+	if (!input || !output || max_output_size < 4) return -1;
+
+	state = talloc(NULL, struct lzxpress_state);
+	if (!state) return -1;
+	memset(state->head, 0xFF, sizeof (state->head));
+
+	while (input_pos < input_size) {
+		match_length = 0;
+		if (input_size - input_pos >= LZXPRESS_MIN_MATCH) {
+			match_length = lzxpress_find_match(state, input, input_size, input_pos, &match_offset);
+		}
+
+		if (!match_length) {
+			/* Literal */
+			if (output_pos + 1 > max_output_size) goto overflow;
+			output[output_pos++] = input[input_pos];
+			if (input_size - input_pos >= LZXPRESS_MIN_MATCH) {
+				lzxpress_insert(state, input, input_pos);
+			}
+			input_pos++;
+			flags <<= 1;
+		} else {
+			/* Match */
+			for (i = 0; i < match_length && input_size - (input_pos + i) >= LZXPRESS_MIN_MATCH; i++) {
+				lzxpress_insert(state, input, input_pos + i);
+			}
+			input_pos += match_length;
+
+			length = match_length - LZXPRESS_MIN_MATCH;
+			if (output_pos + 2 > max_output_size) goto overflow;
+			LZXPRESS_PUT_UINT16(output, output_pos, ((match_offset - 1) << 3) | MIN(length, 7));
+			output_pos += 2;
+
+			if (length >= 7) {
+				length -= 7;
+				if (!nibble_pos) {
+					if (output_pos + 1 > max_output_size) goto overflow;
+					nibble_pos = output_pos;
+					output[output_pos++] = MIN(length, 15);
+				} else {
+					output[nibble_pos] |= MIN(length, 15) << 4;
+					nibble_pos = 0;
+				}
+
+				if (length >= 15) {
+					length -= 15;
+					if (length < 255) {
+						if (output_pos + 1 > max_output_size) goto overflow;
+						output[output_pos++] = length;
+					} else {
+						if (output_pos + 1 > max_output_size) goto overflow;
+						output[output_pos++] = 0xFF;
+						length = match_length - LZXPRESS_MIN_MATCH;
+						if (length < (1 << 16)) {
+							if (output_pos + 2 > max_output_size) goto overflow;
+							LZXPRESS_PUT_UINT16(output, output_pos, length);
+							output_pos += 2;
+						} else {
+							if (output_pos + 6 > max_output_size) goto overflow;
+							LZXPRESS_PUT_UINT16(output, output_pos, 0);
+							LZXPRESS_PUT_UINT32(output, output_pos + 2, length);
+							output_pos += 6;
+						}
+					}
+				}
+			}
+			flags = (flags << 1) | 1;
+		}
+
+		flag_count++;
+		if (flag_count == 32) {
+			LZXPRESS_PUT_UINT32(output, flag_pos, (uint32_t)flags);
+			flags = 0;
+			flag_count = 0;
+			flag_pos = output_pos;
+			if (output_pos + 4 > max_output_size) goto overflow;
+			output_pos += 4;
+		}
+	}
+
+	/* Terminate with match flags so the decompressor stops at the
+	   end of input */
+	flags = (flags << (32 - flag_count)) | ((1ULL << (32 - flag_count)) - 1);
+	LZXPRESS_PUT_UINT32(output, flag_pos, (uint32_t)flags);
+
+	talloc_free(state);
+	return output_pos;
+
+overflow:
+	talloc_free(state);
+	return -1;
+}
+
+
+/**
+   \details Decompress a LZ77 (Xpress) compressed buffer
+
+   \param input pointer to the compressed data
+   \param input_size size of the compressed data
+   \param output pointer to the buffer receiving uncompressed data
+   \param max_output_size size of the output buffer
+
+   \return size of the uncompressed data on success, otherwise -1
+   on malformed input or if the output buffer is too small
+ */
+_PUBLIC_ ssize_t uncompress_lzxpress(const uint8_t *input, uint32_t input_size,
+				     uint8_t *output, uint32_t max_output_size)
+{
+	uint32_t	input_pos = 0;
+	uint32_t	output_pos = 0;
+	uint32_t	nibble_pos = 0;
+	uint32_t	flags = 0;
+	uint32_t	flag_count = 0;
+	uint32_t	match;
+	uint32_t	match_length;
+	uint32_t	match_offset;
+	uint32_t	i;
+
+	if (!input || !output) return -1;
+
+	while (true) {
+		if (!flag_count) {
+			if (input_pos + 4 > input_size) return -1;
+			flags = LZXPRESS_GET_UINT32(input, input_pos);
+			input_pos += 4;
+			flag_count = 32;
+		}
+		flag_count--;
+
+		if (!(flags & (1U << flag_count))) {
+			/* Literal */
+			if (input_pos >= input_size) return -1;
+			if (output_pos >= max_output_size) return -1;
+			output[output_pos++] = input[input_pos++];
+			continue;
+		}
+
+		/* End of input */
+		if (input_pos == input_size) break;
+
+		if (input_pos + 2 > input_size) return -1;
+		match = LZXPRESS_GET_UINT16(input, input_pos);
+		input_pos += 2;
+		match_length = match & 7;
+		match_offset = (match >> 3) + 1;
+
+		if (match_length == 7) {
+			if (!nibble_pos) {
+				if (input_pos >= input_size) return -1;
+				nibble_pos = input_pos;
+				match_length = input[input_pos++] & 0xF;
+			} else {
+				match_length = input[nibble_pos] >> 4;
+				nibble_pos = 0;
+			}
+
+			if (match_length == 15) {
+				if (input_pos >= input_size) return -1;
+				match_length = input[input_pos++];
+				if (match_length == 255) {
+					if (input_pos + 2 > input_size) return -1;
+					match_length = LZXPRESS_GET_UINT16(input, input_pos);
+					input_pos += 2;
+					if (!match_length) {
+						if (input_pos + 4 > input_size) return -1;
+						match_length = LZXPRESS_GET_UINT32(input, input_pos);
+						input_pos += 4;
+					}
+					if (match_length < 15 + 7) return -1;
+					match_length -= 15 + 7;
+				}
+				match_length += 15;
+			}
+			match_length += 7;
+		}
+		match_length += LZXPRESS_MIN_MATCH;
+
+		if (match_offset > output_pos) return -1;
+		if (match_length > max_output_size - output_pos) return -1;
+
+		/* Byte per byte copy: source and destination may overlap */
+		for (i = 0; i < match_length; i++) {
+			output[output_pos] = output[output_pos - match_offset];
+			output_pos++;
+		}
+	}
+
+	return output_pos;
+}
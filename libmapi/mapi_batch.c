@@ -0,0 +1,841 @@
+/*
+   OpenChange MAPI implementation.
+
+   Copyright (C) agent 2026.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+#include "gen_ndr/ndr_exchange.h"
+
+/**
+   \file mapi_batch.c
+
+   \brief ROP batching: send several operations in a single EMSMDB
+   transaction
+
+   Every libmapi operation is a round trip to the server. Between
+   mapi_batch_begin() and mapi_batch_end(), the mapi_batch_* functions
+   queue their ROP instead and a whole sequence - open a folder, get
+   its contents table, set the columns, read the first rows, release
+   the table - goes out in one EcDoRpc/EcDoRpcExt2 call.
+
+   Objects opened in a batch can be used as input of the operations
+   queued after them: the request refers to the handle index the
+   server will fill rather than to a handle. Their handle, and the
+   data the operations return, are available once the batch has been
+   sent, by mapi_batch_flush(), mapi_batch_end() or as soon as a
+   regular libmapi function is called on the session.
+*/
+
+/* Size of a request is bound by the server receive buffer */
+#define	MAPI_BATCH_MAX_ROPS	64
+#define	MAPI_BATCH_MAX_HANDLES	(MAPI_BATCH_MAX_ROPS * 2)
+#define	MAPI_BATCH_MAX_SIZE	0x7000
+
+#define	INVALID_HANDLE_VALUE	0xffffffff
+
+struct mapi_batch_op {
+	struct EcDoRpc_MAPI_REQ	req;
+	mapi_object_t		*obj;		/* object the operation opens */
+	mapi_object_t		*released;	/* object the operation releases */
+	uint8_t			out_idx;
+	struct SPropTagArray	*properties;
+	struct SPropValue	**lpProps;
+	struct SRowSet		*rowSet;
+	uint32_t		*count;
+};
+
+struct mapi_batch {
+	struct mapi_session	*session;
+	TALLOC_CTX		*mem_ctx;
+	struct mapi_batch_op	*ops;
+	uint32_t		*handles;
+	uint32_t		count;
+	uint32_t		handle_count;
+	uint32_t		size;
+	enum MAPISTATUS		retval;
+};
+
+
+/**
+   \details Find if an object is opened by a ROP which has not been
+   sent yet
+
+   \param batch pointer to the batch context, may be NULL
+   \param obj pointer to the MAPI object
+
+   \return true if the object handle is not known yet, otherwise false
+ */
+bool mapi_batch_pending(struct mapi_batch *batch, mapi_object_t *obj)
+{
+	uint32_t	i;
+
+	if (!batch || !batch->count) return false;
+
+	for (i = 0; i < batch->count; i++) {
+		if (batch->ops[i].obj == obj) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/**
+   \details Return the index in the request handle table an object is
+   referred to with, adding its handle if needed
+
+   The most recent ROP opening the object wins so a mapi_object_t can
+   be reused within a batch.
+ */
+static uint8_t mapi_batch_handle_idx(struct mapi_batch *batch, mapi_object_t *obj)
+{
+	uint32_t	i;
+
+	for (i = batch->count; i > 0; i--) {
+		if (batch->ops[i - 1].obj == obj) {
+			return batch->ops[i - 1].out_idx;
+		}
+	}
+
+	batch->handles[batch->handle_count] = mapi_object_get_handle(obj);
+	return batch->handle_count++;
+}
+
+
+/**
+   \details Append a ROP to the batch of the session obj belongs to
+
+   The batch is sent first if the ROP would not fit in the request.
+
+   \param obj the object the operation applies to
+   \param opnum the ROP identifier
+   \param size the size of the ROP specific part of the request
+   \param obj_out the object the operation opens, NULL if none
+   \param op pointer on pointer to the queued operation
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+ */
+static enum MAPISTATUS mapi_batch_add(mapi_object_t *obj,
+				      uint8_t opnum,
+				      uint32_t size,
+				      mapi_object_t *obj_out,
+				      struct mapi_batch_op **op)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_session	*session;
+	struct mapi_batch	*batch;
+	struct mapi_batch_op	*new_op;
+	uint8_t			logon_id;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!obj, MAPI_E_INVALID_PARAMETER, NULL);
+	session = mapi_object_get_session(obj);
+	OPENCHANGE_RETVAL_IF(!session, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!session->batch, MAPI_E_NOT_INITIALIZED, NULL);
+
+	if ((retval = mapi_object_get_logon_id(obj, &logon_id)) != MAPI_E_SUCCESS)
+		return retval;
+
+	batch = session->batch;
+	if (batch->count == MAPI_BATCH_MAX_ROPS ||
+	    batch->handle_count + 2 > MAPI_BATCH_MAX_HANDLES ||
+	    batch->size + size + 3 > MAPI_BATCH_MAX_SIZE) {
+		mapi_batch_send(batch);
+	}
+
+	if (!batch->mem_ctx) {
+		batch->mem_ctx = talloc_named(batch, 0, "mapi_batch");
+		batch->ops = talloc_array(batch->mem_ctx, struct mapi_batch_op, MAPI_BATCH_MAX_ROPS);
+		batch->handles = talloc_array(batch->mem_ctx, uint32_t, MAPI_BATCH_MAX_HANDLES);
+		/* uint16_t length of the ROP buffer */
+		batch->size = 2;
+	}
+
+	new_op = &batch->ops[batch->count];
+	memset(new_op, 0, sizeof (struct mapi_batch_op));
+	new_op->req.opnum = opnum;
+	new_op->req.logon_id = logon_id;
+	new_op->req.handle_idx = mapi_batch_handle_idx(batch, obj);
+
+	if (obj_out) {
+		new_op->obj = obj_out;
+		new_op->out_idx = batch->handle_count;
+		batch->handles[batch->handle_count++] = INVALID_HANDLE_VALUE;
+
+		mapi_object_set_session(obj_out, session);
+		mapi_object_set_handle(obj_out, INVALID_HANDLE_VALUE);
+		mapi_object_set_logon_id(obj_out, logon_id);
+	}
+
+	batch->size += size + 3;
+	batch->count++;
+
+	*op = new_op;
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Return the next reply of a batch response
+
+   GetProps and QueryRows replies have no length and the NDR layer
+   hands them the rest of the response. Once such a reply has been
+   parsed, the following replies are pulled from what it left over.
+ */
+static struct EcDoRpc_MAPI_REPL *mapi_batch_next_repl(struct mapi_session *session,
+						      TALLOC_CTX *mem_ctx,
+						      struct mapi_response *mapi_response,
+						      uint32_t *idx,
+						      struct ndr_pull *tail)
+{
+	struct EcDoRpc_MAPI_REPL	*repl;
+	struct mapi_response		notification;
+
+	while (true) {
+		if (tail) {
+			if (tail->offset >= tail->data_size) return NULL;
+			repl = talloc_zero_array(mem_ctx, struct EcDoRpc_MAPI_REPL, 2);
+			if (ndr_pull_EcDoRpc_MAPI_REPL(tail, NDR_SCALARS, repl) != NDR_ERR_SUCCESS) {
+				return NULL;
+			}
+			if (repl->opnum == op_MAPI_Notify) {
+				memset(&notification, 0, sizeof (struct mapi_response));
+				notification.mapi_repl = repl;
+				OPENCHANGE_CHECK_NOTIFICATION(session, &notification);
+			}
+		} else {
+			if (!mapi_response->mapi_repl || !mapi_response->mapi_repl[*idx].opnum) {
+				return NULL;
+			}
+			repl = &mapi_response->mapi_repl[(*idx)++];
+		}
+
+		if (repl->opnum != op_MAPI_Notify && repl->opnum != op_MAPI_Pending) {
+			return repl;
+		}
+	}
+}
+
+
+/**
+   \details Return a NDR pull context on the end of a blob
+ */
+static struct ndr_pull *mapi_batch_tail(TALLOC_CTX *mem_ctx, DATA_BLOB *blob, uint32_t offset)
+{
+	struct ndr_pull	*ndr;
+	DATA_BLOB	remaining;
+
+	remaining.data = blob->data + offset;
+	remaining.length = (offset < blob->length) ? blob->length - offset : 0;
+
+	ndr = ndr_pull_init_blob(&remaining, mem_ctx);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+
+	return ndr;
+}
+
+
+/**
+   \details Store the result of a successful operation
+ */
+static void mapi_batch_op_reply(struct mapi_session *session,
+				TALLOC_CTX *mem_ctx,
+				struct mapi_batch_op *op,
+				struct EcDoRpc_MAPI_REPL *repl,
+				uint32_t *handles,
+				struct ndr_pull **tail)
+{
+	DATA_BLOB	*blob = NULL;
+	uint32_t	offset = 0;
+
+	if (op->obj && handles) {
+		mapi_object_set_handle(op->obj, handles[op->out_idx]);
+	}
+
+	switch (op->req.opnum) {
+	case op_MAPI_OpenMessage:
+		mapi_object_message_init(session, op->obj, &repl->u.mapi_OpenMessage);
+		break;
+	case op_MAPI_GetHierarchyTable:
+		if (op->count) {
+			*op->count = repl->u.mapi_GetHierarchyTable.RowCount;
+		}
+		break;
+	case op_MAPI_GetContentsTable:
+		if (op->count) {
+			*op->count = repl->u.mapi_GetContentsTable.RowCount;
+		}
+		break;
+	case op_MAPI_GetProps:
+		blob = &repl->u.mapi_GetProps.prop_data;
+		emsmdb_get_SPropValue_ex((TALLOC_CTX *)session, blob, op->properties,
+					 op->lpProps, op->count, repl->u.mapi_GetProps.layout, &offset);
+		break;
+	case op_MAPI_QueryRows:
+		op->rowSet->cRows = repl->u.mapi_QueryRows.RowCount;
+		op->rowSet->aRow = talloc_array((TALLOC_CTX *)session, struct SRow, op->rowSet->cRows);
+		if (op->rowSet->cRows) {
+			blob = &repl->u.mapi_QueryRows.RowData;
+			emsmdb_get_SRowSet_ex((TALLOC_CTX *)op->rowSet->aRow, op->rowSet,
+					      op->properties, blob, &offset);
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (blob) {
+		*tail = mapi_batch_tail(mem_ctx, blob, offset);
+	}
+}
+
+
+/**
+   \details Send the queued operations to the server
+
+   The first error met is kept in the batch until mapi_batch_flush()
+   or mapi_batch_end() reports it. Objects whose operation failed keep
+   an invalid handle.
+
+   \param batch pointer to the batch context, may be NULL
+ */
+void mapi_batch_send(struct mapi_batch *batch)
+{
+	struct mapi_session		*session;
+	struct mapi_request		*mapi_request;
+	struct mapi_response		*mapi_response = NULL;
+	struct EcDoRpc_MAPI_REQ		*mapi_req;
+	struct EcDoRpc_MAPI_REPL	*repl;
+	struct mapi_batch_op		*ops;
+	struct ndr_pull			*tail = NULL;
+	NTSTATUS			status;
+	enum MAPISTATUS			retval = MAPI_E_SUCCESS;
+	TALLOC_CTX			*mem_ctx;
+	uint32_t			count;
+	uint32_t			i;
+	uint32_t			j = 0;
+
+	if (!batch || !batch->count) return;
+
+	session = batch->session;
+	mem_ctx = batch->mem_ctx;
+	ops = batch->ops;
+	count = batch->count;
+
+	/* Fill the mapi_request structure */
+	mapi_req = talloc_array(mem_ctx, struct EcDoRpc_MAPI_REQ, count);
+	for (i = 0; i < count; i++) {
+		mapi_req[i] = ops[i].req;
+	}
+
+	mapi_request = talloc_zero(mem_ctx, struct mapi_request);
+	mapi_request->mapi_len = batch->size + sizeof (uint32_t) * batch->handle_count;
+	mapi_request->length = batch->size;
+	mapi_request->mapi_req = mapi_req;
+	mapi_request->handles = batch->handles;
+
+	/* Operations queued from here on go to a new request */
+	batch->mem_ctx = NULL;
+	batch->ops = NULL;
+	batch->handles = NULL;
+	batch->count = 0;
+	batch->handle_count = 0;
+	batch->size = 0;
+
+	status = emsmdb_transaction_wrapper(session, mem_ctx, mapi_request, &mapi_response);
+	if (!NT_STATUS_IS_OK(status) || !mapi_response) {
+		retval = MAPI_E_CALL_FAILED;
+	} else {
+		OPENCHANGE_CHECK_NOTIFICATION(session, mapi_response);
+	}
+
+	/* Demultiplex replies, Release has none */
+	for (i = 0; i < count; i++) {
+		if (ops[i].req.opnum == op_MAPI_Release) {
+			mapi_object_cleanup(ops[i].released);
+			continue;
+		}
+		if (retval == MAPI_E_CALL_FAILED) continue;
+
+		repl = mapi_batch_next_repl(session, mem_ctx, mapi_response, &j, tail);
+		if (!repl || repl->opnum != ops[i].req.opnum) {
+			DEBUG(1, ("mapi_batch_send: no reply for ROP 0x%x\n", ops[i].req.opnum));
+			retval = MAPI_E_CALL_FAILED;
+			continue;
+		}
+
+		if (repl->error_code != MAPI_E_SUCCESS) {
+			if (retval == MAPI_E_SUCCESS) {
+				retval = repl->error_code;
+			}
+			continue;
+		}
+
+		mapi_batch_op_reply(session, mem_ctx, &ops[i], repl, mapi_response->handles, &tail);
+	}
+
+	if (retval != MAPI_E_SUCCESS && batch->retval == MAPI_E_SUCCESS) {
+		batch->retval = retval;
+	}
+
+	if (mapi_response) {
+		talloc_free(mapi_response);
+	}
+	talloc_free(mem_ctx);
+}
+
+
+/**
+   \details Start queuing operations on a session
+
+   Until mapi_batch_end() is called, mapi_batch_* functions queue
+   their operation instead of sending it. Other libmapi functions can
+   still be called: the queued operations are sent first.
+
+   \param session pointer to the MAPI session
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \note Developers may also call GetLastError() to retrieve the last
+   MAPI error code. Possible MAPI error codes are:
+   - MAPI_E_INVALID_PARAMETER: session is undefined
+   - MAPI_E_BUSY: a batch is already started on this session
+
+   \sa mapi_batch_flush, mapi_batch_end
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_begin(struct mapi_session *session)
+{
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!session, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!session->emsmdb, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(session->batch, MAPI_E_BUSY, NULL);
+
+	session->batch = talloc_zero(session, struct mapi_batch);
+	OPENCHANGE_RETVAL_IF(!session->batch, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+	session->batch->session = session;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Send the queued operations and report their status
+
+   \param session pointer to the MAPI session
+
+   \return MAPI_E_SUCCESS if every operation sent since the batch
+   started or was last flushed succeeded, otherwise the error of the
+   first one which failed.
+
+   \sa mapi_batch_begin, mapi_batch_end
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_flush(struct mapi_session *session)
+{
+	enum MAPISTATUS	retval;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!session, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!session->batch, MAPI_E_NOT_INITIALIZED, NULL);
+
+	mapi_batch_send(session->batch);
+
+	retval = session->batch->retval;
+	session->batch->retval = MAPI_E_SUCCESS;
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Send the queued operations and stop batching
+
+   \param session pointer to the MAPI session
+
+   \return MAPI_E_SUCCESS on success, otherwise the error of the first
+   operation which failed.
+
+   \sa mapi_batch_begin, mapi_batch_flush
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_end(struct mapi_session *session)
+{
+	enum MAPISTATUS	retval;
+
+	retval = mapi_batch_flush(session);
+
+	if (session && session->batch) {
+		talloc_free(session->batch);
+		session->batch = NULL;
+	}
+
+	return retval;
+}
+
+
+/**
+   \details Queue an OpenFolder operation
+
+   \param obj_store the store to open the folder from, or any object
+   opened in the batch the folder belongs to
+   \param id_folder the folder identifier
+   \param obj_folder the resulting folder object
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa OpenFolder
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_OpenFolder(mapi_object_t *obj_store,
+					       mapi_id_t id_folder,
+					       mapi_object_t *obj_folder)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+
+	OPENCHANGE_RETVAL_IF(!obj_folder, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_add(obj_store, op_MAPI_OpenFolder, sizeof (uint8_t) + sizeof (uint64_t) + sizeof (uint8_t),
+				obj_folder, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op->req.u.mapi_OpenFolder.handle_idx = op->out_idx;
+	op->req.u.mapi_OpenFolder.folder_id = id_folder;
+	op->req.u.mapi_OpenFolder.OpenModeFlags = OpenModeFlags_Folder;
+
+	mapi_object_set_id(obj_folder, id_folder);
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue an OpenMessage operation
+
+   \param obj_store the store to read from
+   \param id_folder the folder ID
+   \param id_message the message ID
+   \param obj_message the resulting message object
+   \param ulFlags the open mode, see OpenMessage
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa OpenMessage
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_OpenMessage(mapi_object_t *obj_store,
+						mapi_id_t id_folder,
+						mapi_id_t id_message,
+						mapi_object_t *obj_message,
+						uint8_t ulFlags)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+
+	OPENCHANGE_RETVAL_IF(!obj_message, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_add(obj_store, op_MAPI_OpenMessage,
+				sizeof (uint8_t) + sizeof (uint16_t) + sizeof (mapi_id_t) + sizeof (uint8_t) + sizeof (mapi_id_t),
+				obj_message, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op->req.u.mapi_OpenMessage.handle_idx = op->out_idx;
+	op->req.u.mapi_OpenMessage.CodePageId = 0xfff;
+	op->req.u.mapi_OpenMessage.FolderId = id_folder;
+	op->req.u.mapi_OpenMessage.OpenModeFlags = (enum OpenMessage_OpenModeFlags)ulFlags;
+	op->req.u.mapi_OpenMessage.MessageId = id_message;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetHierarchyTable operation
+
+   \param obj_container the container to get the hierarchy table of
+   \param obj_table the resulting table object
+   \param TableFlags flags controlling the type of table
+   \param RowCount pointer to the number of rows in the table, set
+   once the batch is sent, may be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa GetHierarchyTable
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetHierarchyTable(mapi_object_t *obj_container,
+						      mapi_object_t *obj_table,
+						      uint8_t TableFlags,
+						      uint32_t *RowCount)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+
+	OPENCHANGE_RETVAL_IF(!obj_table, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_add(obj_container, op_MAPI_GetHierarchyTable, 2, obj_table, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op->req.u.mapi_GetHierarchyTable.handle_idx = op->out_idx;
+	op->req.u.mapi_GetHierarchyTable.TableFlags = TableFlags;
+	op->count = RowCount;
+
+	mapi_object_table_init((TALLOC_CTX *)obj_table->session, obj_table);
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetContentsTable operation
+
+   \param obj_container the container to get the contents table of
+   \param obj_table the resulting table object
+   \param TableFlags flags controlling the type of table
+   \param RowCount pointer to the number of rows in the table, set
+   once the batch is sent, may be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa GetContentsTable
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetContentsTable(mapi_object_t *obj_container,
+						     mapi_object_t *obj_table,
+						     uint8_t TableFlags,
+						     uint32_t *RowCount)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+
+	OPENCHANGE_RETVAL_IF(!obj_table, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_add(obj_container, op_MAPI_GetContentsTable, 2, obj_table, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op->req.u.mapi_GetContentsTable.handle_idx = op->out_idx;
+	op->req.u.mapi_GetContentsTable.TableFlags = TableFlags;
+	op->count = RowCount;
+
+	mapi_object_table_init((TALLOC_CTX *)obj_table->session, obj_table);
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetAttachmentTable operation
+
+   \param obj_message the message to get the attachment table of
+   \param obj_table the resulting table object
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa GetAttachmentTable
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetAttachmentTable(mapi_object_t *obj_message,
+						       mapi_object_t *obj_table)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+
+	OPENCHANGE_RETVAL_IF(!obj_table, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_add(obj_message, op_MAPI_GetAttachmentTable, 2, obj_table, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op->req.u.mapi_GetAttachmentTable.handle_idx = op->out_idx;
+	op->req.u.mapi_GetAttachmentTable.TableFlags = 0x0;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetProps operation
+
+   Unlike GetProps, named properties are not mapped: tags must
+   already hold the identifiers the server uses.
+
+   \param obj the object to get properties on
+   \param flags MAPI_UNICODE to get strings as UTF-16 on the wire
+   \param SPropTagArray an array of MAPI property tags
+   \param lpProps the result of the query, set once the batch is sent
+   \param PropCount the number of entries in lpProps
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa GetProps
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetProps(mapi_object_t *obj,
+					     uint32_t flags,
+					     struct SPropTagArray *SPropTagArray,
+					     struct SPropValue **lpProps,
+					     uint32_t *PropCount)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+	struct mapi_batch	*batch;
+
+	OPENCHANGE_RETVAL_IF(!SPropTagArray, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!lpProps || !PropCount, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_add(obj, op_MAPI_GetProps, 3 * sizeof (uint16_t) + SPropTagArray->cValues * sizeof (uint32_t),
+				NULL, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	/* Reply parsing may update the tags with PT_ERROR */
+	batch = obj->session->batch;
+	op->properties = talloc_zero(batch->mem_ctx, struct SPropTagArray);
+	op->properties->cValues = SPropTagArray->cValues;
+	op->properties->aulPropTag = talloc_memdup(op->properties, SPropTagArray->aulPropTag,
+						   SPropTagArray->cValues * sizeof (enum MAPITAGS));
+	op->lpProps = lpProps;
+	op->count = PropCount;
+
+	op->req.u.mapi_GetProps.PropertySizeLimit = 0x0;
+	op->req.u.mapi_GetProps.WantUnicode = (flags & MAPI_UNICODE) != 0 ? true : 0x0;
+	op->req.u.mapi_GetProps.prop_count = (uint16_t) SPropTagArray->cValues;
+	op->req.u.mapi_GetProps.properties = op->properties->aulPropTag;
+
+	*lpProps = NULL;
+	*PropCount = 0;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a SetColumns operation
+
+   The columns are recorded in the table object right away so that a
+   QueryRows can be queued after it.
+
+   \param obj_table the table to set the columns on
+   \param properties the properties intended to be columns
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa SetColumns
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_SetColumns(mapi_object_t *obj_table,
+					       struct SPropTagArray *properties)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+	mapi_object_table_t	*table;
+
+	OPENCHANGE_RETVAL_IF(!properties, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = mapi_batch_add(obj_table, op_MAPI_SetColumns, 3 + properties->cValues * sizeof (uint32_t),
+				NULL, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	if (obj_table->private_data == NULL) {
+		obj_table->private_data = talloc_zero((TALLOC_CTX *)obj_table->session, mapi_object_table_t);
+	}
+
+	table = (mapi_object_table_t *)obj_table->private_data;
+	talloc_free(table->proptags.aulPropTag);
+	table->proptags.cValues = properties->cValues;
+	table->proptags.aulPropTag = talloc_memdup((TALLOC_CTX *)table, properties->aulPropTag,
+						   properties->cValues * sizeof (enum MAPITAGS));
+
+	op->req.u.mapi_SetColumns.SetColumnsFlags = SetColumns_TBL_SYNC;
+	op->req.u.mapi_SetColumns.prop_count = properties->cValues;
+	op->req.u.mapi_SetColumns.properties = talloc_memdup(obj_table->session->batch->mem_ctx,
+							     properties->aulPropTag,
+							     properties->cValues * sizeof (enum MAPITAGS));
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a QueryRows operation
+
+   The rows are allocated on the session and should be freed with
+   MAPIFreeBuffer(rowSet->aRow) once used. Keep row_count small
+   enough for every reply of the batch to fit in the server response
+   buffer.
+
+   \param obj_table the table to read rows from
+   \param row_count the maximum number of rows to retrieve
+   \param flags flags to use for the query
+   \param rowSet the result of the query, set once the batch is sent
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa QueryRows
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_QueryRows(mapi_object_t *obj_table,
+					      uint16_t row_count,
+					      enum QueryRowsFlags flags,
+					      struct SRowSet *rowSet)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+	mapi_object_table_t	*table;
+
+	OPENCHANGE_RETVAL_IF(!obj_table || !rowSet, MAPI_E_INVALID_PARAMETER, NULL);
+
+	/* table contains mapitags from previous SetColumns */
+	table = (mapi_object_table_t *)obj_table->private_data;
+	OPENCHANGE_RETVAL_IF(!table || !table->proptags.cValues, MAPI_E_INVALID_OBJECT, NULL);
+
+	retval = mapi_batch_add(obj_table, op_MAPI_QueryRows, 4, NULL, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	/* Columns may change before the batch is sent */
+	op->properties = talloc_zero(obj_table->session->batch->mem_ctx, struct SPropTagArray);
+	op->properties->cValues = table->proptags.cValues;
+	op->properties->aulPropTag = talloc_memdup(op->properties, table->proptags.aulPropTag,
+						   table->proptags.cValues * sizeof (enum MAPITAGS));
+	op->rowSet = rowSet;
+
+	op->req.u.mapi_QueryRows.QueryRowsFlags = flags;
+	op->req.u.mapi_QueryRows.ForwardRead = 1;
+	op->req.u.mapi_QueryRows.RowCount = row_count;
+
+	rowSet->cRows = 0;
+	rowSet->aRow = NULL;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a Release operation
+
+   The object is reset, as mapi_object_release() does, once the batch
+   has been sent. It must not be used in the meantime.
+
+   \param obj the object to release
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa Release, mapi_object_release
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_Release(mapi_object_t *obj)
+{
+	enum MAPISTATUS		retval;
+	struct mapi_batch_op	*op;
+
+	retval = mapi_batch_add(obj, op_MAPI_Release, 0, NULL, &op);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	op->released = obj;
+
+	return MAPI_E_SUCCESS;
+}
@@ -29,6 +29,147 @@
    \brief mapi_nameid convenience API
 */
 
+#define	MAPI_NAMEID_INDEX_COUNT(positions)	(sizeof (positions) / sizeof (uint16_t))
+
+enum mapi_nameid_key {
+	MAPI_NAMEID_KEY_PROPTAG,
+	MAPI_NAMEID_KEY_LID,
+	MAPI_NAMEID_KEY_OOM,
+	MAPI_NAMEID_KEY_NAME
+};
+
+
+static int mapi_nameid_tags_cmp(const struct mapi_nameid_tags *entry,
+				enum mapi_nameid_key key, uint32_t id,
+				const char *str)
+{
+	switch (key) {
+	case MAPI_NAMEID_KEY_PROPTAG:
+		return (entry->proptag > id) - (entry->proptag < id);
+	case MAPI_NAMEID_KEY_LID:
+		return (entry->lid > id) - (entry->lid < id);
+	case MAPI_NAMEID_KEY_OOM:
+		return strcmp(entry->OOM, str);
+	case MAPI_NAMEID_KEY_NAME:
+		return strcmp(entry->Name, str);
+	}
+
+	return -1;
+}
+
+
+/**
+   \details Find the first mapi_nameid_tags entry matching a key and
+   OLEGUID
+
+   The generated index for the key lists entries sorted by key and
+   then by table position: the lower bound of the key is found with a
+   binary search and only the entries sharing the key are compared
+   against OLEGUID.
+
+   \param key the mapi_nameid_tags field to search
+   \param id the value searched for integer keys
+   \param str the value searched for string keys
+   \param OLEGUID the property set the entry belongs to, NULL for any
+
+   \return pointer to the entry on success, otherwise NULL
+ */
+static struct mapi_nameid_tags *mapi_nameid_tags_find(enum mapi_nameid_key key,
+						      uint32_t id, const char *str,
+						      const char *OLEGUID)
+{
+	const uint16_t		*positions;
+	uint32_t		count;
+	uint32_t		low;
+	uint32_t		high;
+	uint32_t		mid;
+	struct mapi_nameid_tags	*entry;
+
+	switch (key) {
+	case MAPI_NAMEID_KEY_PROPTAG:
+		positions = mapi_nameid_tags_by_proptag;
+		count = MAPI_NAMEID_INDEX_COUNT(mapi_nameid_tags_by_proptag);
+		break;
+	case MAPI_NAMEID_KEY_LID:
+		positions = mapi_nameid_tags_by_lid;
+		count = MAPI_NAMEID_INDEX_COUNT(mapi_nameid_tags_by_lid);
+		break;
+	case MAPI_NAMEID_KEY_OOM:
+		positions = mapi_nameid_tags_by_OOM;
+		count = MAPI_NAMEID_INDEX_COUNT(mapi_nameid_tags_by_OOM);
+		break;
+	case MAPI_NAMEID_KEY_NAME:
+		positions = mapi_nameid_tags_by_Name;
+		count = MAPI_NAMEID_INDEX_COUNT(mapi_nameid_tags_by_Name);
+		break;
+	default:
+		return NULL;
+	}
+
+	low = 0;
+	high = count;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (mapi_nameid_tags_cmp(&mapi_nameid_tags[positions[mid]], key, id, str) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	for (; low < count; low++) {
+		entry = &mapi_nameid_tags[positions[low]];
+		if (mapi_nameid_tags_cmp(entry, key, id, str)) {
+			break;
+		}
+		if (!OLEGUID || !strcmp(OLEGUID, entry->OLEGUID)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+   \details Append a mapi_nameid_tags entry to a mapi_nameid structure
+
+   \param mapi_nameid the structure where results are stored
+   \param entry the entry to add
+
+   \return MAPI_E_SUCCESS
+ */
+static enum MAPISTATUS mapi_nameid_entry_add(struct mapi_nameid *mapi_nameid,
+					     const struct mapi_nameid_tags *entry)
+{
+	uint16_t	count;
+
+	mapi_nameid->nameid = talloc_realloc(mapi_nameid,
+					     mapi_nameid->nameid, struct MAPINAMEID,
+					     mapi_nameid->count + 1);
+	mapi_nameid->entries = talloc_realloc(mapi_nameid,
+					      mapi_nameid->entries, struct mapi_nameid_tags,
+					      mapi_nameid->count + 1);
+	count = mapi_nameid->count;
+
+	mapi_nameid->entries[count] = *entry;
+
+	mapi_nameid->nameid[count].ulKind = (enum ulKind) entry->ulKind;
+	GUID_from_string(entry->OLEGUID, &(mapi_nameid->nameid[count].lpguid));
+	switch (entry->ulKind) {
+	case MNID_ID:
+		mapi_nameid->nameid[count].kind.lid = entry->lid;
+		break;
+	case MNID_STRING:
+		mapi_nameid->nameid[count].kind.lpwstr.Name = entry->Name;
+		mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(entry->Name);
+		break;
+	}
+	mapi_nameid->count++;
+
+	return MAPI_E_SUCCESS;
+}
+
 
 /**
    \details Create a new mapi_nameid structure
@@ -81,46 +222,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_add(struct mapi_nameid *mapi_nameid,
 					     const char *OOM,
 					     const char *OLEGUID)
 {
-	uint32_t		i;
-	uint16_t		count;
+	struct mapi_nameid_tags	*entry;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM &&
-		    !strcmp(OOM, mapi_nameid_tags[i].OOM) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind)mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_tags_find(MAPI_NAMEID_KEY_OOM, 0, OOM, OLEGUID);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	return mapi_nameid_entry_add(mapi_nameid, entry);
 }
 
 
@@ -147,45 +261,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_add(struct mapi_nameid *mapi_nameid,
 _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_add(struct mapi_nameid *mapi_nameid,
 					     uint16_t lid, const char *OLEGUID)
 {
-	uint32_t		i;
-	uint16_t		count;
+	struct mapi_nameid_tags	*entry;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if ((lid == mapi_nameid_tags[i].lid) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_tags_find(MAPI_NAMEID_KEY_LID, lid, NULL, OLEGUID);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	return mapi_nameid_entry_add(mapi_nameid, entry);
 }
 
 
@@ -213,46 +301,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_add(struct mapi_nameid *mapi_nameid,
 						const char *Name,
 						const char *OLEGUID)
 {
-	uint32_t		i;
-	uint16_t		count;
+	struct mapi_nameid_tags	*entry;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(Name, mapi_nameid_tags[i].Name) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_tags_find(MAPI_NAMEID_KEY_NAME, 0, Name, OLEGUID);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	return mapi_nameid_entry_add(mapi_nameid, entry);
 }
 
 /**
@@ -380,43 +441,18 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_custom_string_add(struct mapi_nameid *mapi_
 _PUBLIC_ enum MAPISTATUS mapi_nameid_canonical_add(struct mapi_nameid *mapi_nameid,
 						   uint32_t proptag)
 {
-	uint32_t	i;
-	uint16_t	count;
+	struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!proptag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							      mapi_nameid->entries, struct mapi_nameid_tags,
-							      mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_tags_find(MAPI_NAMEID_KEY_PROPTAG, proptag, NULL, NULL);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	return mapi_nameid_entry_add(mapi_nameid, entry);
 }
 
 
@@ -430,12 +466,8 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_canonical_add(struct mapi_nameid *mapi_name
  */
 _PUBLIC_ enum MAPISTATUS mapi_nameid_property_lookup(uint32_t proptag)
 {
-	uint32_t	i;
-
-	for (i = 0; mapi_nameid_tags[i].proptag; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			return MAPI_E_SUCCESS;
-		}
+	if (proptag && mapi_nameid_tags_find(MAPI_NAMEID_KEY_PROPTAG, proptag, NULL, NULL)) {
+		return MAPI_E_SUCCESS;
 	}
 
 	return MAPI_E_NOT_FOUND;
@@ -460,22 +492,17 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_property_lookup(uint32_t proptag)
 _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_lookup(const char *OOM, const char *OLEGUID,
 						uint16_t *propType)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM &&
-		    !strcmp(mapi_nameid_tags[i].OOM, OOM) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	entry = mapi_nameid_tags_find(MAPI_NAMEID_KEY_OOM, 0, OOM, OLEGUID);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_NOT_FOUND, NULL);
 
-	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
+	*propType = entry->propType;
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -497,21 +524,17 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_lookup(const char *OOM, const char *OLE
 _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup(uint16_t lid, const char *OLEGUID,
 						uint16_t *propType)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	entry = mapi_nameid_tags_find(MAPI_NAMEID_KEY_LID, lid, NULL, OLEGUID);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_NOT_FOUND, NULL);
 
-	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
+	*propType = entry->propType;
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -533,22 +556,18 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup(uint16_t lid, const char *OLEGUI
 _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup_canonical(uint16_t lid, const char *OLEGUID,
 							  uint32_t *propTag)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	entry = mapi_nameid_tags_find(MAPI_NAMEID_KEY_LID, lid, NULL, OLEGUID);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_NOT_FOUND, NULL);
 
-	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
+	*propTag = entry->proptag;
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -571,22 +590,17 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup(const char *Name,
 						   const char *OLEGUID,
 						   uint16_t *propType)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	entry = mapi_nameid_tags_find(MAPI_NAMEID_KEY_NAME, 0, Name, OLEGUID);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_NOT_FOUND, NULL);
 
-	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
+	*propType = entry->propType;
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -609,23 +623,18 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup_canonical(const char *Name,
 							     const char *OLEGUID,
 							     uint32_t *propTag)
 {
-	uint32_t	i;
+	struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	entry = mapi_nameid_tags_find(MAPI_NAMEID_KEY_NAME, 0, Name, OLEGUID);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_NOT_FOUND, NULL);
 
-	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
+	*propTag = entry->proptag;
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -966,34 +975,77 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_GetIDsFromNames(struct mapi_nameid *mapi_na
 	return retval;
 }
 
+/**
+   \details Return the first mapi_nameid_names_by_proptag position
+   whose property tag is not lower than proptag
+ */
+static uint32_t mapi_nameid_names_lower_bound(uint32_t proptag)
+{
+	uint32_t	low = 0;
+	uint32_t	high = MAPI_NAMEID_INDEX_COUNT(mapi_nameid_names_by_proptag);
+	uint32_t	mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (mapi_nameid_names[mapi_nameid_names_by_proptag[mid]].proptag < proptag) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static const char *mapi_nameid_names_name(uint32_t proptag)
+{
+	uint32_t	idx;
+
+	idx = mapi_nameid_names_lower_bound(proptag);
+	if (idx < MAPI_NAMEID_INDEX_COUNT(mapi_nameid_names_by_proptag) &&
+	    mapi_nameid_names[mapi_nameid_names_by_proptag[idx]].proptag == proptag) {
+		return mapi_nameid_names[mapi_nameid_names_by_proptag[idx]].propname;
+	}
+
+	return NULL;
+}
+
 _PUBLIC_ const char *get_namedid_name(uint32_t proptag)
 {
-	uint32_t idx;
+	const char	*propname;
 
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (mapi_nameid_names[idx].proptag == proptag) {
-			return mapi_nameid_names[idx].propname;
-		}
+	propname = mapi_nameid_names_name(proptag);
+	if (propname) {
+		return propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
-		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (mapi_nameid_names[idx].proptag == proptag) {
-			return mapi_nameid_names[idx].propname;
-		}
+		/* try as _UNICODE variant */
+		return mapi_nameid_names_name(proptag + 1);
 	}
 	return NULL;
 }
 
 _PUBLIC_ uint32_t get_namedid_value(const char *propname)
 {
-	uint32_t idx;
+	uint32_t	low = 0;
+	uint32_t	high = MAPI_NAMEID_INDEX_COUNT(mapi_nameid_names_by_propname);
+	uint32_t	mid;
+	int		ret;
+
+	if (!propname) {
+		return 0;
+	}
 
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (!strcmp(mapi_nameid_names[idx].propname, propname)) {
-			return mapi_nameid_names[idx].proptag;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		ret = strcmp(mapi_nameid_names[mapi_nameid_names_by_propname[mid]].propname, propname);
+		if (ret == 0) {
+			return mapi_nameid_names[mapi_nameid_names_by_propname[mid]].proptag;
+		} else if (ret < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
 
@@ -1003,16 +1055,24 @@ _PUBLIC_ uint32_t get_namedid_value(const char *propname)
 _PUBLIC_ uint16_t get_namedid_type(uint16_t untypedtag)
 {
 	uint32_t	idx;
+	uint32_t	count = MAPI_NAMEID_INDEX_COUNT(mapi_nameid_names_by_proptag);
+	uint32_t	found = count;
 	uint16_t	current_type;
 
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if ((mapi_nameid_names[idx].proptag >> 16) == untypedtag) {
-			current_type = mapi_nameid_names[idx].proptag & 0xFFFF;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
+	/* All the types of a property id are adjacent in the proptag
+	 * index. The one coming first in the table is returned. */
+	for (idx = mapi_nameid_names_lower_bound((uint32_t)untypedtag << 16);
+	     idx < count && (mapi_nameid_names[mapi_nameid_names_by_proptag[idx]].proptag >> 16) == untypedtag;
+	     idx++) {
+		current_type = mapi_nameid_names[mapi_nameid_names_by_proptag[idx]].proptag & 0xFFFF;
+		if (current_type != PT_ERROR && current_type != PT_STRING8 &&
+		    mapi_nameid_names_by_proptag[idx] < found) {
+			found = mapi_nameid_names_by_proptag[idx];
 		}
 	}
+	if (found < count) {
+		return mapi_nameid_names[found].proptag & 0xFFFF;
+	}
 
 	DEBUG(5, ("%s: type for property '%x' could not be deduced\n", __FUNCTION__, untypedtag));
 	return 0;
@@ -92,13 +92,29 @@ _PUBLIC_ void mapi_object_release(mapi_object_t *obj)
 	enum MAPISTATUS retval;
 
 	if (!obj) return;
-	if (obj->handle == INVALID_HANDLE_VALUE) return;
+	if (mapi_object_get_handle(obj) == INVALID_HANDLE_VALUE) return;
 
 	retval = Release(obj);
 	if (retval != MAPI_E_SUCCESS) {
 		DEBUG(1, ("Release has failed"));
 	}
 
+	mapi_object_cleanup(obj);
+}
+
+
+/**
+   \details Free the data associated to a MAPI object whose server
+   handle has already been released
+
+   \param obj pointer on the MAPI object to clean up
+
+   \sa mapi_object_release, mapi_batch_Release
+ */
+void mapi_object_cleanup(mapi_object_t *obj)
+{
+	if (!obj) return;
+
 	if (obj->private_data) {
 		talloc_free(obj->private_data);
 	}
@@ -269,7 +285,15 @@ _PUBLIC_ void mapi_object_set_logon_store(mapi_object_t *obj)
  */
 mapi_handle_t mapi_object_get_handle(mapi_object_t *obj)
 {
-	return (!obj) ? 0xFFFFFFFF : obj->handle;
+	if (!obj) return 0xFFFFFFFF;
+
+	/* Objects opened in a batch get their handle once it is sent */
+	if (obj->handle == INVALID_HANDLE_VALUE && obj->session &&
+	    mapi_batch_pending(obj->session->batch, obj)) {
+		mapi_batch_send(obj->session->batch);
+	}
+
+	return obj->handle;
 }
 
 
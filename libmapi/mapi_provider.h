@@ -44,6 +44,8 @@ struct mapi_objects {
 	struct mapi_objects	*next;
 };
 
+struct mapi_batch;
+
 struct mapi_session {
 	struct mapi_provider		*emsmdb;
 	struct mapi_provider		*nspi;
@@ -51,6 +53,7 @@ struct mapi_session {
 	struct mapi_notify_ctx		*notify_ctx;
 	struct mapi_objects		*objects;
 	struct mapi_context		*mapi_ctx;
+	struct mapi_batch		*batch;
 	uint8_t				logon_ids[255];
 
 	struct mapi_session		*next;
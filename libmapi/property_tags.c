@@ -11,7 +11,8 @@ struct mapi_proptags
 	const char	*propname;
 };
 
-static struct mapi_proptags canonical_property_tags[] = {
+/* Sorted by property name */
+static const struct mapi_proptags canonical_property_tags[] = {
 	{ PidTagAccess,                                                       PT_LONG,      "PidTagAccess"                                                      },
 	{ PidTagAccessControlListData,                                        PT_BINARY,    "PidTagAccessControlListData"                                       },
 	{ PidTagAccessControlListData_Error,                                  PT_ERROR,     "PidTagAccessControlListData_Error"                                 },
@@ -1155,90 +1156,235 @@ static struct mapi_proptags canonical_property_tags[] = {
 	{ PidTagWlinkStoreEntryId_Error,                                      PT_ERROR,     "PidTagWlinkStoreEntryId_Error"                                     },
 	{ PidTagWlinkType,                                                    PT_LONG,      "PidTagWlinkType"                                                   },
 	{ PidTagWlinkType_Error,                                              PT_ERROR,     "PidTagWlinkType_Error"                                             },
-	{ openchange_private_ROOT_FOLDER_FID,		PT_I8, "openchange_private_ROOT_FOLDER_FID" },
-	{ openchange_private_DEFERRED_ACTIONS_FID,	PT_I8, "openchange_private_DEFERRED_ACTIONS_FID" },
-	{ openchange_private_SPOOLER_QUEUE_FID,		PT_I8, "openchange_private_SPOOLER_QUEUE_FID" },
-	{ openchange_private_IPM_SUBTREE_FID,		PT_I8, "openchange_private_IPM_SUBTREE_FID" },
-	{ openchange_private_INBOX_FID,			PT_I8, "openchange_private_INBOX_FID" },
-	{ openchange_private_OUTBOX_FID,		PT_I8, "openchange_private_OUTBOX_FID" },
-	{ openchange_private_SENT_ITEMS_FID,		PT_I8, "openchange_private_SENT_ITEMS_FID" },
-	{ openchange_private_DELETED_ITEMS_FID,		PT_I8, "openchange_private_DELETED_ITEMS_FID" },
-	{ openchange_private_COMMON_VIEWS_FID,		PT_I8, "openchange_private_COMMON_VIEWS_FID" },
-	{ openchange_private_SCHEDULE_FID,		PT_I8, "openchange_private_SCHEDULE_FID" },
-	{ openchange_private_SEARCH_FID,		PT_I8, "openchange_private_SEARCH_FID" },
-	{ openchange_private_VIEWS_FID,			PT_I8, "openchange_private_VIEWS_FID" },
-	{ openchange_private_SHORTCUTS_FID,		PT_I8, "openchange_private_SHORTCUTS_FID" },
-	{ openchange_private_MailboxGUID,		PT_CLSID, "openchange_private_MailboxGUID" },
-	{ openchange_private_ReplicaID,			PT_SHORT, "openchange_private_ReplicaID" },
-	{ openchange_private_ReplicaGUID,		PT_CLSID, "openchange_private_ReplicaGUID" },
-	{ openchange_private_CONTACT_FID,		PT_I8, "openchange_private_CONTACT_FID" },
-	{ openchange_private_CALENDAR_FID,		PT_I8, "openchange_private_CALENDAR_FID" },
-	{ openchange_private_JOURNAL_FID,		PT_I8, "openchange_private_JOURNAL_FID" },
-	{ openchange_private_NOTE_FID,			PT_I8, "openchange_private_NOTE_FID" },
-	{ openchange_private_TASK_FID,			PT_I8, "openchange_private_TASK_FID" },
-	{ openchange_private_DRAFTS_FID,		PT_I8, "openchange_private_DRAFTS_FID" },
-	{ openchange_private_PF_ROOT,			PT_I8, "openchange_private_PF_ROOT" },
-	{ openchange_private_PF_IPM_SUBTREE,		PT_I8, "openchange_private_PF_IPM_SUBTREE" },
-	{ openchange_private_PF_NONIPM_SUBTREE,		PT_I8, "openchange_private_PF_NONIPM_SUBTREE" },
-	{ openchange_private_PF_EFORMS,			PT_I8, "openchange_private_PF_EFORMS" },
-	{ openchange_private_PF_FREEBUSY,		PT_I8, "openchange_private_PF_FREEBUSY" },
-	{ openchange_private_PF_OAB,			PT_I8, "openchange_private_PF_OAB" },
-	{ openchange_private_PF_LOCAL_EFORMS,		PT_I8, "openchange_private_PF_LOCAL_EFORMS" },
-	{ openchange_private_PF_LOCAL_FREEBUSY,		PT_I8, "openchange_private_PF_LOCAL_FREEBUSY" },
-	{ openchange_private_PF_LOCAL_OAB,		PT_I8, "openchange_private_PF_LOCAL_OAB" },
-	{ 0,                                                                  0,            "NULL"                                                              }
+	{ openchange_private_CALENDAR_FID,                                    PT_I8,        "openchange_private_CALENDAR_FID"                                   },
+	{ openchange_private_COMMON_VIEWS_FID,                                PT_I8,        "openchange_private_COMMON_VIEWS_FID"                               },
+	{ openchange_private_CONTACT_FID,                                     PT_I8,        "openchange_private_CONTACT_FID"                                    },
+	{ openchange_private_DEFERRED_ACTIONS_FID,                            PT_I8,        "openchange_private_DEFERRED_ACTIONS_FID"                           },
+	{ openchange_private_DELETED_ITEMS_FID,                               PT_I8,        "openchange_private_DELETED_ITEMS_FID"                              },
+	{ openchange_private_DRAFTS_FID,                                      PT_I8,        "openchange_private_DRAFTS_FID"                                     },
+	{ openchange_private_INBOX_FID,                                       PT_I8,        "openchange_private_INBOX_FID"                                      },
+	{ openchange_private_IPM_SUBTREE_FID,                                 PT_I8,        "openchange_private_IPM_SUBTREE_FID"                                },
+	{ openchange_private_JOURNAL_FID,                                     PT_I8,        "openchange_private_JOURNAL_FID"                                    },
+	{ openchange_private_MailboxGUID,                                     PT_CLSID,     "openchange_private_MailboxGUID"                                    },
+	{ openchange_private_NOTE_FID,                                        PT_I8,        "openchange_private_NOTE_FID"                                       },
+	{ openchange_private_OUTBOX_FID,                                      PT_I8,        "openchange_private_OUTBOX_FID"                                     },
+	{ openchange_private_PF_EFORMS,                                       PT_I8,        "openchange_private_PF_EFORMS"                                      },
+	{ openchange_private_PF_FREEBUSY,                                     PT_I8,        "openchange_private_PF_FREEBUSY"                                    },
+	{ openchange_private_PF_IPM_SUBTREE,                                  PT_I8,        "openchange_private_PF_IPM_SUBTREE"                                 },
+	{ openchange_private_PF_LOCAL_EFORMS,                                 PT_I8,        "openchange_private_PF_LOCAL_EFORMS"                                },
+	{ openchange_private_PF_LOCAL_FREEBUSY,                               PT_I8,        "openchange_private_PF_LOCAL_FREEBUSY"                              },
+	{ openchange_private_PF_LOCAL_OAB,                                    PT_I8,        "openchange_private_PF_LOCAL_OAB"                                   },
+	{ openchange_private_PF_NONIPM_SUBTREE,                               PT_I8,        "openchange_private_PF_NONIPM_SUBTREE"                              },
+	{ openchange_private_PF_OAB,                                          PT_I8,        "openchange_private_PF_OAB"                                         },
+	{ openchange_private_PF_ROOT,                                         PT_I8,        "openchange_private_PF_ROOT"                                        },
+	{ openchange_private_ROOT_FOLDER_FID,                                 PT_I8,        "openchange_private_ROOT_FOLDER_FID"                                },
+	{ openchange_private_ReplicaGUID,                                     PT_CLSID,     "openchange_private_ReplicaGUID"                                    },
+	{ openchange_private_ReplicaID,                                       PT_SHORT,     "openchange_private_ReplicaID"                                      },
+	{ openchange_private_SCHEDULE_FID,                                    PT_I8,        "openchange_private_SCHEDULE_FID"                                   },
+	{ openchange_private_SEARCH_FID,                                      PT_I8,        "openchange_private_SEARCH_FID"                                     },
+	{ openchange_private_SENT_ITEMS_FID,                                  PT_I8,        "openchange_private_SENT_ITEMS_FID"                                 },
+	{ openchange_private_SHORTCUTS_FID,                                   PT_I8,        "openchange_private_SHORTCUTS_FID"                                  },
+	{ openchange_private_SPOOLER_QUEUE_FID,                               PT_I8,        "openchange_private_SPOOLER_QUEUE_FID"                              },
+	{ openchange_private_TASK_FID,                                        PT_I8,        "openchange_private_TASK_FID"                                       },
+	{ openchange_private_VIEWS_FID,                                       PT_I8,        "openchange_private_VIEWS_FID"                                      },
 };
 
-_PUBLIC_ const char *get_proptag_name(uint32_t proptag)
+/* canonical_property_tags positions sorted by property tag */
+static const uint16_t canonical_property_tags_by_tag[] = {
+	1068, 1067,  145,  144,  217,  960,  216,  959,  219,  218,  315,  314,
+	 333,  332,  369,  368,  463,  464,  562,  561,  676,  675,  706,  705,
+	 727,  728,  751,  750,  758,  757,  798,  797,  659,  660,  824,  823,
+	 836,  835,  840,  839, 1005, 1006, 1052, 1049,  261,  260,  832,  831,
+	1020, 1019, 1051, 1050,  764,  763,  766,  765, 1014, 1013, 1018, 1017,
+	 776,  775,  778,  777,  830,  829,  747,  746,  586,  585,  672,  671,
+	 646,  645,  632,  631,  634,  633,  674,  673,  816,  815,  818,  817,
+	 768,  767,  780,  779,  753,  752,  834,  833,  636,  635,  588,  587,
+	 560,  559,  576,  575,  656,  655,  654,  653,  658,  657,  668,  667,
+	 666,  665,  670,  669, 1036, 1033,  355,  354,  697,  698,  846,  845,
+	1010, 1009, 1012, 1011,  650,  649,  652,  651,  662,  661,  664,  663,
+	 295,  294,  293,  290,  638,  637,  640,  639,  642,  641,  760,  759,
+	 762,  761,  772,  771,  774,  773, 1084, 1083, 1078, 1077,  828,  825,
+	 827,  826,  126,  127,  131,  130,  605,  606,  603,  604,  678,  677,
+	 803,  804,  820,  819,  994,  993,  998,  997, 1054, 1053, 1000,  999,
+	 990,  989,  992,  991,  607,  608,  812,  811,  327,  326,  339,  338,
+	 341,  340,  347,  346,  566,  565,  569,  570,  579,  581,  582,  580,
+	 702,  701,  848,  847,  578,  577,  558,  557,  583,  584,  422,  421,
+	 610,  609,  870,  869,  198,  199,  188,  189,  724,  723,  600,  599,
+	1079, 1080, 1060, 1059, 1058, 1057,  756,  741,  982,  981, 1085, 1086,
+	 365,  364,  375,  374,  377,  376,  378,  379,    0,    5,  863,  864,
+	 476,  475,    3,    4,  548,  547,  806,  805, 1040, 1039,  611,  612,
+	 357,  356,  233,  226,  838,  837,  868,  867,  232,  454,  231,  453,
+	 230,  229,  228,  227,  597,  598,  484,  483,  486,  485,  468,  467,
+	 526,  525,  528,  527,  530,  529,  648,  647,  461,  462,  521,  522,
+	 524,  523,  384,  385,  383,  382,  395,  396,  224,  225,  460,  459,
+	 456,  455,  251,  250,  458,  457,  213,  212,  215,  214,  865,  866,
+	 345,  342,  143,  142,  353,  352,  265,  264,  336,  337,  299,  298,
+	 516,  515,  980,  979, 1062, 1061,  289,  288,  292,  291,  153,  152,
+	 712,  711,  853,  854, 1035, 1034,  850,  849,  851,  852,  150,  151,
+	 149,  148, 1043, 1044, 1041, 1042,  278,  279,  393,  394,  282,  283,
+	 286,  287,  984,  983, 1048, 1047,  147,  146,  281,  280,  277,  276,
+	 389,  388,  275,  274,  488,  487,  490,  489,  494,  493,  496,  495,
+	 498,  497,  810,  809,  492,  491,   11,    8,   10,    9,  373,  372,
+	 627,  628,  400,  399,  311,  310,  169,  171,  170,  168,  173,  172,
+	 175,  174,  177,  176,  184,  185,  181,  180,  191,  190,  197,  196,
+	 201,  200,  813,  814,  203,  202,  183,  182,  187,  186,  161,  160,
+	 163,  162,  165,  164,  167,  166,  178,  179,  195,  194,  193,  192,
+	1072, 1071,  348,  351, 1070, 1069,  349,  350, 1024, 1023,   19,   18,
+	   7,    6,  247,  246,  416,  415,  418,  417,  420,  419,  243,  242,
+	 452,  451,  472,  471,  512,  511,  514,  513,  540,  539,  572,  571,
+	 630,  629, 1056, 1055,  644,  643,  716,  715,  269,  268, 1076, 1075,
+	 335,  334,  614,  613,  726,  725,  235,  237,  234,  236,  596,  595,
+	 740,  739,  249,  248,  694,  693, 1082, 1081,  700,  699, 1088, 1087,
+	 722,  721,  239,  238,  450,  449,  297,  296,  538,  537, 1038, 1037,
+	1046, 1045,  718,  717,  714,  713, 1066, 1065,  500,  499,  156,  155,
+	 434,  436,  433,  435,  157,  154,  988,  987, 1108, 1107,  223,  222,
+	 432,  431,  592,  591,  344,  343,  732,  731,  808,  807, 1032, 1031,
+	 271,  270,  305,  304, 1064, 1063,  410,  409,  413,  414,  546,  545,
+	 602,  601,  710,  709,  241,  240,  267,  266,  257,  256,  438,  437,
+	 440,  439,  444,  443,  446,  445,  448,  447,  442,  441,  682,  681,
+	 684,  683,  688,  687,  690,  689,  692,  691,  686,  685, 1092, 1091,
+	 985,  986,  469,  470,  479,  480,  220,  221,    2,    1,  325,  324,
+	 843,  844,  424,  423,  316,  317,  320,  321,  366,  367,  370,  371,
+	 319,  318,  273,  272,  573,  574,  303,  302,  301,  300,  520,  519,
+	 518,  517,  563,  564, 1015, 1016,  743,  742,  745,  744,  749,  748,
+	 284,  285,  995,  996,  738,  737,  481,  482,  567,  568, 1002, 1001,
+	1022, 1021,  755,  754,  770,  769,  782,  781,  789,  790,  796,  791,
+	 795,  794,  793,  792,  784,  783,  786,  785,  801,  800,  787,  788,
+	 799,  802,  503,  504,  509,  510,  505,  506,  501,  502,  508,  507,
+	 594,  593,  822,  821, 1028, 1027,  708,  707,  253,  252,  720,  719,
+	 899,  900,  901,  902,  896,  893,  892,  891,  889,  890,  895,  894,
+	 897,  898, 1090, 1089,  542,  541,  544,  543,  696,  695,  958,  957,
+	 390,  855,  856,  428,  427,   33,   32,  429,  430,  259,  258,  309,
+	 308,  307,  306,  879,  880,  873,  874,  426,  425,  871,  872,  882,
+	 881,  733,  734,  466,  465,  549,  550,  735,  736,  552,  551,  554,
+	 553,  555,  556,  884,  883,  886,  885,  909,  910,  911,  912,  913,
+	 914,  878,  877,  876,  875,  908,  905,  904,  903,  887,  888,  907,
+	 906,  331,  330,  535,  536,  262,  263,   85,   84, 1025, 1026,  534,
+	 531,  533,  532,  328,  329,  387,  386, 1008, 1007,  313,  312,  392,
+	 391,  704,  703,  590,  589,  474,  473,  477,  478,   93,   92,  255,
+	 254,  159,  158,  622,  621,  623, 1103,  624, 1104,  616,  916, 1004,
+	 615, 1003,  915,  619,  620, 1106, 1105,  380,  381,  618,  617,  626,
+	1102, 1101,  625,  245,  244,  842,  841,  969,  970,  965,  966,  955,
+	 977,  956,  978,  928,  968, 1126,  927, 1125,  967,  936,  935,  926,
+	 972,  971,  923,  922,  962,  961,  921,  973,  412,  974,  411,  405,
+	 975, 1135,  406,  976, 1136,  403,  963,  404,  964, 1141,  402, 1142,
+	 401, 1119,  925, 1120,  924,  930, 1130,  929, 1129, 1118, 1117, 1134,
+	1133, 1140, 1139,  952, 1122, 1121,  951,  943, 1124, 1123,  942,  954,
+	1128, 1127,  953, 1137,  945, 1138,  944, 1113,  950, 1114,  949,  941,
+	1110, 1109,  940,  948,  947,  939,  938,  408,  407,  397,  398,  918,
+	 917,  323,  322,  946,  937,  920,  919,  934,  933,  932,  931, 1116,
+	1115, 1112, 1111, 1131, 1132, 1094, 1093, 1098, 1097, 1096, 1095, 1099,
+	1100,  857,  858,  860,  859,  862,  861,  680,  679,  730,  729,  361,
+	 360,  210,  211,  363,  362,  359,  358,  206,  207,  209,  208,  205,
+	 204,   65,   64,   88,   89,   86,   87,   79,   78,   83,   82,   91,
+	  90,  107,  104,  125,  124,  121,  120,  137,  136,  123,  122,  106,
+	 105,   47,   34,   49,   48,   51,   50,   53,   52,   55,   54,   57,
+	  56,   59,   58,   61,   60,   63,   62,   36,   35,   99,   98,   16,
+	  17,   27,   26,   97,   96,   38,   37,   40,   39,   42,   41,   44,
+	  43,   46,   45,  141,  140,  101,  100,  117,  116,  119,  118,  113,
+	 112,  111,  110,  115,  114,   20,   21,   77,   76,  129,  128,   69,
+	  68,   75,   74,   73,   72,   67,   66, 1074, 1073,  134,  135,  103,
+	 102,  133,  132,   95,   94, 1030, 1029,   13,   12,  139,  138,   29,
+	  28,   31,   30,   71,   70,   24,   25,   22,   23, 1164, 1146, 1171,
+	1150, 1149, 1154, 1169, 1147, 1144, 1167, 1168, 1173, 1170, 1152, 1166,
+	1165, 1145, 1143, 1151, 1153, 1172, 1148, 1163, 1157, 1161, 1155, 1156,
+	1162, 1158, 1159, 1160,   81,   80,  109,  108,   14,   15,
+};
+
+#define	CANONICAL_PROPERTY_TAGS_COUNT	(sizeof (canonical_property_tags_by_tag) / sizeof (uint16_t))
+
+/**
+   \details Return the first canonical_property_tags_by_tag position
+   whose property tag is not lower than proptag
+ */
+static uint32_t canonical_property_tags_lower_bound(uint32_t proptag)
 {
-	uint32_t idx;
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (canonical_property_tags[canonical_property_tags_by_tag[mid]].proptag < proptag) {
+			low = mid + 1;
+		} else {
+			high = mid;
 		}
 	}
+
+	return low;
+}
+
+static const char *canonical_property_tags_name(uint32_t proptag)
+{
+	uint32_t	idx;
+
+	idx = canonical_property_tags_lower_bound(proptag);
+	if (idx < CANONICAL_PROPERTY_TAGS_COUNT &&
+	    canonical_property_tags[canonical_property_tags_by_tag[idx]].proptag == proptag) {
+		return canonical_property_tags[canonical_property_tags_by_tag[idx]].propname;
+	}
+
+	return NULL;
+}
+
+static int canonical_property_tags_cmp(const void *propname, const void *entry)
+{
+	return strcmp((const char *) propname, ((const struct mapi_proptags *) entry)->propname);
+}
+
+_PUBLIC_ const char *get_proptag_name(uint32_t proptag)
+{
+	const char	*propname;
+
+	propname = canonical_property_tags_name(proptag);
+	if (propname) {
+		return propname;
+	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
-		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+		/* try as _UNICODE variant */
+		return canonical_property_tags_name(proptag + 1);
 	}
 	return NULL;
 }
 
 _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
-	uint32_t idx;
+	const struct mapi_proptags	*entry;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
-		}
+	if (!propname) {
+		return 0;
 	}
 
-	return 0;
+	entry = bsearch(propname, canonical_property_tags, CANONICAL_PROPERTY_TAGS_COUNT,
+			sizeof (struct mapi_proptags), canonical_property_tags_cmp);
+
+	return entry ? entry->proptag : 0;
 }
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
 	uint32_t	idx;
+	uint32_t	found = CANONICAL_PROPERTY_TAGS_COUNT;
 	uint16_t	current_type;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
+	/* All the types of a property id are adjacent in the tag
+	 * index. The one coming first in the table is returned. */
+	for (idx = canonical_property_tags_lower_bound((uint32_t)untypedtag << 16);
+	     idx < CANONICAL_PROPERTY_TAGS_COUNT &&
+		     (canonical_property_tags[canonical_property_tags_by_tag[idx]].proptag >> 16) == untypedtag;
+	     idx++) {
+		current_type = canonical_property_tags[canonical_property_tags_by_tag[idx]].proptype;
+		if (current_type != PT_ERROR && current_type != PT_STRING8 &&
+		    canonical_property_tags_by_tag[idx] < found) {
+			found = canonical_property_tags_by_tag[idx];
 		}
 	}
+	if (found < CANONICAL_PROPERTY_TAGS_COUNT) {
+		return canonical_property_tags[found].proptype;
+	}
 
 	DEBUG(5, ("%s: type for property '%x' could not be deduced\n", __FUNCTION__, untypedtag));
 	return 0;
 }
-
-
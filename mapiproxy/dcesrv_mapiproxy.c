@@ -744,6 +744,9 @@ NTSTATUS samba_init_module(void)
 	status = dcerpc_server_exchange_emsmdb_init();
 	NT_STATUS_NOT_OK_RETURN(status);
 
+	status = dcerpc_server_exchange_async_emsmdb_init();
+	NT_STATUS_NOT_OK_RETURN(status);
+
 	status = dcerpc_server_exchange_nsp_init();
 	NT_STATUS_NOT_OK_RETURN(status);
 
@@ -754,6 +757,9 @@ NTSTATUS samba_init_module(void)
 	status = ndr_table_register(&ndr_table_exchange_emsmdb);
 	NT_STATUS_NOT_OK_RETURN(status);
 
+	status = ndr_table_register(&ndr_table_exchange_async_emsmdb);
+	NT_STATUS_NOT_OK_RETURN(status);
+
 	status = ndr_table_register(&ndr_table_exchange_nsp);
 	NT_STATUS_NOT_OK_RETURN(status);
 
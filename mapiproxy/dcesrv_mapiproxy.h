@@ -56,7 +56,8 @@ struct dcesrv_mapiproxy_private {
 enum exchange_handle {
 	EXCHANGE_HANDLE_NSP,
 	EXCHANGE_HANDLE_EMSMDB,
-	EXCHANGE_HANDLE_DS_RFR
+	EXCHANGE_HANDLE_DS_RFR,
+	EXCHANGE_HANDLE_ASYNC_EMSMDB
 };
 
 /* Forward declarations */
@@ -27,6 +27,8 @@
 #include <talloc.h>
 #include <gen_ndr/exchange.h>
 
+struct openchangedb_table_row;
+
 struct openchangedb_context {
 	enum MAPISTATUS (*get_new_changeNumber)(struct openchangedb_context *, const char *, uint64_t *);
 	enum MAPISTATUS (*get_new_changeNumbers)(struct openchangedb_context *, TALLOC_CTX *, const char *, uint64_t, struct UI8Array_r **);
@@ -66,6 +68,7 @@ struct openchangedb_context {
 	enum MAPISTATUS (*table_set_sort_order)(struct openchangedb_context *, void *, struct SSortOrderSet *);
 	enum MAPISTATUS (*table_set_restrictions)(struct openchangedb_context *, void *, struct mapi_SRestriction *);
 	enum MAPISTATUS (*table_get_property)(TALLOC_CTX *, struct openchangedb_context *, void *, enum MAPITAGS, uint32_t, bool, void **);
+	enum MAPISTATUS (*table_get_rows)(TALLOC_CTX *, struct openchangedb_context *, void *, struct SPropTagArray *, uint32_t, uint32_t, bool, struct openchangedb_table_row **, uint32_t *);
 
 	enum MAPISTATUS (*message_create)(TALLOC_CTX *, struct openchangedb_context *, const char *, uint64_t, uint64_t, bool, void **);
 	enum MAPISTATUS (*message_save)(struct openchangedb_context *, void *, uint8_t);
@@ -942,33 +942,78 @@ static enum MAPISTATUS get_ReceiveFolderTable(TALLOC_CTX *mem_ctx,
 	return MAPI_E_SUCCESS;
 }
 
-static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self, const char *username, uint64_t *cn)
+/**
+   \details Atomically reserve a range of change numbers
+
+   The read and update of the server ChangeNumber attribute run within
+   a single ldb transaction, which serializes concurrent reservations
+   from other processes.
+
+   \param self pointer to the openchangedb context
+   \param username the mailbox username
+   \param count number of change numbers to reserve
+   \param first pointer to the first reserved change number the
+   function returns
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS reserve_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t count,
+					     uint64_t *first)
 {
 	TALLOC_CTX		*mem_ctx;
 	int			ret;
 	struct ldb_result	*res;
 	struct ldb_message	*msg;
-	const char * const	attrs[] = { "*", NULL };
+	const char * const	attrs[] = { "ChangeNumber", NULL };
 	struct ldb_context	*ldb_ctx = self->data;
 
+	OPENCHANGE_RETVAL_IF(!count, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!first, MAPI_E_INVALID_PARAMETER, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "reserve_changeNumbers");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	ret = ldb_transaction_start(ldb_ctx);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_CALL_FAILED, mem_ctx);
+
 	/* Get the current GlobalCount */
-	mem_ctx = talloc_named(NULL, 0, "get_next_changeNumber");
 	ret = ldb_search(ldb_ctx, mem_ctx, &res, ldb_get_root_basedn(ldb_ctx),
 			 LDB_SCOPE_SUBTREE, attrs, "(objectClass=server)");
-	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || !res->count, MAPI_E_NOT_FOUND, mem_ctx);
+	if (ret != LDB_SUCCESS || !res->count) {
+		ldb_transaction_cancel(ldb_ctx);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, mem_ctx);
+	}
 
-	*cn = ldb_msg_find_attr_as_uint64(res->msgs[0], "ChangeNumber", 1);
+	*first = ldb_msg_find_attr_as_uint64(res->msgs[0], "ChangeNumber", 1);
 
 	/* Update GlobalCount value */
 	msg = ldb_msg_new(mem_ctx);
-	msg->dn = ldb_dn_copy(msg, ldb_msg_find_attr_as_dn(ldb_ctx, mem_ctx, res->msgs[0], "distinguishedName"));
-	ldb_msg_add_fmt(msg, "ChangeNumber", "%"PRIu64, ((*cn) + 1));
+	msg->dn = ldb_dn_copy(msg, res->msgs[0]->dn);
+	ldb_msg_add_fmt(msg, "ChangeNumber", "%"PRIu64, ((*first) + count));
 	msg->elements[0].flags = LDB_FLAG_MOD_REPLACE;
 	ret = ldb_modify(ldb_ctx, msg);
-	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_NO_SUPPORT, mem_ctx);
+	if (ret != LDB_SUCCESS) {
+		ldb_transaction_cancel(ldb_ctx);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NO_SUPPORT, mem_ctx);
+	}
+
+	ret = ldb_transaction_commit(ldb_ctx);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_CALL_FAILED, mem_ctx);
 
 	talloc_free(mem_ctx);
 
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self, const char *username, uint64_t *cn)
+{
+	enum MAPISTATUS	retval;
+
+	retval = reserve_changeNumbers(self, username, 1, cn);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
+
 	*cn = (exchange_globcnt(*cn) << 16) | 0x0001;
 
 	return MAPI_E_SUCCESS;
@@ -980,42 +1025,24 @@ static enum MAPISTATUS get_new_changeNumbers(struct openchangedb_context *self,
 					     uint64_t max,
 					     struct UI8Array_r **cns_p)
 {
-	TALLOC_CTX		*local_mem_ctx;
-	int			ret;
-	struct ldb_result	*res;
-	struct ldb_message	*msg;
-	const char * const	attrs[] = { "*", NULL };
+	enum MAPISTATUS		retval;
 	uint64_t		cn, count;
 	struct UI8Array_r	*cns;
-	struct ldb_context	*ldb_ctx = self->data;
 
-	/* Get the current GlobalCount */
-	local_mem_ctx = talloc_named(NULL, 0, "get_new_changeNumber");
-	ret = ldb_search(ldb_ctx, local_mem_ctx, &res, ldb_get_root_basedn(ldb_ctx),
-			 LDB_SCOPE_SUBTREE, attrs, "(objectClass=server)");
-	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || !res->count, MAPI_E_NOT_FOUND, local_mem_ctx);
+	retval = reserve_changeNumbers(self, username, max, &cn);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
-	cn = ldb_msg_find_attr_as_uint64(res->msgs[0], "ChangeNumber", 1);
-
-	cns = talloc_zero(local_mem_ctx, struct UI8Array_r);
+	cns = talloc_zero(mem_ctx, struct UI8Array_r);
+	OPENCHANGE_RETVAL_IF(!cns, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	cns->cValues = max;
 	cns->lpui8 = talloc_array(cns, uint64_t, max);
+	OPENCHANGE_RETVAL_IF(!cns->lpui8, MAPI_E_NOT_ENOUGH_MEMORY, cns);
 
 	for (count = 0; count < max; count++) {
 		cns->lpui8[count] = (exchange_globcnt(cn + count) << 16) | 0x0001;
 	}
 
-	/* Update GlobalCount value */
-	msg = ldb_msg_new(local_mem_ctx);
-	msg->dn = ldb_dn_copy(msg, ldb_msg_find_attr_as_dn(ldb_ctx, local_mem_ctx, res->msgs[0], "distinguishedName"));
-	ldb_msg_add_fmt(msg, "ChangeNumber", "%"PRIu64, (cn + max));
-	msg->elements[0].flags = LDB_FLAG_MOD_REPLACE;
-	ret = ldb_modify(ldb_ctx, msg);
-	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_NO_SUPPORT, local_mem_ctx);
-
 	*cns_p = cns;
-	(void) talloc_reference(mem_ctx, cns);
-	talloc_free(local_mem_ctx);
 
 	return MAPI_E_SUCCESS;
 }
@@ -1750,6 +1777,7 @@ struct openchangedb_table {
 	struct SSortOrderSet		*lpSortCriteria;
 	struct mapi_SRestriction	*restrictions;
 	struct ldb_result		*res;
+	uint64_t			*fmids;
 };
 
 
@@ -1785,6 +1813,7 @@ static enum MAPISTATUS table_set_sort_order(struct openchangedb_context *self,
 	if (table->res) {
 		talloc_free(table->res);
 		table->res = NULL;
+		table->fmids = NULL;
 	}
 
 	if (table->lpSortCriteria) {
@@ -1815,6 +1844,7 @@ static enum MAPISTATUS table_set_restrictions(struct openchangedb_context *self,
 	if (table->res) {
 		talloc_free(table->res);
 		table->res = NULL;
+		table->fmids = NULL;
 	}
 
 	if (table->restrictions) {
@@ -1850,11 +1880,43 @@ static enum MAPISTATUS table_set_restrictions(struct openchangedb_context *self,
 	return MAPI_E_SUCCESS;
 }
 
+static const char *_table_get_child_id_attribute(struct openchangedb_table *table)
+{
+	switch (table->table_type) {
+	case 0x3 /* EMSMDBP_TABLE_FAI_TYPE */:
+	case 0x2 /* EMSMDBP_TABLE_MESSAGE_TYPE */:
+		return "PidTagMessageId";
+	case 0x1 /* EMSMDBP_TABLE_FOLDER_TYPE */:
+		return "PidTagFolderId";
+	default:
+		DEBUG(5, ("unsupported table type for openchangedb: %d\n", table->table_type));
+		return NULL;
+	}
+}
+
+/**
+   \details Build the LDB filter matching the rows of a table
+
+   \param mem_ctx pointer to the memory context
+   \param table pointer to the openchangedb table
+   \param row_fmids the identifiers of the rows to match
+   \param row_count number of elements in row_fmids, 0 to match all
+   the rows of the table
+   \param restrictions optional restrictions to apply
+
+   \return the LDB filter on success, otherwise NULL
+ */
 static char *_table_build_filter(TALLOC_CTX *mem_ctx, struct openchangedb_table *table,
-				 uint64_t row_fmid, struct mapi_SRestriction *restrictions)
+				 const uint64_t *row_fmids, uint32_t row_count,
+				 struct mapi_SRestriction *restrictions)
 {
 	char		*filter = NULL;
 	const char	*PidTagAttr = NULL;
+	const char	*childIdAttr;
+	uint32_t	i;
+
+	childIdAttr = _table_get_child_id_attribute(table);
+	if (!childIdAttr) return NULL;
 
 	switch (table->table_type) {
 	case 0x3 /* EMSMDBP_TABLE_FAI_TYPE */:
@@ -1868,11 +1930,18 @@ static char *_table_build_filter(TALLOC_CTX *mem_ctx, struct openchangedb_table
 		break;
 	}
 
-	if (row_fmid == 0) {
+	if (row_count == 0) {
 		filter = talloc_asprintf_append(filter, "*)");
 	}
+	else if (row_count == 1) {
+		filter = talloc_asprintf_append(filter, "%"PRIu64")", row_fmids[0]);
+	}
 	else {
-		filter = talloc_asprintf_append(filter, "%"PRIu64")", row_fmid);
+		filter = talloc_asprintf_append(filter, "*)(|");
+		for (i = 0; i < row_count; i++) {
+			filter = talloc_asprintf_append(filter, "(%s=%"PRIu64")", childIdAttr, row_fmids[i]);
+		}
+		filter = talloc_asprintf_append(filter, ")");
 	}
 
 	if (restrictions) {
@@ -1906,74 +1975,67 @@ static char *_table_build_filter(TALLOC_CTX *mem_ctx, struct openchangedb_table
 	return filter;
 }
 
-static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
-					  struct openchangedb_context *self,
-					  void *table_object,
-					  enum MAPITAGS proptag, uint32_t pos,
-					  bool live_filtered, void **data)
-{
-	struct openchangedb_table	*table = (struct openchangedb_table *)table_object;
-	char				*ldb_filter = NULL;
-	struct ldb_result		*res = NULL, *live_res = NULL;
-	const char * const		attrs[] = { "*", NULL };
-	const char			*PidTagAttr = NULL, *childIdAttr;
-	uint64_t			*row_fmid;
-	int				ret;
-	struct ldb_context 		*ldb_ctx = self->data;
+/**
+   \details Fetch the identifiers of the table rows. Only the row
+   identifier is retrieved here, columns are fetched page by page
+   by table_get_rows.
 
-	/* Fetch results */
-	if (!table->res) {
-		/* Build ldb filter */
-		if (live_filtered) {
-			ldb_filter = _table_build_filter(NULL, table, 0, NULL);
-			DEBUG(5, ("(live-filtered) ldb_filter = %s\n", ldb_filter));
-		}
-		else {
-			ldb_filter = _table_build_filter(NULL, table, 0, table->restrictions);
-			DEBUG(5, ("(pre-filtered) ldb_filter = %s\n", ldb_filter));
-		}
-		OPENCHANGE_RETVAL_IF(!ldb_filter, MAPI_E_TOO_COMPLEX, NULL);
-		ret = ldb_search(ldb_ctx, (TALLOC_CTX *)table_object, &table->res, ldb_get_default_basedn(ldb_ctx), LDB_SCOPE_SUBTREE, attrs, ldb_filter, NULL);
-		talloc_free(ldb_filter);
-		OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_INVALID_OBJECT, NULL);
-	}
-	res = table->res;
+   \param ldb_ctx pointer to the openchange LDB context
+   \param table pointer to the openchangedb table
+   \param live_filtered whether restrictions are checked for each row
+   rather than applied to the search
 
-	/* Ensure position is within search results range */
-	OPENCHANGE_RETVAL_IF(pos >= res->count, MAPI_E_INVALID_OBJECT, NULL);
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS _table_fetch_rows_index(struct ldb_context *ldb_ctx,
+					       struct openchangedb_table *table,
+					       bool live_filtered)
+{
+	char		*ldb_filter;
+	const char	*attrs[] = { NULL, NULL };
+	uint32_t	i;
+	int		ret;
 
-	/* If live filtering, make sure the specified row match the restrictions */
-	if (live_filtered) {
-		TALLOC_CTX *local_mem_ctx;
+	attrs[0] = _table_get_child_id_attribute(table);
+	OPENCHANGE_RETVAL_IF(!attrs[0], MAPI_E_INVALID_OBJECT, NULL);
 
-		switch (table->table_type) {
-		case 0x3 /* EMSMDBP_TABLE_FAI_TYPE */:
-		case 0x2 /* EMSMDBP_TABLE_MESSAGE_TYPE */:
-			childIdAttr = "PidTagMessageId";
-			break;
-		case 0x1 /* EMSMDBP_TABLE_FOLDER_TYPE */:
-			childIdAttr = "PidTagFolderId";
-			break;
-		default:
-			DEBUG(5, ("unsupported table type for openchangedb: %d\n", table->table_type));
-			abort();
-		}
-		row_fmid = get_property_data(mem_ctx, res, pos, PR_MID, childIdAttr);
-		if (!row_fmid || !*row_fmid) {
-			DEBUG(5, ("ldb object must have a '%s' field\n", childIdAttr));
-			abort();
+	/* Build ldb filter */
+	if (live_filtered) {
+		ldb_filter = _table_build_filter(NULL, table, NULL, 0, NULL);
+		DEBUG(5, ("(live-filtered) ldb_filter = %s\n", ldb_filter));
+	}
+	else {
+		ldb_filter = _table_build_filter(NULL, table, NULL, 0, table->restrictions);
+		DEBUG(5, ("(pre-filtered) ldb_filter = %s\n", ldb_filter));
+	}
+	OPENCHANGE_RETVAL_IF(!ldb_filter, MAPI_E_TOO_COMPLEX, NULL);
+	ret = ldb_search(ldb_ctx, (TALLOC_CTX *)table, &table->res, ldb_get_default_basedn(ldb_ctx), LDB_SCOPE_SUBTREE, attrs, "%s", ldb_filter);
+	talloc_free(ldb_filter);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_INVALID_OBJECT, NULL);
+
+	table->fmids = talloc_array(table->res, uint64_t, table->res->count);
+	OPENCHANGE_RETVAL_IF(!table->fmids && table->res->count, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	for (i = 0; i < table->res->count; i++) {
+		table->fmids[i] = ldb_msg_find_attr_as_uint64(table->res->msgs[i], attrs[0], 0);
+		if (!table->fmids[i]) {
+			DEBUG(5, ("ldb object must have a '%s' field\n", attrs[0]));
 		}
+	}
 
-		local_mem_ctx = talloc_zero(NULL, TALLOC_CTX);
+	return MAPI_E_SUCCESS;
+}
 
-		ldb_filter = _table_build_filter(local_mem_ctx, table, *row_fmid, table->restrictions);
-		OPENCHANGE_RETVAL_IF(!ldb_filter, MAPI_E_TOO_COMPLEX, NULL);
-		DEBUG(5, ("  row ldb_filter = %s\n", ldb_filter));
-		ret = ldb_search(ldb_ctx, local_mem_ctx, &live_res, ldb_get_default_basedn(ldb_ctx), LDB_SCOPE_SUBTREE, attrs, ldb_filter, NULL);
-		OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || live_res->count == 0, MAPI_E_INVALID_OBJECT, local_mem_ctx);
-		talloc_free(local_mem_ctx);
-	}
+/**
+   \details Map a table column to the property stored in the LDB
+   record
+
+   \param table pointer to the openchangedb table
+   \param proptag the column property tag
 
+   \return the property tag to read from the record
+ */
+static enum MAPITAGS _table_get_column_property(struct openchangedb_table *table, enum MAPITAGS proptag)
+{
 	/* hacks for some attributes specific to tables */
 	if (proptag == PR_INST_ID) {
 		if (table->table_type == 1) {
@@ -1983,30 +2045,168 @@ static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
 			proptag = PR_MID;
 		}
 	}
-	else if (proptag == PR_INSTANCE_NUM) {
-		*data = talloc_zero(mem_ctx, uint32_t);
-		return MAPI_E_SUCCESS;
-	}
 
-	/* Convert proptag into PidTag attribute */
 	if ((table->table_type != 0x1) && proptag == PR_FID) {
 		proptag = PR_PARENT_FID;
 	}
-	PidTagAttr = openchangedb_property_get_attribute(proptag);
-	OPENCHANGE_RETVAL_IF(!PidTagAttr, MAPI_E_NOT_FOUND, NULL);
 
-	/* Ensure the element exists */
-	OPENCHANGE_RETVAL_IF(!ldb_msg_find_element(res->msgs[pos], PidTagAttr), MAPI_E_NOT_FOUND, NULL);
+	return proptag;
+}
 
-	/* Check if this is a "special property" */
-	*data = _get_special_property(mem_ctx, ldb_ctx, res, proptag, PidTagAttr);
-	OPENCHANGE_RETVAL_IF(*data != NULL, MAPI_E_SUCCESS, NULL);
+static void _table_fill_row(struct ldb_context *ldb_ctx,
+			    struct openchangedb_table_row *row,
+			    struct ldb_result *res, uint32_t pos,
+			    struct SPropTagArray *props,
+			    enum MAPITAGS *columns, const char **column_attrs)
+{
+	uint32_t	i;
 
-	/* Check if this is NOT a "special property" */
-	*data = get_property_data(mem_ctx, res, pos, proptag, PidTagAttr);
-	OPENCHANGE_RETVAL_IF(*data != NULL, MAPI_E_SUCCESS, NULL);
+	for (i = 0; i < props->cValues; i++) {
+		if (props->aulPropTag[i] == PR_INSTANCE_NUM) {
+			row->data[i] = talloc_zero(row->data, uint32_t);
+			row->retvals[i] = MAPI_E_SUCCESS;
+			continue;
+		}
 
-	return MAPI_E_NOT_FOUND;
+		/* Ensure the element exists */
+		if (!column_attrs[i] || !ldb_msg_find_element(res->msgs[pos], column_attrs[i])) {
+			row->retvals[i] = MAPI_E_NOT_FOUND;
+			continue;
+		}
+
+		/* Check if this is a "special property" */
+		row->data[i] = _get_special_property(row->data, ldb_ctx, res, columns[i], column_attrs[i]);
+		if (!row->data[i]) {
+			row->data[i] = get_property_data(row->data, res, pos, columns[i], column_attrs[i]);
+		}
+		row->retvals[i] = row->data[i] ? MAPI_E_SUCCESS : MAPI_E_NOT_FOUND;
+	}
+}
+
+static enum MAPISTATUS table_get_rows(TALLOC_CTX *mem_ctx,
+				      struct openchangedb_context *self,
+				      void *table_object,
+				      struct SPropTagArray *props,
+				      uint32_t pos, uint32_t count,
+				      bool live_filtered,
+				      struct openchangedb_table_row **rowsp,
+				      uint32_t *row_countp)
+{
+	struct openchangedb_table	*table = (struct openchangedb_table *)table_object;
+	struct ldb_context		*ldb_ctx = self->data;
+	struct openchangedb_table_row	*rows;
+	struct ldb_result		*res = NULL;
+	enum MAPISTATUS			retval;
+	TALLOC_CTX			*local_mem_ctx;
+	enum MAPITAGS			*columns;
+	const char			**column_attrs;
+	const char			**attrs;
+	const char			*childIdAttr;
+	char				*ldb_filter;
+	uint64_t			fmid;
+	uint32_t			attr_count, i, j;
+	int				ret;
+
+	/* Fetch results */
+	if (!table->res) {
+		retval = _table_fetch_rows_index(ldb_ctx, table, live_filtered);
+		OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+	}
+
+	/* Ensure position is within search results range */
+	OPENCHANGE_RETVAL_IF(pos >= table->res->count, MAPI_E_INVALID_OBJECT, NULL);
+	if (count > table->res->count - pos) {
+		count = table->res->count - pos;
+	}
+	childIdAttr = _table_get_child_id_attribute(table);
+
+	local_mem_ctx = talloc_named(NULL, 0, "table_get_rows");
+	OPENCHANGE_RETVAL_IF(!local_mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	/* Only retrieve the requested columns */
+	columns = talloc_array(local_mem_ctx, enum MAPITAGS, props->cValues);
+	column_attrs = talloc_array(local_mem_ctx, const char *, props->cValues);
+	attrs = talloc_array(local_mem_ctx, const char *, props->cValues + 2);
+	OPENCHANGE_RETVAL_IF(!columns || !column_attrs || !attrs, MAPI_E_NOT_ENOUGH_MEMORY, local_mem_ctx);
+
+	attrs[0] = childIdAttr;
+	attr_count = 1;
+	for (i = 0; i < props->cValues; i++) {
+		columns[i] = _table_get_column_property(table, props->aulPropTag[i]);
+		column_attrs[i] = openchangedb_property_get_attribute(columns[i]);
+		if (!column_attrs[i]) continue;
+
+		for (j = 0; j < attr_count && strcmp(attrs[j], column_attrs[i]); j++);
+		if (j == attr_count) {
+			attrs[attr_count++] = column_attrs[i];
+		}
+	}
+	attrs[attr_count] = NULL;
+
+	/* Fetch the whole page at once. When live filtering, rows which
+	 * no longer match the restrictions are not returned */
+	ldb_filter = _table_build_filter(local_mem_ctx, table, table->fmids + pos, count,
+					 live_filtered ? table->restrictions : NULL);
+	OPENCHANGE_RETVAL_IF(!ldb_filter, MAPI_E_TOO_COMPLEX, local_mem_ctx);
+	DEBUG(5, ("  page ldb_filter = %s\n", ldb_filter));
+	ret = ldb_search(ldb_ctx, local_mem_ctx, &res, ldb_get_default_basedn(ldb_ctx), LDB_SCOPE_SUBTREE, attrs, "%s", ldb_filter);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_INVALID_OBJECT, local_mem_ctx);
+
+	rows = talloc_zero_array(mem_ctx, struct openchangedb_table_row, count);
+	OPENCHANGE_RETVAL_IF(!rows && count, MAPI_E_NOT_ENOUGH_MEMORY, local_mem_ctx);
+	for (i = 0; i < count; i++) {
+		rows[i].fmid = table->fmids[pos + i];
+	}
+
+	for (i = 0; i < res->count; i++) {
+		fmid = ldb_msg_find_attr_as_uint64(res->msgs[i], childIdAttr, 0);
+		for (j = 0; j < count; j++) {
+			if (rows[j].fmid != fmid || rows[j].data) continue;
+
+			rows[j].data = talloc_zero_array(rows, void *, props->cValues);
+			rows[j].retvals = talloc_zero_array(rows, enum MAPISTATUS, props->cValues);
+			if (!rows[j].data || !rows[j].retvals) {
+				talloc_free(rows);
+				talloc_free(local_mem_ctx);
+				return MAPI_E_NOT_ENOUGH_MEMORY;
+			}
+			_table_fill_row(ldb_ctx, &rows[j], res, i, props, columns, column_attrs);
+		}
+	}
+	talloc_free(local_mem_ctx);
+
+	*rowsp = rows;
+	*row_countp = count;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
+					  struct openchangedb_context *self,
+					  void *table_object,
+					  enum MAPITAGS proptag, uint32_t pos,
+					  bool live_filtered, void **data)
+{
+	struct openchangedb_table_row	*rows = NULL;
+	struct SPropTagArray		props;
+	enum MAPISTATUS			retval;
+	uint32_t			count;
+
+	props.cValues = 1;
+	props.aulPropTag = &proptag;
+	retval = table_get_rows(mem_ctx, self, table_object, &props, pos, 1, live_filtered, &rows, &count);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	/* The row does not match the restrictions */
+	OPENCHANGE_RETVAL_IF(!rows[0].data, MAPI_E_INVALID_OBJECT, rows);
+
+	retval = rows[0].retvals[0];
+	if (retval == MAPI_E_SUCCESS) {
+		*data = talloc_steal(mem_ctx, rows[0].data[0]);
+	}
+	talloc_free(rows);
+
+	return retval;
 }
 
 // ^ openchangedb table -------------------------------------------------------
@@ -2423,6 +2623,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_ldb_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->table_set_sort_order = table_set_sort_order;
 	oc_ctx->table_set_restrictions = table_set_restrictions;
 	oc_ctx->table_get_property = table_get_property;
+	oc_ctx->table_get_rows = table_get_rows;
 
 	oc_ctx->message_create = message_create;
 	oc_ctx->message_save = message_save;
@@ -60,30 +60,23 @@ static enum MAPISTATUS get_SpecialFolderID(struct openchangedb_context *self,
 					   uint32_t system_idx,
 					   uint64_t *folder_id)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
+	MYSQL_BIND	params[2];
+	uint64_t	idx = system_idx;
 
-	mem_ctx = talloc_named(NULL, 0, "get_SpecialFolderId");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
-	sql = talloc_asprintf(mem_ctx,
+	stmt_bind_string(&params[0], recipient);
+	stmt_bind_uint64(&params[1], &idx);
+	return status(select_stmt_first_uint(conn,
 		"SELECT f.folder_id FROM folders f "
 		"JOIN mailboxes m ON f.mailbox_id = m.id "
-		"  AND m.name = '%s' "
-		"WHERE f.SystemIdx = %"PRIu32
+		"  AND m.name = ? "
+		"WHERE f.SystemIdx = ?"
 		"  AND f.folder_class = '"SYSTEM_FOLDER"' "
 		"  AND f.parent_folder_id IS NOT NULL",
-		_sql(mem_ctx, recipient), system_idx);
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_uint(conn, sql, folder_id));
-
-	talloc_free(mem_ctx);
-	return retval;
+		params, folder_id));
 }
 
 static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
@@ -91,36 +84,29 @@ static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
 					  uint32_t SystemIdx,
 					  uint64_t *FolderId)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
+	MYSQL_BIND	params[2];
+	uint64_t	idx = SystemIdx;
 
-	mem_ctx = talloc_named(NULL, 0, "get_SystemFolderId");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
+	stmt_bind_string(&params[0], recipient);
 	if (SystemIdx == 0x1) {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT folder_id FROM mailboxes WHERE name = '%s'",
-			_sql(mem_ctx, recipient));
-	} else {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT f.folder_id FROM folders f "
-			"JOIN mailboxes m ON f.mailbox_id = m.id "
-			"  AND m.name = '%s' "
-			"WHERE f.SystemIdx = %"PRIu32
-			"  AND f.folder_class = '"SYSTEM_FOLDER"' "
-			"ORDER BY parent_folder_id",
-			_sql(mem_ctx, recipient), SystemIdx);
+		return status(select_stmt_first_uint(conn,
+			"SELECT folder_id FROM mailboxes WHERE name = ?",
+			params, FolderId));
 	}
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_uint(conn, sql, FolderId));
 
-	talloc_free(mem_ctx);
-	return retval;
+	stmt_bind_uint64(&params[1], &idx);
+	return status(select_stmt_first_uint(conn,
+		"SELECT f.folder_id FROM folders f "
+		"JOIN mailboxes m ON f.mailbox_id = m.id "
+		"  AND m.name = ? "
+		"WHERE f.SystemIdx = ?"
+		"  AND f.folder_class = '"SYSTEM_FOLDER"' "
+		"ORDER BY parent_folder_id",
+		params, FolderId));
 }
 
 static enum MAPISTATUS get_PublicFolderID(struct openchangedb_context *self,
@@ -128,28 +114,21 @@ static enum MAPISTATUS get_PublicFolderID(struct openchangedb_context *self,
 					  uint32_t SystemIdx,
 					  uint64_t *FolderId)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
+	MYSQL_BIND	params[2];
+	uint64_t	idx = SystemIdx;
 
-	mem_ctx = talloc_named(NULL, 0, "get_PublicFolderID");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
-	sql = talloc_asprintf(mem_ctx,
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &idx);
+	return status(select_stmt_first_uint(conn,
 		"SELECT f.folder_id FROM folders f "
-		"JOIN mailboxes m ON f.ou_id = m.ou_id AND m.name = '%s' "
-		"WHERE f.SystemIdx = %"PRIu32
+		"JOIN mailboxes m ON f.ou_id = m.ou_id AND m.name = ? "
+		"WHERE f.SystemIdx = ?"
 		"  AND f.folder_class = '"PUBLIC_FOLDER"'",
-		_sql(mem_ctx, username), SystemIdx);
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_uint(conn, sql, FolderId));
-
-	talloc_free(mem_ctx);
-	return retval;
+		params, FolderId));
 }
 
 static enum MAPISTATUS get_distinguishedName(TALLOC_CTX *parent_ctx,
@@ -288,62 +267,51 @@ static enum MAPISTATUS get_mapistoreURI(TALLOC_CTX *parent_ctx,
 				        const char *username, uint64_t fid,
 				        char **mapistoreURL, bool mailboxstore)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
+	MYSQL_BIND	params[2];
 
-	mem_ctx = talloc_named(NULL, 0, "get_mapistoreURI");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
 	if (!mailboxstore) {
-		talloc_free(mem_ctx);
 		// TODO is it possible?
 		return _not_implemented("get_mapistoreURI with mailboxstore=false");
 	}
 
-	sql = talloc_asprintf(mem_ctx,
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &fid);
+	return status(select_stmt_first_string(parent_ctx, conn,
 		"SELECT MAPIStoreURI FROM folders f "
-		"JOIN mailboxes m ON m.id = f.mailbox_id AND m.name = '%s' "
-		"WHERE f.folder_id = %"PRIu64, _sql(mem_ctx, username), fid);
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_string(parent_ctx, conn, sql, (const char **)mapistoreURL));
-
-	talloc_free(mem_ctx);
-	return retval;
+		"JOIN mailboxes m ON m.id = f.mailbox_id AND m.name = ? "
+		"WHERE f.folder_id = ?",
+		params, (const char **)mapistoreURL));
 }
 
 static enum MAPISTATUS set_mapistoreURI(struct openchangedb_context *self,
 					const char *username, uint64_t fid,
 					const char *mapistoreURL)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
 	enum MAPISTATUS	retval;
-	char		*sql;
+	MYSQL_BIND	params[3];
+	uint64_t	affected_rows = 0;
 
-	mem_ctx = talloc_named(NULL, 0, "set_mapistoreURI");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
-	sql = talloc_asprintf(mem_ctx,
+	stmt_bind_string(&params[0], username);
+	stmt_bind_string(&params[1], mapistoreURL);
+	stmt_bind_uint64(&params[2], &fid);
+	retval = status(execute_stmt(conn,
 		"UPDATE folders f "
-		"JOIN mailboxes m ON m.id = f.mailbox_id AND m.name = '%s' "
-		"SET f.MAPIStoreURI = '%s' "
-		"WHERE f.folder_id = %"PRIu64,
-		_sql(mem_ctx, username), mapistoreURL, fid);
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(execute_query(conn, sql));
-	if (mysql_affected_rows(conn) == 0) {
+		"JOIN mailboxes m ON m.id = f.mailbox_id AND m.name = ? "
+		"SET f.MAPIStoreURI = ? "
+		"WHERE f.folder_id = ?",
+		params, &affected_rows));
+	if (affected_rows == 0) {
 		retval = MAPI_E_NOT_FOUND;
 	}
 
-	talloc_free(mem_ctx);
 	return retval;
 }
 
@@ -351,47 +319,40 @@ static enum MAPISTATUS get_parent_fid(struct openchangedb_context *self,
 				      const char *username, uint64_t fid,
 				      uint64_t *parent_fidp, bool mailboxstore)
 {
-	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval;
-	char		*sql;
+	MYSQL_BIND	params[4];
 
-	mem_ctx = talloc_named(NULL, 0, "get_parent_fid");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, mem_ctx);
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
+	stmt_bind_uint64(&params[0], &fid);
+	stmt_bind_string(&params[1], username);
 	if (mailboxstore) {
-		sql = talloc_asprintf(mem_ctx,
+		stmt_bind_uint64(&params[2], &fid);
+		stmt_bind_string(&params[3], username);
+		return status(select_stmt_first_uint(conn,
 			"SELECT f1.folder_id FROM folders f1 "
 			"JOIN folders f2 ON f1.id = f2.parent_folder_id"
-			"  AND f2.folder_id = %"PRIu64" "
+			"  AND f2.folder_id = ? "
 			"JOIN mailboxes m ON m.id = f2.mailbox_id"
-			"  AND m.name = '%s' "
+			"  AND m.name = ? "
 			"UNION "
 			"SELECT m.folder_id FROM mailboxes m "
 			"JOIN folders f1 ON f1.mailbox_id = m.id"
 			"  AND f1.parent_folder_id IS NULL "
-			"  AND f1.folder_id = %"PRIu64" "
-			"WHERE m.name = '%s'",
-			fid, _sql(mem_ctx, username),
-			fid, _sql(mem_ctx, username));
-	} else {
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT f1.folder_id FROM folders f1 "
-			"JOIN folders f2 ON f1.id = f2.parent_folder_id"
-			"  AND f2.folder_id = %"PRIu64" "
-			"JOIN mailboxes m ON m.ou_id = f2.ou_id"
-			"  AND m.name = '%s' "
-			"WHERE f1.folder_class = '"PUBLIC_FOLDER"'",
-			fid, _sql(mem_ctx, username));
+			"  AND f1.folder_id = ? "
+			"WHERE m.name = ?",
+			params, parent_fidp));
 	}
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_uint(conn, sql, parent_fidp));
 
-	talloc_free(mem_ctx);
-	return retval;
+	return status(select_stmt_first_uint(conn,
+		"SELECT f1.folder_id FROM folders f1 "
+		"JOIN folders f2 ON f1.id = f2.parent_folder_id"
+		"  AND f2.folder_id = ? "
+		"JOIN mailboxes m ON m.ou_id = f2.ou_id"
+		"  AND m.name = ? "
+		"WHERE f1.folder_class = '"PUBLIC_FOLDER"'",
+		params, parent_fidp));
 }
 
 static enum MAPISTATUS get_fid(struct openchangedb_context *self,
@@ -400,7 +361,8 @@ static enum MAPISTATUS get_fid(struct openchangedb_context *self,
 	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
 	enum MAPISTATUS	retval;
-	char		*sql, *mapistore_uri_2;
+	char		*mapistore_uri_2;
+	MYSQL_BIND	params[2];
 
 	mem_ctx = talloc_named(NULL, 0, "get_fid");
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
@@ -416,13 +378,12 @@ static enum MAPISTATUS get_fid(struct openchangedb_context *self,
 		OPENCHANGE_RETVAL_IF(!mapistore_uri_2, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 	}
 
-	sql = talloc_asprintf(mem_ctx,
+	stmt_bind_string(&params[0], mapistore_uri);
+	stmt_bind_string(&params[1], mapistore_uri_2);
+	retval = status(select_stmt_first_uint(conn,
 		"SELECT folder_id FROM folders "
-		"WHERE MAPIStoreURI = '%s' OR MAPIStoreURI = '%s'",
-		_sql(mem_ctx, mapistore_uri), _sql(mem_ctx, mapistore_uri_2));
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_first_uint(conn, sql, fidp));
+		"WHERE MAPIStoreURI = ? OR MAPIStoreURI = ?",
+		params, fidp));
 
 	talloc_free(mem_ctx);
 	return retval;
@@ -646,56 +607,29 @@ static enum MAPISTATUS get_mailbox_ids_by_name(MYSQL *conn,
 					       uint64_t *mailbox_folder_id,
 					       uint64_t *ou_id)
 {
-	TALLOC_CTX	*mem_ctx;
 	enum MAPISTATUS	retval;
-	char		*sql;
-	MYSQL_RES	*res;
-	MYSQL_ROW	row;
+	MYSQL_BIND	params[1];
+	MYSQL_BIND	results[3];
+	uint64_t	ids[3];
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "get_mailbox_ids_by_name");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
-
-	sql = talloc_asprintf(mem_ctx,
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&results[0], &ids[0]);
+	stmt_bind_uint64(&results[1], &ids[1]);
+	stmt_bind_uint64(&results[2], &ids[2]);
+	retval = status(select_stmt_first_row(NULL, conn,
 		"SELECT m.id, m.folder_id, m.ou_id FROM mailboxes m "
-		"WHERE m.name = '%s'", _sql(mem_ctx, username));
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+		"WHERE m.name = ?", params, results));
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
-	retval = status(select_without_fetch(conn, sql, &res));
-	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
-	row = mysql_fetch_row(res);
-	if (row == NULL) {
-		DEBUG(0, ("Error getting user's mailbox `%s`: %s", sql,
-			  mysql_error(conn)));
-		retval = MAPI_E_NOT_FOUND;
-		goto end;
-	}
+	if (mailbox_id) *mailbox_id = ids[0];
+	if (mailbox_folder_id) *mailbox_folder_id = ids[1];
+	if (ou_id) *ou_id = ids[2];
 
-	if (mailbox_id) {
-		if (!convert_string_to_ull(row[0], mailbox_id)) {
-			retval = MAPI_E_CALL_FAILED;
-			goto end;
-		}
-	}
-	if (mailbox_folder_id) {
-		if (!convert_string_to_ull(row[1], mailbox_folder_id)) {
-			retval = MAPI_E_CALL_FAILED;
-			goto end;
-		}
-	}
-	if (ou_id) {
-		if (!convert_string_to_ull(row[2], ou_id)) {
-			retval = MAPI_E_CALL_FAILED;
-			goto end;
-		}
-	}
-end:
-	mysql_free_result(res);
-	talloc_free(mem_ctx);
-	return retval;
+	return MAPI_E_SUCCESS;
 }
 
 #define is_public_folder(id) is_public_folder_id(NULL, id)
@@ -798,32 +732,100 @@ static enum MAPISTATUS get_server_change_number(MYSQL *conn,
 }
 
 /**
-   \details Set the current change number field
+   \details Run the statement advancing a server change number
+   counter and return the first number of the reserved range
+
+   The statement stores the new counter value through
+   LAST_INSERT_ID(expr): the value is private to this connection, so
+   concurrent reservations from other processes never overlap. Note
+   this overwrites the LAST_INSERT_ID() of the connection.
  */
-static enum MAPISTATUS set_server_change_number(MYSQL *conn,
-						const char *username,
-						uint64_t change_number)
+static enum MAPISTATUS execute_change_number_reservation(MYSQL *conn,
+							 const char *sql,
+							 uint64_t count,
+							 uint64_t *first)
+{
+	enum MAPISTATUS	retval;
+
+	retval = status(execute_query(conn, sql));
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
+	OPENCHANGE_RETVAL_IF(mysql_affected_rows(conn) != 1, MAPI_E_NOT_FOUND, NULL);
+
+	*first = mysql_insert_id(conn) - count;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Atomically reserve a range of change numbers on the server
+   of the given organizational unit
+ */
+static enum MAPISTATUS reserve_ou_changeNumbers(MYSQL *conn,
+						uint64_t ou_id,
+						uint64_t count,
+						uint64_t *first)
 {
 	TALLOC_CTX	*mem_ctx;
 	enum MAPISTATUS	retval;
 	char		*sql;
 
+	mem_ctx = talloc_named(NULL, 0, "reserve_ou_changeNumbers");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	sql = talloc_asprintf(mem_ctx,
+		"UPDATE servers "
+		"SET change_number = LAST_INSERT_ID(change_number + %"PRIu64") "
+		"WHERE ou_id = %"PRIu64,
+		count, ou_id);
+	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	retval = execute_change_number_reservation(conn, sql, count, first);
+
+	talloc_free(mem_ctx);
+	return retval;
+}
+
+/**
+   \details Atomically reserve a range of change numbers on the server
+   hosting the user mailbox
+
+   \param self pointer to the openchangedb context
+   \param username the mailbox username
+   \param count number of change numbers to reserve
+   \param first pointer to the first reserved change number the
+   function returns
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS reserve_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t count,
+					     uint64_t *first)
+{
+	TALLOC_CTX	*mem_ctx;
+	MYSQL		*conn;
+	enum MAPISTATUS	retval;
+	char		*sql;
+
 	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
-	OPENCHANGE_RETVAL_IF(!change_number, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!count, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!first, MAPI_E_INVALID_PARAMETER, NULL);
+
+	conn = self->data;
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "set_server_change_number");
+	mem_ctx = talloc_named(NULL, 0, "reserve_changeNumbers");
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 
 	sql = talloc_asprintf(mem_ctx,
 		"UPDATE servers s "
 		"JOIN mailboxes m ON m.ou_id = s.ou_id AND m.name = '%s' "
-		"SET s.change_number=%"PRIu64,
-		_sql(mem_ctx, username), change_number);
+		"SET s.change_number = LAST_INSERT_ID(s.change_number + %"PRIu64")",
+		_sql(mem_ctx, username), count);
 	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 
-	retval = status(execute_query(conn, sql));
+	retval = execute_change_number_reservation(conn, sql, count, first);
 
 	talloc_free(mem_ctx);
 	return retval;
@@ -833,16 +835,9 @@ static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self,
 					    const char *username,
 					    uint64_t *cn)
 {
-	MYSQL		*conn;
 	enum MAPISTATUS	retval;
 
-	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
-
-	retval = get_server_change_number(conn, username, cn);
-	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
-
-	retval = set_server_change_number(conn, username, (*cn) + 1);
+	retval = reserve_changeNumbers(self, username, 1, cn);
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
 	// Transform the number the way exchange protocol likes it
@@ -857,30 +852,25 @@ static enum MAPISTATUS get_new_changeNumbers(struct openchangedb_context *self,
 					     uint64_t max,
 					     struct UI8Array_r **cns_p)
 {
-	MYSQL			*conn;
 	enum MAPISTATUS		retval;
 	struct UI8Array_r	*cns;
 	uint64_t		cn = 0;
 	size_t			count = 0;
 
-	conn = self->data;
-	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
-
-	retval = get_server_change_number(conn, username, &cn);
+	retval = reserve_changeNumbers(self, username, max, &cn);
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
 	// Transform the numbers the way exchange protocol likes it
 	cns = talloc_zero(mem_ctx, struct UI8Array_r);
+	OPENCHANGE_RETVAL_IF(!cns, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	cns->cValues = max;
 	cns->lpui8 = talloc_array(cns, uint64_t, max);
+	OPENCHANGE_RETVAL_IF(!cns->lpui8, MAPI_E_NOT_ENOUGH_MEMORY, cns);
 
 	for (count = 0; count < max; count++) {
 		cns->lpui8[count] = (exchange_globcnt(cn + count) << 16) | 0x0001;
 	}
 
-	retval = set_server_change_number(conn, username, cn + max);
-	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
-
 	*cns_p = cns;
 
 	return retval;
@@ -1106,7 +1096,8 @@ static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
 	enum MAPISTATUS	retval = MAPI_E_SUCCESS;
-	char		*sql = NULL;
+	const char	*sql = NULL;
+	MYSQL_BIND	params[3];
 	uint64_t	mailbox_id = 0, mailbox_folder_id = 0;
 	uint64_t	*n = NULL;
 	const char	*attr, *value;
@@ -1142,25 +1133,26 @@ static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 			goto end;
 		}
 
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT fp.value FROM folders_properties fp "
-			"JOIN folders f ON f.id = fp.folder_id "
-			"  AND f.folder_class = '"PUBLIC_FOLDER"'"
-			"  AND f.folder_id = %"PRIu64" "
-			"JOIN mailboxes m ON m.ou_id = f.ou_id"
-			"  AND m.name = '%s' "
-			"WHERE fp.name = '%s'",
-			fid, _sql(mem_ctx, username), _sql(mem_ctx, attr));
+		sql = "SELECT fp.value FROM folders_properties fp "
+		      "JOIN folders f ON f.id = fp.folder_id "
+		      "  AND f.folder_class = '"PUBLIC_FOLDER"'"
+		      "  AND f.folder_id = ? "
+		      "JOIN mailboxes m ON m.ou_id = f.ou_id"
+		      "  AND m.name = ? "
+		      "WHERE fp.name = ?";
+		stmt_bind_uint64(&params[0], &fid);
+		stmt_bind_string(&params[1], username);
+		stmt_bind_string(&params[2], attr);
 	} else {
 		// system folder
 		retval = get_mailbox_ids_by_name(conn, username, &mailbox_id, &mailbox_folder_id, NULL);
 		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 
 		if (mailbox_folder_id == fid) {
-			sql = talloc_asprintf(mem_ctx,
-				"SELECT mp.value FROM mailboxes_properties mp "
-				"WHERE mp.mailbox_id = %"PRIu64" AND mp.name = '%s'",
-				mailbox_id, _sql(mem_ctx, attr));
+			sql = "SELECT mp.value FROM mailboxes_properties mp "
+			      "WHERE mp.mailbox_id = ? AND mp.name = ?";
+			stmt_bind_uint64(&params[0], &mailbox_id);
+			stmt_bind_string(&params[1], attr);
 		} else if (proptag == PidTagParentFolderId) {
 			n = talloc_zero(parent_ctx, uint64_t);
 			OPENCHANGE_RETVAL_IF(!n, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
@@ -1169,17 +1161,17 @@ static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 			*data = (void *) n;
 			goto end;
 		} else {
-			sql = talloc_asprintf(mem_ctx,
-				"SELECT fp.value FROM folders_properties fp "
-				"JOIN folders f ON f.id = fp.folder_id "
-				"  AND f.mailbox_id = %"PRIu64" "
-				"  AND f.folder_id = %"PRIu64" "
-				"WHERE fp.name = '%s'",
-				mailbox_id, fid, _sql(mem_ctx, attr));
+			sql = "SELECT fp.value FROM folders_properties fp "
+			      "JOIN folders f ON f.id = fp.folder_id "
+			      "  AND f.mailbox_id = ? "
+			      "  AND f.folder_id = ? "
+			      "WHERE fp.name = ?";
+			stmt_bind_uint64(&params[0], &mailbox_id);
+			stmt_bind_uint64(&params[1], &fid);
+			stmt_bind_string(&params[2], attr);
 		}
 	}
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-	retval = status(select_first_string(mem_ctx, conn, sql, &value));
+	retval = status(select_stmt_first_string(mem_ctx, conn, sql, params, &value));
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 	// Transform string into the expected data type
 	*data = get_property_data(parent_ctx, proptag, value);
@@ -1691,6 +1683,11 @@ static enum MAPISTATUS create_mailbox(struct openchangedb_context *self,
 	retval = status(select_first_uint(conn, sql, &ou_id));
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 
+	// Reserve the change number first: it resets LAST_INSERT_ID()
+	retval = reserve_ou_changeNumbers(conn, ou_id, 1, &change_number);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
+	change_number = (exchange_globcnt(change_number) << 16) | 0x0001;
+
 	// Insert row in mailboxes
 	guid = GUID_random();
 	mailbox_guid = GUID_string(mem_ctx, &guid);
@@ -1742,8 +1739,6 @@ static enum MAPISTATUS create_mailbox(struct openchangedb_context *self,
 	l = str_list_add(l, value);
 	OPENCHANGE_RETVAL_IF(!l, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 
-	retval = get_new_changeNumber(self, username, &change_number);
-	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 	value = talloc_asprintf(mem_ctx,
 		"(LAST_INSERT_ID(), 'PidTagChangeNumber', '%"PRIu64"')", change_number);
 	OPENCHANGE_RETVAL_IF(!value, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
@@ -3020,6 +3015,223 @@ end:
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Fetch in a single query the properties of a set of table
+   rows which are stored in the messages_properties or
+   folders_properties tables
+
+   \param mem_ctx pointer to the memory context
+   \param conn pointer to the MySQL connection
+   \param table pointer to the openchangedb table
+   \param rows the rows to fill
+   \param row_ids the database identifiers of the rows
+   \param count number of elements in rows and row_ids
+   \param props the requested columns
+   \param columns the property tags stored in the database for each
+   column, 0 for columns which are not read from the database
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS _table_fetch_rows_properties(TALLOC_CTX *mem_ctx,
+						    MYSQL *conn,
+						    struct openchangedb_table *table,
+						    struct openchangedb_table_row *rows,
+						    uint64_t *row_ids, uint32_t count,
+						    struct SPropTagArray *props,
+						    enum MAPITAGS *columns)
+{
+	char			*sql;
+	const char		*attr;
+	bool			is_message, first;
+	MYSQL_RES		*res = NULL;
+	MYSQL_ROW		row;
+	enum MYSQLRESULT	ret;
+	uint64_t		id;
+	uint32_t		i, j, k;
+
+	is_message = table->table_type == 0x3 || table->table_type == 0x2;
+
+	if (is_message) {
+		sql = talloc_strdup(mem_ctx, "SELECT message_id, name, value FROM messages_properties WHERE message_id IN (");
+	} else {
+		sql = talloc_strdup(mem_ctx, "SELECT folder_id, name, value FROM folders_properties WHERE folder_id IN (");
+	}
+	first = true;
+	for (i = 0; i < count; i++) {
+		if (!rows[i].data) continue;
+		sql = talloc_asprintf_append(sql, "%s%"PRIu64, first ? "" : ",", row_ids[i]);
+		first = false;
+	}
+	/* No row matches the restrictions */
+	if (first) return MAPI_E_SUCCESS;
+
+	sql = talloc_asprintf_append(sql, ") AND name IN (");
+	first = true;
+	for (i = 0; i < props->cValues; i++) {
+		if (!columns[i]) continue;
+		attr = openchangedb_property_get_attribute(columns[i]);
+		if (!attr) continue;
+		sql = talloc_asprintf_append(sql, "%s'%s'", first ? "" : ",", attr);
+		first = false;
+	}
+	/* All the columns are computed or unknown */
+	if (first) return MAPI_E_SUCCESS;
+	sql = talloc_asprintf_append(sql, ")");
+	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	ret = select_without_fetch(conn, sql, &res);
+	if (ret == MYSQL_NOT_FOUND) return MAPI_E_SUCCESS;
+	OPENCHANGE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPI_E_CALL_FAILED, NULL);
+
+	while ((row = mysql_fetch_row(res)) != NULL) {
+		if (!convert_string_to_ull(row[0], &id)) continue;
+		for (j = 0; j < count; j++) {
+			if (!rows[j].data || row_ids[j] != id) continue;
+			for (k = 0; k < props->cValues; k++) {
+				if (!columns[k] || rows[j].data[k]) continue;
+				attr = openchangedb_property_get_attribute(columns[k]);
+				if (!attr || strcmp(attr, row[1])) continue;
+				rows[j].data[k] = get_property_data(rows[j].data, columns[k], row[2]);
+				rows[j].retvals[k] = rows[j].data[k] ? MAPI_E_SUCCESS : MAPI_E_NOT_FOUND;
+			}
+		}
+	}
+	mysql_free_result(res);
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS table_get_rows(TALLOC_CTX *mem_ctx,
+				      struct openchangedb_context *self,
+				      void *_table,
+				      struct SPropTagArray *props,
+				      uint32_t pos, uint32_t count,
+				      bool live_filtered,
+				      struct openchangedb_table_row **rowsp,
+				      uint32_t *row_countp)
+{
+	struct openchangedb_table		*table = (struct openchangedb_table *)_table;
+	struct openchangedb_table_row		*rows;
+	TALLOC_CTX				*local_mem_ctx;
+	enum MAPISTATUS				retval;
+	enum MAPITAGS				*columns;
+	enum MAPITAGS				proptag;
+	uint64_t				*row_ids;
+	uint64_t				*fid;
+	uint32_t				i, j;
+	bool					is_message;
+	MYSQL					*conn;
+
+	conn = self->data;
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
+
+	/* Fetch results */
+	if (!table->res) {
+		retval = _table_fetch_results(conn, table, live_filtered);
+		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
+	}
+
+	// Ensure position is within search results range
+	OPENCHANGE_RETVAL_IF(pos >= table->res->count, MAPI_E_INVALID_OBJECT, NULL);
+	if (count > table->res->count - pos) {
+		count = table->res->count - pos;
+	}
+	is_message = table->table_type == 0x3 || table->table_type == 0x2;
+
+	local_mem_ctx = talloc_named(NULL, 0, "table_get_rows");
+	OPENCHANGE_RETVAL_IF(!local_mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	columns = talloc_zero_array(local_mem_ctx, enum MAPITAGS, props->cValues);
+	row_ids = talloc_array(local_mem_ctx, uint64_t, count);
+	rows = talloc_zero_array(mem_ctx, struct openchangedb_table_row, count);
+	OPENCHANGE_RETVAL_IF(!columns || !row_ids || !rows, MAPI_E_NOT_ENOUGH_MEMORY, local_mem_ctx);
+
+	for (i = 0; i < count; i++) {
+		if (is_message) {
+			rows[i].fmid = table->res->messages[pos + i]->mid;
+			row_ids[i] = table->res->messages[pos + i]->id;
+		} else {
+			rows[i].fmid = table->res->folders[pos + i]->fid;
+			row_ids[i] = table->res->folders[pos + i]->id;
+		}
+
+		/* If live filtering, make sure the row match the restrictions */
+		if (live_filtered && !_table_check_match_restrictions(conn, table, pos + i)) {
+			continue;
+		}
+
+		rows[i].data = talloc_zero_array(rows, void *, props->cValues);
+		rows[i].retvals = talloc_array(rows, enum MAPISTATUS, props->cValues);
+		if (!rows[i].data || !rows[i].retvals) {
+			talloc_free(rows);
+			talloc_free(local_mem_ctx);
+			return MAPI_E_NOT_ENOUGH_MEMORY;
+		}
+		for (j = 0; j < props->cValues; j++) {
+			rows[i].retvals[j] = MAPI_E_NOT_FOUND;
+		}
+	}
+
+	/* Columns available without reading the properties tables */
+	for (j = 0; j < props->cValues; j++) {
+		// workarounds for some specific attributes
+		proptag = props->aulPropTag[j];
+		if (proptag == PR_INST_ID) {
+			proptag = table->table_type == 1 ? PR_FID : PR_MID;
+		}
+
+		for (i = 0; i < count; i++) {
+			if (!rows[i].data) continue;
+
+			if (proptag == PR_INSTANCE_NUM) {
+				rows[i].data[j] = talloc_zero(rows[i].data, uint32_t);
+			} else if ((table->table_type != 0x1) && proptag == PR_FID) {
+				fid = talloc_zero(rows[i].data, uint64_t);
+				if (fid) *fid = table->folder_id;
+				rows[i].data[j] = fid;
+			} else if (!is_message && proptag == PidTagFolderId) {
+				rows[i].data[j] = get_property_data(rows[i].data, proptag,
+								    talloc_asprintf(local_mem_ctx, "%"PRIu64, rows[i].fmid));
+				rows[i].retvals[j] = rows[i].data[j] ? MAPI_E_SUCCESS : MAPI_E_NOT_FOUND;
+				continue;
+			} else if (is_message && proptag == PidTagMid) {
+				rows[i].data[j] = get_property_data(rows[i].data, proptag,
+								    talloc_asprintf(local_mem_ctx, "%"PRIu64, rows[i].fmid));
+				rows[i].retvals[j] = rows[i].data[j] ? MAPI_E_SUCCESS : MAPI_E_NOT_FOUND;
+				continue;
+			} else if (is_message && proptag == PidTagNormalizedSubject) {
+				rows[i].data[j] = get_property_data(rows[i].data, proptag,
+								    table->res->messages[pos + i]->normalized_subject);
+				rows[i].retvals[j] = rows[i].data[j] ? MAPI_E_SUCCESS : MAPI_E_NOT_FOUND;
+				continue;
+			} else {
+				// Check if this is a "special property"
+				rows[i].data[j] = _get_special_property(rows[i].data, proptag);
+				if (rows[i].data[j]) {
+					rows[i].retvals[j] = MAPI_E_SUCCESS;
+				} else {
+					columns[j] = proptag;
+				}
+				continue;
+			}
+
+			rows[i].retvals[j] = rows[i].data[j] ? MAPI_E_SUCCESS : MAPI_E_NOT_ENOUGH_MEMORY;
+		}
+	}
+
+	/* Everything else comes from a single query for the whole page */
+	retval = _table_fetch_rows_properties(local_mem_ctx, conn, table, rows, row_ids, count, props, columns);
+	talloc_free(local_mem_ctx);
+	if (retval != MAPI_E_SUCCESS) {
+		talloc_free(rows);
+		return retval;
+	}
+
+	*rowsp = rows;
+	*row_countp = count;
+
+	return MAPI_E_SUCCESS;
+}
+
 // ^ openchangedb table -------------------------------------------------------
 
 // v openchangedb message -----------------------------------------------------
@@ -3684,6 +3896,7 @@ enum MAPISTATUS openchangedb_mysql_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->table_set_sort_order = table_set_sort_order;
 	oc_ctx->table_set_restrictions = table_set_restrictions;
 	oc_ctx->table_get_property = table_get_property;
+	oc_ctx->table_get_rows = table_get_rows;
 
 	oc_ctx->message_create = message_create;
 	oc_ctx->message_save = message_save;
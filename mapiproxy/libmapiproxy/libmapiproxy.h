@@ -78,6 +78,56 @@ struct mpm_session {
 };
 
 
+struct mpm_session_registry_stats {
+	uint32_t	live;
+	uint64_t	lookups;
+	uint64_t	misses;
+	uint64_t	evictions;
+};
+
+
+struct mpm_session_registry;
+
+/* Default number of seconds a session can stay unused before being
+ * evicted, overridden by dcerpc_mapiproxy:session_idle_timeout */
+#define	MPM_SESSION_IDLE_TIMEOUT	3600
+
+
+/* Layout of the per-ROP counters shared through the file set by
+ * dcerpc_mapiproxy:rop_stats */
+#define	MPM_ROP_STATS_OPNUMS		256
+#define	MPM_ROP_STATS_BUCKETS		128
+
+struct mpm_rop_stats_entry {
+	uint64_t	calls;
+	uint64_t	errors;
+	uint64_t	bytes_in;
+	uint64_t	bytes_out;
+	uint64_t	usec_total;
+	uint64_t	usec_max;
+	uint64_t	latency[MPM_ROP_STATS_BUCKETS];
+};
+
+
+struct mpm_rop_stats;
+
+
+/* Counters of the process-wide pool of backend handles */
+struct mpm_shared_stats {
+	uint32_t	entries;
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	invalidations;
+	uint64_t	evictions;
+};
+
+/* Default number of seconds a pooled object nobody borrows is kept,
+ * overridden by mapiproxy:shared_idle_timeout */
+#define	MPM_SHARED_IDLE_TIMEOUT		300
+
+typedef void *(*mpm_shared_open_fn)(TALLOC_CTX *, void *);
+
+
 struct auth_serversupplied_info 
 {
 	struct dom_sid	*account_sid;
@@ -119,21 +169,38 @@ struct mapi_handles {
 	uint32_t	       	handle;
 	uint32_t		parent_handle;
 	void		       	*private_data;
+	struct mapi_handles	*parent;
+	struct mapi_handles	*children;
 	struct mapi_handles	*prev;
 	struct mapi_handles	*next;
 };
 
 
+struct mapi_handles_slot {
+	struct mapi_handles	*rec;
+	uint32_t		generation;
+	uint32_t		next_free;
+};
+
+
 struct mapi_handles_context {
-	TDB_CONTEXT	       	*tdb_ctx;
-	uint32_t		last_handle;
-	struct mapi_handles    	*handles;
+	struct mapi_handles_slot	*slots;
+	uint32_t			slots_count;
+	uint32_t			last_handle;
+	uint32_t			free_index;
+	uint32_t			count;
+	struct mapi_handles    		*handles;
 };
 
 
-#define	MAPI_HANDLES_RESERVED	0xFFFFFFFF
-#define	MAPI_HANDLES_ROOT	"root"
-#define	MAPI_HANDLES_NULL	"null"
+/* A MAPI handle is made of a slot index (low 24 bits) and a
+ * generation counter (high 8 bits) bumped each time the slot is
+ * released, so a stale handle never resolves to a recycled slot */
+#define	MAPI_HANDLES_RESERVED		0xFFFFFFFF
+#define	MAPI_HANDLES_INDEX_BITS		24
+#define	MAPI_HANDLES_INDEX_MASK		0x00FFFFFF
+#define	MAPI_HANDLES_GENERATION_MAX	0xFE
+#define	MAPI_HANDLES_SLOTS_INIT		64
 
 
 /**
@@ -196,8 +263,42 @@ bool mpm_session_release(struct mpm_session *);
 bool mpm_session_cmp_sub(struct mpm_session *, struct server_id, uint32_t);
 bool mpm_session_cmp(struct mpm_session *, struct dcesrv_call_state *);
 
+/* definitions from session_registry.c */
+struct mpm_session_registry *mpm_session_registry_init(TALLOC_CTX *, const char *, uint32_t);
+bool mpm_session_registry_add(struct mpm_session_registry *, const struct GUID *, struct mpm_session *);
+struct mpm_session *mpm_session_registry_find(struct mpm_session_registry *, const struct GUID *);
+enum MAPISTATUS mpm_session_registry_hold(struct mpm_session_registry *, const struct GUID *, TALLOC_CTX *);
+enum MAPISTATUS mpm_session_registry_release(struct mpm_session_registry *, const struct GUID *);
+uint32_t mpm_session_registry_expire(struct mpm_session_registry *, time_t);
+enum MAPISTATUS mpm_session_registry_get_stats(struct mpm_session_registry *, struct mpm_session_registry_stats *);
+
+/* definitions from rop_stats.c */
+struct mpm_rop_stats *mpm_rop_stats_init(TALLOC_CTX *, const char *, bool);
+uint32_t mpm_rop_stats_bucket(uint64_t);
+uint64_t mpm_rop_stats_bucket_usec(uint32_t);
+void mpm_rop_stats_record(struct mpm_rop_stats *, uint8_t, uint64_t, uint32_t, uint32_t, bool);
+enum MAPISTATUS mpm_rop_stats_get(struct mpm_rop_stats *, uint8_t, struct mpm_rop_stats_entry *);
+time_t mpm_rop_stats_reset_time(struct mpm_rop_stats *);
+enum MAPISTATUS mpm_rop_stats_reset(struct mpm_rop_stats *);
+uint64_t mpm_rop_stats_percentile(const struct mpm_rop_stats_entry *, double);
+
+/* definitions from shared_pool.c */
+void *mpm_shared_get(TALLOC_CTX *, const char *, const char *, mpm_shared_open_fn, void *);
+int mpm_shared_release(TALLOC_CTX *, void *);
+uint32_t mpm_shared_invalidate(const char *);
+void mpm_shared_set_idle_timeout(uint32_t);
+enum MAPISTATUS mpm_shared_get_stats(struct mpm_shared_stats *);
+
 struct openchangedb_context;
 
+/* A row returned by openchangedb_table_get_rows. data and retvals
+ * are NULL when the row does not match the table restrictions */
+struct openchangedb_table_row {
+	uint64_t		fmid;
+	void			**data;
+	enum MAPISTATUS		*retvals;
+};
+
 /* definitions from openchangedb.c */
 enum MAPISTATUS openchangedb_initialize(TALLOC_CTX *, struct loadparm_context *, struct openchangedb_context **oc_ctx);
 enum MAPISTATUS openchangedb_get_new_changeNumber(struct openchangedb_context *, const char *, uint64_t *);
@@ -250,6 +351,7 @@ enum MAPISTATUS openchangedb_table_init(TALLOC_CTX *, struct openchangedb_contex
 enum MAPISTATUS openchangedb_table_set_sort_order(struct openchangedb_context *, void *, struct SSortOrderSet *);
 enum MAPISTATUS openchangedb_table_set_restrictions(struct openchangedb_context *, void *, struct mapi_SRestriction *);
 enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *, struct openchangedb_context *, void *, enum MAPITAGS, uint32_t, bool, void **);
+enum MAPISTATUS openchangedb_table_get_rows(TALLOC_CTX *, struct openchangedb_context *, void *, struct SPropTagArray *, uint32_t, uint32_t, bool, struct openchangedb_table_row **, uint32_t *);
 
 /* definitions from openchangedb_message.c */
 enum MAPISTATUS openchangedb_message_open(TALLOC_CTX *, struct openchangedb_context *, const char *, uint64_t, uint64_t, void **, void **);
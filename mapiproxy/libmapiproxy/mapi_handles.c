@@ -46,11 +46,19 @@ _PUBLIC_ struct mapi_handles_context *mapi_handles_init(TALLOC_CTX *mem_ctx)
 	handles_ctx = talloc_zero(mem_ctx, struct mapi_handles_context);
 	if (!handles_ctx) return NULL;
 
-	/* Step 2. Initialize the TDB context */
-	handles_ctx->tdb_ctx = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
+	/* Step 2. Initialize the slots array. Slot 0 is never used so
+	 * handle 0 keeps meaning "no container" */
+	handles_ctx->slots = talloc_zero_array(handles_ctx, struct mapi_handles_slot, MAPI_HANDLES_SLOTS_INIT);
+	if (!handles_ctx->slots) {
+		talloc_free(handles_ctx);
+		return NULL;
+	}
+	handles_ctx->slots_count = MAPI_HANDLES_SLOTS_INIT;
 
-	/* Step 3. Initialize the handles list */
+	/* Step 3. Initialize the root handles list */
 	handles_ctx->handles = NULL;
+	handles_ctx->free_index = 0;
+	handles_ctx->count = 0;
 
 	/* Step 4. Set last_handle to the first valid value */
 	handles_ctx->last_handle = 1;
@@ -71,7 +79,6 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 
-	tdb_close(handles_ctx->tdb_ctx);
 	talloc_free(handles_ctx);
 
 	return MAPI_E_SUCCESS;
@@ -79,180 +86,127 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 
 
 /**
-   \details Search for a record in the TDB database
+   \details Return the slot referenced by a MAPI handle if the handle
+   is currently in use
 
    \param handles_ctx pointer to the MAPI handles context
    \param handle MAPI handle to lookup
-   \param rec pointer to the MAPI handle structure the function
-   returns
-   
-   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+
+   \return pointer to the slot on success, otherwise NULL
  */
-_PUBLIC_ enum MAPISTATUS mapi_handles_search(struct mapi_handles_context *handles_ctx,
-					     uint32_t handle, struct mapi_handles **rec)
+static struct mapi_handles_slot *mapi_handles_get_slot(struct mapi_handles_context *handles_ctx,
+						       uint32_t handle)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	struct mapi_handles	*el;
-
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
-	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_search");
-
-	/* Step 1. Search for the handle within TDB database */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
+	struct mapi_handles_slot	*slot;
+	uint32_t			index;
 
-	dbuf = tdb_fetch(handles_ctx->tdb_ctx, key);
-	talloc_free(key.dptr);
-	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, mem_ctx);
-	OPENCHANGE_RETVAL_IF(!dbuf.dsize, MAPI_E_NOT_FOUND, mem_ctx);
-
-	talloc_free(mem_ctx);
-	/* Ensure this is not a free'd record */
-	if (dbuf.dsize == (sizeof(MAPI_HANDLES_NULL) - 1) && !strncmp((char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize)) {
-		free(dbuf.dptr);
-		return MAPI_E_NOT_FOUND;
+	index = handle & MAPI_HANDLES_INDEX_MASK;
+	if (!index || index >= handles_ctx->last_handle) {
+		return NULL;
 	}
-	free(dbuf.dptr);
 
-	/* Step 2. Return the record within the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			*rec = el;
-			return MAPI_E_SUCCESS;
-		}
+	slot = &handles_ctx->slots[index];
+	if (!slot->rec || slot->generation != (handle >> MAPI_HANDLES_INDEX_BITS)) {
+		return NULL;
 	}
 
-	return MAPI_E_CORRUPT_STORE;
+	return slot;
 }
 
 
 /**
-   \details Set a TDB record data as null meaning it can be reused in
-   the future.
+   \details Search for a MAPI handle record
 
    \param handles_ctx pointer to the MAPI handles context
-   \param handle handle key value to free
-
+   \param handle MAPI handle to lookup
+   \param rec pointer to the MAPI handle structure the function
+   returns
+   
    \return MAPI_E_SUCCESS on success, otherwise MAPI error
  */
-static enum MAPISTATUS mapi_handles_tdb_free(struct mapi_handles_context *handles_ctx,
-					     uint32_t handle)
+_PUBLIC_ enum MAPISTATUS mapi_handles_search(struct mapi_handles_context *handles_ctx,
+					     uint32_t handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	int			ret;
+	struct mapi_handles_slot	*slot;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_free");
-	
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update existing record */
-	dbuf.dptr = (unsigned char *)MAPI_HANDLES_NULL;
-	dbuf.dsize = sizeof(MAPI_HANDLES_NULL) - 1;
-
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		DEBUG(3, ("[%s:%d]: Unable to create 0x%x record: %s\n", __FUNCTION__, __LINE__,
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx)));
-		return MAPI_E_CORRUPT_STORE;
-	}
+	slot = mapi_handles_get_slot(handles_ctx, handle);
+	OPENCHANGE_RETVAL_IF(!slot, MAPI_E_NOT_FOUND, NULL);
+
+	*rec = slot->rec;
 
 	return MAPI_E_SUCCESS;
 }
 
 
 /**
-   \details Update a TDB record
+   \details Reserve a free slot, reusing released slots first and
+   growing the slots array when needed
 
-   
+   \param handles_ctx pointer to the MAPI handles context
+   \param index pointer to the slot index the function returns
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
  */
-static enum MAPISTATUS mapi_handles_tdb_update(struct mapi_handles_context *handles_ctx,
-					       uint32_t handle, uint32_t container_handle)
+static enum MAPISTATUS mapi_handles_slot_alloc(struct mapi_handles_context *handles_ctx,
+					       uint32_t *index)
 {
-	TALLOC_CTX	*mem_ctx;
-	TDB_DATA	key;
-	TDB_DATA	dbuf;
-	int		ret;
-
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handle, MAPI_E_INVALID_PARAMETER, NULL);
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_update");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update record */
-	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-	dbuf.dsize = strlen((const char *)dbuf.dptr);
+	struct mapi_handles_slot	*slots;
+	uint32_t			slots_count;
+
+	/* Step 1. Reuse the most recently released slot */
+	if (handles_ctx->free_index) {
+		*index = handles_ctx->free_index;
+		handles_ctx->free_index = handles_ctx->slots[*index].next_free;
+		handles_ctx->slots[*index].next_free = 0;
+		DEBUG(5, ("We have found free slot 0x%x\n", *index));
+		return MAPI_E_SUCCESS;
+	}
 
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		DEBUG(3, ("[%s:%d]: Unable to update 0x%x record: %s\n", __FUNCTION__, __LINE__,
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx)));
+	/* Step 2. Otherwise take the next never used slot */
+	OPENCHANGE_RETVAL_IF(handles_ctx->last_handle > MAPI_HANDLES_INDEX_MASK, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
 
-		return MAPI_E_CORRUPT_STORE;	
+	if (handles_ctx->last_handle >= handles_ctx->slots_count) {
+		slots_count = handles_ctx->slots_count * 2;
+		if (slots_count > MAPI_HANDLES_INDEX_MASK + 1) {
+			slots_count = MAPI_HANDLES_INDEX_MASK + 1;
+		}
+		slots = talloc_realloc(handles_ctx, handles_ctx->slots, struct mapi_handles_slot, slots_count);
+		OPENCHANGE_RETVAL_IF(!slots, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+		memset(&slots[handles_ctx->slots_count], 0,
+		       (slots_count - handles_ctx->slots_count) * sizeof (struct mapi_handles_slot));
+		handles_ctx->slots = slots;
+		handles_ctx->slots_count = slots_count;
 	}
 
+	*index = handles_ctx->last_handle;
+	handles_ctx->last_handle += 1;
+
 	return MAPI_E_SUCCESS;
 }
 
 
 /**
-   \details Traverse TDB database and search for the first record
-   which dbuf value is "null" string.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key
-   \param dbuf the current TDB value
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
-				      TDB_DATA key, TDB_DATA dbuf,
-				      void *state)
-{
-	TALLOC_CTX	*mem_ctx;
-	uint32_t	*handle = (uint32_t *) state;
-	char		*handle_str = NULL;
-
-	if (dbuf.dptr && (dbuf.dsize == sizeof(MAPI_HANDLES_NULL) - 1) && strncmp((const char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize) == 0) {
-		mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_null");
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		*handle = strtol((const char *) handle_str, NULL, 16);
-		talloc_free(mem_ctx);
+   \details Give a slot back to the free list and bump its generation
+   so handles previously pointing to it become invalid
 
-		return 1;
-	}
+   \param handles_ctx pointer to the MAPI handles context
+   \param index the slot index to release
+ */
+static void mapi_handles_slot_free(struct mapi_handles_context *handles_ctx,
+				   uint32_t index)
+{
+	struct mapi_handles_slot	*slot = &handles_ctx->slots[index];
 
-	return 0;
+	slot->rec = NULL;
+	slot->generation = (slot->generation >= MAPI_HANDLES_GENERATION_MAX) ? 0 : slot->generation + 1;
+	slot->next_free = handles_ctx->free_index;
+	handles_ctx->free_index = index;
 }
 
 
@@ -270,84 +224,47 @@ static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_add(struct mapi_handles_context *handles_ctx,
 					  uint32_t container_handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
-	enum MAPISTATUS		retval;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	uint32_t		handle = 0;
-	struct mapi_handles	*el;
-	int			ret;
+	enum MAPISTATUS			retval;
+	struct mapi_handles_slot	*slot;
+	struct mapi_handles_slot	*parent_slot = NULL;
+	struct mapi_handles		*el;
+	uint32_t			index;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_add");
-
-	/* Step 1. Seek the TDB database for the first free record */
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_null, (void *)&handle);
-	if (ret > -1 && handle > 0) {
-		DEBUG(5, ("We have found free record 0x%x\n", handle));
-		retval = mapi_handles_tdb_update(handles_ctx, handle, container_handle);
-		OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
-		
-		el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
-		if (!el) {
-			mapi_handles_tdb_free(handles_ctx, handle);
-			talloc_free(mem_ctx);
-			return MAPI_E_NOT_ENOUGH_RESOURCES;
-		}
-
-		el->handle = handle;
-		el->parent_handle = container_handle;
-		el->private_data = NULL;
-		*rec = el;
-		DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
-
-		talloc_free(mem_ctx);
-
-		return MAPI_E_SUCCESS;
-	}
+	el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
+	OPENCHANGE_RETVAL_IF(!el, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
 
-	/* Step 2. If no record is available, create a new one */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handles_ctx->last_handle);
-	key.dsize = strlen((const char *)key.dptr);
+	/* Step 1. Reserve a slot for the handle */
+	retval = mapi_handles_slot_alloc(handles_ctx, &index);
+	OPENCHANGE_RETVAL_IF(retval, retval, el);
 
-	if (container_handle) {
-		dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-		dbuf.dsize = strlen((const char *)dbuf.dptr);
-	} else {
-		dbuf.dptr = (unsigned char *) MAPI_HANDLES_ROOT;
-		dbuf.dsize = strlen(MAPI_HANDLES_ROOT);
-	}
+	slot = &handles_ctx->slots[index];
+	slot->rec = el;
 
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_INSERT);
-	if (ret == -1) {
-		DEBUG(3, ("[%s:%d]: Unable to create 0x%x record: %s\n", __FUNCTION__, __LINE__,
-			  handles_ctx->last_handle, tdb_errorstr(handles_ctx->tdb_ctx)));
-		talloc_free(mem_ctx);
+	el->handle = (slot->generation << MAPI_HANDLES_INDEX_BITS) | index;
+	el->parent_handle = container_handle;
+	el->private_data = NULL;
 
-		return MAPI_E_CORRUPT_STORE;
+	/* Step 2. Attach the handle to its container, or to the root
+	 * list when the container is unknown */
+	if (container_handle && container_handle != MAPI_HANDLES_RESERVED) {
+		parent_slot = mapi_handles_get_slot(handles_ctx, container_handle);
 	}
-
-	el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
-	if (!el) {
-		mapi_handles_tdb_free(handles_ctx, handles_ctx->last_handle);
-		talloc_free(mem_ctx);
-		return MAPI_E_NOT_ENOUGH_RESOURCES;
+	if (parent_slot) {
+		el->parent = parent_slot->rec;
+		DLIST_ADD_END(el->parent->children, el, struct mapi_handles *);
+	} else {
+		el->parent = NULL;
+		DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
 	}
+	handles_ctx->count += 1;
 
-	el->handle = handles_ctx->last_handle;
-	el->parent_handle = container_handle;
-	el->private_data = NULL;
 	*rec = el;
-	DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
-
 	DEBUG(5, ("handle 0x%.2x is a father of 0x%.2x\n", container_handle, el->handle));
-	handles_ctx->last_handle += 1;
-	talloc_free(mem_ctx);
 
 	return MAPI_E_SUCCESS;
 }
@@ -396,55 +313,9 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_set_private_data(struct mapi_handles *hand
 }
 
 
-struct mapi_handles_private {
-	struct mapi_handles_context	*handles_ctx;
-	uint32_t			container_handle;
-};
-
 /**
-   \details Traverse TDB database and search for records
-   which dbuf value is set to state.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key (potential child handle)
-   \param dbuf the current TDB value (parent handle)
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
-					TDB_DATA key, TDB_DATA dbuf,
-					void *state)
-{
-	TALLOC_CTX			*mem_ctx;
-	struct mapi_handles_private	*handles_private = (struct mapi_handles_private *) state;
-	uint32_t			handle;
-	char				*container_handle_str = NULL;
-	char				*handle_str = NULL;
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_delete");
-	container_handle_str = talloc_asprintf(mem_ctx, "0x%x", handles_private->container_handle);
-
-	if (dbuf.dptr && strlen(container_handle_str) == dbuf.dsize && strncmp((const char *)dbuf.dptr, container_handle_str, dbuf.dsize) == 0) {
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		DEBUG(5, ("handles being released must NOT have child handles attached to them (%s is a child of %s)\n", handle_str, container_handle_str));
-		handle = strtol((const char *) handle_str, NULL, 16);
-		/* abort(); */
-		/* DEBUG(5, ("deleting child handle: %d, %s\n", handle, handle_str)); */
-		mapi_handles_delete(handles_private->handles_ctx, handle);
-	}
-
-	talloc_free(mem_ctx);
-
-	return 0;
-}
-
-
-
-/**
-   \details Remove the MAPI handle referenced by the handle parameter
-   from the double chained list and mark its associated TDB record as
-   null
+   \details Remove the MAPI handle referenced by the handle parameter,
+   release its slot and recursively delete its children handles
 
    \param handles_ctx pointer to the MAPI handles context
    \param handle the handle to delete
@@ -454,56 +325,48 @@ static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_delete(struct mapi_handles_context *handles_ctx, 
 					     uint32_t handle)
 {
-	TALLOC_CTX			*mem_ctx;
-	enum MAPISTATUS			retval;
-	TDB_DATA			key;
+	struct mapi_handles_slot	*slot;
 	struct mapi_handles		*el;
-	struct mapi_handles_private	handles_private;
-	int				ret;
-	bool				found = false;
+	struct mapi_handles		*children;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
 
-	DEBUG(4, ("[%s:%d]: Deleting MAPI handle 0x%x (handles_ctx: %p, tdb_ctx: %p)\n", __FUNCTION__, __LINE__,
-		  handle, handles_ctx, handles_ctx->tdb_ctx));
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_delete");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
+	DEBUG(4, ("[%s:%d]: Deleting MAPI handle 0x%x (handles_ctx: %p)\n", __FUNCTION__, __LINE__,
+		  handle, handles_ctx));
 
 	/* Step 1. Make sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Delete this record from the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			DLIST_REMOVE(handles_ctx->handles, el);
-			talloc_free(el);
-			found = true;
-			break;
-		}
+	slot = mapi_handles_get_slot(handles_ctx, handle);
+	OPENCHANGE_RETVAL_IF(!slot, MAPI_E_NOT_FOUND, NULL);
+	el = slot->rec;
+
+	/* Step 2. Detach the record from its container list */
+	if (el->parent) {
+		DLIST_REMOVE(el->parent->children, el);
+	} else {
+		DLIST_REMOVE(handles_ctx->handles, el);
 	}
-	/* This case should never occur */
-	OPENCHANGE_RETVAL_IF(found == false, MAPI_E_CORRUPT_STORE, mem_ctx);
 
-	/* Step 3. Free this record within the TDB database */
-	retval = mapi_handles_tdb_free(handles_ctx, handle);
-	/* if (retval) { */
-	/* 	abort(); */
-	/* } */
-	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+	/* Step 3. Release the slot and the record */
+	mapi_handles_slot_free(handles_ctx, handle & MAPI_HANDLES_INDEX_MASK);
+	handles_ctx->count -= 1;
 
-	/* Step 4. Delete hierarchy of children */
-	handles_private.handles_ctx = handles_ctx;
-	handles_private.container_handle = handle;
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_delete, (void *)&handles_private);
+	children = el->children;
+	el->children = NULL;
+	talloc_free(el);
 
-	talloc_free(mem_ctx);
+	/* Step 4. Delete hierarchy of children */
+	while (children) {
+		el = children;
+		DEBUG(5, ("handles being released must NOT have child handles attached to them (0x%x is a child of 0x%x)\n",
+			  el->handle, handle));
+		DLIST_REMOVE(children, el);
+		el->parent = NULL;
+		DLIST_ADD(handles_ctx->handles, el);
+		mapi_handles_delete(handles_ctx, el->handle);
+	}
 
 	DEBUG(4, ("[%s:%d]: Deleting MAPI handle 0x%x COMPLETE\n", __FUNCTION__, __LINE__, handle));
 
@@ -105,3 +105,42 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *mem_ctx,
 
 	return self->table_get_property(mem_ctx, self, table_object, proptag, pos, live_filtered, data);
 }
+
+/**
+   \details Retrieve a set of columns for count consecutive rows of an
+   openchangedb table
+
+   Backends fetch the whole page with a single query restricted to
+   the requested columns, rather than one query per property.
+
+   \param mem_ctx pointer to the memory context to use for allocation
+   \param self pointer to the openchangedb context
+   \param table_object pointer to the table object
+   \param props the columns to retrieve
+   \param pos index of the first row
+   \param count number of rows to retrieve
+   \param live_filtered whether restrictions are checked for each row
+   \param rowsp pointer on the array of rows to return
+   \param row_countp pointer on the number of rows returned, which
+   is lower than count at the end of the table
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_INVALID_OBJECT if pos is
+   past the end of the table, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_table_get_rows(TALLOC_CTX *mem_ctx,
+						     struct openchangedb_context *self,
+						     void *table_object,
+						     struct SPropTagArray *props,
+						     uint32_t pos,
+						     uint32_t count,
+						     bool live_filtered,
+						     struct openchangedb_table_row **rowsp,
+						     uint32_t *row_countp)
+{
+	OPENCHANGE_RETVAL_IF(!self, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!props || !rowsp || !row_countp, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!self->table_get_rows, MAPI_E_NO_SUPPORT, NULL);
+
+	return self->table_get_rows(mem_ctx, self, table_object, props, pos, count, live_filtered, rowsp, row_countp);
+}
@@ -0,0 +1,357 @@
+/*
+   MAPI Proxy
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "libmapiproxy.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+   \file rop_stats.c
+
+   \brief Per-ROP counters shared between server processes
+
+   Counters live in a fixed layout file mapped by every server
+   process. They are only ever incremented with atomic operations, so
+   no lock is needed on the hot path and readers such as the ropstats
+   tool can map the same file at any time.
+
+   Latencies are recorded in log-linear buckets: values below 8
+   microseconds have a bucket of their own, then each power of two is
+   split into 4 sub-buckets, which bounds the recording error to 25%.
+ */
+
+#define	MPM_ROP_STATS_MAGIC	0x5350524f /* "ORPS" */
+#define	MPM_ROP_STATS_VERSION	1
+#define	MPM_ROP_STATS_SUB_BITS	2
+
+struct mpm_rop_stats_file {
+	uint32_t			magic;
+	uint32_t			version;
+	uint32_t			opnums;
+	uint32_t			buckets;
+	uint64_t			reset_time;
+	struct mpm_rop_stats_entry	entries[MPM_ROP_STATS_OPNUMS];
+};
+
+struct mpm_rop_stats {
+	const char			*path;
+	bool				writable;
+	struct mpm_rop_stats_file	*file;
+};
+
+
+static int mpm_rop_stats_destructor(struct mpm_rop_stats *stats)
+{
+	if (stats->file) {
+		munmap(stats->file, sizeof (struct mpm_rop_stats_file));
+	}
+
+	return 0;
+}
+
+
+static bool mpm_rop_stats_file_valid(const struct mpm_rop_stats_file *file)
+{
+	return (file->magic == MPM_ROP_STATS_MAGIC &&
+		file->version == MPM_ROP_STATS_VERSION &&
+		file->opnums == MPM_ROP_STATS_OPNUMS &&
+		file->buckets == MPM_ROP_STATS_BUCKETS);
+}
+
+
+/**
+   \details Map the ROP statistics file. A writable mapping creates
+   the file, or initializes it when it is empty. Files which do not
+   match the current layout are never overwritten.
+
+   \param mem_ctx pointer to the memory context
+   \param path path to the statistics file
+   \param writable whether counters will be recorded or reset
+   through this mapping
+
+   \return Allocated statistics context on success, otherwise NULL
+ */
+struct mpm_rop_stats *mpm_rop_stats_init(TALLOC_CTX *mem_ctx,
+					 const char *path,
+					 bool writable)
+{
+	struct mpm_rop_stats	*stats;
+	struct stat		sb;
+	void			*addr;
+	bool			init = false;
+	int			fd;
+
+	if (!mem_ctx || !path) return NULL;
+
+	fd = open(path, writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+	if (fd == -1) {
+		DEBUG(0, ("[%s:%d]: unable to open %s: %s\n", __FUNCTION__, __LINE__,
+			  path, strerror(errno)));
+		return NULL;
+	}
+
+	/* Serialize layout checks between processes starting together */
+	if (writable) {
+		flock(fd, LOCK_EX);
+	}
+
+	if (fstat(fd, &sb) == -1) {
+		goto fail;
+	}
+
+	if (writable && sb.st_size == 0) {
+		if (ftruncate(fd, sizeof (struct mpm_rop_stats_file)) == -1) {
+			DEBUG(0, ("[%s:%d]: unable to resize %s: %s\n", __FUNCTION__, __LINE__,
+				  path, strerror(errno)));
+			goto fail;
+		}
+		init = true;
+	} else if (sb.st_size != sizeof (struct mpm_rop_stats_file)) {
+		DEBUG(0, ("[%s:%d]: %s is not a ROP statistics file\n", __FUNCTION__, __LINE__, path));
+		goto fail;
+	}
+
+	addr = mmap(NULL, sizeof (struct mpm_rop_stats_file),
+		    writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		DEBUG(0, ("[%s:%d]: unable to map %s: %s\n", __FUNCTION__, __LINE__,
+			  path, strerror(errno)));
+		goto fail;
+	}
+
+	stats = talloc_zero(mem_ctx, struct mpm_rop_stats);
+	if (!stats) {
+		munmap(addr, sizeof (struct mpm_rop_stats_file));
+		goto fail;
+	}
+	stats->path = talloc_strdup(stats, path);
+	stats->writable = writable;
+	stats->file = (struct mpm_rop_stats_file *) addr;
+	talloc_set_destructor(stats, mpm_rop_stats_destructor);
+
+	if (!init && !mpm_rop_stats_file_valid(stats->file)) {
+		DEBUG(0, ("[%s:%d]: %s has an unsupported layout\n", __FUNCTION__, __LINE__, path));
+		talloc_free(stats);
+		goto fail;
+	}
+
+	if (init) {
+		stats->file->opnums = MPM_ROP_STATS_OPNUMS;
+		stats->file->buckets = MPM_ROP_STATS_BUCKETS;
+		stats->file->version = MPM_ROP_STATS_VERSION;
+		stats->file->reset_time = time(NULL);
+		__sync_synchronize();
+		stats->file->magic = MPM_ROP_STATS_MAGIC;
+	}
+
+	close(fd);
+	return stats;
+
+fail:
+	close(fd);
+	return NULL;
+}
+
+
+/**
+   \details Return the latency bucket a duration falls in
+
+   \param usec duration in microseconds
+
+   \return bucket index, lower than MPM_ROP_STATS_BUCKETS
+ */
+uint32_t mpm_rop_stats_bucket(uint64_t usec)
+{
+	uint32_t	shift;
+	uint32_t	bucket;
+
+	if (usec < (2 << MPM_ROP_STATS_SUB_BITS)) {
+		return (uint32_t) usec;
+	}
+
+	shift = 63 - __builtin_clzll(usec);
+	bucket = ((shift - MPM_ROP_STATS_SUB_BITS + 1) << MPM_ROP_STATS_SUB_BITS) +
+		((usec >> (shift - MPM_ROP_STATS_SUB_BITS)) & ((1 << MPM_ROP_STATS_SUB_BITS) - 1));
+
+	return (bucket < MPM_ROP_STATS_BUCKETS) ? bucket : MPM_ROP_STATS_BUCKETS - 1;
+}
+
+
+/**
+   \details Return the lowest duration recorded in a latency bucket
+
+   \param bucket the bucket index
+
+   \return duration in microseconds
+ */
+uint64_t mpm_rop_stats_bucket_usec(uint32_t bucket)
+{
+	uint32_t	shift;
+	uint64_t	sub;
+
+	if (bucket < (2 << MPM_ROP_STATS_SUB_BITS)) {
+		return bucket;
+	}
+
+	shift = (bucket >> MPM_ROP_STATS_SUB_BITS) + MPM_ROP_STATS_SUB_BITS - 1;
+	sub = bucket & ((1 << MPM_ROP_STATS_SUB_BITS) - 1);
+
+	return ((1ULL << MPM_ROP_STATS_SUB_BITS) + sub) << (shift - MPM_ROP_STATS_SUB_BITS);
+}
+
+
+/**
+   \details Record a processed ROP. This function is safe to call
+   concurrently from several processes sharing the file.
+
+   \param stats pointer to the statistics context
+   \param opnum the ROP identifier
+   \param usec time spent processing the ROP in microseconds
+   \param bytes_in size of the ROP request
+   \param bytes_out size of the ROP response
+   \param failed whether the ROP returned an error
+ */
+void mpm_rop_stats_record(struct mpm_rop_stats *stats, uint8_t opnum, uint64_t usec,
+			  uint32_t bytes_in, uint32_t bytes_out, bool failed)
+{
+	struct mpm_rop_stats_entry	*entry;
+	uint64_t			max;
+
+	if (!stats || !stats->writable) return;
+
+	entry = &stats->file->entries[opnum];
+	__sync_fetch_and_add(&entry->calls, 1);
+	if (failed) {
+		__sync_fetch_and_add(&entry->errors, 1);
+	}
+	__sync_fetch_and_add(&entry->bytes_in, bytes_in);
+	__sync_fetch_and_add(&entry->bytes_out, bytes_out);
+	__sync_fetch_and_add(&entry->usec_total, usec);
+	__sync_fetch_and_add(&entry->latency[mpm_rop_stats_bucket(usec)], 1);
+
+	max = entry->usec_max;
+	while (usec > max && !__sync_bool_compare_and_swap(&entry->usec_max, max, usec)) {
+		max = entry->usec_max;
+	}
+}
+
+
+/**
+   \details Retrieve a snapshot of the counters of a ROP
+
+   \param stats pointer to the statistics context
+   \param opnum the ROP identifier
+   \param entry pointer to the structure receiving the counters
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_INVALID_PARAMETER
+ */
+enum MAPISTATUS mpm_rop_stats_get(struct mpm_rop_stats *stats, uint8_t opnum,
+				  struct mpm_rop_stats_entry *entry)
+{
+	OPENCHANGE_RETVAL_IF(!stats, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_INVALID_PARAMETER, NULL);
+
+	*entry = stats->file->entries[opnum];
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Return the time counters were last reset
+
+   \param stats pointer to the statistics context
+
+   \return reset time, or 0 if stats is not valid
+ */
+time_t mpm_rop_stats_reset_time(struct mpm_rop_stats *stats)
+{
+	if (!stats) return 0;
+
+	return (time_t) stats->file->reset_time;
+}
+
+
+/**
+   \details Clear all counters. ROPs recorded while the reset is in
+   progress may be partially accounted.
+
+   \param stats pointer to a writable statistics context
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_INVALID_PARAMETER
+ */
+enum MAPISTATUS mpm_rop_stats_reset(struct mpm_rop_stats *stats)
+{
+	OPENCHANGE_RETVAL_IF(!stats, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!stats->writable, MAPI_E_INVALID_PARAMETER, NULL);
+
+	memset(stats->file->entries, 0, sizeof (stats->file->entries));
+	stats->file->reset_time = time(NULL);
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Estimate a latency percentile from the histogram of a ROP
+
+   \param entry pointer to the ROP counters
+   \param percentile the percentile to compute, between 0 and 100
+
+   \return upper bound of the bucket holding the percentile in
+   microseconds, 0 if no call was recorded
+ */
+uint64_t mpm_rop_stats_percentile(const struct mpm_rop_stats_entry *entry, double percentile)
+{
+	uint64_t	total = 0;
+	uint64_t	rank;
+	uint64_t	count = 0;
+	uint64_t	upper;
+	uint32_t	i;
+
+	if (!entry) return 0;
+
+	for (i = 0; i < MPM_ROP_STATS_BUCKETS; i++) {
+		total += entry->latency[i];
+	}
+	if (!total) return 0;
+
+	rank = (uint64_t) (total * percentile / 100.0);
+	if (rank < total * percentile / 100.0) rank++;
+	if (rank < 1) rank = 1;
+
+	for (i = 0; i < MPM_ROP_STATS_BUCKETS; i++) {
+		count += entry->latency[i];
+		if (count >= rank) break;
+	}
+	if (i >= MPM_ROP_STATS_BUCKETS - 1) {
+		return entry->usec_max;
+	}
+
+	upper = mpm_rop_stats_bucket_usec(i + 1) - 1;
+	return (upper < entry->usec_max) ? upper : entry->usec_max;
+}
@@ -0,0 +1,391 @@
+/*
+   MAPI Proxy
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "libmapiproxy.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+
+#include <time.h>
+
+/**
+   \file session_registry.c
+
+   \brief Hash indexed session registry for mapiproxy servers
+
+   Sessions are indexed by the GUID of the RPC context handle
+   returned to the client at bind/connect time. The registry keeps
+   entries ordered by last access time, so idle sessions are found at
+   the head of the list and expiry stops at the first active one.
+
+   The session reference count tells how many EcDoConnect calls share
+   a session, it does not tell whether a client still uses it. Servers
+   hold sessions for as long as something can still reach them, such as
+   the RPC context handle of a connection or a parked call, and expiry
+   only frees sessions nobody holds.
+ */
+
+struct mpm_session_registry_entry {
+	struct GUID				uuid;
+	struct mpm_session			*session;
+	time_t					last_access;
+	uint32_t				holders;
+	struct mpm_session_registry_entry	*prev;
+	struct mpm_session_registry_entry	*next;
+};
+
+struct mpm_session_registry_hold {
+	struct mpm_session_registry		*registry;
+	struct GUID				uuid;
+	struct mpm_session_registry_hold	*prev;
+	struct mpm_session_registry_hold	*next;
+};
+
+struct mpm_session_registry {
+	const char				*name;
+	struct htable				ht;
+	uint32_t				idle_timeout;
+	struct mpm_session_registry_stats	stats;
+	struct mpm_session_registry_entry	*entries;
+	struct mpm_session_registry_hold	*holds;
+};
+
+
+/* FNV-1a over the GUID bytes: context handle GUIDs are random, so
+   this is enough to spread them over the table */
+static size_t mpm_session_registry_hash(const struct GUID *uuid)
+{
+	const uint8_t	*p = (const uint8_t *) uuid;
+	uint32_t	h = 2166136261U;
+	size_t		i;
+
+	for (i = 0; i < sizeof (struct GUID); i++) {
+		h = (h ^ p[i]) * 16777619U;
+	}
+
+	return h;
+}
+
+
+static size_t mpm_session_registry_rehash(const void *e, void *unused)
+{
+	const struct mpm_session_registry_entry	*entry = (const struct mpm_session_registry_entry *) e;
+
+	return mpm_session_registry_hash(&entry->uuid);
+}
+
+
+static bool mpm_session_registry_cmp(const void *e, void *uuid)
+{
+	const struct mpm_session_registry_entry	*entry = (const struct mpm_session_registry_entry *) e;
+
+	return GUID_equal(&entry->uuid, (const struct GUID *) uuid);
+}
+
+
+static int mpm_session_registry_destructor(struct mpm_session_registry *registry)
+{
+	struct mpm_session_registry_hold	*hold;
+
+	/* Holders may outlive the registry */
+	for (hold = registry->holds; hold; hold = hold->next) {
+		hold->registry = NULL;
+	}
+	htable_clear(&registry->ht);
+
+	return 0;
+}
+
+
+static void mpm_session_registry_remove(struct mpm_session_registry *registry,
+					struct mpm_session_registry_entry *entry)
+{
+	htable_del(&registry->ht, mpm_session_registry_hash(&entry->uuid), entry);
+	DLIST_REMOVE(registry->entries, entry);
+	registry->stats.live -= 1;
+	talloc_free(entry);
+}
+
+
+/**
+   \details Create a session registry
+
+   \param mem_ctx pointer to the memory context
+   \param name name of the server owning the registry, used for logging
+   \param idle_timeout number of seconds after which an unused session
+   is evicted, 0 disables expiry
+
+   \return Allocated registry on success, otherwise NULL
+ */
+struct mpm_session_registry *mpm_session_registry_init(TALLOC_CTX *mem_ctx,
+						       const char *name,
+						       uint32_t idle_timeout)
+{
+	struct mpm_session_registry	*registry;
+
+	if (!mem_ctx || !name) return NULL;
+
+	registry = talloc_zero(mem_ctx, struct mpm_session_registry);
+	if (!registry) return NULL;
+
+	registry->name = talloc_strdup(registry, name);
+	registry->idle_timeout = idle_timeout;
+	registry->entries = NULL;
+	htable_init(&registry->ht, mpm_session_registry_rehash, NULL);
+	talloc_set_destructor(registry, mpm_session_registry_destructor);
+
+	return registry;
+}
+
+
+/**
+   \details Register a session under the specified context handle
+   GUID. The registry takes ownership of the session.
+
+   \param registry pointer to the session registry
+   \param uuid pointer to the context handle GUID
+   \param session pointer to the mpm session to register
+
+   \return true on success, otherwise false
+ */
+bool mpm_session_registry_add(struct mpm_session_registry *registry,
+			      const struct GUID *uuid,
+			      struct mpm_session *session)
+{
+	struct mpm_session_registry_entry	*entry;
+
+	if (!registry || !uuid || !session) return false;
+
+	entry = talloc_zero(registry, struct mpm_session_registry_entry);
+	if (!entry) return false;
+
+	entry->uuid = *uuid;
+	entry->session = session;
+	entry->last_access = time(NULL);
+
+	if (!htable_add(&registry->ht, mpm_session_registry_hash(uuid), entry)) {
+		DEBUG(0, ("[%s:%d]: unable to add session to %s registry\n",
+			  __FUNCTION__, __LINE__, registry->name));
+		talloc_free(entry);
+		return false;
+	}
+
+	talloc_steal(entry, session);
+
+	DLIST_ADD_END(registry->entries, entry, struct mpm_session_registry_entry *);
+	registry->stats.live += 1;
+
+	return true;
+}
+
+
+/**
+   \details Find the session registered under the specified context
+   handle GUID and mark it as recently used.
+
+   \param registry pointer to the session registry
+   \param uuid pointer to the context handle GUID
+
+   \return Pointer to the mpm session on success, otherwise NULL
+ */
+struct mpm_session *mpm_session_registry_find(struct mpm_session_registry *registry,
+					      const struct GUID *uuid)
+{
+	struct mpm_session_registry_entry	*entry;
+
+	if (!registry || !uuid) return NULL;
+
+	registry->stats.lookups += 1;
+
+	entry = htable_get(&registry->ht, mpm_session_registry_hash(uuid), mpm_session_registry_cmp, uuid);
+	if (!entry) {
+		registry->stats.misses += 1;
+		return NULL;
+	}
+
+	entry->last_access = time(NULL);
+	if (entry->next) {
+		DLIST_REMOVE(registry->entries, entry);
+		DLIST_ADD_END(registry->entries, entry, struct mpm_session_registry_entry *);
+	}
+
+	return entry->session;
+}
+
+
+static int mpm_session_registry_hold_destructor(struct mpm_session_registry_hold *hold)
+{
+	struct mpm_session_registry_entry	*entry;
+
+	if (!hold->registry) return 0;
+
+	entry = htable_get(&hold->registry->ht, mpm_session_registry_hash(&hold->uuid),
+			   mpm_session_registry_cmp, &hold->uuid);
+	if (entry && entry->holders) {
+		entry->holders -= 1;
+	}
+	DLIST_REMOVE(hold->registry->holds, hold);
+
+	return 0;
+}
+
+
+/**
+   \details Prevent the session registered under the specified context
+   handle GUID from expiring for as long as the holder memory context
+   exists, e.g. the RPC context handle of the connection or a parked
+   call.
+
+   \param registry pointer to the session registry
+   \param uuid pointer to the context handle GUID
+   \param holder memory context the hold is attached to
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+enum MAPISTATUS mpm_session_registry_hold(struct mpm_session_registry *registry,
+					  const struct GUID *uuid,
+					  TALLOC_CTX *holder)
+{
+	struct mpm_session_registry_entry	*entry;
+	struct mpm_session_registry_hold	*hold;
+
+	OPENCHANGE_RETVAL_IF(!registry, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!uuid, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!holder, MAPI_E_INVALID_PARAMETER, NULL);
+
+	entry = htable_get(&registry->ht, mpm_session_registry_hash(uuid), mpm_session_registry_cmp, uuid);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_NOT_FOUND, NULL);
+
+	hold = talloc_zero(holder, struct mpm_session_registry_hold);
+	OPENCHANGE_RETVAL_IF(!hold, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	hold->registry = registry;
+	hold->uuid = *uuid;
+	DLIST_ADD(registry->holds, hold);
+	talloc_set_destructor(hold, mpm_session_registry_hold_destructor);
+	entry->holders += 1;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Release the session registered under the specified
+   context handle GUID. The session is removed from the registry when
+   its reference count drops to zero.
+
+   \param registry pointer to the session registry
+   \param uuid pointer to the context handle GUID
+
+   \return MAPI_E_SUCCESS when the session was released,
+   MAPI_E_NOT_FOUND if no session is registered, otherwise
+   MAPI_E_UNABLE_TO_COMPLETE if the session is still referenced
+ */
+enum MAPISTATUS mpm_session_registry_release(struct mpm_session_registry *registry,
+					     const struct GUID *uuid)
+{
+	struct mpm_session_registry_entry	*entry;
+
+	OPENCHANGE_RETVAL_IF(!registry, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!uuid, MAPI_E_INVALID_PARAMETER, NULL);
+
+	entry = htable_get(&registry->ht, mpm_session_registry_hash(uuid), mpm_session_registry_cmp, uuid);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_NOT_FOUND, NULL);
+
+	/* mpm_session_release frees the session on success */
+	if (mpm_session_release(entry->session) == false) {
+		return MAPI_E_UNABLE_TO_COMPLETE;
+	}
+
+	entry->session = NULL;
+	mpm_session_registry_remove(registry, entry);
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Evict sessions which have not been used for more than the
+   registry idle timeout. Held sessions are kept, whatever their last
+   access time: a connection or a parked call can still use them.
+
+   \param registry pointer to the session registry
+   \param now reference time, usually time(NULL)
+
+   \return number of evicted sessions
+ */
+uint32_t mpm_session_registry_expire(struct mpm_session_registry *registry,
+				     time_t now)
+{
+	struct mpm_session_registry_entry	*entry;
+	uint32_t				remaining;
+	uint32_t				count = 0;
+
+	if (!registry || !registry->idle_timeout) return 0;
+
+	/* Entries kept alive move to the tail: visit each entry at
+	   most once */
+	remaining = registry->stats.live;
+	while (remaining-- && (entry = registry->entries) != NULL) {
+		if ((now - entry->last_access) < (time_t) registry->idle_timeout) break;
+
+		if (!entry->holders) {
+			/* Nothing can reach the session anymore, drop
+			 * every reference at once */
+			entry->session->ref_count = 0;
+			if (mpm_session_release(entry->session) == true) {
+				DEBUG(3, ("[%s:%d]: %s session idle for %ld seconds evicted\n",
+					  __FUNCTION__, __LINE__, registry->name,
+					  (long)(now - entry->last_access)));
+				entry->session = NULL;
+				mpm_session_registry_remove(registry, entry);
+				registry->stats.evictions += 1;
+				count++;
+				continue;
+			}
+		}
+
+		entry->last_access = now;
+		DLIST_REMOVE(registry->entries, entry);
+		DLIST_ADD_END(registry->entries, entry, struct mpm_session_registry_entry *);
+	}
+
+	return count;
+}
+
+
+/**
+   \details Retrieve the registry counters
+
+   \param registry pointer to the session registry
+   \param stats pointer to the structure receiving the counters
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_INVALID_PARAMETER
+ */
+enum MAPISTATUS mpm_session_registry_get_stats(struct mpm_session_registry *registry,
+					       struct mpm_session_registry_stats *stats)
+{
+	OPENCHANGE_RETVAL_IF(!registry, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!stats, MAPI_E_INVALID_PARAMETER, NULL);
+
+	*stats = registry->stats;
+
+	return MAPI_E_SUCCESS;
+}
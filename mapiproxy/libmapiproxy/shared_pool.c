@@ -0,0 +1,408 @@
+/*
+   MAPI Proxy
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "libmapiproxy.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+
+/**
+   \file shared_pool.c
+
+   \brief Process-wide pool of backend handles shared between sessions
+
+   Opening samdb, the named properties store or an indexing database
+   costs far more than using it, and every session of a server process
+   opens the same ones. The pool keeps one object per name, opened by
+   the first session asking for it. Later sessions borrow it through a
+   talloc reference, which they drop when they are released.
+
+   Once its last borrower is gone, an object is kept for the idle
+   timeout so the next sessions still find it open, then evicted by
+   the next lookup. Per-user objects such as the indexing databases
+   would otherwise stay open until the process exits.
+
+   Each object is recorded with a configuration string built by its
+   user from the parameters it was opened with. Asking for a name with
+   a different configuration drops the pooled object and opens a new
+   one: sessions still holding the previous object keep it alive until
+   they release it, new sessions only see the new one.
+ */
+
+struct mpm_shared_entry {
+	const char		*name;
+	const char		*config;
+	void			*object;
+	uint32_t		borrowers;
+	time_t			idle_since;
+	struct mpm_shared_entry	*prev;
+	struct mpm_shared_entry	*next;
+};
+
+/* One per mpm_shared_get call, allocated on the borrower memory
+ * context and holding the reference on the object */
+struct mpm_shared_borrow {
+	struct mpm_shared_pool		*pool;
+	struct mpm_shared_entry		*entry;
+	void				*object;
+	struct mpm_shared_borrow	*prev;
+	struct mpm_shared_borrow	*next;
+};
+
+struct mpm_shared_pool {
+	struct htable			ht;
+	struct mpm_shared_stats		stats;
+	struct mpm_shared_entry		*entries;
+	struct mpm_shared_borrow	*borrows;
+	uint32_t			idle_timeout;
+};
+
+static struct mpm_shared_pool	*shared_pool = NULL;
+static uint32_t			shared_idle_timeout = MPM_SHARED_IDLE_TIMEOUT;
+
+
+/* FNV-1a over the entry name */
+static size_t mpm_shared_hash(const char *name)
+{
+	uint32_t	h = 2166136261U;
+
+	for (; *name; name++) {
+		h = (h ^ (uint8_t) *name) * 16777619U;
+	}
+
+	return h;
+}
+
+
+static size_t mpm_shared_rehash(const void *e, void *unused)
+{
+	const struct mpm_shared_entry	*entry = (const struct mpm_shared_entry *) e;
+
+	return mpm_shared_hash(entry->name);
+}
+
+
+static bool mpm_shared_cmp(const void *e, void *name)
+{
+	const struct mpm_shared_entry	*entry = (const struct mpm_shared_entry *) e;
+
+	return (strcmp(entry->name, (const char *) name) == 0);
+}
+
+
+static int mpm_shared_pool_destructor(struct mpm_shared_pool *pool)
+{
+	struct mpm_shared_borrow	*borrow;
+
+	/* Borrowers outliving the pool keep their object */
+	for (borrow = pool->borrows; borrow; borrow = borrow->next) {
+		borrow->pool = NULL;
+		borrow->entry = NULL;
+	}
+	htable_clear(&pool->ht);
+	shared_pool = NULL;
+
+	return 0;
+}
+
+
+static struct mpm_shared_pool *mpm_shared_pool_get(void)
+{
+	if (shared_pool) return shared_pool;
+
+	shared_pool = talloc_zero(talloc_autofree_context(), struct mpm_shared_pool);
+	if (!shared_pool) return NULL;
+
+	htable_init(&shared_pool->ht, mpm_shared_rehash, NULL);
+	shared_pool->idle_timeout = shared_idle_timeout;
+	talloc_set_destructor(shared_pool, mpm_shared_pool_destructor);
+
+	return shared_pool;
+}
+
+
+/**
+   \details Remove an entry from the pool. Borrowers of its object
+   keep it alive until they release it.
+ */
+static void mpm_shared_remove(struct mpm_shared_pool *pool,
+			      struct mpm_shared_entry *entry)
+{
+	struct mpm_shared_borrow	*borrow;
+
+	for (borrow = pool->borrows; entry->borrowers && borrow; borrow = borrow->next) {
+		if (borrow->entry == entry) {
+			borrow->entry = NULL;
+			entry->borrowers -= 1;
+		}
+	}
+
+	htable_del(&pool->ht, mpm_shared_hash(entry->name), entry);
+	DLIST_REMOVE(pool->entries, entry);
+	pool->stats.entries -= 1;
+
+	talloc_unlink(entry, entry->object);
+	talloc_free(entry);
+}
+
+
+/**
+   \details Evict the objects nobody borrowed for the idle timeout
+ */
+static void mpm_shared_expire(struct mpm_shared_pool *pool, time_t now)
+{
+	struct mpm_shared_entry	*entry;
+	struct mpm_shared_entry	*next;
+
+	for (entry = pool->entries; entry; entry = next) {
+		next = entry->next;
+		if (entry->borrowers || now - entry->idle_since < pool->idle_timeout) continue;
+
+		DEBUG(5, ("[%s:%d]: evicting idle shared %s\n", __FUNCTION__, __LINE__, entry->name));
+		mpm_shared_remove(pool, entry);
+		pool->stats.evictions += 1;
+	}
+}
+
+
+static int mpm_shared_borrow_destructor(struct mpm_shared_borrow *borrow)
+{
+	struct mpm_shared_pool	*pool = borrow->pool;
+	struct mpm_shared_entry	*entry = borrow->entry;
+
+	if (!pool) return 0;
+
+	DLIST_REMOVE(pool->borrows, borrow);
+	if (!entry) return 0;
+
+	entry->borrowers -= 1;
+	if (entry->borrowers) return 0;
+
+	entry->idle_since = time(NULL);
+	if (!pool->idle_timeout) {
+		/* Drop the reference first, so the object goes with the entry */
+		talloc_unlink(borrow, borrow->object);
+		mpm_shared_remove(pool, entry);
+		pool->stats.evictions += 1;
+	}
+
+	return 0;
+}
+
+
+/**
+   \details Record a new borrower of a pooled entry
+
+   \return Pointer to the pooled object on success, otherwise NULL
+ */
+static void *mpm_shared_borrow(struct mpm_shared_pool *pool, TALLOC_CTX *mem_ctx,
+			       struct mpm_shared_entry *entry)
+{
+	struct mpm_shared_borrow	*borrow;
+
+	borrow = talloc_zero(mem_ctx, struct mpm_shared_borrow);
+	if (!borrow) return NULL;
+
+	if (!talloc_reference(borrow, entry->object)) {
+		talloc_free(borrow);
+		return NULL;
+	}
+	borrow->pool = pool;
+	borrow->entry = entry;
+	borrow->object = entry->object;
+	DLIST_ADD(pool->borrows, borrow);
+	entry->borrowers += 1;
+	talloc_set_destructor(borrow, mpm_shared_borrow_destructor);
+
+	return entry->object;
+}
+
+
+/**
+   \details Set the number of seconds an object nobody borrows is kept
+   in the pool
+
+   \param idle_timeout number of seconds, 0 evicts objects as soon as
+   their last borrower releases them
+ */
+void mpm_shared_set_idle_timeout(uint32_t idle_timeout)
+{
+	shared_idle_timeout = idle_timeout;
+	if (shared_pool) {
+		shared_pool->idle_timeout = idle_timeout;
+	}
+}
+
+
+/**
+   \details Borrow the pooled object registered under the specified
+   name, opening it if the pool does not hold one for this
+   configuration yet
+
+   The open function receives the memory context the object has to be
+   allocated on, and must return an object owning everything it
+   depends on, since it can outlive that context.
+
+   \param mem_ctx pointer to the memory context of the borrower
+   \param name name of the object in the pool
+   \param config configuration string the object is opened with
+   \param open_fn function opening the object
+   \param private_data pointer passed to open_fn
+
+   \note The borrower releases the object with mpm_shared_release, or
+   by freeing mem_ctx. It must never free it.
+
+   \return Pointer to the pooled object on success, otherwise NULL
+ */
+void *mpm_shared_get(TALLOC_CTX *mem_ctx, const char *name, const char *config,
+		     mpm_shared_open_fn open_fn, void *private_data)
+{
+	struct mpm_shared_pool	*pool;
+	struct mpm_shared_entry	*entry;
+
+	if (!mem_ctx || !name || !config || !open_fn) return NULL;
+
+	pool = mpm_shared_pool_get();
+	if (!pool) return NULL;
+
+	mpm_shared_expire(pool, time(NULL));
+
+	entry = htable_get(&pool->ht, mpm_shared_hash(name), mpm_shared_cmp, name);
+	if (entry) {
+		if (!strcmp(entry->config, config)) {
+			pool->stats.hits += 1;
+			return mpm_shared_borrow(pool, mem_ctx, entry);
+		}
+		DEBUG(3, ("[%s:%d]: configuration of shared %s changed, reopening it\n",
+			  __FUNCTION__, __LINE__, name));
+		mpm_shared_remove(pool, entry);
+		pool->stats.invalidations += 1;
+	}
+
+	pool->stats.misses += 1;
+
+	entry = talloc_zero(pool, struct mpm_shared_entry);
+	if (!entry) return NULL;
+
+	entry->name = talloc_strdup(entry, name);
+	entry->config = talloc_strdup(entry, config);
+	if (!entry->name || !entry->config) {
+		talloc_free(entry);
+		return NULL;
+	}
+
+	entry->object = open_fn(entry, private_data);
+	if (!entry->object) {
+		talloc_free(entry);
+		return NULL;
+	}
+
+	if (!htable_add(&pool->ht, mpm_shared_hash(name), entry)) {
+		DEBUG(0, ("[%s:%d]: unable to add %s to the shared pool\n",
+			  __FUNCTION__, __LINE__, name));
+		talloc_free(entry);
+		return NULL;
+	}
+	DLIST_ADD_END(pool->entries, entry, struct mpm_shared_entry *);
+	pool->stats.entries += 1;
+	entry->idle_since = time(NULL);
+
+	return mpm_shared_borrow(pool, mem_ctx, entry);
+}
+
+
+/**
+   \details Release an object borrowed with mpm_shared_get
+
+   When this was the last borrower, the object stays in the pool for
+   the idle timeout, or is evicted at once if the timeout is 0.
+
+   \param mem_ctx pointer to the memory context the object was
+   borrowed with
+   \param object pointer to the borrowed object
+
+   \return 0 on success, otherwise -1
+ */
+int mpm_shared_release(TALLOC_CTX *mem_ctx, void *object)
+{
+	struct mpm_shared_borrow	*borrow;
+
+	if (!mem_ctx || !object || !shared_pool) return -1;
+
+	for (borrow = shared_pool->borrows; borrow; borrow = borrow->next) {
+		if (borrow->object == object && talloc_parent(borrow) == mem_ctx) {
+			talloc_free(borrow);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+
+/**
+   \details Drop pooled objects, so the next sessions asking for them
+   open new ones
+
+   \param prefix prefix of the names of the objects to drop, NULL
+   drops all of them
+
+   \return number of dropped objects
+ */
+uint32_t mpm_shared_invalidate(const char *prefix)
+{
+	struct mpm_shared_entry	*entry;
+	struct mpm_shared_entry	*next;
+	uint32_t		count = 0;
+
+	if (!shared_pool) return 0;
+
+	for (entry = shared_pool->entries; entry; entry = next) {
+		next = entry->next;
+		if (prefix && strncmp(entry->name, prefix, strlen(prefix))) continue;
+
+		mpm_shared_remove(shared_pool, entry);
+		shared_pool->stats.invalidations += 1;
+		count++;
+	}
+
+	return count;
+}
+
+
+/**
+   \details Retrieve the pool counters
+
+   \param stats pointer to the structure receiving the counters
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_INVALID_PARAMETER
+ */
+enum MAPISTATUS mpm_shared_get_stats(struct mpm_shared_stats *stats)
+{
+	OPENCHANGE_RETVAL_IF(!stats, MAPI_E_INVALID_PARAMETER, NULL);
+
+	if (!shared_pool) {
+		memset(stats, 0, sizeof (struct mpm_shared_stats));
+		return MAPI_E_SUCCESS;
+	}
+	*stats = shared_pool->stats;
+
+	return MAPI_E_SUCCESS;
+}
@@ -345,6 +345,13 @@
  */
 #define	SIZE_DFLT_ROPNOTIFY                     8
 
+/**
+   \details Pending Rop has non-default fixed response size for:
+   -# RopId: uint8_t
+   -# SessionIndex: uint16_t
+ */
+#define	SIZE_DFLT_ROPPENDING			3
+
 /**
    \details GetSearchCriteria Rop has fixed response size for:
    -# RestrictionDataSize: uint16_t
@@ -476,6 +483,22 @@
  */
 #define SIZE_DFLT_ROPGETLOCALREPLICAIDS 22
 
+/**
+   \details Maximum number of rows libmapiserver_RopQueryRows_fill
+   retrieves from the table at once
+ */
+#define	LIBMAPISERVER_QUERYROWS_BATCH	64
+
+/**
+   \details Callback used by libmapiserver_RopQueryRows_fill to
+   retrieve count consecutive rows starting at start. Each row is
+   serialized into the matching rows entry, allocated on mem_ctx.
+
+   \return number of leading rows successfully serialized
+ */
+typedef uint32_t (*libmapiserver_get_rows_fn)(TALLOC_CTX *mem_ctx, void *private_data,
+					       uint32_t start, uint32_t count, DATA_BLOB *rows);
+
 __BEGIN_DECLS
 
 /* definitions from libmapiserver_oxcfold.c */
@@ -511,6 +534,7 @@ uint16_t libmapiserver_RopOpenEmbeddedMessage_size(struct EcDoRpc_MAPI_REPL *res
 /* definitions from libmapiserver_oxcnotif.c */
 uint16_t libmapiserver_RopRegisterNotification_size(void);
 uint16_t libmapiserver_RopNotify_size(struct EcDoRpc_MAPI_REPL *);
+uint16_t libmapiserver_RopPending_size(void);
 
 /* definitions from libmapiserver_oxcdata.c */
 uint16_t libmapiserver_TypedString_size(struct TypedString);
@@ -557,6 +581,7 @@ uint16_t libmapiserver_RopSetColumns_size(struct EcDoRpc_MAPI_REPL *);
 uint16_t libmapiserver_RopSortTable_size(struct EcDoRpc_MAPI_REPL *);
 uint16_t libmapiserver_RopRestrict_size(struct EcDoRpc_MAPI_REPL *);
 uint16_t libmapiserver_RopQueryRows_size(struct EcDoRpc_MAPI_REPL *);
+enum MAPISTATUS libmapiserver_RopQueryRows_fill(TALLOC_CTX *, struct EcDoRpc_MAPI_REPL *, uint16_t, bool, uint16_t, uint32_t *, uint32_t, libmapiserver_get_rows_fn, void *);
 uint16_t libmapiserver_RopQueryPosition_size(struct EcDoRpc_MAPI_REPL *);
 uint16_t libmapiserver_RopSeekRow_size(struct EcDoRpc_MAPI_REPL *);
 uint16_t libmapiserver_RopFindRow_size(struct EcDoRpc_MAPI_REPL *);
@@ -221,3 +221,13 @@ _PUBLIC_ uint16_t libmapiserver_RopNotify_size(struct EcDoRpc_MAPI_REPL *respons
 
         return size;
 }
+
+/**
+   \details Calculate Pending Rop size
+
+   \return Size of Pending response
+ */
+_PUBLIC_ uint16_t libmapiserver_RopPending_size(void)
+{
+	return SIZE_DFLT_ROPPENDING;
+}
@@ -116,6 +116,130 @@ _PUBLIC_ uint16_t libmapiserver_RopQueryRows_size(struct EcDoRpc_MAPI_REPL *resp
 }
 
 
+/**
+   \details Fill the rows of a QueryRows response without exceeding
+   the space left in the ROP output buffer
+
+   Rows are retrieved in batches from position, moving forward or
+   backward. Once some rows have been serialized, the batch size is
+   derived from their average size so rows which cannot fit are
+   seldom fetched.
+
+   \param mem_ctx pointer to the memory context
+   \param response pointer to the QueryRows EcDoRpc_MAPI_REPL
+   structure
+   \param max_size number of bytes left in the ROP output buffer for
+   this response
+   \param forward true to read rows forward, false to read backward
+   \param row_count maximum number of rows requested by the client
+   \param position pointer to the cursor position, moved past the
+   rows actually returned
+   \param total number of rows in the table
+   \param get_rows callback retrieving serialized rows
+   \param private_data pointer passed to get_rows
+
+   \return MAPI_E_SUCCESS on success, ecBufferTooSmall if the next
+   row does not fit in max_size, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS libmapiserver_RopQueryRows_fill(TALLOC_CTX *mem_ctx,
+							 struct EcDoRpc_MAPI_REPL *response,
+							 uint16_t max_size, bool forward,
+							 uint16_t row_count, uint32_t *position,
+							 uint32_t total,
+							 libmapiserver_get_rows_fn get_rows,
+							 void *private_data)
+{
+	struct QueryRows_repl	*repl;
+	DATA_BLOB		*rows;
+	DATA_BLOB		*row;
+	uint32_t		budget;
+	uint32_t		pos;
+	uint32_t		available;
+	uint32_t		batch;
+	uint32_t		start;
+	uint32_t		fetched;
+	uint32_t		average;
+	uint32_t		idx;
+	uint32_t		i;
+	bool			full = false;
+	bool			exhausted = false;
+
+	if (!response || !position || !get_rows) {
+		return MAPI_E_INVALID_PARAMETER;
+	}
+
+	repl = &response->u.mapi_QueryRows;
+	repl->RowCount = 0;
+	repl->RowData.length = 0;
+	repl->RowData.data = NULL;
+
+	if (max_size <= SIZE_DFLT_MAPI_RESPONSE + SIZE_DFLT_ROPQUERYROWS) {
+		return ecBufferTooSmall;
+	}
+	budget = max_size - SIZE_DFLT_MAPI_RESPONSE - SIZE_DFLT_ROPQUERYROWS;
+
+	pos = (*position > total) ? total : *position;
+	while (!full && !exhausted && repl->RowCount < row_count) {
+		available = forward ? (total - pos) : pos;
+		if (!available) break;
+
+		batch = row_count - repl->RowCount;
+		if (batch > available) batch = available;
+		if (repl->RowCount) {
+			average = repl->RowData.length / repl->RowCount;
+			if (average && batch > (budget - repl->RowData.length) / average + 1) {
+				batch = (budget - repl->RowData.length) / average + 1;
+			}
+		}
+		if (batch > LIBMAPISERVER_QUERYROWS_BATCH) batch = LIBMAPISERVER_QUERYROWS_BATCH;
+
+		rows = talloc_zero_array(mem_ctx, DATA_BLOB, batch);
+		if (!rows) return MAPI_E_NOT_ENOUGH_MEMORY;
+
+		start = forward ? pos : pos - batch;
+		fetched = get_rows(rows, private_data, start, batch, rows);
+		if (fetched > batch) fetched = batch;
+
+		/* rows[0] is the row at start: backward reads walk the
+		 * returned rows from their end */
+		for (i = 0; i < fetched; i++) {
+			idx = forward ? i : fetched - 1 - i;
+			row = &rows[idx];
+			if (repl->RowData.length + row->length > budget) {
+				full = true;
+				break;
+			}
+
+			if (!repl->RowData.data) {
+				repl->RowData.data = talloc_array(mem_ctx, uint8_t, budget);
+				if (!repl->RowData.data) {
+					talloc_free(rows);
+					return MAPI_E_NOT_ENOUGH_MEMORY;
+				}
+			}
+			memcpy(repl->RowData.data + repl->RowData.length, row->data, row->length);
+			repl->RowData.length += row->length;
+			repl->RowCount++;
+			pos = forward ? (start + idx + 1) : (start + idx);
+		}
+
+		/* A short batch means the backend ran out of rows */
+		if (fetched < batch) {
+			exhausted = true;
+		}
+		talloc_free(rows);
+	}
+
+	*position = pos;
+
+	if (full && !repl->RowCount) {
+		return ecBufferTooSmall;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+
 /**
    \details Calculate QueryPosition Rop size
 
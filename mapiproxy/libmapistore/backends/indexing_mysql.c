@@ -54,8 +54,7 @@ static enum mapistore_error mysql_search_existing_fmid(struct indexing_context *
 {
 	int		ret;
 	uint64_t	soft_deleted;
-	char		*sql;
-	TALLOC_CTX	*mem_ctx;
+	MYSQL_BIND	params[2];
 
 	/* Sanity */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -63,16 +62,14 @@ static enum mapistore_error mysql_search_existing_fmid(struct indexing_context *
 	MAPISTORE_RETVAL_IF(!fmid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!is_soft_deleted, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_new(NULL);
-	sql = talloc_asprintf(mem_ctx,
-		"SELECT soft_deleted FROM %s "
-		"WHERE username = '%s' AND fmid = %"PRIu64,
-		INDEXING_TABLE, _sql(mem_ctx, username), fmid);
-	ret = select_first_uint(MYSQL(ictx), sql, &soft_deleted);
-	MAPI_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_EXIST, mem_ctx);
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &fmid);
+	ret = select_stmt_first_uint(MYSQL(ictx),
+		"SELECT soft_deleted FROM "INDEXING_TABLE" "
+		"WHERE username = ? AND fmid = ?", params, &soft_deleted);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_EXIST, NULL);
 
 	*is_soft_deleted = (soft_deleted == 1);
-	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
 }
 
@@ -97,8 +94,7 @@ static enum mapistore_error mysql_record_add(struct indexing_context *ictx,
 {
 	int		ret;
 	bool		IsSoftDeleted = false;
-	char		*sql;
-	TALLOC_CTX	*mem_ctx;
+	MYSQL_BIND	params[3];
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -110,18 +106,15 @@ static enum mapistore_error mysql_record_add(struct indexing_context *ictx,
 	ret = mysql_search_existing_fmid(ictx, username, fmid, &IsSoftDeleted);
 	MAPISTORE_RETVAL_IF(ret == MAPISTORE_SUCCESS, MAPISTORE_ERR_EXIST, NULL);
 
-	mem_ctx = talloc_new(NULL);
-	sql = talloc_asprintf(mem_ctx,
-		"INSERT INTO %s "
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &fmid);
+	stmt_bind_string(&params[2], mapistore_URI);
+	ret = execute_stmt(MYSQL(ictx),
+		"INSERT INTO "INDEXING_TABLE" "
 		"(username, fmid, url, soft_deleted) "
-		"VALUES ('%s', %"PRIu64", '%s', '%d')",
-		INDEXING_TABLE, _sql(mem_ctx, username), fmid,
-		_sql(mem_ctx, mapistore_URI), 0);
-
-	ret = execute_query(MYSQL(ictx), sql);
-	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+		"VALUES (?, ?, ?, 0)", params, NULL);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
 
-	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
 }
 
@@ -145,8 +138,8 @@ static enum mapistore_error mysql_record_update(struct indexing_context *ictx,
 						const char *mapistore_URI)
 {
 	int		ret;
-	char		*sql;
-	TALLOC_CTX	*mem_ctx;
+	uint64_t	affected_rows;
+	MYSQL_BIND	params[3];
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -154,21 +147,17 @@ static enum mapistore_error mysql_record_update(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!fmid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!mapistore_URI, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_new(NULL);
-	sql = talloc_asprintf(mem_ctx,
-		"UPDATE %s "
-		"SET url = '%s' "
-		"WHERE username = '%s' AND fmid = %"PRIu64,
-		INDEXING_TABLE, _sql(mem_ctx, mapistore_URI), _sql(mem_ctx, username), fmid);
-
-	ret = execute_query(MYSQL(ictx), sql);
-	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
-
-	talloc_free(mem_ctx);
+	stmt_bind_string(&params[0], mapistore_URI);
+	stmt_bind_string(&params[1], username);
+	stmt_bind_uint64(&params[2], &fmid);
+	ret = execute_stmt(MYSQL(ictx),
+		"UPDATE "INDEXING_TABLE" "
+		"SET url = ? "
+		"WHERE username = ? AND fmid = ?", params, &affected_rows);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
 
 	/* did we updated anything? */
-	/* TODO: Move mysql_affected_rows() in execute_query() */
-	if (mysql_affected_rows(MYSQL(ictx)) == 0) {
+	if (affected_rows == 0) {
 		return MAPISTORE_ERR_NOT_FOUND;
 	}
 
@@ -197,8 +186,8 @@ static enum mapistore_error mysql_record_del(struct indexing_context *ictx,
 {
 	int		ret;
 	bool		IsSoftDeleted = false;
-	char		*sql;
-	TALLOC_CTX	*mem_ctx;
+	const char	*sql;
+	MYSQL_BIND	params[2];
 
 
 	/* Sanity checks */
@@ -208,35 +197,29 @@ static enum mapistore_error mysql_record_del(struct indexing_context *ictx,
 
 	/* Check if the fid/mid still exists within the database */
 	ret = mysql_search_existing_fmid(ictx, username, fmid, &IsSoftDeleted);
-	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_SUCCESS, NULL);
-
-	mem_ctx = talloc_new(NULL);
+	MAPISTORE_RETVAL_IF(ret != MAPISTORE_SUCCESS, MAPISTORE_SUCCESS, NULL);
 
 	switch (flags) {
 	case MAPISTORE_SOFT_DELETE:
 		/* nothing to do if the record is already soft deleted */
 		MAPISTORE_RETVAL_IF(IsSoftDeleted == true, MAPISTORE_SUCCESS, NULL);
-		sql = talloc_asprintf(mem_ctx,
-			"UPDATE %s "
-			"SET soft_deleted=1 "
-			"WHERE username = '%s' AND fmid = %"PRIu64,
-			INDEXING_TABLE, _sql(mem_ctx, username), fmid);
+		sql = "UPDATE "INDEXING_TABLE" "
+		      "SET soft_deleted=1 "
+		      "WHERE username = ? AND fmid = ?";
 		break;
 	case MAPISTORE_PERMANENT_DELETE:
-		sql = talloc_asprintf(mem_ctx,
-			"DELETE FROM %s "
-			"WHERE username = '%s' AND fmid = %"PRIu64,
-			INDEXING_TABLE, _sql(mem_ctx, username), fmid);
+		sql = "DELETE FROM "INDEXING_TABLE" "
+		      "WHERE username = ? AND fmid = ?";
 		break;
 	default:
-		talloc_free(mem_ctx);
 		return MAPISTORE_ERR_INVALID_PARAMETER;
 	}
 
-	execute_query(MYSQL(ictx), sql);
-	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &fmid);
+	ret = execute_stmt(MYSQL(ictx), sql, params, NULL);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
 
-	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
 }
 
@@ -262,9 +245,9 @@ static enum mapistore_error mysql_record_get_uri(struct indexing_context *ictx,
 						 bool *soft_deletedp)
 {
 	int		ret;
-	char		*sql;
-	MYSQL_RES	*res;
-	MYSQL_ROW	row;
+	uint64_t	soft_deleted;
+	MYSQL_BIND	params[2];
+	MYSQL_BIND	results[2];
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -273,22 +256,19 @@ static enum mapistore_error mysql_record_get_uri(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!urip, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &fmid);
+	stmt_bind_string_result(&results[0]);
+	stmt_bind_uint64(&results[1], &soft_deleted);
+	ret = select_stmt_first_row(mem_ctx, MYSQL(ictx),
+		"SELECT url, soft_deleted FROM "INDEXING_TABLE" "
+		"WHERE username = ? AND fmid = ?", params, results);
+	MAPISTORE_RETVAL_IF(ret == MYSQL_NOT_FOUND, MAPISTORE_ERR_NOT_FOUND, NULL);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
 
-	sql = talloc_asprintf(mem_ctx,
-		"SELECT url, soft_deleted FROM %s "
-		"WHERE username = '%s' AND fmid = %"PRIu64,
-		INDEXING_TABLE, _sql(mem_ctx, username), fmid);
-
-	ret = select_without_fetch(MYSQL(ictx), sql, &res);
-	MAPISTORE_RETVAL_IF(ret == MYSQL_NOT_FOUND, MAPISTORE_ERR_NOT_FOUND, sql);
-	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, sql);
-
-	row = mysql_fetch_row(res);
-
-	*urip = talloc_strdup(mem_ctx, row[0]);
-	*soft_deletedp = strtoull(row[1], NULL, 0) == 1;
+	*urip = (char *) results[0].buffer;
+	*soft_deletedp = soft_deleted == 1;
 
-	talloc_free(sql);
 	return MAPISTORE_SUCCESS;
 }
 
@@ -316,9 +296,11 @@ static enum mapistore_error mysql_record_get_fmid(struct indexing_context *ictx,
 						  bool *soft_deletedp)
 {
 	enum MYSQLRESULT	ret;
-	char			*sql, *uri_like;
-	MYSQL_RES		*res;
-	MYSQL_ROW		row;
+	const char		*sql;
+	char			*uri_like;
+	uint64_t		soft_deleted;
+	MYSQL_BIND		params[2];
+	MYSQL_BIND		results[2];
 	TALLOC_CTX		*mem_ctx;
 
 	// Sanity checks
@@ -330,29 +312,28 @@ static enum mapistore_error mysql_record_get_fmid(struct indexing_context *ictx,
 
 	mem_ctx = talloc_named(NULL, 0, "mysql_record_get_fmid");
 
-	sql = talloc_asprintf(mem_ctx,
-		"SELECT fmid, soft_deleted FROM "INDEXING_TABLE" "
-		"WHERE username = '%s'", _sql(mem_ctx, username));
+	stmt_bind_string(&params[0], username);
 	if (partial) {
 		uri_like = talloc_strdup(mem_ctx, uri);
+		MAPISTORE_RETVAL_IF(!uri_like, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
 		string_replace(uri_like, '*', '%');
-		sql = talloc_asprintf_append(sql, " AND url LIKE '%s'",
-					     _sql(mem_ctx, uri_like));
+		stmt_bind_string(&params[1], uri_like);
+		sql = "SELECT fmid, soft_deleted FROM "INDEXING_TABLE" "
+		      "WHERE username = ? AND url LIKE ?";
 	} else {
-		sql = talloc_asprintf_append(sql, " AND url = '%s'",
-					     _sql(mem_ctx, uri));
+		stmt_bind_string(&params[1], uri);
+		sql = "SELECT fmid, soft_deleted FROM "INDEXING_TABLE" "
+		      "WHERE username = ? AND url = ?";
 	}
+	stmt_bind_uint64(&results[0], fmidp);
+	stmt_bind_uint64(&results[1], &soft_deleted);
 
-	ret = select_without_fetch(MYSQL(ictx), sql, &res);
+	ret = select_stmt_first_row(mem_ctx, MYSQL(ictx), sql, params, results);
 	MAPISTORE_RETVAL_IF(ret == MYSQL_NOT_FOUND, MAPISTORE_ERR_NOT_FOUND, mem_ctx);
 	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
 
-	row = mysql_fetch_row(res);
+	*soft_deletedp = soft_deleted == 1;
 
-	*fmidp = strtoull(row[0], NULL, 0);
-	*soft_deletedp = strtoull(row[1], NULL, 0) == 1;
-
-	mysql_free_result(res);
 	talloc_free(mem_ctx);
 
 	return MAPISTORE_SUCCESS;
@@ -365,9 +346,9 @@ static enum mapistore_error mysql_record_allocate_fmids(struct indexing_context
 						      uint64_t *fmidp)
 {
 	int		ret;
-	uint64_t	next_fmid;
-	char		*sql;
-	TALLOC_CTX	*mem_ctx;
+	uint64_t	next_fmid, last_fmid;
+	const char	*sql;
+	MYSQL_BIND	params[2];
 
 	/* SANITY checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -380,51 +361,43 @@ static enum mapistore_error mysql_record_allocate_fmids(struct indexing_context
 	ret = execute_query(MYSQL(ictx), "START TRANSACTION");
 	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
 
-	mem_ctx = talloc_new(NULL);
-	sql = talloc_asprintf(mem_ctx,
-		"SELECT next_fmid FROM %s "
-		"WHERE username = '%s'",
-		INDEXING_ALLOC_TABLE, _sql(mem_ctx, username));
-	ret = select_first_uint(MYSQL(ictx), sql, &next_fmid);
+	stmt_bind_string(&params[0], username);
+	ret = select_stmt_first_uint(MYSQL(ictx),
+		"SELECT next_fmid FROM "INDEXING_ALLOC_TABLE" "
+		"WHERE username = ?", params, &next_fmid);
 	switch (ret) {
 	case MYSQL_SUCCESS:
 		if (next_fmid <= MAX_PUBLIC_FOLDER_ID) {
 			next_fmid = MAX_PUBLIC_FOLDER_ID + 1;
 		}
 		// Update next fmid
-		sql = talloc_asprintf(mem_ctx,
-			"UPDATE %s SET next_fmid = %"PRIu64
-			" WHERE username='%s'",
-			INDEXING_ALLOC_TABLE,
-			next_fmid + count,
-			_sql(mem_ctx, username));
+		sql = "UPDATE "INDEXING_ALLOC_TABLE" SET next_fmid = ? "
+		      "WHERE username = ?";
+		stmt_bind_uint64(&params[0], &last_fmid);
+		stmt_bind_string(&params[1], username);
 		break;
 	case MYSQL_NOT_FOUND:
 		// First allocation, insert in the database
 		next_fmid = MAX_PUBLIC_FOLDER_ID + 1;
-		sql = talloc_asprintf(mem_ctx,
-			"INSERT INTO %s (username, next_fmid) "
-			"VALUES('%s', %"PRIu64")",
-			INDEXING_ALLOC_TABLE,
-			_sql(mem_ctx, username),
-			next_fmid + count);
+		sql = "INSERT INTO "INDEXING_ALLOC_TABLE" (username, next_fmid) "
+		      "VALUES(?, ?)";
+		stmt_bind_string(&params[0], username);
+		stmt_bind_uint64(&params[1], &last_fmid);
 		break;
 
 	default:
 		// Unknown error
-		talloc_free(mem_ctx);
 		return MAPISTORE_ERR_DATABASE_OPS;
 	}
-	ret = execute_query(MYSQL(ictx), sql);
-	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+	last_fmid = next_fmid + count;
+	ret = execute_stmt(MYSQL(ictx), sql, params, NULL);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
 
 	ret = execute_query(MYSQL(ictx), "COMMIT");
-	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
 
 	*fmidp = next_fmid;
 
-	talloc_free(mem_ctx);
-
 	return MAPISTORE_SUCCESS;
 }
 
@@ -436,6 +409,324 @@ static enum mapistore_error mysql_record_allocate_fmid(struct indexing_context *
 }
 
 
+/**
+  \details Retrieve the state of the change number index of a folder
+  table
+
+  \return the state, MAPISTORE_CN_INDEX_NONE when not indexed
+ */
+static enum mapistore_cn_index_state mysql_cn_index_state(struct indexing_context *ictx,
+							  const char *username,
+							  uint64_t fid,
+							  enum mapistore_table_type table_type)
+{
+	int		ret;
+	uint64_t	type = table_type;
+	uint64_t	state;
+	MYSQL_BIND	params[3];
+
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &fid);
+	stmt_bind_uint64(&params[2], &type);
+	ret = select_stmt_first_uint(MYSQL(ictx),
+		"SELECT state FROM "INDEXING_CN_STATE_TABLE" "
+		"WHERE username = ? AND folder_id = ? AND table_type = ?", params, &state);
+	if (ret != MYSQL_SUCCESS || state > MAPISTORE_CN_INDEX_READY) {
+		return MAPISTORE_CN_INDEX_NONE;
+	}
+
+	return (enum mapistore_cn_index_state) state;
+}
+
+/**
+  \details Record the change numbers of messages of a folder table
+
+  \param ictx valid pointer to indexing context
+  \param username samAccountName for current user
+  \param fid the folder identifier
+  \param table_type MAPISTORE_MESSAGE_TABLE or MAPISTORE_FAI_TABLE
+  \param count the number of messages
+  \param mids the message identifiers
+  \param cns the PidTagChangeNumber of each message
+
+  \return MAPISTORE_SUCCESS on success, also when the table is not
+	  indexed
+	  MAPISTORE_ERR_NOT_INITIALIZED if ictx pointer is invalid (NULL)
+	  MAPISTORE_ERR_INVALID_PARAMETER in case other parameters are not valid
+	  MAPISTORE_ERR_DATABASE_OPS in case of MySQL error
+ */
+static enum mapistore_error mysql_record_set_cns(struct indexing_context *ictx,
+						 const char *username,
+						 uint64_t fid,
+						 enum mapistore_table_type table_type,
+						 uint32_t count,
+						 const uint64_t *mids,
+						 const uint64_t *cns)
+{
+	int		ret;
+	uint64_t	type = table_type;
+	uint64_t	mid, cn;
+	uint32_t	i;
+	MYSQL_BIND	params[5];
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && (!mids || !cns), MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	if (!count || mysql_cn_index_state(ictx, username, fid, table_type) == MAPISTORE_CN_INDEX_NONE) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	ret = execute_query(MYSQL(ictx), "START TRANSACTION");
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &mid);
+	stmt_bind_uint64(&params[2], &fid);
+	stmt_bind_uint64(&params[3], &type);
+	stmt_bind_uint64(&params[4], &cn);
+	for (i = 0; i < count; i++) {
+		mid = mids[i];
+		cn = cns[i];
+		/* cn is assigned first: it compares against the previous location */
+		ret = execute_stmt(MYSQL(ictx),
+			"INSERT INTO "INDEXING_CN_TABLE" "
+			"(username, mid, folder_id, table_type, cn) "
+			"VALUES (?, ?, ?, ?, ?) "
+			"ON DUPLICATE KEY UPDATE "
+			"cn = IF(folder_id = VALUES(folder_id) AND table_type = VALUES(table_type), "
+			"GREATEST(cn, VALUES(cn)), VALUES(cn)), "
+			"folder_id = VALUES(folder_id), table_type = VALUES(table_type)", params, NULL);
+		if (ret != MYSQL_SUCCESS) {
+			execute_query(MYSQL(ictx), "ROLLBACK");
+			return MAPISTORE_ERR_DATABASE_OPS;
+		}
+	}
+
+	ret = execute_query(MYSQL(ictx), "COMMIT");
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+  \details Remove a message from the change number index.
+	   Note that function will succeed when the message is not indexed
+
+  \param ictx valid pointer to indexing context
+  \param username samAccountName for current user
+  \param mid the message identifier
+
+  \return MAPISTORE_SUCCESS on success
+	  MAPISTORE_ERR_NOT_INITIALIZED if ictx pointer is invalid (NULL)
+	  MAPISTORE_ERR_INVALID_PARAMETER in case other parameters are not valid
+	  MAPISTORE_ERR_DATABASE_OPS in case of MySQL error
+ */
+static enum mapistore_error mysql_record_del_cn(struct indexing_context *ictx,
+						const char *username,
+						uint64_t mid)
+{
+	int		ret;
+	MYSQL_BIND	params[2];
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!mid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &mid);
+	ret = execute_stmt(MYSQL(ictx),
+		"DELETE FROM "INDEXING_CN_TABLE" "
+		"WHERE username = ? AND mid = ?", params, NULL);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+  \details Change the state of the change number index of a folder
+	   table. Entries are dropped unless the table becomes ready,
+	   seeding starts a new generation and only the current one can
+	   make the table ready
+
+  \param ictx valid pointer to indexing context
+  \param username samAccountName for current user
+  \param fid the folder identifier
+  \param table_type MAPISTORE_MESSAGE_TABLE or MAPISTORE_FAI_TABLE
+  \param state the new state
+  \param generation pointer to the seeding generation, set when
+	 seeding and checked when ready - optional
+
+  \return MAPISTORE_SUCCESS on success
+	  MAPISTORE_ERR_NOT_FOUND if the table is not being seeded with
+	  this generation
+	  MAPISTORE_ERR_NOT_INITIALIZED if ictx pointer is invalid (NULL)
+	  MAPISTORE_ERR_INVALID_PARAMETER in case other parameters are not valid
+	  MAPISTORE_ERR_DATABASE_OPS in case of MySQL error
+ */
+static enum mapistore_error mysql_record_set_cn_index_state(struct indexing_context *ictx,
+							    const char *username,
+							    uint64_t fid,
+							    enum mapistore_table_type table_type,
+							    enum mapistore_cn_index_state state,
+							    uint32_t *generation)
+{
+	int		ret;
+	uint64_t	type = table_type;
+	uint64_t	value = 0;
+	uint64_t	affected_rows = 0;
+	MYSQL_BIND	params[4];
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(state > MAPISTORE_CN_INDEX_READY, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	stmt_bind_string(&params[0], username);
+	stmt_bind_uint64(&params[1], &fid);
+	stmt_bind_uint64(&params[2], &type);
+	stmt_bind_uint64(&params[3], &value);
+
+	if (state == MAPISTORE_CN_INDEX_READY) {
+		if (generation) {
+			value = *generation;
+			ret = execute_stmt(MYSQL(ictx),
+				"UPDATE "INDEXING_CN_STATE_TABLE" SET state = 2 "
+				"WHERE username = ? AND folder_id = ? AND table_type = ? "
+				"AND state = 1 AND generation = ?", params, &affected_rows);
+		} else {
+			ret = execute_stmt(MYSQL(ictx),
+				"UPDATE "INDEXING_CN_STATE_TABLE" SET state = 2 "
+				"WHERE username = ? AND folder_id = ? AND table_type = ? "
+				"AND state = 1", params, &affected_rows);
+		}
+		MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
+		MAPISTORE_RETVAL_IF(!affected_rows, MAPISTORE_ERR_NOT_FOUND, NULL);
+		return MAPISTORE_SUCCESS;
+	}
+
+	ret = execute_query(MYSQL(ictx), "START TRANSACTION");
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	ret = execute_stmt(MYSQL(ictx),
+		"DELETE FROM "INDEXING_CN_TABLE" "
+		"WHERE username = ? AND folder_id = ? AND table_type = ?", params, NULL);
+	if (ret != MYSQL_SUCCESS) goto rollback;
+
+	/* The generation outlives a drop, a stale seeding must not match a newer one */
+	if (state == MAPISTORE_CN_INDEX_NONE) {
+		ret = execute_stmt(MYSQL(ictx),
+			"UPDATE "INDEXING_CN_STATE_TABLE" SET state = 0 "
+			"WHERE username = ? AND folder_id = ? AND table_type = ?", params, NULL);
+		if (ret != MYSQL_SUCCESS) goto rollback;
+	} else {
+		ret = execute_stmt(MYSQL(ictx),
+			"INSERT INTO "INDEXING_CN_STATE_TABLE" "
+			"(username, folder_id, table_type, state, generation) "
+			"VALUES (?, ?, ?, 1, 1) "
+			"ON DUPLICATE KEY UPDATE state = 1, "
+			"generation = IF(generation = 4294967295, 1, generation + 1)", params, NULL);
+		if (ret != MYSQL_SUCCESS) goto rollback;
+		ret = select_stmt_first_uint(MYSQL(ictx),
+			"SELECT generation FROM "INDEXING_CN_STATE_TABLE" "
+			"WHERE username = ? AND folder_id = ? AND table_type = ?", params, &value);
+		if (ret != MYSQL_SUCCESS) goto rollback;
+		if (generation) *generation = (uint32_t) value;
+	}
+
+	ret = execute_query(MYSQL(ictx), "COMMIT");
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	return MAPISTORE_SUCCESS;
+
+rollback:
+	execute_query(MYSQL(ictx), "ROLLBACK");
+	return MAPISTORE_ERR_DATABASE_OPS;
+}
+
+/**
+  \details Return the messages of a folder table changed after a
+	   given change number, in change number order
+
+  \param ictx valid pointer to indexing context
+  \param username samAccountName for current user
+  \param mem_ctx pointer to the memory context
+  \param fid the folder identifier
+  \param table_type MAPISTORE_MESSAGE_TABLE or MAPISTORE_FAI_TABLE
+  \param cn the change number known by the client
+  \param midsp pointer to the returned message identifiers
+
+  \return MAPISTORE_SUCCESS on success
+	  MAPISTORE_ERR_NOT_FOUND if the table index is not ready
+	  MAPISTORE_ERR_NOT_INITIALIZED if ictx pointer is invalid (NULL)
+	  MAPISTORE_ERR_INVALID_PARAMETER in case other parameters are not valid
+	  MAPISTORE_ERR_DATABASE_OPS in case of MySQL error
+ */
+static enum mapistore_error mysql_record_get_changes(struct indexing_context *ictx,
+						     const char *username,
+						     TALLOC_CTX *mem_ctx,
+						     uint64_t fid,
+						     enum mapistore_table_type table_type,
+						     uint64_t cn,
+						     struct UI8Array_r **midsp)
+{
+	TALLOC_CTX		*local_mem_ctx;
+	enum MYSQLRESULT	ret;
+	struct UI8Array_r	*mids;
+	MYSQL_RES		*res;
+	MYSQL_ROW		row;
+	const char		*sql;
+	uint32_t		i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!midsp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	if (mysql_cn_index_state(ictx, username, fid, table_type) != MAPISTORE_CN_INDEX_READY) {
+		return MAPISTORE_ERR_NOT_FOUND;
+	}
+
+	mids = talloc_zero(mem_ctx, struct UI8Array_r);
+	MAPISTORE_RETVAL_IF(!mids, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	local_mem_ctx = talloc_named(NULL, 0, "mysql_record_get_changes");
+	sql = talloc_asprintf(local_mem_ctx,
+		"SELECT mid FROM "INDEXING_CN_TABLE" "
+		"WHERE username = '%s' AND folder_id = %"PRIu64" AND table_type = %d "
+		"AND cn > %"PRIu64" ORDER BY cn",
+		_sql(local_mem_ctx, username), fid, table_type, cn);
+	ret = select_without_fetch(MYSQL(ictx), sql, &res);
+	talloc_free(local_mem_ctx);
+
+	if (ret == MYSQL_SUCCESS) {
+		mids->cValues = mysql_num_rows(res);
+		mids->lpui8 = talloc_array(mids, uint64_t, mids->cValues);
+		for (i = 0; i < mids->cValues; i++) {
+			row = mysql_fetch_row(res);
+			if (!row || !convert_string_to_ull(row[0], &mids->lpui8[i])) {
+				mysql_free_result(res);
+				talloc_free(mids);
+				return MAPISTORE_ERR_DATABASE_OPS;
+			}
+		}
+		mysql_free_result(res);
+	} else if (ret != MYSQL_NOT_FOUND) {
+		talloc_free(mids);
+		return MAPISTORE_ERR_DATABASE_OPS;
+	}
+
+	*midsp = mids;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
 static int mapistore_indexing_mysql_destructor(struct indexing_context *ictx)
 {
 	if (ictx && ictx->data) {
@@ -491,7 +782,8 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_mysql_init(struct mapistore_con
 	talloc_set_destructor(ictx, mapistore_indexing_mysql_destructor);
 	MAPISTORE_RETVAL_IF(!ictx->data, MAPISTORE_ERR_NOT_INITIALIZED, ictx);
 
-	if (!table_exists(conn, INDEXING_TABLE)) {
+	/* Tables are created if missing: this also upgrades existing schemas */
+	if (!table_exists(conn, INDEXING_TABLE) || !table_exists(conn, INDEXING_CN_TABLE)) {
 		DEBUG(3, ("Creating schema for indexing on mysql %s\n", connection_string));
 
 		schema_file = talloc_asprintf(ictx, "%s/%s", MAPISTORE_LDIF, INDEXING_SCHEMA_FILE);
@@ -518,6 +810,10 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_mysql_init(struct mapistore_con
 	ictx->get_fmid = mysql_record_get_fmid;
 	ictx->allocate_fmid = mysql_record_allocate_fmid;
 	ictx->allocate_fmids = mysql_record_allocate_fmids;
+	ictx->set_cns = mysql_record_set_cns;
+	ictx->del_cn = mysql_record_del_cn;
+	ictx->set_cn_index_state = mysql_record_set_cn_index_state;
+	ictx->get_changes = mysql_record_get_changes;
 
 	*ictxp = ictx;
 
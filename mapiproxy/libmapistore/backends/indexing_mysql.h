@@ -26,6 +26,8 @@
 #define INDEXING_SCHEMA_FILE	"indexing_schema.sql"
 #define INDEXING_TABLE		"mapistore_indexing"
 #define INDEXING_ALLOC_TABLE	"mapistore_indexes"
+#define INDEXING_CN_TABLE	"mapistore_cn_index"
+#define INDEXING_CN_STATE_TABLE	"mapistore_cn_index_state"
 
 
 enum mapistore_error mapistore_indexing_mysql_init(struct mapistore_context *,
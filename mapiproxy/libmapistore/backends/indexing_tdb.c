@@ -34,6 +34,146 @@
 
 #define	TDB_WRAP(context)	((struct tdb_wrap*)context->data)
 
+/* FMID records are keyed by "0x%.16"PRIx64 strings, name index
+   values are plain concatenations of them */
+#define	TDB_FMID_STR_LEN	18
+
+
+/**
+   \details Return a copy of the URI without its trailing slash, the
+   form used by the reverse index keys
+ */
+static char *tdb_normalize_uri(TALLOC_CTX *mem_ctx, const char *uri, size_t len)
+{
+	if (len && uri[len - 1] == '/') {
+		len--;
+	}
+
+	return talloc_strndup(mem_ctx, uri, len);
+}
+
+static const char *tdb_uri_name(const char *uri)
+{
+	const char	*slash_ptr;
+
+	slash_ptr = strrchr(uri, '/');
+
+	return slash_ptr ? slash_ptr + 1 : uri;
+}
+
+static bool tdb_uri_match(const char *uri, size_t len, const char *startswith, const char *endswith)
+{
+	size_t	start_len = strlen(startswith);
+	size_t	end_len = strlen(endswith);
+
+	if (len < start_len + end_len) return false;
+
+	return (!memcmp(uri, startswith, start_len) &&
+		!memcmp(uri + len - end_len, endswith, end_len));
+}
+
+static TDB_DATA tdb_index_key(TALLOC_CTX *mem_ctx, const char *tag, const char *value)
+{
+	TDB_DATA	key;
+
+	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%s", tag, value);
+	key.dsize = strlen((const char *) key.dptr);
+
+	return key;
+}
+
+
+/**
+   \details Add the reverse index entries of a record
+
+   \param tdb pointer to the indexing database
+   \param fmid the fmid of the record
+   \param uri the URI of the record
+   \param len length of the URI
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERR_DATABASE_OPS
+ */
+static enum mapistore_error tdb_index_add(struct tdb_context *tdb, uint64_t fmid,
+					  const char *uri, size_t len)
+{
+	TALLOC_CTX	*mem_ctx;
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		*norm_uri;
+	int		ret;
+
+	mem_ctx = talloc_named(NULL, 0, "tdb_index_add");
+	norm_uri = tdb_normalize_uri(mem_ctx, uri, len);
+
+	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%.16"PRIx64, fmid);
+	dbuf.dsize = TDB_FMID_STR_LEN;
+
+	key = tdb_index_key(mem_ctx, MAPISTORE_INDEXING_URI_TAG, norm_uri);
+	ret = tdb_store(tdb, key, dbuf, TDB_REPLACE);
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+
+	key = tdb_index_key(mem_ctx, MAPISTORE_INDEXING_NAME_TAG, tdb_uri_name(norm_uri));
+	ret = tdb_append(tdb, key, dbuf);
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+
+	talloc_free(mem_ctx);
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Remove the reverse index entries of a record
+
+   \param tdb pointer to the indexing database
+   \param fmid the fmid of the record
+   \param uri the URI of the record
+   \param len length of the URI
+ */
+static void tdb_index_del(struct tdb_context *tdb, uint64_t fmid, const char *uri, size_t len)
+{
+	TALLOC_CTX	*mem_ctx;
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		*norm_uri;
+	char		*fmid_str;
+	size_t		i;
+
+	mem_ctx = talloc_named(NULL, 0, "tdb_index_del");
+	norm_uri = tdb_normalize_uri(mem_ctx, uri, len);
+	fmid_str = talloc_asprintf(mem_ctx, "0x%.16"PRIx64, fmid);
+
+	/* Another record may have been indexed under the same URI since */
+	key = tdb_index_key(mem_ctx, MAPISTORE_INDEXING_URI_TAG, norm_uri);
+	dbuf = tdb_fetch(tdb, key);
+	if (dbuf.dptr) {
+		if (dbuf.dsize == TDB_FMID_STR_LEN && !memcmp(dbuf.dptr, fmid_str, TDB_FMID_STR_LEN)) {
+			tdb_delete(tdb, key);
+		}
+		free(dbuf.dptr);
+	}
+
+	key = tdb_index_key(mem_ctx, MAPISTORE_INDEXING_NAME_TAG, tdb_uri_name(norm_uri));
+	dbuf = tdb_fetch(tdb, key);
+	if (dbuf.dptr) {
+		for (i = 0; i + TDB_FMID_STR_LEN <= dbuf.dsize; i += TDB_FMID_STR_LEN) {
+			if (!memcmp(dbuf.dptr + i, fmid_str, TDB_FMID_STR_LEN)) {
+				memmove(dbuf.dptr + i, dbuf.dptr + i + TDB_FMID_STR_LEN,
+					dbuf.dsize - i - TDB_FMID_STR_LEN);
+				dbuf.dsize -= TDB_FMID_STR_LEN;
+				if (dbuf.dsize) {
+					tdb_store(tdb, key, dbuf, TDB_MODIFY);
+				} else {
+					tdb_delete(tdb, key);
+				}
+				break;
+			}
+		}
+		free(dbuf.dptr);
+	}
+
+	talloc_free(mem_ctx);
+}
 
 
 static enum mapistore_error tdb_search_existing_fmid(struct indexing_context *ictx,
@@ -110,7 +250,7 @@ static enum mapistore_error tdb_record_add(struct indexing_context *ictx,
 		return MAPISTORE_ERR_DATABASE_OPS;
 	}
 
-	return MAPISTORE_SUCCESS;
+	return tdb_index_add(TDB_WRAP(ictx)->tdb, fmid, mapistore_URI, strlen(mapistore_URI));
 }
 
 static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
@@ -121,6 +261,7 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	int		ret;
 	TDB_DATA	key;
 	TDB_DATA	dbuf;
+	TDB_DATA	old_dbuf;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -135,6 +276,9 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	dbuf.dptr = (unsigned char *) talloc_strdup(ictx, mapistore_URI);
 	dbuf.dsize = strlen((const char *) dbuf.dptr);
 
+	/* Retrieve the previous URI to update the reverse index */
+	old_dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+
 	ret = tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_MODIFY);
 	talloc_free(key.dptr);
 	talloc_free(dbuf.dptr);
@@ -142,10 +286,16 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	if (ret == -1) {
 		DEBUG(3, ("[%s:%d]: Unable to update 0x%.16"PRIx64" record: %s\n", __FUNCTION__, __LINE__,
 			  fmid, mapistore_URI));
+		free(old_dbuf.dptr);
 		return MAPISTORE_ERR_NOT_FOUND;
 	}
 
-	return MAPISTORE_SUCCESS;
+	if (old_dbuf.dptr) {
+		tdb_index_del(TDB_WRAP(ictx)->tdb, fmid, (const char *) old_dbuf.dptr, old_dbuf.dsize);
+		free(old_dbuf.dptr);
+	}
+
+	return tdb_index_add(TDB_WRAP(ictx)->tdb, fmid, mapistore_URI, strlen(mapistore_URI));
 }
 
 static enum mapistore_error tdb_record_del(struct indexing_context *ictx,
@@ -195,9 +345,17 @@ static enum mapistore_error tdb_record_del(struct indexing_context *ictx,
 		talloc_free(newkey.dptr);
 		break;
 	case MAPISTORE_PERMANENT_DELETE:
+		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
 		ret = tdb_delete(TDB_WRAP(ictx)->tdb, key);
 		talloc_free(key.dptr);
-		MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
+		if (ret) {
+			free(dbuf.dptr);
+			return MAPISTORE_ERR_DATABASE_OPS;
+		}
+		if (dbuf.dptr) {
+			tdb_index_del(TDB_WRAP(ictx)->tdb, fmid, (const char *) dbuf.dptr, dbuf.dsize);
+			free(dbuf.dptr);
+		}
 		break;
 	default:
 		return MAPISTORE_ERR_INVALID_PARAMETER;
@@ -256,83 +414,97 @@ static enum mapistore_error tdb_record_get_uri(struct indexing_context *ictx,
 }
 
 /**
-   \details A slow but effective way to retrieve an fmid from a uri
+   \details Check whether an fmid candidate returned by the reverse
+   index still points to a record matching the searched URI
+
+   \param ictx pointer to the indexing context
+   \param username the username
+   \param fmid_str fmid candidate as stored in the index
+   \param uri the URI, or NULL to match startswith and endswith
+   \param startswith the beginning of the URI pattern
+   \param endswith the end of the URI pattern
+   \param fmidp pointer to the fmid to return
+   \param soft_deletedp pointer to the soft deleted state to return
+
+   \return true if the record matches, otherwise false
+ */
+static bool tdb_index_check_candidate(struct indexing_context *ictx, const char *username,
+				      const char *fmid_str, const char *uri,
+				      const char *startswith, const char *endswith,
+				      uint64_t *fmidp, bool *soft_deletedp)
+{
+	enum mapistore_error	ret;
+	uint64_t		fmid;
+	char			*record_uri = NULL;
+	char			*norm_uri;
+	bool			soft_deleted;
+	bool			found = false;
+
+	fmid = strtoull(fmid_str, NULL, 16);
+	if (!fmid) return false;
+
+	ret = tdb_record_get_uri(ictx, username, NULL, fmid, &record_uri, &soft_deleted);
+	if (ret != MAPISTORE_SUCCESS) return false;
+
+	norm_uri = tdb_normalize_uri(record_uri, record_uri, strlen(record_uri));
+	if (uri) {
+		found = (strcmp(norm_uri, uri) == 0);
+	} else {
+		found = tdb_uri_match(norm_uri, strlen(norm_uri), startswith, endswith);
+	}
+	talloc_free(record_uri);
 
-   \param mstore_ctx pointer to the mapistore context
-   \param mem_ctx pointer to the talloc context
-   \param fmid the fmid/key to the record
-   \param urip pointer to the uri pointer
-   \param soft_deletedp pointer to the soft deleted pointer
+	if (found) {
+		*fmidp = fmid;
+		*soft_deletedp = soft_deleted;
+	}
 
-   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+	return found;
+}
+
+/**
+   \details Fallback for URI patterns the reverse index can't
+   resolve: walk the whole database
  */
 struct tdb_get_fid_data {
 	bool		found;
 	uint64_t	fmid;
-	char		*uri;
-	size_t		uri_len;
-	uint32_t	wildcard_count;
-	char		*startswith;
-	char		*endswith;
+	bool		soft_deleted;
+	const char	*startswith;
+	const char	*endswith;
 };
 
-static int tdb_get_fid_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+static int tdb_get_fid_traverse_partial(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
 {
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
-	TALLOC_CTX		*mem_ctx;
-	int			ret = 0;
-
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-	}
-	if (strcmp(cmp_uri, tdb_data->uri) == 0) {
-		key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		tdb_data->fmid = strtoull(key_str, NULL, 16);
-		tdb_data->found = true;
-		ret = 1;
-	}
-	
-	talloc_free(mem_ctx);
+	struct tdb_get_fid_data	*tdb_data = data;
+	const char		*key_str = (const char *) key.dptr;
+	size_t			tag_len = strlen(MAPISTORE_SOFT_DELETED_TAG);
+	size_t			len = value.dsize;
+	char			fmid_str[TDB_FMID_STR_LEN + 1];
+	bool			soft_deleted = false;
+
+	/* Skip the counter and the reverse index */
+	if (key.dsize == TDB_FMID_STR_LEN + tag_len && !strncmp(key_str, MAPISTORE_SOFT_DELETED_TAG, tag_len)) {
+		key_str += tag_len;
+		soft_deleted = true;
+	} else if (key.dsize != TDB_FMID_STR_LEN || strncmp(key_str, "0x", 2)) {
+		return 0;
+	}
 
-	return ret;
-}
+	if (len && value.dptr[len - 1] == '/') {
+		len--;
+	}
+	if (!tdb_uri_match((const char *) value.dptr, len, tdb_data->startswith, tdb_data->endswith)) {
+		return 0;
+	}
 
-static int tdb_get_fid_traverse_partial(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
-{
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
-	TALLOC_CTX		*mem_ctx;
-	int			ret = 0;
-
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-	}
-
-	if (!strncmp(cmp_uri, tdb_data->startswith, strlen(tdb_data->startswith)) &&
-	    !strncmp(cmp_uri + (strlen(cmp_uri) - strlen(tdb_data->endswith)), tdb_data->endswith, 
-		     strlen(tdb_data->endswith))) {
-		    key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		    tdb_data->fmid = strtoull(key_str, NULL, 16);
-		    tdb_data->found = true;
-		    ret = 1;
-	}
-	
-	talloc_free(mem_ctx);
+	memcpy(fmid_str, key_str, TDB_FMID_STR_LEN);
+	fmid_str[TDB_FMID_STR_LEN] = 0;
+	tdb_data->fmid = strtoull(fmid_str, NULL, 16);
+	tdb_data->soft_deleted = soft_deleted;
+	tdb_data->found = true;
 
-	return ret;
+	return 1;
 }
 
 static enum mapistore_error tdb_record_get_fmid(struct indexing_context *ictx,
@@ -340,10 +512,16 @@ static enum mapistore_error tdb_record_get_fmid(struct indexing_context *ictx,
 					        const char *uri, bool partial,
 					        uint64_t *fmidp, bool *soft_deletedp)
 {
-	int				ret;
+	TALLOC_CTX			*mem_ctx;
 	struct tdb_get_fid_data		tdb_data;
-	char				*slash_ptr;
-	uint32_t			i;
+	TDB_DATA			key;
+	TDB_DATA			dbuf;
+	char				*norm_uri;
+	char				*fmid_str;
+	const char			*name;
+	const char			*wildcard;
+	bool				found = false;
+	size_t				i;
 
 	/* SANITY checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -352,60 +530,64 @@ static enum mapistore_error tdb_record_get_fmid(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!fmidp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	/* Check if the fmid exists within the database */
-	tdb_data.found = false;
-	tdb_data.uri = talloc_strdup(NULL, uri);
-	tdb_data.uri_len = strlen(uri);
-
-	tdb_data.startswith = NULL;
-	tdb_data.endswith = NULL;
-	tdb_data.wildcard_count = 0;
+	mem_ctx = talloc_named(NULL, 0, "tdb_record_get_fmid");
+	norm_uri = tdb_normalize_uri(mem_ctx, uri, strlen(uri));
 
-	slash_ptr = tdb_data.uri + tdb_data.uri_len - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-		tdb_data.uri_len--;
+	wildcard = partial ? strchr(norm_uri, '*') : NULL;
+	if (wildcard && strchr(wildcard + 1, '*')) {
+		DEBUG(0, ("[%s:%d]: Too many wildcards found (1 maximum)\n", __FUNCTION__, __LINE__));
+		talloc_free(mem_ctx);
+		return MAPISTORE_ERR_NOT_FOUND;
 	}
-	if (partial == false) {
-		tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse, &tdb_data);
-	} else {
-		for (tdb_data.wildcard_count = 0, i = 0; i < strlen(uri); i++) {
-			if (uri[i] == '*') tdb_data.wildcard_count += 1;
-		}
 
-		switch (tdb_data.wildcard_count) {
-		case 0: /* complete URI */
-			partial = true;
-			break;
-		case 1: /* start and end only */
-			tdb_data.endswith = strchr(uri, '*') + 1;
-			tdb_data.startswith = talloc_strndup(NULL, uri, strlen(uri) - strlen(tdb_data.endswith) - 1);
-			break;
-		default:
-			DEBUG(0, ("[%s:%d]: Too many wildcards found (1 maximum)\n", __FUNCTION__, __LINE__));
-			talloc_free(tdb_data.uri);
-			return MAPISTORE_ERR_NOT_FOUND;
+	if (!wildcard) {
+		/* complete URI */
+		key = tdb_index_key(mem_ctx, MAPISTORE_INDEXING_URI_TAG, norm_uri);
+		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+		if (dbuf.dptr) {
+			fmid_str = talloc_strndup(mem_ctx, (const char *) dbuf.dptr, dbuf.dsize);
+			found = tdb_index_check_candidate(ictx, username, fmid_str, norm_uri, NULL, NULL,
+							  fmidp, soft_deletedp);
+			free(dbuf.dptr);
 		}
+		talloc_free(mem_ctx);
+		return found ? MAPISTORE_SUCCESS : MAPISTORE_ERR_NOT_FOUND;
+	}
 
-		if (partial == true) {
-			tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse_partial, &tdb_data);
-			talloc_free(tdb_data.startswith);
-		} else {
-			tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse, &tdb_data);
+	tdb_data.found = false;
+	tdb_data.endswith = wildcard + 1;
+	tdb_data.startswith = talloc_strndup(mem_ctx, norm_uri, wildcard - norm_uri);
+
+	/* If the pattern ends with a complete URI segment, only
+	   records sharing this basename can match */
+	name = tdb_uri_name(tdb_data.endswith);
+	if (name != tdb_data.endswith && *name) {
+		key = tdb_index_key(mem_ctx, MAPISTORE_INDEXING_NAME_TAG, name);
+		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+		if (dbuf.dptr) {
+			fmid_str = talloc_array(mem_ctx, char, TDB_FMID_STR_LEN + 1);
+			fmid_str[TDB_FMID_STR_LEN] = 0;
+			for (i = 0; !found && i + TDB_FMID_STR_LEN <= dbuf.dsize; i += TDB_FMID_STR_LEN) {
+				memcpy(fmid_str, dbuf.dptr + i, TDB_FMID_STR_LEN);
+				found = tdb_index_check_candidate(ictx, username, fmid_str, NULL,
+								  tdb_data.startswith, tdb_data.endswith,
+								  fmidp, soft_deletedp);
+			}
+			free(dbuf.dptr);
 		}
+		talloc_free(mem_ctx);
+		return found ? MAPISTORE_SUCCESS : MAPISTORE_ERR_NOT_FOUND;
 	}
 
-	talloc_free(tdb_data.uri);
-	if (tdb_data.found) {
-		*fmidp = tdb_data.fmid;
-		*soft_deletedp = false; /* TODO: implement the feature */
-		ret = MAPISTORE_SUCCESS;
-	}
-	else {
-		ret = MAPISTORE_ERR_NOT_FOUND;
-	}
+	tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse_partial, &tdb_data);
+	talloc_free(mem_ctx);
+
+	MAPISTORE_RETVAL_IF(!tdb_data.found, MAPISTORE_ERR_NOT_FOUND, NULL);
+
+	*fmidp = tdb_data.fmid;
+	*soft_deletedp = tdb_data.soft_deleted;
 
-	return ret;
+	return MAPISTORE_SUCCESS;
 }
 
 
@@ -462,6 +644,641 @@ static enum mapistore_error tdb_record_allocate_fmid(struct indexing_context *ic
 }
 
 
+/* Change number index
+
+   Each indexed folder table has a record holding its state followed
+   by (CN, MID) entries sorted by CN, so the changes after a given CN
+   are a binary search away. Each indexed MID has a record pointing
+   back to its entry. Entries of a table being seeded are appended
+   unsorted and sorted once when it becomes ready. The header also
+   holds the generation of the last seeding, kept when the index is
+   dropped so that a stale seeding can't mark a newer one ready. */
+
+struct tdb_cn_entry {
+	uint64_t	cn;
+	uint64_t	mid;
+};
+
+struct tdb_cn_location {
+	uint64_t	fid;
+	uint64_t	cn;
+	uint32_t	table_type;
+	uint32_t	padding;
+};
+
+struct tdb_cn_index {
+	uint32_t		state;
+	uint32_t		generation;
+	uint32_t		count;
+	struct tdb_cn_entry	*entries;
+};
+
+#define	TDB_CN_HEADER_LEN	(2 * sizeof (uint32_t))
+
+static TDB_DATA tdb_cn_index_key(TALLOC_CTX *mem_ctx, uint64_t fid, enum mapistore_table_type table_type)
+{
+	TDB_DATA	key;
+
+	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%d:0x%.16"PRIx64,
+						     MAPISTORE_INDEXING_CN_TAG, table_type, fid);
+	key.dsize = strlen((const char *) key.dptr);
+
+	return key;
+}
+
+static TDB_DATA tdb_cn_mid_key(TALLOC_CTX *mem_ctx, uint64_t mid)
+{
+	TDB_DATA	key;
+
+	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s0x%.16"PRIx64,
+						     MAPISTORE_INDEXING_CN_MID_TAG, mid);
+	key.dsize = strlen((const char *) key.dptr);
+
+	return key;
+}
+
+static bool tdb_cn_location_fetch(struct tdb_context *tdb, TDB_DATA key, struct tdb_cn_location *location)
+{
+	TDB_DATA	dbuf;
+	bool		found = false;
+
+	dbuf = tdb_fetch(tdb, key);
+	if (dbuf.dptr) {
+		if (dbuf.dsize == sizeof (struct tdb_cn_location)) {
+			memcpy(location, dbuf.dptr, sizeof (struct tdb_cn_location));
+			found = true;
+		}
+		free(dbuf.dptr);
+	}
+
+	return found;
+}
+
+/**
+   \details Load the change number index of a folder table, with
+   room for extra entries
+
+   A missing record is returned as an empty index in the
+   MAPISTORE_CN_INDEX_NONE state, with a null generation.
+ */
+static void tdb_cn_index_fetch(TALLOC_CTX *mem_ctx, struct tdb_context *tdb, TDB_DATA key,
+			       uint32_t extra, struct tdb_cn_index *index)
+{
+	TDB_DATA	dbuf;
+
+	index->state = MAPISTORE_CN_INDEX_NONE;
+	index->generation = 0;
+	index->count = 0;
+
+	dbuf = tdb_fetch(tdb, key);
+	if (dbuf.dptr && dbuf.dsize >= TDB_CN_HEADER_LEN) {
+		memcpy(&index->state, dbuf.dptr, sizeof (uint32_t));
+		memcpy(&index->generation, dbuf.dptr + sizeof (uint32_t), sizeof (uint32_t));
+		index->count = (dbuf.dsize - TDB_CN_HEADER_LEN) / sizeof (struct tdb_cn_entry);
+	}
+
+	index->entries = talloc_array(mem_ctx, struct tdb_cn_entry, index->count + extra);
+	if (index->count) {
+		memcpy(index->entries, dbuf.dptr + TDB_CN_HEADER_LEN, index->count * sizeof (struct tdb_cn_entry));
+	}
+	free(dbuf.dptr);
+}
+
+static enum mapistore_error tdb_cn_index_store(TALLOC_CTX *mem_ctx, struct tdb_context *tdb, TDB_DATA key,
+					       struct tdb_cn_index *index)
+{
+	TDB_DATA	dbuf;
+	uint32_t	header[2];
+	int		ret;
+
+	/* Never seeded, nothing worth keeping */
+	if (index->state == MAPISTORE_CN_INDEX_NONE && !index->generation) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	header[0] = index->state;
+	header[1] = index->generation;
+	dbuf.dsize = TDB_CN_HEADER_LEN + index->count * sizeof (struct tdb_cn_entry);
+	dbuf.dptr = talloc_array(mem_ctx, unsigned char, dbuf.dsize);
+	MAPISTORE_RETVAL_IF(!dbuf.dptr, MAPISTORE_ERR_NO_MEMORY, NULL);
+	memcpy(dbuf.dptr, header, TDB_CN_HEADER_LEN);
+	if (index->count) {
+		memcpy(dbuf.dptr + TDB_CN_HEADER_LEN, index->entries, index->count * sizeof (struct tdb_cn_entry));
+	}
+
+	ret = tdb_store(tdb, key, dbuf, TDB_REPLACE);
+	talloc_free(dbuf.dptr);
+	MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
+/* Return the position of the first entry with a CN above cn */
+static uint32_t tdb_cn_index_upper_bound(const uint8_t *entries, uint32_t count, uint64_t cn)
+{
+	uint32_t	low = 0;
+	uint32_t	high = count;
+	uint32_t	middle;
+	uint64_t	middle_cn;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		memcpy(&middle_cn, entries + middle * sizeof (struct tdb_cn_entry), sizeof (uint64_t));
+		if (middle_cn <= cn) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+static void tdb_cn_index_remove(struct tdb_cn_index *index, uint64_t mid, uint64_t cn)
+{
+	uint32_t	i = 0;
+
+	if (index->state == MAPISTORE_CN_INDEX_READY && cn) {
+		i = tdb_cn_index_upper_bound((const uint8_t *) index->entries, index->count, cn - 1);
+	}
+	for (; i < index->count; i++) {
+		if (index->entries[i].mid == mid) {
+			memmove(index->entries + i, index->entries + i + 1,
+				(index->count - i - 1) * sizeof (struct tdb_cn_entry));
+			index->count--;
+			return;
+		}
+	}
+}
+
+static void tdb_cn_index_insert(struct tdb_cn_index *index, uint64_t mid, uint64_t cn)
+{
+	uint32_t	i = index->count;
+
+	/* CNs are allocated in increasing order: this is an append
+	   most of the time */
+	if (index->state == MAPISTORE_CN_INDEX_READY && i && index->entries[i - 1].cn > cn) {
+		i = tdb_cn_index_upper_bound((const uint8_t *) index->entries, index->count, cn);
+		memmove(index->entries + i + 1, index->entries + i,
+			(index->count - i) * sizeof (struct tdb_cn_entry));
+	}
+	index->entries[i].cn = cn;
+	index->entries[i].mid = mid;
+	index->count++;
+}
+
+static int tdb_cn_entry_cmp(const void *a, const void *b)
+{
+	const struct tdb_cn_entry	*entry_a = a;
+	const struct tdb_cn_entry	*entry_b = b;
+
+	if (entry_a->cn != entry_b->cn) {
+		return (entry_a->cn < entry_b->cn) ? -1 : 1;
+	}
+	if (entry_a->mid != entry_b->mid) {
+		return (entry_a->mid < entry_b->mid) ? -1 : 1;
+	}
+	return 0;
+}
+
+/**
+   \details Remove the entry of a message from the index of a folder
+   table other than the one being updated
+ */
+static void tdb_cn_index_remove_other(struct tdb_context *tdb, struct tdb_cn_location *location, uint64_t mid)
+{
+	TALLOC_CTX		*mem_ctx;
+	TDB_DATA		key;
+	struct tdb_cn_index	index;
+
+	mem_ctx = talloc_named(NULL, 0, "tdb_cn_index_remove_other");
+	key = tdb_cn_index_key(mem_ctx, location->fid, location->table_type);
+	if (tdb_chainlock(tdb, key) == 0) {
+		tdb_cn_index_fetch(mem_ctx, tdb, key, 0, &index);
+		if (index.state != MAPISTORE_CN_INDEX_NONE) {
+			tdb_cn_index_remove(&index, mid, location->cn);
+			tdb_cn_index_store(mem_ctx, tdb, key, &index);
+		}
+		tdb_chainunlock(tdb, key);
+	}
+	talloc_free(mem_ctx);
+}
+
+/**
+   \details Record the change numbers of messages of a folder table
+
+   Messages already indexed elsewhere are moved to this table. Tables
+   that are not indexed are left untouched.
+
+   \param ictx pointer to the indexing context
+   \param username the username
+   \param fid the folder identifier
+   \param table_type MAPISTORE_MESSAGE_TABLE or MAPISTORE_FAI_TABLE
+   \param count the number of messages
+   \param mids the message identifiers
+   \param cns the PidTagChangeNumber of each message
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error tdb_record_set_cns(struct indexing_context *ictx,
+					       const char *username,
+					       uint64_t fid,
+					       enum mapistore_table_type table_type,
+					       uint32_t count,
+					       const uint64_t *mids,
+					       const uint64_t *cns)
+{
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	retval = MAPISTORE_SUCCESS;
+	struct tdb_context	*tdb;
+	TDB_DATA		key, mid_key, dbuf;
+	struct tdb_cn_index	index;
+	struct tdb_cn_location	location, *moved;
+	uint64_t		*moved_mids;
+	uint32_t		i, moved_count = 0;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(count && (!mids || !cns), MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	tdb = TDB_WRAP(ictx)->tdb;
+	mem_ctx = talloc_named(NULL, 0, "tdb_record_set_cns");
+	key = tdb_cn_index_key(mem_ctx, fid, table_type);
+	MAPISTORE_RETVAL_IF(tdb_chainlock(tdb, key), MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+
+	tdb_cn_index_fetch(mem_ctx, tdb, key, count, &index);
+	if (index.state == MAPISTORE_CN_INDEX_NONE) {
+		tdb_chainunlock(tdb, key);
+		talloc_free(mem_ctx);
+		return MAPISTORE_SUCCESS;
+	}
+
+	moved = talloc_array(mem_ctx, struct tdb_cn_location, count);
+	moved_mids = talloc_array(mem_ctx, uint64_t, count);
+	for (i = 0; retval == MAPISTORE_SUCCESS && i < count; i++) {
+		mid_key = tdb_cn_mid_key(mem_ctx, mids[i]);
+		if (tdb_cn_location_fetch(tdb, mid_key, &location)) {
+			if (location.fid == fid && location.table_type == table_type) {
+				if (location.cn >= cns[i]) {
+					talloc_free(mid_key.dptr);
+					continue;
+				}
+				tdb_cn_index_remove(&index, mids[i], location.cn);
+			} else {
+				moved[moved_count] = location;
+				moved_mids[moved_count] = mids[i];
+				moved_count++;
+			}
+		}
+		tdb_cn_index_insert(&index, mids[i], cns[i]);
+
+		memset(&location, 0, sizeof (struct tdb_cn_location));
+		location.fid = fid;
+		location.cn = cns[i];
+		location.table_type = table_type;
+		dbuf.dptr = (unsigned char *) &location;
+		dbuf.dsize = sizeof (struct tdb_cn_location);
+		if (tdb_store(tdb, mid_key, dbuf, TDB_REPLACE) == -1) {
+			retval = MAPISTORE_ERR_DATABASE_OPS;
+		}
+		talloc_free(mid_key.dptr);
+	}
+
+	if (retval == MAPISTORE_SUCCESS) {
+		retval = tdb_cn_index_store(mem_ctx, tdb, key, &index);
+	}
+	tdb_chainunlock(tdb, key);
+
+	/* Never hold two chain locks at once */
+	for (i = 0; i < moved_count; i++) {
+		tdb_cn_index_remove_other(tdb, &moved[i], moved_mids[i]);
+	}
+
+	talloc_free(mem_ctx);
+
+	return retval;
+}
+
+/**
+   \details Remove a message from the change number index
+
+   \param ictx pointer to the indexing context
+   \param username the username
+   \param mid the message identifier
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error tdb_record_del_cn(struct indexing_context *ictx,
+					      const char *username,
+					      uint64_t mid)
+{
+	TALLOC_CTX		*mem_ctx;
+	struct tdb_context	*tdb;
+	TDB_DATA		mid_key;
+	struct tdb_cn_location	location;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!mid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	tdb = TDB_WRAP(ictx)->tdb;
+	mem_ctx = talloc_named(NULL, 0, "tdb_record_del_cn");
+	mid_key = tdb_cn_mid_key(mem_ctx, mid);
+	if (tdb_cn_location_fetch(tdb, mid_key, &location)) {
+		tdb_cn_index_remove_other(tdb, &location, mid);
+		tdb_delete(tdb, mid_key);
+	}
+	talloc_free(mem_ctx);
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Change the state of the change number index of a folder
+   table
+
+   Moving to MAPISTORE_CN_INDEX_NONE or MAPISTORE_CN_INDEX_SEEDING
+   drops the entries of the table, the latter also starts a new
+   generation. Moving from MAPISTORE_CN_INDEX_SEEDING to
+   MAPISTORE_CN_INDEX_READY sorts them, provided the generation is
+   still the current one.
+
+   \param ictx pointer to the indexing context
+   \param username the username
+   \param fid the folder identifier
+   \param table_type MAPISTORE_MESSAGE_TABLE or MAPISTORE_FAI_TABLE
+   \param state the new state
+   \param generation pointer to the seeding generation, set when
+   seeding and checked when ready
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_FOUND if
+   the table is not being seeded with this generation, otherwise
+   MAPISTORE error
+ */
+static enum mapistore_error tdb_record_set_cn_index_state(struct indexing_context *ictx,
+							  const char *username,
+							  uint64_t fid,
+							  enum mapistore_table_type table_type,
+							  enum mapistore_cn_index_state state,
+							  uint32_t *generation)
+{
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	retval;
+	struct tdb_context	*tdb;
+	TDB_DATA		key, mid_key;
+	struct tdb_cn_index	index;
+	struct tdb_cn_location	location;
+	uint32_t		i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(state > MAPISTORE_CN_INDEX_READY, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	tdb = TDB_WRAP(ictx)->tdb;
+	mem_ctx = talloc_named(NULL, 0, "tdb_record_set_cn_index_state");
+	key = tdb_cn_index_key(mem_ctx, fid, table_type);
+	MAPISTORE_RETVAL_IF(tdb_chainlock(tdb, key), MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+
+	tdb_cn_index_fetch(mem_ctx, tdb, key, 0, &index);
+	if (state == MAPISTORE_CN_INDEX_READY) {
+		if (index.state != MAPISTORE_CN_INDEX_SEEDING ||
+		    (generation && *generation != index.generation)) {
+			DEBUG(5, ("[%s:%d]: folder 0x%.16"PRIx64" is not being seeded with this generation\n",
+				  __FUNCTION__, __LINE__, fid));
+			tdb_chainunlock(tdb, key);
+			talloc_free(mem_ctx);
+			return MAPISTORE_ERR_NOT_FOUND;
+		}
+		qsort(index.entries, index.count, sizeof (struct tdb_cn_entry), tdb_cn_entry_cmp);
+	} else {
+		for (i = 0; i < index.count; i++) {
+			mid_key = tdb_cn_mid_key(mem_ctx, index.entries[i].mid);
+			if (tdb_cn_location_fetch(tdb, mid_key, &location) &&
+			    location.fid == fid && location.table_type == table_type) {
+				tdb_delete(tdb, mid_key);
+			}
+			talloc_free(mid_key.dptr);
+		}
+		index.count = 0;
+		if (state == MAPISTORE_CN_INDEX_SEEDING) {
+			index.generation++;
+			if (!index.generation) index.generation++;
+			if (generation) *generation = index.generation;
+		}
+	}
+	index.state = state;
+	retval = tdb_cn_index_store(mem_ctx, tdb, key, &index);
+
+	tdb_chainunlock(tdb, key);
+	talloc_free(mem_ctx);
+
+	return retval;
+}
+
+struct tdb_get_changes_data {
+	TALLOC_CTX		*mem_ctx;
+	uint64_t		cn;
+	struct UI8Array_r	*mids;
+};
+
+static int tdb_get_changes_parser(TDB_DATA key, TDB_DATA data, void *private_data)
+{
+	struct tdb_get_changes_data	*changes = private_data;
+	const uint8_t			*entries;
+	uint32_t			state, count, first, i;
+
+	if (data.dsize < TDB_CN_HEADER_LEN) return -1;
+	memcpy(&state, data.dptr, sizeof (uint32_t));
+	if (state != MAPISTORE_CN_INDEX_READY) return -1;
+
+	entries = data.dptr + TDB_CN_HEADER_LEN;
+	count = (data.dsize - TDB_CN_HEADER_LEN) / sizeof (struct tdb_cn_entry);
+	first = tdb_cn_index_upper_bound(entries, count, changes->cn);
+
+	changes->mids = talloc_zero(changes->mem_ctx, struct UI8Array_r);
+	if (!changes->mids) return -1;
+	changes->mids->cValues = count - first;
+	changes->mids->lpui8 = talloc_array(changes->mids, uint64_t, changes->mids->cValues);
+	for (i = first; i < count; i++) {
+		memcpy(&changes->mids->lpui8[i - first],
+		       entries + i * sizeof (struct tdb_cn_entry) + sizeof (uint64_t), sizeof (uint64_t));
+	}
+
+	return 0;
+}
+
+/**
+   \details Return the messages of a folder table changed after a
+   given change number, in change number order
+
+   \param ictx pointer to the indexing context
+   \param username the username
+   \param mem_ctx pointer to the memory context
+   \param fid the folder identifier
+   \param table_type MAPISTORE_MESSAGE_TABLE or MAPISTORE_FAI_TABLE
+   \param cn the change number known by the client
+   \param midsp pointer to the returned message identifiers
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_FOUND if
+   the table index is not ready, otherwise MAPISTORE error
+ */
+static enum mapistore_error tdb_record_get_changes(struct indexing_context *ictx,
+						   const char *username,
+						   TALLOC_CTX *mem_ctx,
+						   uint64_t fid,
+						   enum mapistore_table_type table_type,
+						   uint64_t cn,
+						   struct UI8Array_r **midsp)
+{
+	struct tdb_get_changes_data	changes;
+	TDB_DATA			key;
+	int				ret;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!fid, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!midsp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	changes.mem_ctx = mem_ctx;
+	changes.cn = cn;
+	changes.mids = NULL;
+
+	/* The index is searched in place, without copying it */
+	key = tdb_cn_index_key(NULL, fid, table_type);
+	ret = tdb_parse_record(TDB_WRAP(ictx)->tdb, key, tdb_get_changes_parser, &changes);
+	talloc_free(key.dptr);
+	MAPISTORE_RETVAL_IF(ret != 0 || !changes.mids, MAPISTORE_ERR_NOT_FOUND, NULL);
+
+	*midsp = changes.mids;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+struct tdb_index_migration {
+	TALLOC_CTX	*mem_ctx;
+	uint32_t	count;
+	uint64_t	*fmids;
+	char		**uris;
+};
+
+static int tdb_index_migration_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+{
+	struct tdb_index_migration	*migration = data;
+	const char			*key_str = (const char *) key.dptr;
+	size_t				tag_len = strlen(MAPISTORE_SOFT_DELETED_TAG);
+	char				fmid_str[TDB_FMID_STR_LEN + 1];
+
+	if (key.dsize == TDB_FMID_STR_LEN + tag_len && !strncmp(key_str, MAPISTORE_SOFT_DELETED_TAG, tag_len)) {
+		key_str += tag_len;
+	} else if (key.dsize != TDB_FMID_STR_LEN || strncmp(key_str, "0x", 2)) {
+		return 0;
+	}
+
+	if (!(migration->count % 1024)) {
+		migration->fmids = talloc_realloc(migration->mem_ctx, migration->fmids, uint64_t, migration->count + 1024);
+		migration->uris = talloc_realloc(migration->mem_ctx, migration->uris, char *, migration->count + 1024);
+		if (!migration->fmids || !migration->uris) return -1;
+	}
+
+	memcpy(fmid_str, key_str, TDB_FMID_STR_LEN);
+	fmid_str[TDB_FMID_STR_LEN] = 0;
+	migration->fmids[migration->count] = strtoull(fmid_str, NULL, 16);
+	migration->uris[migration->count] = talloc_strndup(migration->mem_ctx, (const char *) value.dptr, value.dsize);
+	migration->count++;
+
+	return 0;
+}
+
+static uint32_t tdb_index_version(struct tdb_context *tdb, TDB_DATA key)
+{
+	TDB_DATA	dbuf;
+	char		*version_str;
+	uint32_t	version = 0;
+
+	dbuf = tdb_fetch(tdb, key);
+	if (dbuf.dptr) {
+		version_str = talloc_strndup(NULL, (const char *) dbuf.dptr, dbuf.dsize);
+		version = strtoul(version_str, NULL, 10);
+		talloc_free(version_str);
+		free(dbuf.dptr);
+	}
+
+	return version;
+}
+
+/**
+   \details Build the reverse index of indexing databases created
+   before it was introduced
+
+   \param tdb pointer to the indexing database
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error tdb_index_migrate(struct tdb_context *tdb)
+{
+	struct tdb_index_migration	migration;
+	enum mapistore_error		retval = MAPISTORE_SUCCESS;
+	TDB_DATA			key;
+	TDB_DATA			dbuf;
+	uint32_t			version = 0;
+	uint32_t			i;
+
+	key.dptr = (unsigned char *) MAPISTORE_INDEXING_VERSION_KEY;
+	key.dsize = strlen(MAPISTORE_INDEXING_VERSION_KEY);
+
+	version = tdb_index_version(tdb, key);
+	MAPISTORE_RETVAL_IF(version >= MAPISTORE_INDEXING_VERSION, MAPISTORE_SUCCESS, NULL);
+
+	/* The transaction locks the database: check again whether
+	   another process migrated it in the meantime */
+	MAPISTORE_RETVAL_IF(tdb_transaction_start(tdb), MAPISTORE_ERR_DATABASE_OPS, NULL);
+	if (tdb_index_version(tdb, key) >= MAPISTORE_INDEXING_VERSION) {
+		tdb_transaction_cancel(tdb);
+		return MAPISTORE_SUCCESS;
+	}
+
+	memset(&migration, 0, sizeof (struct tdb_index_migration));
+	migration.mem_ctx = talloc_named(NULL, 0, "tdb_index_migrate");
+	if (tdb_traverse_read(tdb, tdb_index_migration_traverse, &migration) < 0) {
+		retval = MAPISTORE_ERR_DATABASE_OPS;
+	}
+
+	for (i = 0; retval == MAPISTORE_SUCCESS && i < migration.count; i++) {
+		retval = tdb_index_add(tdb, migration.fmids[i], migration.uris[i], strlen(migration.uris[i]));
+	}
+
+	if (retval == MAPISTORE_SUCCESS) {
+		dbuf.dptr = (unsigned char *) talloc_asprintf(migration.mem_ctx, "%d", MAPISTORE_INDEXING_VERSION);
+		dbuf.dsize = strlen((const char *) dbuf.dptr);
+		if (tdb_store(tdb, key, dbuf, TDB_REPLACE) == -1) {
+			retval = MAPISTORE_ERR_DATABASE_OPS;
+		}
+	}
+
+	if (retval != MAPISTORE_SUCCESS) {
+		tdb_transaction_cancel(tdb);
+	} else if (tdb_transaction_commit(tdb) == -1) {
+		retval = MAPISTORE_ERR_DATABASE_OPS;
+	}
+
+	if (retval == MAPISTORE_SUCCESS) {
+		DEBUG(3, ("[%s:%d]: reverse index built for %u records\n", __FUNCTION__, __LINE__, migration.count));
+	} else {
+		DEBUG(0, ("[%s:%d]: unable to build the reverse index\n", __FUNCTION__, __LINE__));
+	}
+	talloc_free(migration.mem_ctx);
+
+	return retval;
+}
+
+
 /**
    \details Open connection to indexing database for a given user
 
@@ -497,7 +1314,7 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_conte
 	dbpath = talloc_asprintf(mem_ctx, "%s/%s/indexing.tdb",
 				 mapistore_get_mapping_path(), username);
 
-	ictx->data = mapistore_tdb_wrap_open(ictx, dbpath, 0, 0, O_RDWR|O_CREAT, 0600);
+	ictx->data = mapistore_tdb_wrap_open(ictx, dbpath, MAPISTORE_INDEXING_HASH_SIZE, 0, O_RDWR|O_CREAT, 0600);
 	talloc_free(dbpath);
 	if (!TDB_WRAP(ictx)) {
 		DEBUG(3, ("[%s:%d]: %s\n", __FUNCTION__, __LINE__, strerror(errno)));
@@ -506,6 +1323,13 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_conte
 		return MAPISTORE_ERR_DATABASE_INIT;
 	}
 
+	/* Step 2. Build the reverse index if the database predates it */
+	if (tdb_index_migrate(TDB_WRAP(ictx)->tdb) != MAPISTORE_SUCCESS) {
+		talloc_free(ictx);
+		talloc_free(mem_ctx);
+		return MAPISTORE_ERR_DATABASE_INIT;
+	}
+
 	/* TODO: extract url from backend mapping, by the moment we use the username */
 	ictx->url = talloc_strdup(ictx, username);
 
@@ -517,6 +1341,10 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_conte
 	ictx->get_fmid = tdb_record_get_fmid;
 	ictx->allocate_fmid = tdb_record_allocate_fmid;
 	ictx->allocate_fmids = tdb_record_allocate_fmids;
+	ictx->set_cns = tdb_record_set_cns;
+	ictx->del_cn = tdb_record_del_cn;
+	ictx->set_cn_index_state = tdb_record_set_cn_index_state;
+	ictx->get_changes = tdb_record_get_changes;
 
 	*ictxp = ictx;
 
@@ -27,6 +27,18 @@
 #define	MAPISTORE_DB_INDEXING		"indexing.tdb"
 #define	MAPISTORE_SOFT_DELETED_TAG	"SOFT_DELETED:"
 
+/* Reverse index: URI -> FMID and URI basename -> FMID list */
+#define	MAPISTORE_INDEXING_URI_TAG	"URI:"
+#define	MAPISTORE_INDEXING_NAME_TAG	"URI_NAME:"
+/* Change number index: per folder table (CN, MID) array sorted by
+   CN, and MID -> location of its entry */
+#define	MAPISTORE_INDEXING_CN_TAG	"CN_INDEX:"
+#define	MAPISTORE_INDEXING_CN_MID_TAG	"CN_MID:"
+
+#define	MAPISTORE_INDEXING_VERSION_KEY	"IndexVersion"
+#define	MAPISTORE_INDEXING_VERSION	2
+#define	MAPISTORE_INDEXING_HASH_SIZE	10007
+
 
 enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_context *,
 						 const char *,
@@ -58,6 +58,7 @@ struct namedprops_context {
 __BEGIN_DECLS
 
 enum mapistore_error mapistore_namedprops_init(TALLOC_CTX *, struct loadparm_context *, struct namedprops_context **);
+enum mapistore_error mapistore_namedprops_borrow(TALLOC_CTX *, struct loadparm_context *, struct namedprops_context **);
 const char *mapistore_namedprops_get_ldif_path(void);
 int mapistore_namedprops_prop_type_from_string(const char *);
 
@@ -108,6 +108,13 @@ enum mapistore_query_type {
 	MAPISTORE_LIVEFILTERED_QUERY,
 };
 
+/* State of the change number index of a folder table */
+enum mapistore_cn_index_state {
+	MAPISTORE_CN_INDEX_NONE = 0,	/* not indexed */
+	MAPISTORE_CN_INDEX_SEEDING = 1,	/* being filled by a full table walk */
+	MAPISTORE_CN_INDEX_READY = 2	/* complete, can be queried */
+};
+
 /* proof of concept: a new structure to simplify property queries */
 struct mapistore_property_data {
         void *data;
@@ -158,6 +165,12 @@ struct indexing_context {
 	enum mapistore_error	(*allocate_fmid)(struct indexing_context *, const char *, uint64_t *);
 	enum mapistore_error	(*allocate_fmids)(struct indexing_context *, const char *, int, uint64_t *);
 
+	/* Change number index of folder tables */
+	enum mapistore_error	(*set_cns)(struct indexing_context *, const char *, uint64_t, enum mapistore_table_type, uint32_t, const uint64_t *, const uint64_t *);
+	enum mapistore_error	(*del_cn)(struct indexing_context *, const char *, uint64_t);
+	enum mapistore_error	(*set_cn_index_state)(struct indexing_context *, const char *, uint64_t, enum mapistore_table_type, enum mapistore_cn_index_state, uint32_t *);
+	enum mapistore_error	(*get_changes)(struct indexing_context *, const char *, TALLOC_CTX *, uint64_t, enum mapistore_table_type, uint64_t, struct UI8Array_r **);
+
 	/* Backend URL */
 	const char *url;
 
@@ -226,6 +239,7 @@ struct mapistore_backend {
                 enum mapistore_error	(*set_restrictions)(void *, struct mapi_SRestriction *, uint8_t *);
                 enum mapistore_error	(*set_sort_order)(void *, struct SSortOrderSet *, uint8_t *);
                 enum mapistore_error	(*get_row)(void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, struct mapistore_property_data **);
+                enum mapistore_error	(*get_rows)(void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***);
                 enum mapistore_error	(*get_row_count)(void *, enum mapistore_query_type, uint32_t *);
 		enum mapistore_error	(*handle_destructor)(void *, uint32_t);
         } table;
@@ -235,6 +249,13 @@ struct mapistore_backend {
                 enum mapistore_error	(*get_available_properties)(void *, TALLOC_CTX *, struct SPropTagArray **);
                 enum mapistore_error	(*get_properties)(void *, TALLOC_CTX *, uint16_t, enum MAPITAGS *, struct mapistore_property_data *);
                 enum mapistore_error	(*set_properties)(void *, struct SRow *);
+
+		/* optional property streams, see mapistore_stream.c */
+		enum mapistore_error	(*open_property_stream)(void *, TALLOC_CTX *, enum MAPITAGS, bool, void **);
+		enum mapistore_error	(*read_at)(void *, TALLOC_CTX *, uint64_t, uint32_t, DATA_BLOB *);
+		enum mapistore_error	(*write_at)(void *, uint64_t, DATA_BLOB);
+		enum mapistore_error	(*get_size)(void *, uint64_t *);
+		enum mapistore_error	(*commit_stream)(void *);
         } properties;
 
 	/** manager operations */
@@ -261,6 +282,16 @@ struct backend_context_list {
 
 struct processing_context;
 
+/* Property streams read backends by chunks of this size */
+#define	MAPISTORE_STREAM_CHUNK_SIZE	0x10000
+
+struct mapistore_property_stream;
+
+struct mapistore_context;
+
+/* Called when a notification is queued for a session with an empty queue */
+typedef void (*mapistore_notification_fn)(struct mapistore_context *, void *);
+
 struct mapistore_context {
 	struct processing_context		*processing_ctx;
 	struct backend_context_list		*context_list;
@@ -270,6 +301,18 @@ struct mapistore_context {
 	struct mapistore_notification_list	*notifications;
 	struct namedprops_context		*nprops_ctx;
 	struct mapistore_connection_info	*conn_info;
+	/* whether backends report every change, see mapistore_indexing_get_changes */
+	bool					cn_index;
+	/* whether named properties and indexing contexts are borrowed from
+	   the process-wide pool, see mpm_shared_get */
+	bool					shared_backends;
+	/* pending notifications and queue bound, see mapistore_push_notification */
+	uint32_t				notifications_count;
+	uint32_t				notifications_max;
+	/* wakes up the session waiting on the queue, see
+	   mapistore_set_notification_callback */
+	mapistore_notification_fn		notification_fn;
+	void					*notification_private;
 #if 0
 	mqd_t					mq_ipc;
 #endif
@@ -354,6 +397,8 @@ enum mapistore_error mapistore_table_set_columns(struct mapistore_context *, uin
 enum mapistore_error mapistore_table_set_restrictions(struct mapistore_context *, uint32_t, void *, struct mapi_SRestriction *, uint8_t *);
 enum mapistore_error mapistore_table_set_sort_order(struct mapistore_context *, uint32_t, void *, struct SSortOrderSet *, uint8_t *);
 enum mapistore_error mapistore_table_get_row(struct mapistore_context *, uint32_t, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, struct mapistore_property_data **);
+enum mapistore_error mapistore_table_get_rows(struct mapistore_context *, uint32_t, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***);
+bool mapistore_table_get_rows_batched(struct mapistore_context *, uint32_t);
 enum mapistore_error mapistore_table_get_row_count(struct mapistore_context *, uint32_t, void *, enum mapistore_query_type, uint32_t *);
 enum mapistore_error mapistore_table_handle_destructor(struct mapistore_context *, uint32_t, void *, uint32_t);
 
@@ -364,6 +409,13 @@ enum mapistore_error mapistore_properties_set_properties(struct mapistore_contex
 enum MAPISTATUS mapistore_error_to_mapi(enum mapistore_error);
 
 
+/* definitions from mapistore_stream.c */
+enum mapistore_error mapistore_properties_open_stream(struct mapistore_context *, uint32_t, void *, TALLOC_CTX *, enum MAPITAGS, bool, struct mapistore_property_stream **);
+enum mapistore_error mapistore_property_stream_read(struct mapistore_property_stream *, TALLOC_CTX *, uint64_t, uint32_t, DATA_BLOB *);
+enum mapistore_error mapistore_property_stream_write(struct mapistore_property_stream *, uint64_t, DATA_BLOB);
+enum mapistore_error mapistore_property_stream_get_size(struct mapistore_property_stream *, uint64_t *);
+enum mapistore_error mapistore_property_stream_commit(struct mapistore_property_stream *);
+
 /* definitions from mapistore_processing.c */
 enum mapistore_error mapistore_set_mapping_path(const char *);
 
@@ -371,8 +423,8 @@ enum mapistore_error mapistore_set_mapping_path(const char *);
 enum mapistore_error mapistore_backend_register(const void *);
 const char	*mapistore_backend_get_installdir(void);
 init_backend_fn	*mapistore_backend_load(TALLOC_CTX *, const char *);
-struct backend_context *mapistore_backend_lookup(struct backend_context_list *, uint32_t);
-struct backend_context *mapistore_backend_lookup_by_uri(struct backend_context_list *, const char *);
+struct backend_context *mapistore_backend_lookup(struct mapistore_context *, uint32_t);
+struct backend_context *mapistore_backend_lookup_by_uri(struct mapistore_context *, const char *);
 struct backend_context *mapistore_backend_lookup_by_name(TALLOC_CTX *, const char *);
 bool		mapistore_backend_run_init(init_backend_fn *);
 
@@ -386,6 +438,11 @@ enum mapistore_error mapistore_indexing_record_add_mid(struct mapistore_context
 enum mapistore_error mapistore_indexing_record_del_mid(struct mapistore_context *, uint32_t, const char *, uint64_t, uint8_t);
 enum mapistore_error mapistore_indexing_record_get_uri(struct mapistore_context *, const char *, TALLOC_CTX *, uint64_t, char **, bool *);
 enum mapistore_error mapistore_indexing_record_get_fmid(struct mapistore_context *, const char *, const char *, bool, uint64_t *, bool *);
+enum mapistore_error mapistore_indexing_record_set_cn(struct mapistore_context *, const char *, uint64_t, enum mapistore_table_type, uint64_t, uint64_t);
+enum mapistore_error mapistore_indexing_record_set_cns(struct mapistore_context *, const char *, uint64_t, enum mapistore_table_type, uint32_t, const uint64_t *, const uint64_t *);
+enum mapistore_error mapistore_indexing_record_del_cn(struct mapistore_context *, const char *, uint64_t);
+enum mapistore_error mapistore_indexing_set_cn_index_state(struct mapistore_context *, const char *, uint64_t, enum mapistore_table_type, enum mapistore_cn_index_state, uint32_t *);
+enum mapistore_error mapistore_indexing_get_changes(struct mapistore_context *, const char *, TALLOC_CTX *, uint64_t, enum mapistore_table_type, uint64_t, struct UI8Array_r **);
 
 enum mapistore_error mapistore_indexing_get_new_folderID(struct mapistore_context *, uint64_t *);
 enum mapistore_error mapistore_indexing_get_new_folderID_as_user(struct mapistore_context *, const char *, uint64_t *);
@@ -417,7 +474,10 @@ enum mapistore_error mapistore_mgmt_interface_unregister_subscription(struct map
 enum mapistore_error mapistore_mgmt_interface_register_bind(struct mapistore_connection_info *, uint16_t, uint8_t *, uint16_t, uint8_t *);
 #endif
 
-/* definitions from mapistore_notifications.c (proof-of-concept) */
+/* definitions from mapistore_notification.c */
+
+/* Default number of notifications a session queues before dropping new ones */
+#define	MAPISTORE_NOTIFICATION_QUEUE_MAX	1024
 
 /* notifications subscriptions */
 struct mapistore_subscription_list {
@@ -437,6 +497,8 @@ struct mapistore_object_subscription_parameters {
 	uint64_t object_id;
 };
 
+struct mapistore_subscription_bucket;
+
 struct mapistore_subscription {
 	uint32_t        handle;
 	uint16_t        notification_types;
@@ -444,6 +506,12 @@ struct mapistore_subscription {
 		struct mapistore_table_subscription_parameters table_parameters;
 		struct mapistore_object_subscription_parameters object_parameters;
 	} parameters;
+	/* registration in the process-wide subscription index */
+	char					*owner;
+	struct mapistore_context		*mstore_ctx;
+	struct mapistore_subscription_bucket	*bucket;
+	struct mapistore_subscription		*prev;
+	struct mapistore_subscription		*next;
 #if 0
 	char		*mqueue_name;
 	mqd_t		mqueue;
@@ -456,6 +524,7 @@ struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *, struct m
 
 struct mapistore_notification_list {
 	struct mapistore_notification *notification;
+	uint32_t handle; /* handle of the subscription it was queued for */
 	struct mapistore_notification_list *next;
 	struct mapistore_notification_list *prev;
 };
@@ -499,6 +568,14 @@ struct mapistore_notification {
 	} parameters;
 };
 
+struct mapistore_notification_stats {
+	uint32_t	subscriptions;
+	uint32_t	buckets;
+	uint64_t	notifications;
+	uint64_t	deliveries;
+	uint64_t	dropped;
+};
+
 struct mapistore_context;
 
 struct mapistore_subscription_list *mapistore_find_matching_subscriptions(struct mapistore_context *, struct mapistore_notification *);
@@ -506,6 +583,9 @@ enum mapistore_error mapistore_delete_subscription(struct mapistore_context *, u
 void mapistore_push_notification(struct mapistore_context *, uint8_t, enum mapistore_notification_type, void *);
 enum mapistore_error mapistore_get_queued_notifications(struct mapistore_context *, struct mapistore_subscription *, struct mapistore_notification_list **);
 enum mapistore_error mapistore_get_queued_notifications_named(struct mapistore_context *, const char *, struct mapistore_notification_list **);
+struct mapistore_notification_list *mapistore_dequeue_notification(TALLOC_CTX *, struct mapistore_context *);
+enum mapistore_error mapistore_notification_get_stats(struct mapistore_notification_stats *);
+enum mapistore_error mapistore_set_notification_callback(struct mapistore_context *, mapistore_notification_fn, void *);
 
 __END_DECLS
 
@@ -45,10 +45,15 @@
 
 static struct mstore_backend {
 	struct mapistore_backend	*backend;
+	uint32_t			context_count;
 } *backends = NULL;
 
 int					num_backends;
 
+/* Backends are loaded and initialized once per process and folder */
+static char				*backends_path = NULL;
+static enum mapistore_error		backends_status;
+
 
 /**
    \details Register mapistore backends
@@ -81,6 +86,7 @@ _PUBLIC_ enum mapistore_error mapistore_backend_register(const void *_backend)
 
 	backends[num_backends].backend = smb_xmemdup(backend, sizeof (*backend));
 	backends[num_backends].backend->backend.name = smb_xstrdup(backend->backend.name);
+	backends[num_backends].context_count = 0;
 
 	num_backends++;
 
@@ -114,6 +120,33 @@ _PUBLIC_ enum mapistore_error mapistore_backend_registered(const char *name)
 }
 
 
+/**
+   \details Return the number of live contexts opened on a backend
+
+   \param name backend's name to lookup
+   \param countp pointer to the number of contexts to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_backend_get_context_count(const char *name, uint32_t *countp)
+{
+	int	i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!name, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!countp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	for (i = 0; i < num_backends; i++) {
+		if (backends[i].backend && !strcmp(backends[i].backend->backend.name, name)) {
+			*countp = backends[i].context_count;
+			return MAPISTORE_SUCCESS;
+		}
+	}
+
+	return MAPISTORE_ERR_NOT_FOUND;
+}
+
+
 /**
    \details Return the full path where mapistore backends are
    installed.
@@ -256,6 +289,11 @@ _PUBLIC_ bool mapistore_backend_run_init(init_backend_fn *fns)
 /**
    \details Initialize mapistore backends
 
+   Backends are loaded and initialized by the first call only: later
+   calls for the same folder return the result of the first one, so
+   new sessions do not scan and open the backend libraries again,
+   until mapistore_backend_reset is called.
+
    \param mem_ctx pointer to the memory context
    \param path pointer to folder where mapistore backends are
    installed
@@ -270,6 +308,14 @@ enum mapistore_error mapistore_backend_init(TALLOC_CTX *mem_ctx, const char *pat
 	int				retval;
 	int				i;
 
+	if (!path) {
+		path = mapistore_backend_get_installdir();
+	}
+
+	if (backends_path && !strcmp(backends_path, path)) {
+		return backends_status;
+	}
+
 	ret = mapistore_backend_load(mem_ctx, path);
 	status = mapistore_backend_run_init(ret);
 	talloc_free(ret);
@@ -285,7 +331,25 @@ enum mapistore_error mapistore_backend_init(TALLOC_CTX *mem_ctx, const char *pat
 		}
 	}
 
-	return (status != true) ? MAPISTORE_SUCCESS : MAPISTORE_ERR_BACKEND_INIT;
+	talloc_free(backends_path);
+	backends_path = talloc_strdup(talloc_autofree_context(), path);
+	backends_status = (status != true) ? MAPISTORE_SUCCESS : MAPISTORE_ERR_BACKEND_INIT;
+
+	return backends_status;
+}
+
+/**
+   \details Forget the result of the previous backends initialization
+
+   The next call to mapistore_backend_init loads and initializes the
+   backends again, for instance once backends have been installed or
+   updated in the folder.
+ */
+void mapistore_backend_reset(void)
+{
+	talloc_free(backends_path);
+	backends_path = NULL;
+	backends_status = MAPISTORE_SUCCESS;
 }
 
 /**
@@ -371,6 +435,7 @@ enum mapistore_error mapistore_backend_create_context(TALLOC_CTX *mem_ctx, struc
 	context->ref_count = 1;
 	context->uri = talloc_asprintf(context, "%s%s", namespace, uri);
 	*context_p = context;
+	backends[i].context_count++;
 
 	(void) talloc_reference(mem_ctx, context);
 
@@ -421,11 +486,20 @@ _PUBLIC_ enum mapistore_error mapistore_backend_add_ref_count(struct backend_con
  */
 _PUBLIC_ enum mapistore_error mapistore_backend_delete_context(struct backend_context *bctx)
 {
+	int	i;
+
 	bctx->ref_count -= 1;
 	if (bctx->ref_count) {
 		return MAPISTORE_ERR_REF_COUNT;
 	}
 
+	for (i = 0; i < num_backends; i++) {
+		if (backends[i].backend == bctx->backend) {
+			backends[i].context_count--;
+			break;
+		}
+	}
+
 	talloc_free(bctx);
 	
 	return MAPISTORE_SUCCESS;
@@ -435,54 +509,47 @@ _PUBLIC_ enum mapistore_error mapistore_backend_delete_context(struct backend_co
 /**
    \details find the context matching given context identifier
 
-   \param backend_list_ctx pointer to the backend context list
+   \param mstore_ctx pointer to the mapistore context
    \param context_id the context identifier to search
 
    \return Pointer to the mapistore_backend context on success, otherwise NULL
  */
-_PUBLIC_ struct backend_context *mapistore_backend_lookup(struct backend_context_list *backend_list_ctx,
+_PUBLIC_ struct backend_context *mapistore_backend_lookup(struct mapistore_context *mstore_ctx,
 							  uint32_t context_id)
 {
 	struct backend_context_list	*el;
 
 	/* Sanity checks */
-	if (!backend_list_ctx) return NULL;
+	if (!mstore_ctx) return NULL;
 
-	for (el = backend_list_ctx; el; el = el->next) {
-		if (el->ctx && el->ctx->context_id == context_id) {
-			return el->ctx;
-		}
-	}
+	el = mapistore_find_context(mstore_ctx->processing_ctx, context_id);
+	if (!el) return NULL;
 
-	return NULL;
+	return el->ctx;
 }
 
 /**
    \details find the context matching given uri string
 
-   \param backend_list_ctx pointer to the backend context list
+   \param mstore_ctx pointer to the mapistore context
    \param uri the uri string to search
 
    \return Pointer to the mapistore_backend context on success,
    otherwise NULL
  */
-_PUBLIC_ struct backend_context *mapistore_backend_lookup_by_uri(struct backend_context_list *backend_list_ctx,
+_PUBLIC_ struct backend_context *mapistore_backend_lookup_by_uri(struct mapistore_context *mstore_ctx,
 								 const char *uri)
 {
 	struct backend_context_list	*el;
 
 	/* sanity checks */
-	if (!backend_list_ctx) return NULL;
+	if (!mstore_ctx) return NULL;
 	if (!uri) return NULL;
 
-	for (el = backend_list_ctx; el; el = el->next) {
-		if (el->ctx && el->ctx->uri &&
-		    !strcmp(el->ctx->uri, uri)) {
-			return el->ctx;
-		}
-	}
-	
-	return NULL;
+	el = mapistore_find_context_by_uri(mstore_ctx->processing_ctx, uri);
+	if (!el) return NULL;
+
+	return el->ctx;
 }
 
 /**
@@ -729,6 +796,45 @@ enum mapistore_error mapistore_backend_table_get_row(struct backend_context *bct
         return bctx->backend->table.get_row(table, mem_ctx, query_type, rowid, data);
 }
 
+/**
+   \details Fetch count consecutive rows starting at start. Backends
+   which leave the get_rows operation unset are served row by row.
+
+   \param bctx pointer to the backend context
+   \param table pointer to the backend table object
+   \param mem_ctx pointer to the memory context
+   \param query_type the query type
+   \param start index of the first row to fetch
+   \param count number of rows to fetch
+   \param rowsp pointer on the returned array of count rows, rows
+   which could not be fetched are set to NULL
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_backend_table_get_rows(struct backend_context *bctx, void *table, TALLOC_CTX *mem_ctx,
+						      enum mapistore_query_type query_type, uint32_t start, uint32_t count,
+						      struct mapistore_property_data ***rowsp)
+{
+	struct mapistore_property_data	**rows;
+	uint32_t			i;
+
+	if (bctx->backend->table.get_rows) {
+		return bctx->backend->table.get_rows(table, mem_ctx, query_type, start, count, rowsp);
+	}
+
+	rows = talloc_zero_array(mem_ctx, struct mapistore_property_data *, count);
+	MAPISTORE_RETVAL_IF(!rows && count, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	for (i = 0; i < count; i++) {
+		if (bctx->backend->table.get_row(table, rows, query_type, start + i, &rows[i]) != MAPISTORE_SUCCESS) {
+			rows[i] = NULL;
+		}
+	}
+	*rowsp = rows;
+
+	return MAPISTORE_SUCCESS;
+}
+
 enum mapistore_error mapistore_backend_table_get_row_count(struct backend_context *bctx, void *table, enum mapistore_query_type query_type, uint32_t *row_countp)
 {
         return bctx->backend->table.get_row_count(table, query_type, row_countp);
@@ -758,6 +864,41 @@ enum mapistore_error mapistore_backend_properties_set_properties(struct backend_
         return bctx->backend->properties.set_properties(object, aRow);
 }
 
+enum mapistore_error mapistore_backend_properties_open_stream(struct backend_context *bctx, void *object, TALLOC_CTX *mem_ctx,
+							      enum MAPITAGS prop_tag, bool read_write, void **streamp)
+{
+	/* Optional operation, backends may not have set it */
+	if (!bctx->backend->properties.open_property_stream) {
+		return MAPISTORE_ERR_NOT_IMPLEMENTED;
+	}
+	return bctx->backend->properties.open_property_stream(object, mem_ctx, prop_tag, read_write, streamp);
+}
+
+enum mapistore_error mapistore_backend_properties_read_at(struct backend_context *bctx, void *stream, TALLOC_CTX *mem_ctx,
+							  uint64_t offset, uint32_t length, DATA_BLOB *data)
+{
+	return bctx->backend->properties.read_at(stream, mem_ctx, offset, length, data);
+}
+
+enum mapistore_error mapistore_backend_properties_write_at(struct backend_context *bctx, void *stream, uint64_t offset, DATA_BLOB data)
+{
+	return bctx->backend->properties.write_at(stream, offset, data);
+}
+
+enum mapistore_error mapistore_backend_properties_get_size(struct backend_context *bctx, void *stream, uint64_t *sizep)
+{
+	return bctx->backend->properties.get_size(stream, sizep);
+}
+
+enum mapistore_error mapistore_backend_properties_commit_stream(struct backend_context *bctx, void *stream)
+{
+	/* Optional operation, backends may not have set it */
+	if (!bctx->backend->properties.commit_stream) {
+		return MAPISTORE_ERR_NOT_IMPLEMENTED;
+	}
+	return bctx->backend->properties.commit_stream(stream);
+}
+
 enum mapistore_error mapistore_backend_manager_generate_uri(struct backend_context *bctx, TALLOC_CTX *mem_ctx, 
 					   const char *username, const char *folder, 
 					   const char *message, const char *root_uri, char **uri)
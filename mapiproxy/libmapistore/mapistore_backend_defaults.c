@@ -331,6 +331,49 @@ static enum mapistore_error mapistore_op_defaults_set_properties(void *x_object,
 	return MAPISTORE_ERR_NOT_IMPLEMENTED;
 }
 
+static enum mapistore_error mapistore_op_defaults_open_property_stream(void *x_object,
+									  TALLOC_CTX *mem_ctx,
+									  enum MAPITAGS prop_tag,
+									  bool read_write,
+									  void **streamp)
+{
+	/* emsmdbp falls back on get_properties */
+	DEBUG(5, ("[%s:%d] MAPISTORE defaults - MAPISTORE_ERR_NOT_IMPLEMENTED\n", __FUNCTION__, __LINE__));
+	return MAPISTORE_ERR_NOT_IMPLEMENTED;
+}
+
+static enum mapistore_error mapistore_op_defaults_read_at(void *stream,
+							  TALLOC_CTX *mem_ctx,
+							  uint64_t offset,
+							  uint32_t length,
+							  DATA_BLOB *data)
+{
+	DEBUG(3, ("[%s:%d] MAPISTORE defaults - MAPISTORE_ERR_NOT_IMPLEMENTED\n", __FUNCTION__, __LINE__));
+	return MAPISTORE_ERR_NOT_IMPLEMENTED;
+}
+
+static enum mapistore_error mapistore_op_defaults_write_at(void *stream,
+							   uint64_t offset,
+							   DATA_BLOB data)
+{
+	DEBUG(3, ("[%s:%d] MAPISTORE defaults - MAPISTORE_ERR_NOT_IMPLEMENTED\n", __FUNCTION__, __LINE__));
+	return MAPISTORE_ERR_NOT_IMPLEMENTED;
+}
+
+static enum mapistore_error mapistore_op_defaults_get_size(void *stream,
+							   uint64_t *sizep)
+{
+	DEBUG(3, ("[%s:%d] MAPISTORE defaults - MAPISTORE_ERR_NOT_IMPLEMENTED\n", __FUNCTION__, __LINE__));
+	return MAPISTORE_ERR_NOT_IMPLEMENTED;
+}
+
+static enum mapistore_error mapistore_op_defaults_commit_stream(void *stream)
+{
+	/* Backends commit their streams when they are released */
+	DEBUG(5, ("[%s:%d] MAPISTORE defaults - MAPISTORE_ERR_NOT_IMPLEMENTED\n", __FUNCTION__, __LINE__));
+	return MAPISTORE_ERR_NOT_IMPLEMENTED;
+}
+
 static enum mapistore_error mapistore_op_defaults_generate_uri(TALLOC_CTX *mem_ctx,
 							       const char *username,
 							       const char *folder,
@@ -390,6 +433,8 @@ extern enum mapistore_error mapistore_backend_init_defaults(struct mapistore_bac
 	backend->table.set_restrictions = mapistore_op_defaults_set_restrictions;
 	backend->table.set_sort_order = mapistore_op_defaults_set_sort_order;
 	backend->table.get_row = mapistore_op_defaults_get_row;
+	/* Optional, backends without get_rows are served row by row */
+	backend->table.get_rows = NULL;
 	backend->table.get_row_count = mapistore_op_defaults_get_row_count;
 	backend->table.handle_destructor = mapistore_op_defaults_handle_destructor;
 
@@ -397,6 +442,11 @@ extern enum mapistore_error mapistore_backend_init_defaults(struct mapistore_bac
 	backend->properties.get_available_properties = mapistore_op_defaults_get_available_properties;
 	backend->properties.get_properties = mapistore_op_defaults_get_properties;
 	backend->properties.set_properties = mapistore_op_defaults_set_properties;
+	backend->properties.open_property_stream = mapistore_op_defaults_open_property_stream;
+	backend->properties.read_at = mapistore_op_defaults_read_at;
+	backend->properties.write_at = mapistore_op_defaults_write_at;
+	backend->properties.get_size = mapistore_op_defaults_get_size;
+	backend->properties.commit_stream = mapistore_op_defaults_commit_stream;
 
 	/* manager operations */
 	backend->manager.generate_uri = mapistore_op_defaults_generate_uri;
@@ -87,6 +87,77 @@ struct indexing_context *mapistore_indexing_search(struct mapistore_context *mst
 	return NULL;
 }
 
+/**
+   \details Open the indexing context of a user on the backend the
+   indexing URL designates, TDB when NULL
+ */
+static enum mapistore_error mapistore_indexing_open(struct mapistore_context *mstore_ctx,
+						    const char *username,
+						    const char *indexing_url,
+						    struct indexing_context **ictxp)
+{
+	if (indexing_url == NULL) {
+		return mapistore_indexing_tdb_init(mstore_ctx, username, ictxp);
+	}
+
+	return mapistore_indexing_mysql_init(mstore_ctx, username, indexing_url, ictxp);
+}
+
+struct mapistore_indexing_shared_open {
+	struct mapistore_context	*mstore_ctx;
+	const char			*username;
+	const char			*indexing_url;
+};
+
+static void *mapistore_indexing_shared_open(TALLOC_CTX *mem_ctx, void *private_data)
+{
+	struct mapistore_indexing_shared_open	*params = (struct mapistore_indexing_shared_open *) private_data;
+	struct indexing_context			*ictx = NULL;
+	enum mapistore_error			retval;
+
+	retval = mapistore_indexing_open(params->mstore_ctx, params->username, params->indexing_url, &ictx);
+	if (retval != MAPISTORE_SUCCESS || !ictx) {
+		return NULL;
+	}
+
+	/* Backends allocate the context on the mapistore context of the
+	   session opening it */
+	return talloc_steal(mem_ctx, ictx);
+}
+
+/**
+   \details Borrow the indexing context of a user from the ones shared
+   by the sessions of the process, opening it if needed
+
+   \param mstore_ctx pointer to the mapistore context
+   \param mem_ctx pointer to the memory context holding the context
+   \param username the user owning the indexing database
+   \param indexing_url the indexing backend URL, NULL for TDB
+
+   \return Pointer to the indexing context on success, otherwise NULL
+ */
+static struct indexing_context *mapistore_indexing_borrow(struct mapistore_context *mstore_ctx,
+							  TALLOC_CTX *mem_ctx,
+							  const char *username,
+							  const char *indexing_url)
+{
+	struct mapistore_indexing_shared_open	params;
+	struct indexing_context			*ictx;
+	char					*name;
+
+	name = talloc_asprintf(mem_ctx, "indexing:%s", username);
+	if (!name) return NULL;
+
+	params.mstore_ctx = mstore_ctx;
+	params.username = username;
+	params.indexing_url = indexing_url;
+	ictx = mpm_shared_get(mem_ctx, name, indexing_url ? indexing_url : "tdb",
+			      mapistore_indexing_shared_open, &params);
+	talloc_free(name);
+
+	return ictx;
+}
+
 /**
    \details Open connection to indexing database for a given user
 
@@ -119,18 +190,20 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_add(struct mapistore_context *m
 	}
 
 	// indexing_url NULL means to use the default backend: tdb
-	if (indexing_url == NULL) {
-		ictx = talloc_zero(mstore_ctx, struct indexing_context_list);
-		mapistore_indexing_tdb_init(mstore_ctx, username, &ictx->ctx);
-	} else if (strncmp(indexing_url, "mysql://", strlen("mysql://")) == 0) {
-		ictx = talloc_zero(mstore_ctx, struct indexing_context_list);
-		mapistore_indexing_mysql_init(mstore_ctx, username, indexing_url,
-					      &ictx->ctx);
-	} else {
+	if (indexing_url && strncmp(indexing_url, "mysql://", strlen("mysql://")) != 0) {
 		DEBUG(0, ("ERROR unknown indexing url %s\n", indexing_url));
 		return MAPISTORE_ERROR;
 	}
 
+	ictx = talloc_zero(mstore_ctx, struct indexing_context_list);
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	if (mstore_ctx->shared_backends) {
+		ictx->ctx = mapistore_indexing_borrow(mstore_ctx, ictx, username, indexing_url);
+	} else {
+		mapistore_indexing_open(mstore_ctx, username, indexing_url, &ictx->ctx);
+	}
+
 	/* ictx->ref_count = 0; */
 	DLIST_ADD_END(mstore_ctx->indexing_list, ictx, struct indexing_context_list *);
 
@@ -165,7 +238,7 @@ enum mapistore_error mapistore_indexing_record_add_fmid(struct mapistore_context
 	MAPISTORE_RETVAL_IF(!fmid, MAPISTORE_ERROR, NULL);
 
 	/* Ensure the context exists */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!backend_ctx->indexing, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
@@ -221,7 +294,7 @@ enum mapistore_error mapistore_indexing_record_del_fmid(struct mapistore_context
 	MAPISTORE_RETVAL_IF(!fmid, MAPISTORE_ERROR, NULL);
 
 	/* Ensure the context exists */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!backend_ctx->indexing, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
@@ -293,6 +366,169 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_record_get_fmid(struct mapistor
 	return ictx->get_fmid(ictx, username, uri, partial, fmidp, soft_deletedp);
 }
 
+/**
+   \details Record the change numbers of messages of a folder table
+
+   This keeps the change number index used by
+   mapistore_indexing_get_changes up to date. Backends which change
+   messages without going through mapistore can call it as well.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param username the name of the account where to look for the
+   indexing database
+   \param fid the folder identifier
+   \param table_type MAPISTORE_MESSAGE_TABLE or MAPISTORE_FAI_TABLE
+   \param count the number of messages
+   \param mids the message identifiers
+   \param cns the PidTagChangeNumber of each message
+
+   \note Nothing is recorded for tables which are not indexed.
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_indexing_record_set_cns(struct mapistore_context *mstore_ctx, const char *username,
+								uint64_t fid, enum mapistore_table_type table_type,
+								uint32_t count, const uint64_t *mids, const uint64_t *cns)
+{
+	struct indexing_context		*ictx;
+	int				ret;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	ret = mapistore_indexing_add(mstore_ctx, username, &ictx);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERROR, NULL);
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL);
+
+	return ictx->set_cns(ictx, username, fid, table_type, count, mids, cns);
+}
+
+/**
+   \details Record the change number of a message
+
+   \note This is a wrapper to mapistore_indexing_record_set_cns.
+ */
+_PUBLIC_ enum mapistore_error mapistore_indexing_record_set_cn(struct mapistore_context *mstore_ctx, const char *username,
+							       uint64_t fid, enum mapistore_table_type table_type,
+							       uint64_t mid, uint64_t cn)
+{
+	return mapistore_indexing_record_set_cns(mstore_ctx, username, fid, table_type, 1, &mid, &cn);
+}
+
+/**
+   \details Remove a message from the change number index
+
+   \param mstore_ctx pointer to the mapistore context
+   \param username the name of the account where to look for the
+   indexing database
+   \param mid the message identifier
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_indexing_record_del_cn(struct mapistore_context *mstore_ctx, const char *username, uint64_t mid)
+{
+	struct indexing_context		*ictx;
+	int				ret;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	ret = mapistore_indexing_add(mstore_ctx, username, &ictx);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERROR, NULL);
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL);
+
+	return ictx->del_cn(ictx, username, mid);
+}
+
+/**
+   \details Change the state of the change number index of a folder
+   table
+
+   A table is indexed by moving it to MAPISTORE_CN_INDEX_SEEDING,
+   recording the change number of each of its messages, then moving
+   it to MAPISTORE_CN_INDEX_READY. Changes recorded in the meantime
+   are kept.
+
+   Each seeding gets a new generation number, the table only becomes
+   ready if it has not been reset since: a seeding which was started
+   again by someone else can't mark the index ready early.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param username the name of the account where to look for the
+   indexing database
+   \param fid the folder identifier
+   \param table_type MAPISTORE_MESSAGE_TABLE or MAPISTORE_FAI_TABLE
+   \param state the new state
+   \param generation pointer to the seeding generation, returned
+   when moving to MAPISTORE_CN_INDEX_SEEDING and checked when moving
+   to MAPISTORE_CN_INDEX_READY
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_FOUND if
+   the table is not being seeded with this generation, otherwise
+   MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_indexing_set_cn_index_state(struct mapistore_context *mstore_ctx, const char *username,
+								    uint64_t fid, enum mapistore_table_type table_type,
+								    enum mapistore_cn_index_state state, uint32_t *generation)
+{
+	struct indexing_context		*ictx;
+	int				ret;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	ret = mapistore_indexing_add(mstore_ctx, username, &ictx);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERROR, NULL);
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL);
+
+	return ictx->set_cn_index_state(ictx, username, fid, table_type, state, generation);
+}
+
+/**
+   \details Return the messages of a folder table changed after a
+   given change number
+
+   \param mstore_ctx pointer to the mapistore context
+   \param username the name of the account where to look for the
+   indexing database
+   \param mem_ctx pointer to the memory context
+   \param fid the folder identifier
+   \param table_type MAPISTORE_MESSAGE_TABLE or MAPISTORE_FAI_TABLE
+   \param cn the change number, compared to PidTagChangeNumber values
+   \param midsp pointer to the returned message identifiers, sorted
+   by change number
+
+   \note The result is only complete if every change to the messages
+   of the table has been recorded with
+   mapistore_indexing_record_set_cns and
+   mapistore_indexing_record_del_cn.
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_FOUND if
+   the table is not indexed, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_indexing_get_changes(struct mapistore_context *mstore_ctx, const char *username,
+							     TALLOC_CTX *mem_ctx, uint64_t fid,
+							     enum mapistore_table_type table_type, uint64_t cn,
+							     struct UI8Array_r **midsp)
+{
+	struct indexing_context		*ictx;
+	int				ret;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!username, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!midsp, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	ret = mapistore_indexing_add(mstore_ctx, username, &ictx);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERROR, NULL);
+	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERROR, NULL);
+
+	return ictx->get_changes(ictx, username, mem_ctx, fid, table_type, cn, midsp);
+}
+
 /**
    \details Add a fid record to the indexing database
 
@@ -27,6 +27,7 @@
 #include "mapistore_errors.h"
 #include "mapistore_private.h"
 #include "mapistore_nameid.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
 
 #include <dlinklist.h>
 #include "libmapi/libmapi_private.h"
@@ -82,6 +83,13 @@ _PUBLIC_ struct mapistore_context *mapistore_init(TALLOC_CTX *mem_ctx, struct lo
 		return NULL;
 	}
 
+	retval = mapistore_init_context_registry(mstore_ctx->processing_ctx);
+	if (retval != MAPISTORE_SUCCESS) {
+		DEBUG(0, ("[%s:%d]: %s\n", __FUNCTION__, __LINE__, mapistore_errstr(retval)));
+		talloc_free(mstore_ctx);
+		return NULL;
+	}
+
 	retval = mapistore_backend_init(mstore_ctx, path);
 	if (retval != MAPISTORE_SUCCESS) {
 		DEBUG(0, ("[%s:%d]: %s\n", __FUNCTION__, __LINE__, mapistore_errstr(retval)));
@@ -98,9 +106,20 @@ _PUBLIC_ struct mapistore_context *mapistore_init(TALLOC_CTX *mem_ctx, struct lo
 
 	indexing_url = lpcfg_parm_string(lp_ctx, NULL, "mapistore", "indexing_backend");
 	mapistore_set_default_indexing_url(indexing_url);
+	mstore_ctx->cn_index = lpcfg_parm_bool(lp_ctx, NULL, "mapistore", "cn_index", false);
+	mstore_ctx->shared_backends = lpcfg_parm_bool(lp_ctx, NULL, "mapiproxy", "shared_backends", true);
+	mstore_ctx->notifications_count = 0;
+	mstore_ctx->notifications_max = lpcfg_parm_int(lp_ctx, NULL, "mapistore", "notification_queue_size",
+						       MAPISTORE_NOTIFICATION_QUEUE_MAX);
+	mstore_ctx->notification_fn = NULL;
+	mstore_ctx->notification_private = NULL;
 
 	mstore_ctx->nprops_ctx = NULL;
-	retval = mapistore_namedprops_init(mstore_ctx, lp_ctx, &(mstore_ctx->nprops_ctx));
+	if (mstore_ctx->shared_backends) {
+		retval = mapistore_namedprops_borrow(mstore_ctx, lp_ctx, &(mstore_ctx->nprops_ctx));
+	} else {
+		retval = mapistore_namedprops_init(mstore_ctx, lp_ctx, &(mstore_ctx->nprops_ctx));
+	}
 	if (retval != MAPISTORE_SUCCESS) {
 		DEBUG(0, ("[%s:%d] ERROR: %s\n", __FUNCTION__, __LINE__, mapistore_errstr(retval)));
 		talloc_free(mstore_ctx);
@@ -138,7 +157,13 @@ _PUBLIC_ enum mapistore_error mapistore_release(struct mapistore_context *mstore
 
 	DEBUG(5, ("freeing up mstore_ctx ref: %p\n", mstore_ctx));
 
-	talloc_free(mstore_ctx->nprops_ctx);
+	/* The named properties context may be shared with other sessions */
+	if (mstore_ctx->shared_backends) {
+		mpm_shared_release(mstore_ctx, mstore_ctx->nprops_ctx);
+	} else {
+		talloc_free(mstore_ctx->nprops_ctx);
+	}
+	mstore_ctx->nprops_ctx = NULL;
 	talloc_free(mstore_ctx->processing_ctx);
 	talloc_free(mstore_ctx->context_list);
 	talloc_free(mstore_ctx->indexing_list);
@@ -233,6 +258,12 @@ _PUBLIC_ enum mapistore_error mapistore_add_context(struct mapistore_context *ms
 			talloc_free(mem_ctx);
 			return MAPISTORE_ERR_CONTEXT_FAILED;
 		}
+		retval = mapistore_register_context(mstore_ctx->processing_ctx, backend_list);
+		if (retval != MAPISTORE_SUCCESS) {
+			mapistore_free_context_id(mstore_ctx->processing_ctx, backend_list->ctx->context_id);
+			talloc_free(mem_ctx);
+			return MAPISTORE_ERR_CONTEXT_FAILED;
+		}
 		*context_id = backend_list->ctx->context_id;
 		*backend_object = backend_list->ctx->root_folder_object;
 		DLIST_ADD_END(mstore_ctx->context_list, backend_list, struct backend_context_list *);
@@ -269,7 +300,7 @@ _PUBLIC_ enum mapistore_error mapistore_add_context_ref_count(struct mapistore_c
 
 	/* Step 0. Ensure the context exists */
 	DEBUG(0, ("mapistore_add_context_ref_count: context_is to increment is %d\n", context_id));
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 1. Increment the ref count */
@@ -306,7 +337,7 @@ _PUBLIC_ enum mapistore_error mapistore_search_context_by_uri(struct mapistore_c
 
 	if (!uri) return MAPISTORE_ERROR;
 
-	backend_ctx = mapistore_backend_lookup_by_uri(mstore_ctx->context_list, uri);
+	backend_ctx = mapistore_backend_lookup_by_uri(mstore_ctx, uri);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_NOT_FOUND, NULL);
 
 	*context_id = backend_ctx->context_id;
@@ -331,7 +362,6 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 	struct backend_context_list	*backend_list;
 	struct backend_context		*backend_ctx;
 	int				retval;
-	bool				found = false;
 
 	/* Sanity checks */
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
@@ -340,19 +370,9 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 
 	/* Step 0. Ensure the context exists */
 	DEBUG(5, ("mapistore_del_context: context_id to del is %d\n", context_id));
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
-	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
-
-	/* search the backend_list item */
-	for (backend_list = mstore_ctx->context_list; backend_list; backend_list = backend_list->next) {
-		if (backend_list->ctx->context_id == context_id) {
-			found = true;
-			break;
-		}		
-	}
-	if (found == false) {
-		return MAPISTORE_ERROR;
-	}
+	backend_list = mapistore_find_context(mstore_ctx->processing_ctx, context_id);
+	MAPISTORE_RETVAL_IF(!backend_list, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	backend_ctx = backend_list->ctx;
 
 	/* Step 1. Release the indexing context within backend */
 	/* if (backend_ctx->indexing) {
@@ -365,7 +385,12 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 		}
 	} */
 
-	/* Step 2. Delete the context within backend */
+	/* Step 2. Delete the context within backend. The indexes
+	   reference the context URI, so the last reference has to be
+	   unregistered before the context is freed */
+	if (backend_ctx->ref_count == 1) {
+		mapistore_unregister_context(mstore_ctx->processing_ctx, backend_list);
+	}
 	retval = mapistore_backend_delete_context(backend_ctx);
 	
 	switch (retval) {
@@ -373,6 +398,7 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 		return MAPISTORE_SUCCESS;
 	case MAPISTORE_SUCCESS:
 		DLIST_REMOVE(mstore_ctx->context_list, backend_list);
+		talloc_free(backend_list);
 		/* Step 2. Add the free'd context id to the free list */
 		retval = mapistore_free_context_id(mstore_ctx->processing_ctx, context_id);
 		break;
@@ -490,7 +516,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_open_folder(struct mapistore_cont
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend open_folder */
@@ -519,7 +545,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_create_folder(struct mapistore_co
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);	
 	
 	/* Step 2. Call backend create_folder */
@@ -555,7 +581,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_delete(struct mapistore_context *
 	mem_ctx = talloc_zero(NULL, TALLOC_CTX);
 
 	/* Step 1. Find the backend context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	if (!backend_ctx) {
 		ret = MAPISTORE_ERR_INVALID_PARAMETER;
 		goto end;
@@ -656,7 +682,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_open_message(struct mapistore_con
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend open_message */
@@ -685,7 +711,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_create_message(struct mapistore_c
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	
 	/* Step 2. Call backend create_message */
@@ -713,7 +739,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_delete_message(struct mapistore_c
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -732,7 +758,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_move_copy_messages(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -751,7 +777,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_move_folder(struct mapistore_cont
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -771,7 +797,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_copy_folder(struct mapistore_cont
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -801,7 +827,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_get_deleted_fmids(struct mapistor
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -826,7 +852,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_get_child_count(struct mapistore_
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 0. Ensure the context exists */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend get_child_count */
@@ -856,7 +882,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_get_child_fmids(struct mapistore_
 	uint32_t			i, row_count;
 	uint64_t			*fmids, *current_fmid;
 	enum MAPITAGS			fmid_column;
-	struct mapistore_property_data	*row_data;
+	struct mapistore_property_data	**rows;
 
 	switch (table_type) {
 	case MAPISTORE_FOLDER_TABLE:
@@ -888,16 +914,22 @@ _PUBLIC_ enum mapistore_error mapistore_folder_get_child_fmids(struct mapistore_
 		goto end;
 	}
 
-	*child_fmid_count = row_count;
+	ret = mapistore_table_get_rows(mstore_ctx, context_id, backend_table, local_mem_ctx,
+				       MAPISTORE_PREFILTERED_QUERY, 0, row_count, &rows);
+	if (ret != MAPISTORE_SUCCESS) {
+		goto end;
+	}
+
 	fmids = talloc_array(mem_ctx, uint64_t, row_count);
 	*child_fmids = fmids;
 	current_fmid = fmids;
 	for (i = 0; i < row_count; i++) {
-		mapistore_table_get_row(mstore_ctx, context_id, backend_table, local_mem_ctx,
-					MAPISTORE_PREFILTERED_QUERY, i, &row_data);
-		*current_fmid = *(uint64_t *) row_data->data;
-		current_fmid++;
+		if (rows[i] && rows[i][0].error == MAPISTORE_SUCCESS && rows[i][0].data) {
+			*current_fmid = *(uint64_t *) rows[i][0].data;
+			current_fmid++;
+		}
 	}
+	*child_fmid_count = current_fmid - fmids;
 
 end:
 	talloc_free(local_mem_ctx);
@@ -913,7 +945,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_get_child_fid_by_name(struct mapi
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -929,7 +961,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_open_table(struct mapistore_conte
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -944,7 +976,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_modify_permissions(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -959,7 +991,7 @@ _PUBLIC_ enum mapistore_error mapistore_folder_preload_message_bodies(struct map
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1208,7 +1240,7 @@ enum mapistore_error mapistore_folder_fetch_freebusy_properties(struct mapistore
 	/* Sanity checks */
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	local_mem_ctx = talloc_zero(NULL, TALLOC_CTX);
@@ -1402,7 +1434,7 @@ enum mapistore_error mapistore_message_get_message_data(struct mapistore_context
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend modifyrecipients */
@@ -1429,7 +1461,7 @@ enum mapistore_error mapistore_message_modify_recipients(struct mapistore_contex
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend modifyrecipients */
@@ -1455,7 +1487,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_set_read_flag(struct mapistore_c
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend savechangesmessage */
@@ -1481,7 +1513,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_save(struct mapistore_context *m
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend savechangesmessage */
@@ -1509,7 +1541,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_submit(struct mapistore_context
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend submitmessage */
@@ -1525,7 +1557,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_get_attachment_table(struct mapi
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1541,7 +1573,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_open_attachment(struct mapistore
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1557,7 +1589,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_create_attachment(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1572,7 +1604,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_attachment_open_embedded_message
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1587,7 +1619,7 @@ _PUBLIC_ enum mapistore_error mapistore_message_attachment_create_embedded_messa
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1602,7 +1634,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_get_available_properties(struct ma
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1617,7 +1649,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_set_columns(struct mapistore_conte
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1632,7 +1664,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_set_restrictions(struct mapistore_
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1647,7 +1679,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_set_sort_order(struct mapistore_co
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1663,13 +1695,68 @@ _PUBLIC_ enum mapistore_error mapistore_table_get_row(struct mapistore_context *
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
 	return mapistore_backend_table_get_row(backend_ctx, table, mem_ctx, query_type, rowid, data);
 }
 
+/**
+   \details Fetch a batch of consecutive rows from a table
+
+   \param mstore_ctx pointer to the mapistore context
+   \param context_id the context identifier referencing the backend
+   \param table pointer to the table object
+   \param mem_ctx pointer to the memory context
+   \param query_type the query type
+   \param start index of the first row to fetch
+   \param count number of rows to fetch
+   \param rowsp pointer on the returned array of count rows, rows
+   which could not be fetched (filtered out or beyond the end of the
+   table) are set to NULL
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_table_get_rows(struct mapistore_context *mstore_ctx, uint32_t context_id, void *table, TALLOC_CTX *mem_ctx,
+						       enum mapistore_query_type query_type, uint32_t start, uint32_t count,
+						       struct mapistore_property_data ***rowsp)
+{
+	struct backend_context	*backend_ctx;
+
+	/* Sanity checks */
+	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
+	MAPISTORE_RETVAL_IF(!rowsp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Search the context */
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
+	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 2. Call backend operation */
+	return mapistore_backend_table_get_rows(backend_ctx, table, mem_ctx, query_type, start, count, rowsp);
+}
+
+/**
+   \details Tell whether a backend fetches batches of rows in a single
+   call, that is whether it implements the get_rows operation.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param context_id the context identifier referencing the backend
+
+   \return false if the backend is served row by row, otherwise true
+ */
+_PUBLIC_ bool mapistore_table_get_rows_batched(struct mapistore_context *mstore_ctx, uint32_t context_id)
+{
+	struct backend_context	*backend_ctx;
+
+	if (!mstore_ctx) return false;
+
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
+	if (!backend_ctx) return false;
+
+	return backend_ctx->backend->table.get_rows != NULL;
+}
+
 _PUBLIC_ enum mapistore_error mapistore_table_get_row_count(struct mapistore_context *mstore_ctx, uint32_t context_id, void *table, enum mapistore_query_type query_type, uint32_t *row_countp)
 {
 	struct backend_context	*backend_ctx;
@@ -1678,7 +1765,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_get_row_count(struct mapistore_con
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1693,7 +1780,7 @@ _PUBLIC_ enum mapistore_error mapistore_table_handle_destructor(struct mapistore
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1708,7 +1795,7 @@ _PUBLIC_ enum mapistore_error mapistore_properties_get_available_properties(stru
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1727,7 +1814,7 @@ _PUBLIC_ enum mapistore_error mapistore_properties_get_properties(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
@@ -1745,7 +1832,7 @@ _PUBLIC_ enum mapistore_error mapistore_properties_set_properties(struct mapisto
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
 
 	/* Step 1. Search the context */
-	backend_ctx = mapistore_backend_lookup(mstore_ctx->context_list, context_id);
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
 	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
 	/* Step 2. Call backend operation */
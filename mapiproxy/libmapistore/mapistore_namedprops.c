@@ -26,6 +26,7 @@
 
 #include "backends/namedprops_ldb.h"
 #include "backends/namedprops_mysql.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
 
 
 /**
@@ -81,6 +82,77 @@ enum mapistore_error mapistore_namedprops_init(TALLOC_CTX *mem_ctx,
 }
 
 
+static void *mapistore_namedprops_shared_open(TALLOC_CTX *mem_ctx, void *private_data)
+{
+	struct loadparm_context		*lp_ctx = (struct loadparm_context *) private_data;
+	struct namedprops_context	*nprops = NULL;
+	TALLOC_CTX			*local_mem_ctx;
+
+	local_mem_ctx = talloc_named(NULL, 0, "mapistore_namedprops_shared_open");
+	if (!local_mem_ctx) return NULL;
+
+	if (mapistore_namedprops_init(local_mem_ctx, lp_ctx, &nprops) != MAPISTORE_SUCCESS) {
+		talloc_free(local_mem_ctx);
+		return NULL;
+	}
+
+	/* Backends allocate their database handles next to the context:
+	   hand them over to it so it can outlive the pool entry */
+	talloc_steal(mem_ctx, nprops);
+	talloc_steal(nprops, local_mem_ctx);
+
+	return nprops;
+}
+
+
+/**
+   \details Borrow the named properties context shared by the
+   sessions of the process, opening it if needed
+
+   \param mem_ctx pointer to the memory context
+   \param lp_ctx pointer to the loadparm context
+   \param nprops pointer on pointer to the namedprops context the
+   function returns
+
+   \note The context is released with mpm_shared_release(mem_ctx,
+   nprops), or by freeing mem_ctx, and must never be freed.
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_namedprops_borrow(TALLOC_CTX *mem_ctx,
+						 struct loadparm_context *lp_ctx,
+						 struct namedprops_context **nprops)
+{
+	const char * const	options[] = { "ldb_url", "ldb_data", "mysql_sock", "mysql_host",
+					      "mysql_port", "mysql_user", "mysql_pass", "mysql_db",
+					      "mysql_data", NULL };
+	const char		*backend;
+	const char		*value;
+	char			*config;
+	int			i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!lp_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!nprops, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* The context is reopened when any of its options changes */
+	backend = lpcfg_parm_string(lp_ctx, NULL, "mapistore", "namedproperties");
+	config = talloc_strdup(mem_ctx, backend ? backend : NAMEDPROPS_BACKEND_LDB);
+	for (i = 0; config && options[i]; i++) {
+		value = lpcfg_parm_string(lp_ctx, NULL, "namedproperties", options[i]);
+		config = talloc_asprintf_append(config, ";%s", value ? value : "");
+	}
+	MAPISTORE_RETVAL_IF(!config, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	*nprops = mpm_shared_get(mem_ctx, "namedprops", config, mapistore_namedprops_shared_open, lp_ctx);
+	talloc_free(config);
+	MAPISTORE_RETVAL_IF(!*nprops, MAPISTORE_ERR_DATABASE_INIT, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
+
 /**
    \details Returns the next unmapped property ID
 
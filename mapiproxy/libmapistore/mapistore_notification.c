@@ -27,150 +27,501 @@
 #include "mapiproxy/libmapistore/mapistore_errors.h"
 #include "mapiproxy/libmapistore/mgmt/mapistore_mgmt.h"
 #include "mapiproxy/libmapistore/mgmt/gen_ndr/ndr_mapistore_mgmt.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
 
-#if 0
-static int mapistore_subscription_destructor(void *data)
+/**
+   \file mapistore_notification.c
+
+   \brief Notification subscriptions and per-session notification queues
+
+   Subscriptions of all the sessions of a server process are indexed
+   by owner, folder and message identifiers. Each bucket of the index
+   groups the subscriptions registered on the same objects, along with
+   the union of their notification types. Pushing a notification only
+   looks up the few buckets it can match instead of walking every
+   subscription of the process.
+
+   Object notifications are delivered to the matching subscriptions of
+   every session of the mailbox owner. Table notifications refer to
+   the rows and handles of a single session and are only delivered to
+   the session pushing them.
+
+   A matching notification is copied on the queue of the session of
+   the subscription, which EcDoRpc drains into RopNotify replies. The
+   queues are bounded: notifications pushed to a full queue are dropped.
+ */
+
+struct mapistore_subscription_bucket {
+	char				*owner;
+	uint64_t			fid;
+	uint64_t			mid;
+	bool				table;
+	/* union of the notification types of the subscriptions */
+	uint16_t			mask;
+	struct mapistore_subscription	*subscriptions;
+};
+
+struct mapistore_subscription_key {
+	const char			*owner;
+	uint64_t			fid;
+	uint64_t			mid;
+	bool				table;
+};
+
+struct mapistore_notification_engine {
+	struct htable				ht;
+	struct mapistore_notification_stats	stats;
+};
+
+static struct mapistore_notification_engine	*notification_engine = NULL;
+
+typedef void (*mapistore_subscription_fn)(struct mapistore_subscription *, struct mapistore_notification *, void *);
+
+
+static size_t mapistore_subscription_hash(const struct mapistore_subscription_key *key)
 {
-	struct mapistore_subscription	*subscription = (struct mapistore_subscription *) data;
+	uint64_t	h;
 
-	DEBUG(0, ("#### DELETING SUBSCRIPTION ###\n"));
+	h = hash_string(key->owner);
+	h = (h ^ key->fid) * 1099511628211ULL;
+	h = (h ^ key->mid) * 1099511628211ULL;
+	h ^= key->table;
 
-	if (!data) return -1;
+	return (size_t)(h ^ (h >> 32));
+}
+
+
+static size_t mapistore_subscription_rehash(const void *e, void *unused)
+{
+	const struct mapistore_subscription_bucket	*bucket = (const struct mapistore_subscription_bucket *) e;
+	struct mapistore_subscription_key		key;
+
+	key.owner = bucket->owner;
+	key.fid = bucket->fid;
+	key.mid = bucket->mid;
+	key.table = bucket->table;
+
+	return mapistore_subscription_hash(&key);
+}
 
-	DEBUG(0, ("### 1. NotificationFlags = 0x%x\n", subscription->notification_types));
-	DEBUG(0, ("### 2. handle = 0x%x\n", subscription->handle));
 
-	if (subscription->mqueue != -1) {
-		if (mq_unlink(subscription->mqueue_name) == -1) {
-			perror("mq_unlink");
+static bool mapistore_subscription_cmp(const void *e, void *k)
+{
+	const struct mapistore_subscription_bucket	*bucket = (const struct mapistore_subscription_bucket *) e;
+	const struct mapistore_subscription_key		*key = (const struct mapistore_subscription_key *) k;
+
+	return (bucket->fid == key->fid && bucket->mid == key->mid &&
+		bucket->table == key->table && !strcmp(bucket->owner, key->owner));
+}
+
+
+static int mapistore_notification_engine_destructor(struct mapistore_notification_engine *engine)
+{
+	struct mapistore_subscription_bucket	*bucket;
+	struct mapistore_subscription		*s;
+	struct htable_iter			iter;
+
+	/* Subscriptions still alive must not refer to freed buckets */
+	for (bucket = htable_first(&engine->ht, &iter); bucket; bucket = htable_next(&engine->ht, &iter)) {
+		for (s = bucket->subscriptions; s; s = s->next) {
+			s->bucket = NULL;
 		}
-		DEBUG(0, ("%s unlinked\n", subscription->mqueue_name));
-		talloc_free(subscription->mqueue_name);
 	}
+	htable_clear(&engine->ht);
+	notification_engine = NULL;
+
+	return 0;
+}
+
+
+static struct mapistore_notification_engine *mapistore_notification_engine_get(void)
+{
+	if (notification_engine) return notification_engine;
+
+	notification_engine = talloc_zero(talloc_autofree_context(), struct mapistore_notification_engine);
+	if (!notification_engine) return NULL;
+
+	htable_init(&notification_engine->ht, mapistore_subscription_rehash, NULL);
+	talloc_set_destructor(notification_engine, mapistore_notification_engine_destructor);
+
+	return notification_engine;
+}
+
+
+static const char *mapistore_notification_owner(struct mapistore_context *mstore_ctx, const char *username)
+{
+	if (username) return username;
+	if (mstore_ctx && mstore_ctx->conn_info && mstore_ctx->conn_info->username) {
+		return mstore_ctx->conn_info->username;
+	}
+
+	return "";
+}
+
+
+/**
+   \details Return the subscription types matching a notification event
+ */
+static uint16_t mapistore_notification_mask(enum mapistore_notification_type event)
+{
+	switch (event) {
+	case MAPISTORE_OBJECT_CREATED:
+		return fnevObjectCreated;
+	case MAPISTORE_OBJECT_MODIFIED:
+		return fnevObjectModified;
+	case MAPISTORE_OBJECT_DELETED:
+		return fnevObjectDeleted;
+	case MAPISTORE_OBJECT_COPIED:
+		return fnevObjectCopied;
+	case MAPISTORE_OBJECT_MOVED:
+		return fnevObjectMoved;
+	case MAPISTORE_OBJECT_NEWMAIL:
+		return fnevNewMail;
+	}
+
 	return 0;
 }
-#endif
 
-struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *mem_ctx, 
-							  struct mapistore_context *mstore_ctx,
-							  const char *username,
-							  uint32_t handle,
-                                                          uint16_t notification_types,
-                                                          void *notification_parameters)
+
+static void mapistore_subscription_unregister(struct mapistore_subscription *s)
 {
-#if 0
-	int						ret;
-	struct mapistore_connection_info		c;
-	struct mapistore_mgmt_notif			n;
-        struct mapistore_subscription			*new_subscription;
-        struct mapistore_table_subscription_parameters	*table_parameters;
-        struct mapistore_object_subscription_parameters *object_parameters;
-	unsigned int					prio;
-	struct mq_attr					attr;
-	DATA_BLOB					data;
-
-        new_subscription = talloc_zero(mem_ctx, struct mapistore_subscription);
-        new_subscription->handle = handle;
-        new_subscription->notification_types = notification_types;
-	new_subscription->mqueue = -1;
-	new_subscription->mqueue_name = NULL;
-        if (notification_types == fnevTableModified) {
-                table_parameters = notification_parameters;
-                new_subscription->parameters.table_parameters = *table_parameters;
-        }
-        else {
-                object_parameters = notification_parameters;
-                new_subscription->parameters.object_parameters = *object_parameters;
-
-		/* NewMail POC: open newmail mail queue */
-		if (notification_types & fnevNewMail || notification_types & fnevObjectCreated) {
-			new_subscription->mqueue_name = talloc_asprintf((TALLOC_CTX *)new_subscription, 
-									MAPISTORE_MQUEUE_NEWMAIL_FMT, username);
-			new_subscription->mqueue = mq_open(new_subscription->mqueue_name, 
-							   O_RDONLY|O_NONBLOCK|O_CREAT, 0777, NULL);
-			if (new_subscription->mqueue == -1) {
-				perror("mq_open");
-				talloc_free(new_subscription->mqueue_name);
-				return new_subscription;
-			}
-			
-			/* Empty queue since we only want to retrieve new data from now */
-			ret = mq_getattr(new_subscription->mqueue, &attr);
-			if (ret == -1) {
-				perror("mq_getattr");
-			} else {
-				data.data = talloc_size(mem_ctx, attr.mq_msgsize);
-				while ((data.length = mq_receive(new_subscription->mqueue, (char *)data.data,
-								 attr.mq_msgsize, &prio)) != -1) {
-					dump_data(0, data.data, data.length);
-					talloc_free(data.data);
-					data.data = talloc_size(mem_ctx, attr.mq_msgsize);
-				}
-				talloc_free(data.data);
-			}
-			
-			/* Set destructor on new_subscription as we want to unlink the queue upon release */
-			talloc_set_destructor((void *)new_subscription, (int (*)(void *))mapistore_subscription_destructor);
-			
-			/* Send notification to tell about newmail */
-			n.WholeStore = object_parameters->whole_store;
-			n.NotificationFlags = notification_types;
-			if (n.WholeStore == true) {
-				n.FolderID = 0;
-				n.MessageID = 0;
-				n.MAPIStoreURI = NULL;
-			} else {
-				n.FolderID = object_parameters->folder_id;
-				n.MessageID = object_parameters->object_id;
-				/* FIXME */
-				n.MAPIStoreURI = NULL;
+	struct mapistore_subscription_bucket	*bucket = s->bucket;
+	struct mapistore_subscription		*el;
+
+	if (!bucket || !notification_engine) return;
+
+	DLIST_REMOVE(bucket->subscriptions, s);
+	s->bucket = NULL;
+	notification_engine->stats.subscriptions -= 1;
+
+	if (!bucket->subscriptions) {
+		htable_del(&notification_engine->ht, mapistore_subscription_rehash(bucket, NULL), bucket);
+		notification_engine->stats.buckets -= 1;
+		talloc_free(bucket);
+		return;
+	}
+
+	bucket->mask = 0;
+	for (el = bucket->subscriptions; el; el = el->next) {
+		bucket->mask |= el->notification_types;
+	}
+}
+
+
+static int mapistore_subscription_destructor(struct mapistore_subscription *s)
+{
+	/* Queued notifications are children of the subscription and
+	   leave the queue with it */
+	mapistore_subscription_unregister(s);
+
+	return 0;
+}
+
+
+static int mapistore_notification_list_destructor(struct mapistore_notification_list *nl)
+{
+	struct mapistore_subscription	*s;
+
+	s = talloc_get_type(talloc_parent(nl), struct mapistore_subscription);
+	if (s && s->mstore_ctx) {
+		DLIST_REMOVE(s->mstore_ctx->notifications, nl);
+		s->mstore_ctx->notifications_count -= 1;
+	}
+
+	return 0;
+}
+
+
+/**
+   \details Create a subscription and register it in the subscription
+   index of the process
+
+   \param mem_ctx pointer to the memory context, which must not
+   outlive the mapistore context
+   \param mstore_ctx pointer to the mapistore context of the session
+   \param username the owner of the mailbox
+   \param handle the handle of the object notifications are sent to
+   \param notification_types the fnev notification types
+   \param notification_parameters pointer to the table or object
+   subscription parameters, depending on notification_types
+
+   \return pointer to the subscription on success, otherwise NULL
+ */
+_PUBLIC_ struct mapistore_subscription *mapistore_new_subscription(TALLOC_CTX *mem_ctx,
+								   struct mapistore_context *mstore_ctx,
+								   const char *username,
+								   uint32_t handle,
+								   uint16_t notification_types,
+								   void *notification_parameters)
+{
+	struct mapistore_notification_engine		*engine;
+	struct mapistore_subscription			*s;
+	struct mapistore_subscription_bucket		*bucket;
+	struct mapistore_subscription_key		key;
+	struct mapistore_table_subscription_parameters	*table_parameters;
+	struct mapistore_object_subscription_parameters	*object_parameters;
+	size_t						h;
+
+	if (!mstore_ctx || !notification_parameters) return NULL;
+
+	engine = mapistore_notification_engine_get();
+	if (!engine) return NULL;
+
+	s = talloc_zero(mem_ctx, struct mapistore_subscription);
+	if (!s) return NULL;
+
+	s->handle = handle;
+	s->notification_types = notification_types;
+	s->mstore_ctx = mstore_ctx;
+	s->owner = talloc_strdup(s, mapistore_notification_owner(mstore_ctx, username));
+	if (!s->owner) {
+		talloc_free(s);
+		return NULL;
+	}
+
+	key.owner = s->owner;
+	if (notification_types == fnevTableModified) {
+		table_parameters = notification_parameters;
+		s->parameters.table_parameters = *table_parameters;
+		key.fid = table_parameters->folder_id;
+		key.mid = 0;
+		key.table = true;
+	} else {
+		object_parameters = notification_parameters;
+		s->parameters.object_parameters = *object_parameters;
+		key.fid = object_parameters->whole_store ? 0 : object_parameters->folder_id;
+		key.mid = object_parameters->whole_store ? 0 : object_parameters->object_id;
+		key.table = false;
+	}
+
+	h = mapistore_subscription_hash(&key);
+	bucket = htable_get(&engine->ht, h, mapistore_subscription_cmp, &key);
+	if (!bucket) {
+		bucket = talloc_zero(engine, struct mapistore_subscription_bucket);
+		if (!bucket) {
+			talloc_free(s);
+			return NULL;
+		}
+		bucket->owner = talloc_strdup(bucket, key.owner);
+		bucket->fid = key.fid;
+		bucket->mid = key.mid;
+		bucket->table = key.table;
+		if (!bucket->owner || !htable_add(&engine->ht, h, bucket)) {
+			DEBUG(0, ("[%s:%d]: unable to index subscription 0x%x\n", __FUNCTION__, __LINE__, handle));
+			talloc_free(bucket);
+			talloc_free(s);
+			return NULL;
+		}
+		engine->stats.buckets += 1;
+	}
+
+	DLIST_ADD_END(bucket->subscriptions, s, struct mapistore_subscription *);
+	bucket->mask |= notification_types;
+	s->bucket = bucket;
+	engine->stats.subscriptions += 1;
+	talloc_set_destructor(s, mapistore_subscription_destructor);
+
+	return s;
+}
+
+
+static void mapistore_notification_match_bucket(struct mapistore_notification_engine *engine,
+						struct mapistore_subscription_key *key, uint16_t mask,
+						struct mapistore_notification *notification,
+						mapistore_subscription_fn fn, void *private_data)
+{
+	struct mapistore_subscription_bucket	*bucket;
+	struct mapistore_subscription		*s;
+	struct mapistore_subscription		*next;
+
+	bucket = htable_get(&engine->ht, mapistore_subscription_hash(key), mapistore_subscription_cmp, key);
+	if (!bucket || !(bucket->mask & mask)) return;
+
+	for (s = bucket->subscriptions; s; s = next) {
+		next = s->next;
+		if (s->notification_types & mask) {
+			fn(s, notification, private_data);
+		}
+	}
+}
+
+
+/**
+   \details Call fn on every subscription matching a notification
+   pushed by the specified session
+ */
+static void mapistore_notification_match(struct mapistore_context *mstore_ctx,
+					 struct mapistore_notification *notification,
+					 mapistore_subscription_fn fn, void *private_data)
+{
+	struct mapistore_notification_engine		*engine = notification_engine;
+	struct mapistore_subscription_bucket		*bucket;
+	struct mapistore_subscription			*s;
+	struct mapistore_subscription_key		key;
+	struct mapistore_table_notification_parameters	*table_parameters;
+	struct mapistore_object_notification_parameters	*object_parameters;
+	uint16_t					mask;
+
+	if (!engine) return;
+
+	key.owner = mapistore_notification_owner(mstore_ctx, NULL);
+
+	if (notification->object_type == MAPISTORE_TABLE) {
+		table_parameters = &notification->parameters.table_parameters;
+		key.fid = table_parameters->folder_id;
+		key.mid = 0;
+		key.table = true;
+
+		bucket = htable_get(&engine->ht, mapistore_subscription_hash(&key), mapistore_subscription_cmp, &key);
+		if (!bucket) return;
+
+		for (s = bucket->subscriptions; s; s = s->next) {
+			if (s->mstore_ctx == mstore_ctx && s->handle == table_parameters->handle
+			    && s->parameters.table_parameters.table_type == table_parameters->table_type) {
+				fn(s, notification, private_data);
+				return;
 			}
+		}
+		return;
+	}
+
+	mask = mapistore_notification_mask(notification->event);
+	if (!mask) return;
+
+	object_parameters = &notification->parameters.object_parameters;
+	key.table = false;
+
+	/* Whole store subscriptions */
+	key.fid = 0;
+	key.mid = 0;
+	mapistore_notification_match_bucket(engine, &key, mask, notification, fn, private_data);
+
+	switch (notification->object_type) {
+	case MAPISTORE_FOLDER:
+		if (!object_parameters->object_id) break;
+		key.fid = object_parameters->object_id;
+		mapistore_notification_match_bucket(engine, &key, mask, notification, fn, private_data);
+		break;
+	case MAPISTORE_MESSAGE:
+		if (!object_parameters->folder_id) break;
+		key.fid = object_parameters->folder_id;
+		mapistore_notification_match_bucket(engine, &key, mask, notification, fn, private_data);
+		if (!object_parameters->object_id) break;
+		key.mid = object_parameters->object_id;
+		mapistore_notification_match_bucket(engine, &key, mask, notification, fn, private_data);
+		break;
+	default:
+		DEBUG(5, ("[%s] warning: considering notification for unhandled object: %d...\n",
+			  __PRETTY_FUNCTION__, notification->object_type));
+	}
+}
+
+
+/**
+   \details Copy a notification on the queue of the session of a
+   matching subscription
+ */
+static void mapistore_notification_enqueue(struct mapistore_subscription *s,
+					   struct mapistore_notification *notification,
+					   void *private_data)
+{
+	struct mapistore_context			*mstore_ctx = s->mstore_ctx;
+	struct mapistore_notification_list		*nl;
+	struct mapistore_object_notification_parameters	*object_parameters;
+	uint32_t					max;
+
+	max = mstore_ctx->notifications_max ? mstore_ctx->notifications_max : MAPISTORE_NOTIFICATION_QUEUE_MAX;
+	if (mstore_ctx->notifications_count >= max) {
+		notification_engine->stats.dropped += 1;
+		DEBUG(1, ("[%s:%d]: notification queue of %s is full, dropping notification for handle 0x%x\n",
+			  __FUNCTION__, __LINE__, s->owner, s->handle));
+		return;
+	}
 
-			c.username = (char *)username;
-			c.mstore_ctx = mstore_ctx;
-			
-			ret = mapistore_mgmt_interface_register_subscription(&c, &n);
-			DEBUG(0, ("[%s:%d]: registering notification: %d\n", __FUNCTION__, __LINE__, ret));
+	nl = talloc_zero(s, struct mapistore_notification_list);
+	if (!nl) return;
+	nl->handle = s->handle;
+	nl->notification = talloc_memdup(nl, notification, sizeof (struct mapistore_notification));
+	if (!nl->notification) {
+		talloc_free(nl);
+		return;
+	}
+
+	if (notification->object_type != MAPISTORE_TABLE) {
+		object_parameters = &nl->notification->parameters.object_parameters;
+		if (object_parameters->tag_count > 0 && object_parameters->tag_count != 0xffff) {
+			object_parameters->tags = talloc_memdup(nl->notification, object_parameters->tags,
+								sizeof(enum MAPITAGS) * object_parameters->tag_count);
 		}
 	}
 
-        return new_subscription;
-#endif
+	DLIST_ADD_END(mstore_ctx->notifications, nl, struct mapistore_notification_list *);
+	mstore_ctx->notifications_count += 1;
+	notification_engine->stats.deliveries += 1;
+	talloc_set_destructor(nl, mapistore_notification_list_destructor);
 
-	return NULL;
+	if (mstore_ctx->notifications_count == 1 && mstore_ctx->notification_fn) {
+		mstore_ctx->notification_fn(mstore_ctx, mstore_ctx->notification_private);
+	}
 }
 
+
+/**
+   \details Push a notification to the sessions subscribed to it
+
+   Object notifications are queued for the matching subscriptions of
+   all the sessions of the mailbox owner, table notifications for the
+   subscription of the table handle in the pushing session.
+
+   \param mstore_ctx pointer to the mapistore context of the pushing
+   session
+   \param object_type the type of object the notification is about
+   \param event the notification event
+   \param parameters pointer to the table or object notification
+   parameters, depending on object_type
+ */
 _PUBLIC_ void mapistore_push_notification(struct mapistore_context *mstore_ctx, uint8_t object_type, enum mapistore_notification_type event, void *parameters)
 {
-#if 0
-        struct mapistore_notification *new_notification;
-        struct mapistore_notification_list *new_list;
-        struct mapistore_table_notification_parameters *table_parameters;
-        struct mapistore_object_notification_parameters *object_parameters;
-
-        if (!mstore_ctx) return;
-
-	new_list = talloc_zero(mstore_ctx, struct mapistore_notification_list);
-	new_notification = talloc_zero(new_list, struct mapistore_notification);
-	new_list->notification = new_notification;
-	new_notification->object_type = object_type;
-	new_notification->event = event;
+	struct mapistore_notification	notification;
+
+	if (!mstore_ctx || !parameters || !notification_engine) return;
+
+	memset(&notification, 0, sizeof (struct mapistore_notification));
+	notification.object_type = object_type;
+	notification.event = event;
 	if (object_type == MAPISTORE_TABLE) {
-		table_parameters = parameters;
-		new_notification->parameters.table_parameters = *table_parameters;
-	}
-	else {
-		object_parameters = parameters;
-		new_notification->parameters.object_parameters = *object_parameters;
-		if (new_notification->parameters.object_parameters.tag_count > 0
-		    && new_notification->parameters.object_parameters.tag_count != 0xffff) {
-			new_notification->parameters.object_parameters.tags
-				= talloc_memdup(new_notification, new_notification->parameters.object_parameters.tags,
-						sizeof(enum MAPITAGS) * new_notification->parameters.object_parameters.tag_count);
-		}
+		notification.parameters.table_parameters = *(struct mapistore_table_notification_parameters *) parameters;
+	} else {
+		notification.parameters.object_parameters = *(struct mapistore_object_notification_parameters *) parameters;
 	}
-	DLIST_ADD_END(mstore_ctx->notifications, new_list, void);
-#endif
+
+	notification_engine->stats.notifications += 1;
+	mapistore_notification_match(mstore_ctx, &notification, mapistore_notification_enqueue, NULL);
+}
+
+
+/**
+   \details Remove the oldest notification from the queue of a session
+
+   \param mem_ctx pointer to the memory context the notification is
+   moved to
+   \param mstore_ctx pointer to the mapistore context
+
+   \return pointer to the notification, NULL if the queue is empty
+ */
+_PUBLIC_ struct mapistore_notification_list *mapistore_dequeue_notification(TALLOC_CTX *mem_ctx,
+									    struct mapistore_context *mstore_ctx)
+{
+	struct mapistore_notification_list	*nl;
+
+	if (!mstore_ctx || !mstore_ctx->notifications) return NULL;
+
+	nl = mstore_ctx->notifications;
+	talloc_set_destructor(nl, NULL);
+	DLIST_REMOVE(mstore_ctx->notifications, nl);
+	mstore_ctx->notifications_count -= 1;
+
+	return talloc_steal(mem_ctx, nl);
 }
 
 #if 0
@@ -353,13 +704,16 @@ _PUBLIC_ enum mapistore_error mapistore_get_queued_notifications_named(struct ma
 	return (found == false) ? MAPISTORE_ERR_NOT_FOUND : MAPISTORE_SUCCESS;
 }
 
+
 /**
-   \details Return the list of pending mapistore notifications within
-   the queue pointed by the mapistore subscription structure.
+   \details Return the list of pending mapistore notifications queued
+   for the subscription specified in argument. They are removed from
+   the queue of the session.
 
    \param mstore_ctx pointer to the mapistore context
-   \param s pointer to the mapistore subscription where the mqueue file descriptor is stored
-   \param nl pointer on pointer to the list of mapistore noficiations to return
+   \param s pointer to the mapistore subscription
+   \param nl pointer on pointer to the list of mapistore noficiations
+   to return, freeing its first element releases the list
 
    \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
  */
@@ -367,114 +721,31 @@ _PUBLIC_ enum mapistore_error mapistore_get_queued_notifications(struct mapistor
 								 struct mapistore_subscription *s,
 								 struct mapistore_notification_list **nl)
 {
-	bool					found = false;
-#if 0
-	int					ret;
 	struct mapistore_notification_list	*nlist = NULL;
-	struct mapistore_notification_list	*el = NULL;
-	unsigned int				prio;
-	struct mq_attr				attr;
-	DATA_BLOB				data;
+	struct mapistore_notification_list	*el;
+	struct mapistore_notification_list	*next;
 
-	DEBUG(0, ("mapistore_get_queued_notifications: queue name = %s\n", s->mqueue_name));
-	DEBUG(0, ("mapistore_get_queued_notifications: before sanity checks\n"));
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
 	MAPISTORE_RETVAL_IF(!s, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!nl, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	MAPISTORE_RETVAL_IF(s->mqueue == -1, MAPISTORE_ERR_NOT_FOUND, NULL);
-	DEBUG(0, ("mapistore_get_queued_notifications: after sanity checks\n"));
-
-	/* Retrieve queue attributes */
-	ret = mq_getattr(s->mqueue, &attr);
-	if (ret == -1) {
-		perror("mq_getattr");
-		/* set proper error message here and remove above */
-		MAPISTORE_RETVAL_IF(ret == -1, MAPISTORE_ERR_NOT_FOUND, NULL);
-	}
-
-	data.data = talloc_size((TALLOC_CTX *)mstore_ctx, attr.mq_msgsize);
-	while ((data.length = mq_receive(s->mqueue, (char *)data.data, attr.mq_msgsize, &prio)) != -1) {
-		if (!nlist) {
-			nlist = talloc_zero((TALLOC_CTX *)mstore_ctx, struct mapistore_notification_list);
-		}
-		el = mapistore_notification_process_mqueue_notif((TALLOC_CTX *)nlist, data);
-		if (el) {
-			DLIST_ADD_END(nlist, el, struct mapistore_notification_list);
-		}
-		talloc_free(data.data);
-		found = true;
-		data.data = talloc_size((TALLOC_CTX *)mstore_ctx, attr.mq_msgsize);
-	}
-	talloc_free(data.data);
+	for (el = mstore_ctx->notifications; el; el = next) {
+		next = el->next;
+		if (talloc_parent(el) != s) continue;
 
-	if (found == true) {
-		*nl = nlist;
+		talloc_set_destructor(el, NULL);
+		DLIST_REMOVE(mstore_ctx->notifications, el);
+		mstore_ctx->notifications_count -= 1;
+		talloc_steal(nlist ? (TALLOC_CTX *)nlist : (TALLOC_CTX *)mstore_ctx, el);
+		DLIST_ADD_END(nlist, el, struct mapistore_notification_list *);
 	}
+	MAPISTORE_RETVAL_IF(!nlist, MAPISTORE_ERR_NOT_FOUND, NULL);
 
-	DEBUG(0, ("mapistore_get_queued_notification: found = %s\n", 
-		  (found == false) ? "MAPISTORE_ERR_NOT_FOUND" : "MAPISTORE_SUCCESS"));
-#endif
-	return (found == false) ? MAPISTORE_ERR_NOT_FOUND : MAPISTORE_SUCCESS;
-}
+	*nl = nlist;
 
-#if 0
-static bool notification_matches_subscription(struct mapistore_notification *notification, struct mapistore_subscription *subscription)
-{
-        bool result;
-        struct mapistore_table_notification_parameters *n_table_parameters;
-        struct mapistore_table_subscription_parameters *s_table_parameters;
-        struct mapistore_object_notification_parameters *n_object_parameters;
-        struct mapistore_object_subscription_parameters *s_object_parameters;
-
-        result = false;
-
-        if (notification->object_type == MAPISTORE_TABLE) {
-                if (subscription->notification_types & fnevTableModified) {
-                        n_table_parameters = &notification->parameters.table_parameters;
-                        if (subscription->handle == n_table_parameters->handle) {
-                                s_table_parameters = &subscription->parameters.table_parameters;
-                                result = (n_table_parameters->table_type == s_table_parameters->table_type
-                                          && n_table_parameters->folder_id == s_table_parameters->folder_id);
-                        }
-                }
-        }
-        else {
-                if (((subscription->notification_types & fnevObjectCreated)
-                     && notification->event == MAPISTORE_OBJECT_CREATED)
-                    || ((subscription->notification_types & fnevObjectModified)
-                        && notification->event == MAPISTORE_OBJECT_MODIFIED)
-                    || ((subscription->notification_types & fnevObjectDeleted)
-                        && notification->event == MAPISTORE_OBJECT_DELETED)
-		    || ((subscription->notification_types & fnevObjectCopied)
-                        && notification->event == MAPISTORE_OBJECT_COPIED)
-		    || ((subscription->notification_types & fnevObjectMoved)
-                        && notification->event == MAPISTORE_OBJECT_MOVED)) {
-                        n_object_parameters = &notification->parameters.object_parameters;
-                        s_object_parameters = &subscription->parameters.object_parameters;
-                        if (s_object_parameters->whole_store)
-                                result = true;
-                        else {
-                                if (notification->object_type == MAPISTORE_FOLDER) {
-                                        result = (n_object_parameters->object_id == s_object_parameters->folder_id);
-                                }
-                                else if (notification->object_type == MAPISTORE_MESSAGE) {
-                                        result = (n_object_parameters->folder_id == s_object_parameters->folder_id
-                                                  && (s_object_parameters->object_id == 0
-                                                      || n_object_parameters->object_id == s_object_parameters->object_id));
-                                }
-                                else {
-                                        DEBUG(5, ("[%s] warning: considering notification for unhandled object: %d...\n",
-                                                  __PRETTY_FUNCTION__, notification->object_type));
-                                }
-                        }
-                }
-        }
-
-        return result;
+	return MAPISTORE_SUCCESS;
 }
-#endif
 
 _PUBLIC_ enum mapistore_error mapistore_delete_subscription(struct mapistore_context *mstore_ctx, uint32_t identifier, 
 							    uint16_t NotificationFlags)
@@ -503,25 +774,91 @@ _PUBLIC_ enum mapistore_error mapistore_delete_subscription(struct mapistore_con
 	return MAPISTORE_ERR_NOT_FOUND;
 }
 
+struct mapistore_subscription_match {
+	struct mapistore_context		*mstore_ctx;
+	struct mapistore_subscription_list	*list;
+};
+
+static void mapistore_subscription_collect(struct mapistore_subscription *s,
+					   struct mapistore_notification *notification,
+					   void *private_data)
+{
+	struct mapistore_subscription_match	*match = (struct mapistore_subscription_match *) private_data;
+	struct mapistore_subscription_list	*el;
+
+	if (s->mstore_ctx != match->mstore_ctx) return;
+
+	el = talloc_zero(match->mstore_ctx, struct mapistore_subscription_list);
+	if (!el) return;
+	el->subscription = s;
+	DLIST_ADD_END(match->list, el, struct mapistore_subscription_list *);
+}
+
+/**
+   \details Return the subscriptions of a session matching a
+   notification
+
+   \param mstore_ctx pointer to the mapistore context
+   \param notification pointer to the notification
+
+   \return list of matching subscriptions allocated on mstore_ctx, NULL
+   if none matches
+ */
 _PUBLIC_ struct mapistore_subscription_list *mapistore_find_matching_subscriptions(struct mapistore_context *mstore_ctx, struct mapistore_notification *notification)
 {
-#if 0
-        struct mapistore_subscription_list *matching_subscriptions, *new_element, *current_element;
-
-	if (!mstore_ctx) return NULL;
-
-        matching_subscriptions = NULL;
-
-        current_element = mstore_ctx->subscriptions;
-        while (current_element) {
-                if (notification_matches_subscription(notification, current_element->subscription)) {
-                        new_element = talloc_memdup(mstore_ctx, current_element, sizeof(struct mapistore_subscription_list));
-                        DLIST_ADD_END(matching_subscriptions, new_element, void);
-                }
-                current_element = current_element->next;
-        }
-        
-        return matching_subscriptions;
-#endif
-	return NULL;
+	struct mapistore_subscription_match	match;
+
+	if (!mstore_ctx || !notification) return NULL;
+
+	match.mstore_ctx = mstore_ctx;
+	match.list = NULL;
+	mapistore_notification_match(mstore_ctx, notification, mapistore_subscription_collect, &match);
+
+	return match.list;
+}
+
+/**
+   \details Retrieve the counters of the notification engine
+
+   \param stats pointer to the structure receiving the counters
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERR_INVALID_PARAMETER
+ */
+_PUBLIC_ enum mapistore_error mapistore_notification_get_stats(struct mapistore_notification_stats *stats)
+{
+	MAPISTORE_RETVAL_IF(!stats, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	if (!notification_engine) {
+		memset(stats, 0, sizeof (struct mapistore_notification_stats));
+		return MAPISTORE_SUCCESS;
+	}
+	*stats = notification_engine->stats;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Register the function called when a notification is queued
+   for a session whose queue was empty
+
+   The function is called from mapistore_push_notification, once per
+   transition of the queue from empty to non-empty. It must not push
+   notifications itself.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param fn the function to call, NULL to unregister
+   \param private_data pointer passed to fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERR_NOT_INITIALIZED
+ */
+_PUBLIC_ enum mapistore_error mapistore_set_notification_callback(struct mapistore_context *mstore_ctx,
+								  mapistore_notification_fn fn,
+								  void *private_data)
+{
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	mstore_ctx->notification_fn = fn;
+	mstore_ctx->notification_private = fn ? private_data : NULL;
+
+	return MAPISTORE_SUCCESS;
 }
@@ -24,6 +24,7 @@
 
 #include <talloc.h>
 #include "backends/namedprops_backend.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
 
 #ifndef	ISDOT
 #define ISDOT(path) ( \
@@ -66,22 +67,21 @@ struct id_mapping_context {
 
 
 /**
-   Free context identifier list
-
-   This structure is a double chained list storing unused context
-   identifiers.
- */
-struct context_id_list {
-	uint32_t		context_id;
-	struct context_id_list	*prev;
-	struct context_id_list	*next;
-};
+   Context registry
 
+   Context identifiers are allocated from a bitmap where a set bit
+   marks an identifier in use. free_hint references the lowest bitmap
+   word which may still have a free bit. Identifier 0 is reserved.
 
+   Registered contexts are indexed by identifier in a dense array and
+   by URI in a hash table.
+ */
 struct processing_context {
 	struct id_mapping_context	*mapping_ctx;
-	struct context_id_list		*free_ctx;
-	uint32_t			last_context_id;
+	uint32_t			*context_ids;
+	uint32_t			free_hint;
+	struct backend_context_list	**contexts;
+	struct htable			contexts_by_uri;
 	uint64_t			dflt_start_id;
 };
 
@@ -126,13 +126,20 @@ __BEGIN_DECLS
 /* definitions from mapistore_processing.c */
 const char *mapistore_get_mapping_path(void);
 enum mapistore_error mapistore_init_mapping_context(struct processing_context *);
+enum mapistore_error mapistore_init_context_registry(struct processing_context *);
 enum mapistore_error mapistore_get_context_id(struct processing_context *, uint32_t *);
 enum mapistore_error mapistore_free_context_id(struct processing_context *, uint32_t);
+enum mapistore_error mapistore_register_context(struct processing_context *, struct backend_context_list *);
+void mapistore_unregister_context(struct processing_context *, struct backend_context_list *);
+struct backend_context_list *mapistore_find_context(struct processing_context *, uint32_t);
+struct backend_context_list *mapistore_find_context_by_uri(struct processing_context *, const char *);
 
 
 /* definitions from mapistore_backend.c */
 enum mapistore_error mapistore_backend_init(TALLOC_CTX *, const char *);
+void mapistore_backend_reset(void);
 enum mapistore_error mapistore_backend_registered(const char *);
+enum mapistore_error mapistore_backend_get_context_count(const char *, uint32_t *);
 enum mapistore_error mapistore_backend_list_contexts(const char *, struct indexing_context *, TALLOC_CTX *, struct mapistore_contexts_list **);
 enum mapistore_error mapistore_backend_create_context(TALLOC_CTX *, struct mapistore_connection_info *, struct indexing_context *, const char *, const char *, uint64_t, struct backend_context **);
 enum mapistore_error mapistore_backend_create_root_folder(const char *, enum mapistore_context_role, uint64_t, const char *, TALLOC_CTX *, char **);
@@ -172,12 +179,18 @@ enum mapistore_error mapistore_backend_table_set_columns(struct backend_context
 enum mapistore_error mapistore_backend_table_set_restrictions(struct backend_context *, void *, struct mapi_SRestriction *, uint8_t *);
 enum mapistore_error mapistore_backend_table_set_sort_order(struct backend_context *, void *, struct SSortOrderSet *, uint8_t *);
 enum mapistore_error mapistore_backend_table_get_row(struct backend_context *, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, struct mapistore_property_data **);
+enum mapistore_error mapistore_backend_table_get_rows(struct backend_context *, void *, TALLOC_CTX *, enum mapistore_query_type, uint32_t, uint32_t, struct mapistore_property_data ***);
 enum mapistore_error mapistore_backend_table_get_row_count(struct backend_context *, void *, enum mapistore_query_type, uint32_t *);
 enum mapistore_error mapistore_backend_table_handle_destructor(struct backend_context *, void *, uint32_t);
 
 enum mapistore_error mapistore_backend_properties_get_available_properties(struct backend_context *, void *, TALLOC_CTX *, struct SPropTagArray **);
 enum mapistore_error mapistore_backend_properties_get_properties(struct backend_context *, void *, TALLOC_CTX *, uint16_t, enum MAPITAGS *, struct mapistore_property_data *);
 enum mapistore_error mapistore_backend_properties_set_properties(struct backend_context *, void *, struct SRow *);
+enum mapistore_error mapistore_backend_properties_open_stream(struct backend_context *, void *, TALLOC_CTX *, enum MAPITAGS, bool, void **);
+enum mapistore_error mapistore_backend_properties_read_at(struct backend_context *, void *, TALLOC_CTX *, uint64_t, uint32_t, DATA_BLOB *);
+enum mapistore_error mapistore_backend_properties_write_at(struct backend_context *, void *, uint64_t, DATA_BLOB);
+enum mapistore_error mapistore_backend_properties_get_size(struct backend_context *, void *, uint64_t *);
+enum mapistore_error mapistore_backend_properties_commit_stream(struct backend_context *, void *);
 
 enum mapistore_error mapistore_backend_manager_generate_uri(struct backend_context *, TALLOC_CTX *, const char *, const char *, const char *, const char *, char **);
 
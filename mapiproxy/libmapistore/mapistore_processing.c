@@ -23,6 +23,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 
 #include "mapistore.h"
@@ -30,6 +31,7 @@
 #include "mapistore_private.h"
 #include <dlinklist.h>
 #include "libmapi/libmapi_private.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
 
 #include <tdb.h>
 
@@ -170,67 +172,210 @@ enum mapistore_error mapistore_init_mapping_context(struct processing_context *p
 }
 
 
+static size_t mapistore_context_rehash(const void *e, void *unused)
+{
+	return hash_string(((const struct backend_context_list *)e)->ctx->uri);
+}
+
+
+static bool mapistore_context_cmp(const void *e, void *uri)
+{
+	return strcmp(((const struct backend_context_list *)e)->ctx->uri, (const char *)uri) == 0;
+}
+
+
+static int mapistore_context_registry_destructor(struct processing_context *pctx)
+{
+	htable_clear(&pctx->contexts_by_uri);
+
+	return 0;
+}
+
+
 /**
-   \details Return an unused or new context identifier
+   \details Initialize the context identifier bitmap and the context
+   indexes
+
+   \param pctx pointer to the processing context
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_init_context_registry(struct processing_context *pctx)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!pctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+
+	pctx->context_ids = talloc_zero_array(pctx, uint32_t, 1);
+	MAPISTORE_RETVAL_IF(!pctx->context_ids, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	/* 0 is never returned as a context identifier */
+	pctx->context_ids[0] = 1;
+	pctx->free_hint = 0;
+	pctx->contexts = NULL;
+	htable_init(&pctx->contexts_by_uri, mapistore_context_rehash, NULL);
+	talloc_set_destructor(pctx, mapistore_context_registry_destructor);
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Return the lowest unused context identifier
 
    \param pctx pointer to the processing context
    \param context_id pointer to the context identifier the function
    returns
 
-   \return a non zero context identifier on success, otherwise 0.
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
  */
 enum mapistore_error mapistore_get_context_id(struct processing_context *pctx, uint32_t *context_id)
 {
-	struct context_id_list	*el;
+	uint32_t	count;
+	uint32_t	i;
+	int		bit;
 
 	/* Sanity checks */
-	MAPISTORE_RETVAL_IF(!pctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
-
-	/* Step 1. The free context list doesn't exist yet */
-	if (!pctx->free_ctx) {
-		pctx->last_context_id++;
-		*context_id = pctx->last_context_id;
+	MAPISTORE_RETVAL_IF(!pctx || !pctx->context_ids, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!context_id, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Skip the words with all identifiers in use */
+	count = talloc_array_length(pctx->context_ids);
+	for (i = pctx->free_hint; i < count && pctx->context_ids[i] == 0xFFFFFFFF; i++);
+	pctx->free_hint = i;
+
+	/* Step 2. Double the bitmap size when it is full */
+	if (i == count) {
+		pctx->context_ids = talloc_realloc(pctx, pctx->context_ids, uint32_t, count * 2);
+		MAPISTORE_RETVAL_IF(!pctx->context_ids, MAPISTORE_ERR_NO_MEMORY, NULL);
+		memset(pctx->context_ids + count, 0, count * sizeof (uint32_t));
 	}
 
-	/* Step 2. We have a free list */
-	for (el = pctx->free_ctx; el; el = el->next) {
-		if (el->context_id) {
-			*context_id = el->context_id;
-			DLIST_REMOVE(pctx->free_ctx, el);
-			break;
-		}
-	}
+	/* Step 3. Take the lowest free bit */
+	bit = ffs(~pctx->context_ids[i]) - 1;
+	pctx->context_ids[i] |= (1U << bit);
+	*context_id = i * 32 + bit;
 
 	return MAPISTORE_SUCCESS;
 }
 
 
 /**
-   \details Add a context identifier to the list
+   \details Release a context identifier
 
    \param pctx pointer to the processing context
    \param context_id the identifier referencing the context to free
 
-   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_CORRUPTED if
+   the identifier is not in use, otherwise MAPISTORE error
  */
 enum mapistore_error mapistore_free_context_id(struct processing_context *pctx, uint32_t context_id)
 {
-	struct context_id_list	*el;
+	uint32_t	i = context_id / 32;
+	uint32_t	mask = 1U << (context_id % 32);
 
 	/* Sanity checks */
-	MAPISTORE_RETVAL_IF(!pctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!pctx || !pctx->context_ids, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!context_id, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	/* Step 1. Ensure the list is not corrupted */
-	for (el = pctx->free_ctx; el; el = el->next) {
-		if (el->context_id == context_id) {
-			return MAPISTORE_ERR_CORRUPTED;
-		}
+	/* Step 1. Ensure the identifier is not already free */
+	if (i >= talloc_array_length(pctx->context_ids) || !(pctx->context_ids[i] & mask)) {
+		return MAPISTORE_ERR_CORRUPTED;
 	}
 
-	/* Step 2. Create the element and add it to the list */
-	el = talloc_zero((TALLOC_CTX *)pctx, struct context_id_list);
-	el->context_id = context_id;
-	DLIST_ADD_END(pctx->free_ctx, el, struct context_id_list *);
+	/* Step 2. Clear the bit */
+	pctx->context_ids[i] &= ~mask;
+	if (i < pctx->free_hint) {
+		pctx->free_hint = i;
+	}
 
 	return MAPISTORE_SUCCESS;
 }
+
+
+/**
+   \details Index a context by identifier and URI
+
+   \param pctx pointer to the processing context
+   \param el pointer to the context list element to index
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_register_context(struct processing_context *pctx, struct backend_context_list *el)
+{
+	uint32_t	count;
+	uint32_t	size;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!pctx || !pctx->context_ids, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!el || !el->ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Grow the identifier index */
+	count = talloc_array_length(pctx->contexts);
+	if (el->ctx->context_id >= count) {
+		for (size = count ? count : 32; size <= el->ctx->context_id; size *= 2);
+		pctx->contexts = talloc_realloc(pctx, pctx->contexts, struct backend_context_list *, size);
+		MAPISTORE_RETVAL_IF(!pctx->contexts, MAPISTORE_ERR_NO_MEMORY, NULL);
+		memset(pctx->contexts + count, 0, (size - count) * sizeof (struct backend_context_list *));
+	}
+	MAPISTORE_RETVAL_IF(pctx->contexts[el->ctx->context_id], MAPISTORE_ERR_EXIST, NULL);
+
+	/* Step 2. Index the context */
+	if (el->ctx->uri) {
+		MAPISTORE_RETVAL_IF(!htable_add(&pctx->contexts_by_uri, hash_string(el->ctx->uri), el),
+				    MAPISTORE_ERR_NO_MEMORY, NULL);
+	}
+	pctx->contexts[el->ctx->context_id] = el;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Remove a context from the indexes
+
+   \param pctx pointer to the processing context
+   \param el pointer to the context list element to remove
+ */
+void mapistore_unregister_context(struct processing_context *pctx, struct backend_context_list *el)
+{
+	if (!pctx || !el || !el->ctx) return;
+	if (el->ctx->context_id >= talloc_array_length(pctx->contexts)) return;
+	if (pctx->contexts[el->ctx->context_id] != el) return;
+
+	if (el->ctx->uri) {
+		htable_del(&pctx->contexts_by_uri, hash_string(el->ctx->uri), el);
+	}
+	pctx->contexts[el->ctx->context_id] = NULL;
+}
+
+
+/**
+   \details Search a registered context given its identifier
+
+   \param pctx pointer to the processing context
+   \param context_id the context identifier to search
+
+   \return Pointer to the context list element on success, otherwise NULL
+ */
+struct backend_context_list *mapistore_find_context(struct processing_context *pctx, uint32_t context_id)
+{
+	if (!pctx || context_id >= talloc_array_length(pctx->contexts)) return NULL;
+
+	return pctx->contexts[context_id];
+}
+
+
+/**
+   \details Search a registered context given its URI
+
+   \param pctx pointer to the processing context
+   \param uri the URI to search
+
+   \return Pointer to the context list element on success, otherwise NULL
+ */
+struct backend_context_list *mapistore_find_context_by_uri(struct processing_context *pctx, const char *uri)
+{
+	if (!pctx || !uri || !pctx->context_ids) return NULL;
+
+	return htable_get(&pctx->contexts_by_uri, hash_string(uri), mapistore_context_cmp, uri);
+}
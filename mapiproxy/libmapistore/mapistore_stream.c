@@ -0,0 +1,302 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapistore.h"
+#include "mapistore_errors.h"
+#include "mapistore_private.h"
+
+/**
+   \file mapistore_stream.c
+
+   \brief Chunked access to large properties
+
+   Backends implementing the optional open_property_stream, read_at,
+   write_at and get_size operations let callers access a property by
+   ranges instead of loading its whole value with get_properties. The
+   stream content is the wire representation of the property: raw
+   bytes for PT_BINARY, a NUL terminated string for PT_STRING8 and
+   UTF-16LE for PT_UNICODE.
+
+   Reads are served from a single cached chunk of
+   MAPISTORE_STREAM_CHUNK_SIZE bytes, so that the successive small
+   reads of a client walking the stream only reach the backend once
+   per chunk, while memory stays bounded whatever the property size.
+   Data written with write_at is committed by the backend when the
+   stream is committed, or at the latest when the backend stream object
+   is released. Backends without the optional commit_stream operation
+   have their stream released and opened again on commit.
+ */
+
+struct mapistore_property_stream {
+	struct backend_context	*backend_ctx;
+	void			*object;
+	void			*backend_stream;
+	enum MAPITAGS		prop_tag;
+	bool			read_write;
+	uint64_t		size;
+	uint64_t		chunk_offset;
+	DATA_BLOB		chunk;
+};
+
+
+static void mapistore_property_stream_drop_chunk(struct mapistore_property_stream *stream)
+{
+	if (stream->chunk.data) {
+		talloc_unlink(stream, stream->chunk.data);
+	}
+	stream->chunk.data = NULL;
+	stream->chunk.length = 0;
+	stream->chunk_offset = 0;
+}
+
+
+/**
+   \details Open a property of a mapistore object for chunked access
+
+   \param mstore_ctx pointer to the mapistore context
+   \param context_id the context identifier referencing the backend
+   \param object pointer to the backend object holding the property
+   \param mem_ctx pointer to the memory context
+   \param prop_tag the property to open
+   \param read_write whether the stream can be written to
+   \param streamp pointer on the returned stream
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_IMPLEMENTED
+   if the backend does not support property streams, otherwise
+   MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_properties_open_stream(struct mapistore_context *mstore_ctx, uint32_t context_id,
+							       void *object, TALLOC_CTX *mem_ctx,
+							       enum MAPITAGS prop_tag, bool read_write,
+							       struct mapistore_property_stream **streamp)
+{
+	enum mapistore_error			ret;
+	struct backend_context			*backend_ctx;
+	struct mapistore_property_stream	*stream;
+
+	/* Sanity checks */
+	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
+	MAPISTORE_RETVAL_IF(!streamp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Search the context */
+	backend_ctx = mapistore_backend_lookup(mstore_ctx, context_id);
+	MAPISTORE_RETVAL_IF(!backend_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	stream = talloc_zero(mem_ctx, struct mapistore_property_stream);
+	MAPISTORE_RETVAL_IF(!stream, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	stream->backend_ctx = backend_ctx;
+	stream->object = object;
+	stream->prop_tag = prop_tag;
+	stream->read_write = read_write;
+
+	/* Step 2. Open the backend stream and retrieve its size */
+	ret = mapistore_backend_properties_open_stream(backend_ctx, object, stream, prop_tag, read_write, &stream->backend_stream);
+	if (ret != MAPISTORE_SUCCESS) {
+		talloc_free(stream);
+		return ret;
+	}
+
+	ret = mapistore_backend_properties_get_size(backend_ctx, stream->backend_stream, &stream->size);
+	MAPISTORE_RETVAL_IF(ret != MAPISTORE_SUCCESS, ret, stream);
+
+	*streamp = stream;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Read a range of a property stream. The returned data is
+   copied on mem_ctx, so it stays valid even if the stream moves to
+   another chunk or is closed, and is freed with mem_ctx.
+
+   \param stream pointer to the property stream
+   \param mem_ctx pointer to the memory context the returned data is
+   copied on, NULL to point into the cached chunk when data is used
+   before the next stream operation
+   \param offset position of the first byte to read
+   \param length maximum number of bytes to read
+   \param data pointer on the returned data, shorter than length at
+   the end of the stream
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_property_stream_read(struct mapistore_property_stream *stream,
+							     TALLOC_CTX *mem_ctx,
+							     uint64_t offset, uint32_t length,
+							     DATA_BLOB *data)
+{
+	enum mapistore_error	ret;
+	DATA_BLOB		chunk;
+	uint64_t		fetch;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!stream || !stream->backend_stream, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!data, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	data->data = NULL;
+	data->length = 0;
+
+	if (offset >= stream->size || !length) {
+		return MAPISTORE_SUCCESS;
+	}
+	if (length > stream->size - offset) {
+		length = stream->size - offset;
+	}
+
+	/* Step 1. Fetch the chunk starting at offset unless the cached
+	 * one holds the whole range */
+	if (!stream->chunk.data || offset < stream->chunk_offset ||
+	    offset + length > stream->chunk_offset + stream->chunk.length) {
+		mapistore_property_stream_drop_chunk(stream);
+
+		fetch = (length > MAPISTORE_STREAM_CHUNK_SIZE) ? length : MAPISTORE_STREAM_CHUNK_SIZE;
+		if (fetch > stream->size - offset) {
+			fetch = stream->size - offset;
+		}
+
+		chunk.data = NULL;
+		chunk.length = 0;
+		ret = mapistore_backend_properties_read_at(stream->backend_ctx, stream->backend_stream, stream,
+							   offset, (uint32_t) fetch, &chunk);
+		MAPISTORE_RETVAL_IF(ret != MAPISTORE_SUCCESS, ret, NULL);
+		if (!chunk.data || !chunk.length) {
+			/* The property shrank behind our back */
+			stream->size = offset;
+			return MAPISTORE_SUCCESS;
+		}
+
+		stream->chunk = chunk;
+		stream->chunk_offset = offset;
+		if (length > chunk.length) {
+			length = chunk.length;
+		}
+	}
+
+	/* Step 2. Return a slice of the cached chunk */
+	data->data = stream->chunk.data + (offset - stream->chunk_offset);
+	if (mem_ctx) {
+		data->data = (uint8_t *) talloc_memdup(mem_ctx, data->data, length);
+		MAPISTORE_RETVAL_IF(!data->data, MAPISTORE_ERR_NO_MEMORY, NULL);
+	}
+	data->length = length;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Write a range of a property stream
+
+   \param stream pointer to the property stream
+   \param offset position where data is written, the stream grows if
+   it goes beyond its end
+   \param data the data to write
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_property_stream_write(struct mapistore_property_stream *stream,
+							      uint64_t offset, DATA_BLOB data)
+{
+	enum mapistore_error	ret;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!stream || !stream->backend_stream, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!stream->read_write, MAPISTORE_ERR_DENIED, NULL);
+
+	if (!data.length) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	/* Cached data may be stale once written */
+	if (stream->chunk.data && offset < stream->chunk_offset + stream->chunk.length &&
+	    offset + data.length > stream->chunk_offset) {
+		mapistore_property_stream_drop_chunk(stream);
+	}
+
+	ret = mapistore_backend_properties_write_at(stream->backend_ctx, stream->backend_stream, offset, data);
+	MAPISTORE_RETVAL_IF(ret != MAPISTORE_SUCCESS, ret, NULL);
+
+	if (offset + data.length > stream->size) {
+		stream->size = offset + data.length;
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Retrieve the size of a property stream
+
+   \param stream pointer to the property stream
+   \param sizep pointer on the returned size in bytes
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_property_stream_get_size(struct mapistore_property_stream *stream,
+								 uint64_t *sizep)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!stream, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!sizep, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	*sizep = stream->size;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Commit the data written to a property stream, so that it
+   is stored by the backend before the stream is released
+
+   \param stream pointer to the property stream
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_property_stream_commit(struct mapistore_property_stream *stream)
+{
+	enum mapistore_error	ret;
+	void			*backend_stream;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!stream || !stream->backend_stream, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!stream->read_write, MAPISTORE_ERR_DENIED, NULL);
+
+	ret = mapistore_backend_properties_commit_stream(stream->backend_ctx, stream->backend_stream);
+	if (ret != MAPISTORE_ERR_NOT_IMPLEMENTED) {
+		return ret;
+	}
+
+	/* Releasing the backend stream commits its data: open it again
+	 * for the next operations */
+	mapistore_property_stream_drop_chunk(stream);
+	talloc_free(stream->backend_stream);
+	stream->backend_stream = NULL;
+
+	ret = mapistore_backend_properties_open_stream(stream->backend_ctx, stream->object, stream, stream->prop_tag,
+						       stream->read_write, &backend_stream);
+	MAPISTORE_RETVAL_IF(ret != MAPISTORE_SUCCESS, ret, NULL);
+	stream->backend_stream = backend_stream;
+
+	return mapistore_backend_properties_get_size(stream->backend_ctx, stream->backend_stream, &stream->size);
+}
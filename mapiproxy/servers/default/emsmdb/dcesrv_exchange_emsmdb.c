@@ -26,25 +26,53 @@
  */
 
 #include <sys/time.h>
+#include <time.h>
 
 #include "mapiproxy/dcesrv_mapiproxy.h"
 #include "mapiproxy/libmapiserver/libmapiserver.h"
 #include "dcesrv_exchange_emsmdb.h"
 
-struct exchange_emsmdb_session		*emsmdb_session = NULL;
+static struct mpm_session_registry	*emsmdb_sessions = NULL;
+static struct mpm_rop_stats		*emsmdb_rop_stats = NULL;
+static pid_t				emsmdb_server_pid = 0;
 void					*openchange_db_ctx = NULL;
 
-static struct exchange_emsmdb_session *dcesrv_find_emsmdb_session(struct GUID *uuid)
+static struct mpm_session *dcesrv_find_emsmdb_session(struct GUID *uuid)
 {
-	struct exchange_emsmdb_session	*session, *found_session = NULL;
+	return mpm_session_registry_find(emsmdb_sessions, uuid);
+}
+
+/**
+   \details Record a processed ROP in the shared ROP statistics. The
+   request size is not known once the request buffer is parsed, so the
+   ROP is serialized again here, only when statistics are enabled.
+
+   \param ndr pointer to the push context reused over the transaction
+   \param mapi_req pointer to the processed ROP request
+   \param start time the ROP processing started
+   \param bytes_out size of the ROP response
+   \param failed whether the ROP returned an error
+ */
+static void emsmdbp_rop_stats_record(struct ndr_push *ndr,
+				     struct EcDoRpc_MAPI_REQ *mapi_req,
+				     const struct timespec *start,
+				     uint32_t bytes_out, bool failed)
+{
+	struct timespec	end;
+	uint64_t	usec;
+	uint32_t	bytes_in = 0;
 
-	for (session = emsmdb_session; !found_session && session; session = session->next) {
-		if (GUID_equal(uuid, &session->uuid)) {
-			found_session = session;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	usec = (end.tv_sec - start->tv_sec) * 1000000ULL + end.tv_nsec / 1000 - start->tv_nsec / 1000;
+
+	if (ndr) {
+		ndr->offset = 0;
+		if (ndr_push_EcDoRpc_MAPI_REQ(ndr, NDR_SCALARS, mapi_req) == NDR_ERR_SUCCESS) {
+			bytes_in = ndr->offset;
 		}
 	}
 
-	return found_session;
+	mpm_rop_stats_record(emsmdb_rop_stats, mapi_req->opnum, usec, bytes_in, bytes_out, failed);
 }
 
 /* FIXME: See _unbind below */
@@ -81,7 +109,7 @@ static enum MAPISTATUS dcesrv_EcDoConnect(struct dcesrv_call_state *dce_call,
 	struct emsmdbp_context		*emsmdbp_ctx;
 	struct dcesrv_handle		*handle;
 	struct policy_handle		wire_handle;
-	struct exchange_emsmdb_session	*session;
+	struct mpm_session		*session;
 	struct ldb_message		*msg;
 	const char			*mailNickname;
 	const char			*userDN;
@@ -200,30 +228,35 @@ static enum MAPISTATUS dcesrv_EcDoConnect(struct dcesrv_call_state *dce_call,
 
 	r->out.result = MAPI_E_SUCCESS;
 
+	/* Evict sessions left behind by clients which never disconnected */
+	mpm_session_registry_expire(emsmdb_sessions, time(NULL));
+
 	/* Search for an existing session and increment ref_count, otherwise create it */
-        session = dcesrv_find_emsmdb_session(&handle->wire_handle.uuid);
-        if (session) {
-                DEBUG(0, ("[exchange_emsmdb]: Increment session ref count for %d\n", 
-                          session->session->context_id));
-                mpm_session_increment_ref_count(session->session);
-        }
+	session = dcesrv_find_emsmdb_session(&handle->wire_handle.uuid);
+	if (session) {
+		DEBUG(5, ("[exchange_emsmdb]: Increment session ref count for %d\n",
+			  session->context_id));
+		mpm_session_increment_ref_count(session);
+	}
 	else {
 		/* Step 7. Associate this emsmdbp context to the session */
-		session = talloc((TALLOC_CTX *)emsmdb_session, struct exchange_emsmdb_session);
+		session = mpm_session_init((TALLOC_CTX *)emsmdb_sessions, dce_call);
 		OPENCHANGE_RETVAL_IF(!session, MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
 
-		session->pullTimeStamp = *r->out.pullTimeStamp;
-		session->session = mpm_session_init((TALLOC_CTX *)emsmdb_session, dce_call);
-		OPENCHANGE_RETVAL_IF(!session->session, MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
-
-                session->uuid = handle->wire_handle.uuid;
+		mpm_session_set_private_data(session, (void *) emsmdbp_ctx);
+		mpm_session_set_destructor(session, emsmdbp_destructor);
 
-		mpm_session_set_private_data(session->session, (void *) emsmdbp_ctx);
-		mpm_session_set_destructor(session->session, emsmdbp_destructor);
+		if (!mpm_session_registry_add(emsmdb_sessions, &handle->wire_handle.uuid, session)) {
+			talloc_free(session);
+			OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
+		}
 
-		DEBUG(0, ("[exchange_emsmdb]: New session added: %d\n", session->session->context_id));
+		DEBUG(5, ("[exchange_emsmdb]: New session added: %d\n", session->context_id));
+	}
 
-		DLIST_ADD_END(emsmdb_session, session, struct exchange_emsmdb_session *);
+	/* The session can't expire while the client holds the handle */
+	if (mpm_session_registry_hold(emsmdb_sessions, &handle->wire_handle.uuid, handle) != MAPI_E_SUCCESS) {
+		DEBUG(1, ("[exchange_emsmdb]: Unable to hold session %d\n", session->context_id));
 	}
 
 	return MAPI_E_SUCCESS;
@@ -244,8 +277,7 @@ static enum MAPISTATUS dcesrv_EcDoDisconnect(struct dcesrv_call_state *dce_call,
 					     struct EcDoDisconnect *r)
 {
 	struct dcesrv_handle		*h;
-	struct exchange_emsmdb_session	*session;
-	bool				ret;
+	enum MAPISTATUS			retval;
 
 	DEBUG(3, ("exchange_emsmdb: EcDoDisconnect (0x1)\n"));
 
@@ -258,21 +290,20 @@ static enum MAPISTATUS dcesrv_EcDoDisconnect(struct dcesrv_call_state *dce_call,
 	/* Step 1. Retrieve handle and free if emsmdbp context and session are available */
 	h = dcesrv_handle_fetch(dce_call->context, r->in.handle, DCESRV_HANDLE_ANY);
 	if (h) {
-                session = dcesrv_find_emsmdb_session(&r->in.handle->uuid);
-                if (session) {
-                        ret = mpm_session_release(session->session);
-                        if (ret == true) {
-                                DLIST_REMOVE(emsmdb_session, session);
-                                DEBUG(5, ("[%s:%d]: Session found and released\n", 
-                                          __FUNCTION__, __LINE__));
-                        } else {
-                                DEBUG(5, ("[%s:%d]: Session found and ref_count decreased\n",
-                                          __FUNCTION__, __LINE__));
-                        }
+		retval = mpm_session_registry_release(emsmdb_sessions, &r->in.handle->uuid);
+		switch (retval) {
+		case MAPI_E_SUCCESS:
+			DEBUG(5, ("[%s:%d]: Session found and released\n",
+				  __FUNCTION__, __LINE__));
+			break;
+		case MAPI_E_UNABLE_TO_COMPLETE:
+			DEBUG(5, ("[%s:%d]: Session found and ref_count decreased\n",
+				  __FUNCTION__, __LINE__));
+			break;
+		default:
+			DEBUG(5, ("  emsmdb_session NOT found\n"));
+			break;
 		}
-                else {
-                        DEBUG(5, ("  emsmdb_session NOT found\n"));
-                }
 	}
 
 	r->out.handle->handle_type = 0;
@@ -283,10 +314,41 @@ static enum MAPISTATUS dcesrv_EcDoDisconnect(struct dcesrv_call_state *dce_call,
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Update the row counters of the table a notification was
+   sent to
+
+   FIXME: here is a hack to update table counters and which would not
+   be needed if the backend had access to the table structure...
+ */
+static void emsmdbp_notification_update_table(struct emsmdbp_context *emsmdbp_ctx,
+					      uint32_t handle,
+					      struct mapistore_notification *notification)
+{
+	struct mapi_handles		*rec;
+	struct emsmdbp_object		*object;
+	struct emsmdbp_object_table	*table;
+
+	if (notification->object_type != MAPISTORE_TABLE) return;
+	if (mapi_handles_search(emsmdbp_ctx->handles_ctx, handle, &rec)) return;
+	if (mapi_handles_get_private_data(rec, (void **) &object) || !object) return;
+
+	table = object->object.table;
+	if (notification->event == MAPISTORE_OBJECT_CREATED) {
+		table->denominator++;
+	}
+	else if (notification->event == MAPISTORE_OBJECT_DELETED) {
+		table->denominator--;
+		if (table->numerator >= table->denominator) {
+			table->numerator = table->denominator;
+		}
+	}
+}
+
 static bool emsmdbp_fill_notification(TALLOC_CTX *mem_ctx, 
                                       struct emsmdbp_context *emsmdbp_ctx,
                                       struct EcDoRpc_MAPI_REPL *mapi_repl,
-                                      struct mapistore_subscription *subscription,
+                                      uint32_t handle,
                                       struct mapistore_notification *notification,
                                       uint16_t *sizep)
 {
@@ -307,7 +369,7 @@ static bool emsmdbp_fill_notification(TALLOC_CTX *mem_ctx,
         reply = &mapi_repl->u.mapi_Notify;
         reply->LogonId = 0; /* TODO: seems to be always 0 ? */
 
-	retval = mapi_handles_search(emsmdbp_ctx->handles_ctx, subscription->handle, &handle_object_handle);
+	retval = mapi_handles_search(emsmdbp_ctx->handles_ctx, handle, &handle_object_handle);
 	if (retval) {
 		reply->NotificationType = fnevCriticalError;
 		DEBUG(5, ("notification handle not found\n"));
@@ -320,7 +382,7 @@ static bool emsmdbp_fill_notification(TALLOC_CTX *mem_ctx,
 		goto end;
 	}
 
-	reply->NotificationHandle = subscription->handle;
+	reply->NotificationHandle = handle;
         switch (notification->object_type) {
         case MAPISTORE_MESSAGE:
                 reply->NotificationType = fnevMbit;
@@ -348,17 +410,6 @@ static bool emsmdbp_fill_notification(TALLOC_CTX *mem_ctx,
         if (notification->object_type == MAPISTORE_TABLE) {
                 table = handle_object->object.table;
 
-                /* FIXME: here is a hack to update table counters and which would not be needed if the backend had access to the table structure... */
-                if (notification->event == MAPISTORE_OBJECT_CREATED) {
-                        table->denominator++;
-                }
-                else if (notification->event == MAPISTORE_OBJECT_DELETED) {
-                        table->denominator--;
-                        if (table->numerator >= table->denominator) {
-                                table->numerator = table->denominator;
-                        }
-                }
-
                 if (notification->parameters.table_parameters.table_type == MAPISTORE_FOLDER_TABLE) {
                         if (notification->event == MAPISTORE_OBJECT_CREATED || notification->event == MAPISTORE_OBJECT_MODIFIED) {
                                 if (notification->parameters.table_parameters.row_id > 0) {
@@ -643,613 +694,102 @@ end:
 
 static struct mapi_response *EcDoRpc_process_transaction(TALLOC_CTX *mem_ctx, 
 							 struct emsmdbp_context *emsmdbp_ctx,
-							 struct mapi_request *mapi_request)
+							 struct mapi_request *mapi_request,
+							 uint32_t max_size)
 {
 	enum MAPISTATUS				retval;
 	struct mapi_response			*mapi_response;
-        struct mapistore_notification_list	*notification_holder;
-/*
-	struct mapistore_notification_list	*nlist;
-	struct mapistore_notification_list	*el;
-	struct mapistore_subscription_list	*sel;
-*/
-        struct mapistore_subscription_list	*subscription_list;
-	struct mapistore_subscription_list	*subscription_holder;
+	struct emsmdbp_transaction		*transaction;
+	struct mapistore_notification_list	*notification_holder;
 	uint32_t		handles_length;
 	uint16_t		size = 0;
+	uint16_t		rop_size = 0;
+	uint16_t		notif_size;
+	uint32_t		handles_count;
 	uint32_t		i;
 	uint32_t		idx;
-	bool			needs_realloc = true;
+	const struct emsmdbp_rop	*rop;
+	bool			has_reply;
+	struct ndr_push		*stats_ndr = NULL;
+	struct timespec		rop_start;
 
 	/* Sanity checks */
 	if (!emsmdbp_ctx) return NULL;
 	if (!mapi_request) return NULL;
 
-	/* Allocate mapi_response */
+	/* Allocate mapi_response, which owns the transaction memory */
 	mapi_response = talloc_zero(mem_ctx, struct mapi_response);
+	if (!mapi_response) return NULL;
 	mapi_response->handles = mapi_request->handles;
 
-	/* Step 1. Handle Idle requests case */
+	transaction = emsmdbp_transaction_init(mapi_response, mapi_request, max_size,
+					       emsmdbp_ctx->mstore_ctx->notifications_count,
+					       emsmdbp_rop_size(mapi_request));
+	if (!transaction) {
+		talloc_free(mapi_response);
+		return NULL;
+	}
+	mapi_response->mapi_repl = transaction->replies;
+
+	/* Step 1. Size the ROP buffer, idle requests still get
+	 * notifications. The output buffer also holds the response
+	 * length and the handles array */
+	if (mapi_request->mapi_len > 2 && mapi_request->mapi_len > mapi_request->length) {
+		handles_length = mapi_request->mapi_len - mapi_request->length;
+	} else {
+		handles_length = 0;
+	}
+	handles_count = handles_length / sizeof (uint32_t);
+	if (max_size > EMSMDBP_ROP_BUFFER_MAX) {
+		max_size = EMSMDBP_ROP_BUFFER_MAX;
+	}
+	if (max_size > handles_length + sizeof (mapi_response->length)) {
+		emsmdbp_ctx->rop_buffer_size = max_size - handles_length - sizeof (mapi_response->length);
+	} else {
+		emsmdbp_ctx->rop_buffer_size = 0;
+	}
+
+	/* Step 2. Handle Idle requests case */
 	if (mapi_request->mapi_len <= 2) {
 		mapi_response->mapi_len = 2;
 		idx = 0;
 		goto notif;
 	}
 
-	/* Step 2. Process serialized MAPI requests */
-	mapi_response->mapi_repl = talloc_zero(mem_ctx, struct EcDoRpc_MAPI_REPL);
+	/* Step 3. Process serialized MAPI requests */
+
+	if (emsmdb_rop_stats) {
+		stats_ndr = ndr_push_init_ctx(mem_ctx);
+		if (stats_ndr) {
+			ndr_set_flags(&stats_ndr->flags, LIBNDR_FLAG_NOALIGN);
+		}
+	}
+
 	for (i = 0, idx = 0, size = 0; mapi_request->mapi_req[i].opnum != 0; i++) {
-		DEBUG(0, ("MAPI Rop: 0x%.2x (%d)\n", mapi_request->mapi_req[i].opnum, size));
+		rop = emsmdbp_rop_lookup(mapi_request->mapi_req[i].opnum);
+		has_reply = !rop || !(rop->flags & EMSMDBP_ROP_NO_REPLY);
 
-		if (mapi_request->mapi_req[i].opnum != op_MAPI_Release) {
-			mapi_response->mapi_repl = talloc_realloc(mem_ctx, mapi_response->mapi_repl,
-								  struct EcDoRpc_MAPI_REPL, idx + 2);
+		if (has_reply) {
+			mapi_response->mapi_repl = emsmdbp_transaction_replies(transaction, idx + 1);
 		}
 
-		switch (mapi_request->mapi_req[i].opnum) {
-		case op_MAPI_Release: /* 0x01 */
-			retval = EcDoRpc_RopRelease(mem_ctx, emsmdbp_ctx, 
-						    &(mapi_request->mapi_req[i]),
-						    mapi_request->handles, &size);
-			break;
-		case op_MAPI_OpenFolder: /* 0x02 */
-			retval = EcDoRpc_RopOpenFolder(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_OpenMessage: /* 0x3 */
-			retval = EcDoRpc_RopOpenMessage(mem_ctx, emsmdbp_ctx,
-							&(mapi_request->mapi_req[i]),
-							&(mapi_response->mapi_repl[idx]),
-							mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetHierarchyTable: /* 0x04 */
-			retval = EcDoRpc_RopGetHierarchyTable(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetContentsTable: /* 0x05 */
-			retval = EcDoRpc_RopGetContentsTable(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_CreateMessage: /* 0x06 */
-			retval = EcDoRpc_RopCreateMessage(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetProps: /* 0x07 */
-			retval = EcDoRpc_RopGetPropertiesSpecific(mem_ctx, emsmdbp_ctx,
-								  &(mapi_request->mapi_req[i]),
-								  &(mapi_response->mapi_repl[idx]),
-								  mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetPropsAll: /* 0x8 */
-			retval = EcDoRpc_RopGetPropertiesAll(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetPropList: /* 0x9 */
-			retval = EcDoRpc_RopGetPropertiesList(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),	
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetProps: /* 0x0a */
-			retval = EcDoRpc_RopSetProperties(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_DeleteProps: /* 0xb */
-			retval = EcDoRpc_RopDeleteProperties(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_SaveChangesMessage: /* 0x0c */
-			retval = EcDoRpc_RopSaveChangesMessage(mem_ctx, emsmdbp_ctx,
-                                                               &(mapi_request->mapi_req[i]),
-                                                               &(mapi_response->mapi_repl[idx]),
-                                                               mapi_response->handles, &size);
-			break;
-		case op_MAPI_RemoveAllRecipients: /* 0xd */
-			retval = EcDoRpc_RopRemoveAllRecipients(mem_ctx, emsmdbp_ctx,
-								&(mapi_request->mapi_req[i]),
-								&(mapi_response->mapi_repl[idx]),
-								mapi_response->handles, &size);
-			break;
-		case op_MAPI_ModifyRecipients: /* 0xe */
-			retval = EcDoRpc_RopModifyRecipients(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
+		if (emsmdb_rop_stats) {
+			rop_size = size;
+			clock_gettime(CLOCK_MONOTONIC, &rop_start);
+		}
 
-		/* op_MAPI_ReadRecipients: 0xf */
-		case op_MAPI_ReloadCachedInformation: /* 0x10 */
-			retval = EcDoRpc_RopReloadCachedInformation(mem_ctx, emsmdbp_ctx,
-								    &(mapi_request->mapi_req[i]),
-								    &(mapi_response->mapi_repl[idx]),
-								    mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetMessageReadFlag: /* 0x11 */
-			retval = EcDoRpc_RopSetMessageReadFlag(mem_ctx, emsmdbp_ctx,
-							       &(mapi_request->mapi_req[i]),
-							       &(mapi_response->mapi_repl[idx]),
-							       mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetColumns: /* 0x12 */
-			retval = EcDoRpc_RopSetColumns(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_SortTable: /* 0x13 */
-			retval = EcDoRpc_RopSortTable(mem_ctx, emsmdbp_ctx,
-						      &(mapi_request->mapi_req[i]),
-						      &(mapi_response->mapi_repl[idx]),
-						      mapi_response->handles, &size);
-			break;
-		case op_MAPI_Restrict: /* 0x14 */
-			retval = EcDoRpc_RopRestrict(mem_ctx, emsmdbp_ctx,
-						     &(mapi_request->mapi_req[i]),
-						     &(mapi_response->mapi_repl[idx]),
-						     mapi_response->handles, &size);
-			break;
-		case op_MAPI_QueryRows: /* 0x15 */
-			retval = EcDoRpc_RopQueryRows(mem_ctx, emsmdbp_ctx,
-						      &(mapi_request->mapi_req[i]),
-						      &(mapi_response->mapi_repl[idx]),
-						      mapi_response->handles, &size);
-			break;
-		/* op_MAPI_GetStatus: 0x16 */
-		case op_MAPI_QueryPosition: /* 0x17 */
-			retval = EcDoRpc_RopQueryPosition(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SeekRow: /* 0x18 */
-			retval = EcDoRpc_RopSeekRow(mem_ctx, emsmdbp_ctx,
-						    &(mapi_request->mapi_req[i]),
-						    &(mapi_response->mapi_repl[idx]),
-						    mapi_response->handles, &size);
-			break;
-		/* op_MAPI_SeekRowBookmark: 0x19 */
-		/* op_MAPI_SeekRowApprox: 0x1a */
-		/* op_MAPI_CreateBookmark: 0x1b */
-		case op_MAPI_CreateFolder: /* 0x1c */
-			retval = EcDoRpc_RopCreateFolder(mem_ctx, emsmdbp_ctx,
-							 &(mapi_request->mapi_req[i]),
-							 &(mapi_response->mapi_repl[idx]),
-							 mapi_response->handles, &size);
-			break;
-		case op_MAPI_DeleteFolder: /* 0x1d */
-			retval = EcDoRpc_RopDeleteFolder(mem_ctx, emsmdbp_ctx,
-							 &(mapi_request->mapi_req[i]),
-							 &(mapi_response->mapi_repl[idx]),
-							 mapi_response->handles, &size);
-			break;
-		case op_MAPI_DeleteMessages: /* 0x1e */
-			retval = EcDoRpc_RopDeleteMessages(mem_ctx, emsmdbp_ctx,
-							   &(mapi_request->mapi_req[i]),
-							   &(mapi_response->mapi_repl[idx]),
-							   mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetMessageStatus: /* 0x1f */
-			retval = EcDoRpc_RopGetMessageStatus(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		/* op_MAPI_SetMessageStatus: 0x20 */
-		case op_MAPI_GetAttachmentTable: /* 0x21 */
-			retval = EcDoRpc_RopGetAttachmentTable(mem_ctx, emsmdbp_ctx,
-							       &(mapi_request->mapi_req[i]),
-							       &(mapi_response->mapi_repl[idx]),
-							       mapi_response->handles, &size);
-			break;
-                case op_MAPI_OpenAttach: /* 0x22 */
-			retval = EcDoRpc_RopOpenAttach(mem_ctx, emsmdbp_ctx,
-                                                       &(mapi_request->mapi_req[i]),
-                                                       &(mapi_response->mapi_repl[idx]),
-                                                       mapi_response->handles, &size);
-			break;
-                case op_MAPI_CreateAttach: /* 0x23 */
-			retval = EcDoRpc_RopCreateAttach(mem_ctx, emsmdbp_ctx,
-                                                         &(mapi_request->mapi_req[i]),
-                                                         &(mapi_response->mapi_repl[idx]),
-                                                         mapi_response->handles, &size);
-			break;
-		/* op_MAPI_DeleteAttach: 0x24 */
-		case op_MAPI_SaveChangesAttachment: /* 0x25 */
-			retval = EcDoRpc_RopSaveChangesAttachment(mem_ctx, emsmdbp_ctx,
-                                                                  &(mapi_request->mapi_req[i]),
-                                                                  &(mapi_response->mapi_repl[idx]),
-                                                                  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetReceiveFolder: /* 0x26 */
-			retval = EcDoRpc_RopSetReceiveFolder(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetReceiveFolder: /* 0x27 */
-			retval = EcDoRpc_RopGetReceiveFolder(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_RegisterNotification: /* 0x29 */
-			retval = EcDoRpc_RopRegisterNotification(mem_ctx, emsmdbp_ctx,
-								 &(mapi_request->mapi_req[i]),
-								 &(mapi_response->mapi_repl[idx]),
-								 mapi_response->handles, &size);
-			break;
-		/* op_MAPI_Notify: 0x2a */
-		case op_MAPI_OpenStream: /* 0x2b */
-			retval = EcDoRpc_RopOpenStream(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_ReadStream: /* 0x2c */
-			retval = EcDoRpc_RopReadStream(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_WriteStream: /* 0x2d */
-			retval = EcDoRpc_RopWriteStream(mem_ctx, emsmdbp_ctx,
-							&(mapi_request->mapi_req[i]),
-							&(mapi_response->mapi_repl[idx]),
-							mapi_response->handles, &size);
-			break;
-                case op_MAPI_SeekStream: /* 0x2e */
-			retval = EcDoRpc_RopSeekStream(mem_ctx, emsmdbp_ctx,
-                                                       &(mapi_request->mapi_req[i]),
-                                                       &(mapi_response->mapi_repl[idx]),
-                                                       mapi_response->handles, &size);
-			break;
-                case op_MAPI_SetStreamSize: /* 0x2f */
-			retval = EcDoRpc_RopSetStreamSize(mem_ctx, emsmdbp_ctx,
-                                                          &(mapi_request->mapi_req[i]),
-                                                          &(mapi_response->mapi_repl[idx]),
-                                                          mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetSearchCriteria: /* 0x30 */
-			retval = EcDoRpc_RopSetSearchCriteria(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetSearchCriteria: /* 0x31 */
-			retval = EcDoRpc_RopGetSearchCriteria(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_SubmitMessage: /* 0x32 */
-			retval = EcDoRpc_RopSubmitMessage(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_MoveCopyMessages: /* 0x33 */
-			retval = EcDoRpc_RopMoveCopyMessages(mem_ctx, emsmdbp_ctx,
-							    &(mapi_request->mapi_req[i]),
-							    &(mapi_response->mapi_repl[idx]),
-							    mapi_response->handles, &size);
-		        break;
-		/* op_MAPI_AbortSubmit: 0x34 */
-		case op_MAPI_MoveFolder: /* 0x35 */
-			retval = EcDoRpc_RopMoveFolder(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-		        break;
-		case op_MAPI_CopyFolder: /* 0x36 */
-			retval = EcDoRpc_RopCopyFolder(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-		        break;
-		/* op_MAPI_QueryColumnsAll: 0x37 */
-		/* op_MAPI_Abort: 0x38 */
-		case op_MAPI_CopyTo: /* 0x39 */
-                        retval = EcDoRpc_RopCopyTo(mem_ctx, emsmdbp_ctx,
-                                                   &(mapi_request->mapi_req[i]),
-                                                   &(mapi_response->mapi_repl[idx]),
-                                                   mapi_response->handles, &size);
-			break;
-		/* op_MAPI_CopyToStream: 0x3a */
-		/* op_MAPI_CloneStream: 0x3b */
-		case op_MAPI_GetPermissionsTable: /* 0x3e */
-			retval = EcDoRpc_RopGetPermissionsTable(mem_ctx, emsmdbp_ctx,
-								&(mapi_request->mapi_req[i]),
-								&(mapi_response->mapi_repl[idx]),
-								mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetRulesTable: /* 0x3f */
-			retval = EcDoRpc_RopGetRulesTable(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_ModifyPermissions: /* 0x40 */
-			retval = EcDoRpc_RopModifyPermissions(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_ModifyRules: /* 0x41 */
-			retval = EcDoRpc_RopModifyRules(mem_ctx, emsmdbp_ctx,
-							&(mapi_request->mapi_req[i]),
-							&(mapi_response->mapi_repl[idx]),
-							mapi_response->handles, &size);
-			break;
-		/* op_MAPI_GetOwningServers: 0x42 */
-		case op_MAPI_LongTermIdFromId: /* 0x43 */
-			retval = EcDoRpc_RopLongTermIdFromId(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_IdFromLongTermId: /* 0x44 */
-			retval = EcDoRpc_RopIdFromLongTermId(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		/* op_MAPI_PublicFolderIsGhosted: 0x45 */
-		case op_MAPI_OpenEmbeddedMessage: /* 0x46 */
-			retval = EcDoRpc_RopOpenEmbeddedMessage(mem_ctx, emsmdbp_ctx,
-                                                                &(mapi_request->mapi_req[i]),
-                                                                &(mapi_response->mapi_repl[idx]),
-                                                                mapi_response->handles, &size);
-                        break;
-		case op_MAPI_SetSpooler: /* 0x47 */
-			retval = EcDoRpc_RopSetSpooler(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		/* op_MAPI_SpoolerLockMessage: 0x48 */
-		case op_MAPI_AddressTypes: /*x49 */
-			retval = EcDoRpc_RopGetAddressTypes(mem_ctx, emsmdbp_ctx,
-							    &(mapi_request->mapi_req[i]),
-							    &(mapi_response->mapi_repl[idx]),
-							    mapi_response->handles, &size);
-			break;
-		case op_MAPI_TransportSend: /* 0x4a */
-			retval = EcDoRpc_RopTransportSend(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		/* op_MAPI_FastTransferSourceCopyMessages: 0x4b */
-		/* op_MAPI_FastTransferSourceCopyFolder: 0x4c */
-		case op_MAPI_FastTransferSourceCopyTo: /* 0x4d */
-			retval = EcDoRpc_RopFastTransferSourceCopyTo(mem_ctx, emsmdbp_ctx, 
-								     &(mapi_request->mapi_req[i]),
-								     &(mapi_response->mapi_repl[idx]),
-								     mapi_response->handles, &size);
-			break;
-		case op_MAPI_FastTransferSourceGetBuffer: /* 0x4e */
-			retval = EcDoRpc_RopFastTransferSourceGetBuffer(mem_ctx, emsmdbp_ctx, 
-									&(mapi_request->mapi_req[i]),
-									&(mapi_response->mapi_repl[idx]),
-									mapi_response->handles, &size);
-			break;
-		case op_MAPI_FindRow: /* 0x4f */
-			retval = EcDoRpc_RopFindRow(mem_ctx, emsmdbp_ctx, 
-						    &(mapi_request->mapi_req[i]),
-						    &(mapi_response->mapi_repl[idx]),
-						    mapi_response->handles, &size);
-			break;
-		/* op_MAPI_Progress: 0x50 */
-		/* op_MAPI_TransportNewMail: 0x51 */
-		/* op_MAPI_GetValidAttachments: 0x52 */
-		case op_MAPI_GetNamesFromIDs: /* 0x55 */
-			retval = EcDoRpc_RopGetNamesFromIDs(mem_ctx, emsmdbp_ctx,
-							    &(mapi_request->mapi_req[i]),
-							    &(mapi_response->mapi_repl[idx]),
-							    mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetIDsFromNames: /* 0x56 */
-			retval = EcDoRpc_RopGetPropertyIdsFromNames(mem_ctx, emsmdbp_ctx,
-								    &(mapi_request->mapi_req[i]),
-								    &(mapi_response->mapi_repl[idx]),
-								    mapi_response->handles, &size);
-			break;
-		/* op_MAPI_UpdateDeferredActionMessages: 0x57 */ 
-		case op_MAPI_EmptyFolder: /* 0x58 */
-		retval = EcDoRpc_RopEmptyFolder(mem_ctx, emsmdbp_ctx,
-						&(mapi_request->mapi_req[i]),
-						&(mapi_response->mapi_repl[idx]),
-						mapi_response->handles, &size);
-			break;
-		/* op_MAPI_ExpandRow: 0x59 */
-		/* op_MAPI_CollapseRow: 0x5a */
-		/* op_MAPI_LockRegionStream: 0x5b */
-		/* op_MAPI_UnlockRegionStream: 0x5c */
-		case op_MAPI_CommitStream: /* 0x5d */
-			retval = EcDoRpc_RopCommitStream(mem_ctx, emsmdbp_ctx,
-							 &(mapi_request->mapi_req[i]),
-							 &(mapi_response->mapi_repl[idx]),
-							 mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetStreamSize: /* 0x5e */
-			retval = EcDoRpc_RopGetStreamSize(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		/* op_MAPI_QueryNamedProperties: 0x5f */
-		case op_MAPI_GetPerUserLongTermIds: /* 0x60 */
-			retval = EcDoRpc_RopGetPerUserLongTermIds(mem_ctx, emsmdbp_ctx,
-								  &(mapi_request->mapi_req[i]),
-								  &(mapi_response->mapi_repl[idx]),
-								  mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetPerUserGuid: /* 0x61 */
-			retval = EcDoRpc_RopGetPerUserGuid(mem_ctx, emsmdbp_ctx,
-							   &(mapi_request->mapi_req[i]),
-							   &(mapi_response->mapi_repl[idx]),
-							   mapi_response->handles, &size);
-			break;
-		case op_MAPI_ReadPerUserInformation: /* 0x63 */
-			retval = EcDoRpc_RopReadPerUserInformation(mem_ctx, emsmdbp_ctx,
-								   &(mapi_request->mapi_req[i]),
-								   &(mapi_response->mapi_repl[idx]),
-								   mapi_response->handles, &size);
-			break;
-		/* op_MAPI_ReadPerUserInformation: 0x63 */
-		/* op_MAPI_SetReadFlags: 0x66 */
-		/* op_MAPI_CopyProperties: 0x67 */
-		case op_MAPI_GetReceiveFolderTable: /* 0x68 */
-			retval = EcDoRpc_RopGetReceiveFolderTable(mem_ctx, emsmdbp_ctx,
-								  &(mapi_request->mapi_req[i]),
-								  &(mapi_response->mapi_repl[idx]),
-								  mapi_response->handles, &size);
-			break;
+		retval = emsmdbp_rop_dispatch(transaction->mem_ctx, emsmdbp_ctx, rop,
+					      &(mapi_request->mapi_req[i]),
+					      &(mapi_response->mapi_repl[idx]),
+					      mapi_response->handles, handles_count, &size);
 
-		/* op_MAPI_GetCollapseState: 0x6b */
-		/* op_MAPI_SetCollapseState: 0x6c */
-		case op_MAPI_GetTransportFolder: /* 0x6d */
-			retval = EcDoRpc_RopGetTransportFolder(mem_ctx, emsmdbp_ctx,
-							       &(mapi_request->mapi_req[i]),
-							       &(mapi_response->mapi_repl[idx]),
-							       mapi_response->handles, &size);
-			break;
-		/* op_MAPI_Pending: 0x6e */
-		case op_MAPI_OptionsData: /* 0x6f */
-			retval = EcDoRpc_RopOptionsData(mem_ctx, emsmdbp_ctx,
-							&(mapi_request->mapi_req[i]),
-							&(mapi_response->mapi_repl[idx]),
-							mapi_response->handles, &size);
-			break;
-                case op_MAPI_SyncConfigure: /* 0x70 */
-			retval = EcDoRpc_RopSyncConfigure(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportMessageChange: /* 0x72 */
-			retval = EcDoRpc_RopSyncImportMessageChange(mem_ctx, emsmdbp_ctx,
-								    &(mapi_request->mapi_req[i]),
-								    &(mapi_response->mapi_repl[idx]),
-								    mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportHierarchyChange: /* 0x73 */
-			retval = EcDoRpc_RopSyncImportHierarchyChange(mem_ctx, emsmdbp_ctx,
-								      &(mapi_request->mapi_req[i]),
-								      &(mapi_response->mapi_repl[idx]),
-								      mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportDeletes: /* 0x74 */
-			retval = EcDoRpc_RopSyncImportDeletes(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-                case op_MAPI_SyncUploadStateStreamBegin: /* 0x75 */
-			retval = EcDoRpc_RopSyncUploadStateStreamBegin(mem_ctx, emsmdbp_ctx,
-								       &(mapi_request->mapi_req[i]),
-								       &(mapi_response->mapi_repl[idx]),
-								       mapi_response->handles, &size);
-			break;
-                case op_MAPI_SyncUploadStateStreamContinue: /* 0x76 */
-			retval = EcDoRpc_RopSyncUploadStateStreamContinue(mem_ctx, emsmdbp_ctx,
-									  &(mapi_request->mapi_req[i]),
-									  &(mapi_response->mapi_repl[idx]),
-									  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncUploadStateStreamEnd: /* 0x77 */
-			retval = EcDoRpc_RopSyncUploadStateStreamEnd(mem_ctx, emsmdbp_ctx,
-								     &(mapi_request->mapi_req[i]),
-								     &(mapi_response->mapi_repl[idx]),
-								     mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportMessageMove: /* 0x78 */
-			retval = EcDoRpc_RopSyncImportMessageMove(mem_ctx, emsmdbp_ctx,
-								  &(mapi_request->mapi_req[i]),
-								  &(mapi_response->mapi_repl[idx]),
-								  mapi_response->handles, &size);
-			break;
-		/* op_MAPI_SetPropertiesNoReplicate: 0x79 */
-		case op_MAPI_DeletePropertiesNoReplicate: /* 0x7a */
-			retval = EcDoRpc_RopDeletePropertiesNoReplicate(mem_ctx, emsmdbp_ctx,
-									&(mapi_request->mapi_req[i]),
-									&(mapi_response->mapi_repl[idx]),
-									mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetStoreState: /* 0x7b */
-			retval = EcDoRpc_RopGetStoreState(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncOpenCollector: /* 0x7e */
-			retval = EcDoRpc_RopSyncOpenCollector(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetLocalReplicaIds: /* 0x7f */
-			retval = EcDoRpc_RopGetLocalReplicaIds(mem_ctx, emsmdbp_ctx,
-                                                               &(mapi_request->mapi_req[i]),
-                                                               &(mapi_response->mapi_repl[idx]),
-                                                               mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportReadStateChanges: /* 0x80 */
-			retval = EcDoRpc_RopSyncImportReadStateChanges(mem_ctx, emsmdbp_ctx,
-								       &(mapi_request->mapi_req[i]),
-								       &(mapi_response->mapi_repl[idx]),
-								       mapi_response->handles, &size);
-			break;
-		case op_MAPI_ResetTable: /* 0x81 */
-			retval = EcDoRpc_RopResetTable(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncGetTransferState: /* 0x82 */
-			retval = EcDoRpc_RopSyncGetTransferState(mem_ctx, emsmdbp_ctx,
-								 &(mapi_request->mapi_req[i]),
-								 &(mapi_response->mapi_repl[idx]),
-								 mapi_response->handles, &size);
-			break;
-		/* op_MAPI_OpenPublicFolderByName: 0x87 */
-		/* op_MAPI_SetSyncNotificationGuid: 0x88 */
-		/* op_MAPI_FreeBookmark: 0x89 */
-		/* op_MAPI_WriteAndCommitStream: 0x90 */
-		/* op_MAPI_HardDeleteMessages: 0x91 */
-		/* op_MAPI_HardDeleteMessagesAndSubfolders: 0x92 */
-		case op_MAPI_SetLocalReplicaMidsetDeleted: /* 0x93 */
-			retval = EcDoRpc_RopSetLocalReplicaMidsetDeleted(mem_ctx, emsmdbp_ctx,
-									 &(mapi_request->mapi_req[i]),
-									 &(mapi_response->mapi_repl[idx]),
-									 mapi_response->handles, &size);
-			break;
-		case op_MAPI_Logon: /* 0xfe */
-			retval = EcDoRpc_RopLogon(mem_ctx, emsmdbp_ctx,
-						  &(mapi_request->mapi_req[i]),
-						  &(mapi_response->mapi_repl[idx]),
-						  mapi_response->handles, &size);
-			break;
-		default:
-			DEBUG(1, ("MAPI Rop: 0x%.2x not implemented!\n",
-				  mapi_request->mapi_req[i].opnum));
+		if (emsmdb_rop_stats) {
+			emsmdbp_rop_stats_record(stats_ndr, &(mapi_request->mapi_req[i]), &rop_start, size - rop_size,
+						 has_reply ? (mapi_response->mapi_repl[idx].error_code != MAPI_E_SUCCESS)
+						 : (retval != MAPI_E_SUCCESS));
 		}
 
-		if (mapi_request->mapi_req[i].opnum != op_MAPI_Release) {
+		if (has_reply) {
 			idx++;
 		}
 
@@ -1259,61 +799,51 @@ static struct mapi_response *EcDoRpc_process_transaction(TALLOC_CTX *mem_ctx,
 	}
 
 notif:
-	/* Step 3. Notifications/Pending calls should be processed here */
+	/* Step 4. Notifications/Pending calls should be processed here */
 	/* Note: GetProps and GetRows are filled with flag NDR_REMAINING, which may hide the content of the following replies. */
+	/* Note: notifications were matched against the subscriptions
+	   when they were queued. The ones which do not fit in the output
+	   buffer stay queued and a RopPending reply tells the client to
+	   come back for them. */
 	while ((notification_holder = emsmdbp_ctx->mstore_ctx->notifications)) {
-		subscription_list = mapistore_find_matching_subscriptions(emsmdbp_ctx->mstore_ctx, notification_holder->notification);
-		while ((subscription_holder = subscription_list)) {
-			if (needs_realloc) {
-				mapi_response->mapi_repl = talloc_realloc(mem_ctx, mapi_response->mapi_repl, struct EcDoRpc_MAPI_REPL, idx + 2);
-			}
-			needs_realloc = emsmdbp_fill_notification(mapi_response->mapi_repl, emsmdbp_ctx, &(mapi_response->mapi_repl[idx]), subscription_holder->subscription, notification_holder->notification, &size);
-			DLIST_REMOVE(subscription_list, subscription_holder);
-			talloc_free(subscription_holder);
-			idx++;
+		mapi_response->mapi_repl = emsmdbp_transaction_replies(transaction, idx + 1);
+		memset(&(mapi_response->mapi_repl[idx]), 0, sizeof (struct EcDoRpc_MAPI_REPL));
+
+		notif_size = size;
+		if (!emsmdbp_fill_notification(mapi_response->mapi_repl, emsmdbp_ctx, &(mapi_response->mapi_repl[idx]),
+					       notification_holder->handle, notification_holder->notification, &notif_size)) {
+			talloc_free(mapistore_dequeue_notification(mem_ctx, emsmdbp_ctx->mstore_ctx));
+			continue;
 		}
-                
-		DLIST_REMOVE(emsmdbp_ctx->mstore_ctx->notifications, notification_holder);
-		talloc_free(notification_holder);
-	}
-	
-#if 0
-	{
-		enum mapistore_error	mretval;
-
-		DEBUG(0, ("subscriptions: %p\n", emsmdbp_ctx->mstore_ctx->subscriptions));
-		/* Process notifications available on subscriptions queues */
-		for (sel = emsmdbp_ctx->mstore_ctx->subscriptions; sel; sel = sel->next) {
-			DEBUG(0, ("subscription = %p\n", sel->subscription));
-			if (sel->subscription) {
-				DEBUG(0, ("subscription: handle = 0x%x\n", sel->subscription->handle));
-				DEBUG(0, ("subscription: types = 0x%x\n", sel->subscription->notification_types));
-				DEBUG(0, ("subscription: mqueue = %d\n", sel->subscription->mqueue));
-				DEBUG(0, ("subscription: mqueue name = %s\n", sel->subscription->mqueue_name));
-			}
-			mretval = mapistore_get_queued_notifications(emsmdbp_ctx->mstore_ctx, sel->subscription, &nlist);
-			if (mretval == MAPISTORE_SUCCESS) {
-				for (el = nlist; el->notification; el = el->next) {
-					if (needs_realloc) {
-						mapi_response->mapi_repl = talloc_realloc(mem_ctx, mapi_response->mapi_repl, 
-											  struct EcDoRpc_MAPI_REPL, idx + 2);
-					}
-					needs_realloc = emsmdbp_fill_notification(mapi_response->mapi_repl, emsmdbp_ctx, 
-										  &(mapi_response->mapi_repl[idx]),
-										  sel->subscription, el->notification, &size);
-					idx++;
-				}
-				talloc_free(nlist);
+
+		/* A response always carries at least one reply */
+		if (idx && notif_size + libmapiserver_RopPending_size() > emsmdbp_ctx->rop_buffer_size) {
+			memset(&(mapi_response->mapi_repl[idx]), 0, sizeof (struct EcDoRpc_MAPI_REPL));
+			if (size + libmapiserver_RopPending_size() <= emsmdbp_ctx->rop_buffer_size) {
+				mapi_response->mapi_repl[idx].opnum = op_MAPI_Pending;
+				mapi_response->mapi_repl[idx].u.mapi_Pending.SessionIndex = 0;
+				size += libmapiserver_RopPending_size();
+				idx++;
 			}
+			DEBUG(5, ("[%s:%d]: %u notifications left pending\n", __FUNCTION__, __LINE__,
+				  emsmdbp_ctx->mstore_ctx->notifications_count));
+			break;
 		}
+
+		emsmdbp_notification_update_table(emsmdbp_ctx, notification_holder->handle, notification_holder->notification);
+		size = notif_size;
+		idx++;
+		talloc_free(mapistore_dequeue_notification(mem_ctx, emsmdbp_ctx->mstore_ctx));
 	}
-#endif
+
+	talloc_free(stats_ndr);
 
 	if (mapi_response->mapi_repl) {
 		mapi_response->mapi_repl[idx].opnum = 0;
 	}
+	emsmdbp_transaction_done(transaction);
 	
-	/* Step 4. Fill mapi_response structure */
+	/* Step 5. Fill mapi_response structure */
 	handles_length = mapi_request->mapi_len - mapi_request->length;
 	mapi_response->length = size + sizeof (mapi_response->length);
 	mapi_response->mapi_len = mapi_response->length + handles_length;
@@ -1334,7 +864,7 @@ static enum MAPISTATUS dcesrv_EcDoRpc(struct dcesrv_call_state *dce_call,
 				      TALLOC_CTX *mem_ctx,
 				      struct EcDoRpc *r)
 {
-	struct exchange_emsmdb_session	*session;
+	struct mpm_session		*session;
 	struct emsmdbp_context		*emsmdbp_ctx = NULL;
 	struct mapi_request		*mapi_request;
 	struct mapi_response		*mapi_response;
@@ -1351,9 +881,9 @@ static enum MAPISTATUS dcesrv_EcDoRpc(struct dcesrv_call_state *dce_call,
 	}
 
 	/* Retrieve the emsmdbp_context from the session management system */
-        session = dcesrv_find_emsmdb_session(&r->in.handle->uuid);
-        if (session) {
-                emsmdbp_ctx = (struct emsmdbp_context *)session->session->private_data;
+	session = dcesrv_find_emsmdb_session(&r->in.handle->uuid);
+	if (session) {
+		emsmdbp_ctx = (struct emsmdbp_context *)session->private_data;
 	}
 	else {
 		r->out.handle->handle_type = 0;
@@ -1364,7 +894,11 @@ static enum MAPISTATUS dcesrv_EcDoRpc(struct dcesrv_call_state *dce_call,
 
 	/* Step 1. Process EcDoRpc requests */
 	mapi_request = r->in.mapi_request;
-	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi_request);
+	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi_request, r->in.max_data);
+	if (!mapi_response) {
+		r->out.result = MAPI_E_NOT_ENOUGH_MEMORY;
+		return MAPI_E_NOT_ENOUGH_MEMORY;
+	}
 
 	/* Step 2. Fill EcDoRpc reply */
 	r->out.handle = r->in.handle;
@@ -1412,7 +946,7 @@ static enum MAPISTATUS dcesrv_EcRRegisterPushNotification(struct dcesrv_call_sta
 							  struct EcRRegisterPushNotification *r)
 {
 	int				retval;
-	struct exchange_emsmdb_session	*session;
+	struct mpm_session		*session;
 	/* struct emsmdbp_context		*emsmdbp_ctx = NULL; */
 
 	DEBUG(3, ("exchange_emsmdb: EcRRegisterPushNotification (0x4)\n"));
@@ -1428,7 +962,7 @@ static enum MAPISTATUS dcesrv_EcRRegisterPushNotification(struct dcesrv_call_sta
 	/* Retrieve the emsmdbp_context from the session management system */
 	session = dcesrv_find_emsmdb_session(&r->in.handle->uuid);
 	if (session) {
-		/* emsmdbp_ctx = (struct emsmdbp_context *)session->session->private_data; */
+		/* emsmdbp_ctx = (struct emsmdbp_context *)session->private_data; */
 	} else {
 		r->out.handle->handle_type = 0;
 		r->out.handle->uuid = GUID_zero();
@@ -1569,7 +1103,7 @@ static enum MAPISTATUS dcesrv_EcDoConnectEx(struct dcesrv_call_state *dce_call,
 	struct emsmdbp_context		*emsmdbp_ctx;
 	struct dcesrv_handle		*handle;
 	struct policy_handle		wire_handle;
-	struct exchange_emsmdb_session	*session;
+	struct mpm_session		*session;
 	struct ldb_message		*msg;
 	const char			*mailNickname;
 	const char			*userDN;
@@ -1708,30 +1242,35 @@ static enum MAPISTATUS dcesrv_EcDoConnectEx(struct dcesrv_call_state *dce_call,
 		r->out.result = MAPI_E_SUCCESS;
 	}
 
+	/* Evict sessions left behind by clients which never disconnected */
+	mpm_session_registry_expire(emsmdb_sessions, time(NULL));
+
 	/* Search for an existing session and increment ref_count, otherwise create it */
-        session = dcesrv_find_emsmdb_session(&handle->wire_handle.uuid);
-        if (session) {
-                DEBUG(0, ("[exchange_emsmdb]: Increment session ref count for %d\n", 
-                          session->session->context_id));
-                mpm_session_increment_ref_count(session->session);
-        }
+	session = dcesrv_find_emsmdb_session(&handle->wire_handle.uuid);
+	if (session) {
+		DEBUG(5, ("[exchange_emsmdb]: Increment session ref count for %d\n",
+			  session->context_id));
+		mpm_session_increment_ref_count(session);
+	}
 	else {
 		/* Step 7. Associate this emsmdbp context to the session */
-		session = talloc((TALLOC_CTX *)emsmdb_session, struct exchange_emsmdb_session);
+		session = mpm_session_init((TALLOC_CTX *)emsmdb_sessions, dce_call);
 		OPENCHANGE_RETVAL_IF(!session, MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
 
-		session->pullTimeStamp = *r->out.pulTimeStamp;
-		session->session = mpm_session_init((TALLOC_CTX *)emsmdb_session, dce_call);
-		OPENCHANGE_RETVAL_IF(!session->session, MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
-		
-		session->uuid = handle->wire_handle.uuid;
+		mpm_session_set_private_data(session, (void *) emsmdbp_ctx);
+		mpm_session_set_destructor(session, emsmdbp_destructor);
 
-		mpm_session_set_private_data(session->session, (void *) emsmdbp_ctx);
-		mpm_session_set_destructor(session->session, emsmdbp_destructor);
+		if (!mpm_session_registry_add(emsmdb_sessions, &handle->wire_handle.uuid, session)) {
+			talloc_free(session);
+			OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_RESOURCES, emsmdbp_ctx);
+		}
 
-		DEBUG(0, ("[exchange_emsmdb]: New session added: %d\n", session->session->context_id));
+		DEBUG(5, ("[exchange_emsmdb]: New session added: %d\n", session->context_id));
+	}
 
-		DLIST_ADD_END(emsmdb_session, session, struct exchange_emsmdb_session *);
+	/* The session can't expire while the client holds the handle */
+	if (mpm_session_registry_hold(emsmdb_sessions, &handle->wire_handle.uuid, handle) != MAPI_E_SUCCESS) {
+		DEBUG(1, ("[exchange_emsmdb]: Unable to hold session %d\n", session->context_id));
 	}
 
 	return MAPI_E_SUCCESS;
@@ -1751,15 +1290,14 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 					  struct EcDoRpcExt2 *r)
 {
 	enum ndr_err_code		ndr_err;
-	struct exchange_emsmdb_session	*session;
+	struct mpm_session		*session;
 	struct emsmdbp_context		*emsmdbp_ctx = NULL;
 	struct mapi2k7_request		mapi2k7_request;
 	struct mapi_response		*mapi_response;
-	struct RPC_HEADER_EXT		RPC_HEADER_EXT;
 	struct ndr_pull			*ndr_pull = NULL;
 	struct ndr_push			*ndr_uncomp_rgbOut;
-	struct ndr_push			*ndr_comp_rgbOut;
 	struct ndr_push			*ndr_rgbOut;
+	uint16_t			flags;
 	uint32_t			pulFlags = 0x0;
 	uint32_t			pulTransTime = 0;
 	DATA_BLOB			rgbIn;
@@ -1781,14 +1319,14 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 	}
 
 	/* Retrieve the emsmdbp_context from the session management system */
-        session = dcesrv_find_emsmdb_session(&r->in.handle->uuid);
+	session = dcesrv_find_emsmdb_session(&r->in.handle->uuid);
 	if (!session) {
 		r->out.handle->handle_type = 0;
 		r->out.handle->uuid = GUID_zero();
 		r->out.result = DCERPC_FAULT_CONTEXT_MISMATCH;
 		return MAPI_E_LOGON_FAILED;
 	}
-	emsmdbp_ctx = (struct emsmdbp_context *)session->session->private_data;
+	emsmdbp_ctx = (struct emsmdbp_context *)session->private_data;
 
 	/* Sanity checks on pcbOut input parameter */
 	if (*r->in.pcbOut < 0x00000008) {
@@ -1816,8 +1354,14 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 		return ecRpcFormat;
 	}
 
-	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi2k7_request.mapi_request);
+	/* RPC_HEADER_EXT is 8 bytes long */
+	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi2k7_request.mapi_request,
+						    *r->in.pcbOut - 8);
 	talloc_free(mapi2k7_request.mapi_request);
+	if (!mapi_response) {
+		r->out.result = ecRpcFailed;
+		return ecRpcFailed;
+	}
 
 	/* Fill EcDoRpcExt2 reply */
 	r->out.handle = r->in.handle;
@@ -1829,26 +1373,21 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 	ndr_push_mapi_response(ndr_uncomp_rgbOut, NDR_SCALARS|NDR_BUFFERS, mapi_response);
 	talloc_free(mapi_response);
 
-	/* TODO: compress if requested */
-	ndr_comp_rgbOut = ndr_uncomp_rgbOut;
-
-	/* Build RPC_HEADER_EXT header for MAPI response DATA blob */
-	RPC_HEADER_EXT.Version = 0x0000;
-	RPC_HEADER_EXT.Flags = RHEF_Last;
-	RPC_HEADER_EXT.Flags |= (mapi2k7_request.header.Flags & RHEF_XorMagic);
-	RPC_HEADER_EXT.Size = ndr_comp_rgbOut->offset;
-	RPC_HEADER_EXT.SizeActual = ndr_comp_rgbOut->offset;
-
-	/* Obfuscate content if applicable*/
-	if (RPC_HEADER_EXT.Flags & RHEF_XorMagic) {
-		obfuscate_data(ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset, 0xA5);
+	/* Push the response as extended buffers of at most 32KB each,
+	 * compressed unless the client asked not to */
+	flags = mapi2k7_request.header.Flags & RHEF_XorMagic;
+	if (!(*r->in.pulFlags & pulFlags_NoCompression)) {
+		flags |= RHEF_Compressed;
 	}
-
-	/* Push the constructed blob */
 	ndr_rgbOut = ndr_push_init_ctx(mem_ctx);
 	ndr_set_flags(&ndr_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_RPC_HEADER_EXT(ndr_rgbOut, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
-	ndr_push_bytes(ndr_rgbOut, ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset);
+	ndr_err = ndr_push_mapi2k7_chunks(ndr_rgbOut, ndr_uncomp_rgbOut, flags);
+	talloc_free(ndr_uncomp_rgbOut);
+	if (ndr_err != NDR_ERR_SUCCESS) {
+		talloc_free(ndr_rgbOut);
+		r->out.result = ecRpcFailed;
+		return ecRpcFailed;
+	}
 
 	/* Push MAPI response into a DATA blob */
 	r->out.rgbOut = ndr_rgbOut->data;
@@ -1896,21 +1435,156 @@ static void dcesrv_EcUnknown0xD(struct dcesrv_call_state *dce_call,
 
 
 /**
-   \details exchange_emsmdb EcGetMoreRpc (0xe) function
+   \details exchange_emsmdb EcDoAsyncConnectEx (0xe) function
+
+   The async handle identifies the session whose notifications
+   EcDoAsyncWaitEx waits for.
+
+   \note EcDoAsyncWaitEx comes on its own connection and sessions are
+   only known by the process which created them. The call is refused
+   when connections are served by processes forked from the server
+   (the default samba process model): clients then poll for
+   notifications. Run samba with -M single to use async waits.
 
    \param dce_call pointer to the session context
    \param mem_ctx pointer to the memory context
-   \param r pointer to the EcDoAsyncConnectExt request data
+   \param r pointer to the EcDoAsyncConnectEx request data
 
-   \return MAPI_E_SUCCESS on success
+   \return MAPI_E_SUCCESS on success, otherwise ecRejected
  */
 static enum MAPISTATUS dcesrv_EcDoAsyncConnectEx(struct dcesrv_call_state *dce_call,
 						 TALLOC_CTX *mem_ctx,
 						 struct EcDoAsyncConnectEx *r)
 {
-	DEBUG(3, ("exchange_emsmdb: EcDoAsyncConnectEx (0xe) not implemented\n"));
-	r->out.result = ecRejected;
-	DCESRV_FAULT(DCERPC_FAULT_OP_RNG_ERROR);
+	struct mpm_session		*session;
+
+	DEBUG(3, ("exchange_emsmdb: EcDoAsyncConnectEx (0xe)\n"));
+
+	r->out.async_handle->handle_type = 0;
+	r->out.async_handle->uuid = GUID_zero();
+
+	/* Step 0. Ensure incoming user is authenticated */
+	if (!dcesrv_call_authenticated(dce_call)) {
+		DEBUG(1, ("No challenge requested by client, cannot authenticate\n"));
+		r->out.result = ecRejected;
+		return ecRejected;
+	}
+
+	/* Step 1. Refuse when the wait may reach another process */
+	if (getpid() != emsmdb_server_pid) {
+		DEBUG(3, ("exchange_emsmdb: EcDoAsyncConnectEx refused, connections are served by forked processes\n"));
+		r->out.result = ecRejected;
+		return ecRejected;
+	}
+
+	/* Step 2. Retrieve the session the handle belongs to */
+	session = dcesrv_find_emsmdb_session(&r->in.handle->uuid);
+	if (!session) {
+		r->out.result = ecRejected;
+		return ecRejected;
+	}
+
+	r->out.async_handle->handle_type = EXCHANGE_HANDLE_ASYNC_EMSMDB;
+	r->out.async_handle->uuid = r->in.handle->uuid;
+	r->out.result = MAPI_E_SUCCESS;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Reply to a parked EcDoAsyncWaitEx call
+
+   \param flags the pulFlagsOut value
+   \param retval the status of the call
+   \param private_data pointer to the parked call
+ */
+static void dcesrv_EcDoAsyncWaitEx_done(uint32_t flags, enum MAPISTATUS retval, void *private_data)
+{
+	struct dcesrv_call_state	*dce_call = (struct dcesrv_call_state *) private_data;
+	struct EcDoAsyncWaitEx		*r = (struct EcDoAsyncWaitEx *) dce_call->r;
+	NTSTATUS			status;
+
+	DEBUG(5, ("exchange_async_emsmdb: EcDoAsyncWaitEx completed with flags 0x%x\n", flags));
+
+	*r->out.pulFlagsOut = flags;
+	r->out.result = retval;
+
+	status = dcesrv_reply(dce_call);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(1, ("exchange_async_emsmdb: EcDoAsyncWaitEx reply failed: %s\n", nt_errstr(status)));
+	}
+}
+
+
+/**
+   \details exchange_async_emsmdb EcDoAsyncWaitEx (0x0) function
+
+   The call returns immediately if notifications are already queued
+   for the session. Otherwise it is parked and answered later, when a
+   notification is queued or the wait times out, see emsmdbp_async.c.
+
+   \param dce_call pointer to the session context
+   \param mem_ctx pointer to the memory context
+   \param r pointer to the EcDoAsyncWaitEx request data
+
+   \return MAPI_E_SUCCESS on success, otherwise ecRejected
+ */
+static enum MAPISTATUS dcesrv_EcDoAsyncWaitEx(struct dcesrv_call_state *dce_call,
+					      TALLOC_CTX *mem_ctx,
+					      struct EcDoAsyncWaitEx *r)
+{
+	struct mpm_session		*session;
+	struct emsmdbp_context		*emsmdbp_ctx;
+	uint32_t			timeout;
+	enum MAPISTATUS			retval;
+
+	DEBUG(3, ("exchange_async_emsmdb: EcDoAsyncWaitEx (0x0)\n"));
+
+	*r->out.pulFlagsOut = 0;
+
+	/* Step 0. Ensure incoming user is authenticated */
+	if (!dcesrv_call_authenticated(dce_call)) {
+		DEBUG(1, ("No challenge requested by client, cannot authenticate\n"));
+		r->out.result = ecRejected;
+		return ecRejected;
+	}
+
+	/* Step 1. Retrieve the session, the client polls if it is gone */
+	session = dcesrv_find_emsmdb_session(&r->in.async_handle->uuid);
+	if (!session) {
+		r->out.result = ecRejected;
+		return ecRejected;
+	}
+	emsmdbp_ctx = (struct emsmdbp_context *)session->private_data;
+
+	/* Step 2. Return immediately if notifications are pending */
+	if (emsmdbp_ctx->mstore_ctx->notifications_count) {
+		*r->out.pulFlagsOut = EMSMDBP_ASYNC_NOTIFICATION_PENDING;
+		r->out.result = MAPI_E_SUCCESS;
+		return MAPI_E_SUCCESS;
+	}
+
+	/* Step 3. Park the call until a notification is queued */
+	if (!(dce_call->state_flags & DCESRV_CALL_STATE_FLAG_MAY_ASYNC)) {
+		r->out.result = ecRejected;
+		return ecRejected;
+	}
+
+	timeout = lpcfg_parm_int(dce_call->conn->dce_ctx->lp_ctx, NULL, "exchange_emsmdb",
+				 "async_wait_timeout", EMSMDBP_ASYNC_WAIT_TIMEOUT);
+	retval = emsmdbp_async_wait(dce_call, emsmdbp_ctx->async_ctx, dce_call->event_ctx, timeout,
+				    dcesrv_EcDoAsyncWaitEx_done, dce_call);
+	if (retval != MAPI_E_SUCCESS) {
+		r->out.result = ecRejected;
+		return ecRejected;
+	}
+	dce_call->state_flags |= DCESRV_CALL_STATE_FLAG_ASYNC;
+
+	/* The session can't expire while the call is parked */
+	if (mpm_session_registry_hold(emsmdb_sessions, &r->in.async_handle->uuid, dce_call) != MAPI_E_SUCCESS) {
+		DEBUG(1, ("exchange_async_emsmdb: Unable to hold session %d\n", session->context_id));
+	}
 
 	return MAPI_E_SUCCESS;
 }
@@ -1994,6 +1668,42 @@ static NTSTATUS dcesrv_exchange_emsmdb_dispatch(struct dcesrv_call_state *dce_ca
 }
 
 
+/**
+   \details Dispatch incoming async EMSMDB call to the correct
+   OpenChange server function
+
+   \param dce_call pointer to the session context
+   \param mem_ctx pointer to the memory context
+   \param r generic pointer on async EMSMDB data
+   \param mapiproxy pointer to the mapiproxy structure controlling
+   mapiproxy behavior
+
+   \return NT_STATUS_OK;
+ */
+static NTSTATUS dcesrv_exchange_async_emsmdb_dispatch(struct dcesrv_call_state *dce_call,
+						      TALLOC_CTX *mem_ctx,
+						      void *r, struct mapiproxy *mapiproxy)
+{
+	const struct ndr_interface_table	*table;
+	uint16_t				opnum;
+
+	table = (const struct ndr_interface_table *) dce_call->context->iface->private_data;
+	opnum = dce_call->pkt.u.request.opnum;
+
+	/* Sanity checks */
+	if (!table) return NT_STATUS_UNSUCCESSFUL;
+	if (table->name && strcmp(table->name, NDR_EXCHANGE_ASYNC_EMSMDB_NAME)) return NT_STATUS_UNSUCCESSFUL;
+
+	switch (opnum) {
+	case NDR_ECDOASYNCWAITEX:
+		dcesrv_EcDoAsyncWaitEx(dce_call, mem_ctx, (struct EcDoAsyncWaitEx *)r);
+		break;
+	}
+
+	return NT_STATUS_OK;
+}
+
+
 /**
    \details Initialize the EMSMDB OpenChange server
 
@@ -2003,10 +1713,28 @@ static NTSTATUS dcesrv_exchange_emsmdb_dispatch(struct dcesrv_call_state *dce_ca
  */
 static NTSTATUS dcesrv_exchange_emsmdb_init(struct dcesrv_context *dce_ctx)
 {
-	/* Initialize exchange_emsmdb session */
-	emsmdb_session = talloc_zero(dce_ctx, struct exchange_emsmdb_session);
-	if (!emsmdb_session) return NT_STATUS_NO_MEMORY;
-	emsmdb_session->session = NULL;
+	const char	*rop_stats;
+
+	/* Connections served by forked processes can't share sessions */
+	emsmdb_server_pid = getpid();
+
+	/* Initialize exchange_emsmdb session registry */
+	emsmdb_sessions = mpm_session_registry_init(dce_ctx, "exchange_emsmdb",
+						    lpcfg_parm_int(dce_ctx->lp_ctx, NULL, "dcerpc_mapiproxy",
+								   "session_idle_timeout", MPM_SESSION_IDLE_TIMEOUT));
+	if (!emsmdb_sessions) return NT_STATUS_NO_MEMORY;
+
+	mpm_shared_set_idle_timeout(lpcfg_parm_int(dce_ctx->lp_ctx, NULL, "mapiproxy",
+						   "shared_idle_timeout", MPM_SHARED_IDLE_TIMEOUT));
+
+	/* Per-ROP statistics are only recorded when a file is configured */
+	rop_stats = lpcfg_parm_string(dce_ctx->lp_ctx, NULL, "dcerpc_mapiproxy", "rop_stats");
+	if (rop_stats) {
+		emsmdb_rop_stats = mpm_rop_stats_init(dce_ctx, rop_stats, true);
+		if (!emsmdb_rop_stats) {
+			DEBUG(0, ("[exchange_emsmdb]: ROP statistics disabled, unable to use %s\n", rop_stats));
+		}
+	}
 
 	/* Open read/write context on OpenChange dispatcher database */
 	openchange_db_ctx = emsmdbp_openchangedb_init(dce_ctx->lp_ctx);
@@ -2085,5 +1813,24 @@ NTSTATUS samba_init_module(void)
 		return ret;
 	}
 
+	/* The async interface shares the sessions of the EMSMDB server */
+	server.name = "exchange_async_emsmdb";
+	server.status = MAPIPROXY_DEFAULT;
+	server.description = "OpenChange async EMSMDB server";
+	server.endpoint = "exchange_async_emsmdb";
+
+	server.init = NULL;
+	server.unbind = NULL;
+	server.dispatch = dcesrv_exchange_async_emsmdb_dispatch;
+	server.push = NULL;
+	server.pull = NULL;
+	server.ndr_pull = NULL;
+
+	ret = mapiproxy_server_register(&server);
+	if (!NT_STATUS_IS_OK(ret)) {
+		DEBUG(0, ("Failed to register the 'exchange_async_emsmdb' default mapiproxy server!\n"));
+		return ret;
+	}
+
 	return ret;
 }
@@ -45,6 +45,8 @@
 #endif
 #endif
 
+struct emsmdbp_async_context;
+
 struct emsmdbp_context {
 	char					*szUserDN;
 	char					*szDisplayName;
@@ -56,16 +58,13 @@ struct emsmdbp_context {
 	struct ldb_context			*samdb_ctx;
 	struct mapistore_context		*mstore_ctx;
 	struct mapi_handles_context		*handles_ctx;
+	/* EcDoAsyncWaitEx call parked for the session, see emsmdbp_async.c */
+	struct emsmdbp_async_context		*async_ctx;
 
-	TALLOC_CTX				*mem_ctx;
-};
+	/* Space available for ROP responses in the RPC being processed */
+	uint16_t				rop_buffer_size;
 
-struct exchange_emsmdb_session {
-	uint32_t			pullTimeStamp;
-	struct mpm_session		*session;
-        struct GUID                     uuid;
-	struct exchange_emsmdb_session	*prev;
-	struct exchange_emsmdb_session	*next;
+	TALLOC_CTX				*mem_ctx;
 };
 
 struct emsmdbp_stream {
@@ -73,6 +72,67 @@ struct emsmdbp_stream {
 	DATA_BLOB		buffer;
 };
 
+/* A download stream produced one chunk at a time, see emsmdbp_syncstream.c */
+struct emsmdbp_syncstream {
+	struct emsmdbp_stream	chunk;
+	uint32_t		*cutmarks;
+	uint32_t		next_cutmark_idx;
+	bool			last_chunk;
+};
+
+typedef bool (*emsmdbp_syncstream_fill_fn)(struct emsmdbp_syncstream *, uint32_t, void *);
+
+/* Called when a parked EcDoAsyncWaitEx call completes, see emsmdbp_async.c */
+typedef void (*emsmdbp_async_done_fn)(uint32_t, enum MAPISTATUS, void *);
+
+struct emsmdbp_async_wait {
+	struct emsmdbp_async_context	*async_ctx;
+	struct tevent_context		*ev;
+	struct tevent_timer		*timer;
+	struct tevent_immediate		*im;
+	emsmdbp_async_done_fn		done_fn;
+	void				*private_data;
+};
+
+struct emsmdbp_async_context {
+	struct mapistore_context	*mstore_ctx;
+	struct emsmdbp_async_wait	*wait;
+};
+
+/* Memory and replies of an EcDoRpc transaction, see emsmdbp_transaction.c */
+struct emsmdbp_transaction {
+	TALLOC_CTX			*mem_ctx;
+	size_t				pool_size;
+	uint32_t			rop_count;
+	struct EcDoRpc_MAPI_REPL	*replies;
+	uint32_t			replies_max;
+	bool				resized;
+};
+
+struct emsmdbp_transaction_stats {
+	uint64_t	transactions;
+	uint64_t	rops;
+	uint64_t	pool_bytes;
+	uint64_t	used_bytes;
+	uint64_t	blocks;
+	uint64_t	overflows;
+	uint64_t	reply_resizes;
+};
+
+/* ROP dispatch table entry, see emsmdbp_rop.c */
+typedef enum MAPISTATUS (*emsmdbp_rop_handler_fn)(TALLOC_CTX *, struct emsmdbp_context *, struct EcDoRpc_MAPI_REQ *, struct EcDoRpc_MAPI_REPL *, uint32_t *, uint16_t *);
+typedef uint32_t (*emsmdbp_rop_size_fn)(struct EcDoRpc_MAPI_REQ *);
+typedef uint8_t *(*emsmdbp_rop_handle_fn)(struct EcDoRpc_MAPI_REQ *);
+
+struct emsmdbp_rop {
+	uint8_t			opnum;
+	const char		*name;
+	emsmdbp_rop_handler_fn	handler;
+	uint32_t		flags;
+	emsmdbp_rop_size_fn	size_fn;
+	emsmdbp_rop_handle_fn	handle_idx_fn;
+};
+
 struct emsmdbp_syncconfigure_request {
 	bool is_collector;
 	bool contents_mode;
@@ -151,11 +211,17 @@ struct emsmdbp_object_table {
         struct mapistore_subscription_list	*subscription_list;
 };
 
+struct emsmdbp_table_row {
+	void					**data_pointers;
+	enum MAPISTATUS				*retvals;
+};
+
 struct emsmdbp_object_stream {
 	bool				read_write;
 	bool				needs_commit;
 	enum MAPITAGS			property;
 	struct emsmdbp_stream		stream;
+	struct mapistore_property_stream *backend_stream; /* chunked access to the backend, stream is unused */
 };
 
 struct emsmdbp_stream_data {
@@ -202,10 +268,8 @@ struct emsmdbp_object_synccontext {
 	uint16_t		steps;
 	uint16_t		total_steps;
 
-	/* download buffers */
-	struct emsmdbp_stream	stream;
-	uint32_t		*cutmarks;
-	uint32_t		next_cutmark_idx;
+	/* download stream */
+	struct emsmdbp_syncstream	download;
 };
 
 struct emsmdbp_object_ftcontext {
@@ -242,6 +306,33 @@ struct emsmdbp_object {
 #define	EMSMDB_PCRETRY			6
 #define	EMSMDB_PCRETRYDELAY		10000
 
+/* EcDoAsyncWaitEx pulFlagsOut and default wait, [MS-OXCRPC] 3.3.4.1 */
+#define	EMSMDBP_ASYNC_NOTIFICATION_PENDING	0x00000001
+#define	EMSMDBP_ASYNC_WAIT_TIMEOUT		300
+
+/* Bounds of the memory pool of an EcDoRpc transaction, see emsmdbp_transaction.c */
+#define	EMSMDBP_TRANSACTION_POOL_MIN		0x4000
+#define	EMSMDBP_TRANSACTION_POOL_PER_ROP	0x1000
+#define	EMSMDBP_TRANSACTION_POOL_MAX		0x100000
+/* Estimated size of a talloc chunk header on 64 bits platforms */
+#define	EMSMDBP_TRANSACTION_BLOCK_OVERHEAD	0x60
+
+/* ROP dispatch table flags and memory estimates, see emsmdbp_rop.c */
+#define	EMSMDBP_ROP_OPNUMS			256
+#define	EMSMDBP_ROP_HANDLE_IN			0x00000001
+#define	EMSMDBP_ROP_NO_REPLY			0x00000002
+#define	EMSMDBP_ROP_SIZE_DEFAULT		EMSMDBP_TRANSACTION_POOL_PER_ROP
+#define	EMSMDBP_ROP_SIZE_SMALL			0x200
+#define	EMSMDBP_ROP_SIZE_PER_ROW		0x200
+
+/* Number of rows fetched per backend call when walking a table. FindRow
+ * only fetches batches from backends implementing get_rows */
+#define	EMSMDBP_TABLE_FETCH_BATCH	256
+#define	EMSMDBP_FINDROW_FETCH_BATCH	16
+
+/* Largest ROP output buffer returned without chaining, [MS-OXCRPC] 3.1.4.2 */
+#define	EMSMDBP_ROP_BUFFER_MAX		0x8000
+
 enum emsmdbp_mailbox_systemidx {
 	EMSMDBP_MAILBOX_ROOT = 1,
 	EMSMDBP_DEFERRED_ACTION,
@@ -339,16 +430,24 @@ struct emsmdbp_object *emsmdbp_object_mailbox_init(TALLOC_CTX *, struct emsmdbp_
 struct emsmdbp_object *emsmdbp_object_folder_init(TALLOC_CTX *, struct emsmdbp_context *, uint64_t, struct emsmdbp_object *);
 enum MAPISTATUS      emsmdbp_folder_get_folder_count(struct emsmdbp_context *, struct emsmdbp_object *, uint32_t *);
 enum mapistore_error emsmdbp_folder_delete(struct emsmdbp_context *, struct emsmdbp_object *, uint64_t, uint8_t);
+bool emsmdbp_folder_cn_index_enabled(struct emsmdbp_context *, struct emsmdbp_object *);
+void emsmdbp_folder_drop_cn_index(struct emsmdbp_context *, const char *, uint64_t);
 enum mapistore_error emsmdbp_folder_move_folder(struct emsmdbp_context *, struct emsmdbp_object *, struct emsmdbp_object *, TALLOC_CTX *, const char *);
 struct emsmdbp_object *emsmdbp_folder_open_table(TALLOC_CTX *, struct emsmdbp_object *, uint32_t, uint32_t);
 struct emsmdbp_object *emsmdbp_object_table_init(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
 int emsmdbp_object_table_get_available_properties(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, struct SPropTagArray **);
 void **emsmdbp_object_table_get_row_props(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint32_t, enum mapistore_query_type, enum MAPISTATUS **);
+struct emsmdbp_table_row *emsmdbp_object_table_get_rows_props(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint32_t, uint32_t, enum mapistore_query_type);
 struct emsmdbp_object *emsmdbp_object_message_init(TALLOC_CTX *, struct emsmdbp_context *, uint64_t, struct emsmdbp_object *);
 enum mapistore_error emsmdbp_object_message_open(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint64_t, uint64_t, bool, struct emsmdbp_object **, struct mapistore_message **);
+void emsmdbp_object_message_index_cn(struct emsmdbp_context *, struct emsmdbp_object *);
 struct emsmdbp_object *emsmdbp_object_message_open_attachment_table(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
 struct emsmdbp_object *emsmdbp_object_stream_init(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
 int emsmdbp_object_stream_commit(struct emsmdbp_object *);
+bool emsmdbp_object_stream_open_backend(struct emsmdbp_object *);
+DATA_BLOB emsmdbp_object_stream_read(TALLOC_CTX *, struct emsmdbp_object *, uint32_t);
+enum MAPISTATUS emsmdbp_object_stream_write(struct emsmdbp_object *, DATA_BLOB);
+uint32_t emsmdbp_object_stream_get_size(struct emsmdbp_object *);
 struct emsmdbp_object *emsmdbp_object_attachment_init(TALLOC_CTX *, struct emsmdbp_context *, uint64_t, struct emsmdbp_object *);
 struct emsmdbp_object *emsmdbp_object_subscription_init(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
 int emsmdbp_object_get_available_properties(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, struct SPropTagArray **);
@@ -363,6 +462,26 @@ void emsmdbp_stream_write_buffer(TALLOC_CTX *, struct emsmdbp_stream *, DATA_BLO
 void emsmdbp_fill_table_row_blob(TALLOC_CTX *, struct emsmdbp_context *, DATA_BLOB *, uint16_t, enum MAPITAGS *, void **, enum MAPISTATUS *);
 void emsmdbp_fill_row_blob(TALLOC_CTX *, struct emsmdbp_context *, uint8_t *, DATA_BLOB *,struct SPropTagArray *, void **, enum MAPISTATUS *, bool *);
 
+/* definitions from emsmdbp_syncstream.c */
+void		      emsmdbp_syncstream_set_chunk(struct emsmdbp_syncstream *, DATA_BLOB, uint32_t *, bool);
+DATA_BLOB	      emsmdbp_syncstream_read(TALLOC_CTX *, struct emsmdbp_syncstream *, uint32_t, emsmdbp_syncstream_fill_fn, void *);
+bool		      emsmdbp_syncstream_done(struct emsmdbp_syncstream *);
+
+/* definitions from emsmdbp_async.c */
+struct emsmdbp_async_context *emsmdbp_async_init(struct mapistore_context *);
+enum MAPISTATUS	      emsmdbp_async_wait(TALLOC_CTX *, struct emsmdbp_async_context *, struct tevent_context *, uint32_t, emsmdbp_async_done_fn, void *);
+
+/* definitions from emsmdbp_transaction.c */
+struct emsmdbp_transaction *emsmdbp_transaction_init(TALLOC_CTX *, struct mapi_request *, uint32_t, uint32_t, uint32_t);
+struct EcDoRpc_MAPI_REPL *emsmdbp_transaction_replies(struct emsmdbp_transaction *, uint32_t);
+void		      emsmdbp_transaction_done(struct emsmdbp_transaction *);
+enum MAPISTATUS	      emsmdbp_transaction_get_stats(struct emsmdbp_transaction_stats *);
+
+/* definitions from emsmdbp_rop.c */
+const struct emsmdbp_rop *emsmdbp_rop_lookup(uint8_t);
+uint32_t	      emsmdbp_rop_size(struct mapi_request *);
+enum MAPISTATUS	      emsmdbp_rop_dispatch(TALLOC_CTX *, struct emsmdbp_context *, const struct emsmdbp_rop *, struct EcDoRpc_MAPI_REQ *, struct EcDoRpc_MAPI_REPL *, uint32_t *, uint32_t, uint16_t *);
+
 /* definitions from oxcfold.c */
 enum MAPISTATUS EcDoRpc_RopOpenFolder(TALLOC_CTX *, struct emsmdbp_context *, struct EcDoRpc_MAPI_REQ *, struct EcDoRpc_MAPI_REPL *, uint32_t *, uint16_t *);
 enum MAPISTATUS EcDoRpc_RopGetHierarchyTable(TALLOC_CTX *, struct emsmdbp_context *, struct EcDoRpc_MAPI_REQ *, struct EcDoRpc_MAPI_REPL *, uint32_t *, uint16_t *);
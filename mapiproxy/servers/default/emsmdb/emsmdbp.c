@@ -84,6 +84,43 @@ static int emsmdbp_mapi_handles_destructor(void *data)
 	return (retval == MAPI_E_SUCCESS) ? 0 : -1;
 }
 
+/**
+   \details Open a connection to the samDB database, with its own
+   event context
+
+   \param mem_ctx pointer to the memory context
+   \param private_data pointer to the loadparm context
+
+   \return Allocated ldb context on success, otherwise NULL
+ */
+static void *emsmdbp_samdb_open(TALLOC_CTX *mem_ctx, void *private_data)
+{
+	struct loadparm_context	*lp_ctx = (struct loadparm_context *) private_data;
+	struct tevent_context	*ev;
+	struct ldb_context	*samdb_ctx;
+	const char		*samdb_url;
+
+	ev = tevent_context_init(mem_ctx);
+	if (!ev) return NULL;
+	tevent_loop_allow_nesting(ev);
+
+	samdb_url = lpcfg_parm_string(lp_ctx, NULL, "dcerpc_mapiproxy", "samdb_url");
+	if (!samdb_url) {
+		samdb_ctx = samdb_connect(mem_ctx, ev, lp_ctx, system_session(lp_ctx), 0);
+	} else {
+		samdb_ctx = samdb_connect_url(mem_ctx, ev, lp_ctx, system_session(lp_ctx), 0, samdb_url);
+	}
+	if (!samdb_ctx) {
+		talloc_free(ev);
+		return NULL;
+	}
+
+	/* The connection may outlive the pool entry it was opened for */
+	talloc_steal(samdb_ctx, ev);
+
+	return samdb_ctx;
+}
+
 /**
    \details Initialize the EMSMDBP context and open connections to
    Samba databases.
@@ -101,7 +138,6 @@ _PUBLIC_ struct emsmdbp_context *emsmdbp_init(struct loadparm_context *lp_ctx,
 {
 	TALLOC_CTX		*mem_ctx;
 	struct emsmdbp_context	*emsmdbp_ctx;
-	struct tevent_context	*ev;
 	enum mapistore_error	ret;
 	const char		*samdb_url;
 
@@ -118,24 +154,19 @@ _PUBLIC_ struct emsmdbp_context *emsmdbp_init(struct loadparm_context *lp_ctx,
 
 	emsmdbp_ctx->mem_ctx = mem_ctx;
 
-	ev = tevent_context_init(mem_ctx);
-	if (!ev) {
-		talloc_free(mem_ctx);
-		return NULL;
-	}
-	tevent_loop_allow_nesting(ev); 
-
 	/* Save a pointer to the loadparm context */
 	emsmdbp_ctx->lp_ctx = lp_ctx;
 
 	/* Retrieve samdb url (local or external) */
 	samdb_url = lpcfg_parm_string(lp_ctx, NULL, "dcerpc_mapiproxy", "samdb_url");
 
-	/* return an opaque context pointer on samDB database */
-	if (!samdb_url) {
-		emsmdbp_ctx->samdb_ctx = samdb_connect(mem_ctx, ev, lp_ctx, system_session(lp_ctx), 0);
+	/* return an opaque context pointer on samDB database, shared by
+	   the sessions of the process unless configured otherwise */
+	if (lpcfg_parm_bool(lp_ctx, NULL, "mapiproxy", "shared_backends", true)) {
+		emsmdbp_ctx->samdb_ctx = mpm_shared_get(mem_ctx, "samdb", samdb_url ? samdb_url : "",
+							emsmdbp_samdb_open, lp_ctx);
 	} else {
-		emsmdbp_ctx->samdb_ctx = samdb_connect_url(mem_ctx, ev, lp_ctx, system_session(lp_ctx), 0, samdb_url);
+		emsmdbp_ctx->samdb_ctx = emsmdbp_samdb_open(mem_ctx, lp_ctx);
 	}
 
 	if (!emsmdbp_ctx->samdb_ctx) {
@@ -164,6 +195,14 @@ _PUBLIC_ struct emsmdbp_context *emsmdbp_init(struct loadparm_context *lp_ctx,
 	}
 	talloc_set_destructor((void *)emsmdbp_ctx->mstore_ctx, (int (*)(void *))emsmdbp_mapi_store_destructor);
 
+	/* Initialize the EcDoAsyncWaitEx context, woken by the notifications of the session */
+	emsmdbp_ctx->async_ctx = emsmdbp_async_init(emsmdbp_ctx->mstore_ctx);
+	if (!emsmdbp_ctx->async_ctx) {
+		DEBUG(0, ("[%s:%d]: Async wait context initialization failed\n", __FUNCTION__, __LINE__));
+		talloc_free(mem_ctx);
+		return NULL;
+	}
+
 	/* Initialize MAPI handles context */
 	emsmdbp_ctx->handles_ctx = mapi_handles_init(mem_ctx);
 	if (!emsmdbp_ctx->handles_ctx) {
@@ -173,6 +212,9 @@ _PUBLIC_ struct emsmdbp_context *emsmdbp_init(struct loadparm_context *lp_ctx,
 	}
 	talloc_set_destructor((void *)emsmdbp_ctx->handles_ctx, (int (*)(void *))emsmdbp_mapi_handles_destructor);
 
+	/* Updated by each EcDoRpc/EcDoRpcExt2 call */
+	emsmdbp_ctx->rop_buffer_size = EMSMDBP_ROP_BUFFER_MAX;
+
 	return emsmdbp_ctx;
 }
 
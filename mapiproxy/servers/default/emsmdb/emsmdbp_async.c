@@ -0,0 +1,209 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_async.c
+
+   \brief Parked EcDoAsyncWaitEx calls
+
+   A client waiting for notifications calls EcDoAsyncWaitEx, which
+   only returns when a notification is queued for its session or when
+   the wait times out. The call is not answered from the dispatch
+   function: it is parked on the session with a timer, and completed
+   from the event loop. No worker is held and no CPU is used while the
+   client waits.
+
+   The mapistore notification callback of the session wakes the parked
+   call. It may be invoked while another session is processing its
+   ROPs, so the completion is deferred to a tevent immediate.
+ */
+
+#include "mapiproxy/libmapiserver/libmapiserver.h"
+#include "dcesrv_exchange_emsmdb.h"
+
+
+/**
+   \details Complete a parked wait and release it
+
+   The wait is released before its completion function is called, as
+   the latter usually sends the reply and frees the call owning the
+   wait.
+
+   \param wait pointer to the parked wait
+   \param flags the pulFlagsOut value to return to the client
+   \param retval the status to return to the client
+ */
+static void emsmdbp_async_complete(struct emsmdbp_async_wait *wait, uint32_t flags, enum MAPISTATUS retval)
+{
+	emsmdbp_async_done_fn	done_fn = wait->done_fn;
+	void			*private_data = wait->private_data;
+
+	talloc_free(wait);
+	done_fn(flags, retval, private_data);
+}
+
+static void emsmdbp_async_timeout(struct tevent_context *ev, struct tevent_timer *te,
+				  struct timeval current_time, void *private_data)
+{
+	struct emsmdbp_async_wait	*wait = (struct emsmdbp_async_wait *) private_data;
+
+	wait->timer = NULL;
+	emsmdbp_async_complete(wait, 0, MAPI_E_SUCCESS);
+}
+
+static void emsmdbp_async_wakeup(struct tevent_context *ev, struct tevent_immediate *im,
+				 void *private_data)
+{
+	struct emsmdbp_async_wait	*wait = (struct emsmdbp_async_wait *) private_data;
+
+	emsmdbp_async_complete(wait, EMSMDBP_ASYNC_NOTIFICATION_PENDING, MAPI_E_SUCCESS);
+}
+
+/**
+   \details mapistore notification callback: wake up the parked wait
+   of the session
+ */
+static void emsmdbp_async_notify(struct mapistore_context *mstore_ctx, void *private_data)
+{
+	struct emsmdbp_async_context	*async_ctx = (struct emsmdbp_async_context *) private_data;
+	struct emsmdbp_async_wait	*wait = async_ctx->wait;
+
+	if (!wait) return;
+
+	tevent_schedule_immediate(wait->im, wait->ev, emsmdbp_async_wakeup, wait);
+}
+
+static int emsmdbp_async_wait_destructor(struct emsmdbp_async_wait *wait)
+{
+	if (wait->async_ctx && wait->async_ctx->wait == wait) {
+		wait->async_ctx->wait = NULL;
+	}
+
+	return 0;
+}
+
+/**
+   \details Reject the wait still parked when the session goes away
+ */
+static int emsmdbp_async_context_destructor(struct emsmdbp_async_context *async_ctx)
+{
+	mapistore_set_notification_callback(async_ctx->mstore_ctx, NULL, NULL);
+	if (async_ctx->wait) {
+		emsmdbp_async_complete(async_ctx->wait, 0, ecRejected);
+	}
+
+	return 0;
+}
+
+
+/**
+   \details Initialize the async wait context of a session
+
+   The context is allocated on the mapistore context, so it is released
+   with it and never outlives the notification queue it watches.
+
+   \param mstore_ctx pointer to the mapistore context of the session
+
+   \return Allocated async context on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_async_context *emsmdbp_async_init(struct mapistore_context *mstore_ctx)
+{
+	struct emsmdbp_async_context	*async_ctx;
+	enum mapistore_error		retval;
+
+	if (!mstore_ctx) return NULL;
+
+	async_ctx = talloc_zero(mstore_ctx, struct emsmdbp_async_context);
+	if (!async_ctx) return NULL;
+
+	async_ctx->mstore_ctx = mstore_ctx;
+	async_ctx->wait = NULL;
+
+	retval = mapistore_set_notification_callback(mstore_ctx, emsmdbp_async_notify, async_ctx);
+	if (retval != MAPISTORE_SUCCESS) {
+		talloc_free(async_ctx);
+		return NULL;
+	}
+	talloc_set_destructor(async_ctx, emsmdbp_async_context_destructor);
+
+	return async_ctx;
+}
+
+
+/**
+   \details Park a wait until a notification is queued for the session
+   or the timeout expires
+
+   done_fn is called from the event loop with
+   EMSMDBP_ASYNC_NOTIFICATION_PENDING when a notification is queued,
+   with 0 when the wait times out or is superseded by a new wait of the
+   same session, and with ecRejected when the session is released. The
+   caller checks the notification queue before parking the wait.
+
+   \param mem_ctx pointer to the memory context owning the wait,
+   releasing it cancels the wait
+   \param async_ctx pointer to the async context of the session
+   \param ev pointer to the event context completing the wait
+   \param timeout the number of seconds to wait
+   \param done_fn the completion function
+   \param private_data pointer passed to done_fn
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_async_wait(TALLOC_CTX *mem_ctx,
+					    struct emsmdbp_async_context *async_ctx,
+					    struct tevent_context *ev, uint32_t timeout,
+					    emsmdbp_async_done_fn done_fn, void *private_data)
+{
+	struct emsmdbp_async_wait	*wait;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!async_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!ev, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!done_fn, MAPI_E_INVALID_PARAMETER, NULL);
+
+	wait = talloc_zero(mem_ctx, struct emsmdbp_async_wait);
+	OPENCHANGE_RETVAL_IF(!wait, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	wait->async_ctx = async_ctx;
+	wait->ev = ev;
+	wait->done_fn = done_fn;
+	wait->private_data = private_data;
+	wait->im = tevent_create_immediate(wait);
+	wait->timer = tevent_add_timer(ev, wait, tevent_timeval_current_ofs(timeout, 0),
+				       emsmdbp_async_timeout, wait);
+	if (!wait->im || !wait->timer) {
+		talloc_free(wait);
+		return MAPI_E_NOT_ENOUGH_MEMORY;
+	}
+
+	/* A session has a single outstanding wait */
+	if (async_ctx->wait) {
+		DEBUG(5, ("[%s:%d]: new wait supersedes the parked one\n", __FUNCTION__, __LINE__));
+		emsmdbp_async_complete(async_ctx->wait, 0, MAPI_E_SUCCESS);
+	}
+
+	async_ctx->wait = wait;
+	talloc_set_destructor(wait, emsmdbp_async_wait_destructor);
+
+	return MAPI_E_SUCCESS;
+}
@@ -653,6 +653,15 @@ _PUBLIC_ int emsmdbp_object_stream_commit(struct emsmdbp_object *stream_object)
 	stream = stream_object->object.stream;
 
 	rc = MAPISTORE_SUCCESS;
+	if (stream->backend_stream) {
+		/* Data was written to the backend by chunks */
+		if (stream->needs_commit) {
+			stream->needs_commit = false;
+			rc = mapistore_property_stream_commit(stream->backend_stream);
+		}
+		return rc;
+	}
+
 	if (stream->needs_commit) {
 		stream->needs_commit = false;
 		aRow.cValues = 1;
@@ -686,6 +695,129 @@ _PUBLIC_ int emsmdbp_object_stream_commit(struct emsmdbp_object *stream_object)
 	return rc;
 }
 
+/**
+   \details Open the stream property through the mapistore backend
+   property stream interface, so it can be accessed by chunks instead
+   of being loaded in memory.
+
+   \param stream_object pointer to the stream object, with its
+   property and read_write fields set
+
+   \return true if the backend stream was opened, false if the
+   property has to be loaded with get_properties
+ */
+_PUBLIC_ bool emsmdbp_object_stream_open_backend(struct emsmdbp_object *stream_object)
+{
+	struct emsmdbp_object		*parent;
+	struct emsmdbp_object_stream	*stream;
+	enum mapistore_error		ret;
+
+	if (!stream_object || stream_object->type != EMSMDBP_OBJECT_STREAM) return false;
+
+	parent = stream_object->parent_object;
+	if (!parent || !emsmdbp_is_mapistore(parent) || !parent->backend_object) return false;
+
+	stream = stream_object->object.stream;
+	ret = mapistore_properties_open_stream(stream_object->emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(parent),
+					       parent->backend_object, stream, stream->property, stream->read_write,
+					       &stream->backend_stream);
+	if (ret != MAPISTORE_SUCCESS) {
+		stream->backend_stream = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+   \details Read data from the current position of a stream object and
+   move the position forward
+
+   \param mem_ctx pointer to the memory context holding the returned data
+   \param stream_object pointer to the stream object
+   \param length maximum number of bytes to read
+
+   \return the data read, empty at the end of the stream or on error
+ */
+_PUBLIC_ DATA_BLOB emsmdbp_object_stream_read(TALLOC_CTX *mem_ctx, struct emsmdbp_object *stream_object, uint32_t length)
+{
+	struct emsmdbp_object_stream	*stream;
+	DATA_BLOB			buffer;
+
+	buffer.data = NULL;
+	buffer.length = 0;
+	if (!stream_object || stream_object->type != EMSMDBP_OBJECT_STREAM) return buffer;
+
+	stream = stream_object->object.stream;
+	if (!stream->backend_stream) {
+		return emsmdbp_stream_read_buffer(&stream->stream, length);
+	}
+
+	if (mapistore_property_stream_read(stream->backend_stream, mem_ctx, stream->stream.position, length, &buffer) != MAPISTORE_SUCCESS) {
+		DEBUG(5, ("[%s:%d]: unable to read backend stream at %zu\n", __FUNCTION__, __LINE__, stream->stream.position));
+		buffer.data = NULL;
+		buffer.length = 0;
+	}
+	stream->stream.position += buffer.length;
+
+	return buffer;
+}
+
+/**
+   \details Write data at the current position of a stream object and
+   move the position forward
+
+   \param stream_object pointer to the stream object
+   \param data the data to write
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_object_stream_write(struct emsmdbp_object *stream_object, DATA_BLOB data)
+{
+	struct emsmdbp_object_stream	*stream;
+	enum mapistore_error		ret;
+
+	OPENCHANGE_RETVAL_IF(!stream_object || stream_object->type != EMSMDBP_OBJECT_STREAM, MAPI_E_INVALID_OBJECT, NULL);
+
+	stream = stream_object->object.stream;
+	if (!stream->backend_stream) {
+		emsmdbp_stream_write_buffer(stream, &stream->stream, data);
+		stream->needs_commit = true;
+		return MAPI_E_SUCCESS;
+	}
+
+	ret = mapistore_property_stream_write(stream->backend_stream, stream->stream.position, data);
+	OPENCHANGE_RETVAL_IF(ret != MAPISTORE_SUCCESS, mapistore_error_to_mapi(ret), NULL);
+	stream->stream.position += data.length;
+	stream->needs_commit = true;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Return the size of a stream object
+
+   \param stream_object pointer to the stream object
+
+   \return size of the stream in bytes
+ */
+_PUBLIC_ uint32_t emsmdbp_object_stream_get_size(struct emsmdbp_object *stream_object)
+{
+	struct emsmdbp_object_stream	*stream;
+	uint64_t			size = 0;
+
+	if (!stream_object || stream_object->type != EMSMDBP_OBJECT_STREAM) return 0;
+
+	stream = stream_object->object.stream;
+	if (!stream->backend_stream) {
+		return stream->stream.buffer.length;
+	}
+
+	mapistore_property_stream_get_size(stream->backend_stream, &size);
+	/* StreamSize and positions are 32 bits on the wire */
+	return (size > UINT32_MAX) ? UINT32_MAX : (uint32_t) size;
+}
+
 /**
    \details talloc destructor for emsmdbp_objects
 
@@ -726,7 +858,10 @@ static int emsmdbp_object_destructor(void *data)
                 }
 		break;
 	case EMSMDBP_OBJECT_STREAM:
-		emsmdbp_object_stream_commit(object);
+		/* Backend streams commit their data when they are released */
+		if (!object->object.stream->backend_stream) {
+			emsmdbp_object_stream_commit(object);
+		}
 		break;
         case EMSMDBP_OBJECT_SUBSCRIPTION:
                 if (object->object.subscription->subscription_list) {
@@ -1293,6 +1428,89 @@ _PUBLIC_ enum mapistore_error emsmdbp_folder_move_folder(struct emsmdbp_context
 	return ret;
 }
 
+/**
+   \details Check whether the change number index can be used for the
+   messages of a folder
+
+   Message downloads only cover mapistore folders. Their backends may
+   change messages behind our back, so they are only indexed when
+   "mapistore:cn_index" is set.
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param folder_object pointer to the folder object
+
+   \return true if the index of the folder can be trusted
+ */
+_PUBLIC_ bool emsmdbp_folder_cn_index_enabled(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *folder_object)
+{
+	if (!folder_object || folder_object->type != EMSMDBP_OBJECT_FOLDER) {
+		return false;
+	}
+
+	return (emsmdbp_ctx->mstore_ctx->cn_index && emsmdbp_is_mapistore(folder_object));
+}
+
+/**
+   \details Drop the change number index of a folder
+
+   This is used when messages of the folder change in a way we can't
+   record, the index is rebuilt on the next synchronization.
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param owner the mailbox owner
+   \param fid the folder identifier
+ */
+_PUBLIC_ void emsmdbp_folder_drop_cn_index(struct emsmdbp_context *emsmdbp_ctx, const char *owner, uint64_t fid)
+{
+	mapistore_indexing_set_cn_index_state(emsmdbp_ctx->mstore_ctx, owner, fid, MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_NONE, NULL);
+	mapistore_indexing_set_cn_index_state(emsmdbp_ctx->mstore_ctx, owner, fid, MAPISTORE_FAI_TABLE, MAPISTORE_CN_INDEX_NONE, NULL);
+}
+
+/**
+   \details Record the change number of a saved message in the change
+   number index of its folder
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param message_object pointer to the message object
+ */
+_PUBLIC_ void emsmdbp_object_message_index_cn(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *message_object)
+{
+	TALLOC_CTX			*mem_ctx;
+	struct emsmdbp_object		*folder_object;
+	enum MAPITAGS			props_tags[] = { PidTagChangeNumber, PidTagAssociated };
+	struct SPropTagArray		props;
+	void				**data_pointers;
+	enum MAPISTATUS			*retvals;
+	enum mapistore_table_type	table_type;
+
+	if (!message_object || message_object->type != EMSMDBP_OBJECT_MESSAGE) return;
+
+	folder_object = message_object->parent_object;
+	if (!emsmdbp_folder_cn_index_enabled(emsmdbp_ctx, folder_object)) return;
+
+	mem_ctx = talloc_zero(NULL, TALLOC_CTX);
+	props.cValues = 2;
+	props.aulPropTag = props_tags;
+	data_pointers = emsmdbp_object_get_properties(mem_ctx, emsmdbp_ctx, message_object, &props, &retvals);
+	if (data_pointers && retvals[0] == MAPI_E_SUCCESS) {
+		table_type = MAPISTORE_MESSAGE_TABLE;
+		if (retvals[1] == MAPI_E_SUCCESS && *(uint8_t *) data_pointers[1]) {
+			table_type = MAPISTORE_FAI_TABLE;
+		}
+		mapistore_indexing_record_set_cn(emsmdbp_ctx->mstore_ctx, emsmdbp_get_owner(message_object),
+						 folder_object->object.folder->folderID, table_type,
+						 message_object->object.message->messageID,
+						 *(uint64_t *) data_pointers[0]);
+	}
+	else {
+		DEBUG(5, ("[%s:%d]: no change number for message 0x%.16"PRIx64", dropping the folder index\n",
+			  __FUNCTION__, __LINE__, message_object->object.message->messageID));
+		emsmdbp_folder_drop_cn_index(emsmdbp_ctx, emsmdbp_get_owner(message_object),
+					     folder_object->object.folder->folderID);
+	}
+	talloc_free(mem_ctx);
+}
+
 _PUBLIC_ enum mapistore_error emsmdbp_folder_delete(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *parent_folder, uint64_t fid, uint8_t flags)
 {
 	enum mapistore_error	ret;
@@ -1354,6 +1572,7 @@ _PUBLIC_ enum mapistore_error emsmdbp_folder_delete(struct emsmdbp_context *emsm
 		}
 	}
 
+	emsmdbp_folder_drop_cn_index(emsmdbp_ctx, emsmdbp_get_owner(parent_folder), fid);
 	ret = MAPISTORE_SUCCESS;
 
 end:
@@ -1590,49 +1809,205 @@ _PUBLIC_ int emsmdbp_object_table_get_available_properties(TALLOC_CTX *mem_ctx,
 	return retval;
 }
 
-_PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, enum mapistore_query_type query_type, enum MAPISTATUS **retvalsp)
+static void emsmdbp_object_table_convert_row(uint32_t num_props, struct mapistore_property_data *properties,
+					     void **data_pointers, enum MAPISTATUS *retvals)
 {
-        void				**data_pointers;
-        enum MAPISTATUS			retval;
+	uint32_t	i;
+
+	for (i = 0; i < num_props; i++) {
+		data_pointers[i] = properties[i].data;
+
+		if (properties[i].error != MAPISTORE_SUCCESS) {
+			retvals[i] = mapistore_error_to_mapi(properties[i].error);
+		}
+		else {
+			if (properties[i].data == NULL) {
+				retvals[i] = MAPI_E_NOT_FOUND;
+			}
+		}
+	}
+}
+
+/**
+   \details Retrieve count consecutive rows of a table provided by
+   openchangedb, all the table columns being fetched in a single
+   backend query
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param table_object pointer to the table object
+   \param start index of the first row
+   \param count number of rows to retrieve
+   \param query_type the query type
+   \param parentFolderIdp pointer on the folder identifier of the table
+   \param row_countp pointer on the number of rows returned
+
+   \return Allocated array of rows on success, otherwise NULL
+ */
+static struct openchangedb_table_row *emsmdbp_object_table_get_odb_rows(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t start, uint32_t count, enum mapistore_query_type query_type, uint64_t *parentFolderIdp, uint32_t *row_countp)
+{
+	enum MAPISTATUS			retval;
+	struct emsmdbp_object_table	*table;
+	struct openchangedb_table_row	*odb_rows = NULL;
+	struct SPropTagArray		props;
+
+	table = table_object->object.table;
+
+	if (table_object->parent_object->type == EMSMDBP_OBJECT_FOLDER) {
+		*parentFolderIdp = table_object->parent_object->object.folder->folderID;
+	}
+	else if (table_object->parent_object->type == EMSMDBP_OBJECT_MAILBOX) {
+		*parentFolderIdp = table_object->parent_object->object.mailbox->folderID;
+	}
+	else {
+		DEBUG(5, ("%s: non-mapistore tables can only be client of folder objects\n", __location__));
+		return NULL;
+	}
+
+	switch (table->ulType) {
+	case MAPISTORE_FOLDER_TABLE:
+	case MAPISTORE_MESSAGE_TABLE:
+		break;
+	default:
+		DEBUG(5, ("table type %d not supported for non-mapistore table\n", table->ulType));
+		return NULL;
+	}
+
+	props.cValues = table->prop_count;
+	props.aulPropTag = table->properties;
+	retval = openchangedb_table_get_rows(mem_ctx, emsmdbp_ctx->oc_ctx, table_object->backend_object,
+					     &props, start, count, (query_type == MAPISTORE_LIVEFILTERED_QUERY),
+					     &odb_rows, row_countp);
+	if (retval != MAPI_E_SUCCESS) {
+		return NULL;
+	}
+
+	return odb_rows;
+}
+
+/**
+   \details Complete a row retrieved from openchangedb with the
+   properties which are only known by the row object
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param table_object pointer to the table object
+   \param parentFolderId the folder identifier of the table
+   \param odb_row pointer to the openchangedb row
+   \param retvalsp pointer on the properties return values
+
+   \return the properties data on success, otherwise NULL
+ */
+static void **emsmdbp_object_table_get_odb_row_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint64_t parentFolderId, struct openchangedb_table_row *odb_row, enum MAPISTATUS **retvalsp)
+{
+	void				**data_pointers;
+	enum MAPISTATUS			*retvals;
 	enum mapistore_error		ret;
-        enum MAPISTATUS			*retvals;
-        struct emsmdbp_object_table	*table;
-        struct mapistore_property_data	*properties;
-        uint32_t			contextID, i, num_props;
+	struct emsmdbp_object_table	*table;
 	struct emsmdbp_object		*rowobject;
-	uint64_t			*rowFMId;
-	uint64_t			parentFolderId;
-	bool				mapistore_folder;
+	bool				mapistore_folder = false;
 	void				*odb_ctx;
 	char				*owner;
 	struct Binary_r			*binr;
+	uint32_t			i;
+
+	/* the row does not match the restrictions */
+	if (!odb_row->data) {
+		DEBUG(5, ("%s: invalid object in non-mapistore folder, count set to 0\n", __location__));
+		return NULL;
+	}
+
+	table = table_object->object.table;
+	odb_ctx = talloc_zero(NULL, void);
+
+	/* open the corresponding object */
+	switch (table->ulType) {
+	case MAPISTORE_FOLDER_TABLE:
+		ret = emsmdbp_object_open_folder(odb_ctx, table_object->parent_object->emsmdbp_ctx, table_object->parent_object, odb_row->fmid, &rowobject);
+		if (ret == MAPISTORE_SUCCESS) {
+			mapistore_folder = emsmdbp_is_mapistore(rowobject);
+		}
+		break;
+	case MAPISTORE_MESSAGE_TABLE:
+		ret = emsmdbp_object_message_open(odb_ctx, table_object->parent_object->emsmdbp_ctx, table_object->parent_object, parentFolderId, odb_row->fmid, false, &rowobject, NULL);
+		break;
+	default:
+		OC_ABORT(true, ("Trying open row in unsupported type of table. Table type: %d\n", table->ulType));
+		return NULL;
+	}
+	if (ret != MAPISTORE_SUCCESS) {
+		talloc_free(odb_ctx);
+		return NULL;
+	}
 
-        table = table_object->object.table;
-        num_props = table_object->object.table->prop_count;
+	data_pointers = talloc_steal(mem_ctx, odb_row->data);
+	retvals = talloc_steal(mem_ctx, odb_row->retvals);
+
+	/* a hack to avoid fetching dynamic fields from openchange.ldb */
+	for (i = 0; mapistore_folder && i < table->prop_count; i++) {
+		switch (table->properties[i]) {
+		case PR_CONTENT_COUNT:
+		case PidTagAssociatedContentCount:
+		case PR_CONTENT_UNREAD:
+		case PidTagFolderChildCount:
+		case PR_SUBFOLDERS:
+		case PidTagDeletedCountTotal:
+		case PidTagAccess:
+		case PidTagAccessLevel:
+		case PidTagRights: {
+			struct SPropTagArray props;
+			void **local_data_pointers;
+			enum MAPISTATUS *local_retvals;
+
+			props.cValues = 1;
+			props.aulPropTag = table->properties + i;
+
+			local_data_pointers = emsmdbp_object_get_properties(data_pointers, emsmdbp_ctx, rowobject, &props, &local_retvals);
+			data_pointers[i] = local_data_pointers[0];
+			retvals[i] = local_retvals[0];
+		}
+			break;
+		case PidTagSourceKey:
+			owner = emsmdbp_get_owner(table_object);
+			emsmdbp_source_key_from_fmid(data_pointers, emsmdbp_ctx, owner, rowobject->object.folder->folderID, &binr);
+			data_pointers[i] = binr;
+			retvals[i] = MAPI_E_SUCCESS;
+			break;
+		default:
+			break;
+		}
+	}
+
+	talloc_free(odb_ctx);
 
-	data_pointers = talloc_zero_array(mem_ctx, void *, num_props);
-	OPENCHANGE_RETVAL_IF(data_pointers == NULL, 0, NULL);
-	retvals = talloc_zero_array(mem_ctx, enum MAPISTATUS, num_props);
-	OPENCHANGE_RETVAL_IF(retvals == NULL, 0, NULL);
+	*retvalsp = retvals;
+	return data_pointers;
+}
+
+_PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, enum mapistore_query_type query_type, enum MAPISTATUS **retvalsp)
+{
+        void				**data_pointers;
+	enum mapistore_error		ret;
+        enum MAPISTATUS			*retvals;
+        struct mapistore_property_data	*properties;
+        uint32_t			contextID, num_props, row_count;
+	struct openchangedb_table_row	*odb_rows;
+	uint64_t			parentFolderId;
 
 	if (emsmdbp_is_mapistore(table_object)) {
+		num_props = table_object->object.table->prop_count;
+
+		data_pointers = talloc_zero_array(mem_ctx, void *, num_props);
+		OPENCHANGE_RETVAL_IF(data_pointers == NULL, 0, NULL);
+		retvals = talloc_zero_array(mem_ctx, enum MAPISTATUS, num_props);
+		OPENCHANGE_RETVAL_IF(retvals == NULL, 0, NULL);
+
 		contextID = emsmdbp_get_contextID(table_object);
 		ret = mapistore_table_get_row(emsmdbp_ctx->mstore_ctx, contextID,
 					      table_object->backend_object, data_pointers,
 					      query_type, row_id, &properties);
 		if (ret == MAPISTORE_SUCCESS) {
-			for (i = 0; i < num_props; i++) {
-				data_pointers[i] = properties[i].data;
-                                        
-				if (properties[i].error != MAPISTORE_SUCCESS) {
-					retvals[i] = mapistore_error_to_mapi(properties[i].error);
-				}
-				else {
-					if (properties[i].data == NULL) {
-						retvals[i] = MAPI_E_NOT_FOUND;
-					}
-				}
-			}
+			emsmdbp_object_table_convert_row(num_props, properties, data_pointers, retvals);
 		}
 		else {
 			DEBUG(5, ("%s: invalid object (likely due to a restriction)\n", __location__));
@@ -1641,163 +2016,84 @@ _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct e
 			return NULL;
 		}
 	} else {
-		if (table_object->parent_object->type == EMSMDBP_OBJECT_FOLDER) {
-			parentFolderId = table_object->parent_object->object.folder->folderID;
-		}
-		else if (table_object->parent_object->type == EMSMDBP_OBJECT_MAILBOX) {
-			parentFolderId = table_object->parent_object->object.mailbox->folderID;
-		}
-		else {
-			DEBUG(5, ("%s: non-mapistore tables can only be client of folder objects\n", __location__));
-			talloc_free(retvals);
-			talloc_free(data_pointers);
+		odb_rows = emsmdbp_object_table_get_odb_rows(NULL, emsmdbp_ctx, table_object, row_id, 1, query_type, &parentFolderId, &row_count);
+		if (!odb_rows) {
 			return NULL;
 		}
-
-		odb_ctx = talloc_zero(NULL, void);
-
-		/* Setup table_filter for openchangedb */
-		/* switch (table_object->object.table->ulType) { */
-		/* case MAPISTORE_MESSAGE_TABLE: */
-		/* 	table_filter = talloc_asprintf(odb_ctx, "(&(PidTagParentFolderId=%"PRIu64")(PidTagMessageId=*))", folderID); */
-		/* 	break; */
-		/* case MAPISTORE_FOLDER_TABLE: */
-		/* 	table_filter = talloc_asprintf(odb_ctx, "(&(PidTagParentFolderId=%"PRIu64")(PidTagFolderId=*))", folderID); */
-		/* 	break; */
-		/* default: */
-		/* 	DEBUG(5, ("[%s:%d]: Unsupported table type for openchangedb: %d\n", __FUNCTION__, __LINE__,  */
-		/* 		      table_object->object.table->ulType)); */
-		/* 	talloc_free(retvals); */
-		/* 	talloc_free(data_pointers); */
-		/* 	return NULL; */
-		/* } */
-
-		/* 1. retrieve the object id from odb */
-		switch (table_object->object.table->ulType) {
-		case MAPISTORE_FOLDER_TABLE:
-			retval = openchangedb_table_get_property(odb_ctx, emsmdbp_ctx->oc_ctx, table_object->backend_object, PR_FID, row_id, (query_type == MAPISTORE_LIVEFILTERED_QUERY), (void **) &rowFMId);
-			break;
-		case MAPISTORE_MESSAGE_TABLE:
-			retval = openchangedb_table_get_property(odb_ctx, emsmdbp_ctx->oc_ctx, table_object->backend_object, PR_MID, row_id, (query_type == MAPISTORE_LIVEFILTERED_QUERY), (void **) &rowFMId);
-			break;
-			/* case MAPISTORE_FAI_TABLE: 
-			   retval = openchangedb_table_get_property(odb_ctx, table_object->backend_object, emsmdbp_ctx->oc_ctx,
-			   PR_MID, row_id, (query_type == MAPISTORE_LIVEFILTERED_QUERY), (void **) &rowFMId);
-			   break; */
-		default:
-			DEBUG(5, ("table type %d not supported for non-mapistore table\n", table_object->object.table->ulType));
-			retval = MAPI_E_INVALID_OBJECT;
-		}
-		/* printf("openchangedb_table_get_property retval = 0x%.8x\n", retval); */
-		if (retval != MAPI_E_SUCCESS) {
-			talloc_free(retvals);
-			talloc_free(data_pointers);
-			talloc_free(odb_ctx);
+		data_pointers = emsmdbp_object_table_get_odb_row_props(mem_ctx, emsmdbp_ctx, table_object, parentFolderId, odb_rows, &retvals);
+		talloc_free(odb_rows);
+		if (!data_pointers) {
 			return NULL;
 		}
+	}
 
-		/* 2. open the corresponding object */
-		switch (table_object->object.table->ulType) {
-		case MAPISTORE_FOLDER_TABLE:
-			ret = emsmdbp_object_open_folder(odb_ctx, table_object->parent_object->emsmdbp_ctx, table_object->parent_object, *(uint64_t *)rowFMId, &rowobject);
-			if (ret == MAPISTORE_SUCCESS) {
-				mapistore_folder = emsmdbp_is_mapistore(rowobject);
-				if (mapistore_folder) {
-					contextID = emsmdbp_get_contextID(rowobject);
-				}
-			}
-			break;
-		case MAPISTORE_MESSAGE_TABLE:
-			ret = emsmdbp_object_message_open(odb_ctx, table_object->parent_object->emsmdbp_ctx, table_object->parent_object, parentFolderId, *(uint64_t *)rowFMId, false, &rowobject, NULL);
-			mapistore_folder = false;
-			break;
-		default:
-			OC_ABORT(true, ("Trying open row in unsupported type of table. Table type: %d\n", table_object->object.table->ulType));
-			return NULL;
-		}
-		if (ret != MAPISTORE_SUCCESS) {
-			talloc_free(retvals);
-			talloc_free(data_pointers);
-			talloc_free(odb_ctx);
-			return NULL;
-		}
+        if (retvalsp) {
+                *retvalsp = retvals;
+	}
 
-		/* read the row properties */
-                retval = MAPI_E_SUCCESS;
-		for (i = 0; retval != MAPI_E_INVALID_OBJECT && i < num_props; i++) {
-			if (mapistore_folder) {
-				/* a hack to avoid fetching dynamic fields from openchange.ldb */
-				switch (table->properties[i]) {
-				case PR_CONTENT_COUNT:
-				case PidTagAssociatedContentCount:
-				case PR_CONTENT_UNREAD:
-				case PidTagFolderChildCount:
-				case PR_SUBFOLDERS:
-				case PidTagDeletedCountTotal:
-				case PidTagAccess:
-				case PidTagAccessLevel:
-				case PidTagRights: {
-					struct SPropTagArray props;
-					void **local_data_pointers;
-					enum MAPISTATUS *local_retvals;
-
-					props.cValues = 1;
-					props.aulPropTag = table->properties + i;
-
-					local_data_pointers = emsmdbp_object_get_properties(data_pointers, emsmdbp_ctx, rowobject, &props, &local_retvals);
-					data_pointers[i] = local_data_pointers[0];
-					retvals[i] = local_retvals[0];
-				}
-					break;
-				case PidTagSourceKey:
-					owner = emsmdbp_get_owner(table_object);
-					emsmdbp_source_key_from_fmid(data_pointers, emsmdbp_ctx, owner, rowobject->object.folder->folderID, &binr);
-					data_pointers[i] = binr;
-					retval = MAPI_E_SUCCESS;
-					break;
-				default:
-					retval = openchangedb_table_get_property(data_pointers, emsmdbp_ctx->oc_ctx,
-										 table_object->backend_object,
-										 table->properties[i], 
-										 row_id,
-										 (query_type == MAPISTORE_LIVEFILTERED_QUERY),
-										 data_pointers + i);
-					/* retval = openchangedb_get_table_property(data_pointers, emsmdbp_ctx->oc_ctx,  */
-					/* 					 emsmdbp_ctx->username, */
-					/* 					 table_filter, table->properties[i],  */
-					/* 					 row_id, data_pointers + i); */
-				}
-			}
-			else {
-				retval = openchangedb_table_get_property(data_pointers, emsmdbp_ctx->oc_ctx,
-									 table_object->backend_object,
-									 table->properties[i], 
-									 row_id,
-									 (query_type == MAPISTORE_LIVEFILTERED_QUERY),
-									 data_pointers + i);
-			}
+        return data_pointers;
+}
 
-			/* DEBUG(5, ("  %.8x: %d", table->properties[j], retval)); */
-			if (retval == MAPI_E_INVALID_OBJECT) {
-				DEBUG(5, ("%s: invalid object in non-mapistore folder, count set to 0\n", __location__));
-				talloc_free(retvals);
-				talloc_free(data_pointers);
-				talloc_free(odb_ctx);
-				return NULL;
-			}
-			else {
-				retvals[i] = retval;
-			}
+/**
+   \details Retrieve the properties of count consecutive rows of a
+   table in a single backend call
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param table_object pointer to the table object
+   \param start index of the first row
+   \param count number of rows to retrieve
+   \param query_type the query type
+
+   \return Allocated array of count rows on success, otherwise
+   NULL. Rows which could not be fetched have NULL data_pointers.
+ */
+_PUBLIC_ struct emsmdbp_table_row *emsmdbp_object_table_get_rows_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t start, uint32_t count, enum mapistore_query_type query_type)
+{
+	struct emsmdbp_table_row	*rows;
+	struct mapistore_property_data	**properties;
+	struct openchangedb_table_row	*odb_rows;
+	enum mapistore_error		ret;
+	uint64_t			parentFolderId;
+	uint32_t			num_props, row_count, i;
+
+	rows = talloc_zero_array(mem_ctx, struct emsmdbp_table_row, count);
+	if (!rows) return NULL;
+
+	if (!emsmdbp_is_mapistore(table_object)) {
+		odb_rows = emsmdbp_object_table_get_odb_rows(rows, emsmdbp_ctx, table_object, start, count, query_type, &parentFolderId, &row_count);
+		if (!odb_rows) {
+			return rows;
 		}
+		for (i = 0; i < row_count; i++) {
+			rows[i].data_pointers = emsmdbp_object_table_get_odb_row_props(rows, emsmdbp_ctx, table_object, parentFolderId, odb_rows + i, &rows[i].retvals);
+		}
+		talloc_free(odb_rows);
+		return rows;
+	}
 
-		talloc_free(odb_ctx);
+	ret = mapistore_table_get_rows(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(table_object),
+				       table_object->backend_object, rows, query_type, start, count, &properties);
+	if (ret != MAPISTORE_SUCCESS) {
+		DEBUG(5, ("%s: mapistore_table_get_rows: %s\n", __location__, mapistore_errstr(ret)));
+		talloc_free(rows);
+		return NULL;
 	}
 
-        if (retvalsp) {
-                *retvalsp = retvals;
+	num_props = table_object->object.table->prop_count;
+	for (i = 0; i < count; i++) {
+		if (!properties[i]) continue;
+
+		rows[i].data_pointers = talloc_zero_array(rows, void *, num_props);
+		rows[i].retvals = talloc_zero_array(rows, enum MAPISTATUS, num_props);
+		if (!rows[i].data_pointers || !rows[i].retvals) {
+			talloc_free(rows);
+			return NULL;
+		}
+		emsmdbp_object_table_convert_row(num_props, properties[i], rows[i].data_pointers, rows[i].retvals);
 	}
 
-        return data_pointers;
+	return rows;
 }
 
 _PUBLIC_ void emsmdbp_fill_table_row_blob(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx,
@@ -2858,6 +3154,20 @@ _PUBLIC_ void emsmdbp_fill_row_blob(TALLOC_CTX *mem_ctx,
         }
 }
 
+/**
+   \details Build the stream data of a property value. The data is
+   copied, so it does not keep the memory of the value allocated: the
+   value usually lives on the memory of the ROP transaction while the
+   stream data lives as long as the object it is attached to.
+
+   \param mem_ctx pointer to the memory context, the object keeping
+   the stream data
+   \param prop_tag the property tag of the value
+   \param value pointer to the property value
+   \param read_write whether the stream data can be written to
+
+   \return Allocated stream data on success, otherwise NULL
+ */
 _PUBLIC_ struct emsmdbp_stream_data *emsmdbp_stream_data_from_value(TALLOC_CTX *mem_ctx, enum MAPITAGS prop_tag, void *value, bool read_write)
 {
 	uint16_t			prop_type;
@@ -2869,8 +3179,7 @@ _PUBLIC_ struct emsmdbp_stream_data *emsmdbp_stream_data_from_value(TALLOC_CTX *
 	prop_type = prop_tag & 0xffff;
 	if (prop_type == PT_STRING8) {
 		stream_data->data.length = strlen(value) + 1;
-		stream_data->data.data = value;
-                (void) talloc_reference(stream_data, stream_data->data.data);
+		stream_data->data.data = talloc_memdup(stream_data, value, stream_data->data.length);
 	}
 	else if (prop_type == PT_UNICODE) {
 		stream_data->data.length = strlen_m_ext((char *) value, CH_UTF8, CH_UTF16LE) * 2;
@@ -2884,7 +3193,6 @@ _PUBLIC_ struct emsmdbp_stream_data *emsmdbp_stream_data_from_value(TALLOC_CTX *
 	else if (prop_type == PT_BINARY) {
 		stream_data->data.length = ((struct Binary_r *) value)->cb;
 		stream_data->data.data = talloc_memdup(stream_data, ((struct Binary_r *) value)->lpb, stream_data->data.length);
-                (void) talloc_reference(stream_data, value);
 	}
 	else {
 		talloc_free(stream_data);
@@ -2991,15 +3299,13 @@ _PUBLIC_ struct emsmdbp_object *emsmdbp_object_synccontext_init(TALLOC_CTX *mem_
         synccontext_object->object.synccontext->state_property = 0;
         synccontext_object->object.synccontext->state_stream.buffer.length = 0;
         synccontext_object->object.synccontext->state_stream.buffer.data = talloc_zero(synccontext_object->object.synccontext, uint8_t);
-        synccontext_object->object.synccontext->stream.buffer.length = 0;
-        synccontext_object->object.synccontext->stream.buffer.data = NULL;
+        synccontext_object->object.synccontext->download.chunk.buffer.length = 0;
+        synccontext_object->object.synccontext->download.chunk.buffer.data = NULL;
 
 	synccontext_object->object.synccontext->cnset_seen = talloc_zero(emsmdbp_ctx, struct idset);
 	openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, emsmdbp_ctx->username, NULL, &synccontext_object->object.synccontext->cnset_seen->repl.guid);
 	synccontext_object->object.synccontext->cnset_seen->ranges = talloc_zero(synccontext_object->object.synccontext->cnset_seen, struct globset_range);
 	synccontext_object->object.synccontext->cnset_seen->range_count = 1;
-	synccontext_object->object.synccontext->cnset_seen->ranges->next = NULL;
-	synccontext_object->object.synccontext->cnset_seen->ranges->prev = synccontext_object->object.synccontext->cnset_seen->ranges;
 	synccontext_object->object.synccontext->cnset_seen->ranges->low = 0xffffffffffffffffLL;
 	synccontext_object->object.synccontext->cnset_seen->ranges->high = 0x0;
 
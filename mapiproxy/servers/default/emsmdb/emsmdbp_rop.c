@@ -0,0 +1,327 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_rop.c
+
+   \brief ROP dispatch table
+
+   Every ROP implemented by the server has an entry in a table indexed
+   by opnum, with its handler, the handle indexes it uses and the
+   estimator of the memory needed to build its reply. Opnums without
+   entry, and requests referencing a handle index outside the handle
+   array, get an error reply from emsmdbp_rop_dispatch() without
+   reaching any handler.
+
+   The requests of the ROPs opening an object or copying to a
+   destination object carry a second handle index, which is checked as
+   well. Their entry has an accessor returning it from the request.
+ */
+
+#include "mapiproxy/libmapiserver/libmapiserver.h"
+#include "dcesrv_exchange_emsmdb.h"
+
+
+/* RopRelease has no reply */
+static enum MAPISTATUS emsmdbp_rop_release(TALLOC_CTX *mem_ctx,
+					   struct emsmdbp_context *emsmdbp_ctx,
+					   struct EcDoRpc_MAPI_REQ *mapi_req,
+					   struct EcDoRpc_MAPI_REPL *mapi_repl,
+					   uint32_t *handles, uint16_t *size)
+{
+	return EcDoRpc_RopRelease(mem_ctx, emsmdbp_ctx, mapi_req, handles, size);
+}
+
+static uint32_t emsmdbp_rop_size_small(struct EcDoRpc_MAPI_REQ *mapi_req)
+{
+	return EMSMDBP_ROP_SIZE_SMALL;
+}
+
+static uint32_t emsmdbp_rop_size_QueryRows(struct EcDoRpc_MAPI_REQ *mapi_req)
+{
+	return EMSMDBP_ROP_SIZE_DEFAULT + mapi_req->u.mapi_QueryRows.RowCount * EMSMDBP_ROP_SIZE_PER_ROW;
+}
+
+static uint32_t emsmdbp_rop_size_ReadStream(struct EcDoRpc_MAPI_REQ *mapi_req)
+{
+	struct ReadStream_req	*request = &mapi_req->u.mapi_ReadStream;
+
+	if (request->ByteCount == 0xBABE) {
+		return EMSMDBP_ROP_SIZE_DEFAULT + request->MaximumByteCount.value;
+	}
+
+	return EMSMDBP_ROP_SIZE_DEFAULT + request->ByteCount;
+}
+
+static uint32_t emsmdbp_rop_size_FastTransferSourceGetBuffer(struct EcDoRpc_MAPI_REQ *mapi_req)
+{
+	struct FastTransferSourceGetBuffer_req	*request = &mapi_req->u.mapi_FastTransferSourceGetBuffer;
+
+	if (request->BufferSize == 0xBABE) {
+		return EMSMDBP_ROP_SIZE_DEFAULT + request->MaximumBufferSize.MaximumBufferSize;
+	}
+
+	return EMSMDBP_ROP_SIZE_DEFAULT + request->BufferSize;
+}
+
+/* Accessors of the second handle index of a request */
+#define	EMSMDBP_ROP_HANDLE_IDX(rop)						\
+static uint8_t *emsmdbp_rop_handle_idx_##rop(struct EcDoRpc_MAPI_REQ *mapi_req)	\
+{										\
+	return &mapi_req->u.mapi_##rop.handle_idx;				\
+}
+
+EMSMDBP_ROP_HANDLE_IDX(OpenFolder)
+EMSMDBP_ROP_HANDLE_IDX(OpenMessage)
+EMSMDBP_ROP_HANDLE_IDX(GetHierarchyTable)
+EMSMDBP_ROP_HANDLE_IDX(GetContentsTable)
+EMSMDBP_ROP_HANDLE_IDX(CreateMessage)
+EMSMDBP_ROP_HANDLE_IDX(SaveChangesMessage)
+EMSMDBP_ROP_HANDLE_IDX(SetMessageReadFlag)
+EMSMDBP_ROP_HANDLE_IDX(CreateFolder)
+EMSMDBP_ROP_HANDLE_IDX(GetAttachmentTable)
+EMSMDBP_ROP_HANDLE_IDX(OpenAttach)
+EMSMDBP_ROP_HANDLE_IDX(CreateAttach)
+EMSMDBP_ROP_HANDLE_IDX(SaveChangesAttachment)
+EMSMDBP_ROP_HANDLE_IDX(RegisterNotification)
+EMSMDBP_ROP_HANDLE_IDX(OpenStream)
+EMSMDBP_ROP_HANDLE_IDX(MoveCopyMessages)
+EMSMDBP_ROP_HANDLE_IDX(MoveFolder)
+EMSMDBP_ROP_HANDLE_IDX(CopyFolder)
+EMSMDBP_ROP_HANDLE_IDX(CopyTo)
+EMSMDBP_ROP_HANDLE_IDX(GetPermissionsTable)
+EMSMDBP_ROP_HANDLE_IDX(GetRulesTable)
+EMSMDBP_ROP_HANDLE_IDX(OpenEmbeddedMessage)
+EMSMDBP_ROP_HANDLE_IDX(FastTransferSourceCopyTo)
+EMSMDBP_ROP_HANDLE_IDX(SyncConfigure)
+EMSMDBP_ROP_HANDLE_IDX(SyncImportMessageChange)
+EMSMDBP_ROP_HANDLE_IDX(SyncOpenCollector)
+EMSMDBP_ROP_HANDLE_IDX(SyncGetTransferState)
+
+static const struct emsmdbp_rop emsmdbp_rops[EMSMDBP_ROP_OPNUMS] = {
+	[op_MAPI_Release]			= { op_MAPI_Release, "Release", emsmdbp_rop_release, EMSMDBP_ROP_HANDLE_IN | EMSMDBP_ROP_NO_REPLY, emsmdbp_rop_size_small },
+	[op_MAPI_OpenFolder]			= { op_MAPI_OpenFolder, "OpenFolder", EcDoRpc_RopOpenFolder, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_OpenFolder },
+	[op_MAPI_OpenMessage]			= { op_MAPI_OpenMessage, "OpenMessage", EcDoRpc_RopOpenMessage, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_OpenMessage },
+	[op_MAPI_GetHierarchyTable]		= { op_MAPI_GetHierarchyTable, "GetHierarchyTable", EcDoRpc_RopGetHierarchyTable, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_GetHierarchyTable },
+	[op_MAPI_GetContentsTable]		= { op_MAPI_GetContentsTable, "GetContentsTable", EcDoRpc_RopGetContentsTable, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_GetContentsTable },
+	[op_MAPI_CreateMessage]			= { op_MAPI_CreateMessage, "CreateMessage", EcDoRpc_RopCreateMessage, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_CreateMessage },
+	[op_MAPI_GetProps]			= { op_MAPI_GetProps, "GetProps", EcDoRpc_RopGetPropertiesSpecific, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetPropsAll]			= { op_MAPI_GetPropsAll, "GetPropsAll", EcDoRpc_RopGetPropertiesAll, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetPropList]			= { op_MAPI_GetPropList, "GetPropList", EcDoRpc_RopGetPropertiesList, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SetProps]			= { op_MAPI_SetProps, "SetProps", EcDoRpc_RopSetProperties, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_DeleteProps]			= { op_MAPI_DeleteProps, "DeleteProps", EcDoRpc_RopDeleteProperties, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SaveChangesMessage]		= { op_MAPI_SaveChangesMessage, "SaveChangesMessage", EcDoRpc_RopSaveChangesMessage, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_SaveChangesMessage },
+	[op_MAPI_RemoveAllRecipients]		= { op_MAPI_RemoveAllRecipients, "RemoveAllRecipients", EcDoRpc_RopRemoveAllRecipients, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_ModifyRecipients]		= { op_MAPI_ModifyRecipients, "ModifyRecipients", EcDoRpc_RopModifyRecipients, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_ReloadCachedInformation]	= { op_MAPI_ReloadCachedInformation, "ReloadCachedInformation", EcDoRpc_RopReloadCachedInformation, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SetMessageReadFlag]		= { op_MAPI_SetMessageReadFlag, "SetMessageReadFlag", EcDoRpc_RopSetMessageReadFlag, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_SetMessageReadFlag },
+	[op_MAPI_SetColumns]			= { op_MAPI_SetColumns, "SetColumns", EcDoRpc_RopSetColumns, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SortTable]			= { op_MAPI_SortTable, "SortTable", EcDoRpc_RopSortTable, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_Restrict]			= { op_MAPI_Restrict, "Restrict", EcDoRpc_RopRestrict, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_QueryRows]			= { op_MAPI_QueryRows, "QueryRows", EcDoRpc_RopQueryRows, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_QueryRows },
+	[op_MAPI_QueryPosition]			= { op_MAPI_QueryPosition, "QueryPosition", EcDoRpc_RopQueryPosition, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_SeekRow]			= { op_MAPI_SeekRow, "SeekRow", EcDoRpc_RopSeekRow, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_CreateFolder]			= { op_MAPI_CreateFolder, "CreateFolder", EcDoRpc_RopCreateFolder, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_CreateFolder },
+	[op_MAPI_DeleteFolder]			= { op_MAPI_DeleteFolder, "DeleteFolder", EcDoRpc_RopDeleteFolder, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_DeleteMessages]		= { op_MAPI_DeleteMessages, "DeleteMessages", EcDoRpc_RopDeleteMessages, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetMessageStatus]		= { op_MAPI_GetMessageStatus, "GetMessageStatus", EcDoRpc_RopGetMessageStatus, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetAttachmentTable]		= { op_MAPI_GetAttachmentTable, "GetAttachmentTable", EcDoRpc_RopGetAttachmentTable, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_GetAttachmentTable },
+	[op_MAPI_OpenAttach]			= { op_MAPI_OpenAttach, "OpenAttach", EcDoRpc_RopOpenAttach, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_OpenAttach },
+	[op_MAPI_CreateAttach]			= { op_MAPI_CreateAttach, "CreateAttach", EcDoRpc_RopCreateAttach, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_CreateAttach },
+	[op_MAPI_SaveChangesAttachment]		= { op_MAPI_SaveChangesAttachment, "SaveChangesAttachment", EcDoRpc_RopSaveChangesAttachment, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_SaveChangesAttachment },
+	[op_MAPI_SetReceiveFolder]		= { op_MAPI_SetReceiveFolder, "SetReceiveFolder", EcDoRpc_RopSetReceiveFolder, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetReceiveFolder]		= { op_MAPI_GetReceiveFolder, "GetReceiveFolder", EcDoRpc_RopGetReceiveFolder, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_RegisterNotification]		= { op_MAPI_RegisterNotification, "RegisterNotification", EcDoRpc_RopRegisterNotification, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_RegisterNotification },
+	[op_MAPI_OpenStream]			= { op_MAPI_OpenStream, "OpenStream", EcDoRpc_RopOpenStream, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_OpenStream },
+	[op_MAPI_ReadStream]			= { op_MAPI_ReadStream, "ReadStream", EcDoRpc_RopReadStream, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_ReadStream },
+	[op_MAPI_WriteStream]			= { op_MAPI_WriteStream, "WriteStream", EcDoRpc_RopWriteStream, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SeekStream]			= { op_MAPI_SeekStream, "SeekStream", EcDoRpc_RopSeekStream, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_SetStreamSize]			= { op_MAPI_SetStreamSize, "SetStreamSize", EcDoRpc_RopSetStreamSize, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_SetSearchCriteria]		= { op_MAPI_SetSearchCriteria, "SetSearchCriteria", EcDoRpc_RopSetSearchCriteria, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetSearchCriteria]		= { op_MAPI_GetSearchCriteria, "GetSearchCriteria", EcDoRpc_RopGetSearchCriteria, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SubmitMessage]			= { op_MAPI_SubmitMessage, "SubmitMessage", EcDoRpc_RopSubmitMessage, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_MoveCopyMessages]		= { op_MAPI_MoveCopyMessages, "MoveCopyMessages", EcDoRpc_RopMoveCopyMessages, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_MoveCopyMessages },
+	[op_MAPI_MoveFolder]			= { op_MAPI_MoveFolder, "MoveFolder", EcDoRpc_RopMoveFolder, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_MoveFolder },
+	[op_MAPI_CopyFolder]			= { op_MAPI_CopyFolder, "CopyFolder", EcDoRpc_RopCopyFolder, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_CopyFolder },
+	[op_MAPI_CopyTo]			= { op_MAPI_CopyTo, "CopyTo", EcDoRpc_RopCopyTo, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_CopyTo },
+	[op_MAPI_GetPermissionsTable]		= { op_MAPI_GetPermissionsTable, "GetPermissionsTable", EcDoRpc_RopGetPermissionsTable, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_GetPermissionsTable },
+	[op_MAPI_GetRulesTable]			= { op_MAPI_GetRulesTable, "GetRulesTable", EcDoRpc_RopGetRulesTable, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_GetRulesTable },
+	[op_MAPI_ModifyPermissions]		= { op_MAPI_ModifyPermissions, "ModifyPermissions", EcDoRpc_RopModifyPermissions, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_ModifyRules]			= { op_MAPI_ModifyRules, "ModifyRules", EcDoRpc_RopModifyRules, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_LongTermIdFromId]		= { op_MAPI_LongTermIdFromId, "LongTermIdFromId", EcDoRpc_RopLongTermIdFromId, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_IdFromLongTermId]		= { op_MAPI_IdFromLongTermId, "IdFromLongTermId", EcDoRpc_RopIdFromLongTermId, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_OpenEmbeddedMessage]		= { op_MAPI_OpenEmbeddedMessage, "OpenEmbeddedMessage", EcDoRpc_RopOpenEmbeddedMessage, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_OpenEmbeddedMessage },
+	[op_MAPI_SetSpooler]			= { op_MAPI_SetSpooler, "SetSpooler", EcDoRpc_RopSetSpooler, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_AddressTypes]			= { op_MAPI_AddressTypes, "AddressTypes", EcDoRpc_RopGetAddressTypes, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_TransportSend]			= { op_MAPI_TransportSend, "TransportSend", EcDoRpc_RopTransportSend, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_FastTransferSourceCopyTo]	= { op_MAPI_FastTransferSourceCopyTo, "FastTransferSourceCopyTo", EcDoRpc_RopFastTransferSourceCopyTo, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_FastTransferSourceCopyTo },
+	[op_MAPI_FastTransferSourceGetBuffer]	= { op_MAPI_FastTransferSourceGetBuffer, "FastTransferSourceGetBuffer", EcDoRpc_RopFastTransferSourceGetBuffer, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_FastTransferSourceGetBuffer },
+	[op_MAPI_FindRow]			= { op_MAPI_FindRow, "FindRow", EcDoRpc_RopFindRow, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetNamesFromIDs]		= { op_MAPI_GetNamesFromIDs, "GetNamesFromIDs", EcDoRpc_RopGetNamesFromIDs, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetIDsFromNames]		= { op_MAPI_GetIDsFromNames, "GetIDsFromNames", EcDoRpc_RopGetPropertyIdsFromNames, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_EmptyFolder]			= { op_MAPI_EmptyFolder, "EmptyFolder", EcDoRpc_RopEmptyFolder, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_CommitStream]			= { op_MAPI_CommitStream, "CommitStream", EcDoRpc_RopCommitStream, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_GetStreamSize]			= { op_MAPI_GetStreamSize, "GetStreamSize", EcDoRpc_RopGetStreamSize, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_GetPerUserLongTermIds]		= { op_MAPI_GetPerUserLongTermIds, "GetPerUserLongTermIds", EcDoRpc_RopGetPerUserLongTermIds, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetPerUserGuid]		= { op_MAPI_GetPerUserGuid, "GetPerUserGuid", EcDoRpc_RopGetPerUserGuid, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_ReadPerUserInformation]	= { op_MAPI_ReadPerUserInformation, "ReadPerUserInformation", EcDoRpc_RopReadPerUserInformation, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetReceiveFolderTable]		= { op_MAPI_GetReceiveFolderTable, "GetReceiveFolderTable", EcDoRpc_RopGetReceiveFolderTable, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetTransportFolder]		= { op_MAPI_GetTransportFolder, "GetTransportFolder", EcDoRpc_RopGetTransportFolder, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_OptionsData]			= { op_MAPI_OptionsData, "OptionsData", EcDoRpc_RopOptionsData, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SyncConfigure]			= { op_MAPI_SyncConfigure, "SyncConfigure", EcDoRpc_RopSyncConfigure, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_SyncConfigure },
+	[op_MAPI_SyncImportMessageChange]	= { op_MAPI_SyncImportMessageChange, "SyncImportMessageChange", EcDoRpc_RopSyncImportMessageChange, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_SyncImportMessageChange },
+	[op_MAPI_SyncImportHierarchyChange]	= { op_MAPI_SyncImportHierarchyChange, "SyncImportHierarchyChange", EcDoRpc_RopSyncImportHierarchyChange, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SyncImportDeletes]		= { op_MAPI_SyncImportDeletes, "SyncImportDeletes", EcDoRpc_RopSyncImportDeletes, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SyncUploadStateStreamBegin]	= { op_MAPI_SyncUploadStateStreamBegin, "SyncUploadStateStreamBegin", EcDoRpc_RopSyncUploadStateStreamBegin, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SyncUploadStateStreamContinue]	= { op_MAPI_SyncUploadStateStreamContinue, "SyncUploadStateStreamContinue", EcDoRpc_RopSyncUploadStateStreamContinue, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SyncUploadStateStreamEnd]	= { op_MAPI_SyncUploadStateStreamEnd, "SyncUploadStateStreamEnd", EcDoRpc_RopSyncUploadStateStreamEnd, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SyncImportMessageMove]		= { op_MAPI_SyncImportMessageMove, "SyncImportMessageMove", EcDoRpc_RopSyncImportMessageMove, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_DeletePropertiesNoReplicate]	= { op_MAPI_DeletePropertiesNoReplicate, "DeletePropertiesNoReplicate", EcDoRpc_RopDeletePropertiesNoReplicate, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_GetStoreState]			= { op_MAPI_GetStoreState, "GetStoreState", EcDoRpc_RopGetStoreState, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_SyncOpenCollector]		= { op_MAPI_SyncOpenCollector, "SyncOpenCollector", EcDoRpc_RopSyncOpenCollector, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_SyncOpenCollector },
+	[op_MAPI_GetLocalReplicaIds]		= { op_MAPI_GetLocalReplicaIds, "GetLocalReplicaIds", EcDoRpc_RopGetLocalReplicaIds, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_SyncImportReadStateChanges]	= { op_MAPI_SyncImportReadStateChanges, "SyncImportReadStateChanges", EcDoRpc_RopSyncImportReadStateChanges, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_ResetTable]			= { op_MAPI_ResetTable, "ResetTable", EcDoRpc_RopResetTable, EMSMDBP_ROP_HANDLE_IN, emsmdbp_rop_size_small },
+	[op_MAPI_SyncGetTransferState]		= { op_MAPI_SyncGetTransferState, "SyncGetTransferState", EcDoRpc_RopSyncGetTransferState, EMSMDBP_ROP_HANDLE_IN, NULL, emsmdbp_rop_handle_idx_SyncGetTransferState },
+	[op_MAPI_SetLocalReplicaMidsetDeleted]	= { op_MAPI_SetLocalReplicaMidsetDeleted, "SetLocalReplicaMidsetDeleted", EcDoRpc_RopSetLocalReplicaMidsetDeleted, EMSMDBP_ROP_HANDLE_IN, NULL },
+	[op_MAPI_Logon]				= { op_MAPI_Logon, "Logon", EcDoRpc_RopLogon, EMSMDBP_ROP_HANDLE_IN, NULL },
+};
+
+
+/**
+   \details Return the dispatch table entry of a ROP
+
+   \param opnum the ROP opnum
+
+   \return Pointer to the table entry, NULL if the ROP is not
+   implemented
+ */
+_PUBLIC_ const struct emsmdbp_rop *emsmdbp_rop_lookup(uint8_t opnum)
+{
+	if (!emsmdbp_rops[opnum].handler) return NULL;
+
+	return &emsmdbp_rops[opnum];
+}
+
+
+/**
+   \details Estimate the memory needed to process the ROPs of a request
+   and build their replies
+
+   \param mapi_request pointer to the request
+
+   \return estimated size in bytes, never above
+   EMSMDBP_TRANSACTION_POOL_MAX
+ */
+_PUBLIC_ uint32_t emsmdbp_rop_size(struct mapi_request *mapi_request)
+{
+	const struct emsmdbp_rop	*rop;
+	uint32_t			size = 0;
+	uint32_t			i;
+
+	if (!mapi_request || !mapi_request->mapi_req || mapi_request->mapi_len <= 2) return 0;
+
+	for (i = 0; mapi_request->mapi_req[i].opnum != 0 && size < EMSMDBP_TRANSACTION_POOL_MAX; i++) {
+		rop = emsmdbp_rop_lookup(mapi_request->mapi_req[i].opnum);
+		if (!rop) {
+			size += EMSMDBP_ROP_SIZE_SMALL;
+		} else if (rop->size_fn) {
+			size += rop->size_fn(&mapi_request->mapi_req[i]);
+		} else {
+			size += EMSMDBP_ROP_SIZE_DEFAULT;
+		}
+	}
+
+	return (size < EMSMDBP_TRANSACTION_POOL_MAX) ? size : EMSMDBP_TRANSACTION_POOL_MAX;
+}
+
+
+/**
+   \details Process a ROP request
+
+   The request is passed to the handler of its table entry. A ROP
+   without entry, or referencing a handle index outside the handle
+   array, gets an error reply instead: MAPI_E_NO_SUPPORT
+   (ecNotImplemented) and ecNullObject respectively. RopRelease has no
+   reply, only the status is returned.
+
+   \param mem_ctx pointer to the memory context of the transaction
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param rop pointer to the table entry of the ROP, as returned by
+   emsmdbp_rop_lookup()
+   \param mapi_req pointer to the ROP request
+   \param mapi_repl pointer to the ROP reply
+   \param handles pointer to the handle array of the request
+   \param handles_count number of handles in the handle array
+   \param size pointer to the size of the replies, updated with the
+   reply of this ROP
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_rop_dispatch(TALLOC_CTX *mem_ctx,
+					      struct emsmdbp_context *emsmdbp_ctx,
+					      const struct emsmdbp_rop *rop,
+					      struct EcDoRpc_MAPI_REQ *mapi_req,
+					      struct EcDoRpc_MAPI_REPL *mapi_repl,
+					      uint32_t *handles, uint32_t handles_count,
+					      uint16_t *size)
+{
+	enum MAPISTATUS	retval;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!mapi_req, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!mapi_repl, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!size, MAPI_E_INVALID_PARAMETER, NULL);
+
+	if (!rop) {
+		DEBUG(1, ("MAPI Rop: 0x%.2x not implemented!\n", mapi_req->opnum));
+		retval = MAPI_E_NO_SUPPORT;
+		goto error;
+	}
+
+	if ((rop->flags & EMSMDBP_ROP_HANDLE_IN) && mapi_req->handle_idx >= handles_count) {
+		DEBUG(1, ("MAPI Rop: %s handle index %d out of range (%d handles)\n",
+			  rop->name, mapi_req->handle_idx, handles_count));
+		retval = ecNullObject;
+		goto error;
+	}
+
+	if (rop->handle_idx_fn && *rop->handle_idx_fn(mapi_req) >= handles_count) {
+		DEBUG(1, ("MAPI Rop: %s request handle index %d out of range (%d handles)\n",
+			  rop->name, *rop->handle_idx_fn(mapi_req), handles_count));
+		retval = ecNullObject;
+		goto error;
+	}
+
+	return rop->handler(mem_ctx, emsmdbp_ctx, mapi_req, mapi_repl, handles, size);
+
+error:
+	if (rop && (rop->flags & EMSMDBP_ROP_NO_REPLY)) {
+		return retval;
+	}
+
+	mapi_repl->opnum = mapi_req->opnum;
+	mapi_repl->handle_idx = mapi_req->handle_idx;
+	mapi_repl->error_code = retval;
+	*size += SIZE_DFLT_MAPI_RESPONSE;
+
+	return retval;
+}
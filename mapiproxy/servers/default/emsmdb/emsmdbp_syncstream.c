@@ -0,0 +1,190 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_syncstream.c
+
+   \brief Pull-based download stream for ICS synchronization contexts
+
+   The FastTransfer stream of a synchronization download is not built
+   upfront. It is produced one chunk at a time by a fill function, on
+   request from RopFastTransferSourceGetBuffer, and each chunk only
+   needs to be large enough to answer the current request. Each chunk
+   comes with its cutmarks array: (min_size, offset) pairs terminated
+   by a 0xffffffff offset, which tell where a buffer may be cut
+   without splitting an atomic part of the stream.
+ */
+
+#include "mapiproxy/libmapiserver/libmapiserver.h"
+#include "dcesrv_exchange_emsmdb.h"
+
+
+/**
+   \details Make a new chunk current in a download stream
+
+   \param syncstream pointer to the download stream
+   \param data the chunk data, owned by the caller
+   \param cutmarks the chunk cutmarks, owned by the caller
+   \param last_chunk whether the stream ends with this chunk
+ */
+_PUBLIC_ void emsmdbp_syncstream_set_chunk(struct emsmdbp_syncstream *syncstream, DATA_BLOB data,
+					   uint32_t *cutmarks, bool last_chunk)
+{
+	syncstream->chunk.position = 0;
+	syncstream->chunk.buffer = data;
+	syncstream->cutmarks = cutmarks;
+	syncstream->next_cutmark_idx = 1;
+	syncstream->last_chunk = last_chunk;
+}
+
+
+/**
+   \details Return how many bytes of the current chunk can be read
+   when at most length are wanted and the chunk holds more than that
+
+   The buffer is cut at the last cutmark before length, unless the
+   next value has a minimum size that the room left can hold.
+ */
+static uint32_t emsmdbp_syncstream_cut(struct emsmdbp_syncstream *syncstream, uint32_t length)
+{
+	uint32_t	buffer_size, min_value_buffer, mark_idx, max_cutmark;
+	uint32_t	*cutmarks;
+
+	buffer_size = length;
+	cutmarks = syncstream->cutmarks;
+	if (!cutmarks) {
+		return buffer_size;
+	}
+
+	mark_idx = syncstream->next_cutmark_idx;
+	max_cutmark = syncstream->chunk.position + length;
+	while (cutmarks[mark_idx] != 0xffffffff && cutmarks[mark_idx] < max_cutmark) {
+		if (cutmarks[mark_idx] > syncstream->chunk.position) {
+			buffer_size = cutmarks[mark_idx] - syncstream->chunk.position;
+		}
+		mark_idx += 2;
+	}
+	if (buffer_size < length && cutmarks[mark_idx] != 0xffffffff) {
+		min_value_buffer = cutmarks[mark_idx - 1];
+		if (min_value_buffer && (length - buffer_size > min_value_buffer)) {
+			buffer_size = length;
+		}
+	}
+	syncstream->next_cutmark_idx = mark_idx;
+
+	return buffer_size;
+}
+
+
+/**
+   \details Read the next portion of a download stream
+
+   Data is taken from the current chunk. When it runs out before
+   length bytes are read, the fill function is asked for a new chunk
+   of at least the missing size, and the buffer is completed from it.
+
+   \param mem_ctx pointer to the memory context
+   \param syncstream pointer to the download stream
+   \param length the maximum number of bytes to return
+   \param fill_fn function producing the next chunk
+   \param private_data pointer passed to fill_fn
+
+   \note The returned buffer either points into the current chunk
+   or is allocated on mem_ctx. The fill function may release the
+   previous chunk, so data spanning two chunks is always copied.
+
+   \return the buffer read, which is shorter than length only when
+   it is cut on a cutmark or when the stream ends
+ */
+_PUBLIC_ DATA_BLOB emsmdbp_syncstream_read(TALLOC_CTX *mem_ctx, struct emsmdbp_syncstream *syncstream,
+					   uint32_t length, emsmdbp_syncstream_fill_fn fill_fn, void *private_data)
+{
+	DATA_BLOB	buffer;
+	DATA_BLOB	piece;
+	uint32_t	available, wanted;
+	bool		copied = false;
+
+	buffer.data = NULL;
+	buffer.length = 0;
+
+	while (buffer.length < length) {
+		available = syncstream->chunk.buffer.length - syncstream->chunk.position;
+		if (!available) {
+			if (syncstream->last_chunk) break;
+
+			/* The current chunk may be released by fill_fn */
+			if (buffer.length && !copied) {
+				buffer.data = talloc_memdup(mem_ctx, buffer.data, buffer.length);
+				copied = true;
+			}
+			if (!fill_fn(syncstream, length - buffer.length, private_data)) {
+				DEBUG(5, ("[%s:%d]: unable to produce the next chunk, ending stream\n", __FUNCTION__, __LINE__));
+				syncstream->chunk.position = syncstream->chunk.buffer.length;
+				syncstream->last_chunk = true;
+				break;
+			}
+			continue;
+		}
+
+		wanted = length - buffer.length;
+		if (available > wanted) {
+			wanted = emsmdbp_syncstream_cut(syncstream, wanted);
+		}
+		else {
+			wanted = available;
+		}
+
+		piece.data = syncstream->chunk.buffer.data + syncstream->chunk.position;
+		piece.length = wanted;
+		syncstream->chunk.position += wanted;
+
+		if (!buffer.length) {
+			buffer = piece;
+		}
+		else {
+			if (!copied) {
+				buffer.data = talloc_memdup(mem_ctx, buffer.data, buffer.length);
+				copied = true;
+			}
+			buffer.data = talloc_realloc(mem_ctx, buffer.data, uint8_t, buffer.length + piece.length);
+			memcpy(buffer.data + buffer.length, piece.data, piece.length);
+			buffer.length += piece.length;
+		}
+
+		/* cut on a cutmark: the rest waits for the next request */
+		if (syncstream->chunk.position < syncstream->chunk.buffer.length) break;
+	}
+
+	return buffer;
+}
+
+
+/**
+   \details Check whether a download stream has been entirely read
+
+   \param syncstream pointer to the download stream
+
+   \return true when the last chunk has been read to its end
+ */
+_PUBLIC_ bool emsmdbp_syncstream_done(struct emsmdbp_syncstream *syncstream)
+{
+	return (syncstream->last_chunk && syncstream->chunk.position == syncstream->chunk.buffer.length);
+}
@@ -0,0 +1,219 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_transaction.c
+
+   \brief Memory of the ROP buffer processed by an EcDoRpc call
+
+   The ROP handlers allocate their replies, and the many small buffers
+   used to build them, on the memory context of the transaction. It is
+   a talloc pool sized from the estimates of the ROP dispatch table for
+   the ROPs in the request and from the reply buffer size of the
+   client, so processing a ROP buffer only takes a few malloc calls,
+   and releasing the call frees them at once. The reply array is
+   allocated upfront for all the ROPs of the request and the
+   notifications which can fit in the reply buffer.
+
+   Memory kept beyond the call, e.g. by an object referenced by a
+   handle, must be allocated on that object and not referenced or
+   stolen from the transaction: any chunk still in use keeps the whole
+   pool allocated.
+ */
+
+#include "mapiproxy/libmapiserver/libmapiserver.h"
+#include "dcesrv_exchange_emsmdb.h"
+
+static struct emsmdbp_transaction_stats	transaction_stats;
+
+
+/**
+   \details Return the number of ROPs in a request
+
+   \param mapi_request pointer to the request
+
+   \return number of ROPs
+ */
+static uint32_t emsmdbp_transaction_rop_count(struct mapi_request *mapi_request)
+{
+	uint32_t	count;
+
+	if (!mapi_request->mapi_req || mapi_request->mapi_len <= 2) return 0;
+
+	for (count = 0; mapi_request->mapi_req[count].opnum != 0; count++);
+
+	return count;
+}
+
+
+/**
+   \details Initialize the memory of an EcDoRpc transaction
+
+   \param mem_ctx pointer to the memory context of the call
+   \param mapi_request pointer to the request
+   \param max_size the reply buffer size of the client
+   \param notifications number of notifications queued for the session
+   \param rops_size estimated memory needed to process the ROPs of the
+   request, see emsmdbp_rop_size()
+
+   \return Allocated transaction on success, otherwise NULL
+ */
+_PUBLIC_ struct emsmdbp_transaction *emsmdbp_transaction_init(TALLOC_CTX *mem_ctx,
+							      struct mapi_request *mapi_request,
+							      uint32_t max_size,
+							      uint32_t notifications,
+							      uint32_t rops_size)
+{
+	struct emsmdbp_transaction	*transaction;
+	TALLOC_CTX			*pool;
+	uint32_t			rop_count;
+	uint32_t			replies_max;
+	size_t				pool_size;
+
+	/* Sanity checks */
+	if (!mem_ctx || !mapi_request) return NULL;
+
+	if (max_size > EMSMDBP_ROP_BUFFER_MAX) {
+		max_size = EMSMDBP_ROP_BUFFER_MAX;
+	}
+	rop_count = emsmdbp_transaction_rop_count(mapi_request);
+
+	/* A reply per ROP, plus the notifications and the RopPending
+	 * reply which fit in the reply buffer */
+	if (notifications > max_size / SIZE_DFLT_ROPNOTIFY) {
+		notifications = max_size / SIZE_DFLT_ROPNOTIFY;
+	}
+	replies_max = rop_count + notifications + 1;
+
+	/* Replies are built on buffers a few times larger than what
+	 * goes on the wire */
+	pool_size = sizeof (struct emsmdbp_transaction) + (replies_max + 1) * sizeof (struct EcDoRpc_MAPI_REPL)
+		+ 2 * max_size + rops_size;
+	if (pool_size < EMSMDBP_TRANSACTION_POOL_MIN) {
+		pool_size = EMSMDBP_TRANSACTION_POOL_MIN;
+	} else if (pool_size > EMSMDBP_TRANSACTION_POOL_MAX) {
+		pool_size = EMSMDBP_TRANSACTION_POOL_MAX;
+	}
+
+	pool = talloc_pool(mem_ctx, pool_size);
+	if (!pool) return NULL;
+
+	transaction = talloc_zero(pool, struct emsmdbp_transaction);
+	if (!transaction) {
+		talloc_free(pool);
+		return NULL;
+	}
+	transaction->mem_ctx = pool;
+	transaction->pool_size = pool_size;
+	transaction->rop_count = rop_count;
+	transaction->replies_max = replies_max;
+	transaction->replies = talloc_zero_array(pool, struct EcDoRpc_MAPI_REPL, replies_max + 1);
+	if (!transaction->replies) {
+		talloc_free(pool);
+		return NULL;
+	}
+
+	return transaction;
+}
+
+
+/**
+   \details Return the reply array of a transaction, large enough for
+   the specified number of replies and the terminating one
+
+   The array was sized for the request when the transaction was
+   initialized. It is only reallocated when more replies are needed.
+
+   \param transaction pointer to the transaction
+   \param count the number of replies
+
+   \return pointer to the reply array on success, otherwise NULL
+ */
+_PUBLIC_ struct EcDoRpc_MAPI_REPL *emsmdbp_transaction_replies(struct emsmdbp_transaction *transaction, uint32_t count)
+{
+	struct EcDoRpc_MAPI_REPL	*replies;
+
+	if (!transaction) return NULL;
+	if (count <= transaction->replies_max) return transaction->replies;
+
+	replies = talloc_realloc(transaction->mem_ctx, transaction->replies, struct EcDoRpc_MAPI_REPL, count + 1);
+	if (!replies) return NULL;
+	memset(&replies[transaction->replies_max + 1], 0,
+	       (count - transaction->replies_max) * sizeof (struct EcDoRpc_MAPI_REPL));
+
+	transaction->replies = replies;
+	transaction->replies_max = count;
+	transaction->resized = true;
+
+	return replies;
+}
+
+
+/**
+   \details Record the memory used by a processed transaction
+
+   \param transaction pointer to the transaction
+ */
+_PUBLIC_ void emsmdbp_transaction_done(struct emsmdbp_transaction *transaction)
+{
+	size_t		used;
+	size_t		blocks;
+
+	if (!transaction) return;
+
+	/* Leave the pool chunk out */
+	used = talloc_total_size(transaction->mem_ctx) - talloc_get_size(transaction->mem_ctx);
+	blocks = talloc_total_blocks(transaction->mem_ctx) - 1;
+
+	transaction_stats.transactions += 1;
+	transaction_stats.rops += transaction->rop_count;
+	transaction_stats.pool_bytes += transaction->pool_size;
+	transaction_stats.used_bytes += used;
+	transaction_stats.blocks += blocks;
+	/* Allocations which do not fit in the pool are made with malloc */
+	if (used + blocks * EMSMDBP_TRANSACTION_BLOCK_OVERHEAD > transaction->pool_size) {
+		transaction_stats.overflows += 1;
+	}
+	if (transaction->resized) {
+		transaction_stats.reply_resizes += 1;
+	}
+
+	DEBUG(5, ("[%s:%d]: %u ROPs, %zu bytes in %zu blocks, %zu bytes pool\n", __FUNCTION__, __LINE__,
+		  transaction->rop_count, used, blocks, transaction->pool_size));
+}
+
+
+/**
+   \details Retrieve the memory counters of the transactions processed
+   by the server process
+
+   \param stats pointer to the structure receiving the counters
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_INVALID_PARAMETER
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_transaction_get_stats(struct emsmdbp_transaction_stats *stats)
+{
+	OPENCHANGE_RETVAL_IF(!stats, MAPI_E_INVALID_PARAMETER, NULL);
+
+	*stats = transaction_stats;
+
+	return MAPI_E_SUCCESS;
+}
@@ -705,6 +705,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopDeleteMessages(TALLOC_CTX *mem_ctx,
 			}
 			goto delete_message_response;
 		}
+		mapistore_indexing_record_del_cn(emsmdbp_ctx->mstore_ctx, owner, mid);
 
 		ret = mapistore_indexing_record_del_mid(emsmdbp_ctx->mstore_ctx, contextID, owner, mid, MAPISTORE_SOFT_DELETE);
 		if (ret != MAPISTORE_SUCCESS) {
@@ -971,6 +972,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopMoveCopyMessages(TALLOC_CTX *mem_ctx,
 	uint64_t                *targetMIDs;
         uint32_t                i;
 	bool			mapistore = false;
+	char			*owner;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCFOLD] RopMoveCopyMessages (0x33)\n"));
 
@@ -1036,6 +1038,17 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopMoveCopyMessages(TALLOC_CTX *mem_ctx,
 		mapistore_folder_move_copy_messages(emsmdbp_ctx->mstore_ctx, contextID, destination_object->backend_object, source_object->backend_object, mem_ctx, mapi_req->u.mapi_MoveCopyMessages.count, mapi_req->u.mapi_MoveCopyMessages.message_id, targetMIDs, NULL, mapi_req->u.mapi_MoveCopyMessages.WantCopy);
 		talloc_free(targetMIDs);
 
+		/* The change numbers of the new messages are only known by the backend */
+		owner = emsmdbp_get_owner(destination_object);
+		if (destination_object->type == EMSMDBP_OBJECT_FOLDER) {
+			emsmdbp_folder_drop_cn_index(emsmdbp_ctx, owner, destination_object->object.folder->folderID);
+		}
+		if (!mapi_req->u.mapi_MoveCopyMessages.WantCopy) {
+			for (i = 0; i < mapi_req->u.mapi_MoveCopyMessages.count; i++) {
+				mapistore_indexing_record_del_cn(emsmdbp_ctx->mstore_ctx, owner, mapi_req->u.mapi_MoveCopyMessages.message_id[i]);
+			}
+		}
+
 		/* /\* The backend might do this for us. In any case, we try to add it ourselves *\/ */
 		/* mapistore_indexing_record_add_mid(emsmdbp_ctx->mstore_ctx, contextID, targetMID); */
 	}
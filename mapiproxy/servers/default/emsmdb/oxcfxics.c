@@ -32,8 +32,7 @@
 /* a constant time offset by which the first change number ever can be produced by OpenChange */
 #define oc_version_time 0x4dbb2dbe
 
-/* the maximum buffer that will be populated during msg synchronization operations (note: this is a soft limit) */
-static const size_t max_message_sync_size = 262144;
+/* the number of table rows fetched and preloaded at once during msg synchronization operations */
 static const uint32_t message_preload_interval = 150;
 
 /** notes:
@@ -85,10 +84,22 @@ struct oxcfxics_sync_data {
 	struct oxcfxics_message_sync_data	*message_sync_data;
 };
 
+/* cursor kept between two chunks of a message download: either a
+   message table or the changes listed by the change number index */
 struct oxcfxics_message_sync_data {
-	uint64_t	*mids;
-	uint64_t	count;
-	uint64_t	max;
+	struct emsmdbp_object	*table_object;
+	struct UI8Array_r	*changes;
+	uint32_t		row_count;
+	uint32_t		position;
+
+	/* the table is walked to seed the change number index */
+	bool			seeding;
+	uint32_t		generation;
+
+	/* current window of mids */
+	uint64_t		*mids;
+	uint32_t		count;
+	uint32_t		max;
 };
 
 /** ndr helpers */
@@ -753,17 +764,17 @@ static void oxcfxics_push_messageChange_attachments(struct emsmdbp_context *emsm
 	talloc_free(table_object);
 }
 
-static void oxcfxics_table_set_cn_restriction(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, const char *owner, struct idset *cnset_seen)
-{
-	struct mapi_SRestriction cn_restriction;
-	struct idset *local_cnset;
-	uint16_t repl_id;
-	uint8_t state;
+/**
+   \details Return the highest change number of the local replica
+   known by the client
 
-	if (!emsmdbp_is_mapistore(table_object)) {
-		DEBUG(5, (__location__": table restrictions not supported by non-mapistore tables\n"));
-		return;
-	}
+   \return false when the change set can't be summed up by a single
+   change number
+ */
+static bool oxcfxics_cnset_watermark(struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct idset *cnset_seen, uint64_t *cnp)
+{
+	struct idset	*local_cnset;
+	uint16_t	repl_id;
 
 	local_cnset = cnset_seen;
 	while (local_cnset && (emsmdbp_guid_to_replid(emsmdbp_ctx, owner, &local_cnset->repl.guid, &repl_id) != MAPI_E_SUCCESS || repl_id != 1)) {
@@ -771,11 +782,32 @@ static void oxcfxics_table_set_cn_restriction(struct emsmdbp_context *emsmdbp_ct
 	}
 
 	if (!local_cnset) {
-		DEBUG(5, (__location__": no change set available -> no table restrictions\n"));
-		return;
+		DEBUG(5, (__location__": no change set available\n"));
+		return false;
 	}
 	if (local_cnset->range_count != 1) {
-		DEBUG(5, (__location__": no valid change set available (range_count = %d) -> no table restrictions\n", local_cnset->range_count));
+		DEBUG(5, (__location__": no valid change set available (range_count = %d)\n", local_cnset->range_count));
+		return false;
+	}
+
+	*cnp = (local_cnset->ranges[0].high << 16) | repl_id;
+
+	return true;
+}
+
+static void oxcfxics_table_set_cn_restriction(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, const char *owner, struct idset *cnset_seen)
+{
+	struct mapi_SRestriction cn_restriction;
+	uint64_t cn;
+	uint8_t state;
+
+	if (!emsmdbp_is_mapistore(table_object)) {
+		DEBUG(5, (__location__": table restrictions not supported by non-mapistore tables\n"));
+		return;
+	}
+
+	if (!oxcfxics_cnset_watermark(emsmdbp_ctx, owner, cnset_seen, &cn)) {
+		DEBUG(5, (__location__": no table restrictions\n"));
 		return;
 	}
 
@@ -783,18 +815,220 @@ static void oxcfxics_table_set_cn_restriction(struct emsmdbp_context *emsmdbp_ct
 	cn_restriction.res.resProperty.relop = RELOP_GT;
 	cn_restriction.res.resProperty.ulPropTag = PidTagChangeNumber;
 	cn_restriction.res.resProperty.lpProp.ulPropTag = PidTagChangeNumber;
-	cn_restriction.res.resProperty.lpProp.value.d = (cnset_seen->ranges[0].high << 16) | repl_id;
+	cn_restriction.res.resProperty.lpProp.value.d = cn;
 
 	mapistore_table_set_restrictions(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(table_object), table_object->backend_object, &cn_restriction, &state);
 }
 
-static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object_synccontext *synccontext, const char *owner, struct oxcfxics_sync_data *sync_data, struct emsmdbp_object *folder_object)
+/**
+   \details Open the message table of a folder for a message download
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param owner the mailbox owner
+   \param message_sync_data pointer to the download cursor
+   \param folder_object pointer to the synchronized folder
+   \param table_type the table type
+   \param cnset_seen the change numbers known by the client, used to
+   restrict the table, or NULL for a table listing every message with
+   its change number
+ */
+static void oxcfxics_open_message_table(struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct oxcfxics_message_sync_data *message_sync_data, struct emsmdbp_object *folder_object, uint8_t table_type, struct idset *cnset_seen)
+{
+	static enum MAPITAGS	table_properties[] = { PidTagMid, PidTagChangeNumber };
+	struct emsmdbp_object	*table_object;
+	uint32_t		contextID;
+
+	table_object = emsmdbp_folder_open_table(message_sync_data, folder_object, table_type, 0);
+	if (!table_object) {
+		DEBUG(5, ("could not open folder table\n"));
+		return;
+	}
+	table_object->object.table->prop_count = (cnset_seen ? 1 : 2);
+	table_object->object.table->properties = table_properties;
+
+	if (cnset_seen) {
+		oxcfxics_table_set_cn_restriction(emsmdbp_ctx, table_object, owner, cnset_seen);
+	}
+	if (emsmdbp_is_mapistore(table_object)) {
+		contextID = emsmdbp_get_contextID(folder_object);
+		mapistore_table_set_columns(emsmdbp_ctx->mstore_ctx, contextID, table_object->backend_object, table_object->object.table->prop_count, table_object->object.table->properties);
+		mapistore_table_get_row_count(emsmdbp_ctx->mstore_ctx, contextID, table_object->backend_object, MAPISTORE_PREFILTERED_QUERY, &table_object->object.table->denominator);
+		message_sync_data->row_count = table_object->object.table->denominator;
+
+		DEBUG(5, ("push_messageChange: %d objects in table\n", table_object->object.table->denominator));
+	}
+	message_sync_data->table_object = table_object;
+}
+
+/**
+   \details Give up seeding the change number index of a folder table,
+   which stays unindexed
+ */
+static void oxcfxics_abort_seeding(struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct oxcfxics_message_sync_data *message_sync_data, uint64_t fid, enum mapistore_table_type table_type)
+{
+	if (message_sync_data->seeding) {
+		DEBUG(5, (__location__": folder 0x%.16"PRIx64" can't be indexed\n", fid));
+		mapistore_indexing_set_cn_index_state(emsmdbp_ctx->mstore_ctx, owner, fid, table_type, MAPISTORE_CN_INDEX_NONE, NULL);
+		message_sync_data->seeding = false;
+	}
+}
+
+/**
+   \details Prepare a message download from the change number index of
+   a folder
+
+   Only the messages changed after the client watermark are listed.
+   When the folder table is not indexed, the whole table is walked
+   instead and the index is seeded along the way.
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param owner the mailbox owner
+   \param message_sync_data pointer to the download cursor
+   \param folder_object pointer to the synchronized folder
+   \param table_type the table type
+   \param cnset_seen the change numbers known by the client
+ */
+static void oxcfxics_open_message_changes(struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct oxcfxics_message_sync_data *message_sync_data, struct emsmdbp_object *folder_object, uint8_t table_type, struct idset *cnset_seen)
+{
+	uint64_t	fid, cn;
+
+	fid = folder_object->object.folder->folderID;
+	if (!oxcfxics_cnset_watermark(emsmdbp_ctx, owner, cnset_seen, &cn)) {
+		cn = 0;
+	}
+
+	if (mapistore_indexing_get_changes(emsmdbp_ctx->mstore_ctx, owner, message_sync_data, fid, table_type, cn, &message_sync_data->changes) == MAPISTORE_SUCCESS) {
+		message_sync_data->row_count = message_sync_data->changes->cValues;
+		DEBUG(5, ("push_messageChange: %d changes after cn 0x%.16"PRIx64" in index\n", message_sync_data->row_count, cn));
+		return;
+	}
+
+	DEBUG(5, ("push_messageChange: folder 0x%.16"PRIx64" is not indexed, seeding its index\n", fid));
+	message_sync_data->changes = NULL;
+	message_sync_data->seeding = (mapistore_indexing_set_cn_index_state(emsmdbp_ctx->mstore_ctx, owner, fid, table_type, MAPISTORE_CN_INDEX_SEEDING, &message_sync_data->generation) == MAPISTORE_SUCCESS);
+	oxcfxics_open_message_table(emsmdbp_ctx, owner, message_sync_data, folder_object, table_type, NULL);
+	if (!message_sync_data->table_object) {
+		oxcfxics_abort_seeding(emsmdbp_ctx, owner, message_sync_data, fid, table_type);
+	}
+}
+
+/**
+   \details Fetch the mids of the next messages to download and
+   preload their bodies
+
+   When the table is walked to seed the change number index, the change
+   numbers of its rows are recorded and messages already known by the
+   client are skipped without being opened.
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param synccontext pointer to the synchronization context
+   \param owner the mailbox owner
+   \param sync_data pointer to the download state
+   \param message_sync_data pointer to the download cursor
+   \param folder_object pointer to the synchronized folder
+   \param mstore_type the table type
+   \param cnset_seen the change numbers known by the client
+
+   \return false when the end of the table has been reached
+ */
+static bool oxcfxics_fetch_message_window(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object_synccontext *synccontext, const char *owner, struct oxcfxics_sync_data *sync_data, struct oxcfxics_message_sync_data *message_sync_data, struct emsmdbp_object *folder_object, enum mapistore_table_type mstore_type, struct idset *cnset_seen)
+{
+	struct emsmdbp_table_row	*rows;
+	struct UI8Array_r		preload_mids;
+	uint64_t			*seed_mids, *seed_cns;
+	uint64_t			mid, cn;
+	uint32_t			i, batch, seed_count;
+
+	message_sync_data->count = 0;
+	message_sync_data->max = 0;
+	while (!message_sync_data->max && message_sync_data->position < message_sync_data->row_count) {
+		batch = message_sync_data->row_count - message_sync_data->position;
+		if (batch > message_preload_interval) {
+			batch = message_preload_interval;
+		}
+
+		if (message_sync_data->changes) {
+			memcpy(message_sync_data->mids, message_sync_data->changes->lpui8 + message_sync_data->position, batch * sizeof (uint64_t));
+			message_sync_data->position += batch;
+			message_sync_data->max = batch;
+			continue;
+		}
+
+		rows = emsmdbp_object_table_get_rows_props(message_sync_data, emsmdbp_ctx, message_sync_data->table_object, message_sync_data->position, batch, MAPISTORE_PREFILTERED_QUERY);
+		message_sync_data->position += batch;
+		if (!rows) {
+			oxcfxics_abort_seeding(emsmdbp_ctx, owner, message_sync_data, folder_object->object.folder->folderID, mstore_type);
+			continue;
+		}
+
+		seed_mids = talloc_array(rows, uint64_t, batch);
+		seed_cns = talloc_array(rows, uint64_t, batch);
+		seed_count = 0;
+		for (i = 0; i < batch; i++) {
+			if (!rows[i].data_pointers || rows[i].retvals[0] != MAPI_E_SUCCESS) {
+				continue;
+			}
+			mid = *(uint64_t *) rows[i].data_pointers[0];
+
+			if (message_sync_data->seeding) {
+				if (rows[i].retvals[1] != MAPI_E_SUCCESS) {
+					DEBUG(5, (__location__": no change number for message 0x%.16"PRIx64"\n", mid));
+					oxcfxics_abort_seeding(emsmdbp_ctx, owner, message_sync_data, folder_object->object.folder->folderID, mstore_type);
+				}
+				else {
+					cn = *(uint64_t *) rows[i].data_pointers[1];
+					seed_mids[seed_count] = mid;
+					seed_cns[seed_count] = cn;
+					seed_count++;
+
+					cn = (cn >> 16) & 0x0000ffffffffffff;
+					if (IDSET_includes_guid_glob(cnset_seen, &sync_data->replica_guid, cn)) {
+						synccontext->skipped_objects++;
+						continue;
+					}
+				}
+			}
+
+			message_sync_data->mids[message_sync_data->max] = mid;
+			message_sync_data->max++;
+		}
+		if (message_sync_data->seeding && seed_count) {
+			mapistore_indexing_record_set_cns(emsmdbp_ctx->mstore_ctx, owner, folder_object->object.folder->folderID, mstore_type, seed_count, seed_mids, seed_cns);
+		}
+		talloc_free(rows);
+	}
+
+	if (!message_sync_data->max) {
+		return false;
+	}
+
+	if (emsmdbp_is_mapistore(folder_object)) {
+		preload_mids.cValues = message_sync_data->max;
+		preload_mids.lpui8 = message_sync_data->mids;
+		mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(folder_object), folder_object->backend_object, mstore_type, &preload_mids);
+	}
+
+	return true;
+}
+
+/**
+   \details Push message changes to the current chunk until it holds
+   at least min_size bytes or the end of the table is reached
+
+   The table stays open between two calls and its rows are fetched
+   message_preload_interval at a time, so only the current window of
+   mids is held in memory. Folders with a change number index skip
+   the table and only go through the messages changed since the last
+   synchronization.
+
+   \return true when the end of the table has been reached
+ */
+static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object_synccontext *synccontext, const char *owner, struct oxcfxics_sync_data *sync_data, struct emsmdbp_object *folder_object, uint32_t min_size)
 {
 	TALLOC_CTX			*mem_ctx, *msg_ctx;
 	bool				folder_is_mapistore, end_of_table;
-	struct emsmdbp_object		*table_object, *message_object;
+	struct emsmdbp_object		*message_object;
 	uint32_t			i;
-	static enum MAPITAGS		mid_property = PidTagMid;
 	enum MAPISTATUS			*retvals, *header_retvals;
 	void				**data_pointers, **header_data_pointers;
 	struct FILETIME			*lm_time;
@@ -831,44 +1065,20 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		message_sync_data = sync_data->message_sync_data;
 	}
 	else {
-		message_sync_data = talloc_zero(NULL, struct oxcfxics_message_sync_data);
+		message_sync_data = talloc_zero(sync_data, struct oxcfxics_message_sync_data);
+		message_sync_data->mids = talloc_array(message_sync_data, uint64_t, message_preload_interval);
 		sync_data->message_sync_data = message_sync_data;
 
 		/* we only push "messageChangeFull" since we don't handle property-based changes */
 		/* messageChangeFull = IncrSyncChg messageChangeHeader IncrSyncMessage propList messageChildren */
 
-		table_object = emsmdbp_folder_open_table(mem_ctx, folder_object, sync_data->table_type, 0);
-		if (!table_object) {
-			DEBUG(5, ("could not open folder table\n"));
-			abort();
+		if (emsmdbp_folder_cn_index_enabled(emsmdbp_ctx, folder_object)) {
+			oxcfxics_open_message_changes(emsmdbp_ctx, owner, message_sync_data, folder_object, sync_data->table_type, original_cnset_seen);
 		}
-
-		table_object->object.table->prop_count = 1;
-		table_object->object.table->properties = &mid_property;
-
-		oxcfxics_table_set_cn_restriction(emsmdbp_ctx, table_object, owner, original_cnset_seen);
-		message_sync_data->max = 0;
-		if (emsmdbp_is_mapistore(table_object)) {
-			contextID = emsmdbp_get_contextID(folder_object);
-			mapistore_table_set_columns(emsmdbp_ctx->mstore_ctx, contextID, table_object->backend_object, table_object->object.table->prop_count, table_object->object.table->properties);
-			mapistore_table_get_row_count(emsmdbp_ctx->mstore_ctx, contextID, table_object->backend_object, MAPISTORE_PREFILTERED_QUERY, &table_object->object.table->denominator);
-			synccontext->total_objects += table_object->object.table->denominator;
-
-			DEBUG(5, ("push_messageChange: %d objects in table\n", table_object->object.table->denominator));
-			/* fetch maching mids */
-			message_sync_data->mids = talloc_array(message_sync_data, uint64_t, table_object->object.table->denominator);
-			for (i = 0; i < table_object->object.table->denominator; i++) {
-				data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, table_object, i, MAPISTORE_PREFILTERED_QUERY, &retvals);
-				if (data_pointers) {
-					if (retvals[0] == MAPI_E_SUCCESS) {
-						message_sync_data->mids[message_sync_data->max] = *(uint64_t *) data_pointers[0];
-						message_sync_data->max++;
-					}
-				}
-			}
+		else {
+			oxcfxics_open_message_table(emsmdbp_ctx, owner, message_sync_data, folder_object, sync_data->table_type, original_cnset_seen);
 		}
-
-		message_sync_data->count = 0;
+		synccontext->total_objects += message_sync_data->row_count;
 	}
 
 	folder_is_mapistore = emsmdbp_is_mapistore(folder_object);
@@ -877,21 +1087,15 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	}
 
 	/* open each message and fetch properties */
-	for (; sync_data->ndr->offset < max_message_sync_size && message_sync_data->count < message_sync_data->max; message_sync_data->count++) {
-		msg_ctx = talloc_zero(NULL, TALLOC_CTX);
-
-		if (folder_is_mapistore && (message_sync_data->count % message_preload_interval) == 0) {
-			preload_mids.lpui8 = message_sync_data->mids + message_sync_data->count;
-			if ((message_sync_data->count + message_preload_interval) < message_sync_data->max) {
-				preload_mids.cValues = message_preload_interval;
-			}
-			else {
-				preload_mids.cValues = message_sync_data->max - message_sync_data->count;
-			}
-			mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx, contextID, folder_object->backend_object, mstore_type, &preload_mids);
+	for (; sync_data->ndr->offset < min_size; message_sync_data->count++) {
+		if (message_sync_data->count == message_sync_data->max &&
+		    !oxcfxics_fetch_message_window(emsmdbp_ctx, synccontext, owner, sync_data, message_sync_data, folder_object, mstore_type, original_cnset_seen)) {
+			break;
 		}
 
-		eid = *(message_sync_data->mids + message_sync_data->count);
+		msg_ctx = talloc_zero(NULL, TALLOC_CTX);
+
+		eid = message_sync_data->mids[message_sync_data->count];
 		if (eid == 0x7fffffffffffffffLL) {
 			DEBUG(0, ("message without a valid eid\n"));
 			goto end_row;
@@ -947,8 +1151,12 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		i++;
 
 		if (retvals[sync_data->prop_index.change_number]) {
-			DEBUG(5, (__location__": mandatory property PidTagChangeNumber not returned for message\n"));
-			abort();
+			DEBUG(5, (__location__": mandatory property PidTagChangeNumber not returned for message '%.16"PRIx64"', skipped\n", eid));
+			goto end_row;
+		}
+		if (retvals[sync_data->prop_index.change_key]) {
+			DEBUG(5, (__location__": mandatory property PidTagChangeKey not returned for message '%.16"PRIx64"', skipped\n", eid));
+			goto end_row;
 		}
 		cn = ((*(uint64_t *) data_pointers[sync_data->prop_index.change_number]) >> 16) & 0x0000ffffffffffff;
 		if (IDSET_includes_guid_glob(original_cnset_seen, &sync_data->replica_guid, cn)) {
@@ -961,10 +1169,6 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 
 		/* change key */
 		/* bin_data = oxcfxics_make_gid(header_data_pointers, &sync_data->replica_guid, cn); */
-		if (retvals[sync_data->prop_index.change_key]) {
-			DEBUG(5, (__location__": mandatory property PidTagChangeKey not returned for message\n"));
-			abort();
-		}
 		query_props.aulPropTag[i] = PidTagChangeKey;
 		bin_data = data_pointers[sync_data->prop_index.change_key];
 		header_data_pointers[i] = bin_data;
@@ -1058,13 +1262,9 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		talloc_free(msg_ctx);
 	}
 
-	if (sync_data->ndr->offset >= max_message_sync_size) {
-		DEBUG(5, ("reached max sync size: %u >= %zu\n", sync_data->ndr->offset, max_message_sync_size));
-	}
-
-	if (message_sync_data->count < message_sync_data->max) {
+	if (message_sync_data->count < message_sync_data->max || message_sync_data->position < message_sync_data->row_count) {
 		end_of_table = false;
-		DEBUG(5, ("table status: count: %"PRId64", max: %"PRId64"\n", message_sync_data->count, message_sync_data->max));
+		DEBUG(5, ("table status: position: %u, row count: %u\n", message_sync_data->position, message_sync_data->row_count));
 	}
 	else {
 		/* fetch deleted ids */
@@ -1086,7 +1286,10 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 			preload_mids.cValues = 0;
 			mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx, contextID, folder_object->backend_object, mstore_type, &preload_mids);
 		}
-		DEBUG(5, ("end of table reached: count: %"PRId64", max: %"PRId64"\n", message_sync_data->count, message_sync_data->max));
+		if (message_sync_data->seeding) {
+			mapistore_indexing_set_cn_index_state(emsmdbp_ctx->mstore_ctx, owner, folder_object->object.folder->folderID, mstore_type, MAPISTORE_CN_INDEX_READY, &message_sync_data->generation);
+		}
+		DEBUG(5, ("end of table reached: row count: %u\n", message_sync_data->row_count));
 		talloc_free(message_sync_data);
 		sync_data->message_sync_data = NULL;
 		end_of_table = true;
@@ -1097,8 +1300,14 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	return end_of_table;
 }
 
-static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_synccontext *synccontext, TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object)
+/**
+   \details Produce the next chunk of a contents synchronization stream
+
+   The chunk holds at least min_size bytes, unless it is the last one.
+ */
+static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_synccontext *synccontext, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object, uint32_t min_size)
 {
+	DATA_BLOB			chunk;
 	struct oxcfxics_sync_data	*sync_data;
 	struct idset			*new_idset, *old_idset;
 	
@@ -1106,7 +1315,7 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 
 	if (synccontext->sync_stage == 0) {
 		/* 1. we setup the mandatory properties indexes */
-		sync_data = talloc_zero(NULL, struct oxcfxics_sync_data);
+		sync_data = talloc_zero(synccontext, struct oxcfxics_sync_data);
 		openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, owner, NULL, &sync_data->replica_guid);
 		SPropTagArray_find(synccontext->properties, PidTagMid, &sync_data->prop_index.eid);
 		SPropTagArray_find(synccontext->properties, PidTagChangeNumber, &sync_data->prop_index.change_number);
@@ -1143,7 +1352,7 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 				sync_data->table_type = MAPISTORE_MESSAGE_TABLE;
 			}
 
-			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object)) {
+			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object, min_size)) {
 				new_idset = RAWIDSET_convert_to_idset(NULL, sync_data->cnset_seen);
 				old_idset = synccontext->cnset_seen;
 				/* IDSET_dump (synccontext->cnset_seen, "initial cnset_seen"); */
@@ -1168,7 +1377,7 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 				sync_data->table_type = MAPISTORE_FAI_TABLE;
 			}
 
-			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object)) {
+			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object, min_size)) {
 				new_idset = RAWIDSET_convert_to_idset(NULL, sync_data->cnset_seen);
 				old_idset = synccontext->cnset_seen_fai;
 				/* IDSET_dump (synccontext->cnset_seen, "initial cnset_seen_fai"); */
@@ -1259,11 +1468,10 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0);
 	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0xffffffff);
 
-	synccontext->cutmarks = (uint32_t *) sync_data->cutmarks_ndr->data;
-	synccontext->next_cutmark_idx = 1;
-	synccontext->stream.position = 0;
-	synccontext->stream.buffer.data = sync_data->ndr->data;
-	synccontext->stream.buffer.length = sync_data->ndr->offset;
+	chunk.data = sync_data->ndr->data;
+	chunk.length = sync_data->ndr->offset;
+	emsmdbp_syncstream_set_chunk(&synccontext->download, chunk, (uint32_t *) sync_data->cutmarks_ndr->data, synccontext->sync_stage == 4);
+	DEBUG(5, ("sync chunk of %zu bytes, stage %d\n", chunk.length, synccontext->sync_stage));
 
 	if (synccontext->sync_stage == 4) {
 		(void) talloc_reference(synccontext, sync_data->ndr->data);
@@ -1469,9 +1677,10 @@ static void oxcfxics_push_folderChange(struct emsmdbp_context *emsmdbp_ctx, stru
 	talloc_free(mem_ctx);
 }
 
-static void oxcfxics_prepare_synccontext_with_folderChange(struct emsmdbp_object_synccontext *synccontext, TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object)
+static void oxcfxics_prepare_synccontext_with_folderChange(struct emsmdbp_object_synccontext *synccontext, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object)
 {
 	struct oxcfxics_sync_data		*sync_data;
+	DATA_BLOB				chunk;
 	struct idset				*new_idset, *old_idset;
 
 	/* 1b. we setup context data */
@@ -1542,11 +1751,10 @@ static void oxcfxics_prepare_synccontext_with_folderChange(struct emsmdbp_object
 
 	ndr_push_uint32(sync_data->cutmarks_ndr, NDR_SCALARS, 0xffffffff);
 
-	synccontext->cutmarks = (uint32_t *) sync_data->cutmarks_ndr->data;
-	synccontext->next_cutmark_idx = 1;
-	synccontext->stream.position = 0;
-	synccontext->stream.buffer.data = sync_data->ndr->data;
-	synccontext->stream.buffer.length = sync_data->ndr->offset;
+	/* the hierarchy stream is produced at once */
+	chunk.data = sync_data->ndr->data;
+	chunk.length = sync_data->ndr->offset;
+	emsmdbp_syncstream_set_chunk(&synccontext->download, chunk, (uint32_t *) sync_data->cutmarks_ndr->data, true);
 
 	(void) talloc_reference(synccontext, sync_data->ndr->data);
 	(void) talloc_reference(synccontext, sync_data->cutmarks_ndr->data);
@@ -1597,134 +1805,51 @@ static inline void oxcfxics_fill_ftcontext_fasttransfer_response(struct FastTran
 	}
 }
 
-static uint32_t oxcfxics_advance_cutmarks(struct emsmdbp_object_synccontext *synccontext, uint32_t request_buffer_size)
-{
-	uint32_t buffer_size, min_value_buffer, mark_idx, max_cutmark;
+struct oxcfxics_syncstream_fill_ctx {
+	struct emsmdbp_object_synccontext	*synccontext;
+	struct emsmdbp_object			*parent_object;
+	const char				*owner;
+};
 
-	buffer_size = request_buffer_size;
+static bool oxcfxics_syncstream_fill(struct emsmdbp_syncstream *syncstream, uint32_t min_size, void *private_data)
+{
+	struct oxcfxics_syncstream_fill_ctx	*fill_ctx = private_data;
+	struct emsmdbp_object_synccontext	*synccontext = fill_ctx->synccontext;
+	struct emsmdbp_object			*parent_object = fill_ctx->parent_object;
 
-	mark_idx = synccontext->next_cutmark_idx;
-	max_cutmark = synccontext->stream.position + request_buffer_size;
-	/* FIXME: cutmark lookups would be faster using a binary search */
-	while (synccontext->cutmarks[mark_idx] != 0xffffffff && synccontext->cutmarks[mark_idx] < max_cutmark) {
-		buffer_size = synccontext->cutmarks[mark_idx] - synccontext->stream.position;
-		mark_idx += 2;
+	if (synccontext->request.contents_mode) {
+		DEBUG(5, ("content mode, stage %d\n", synccontext->sync_stage));
+		if (synccontext->sync_stage == 4) {
+			return false;
+		}
+		oxcfxics_fill_synccontext_with_messageChange(synccontext, parent_object->emsmdbp_ctx, fill_ctx->owner, parent_object, min_size);
 	}
-	if (buffer_size < request_buffer_size && synccontext->cutmarks[mark_idx] != 0xffffffff) {
-		min_value_buffer = synccontext->cutmarks[mark_idx-1];
-		if (min_value_buffer && (request_buffer_size - buffer_size > min_value_buffer)) {
-			buffer_size = request_buffer_size;
+	else {
+		if (syncstream->chunk.buffer.data) {
+			return false;
 		}
+		oxcfxics_prepare_synccontext_with_folderChange(synccontext, parent_object->emsmdbp_ctx, fill_ctx->owner, parent_object);
+		DEBUG(5, ("synccontext buffer is %u bytes long\n", (uint32_t) syncstream->chunk.buffer.length));
 	}
-	synccontext->next_cutmark_idx = mark_idx;
+	oxcfxics_check_cutmark_buffer(syncstream->cutmarks, &syncstream->chunk.buffer);
 
-	return buffer_size;
+	return true;
 }
 
-
 static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTransferSourceGetBuffer_repl *response, uint32_t request_buffer_size, TALLOC_CTX *mem_ctx, struct emsmdbp_object_synccontext *synccontext, struct emsmdbp_object *parent_object)
 {
-	char		*owner;
-	size_t		old_chunk_size, new_chunk_size;
-	uint32_t	buffer_size;
-	bool		end_of_buffer = false;
-	DATA_BLOB	joint_buffer;
-
-	owner = emsmdbp_get_owner(parent_object);
-
-	DEBUG(5, ("start syncstream: position = %zu, size = %zu\n", synccontext->stream.position, synccontext->stream.buffer.length));
-	if (synccontext->stream.position + request_buffer_size < synccontext->stream.buffer.length) {
-		/* the current chunk has not been "emptied" yet */
-		buffer_size = oxcfxics_advance_cutmarks(synccontext, request_buffer_size);
-		response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
-	}
-	else {
-		/* the current chunk not does exist or we reached its end */
-		if (synccontext->request.contents_mode) {
-			DEBUG(5, ("content mode, stage %d\n", synccontext->sync_stage));
-			if (synccontext->sync_stage == 4) {
-				/* the last chunk was the last one */
-				end_of_buffer = true;
-				response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, request_buffer_size);
-			}
-			else if (synccontext->sync_stage == 0) {
-				/* no chunk sent yet, so we create a new one */
-				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
-				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
-				if (request_buffer_size < synccontext->stream.buffer.length) {
-					buffer_size = oxcfxics_advance_cutmarks(synccontext, request_buffer_size);
-				}
-				else {
-					buffer_size = request_buffer_size;
-					if (synccontext->sync_stage == 4) {
-						end_of_buffer = true;
-					}
-					else {
-						abort();
-					}
-				}
-				response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
-			}
-			else {
-				/* we have reached the end of a middle chunk, we must thus finish it and complete the buffer with the content of the next chunk */
-				old_chunk_size = synccontext->stream.buffer.length - synccontext->stream.position;
+	struct oxcfxics_syncstream_fill_ctx	fill_ctx;
 
-				if (old_chunk_size > 0) {
-					joint_buffer.length = old_chunk_size;
-					joint_buffer.data = talloc_memdup(mem_ctx, synccontext->stream.buffer.data + synccontext->stream.position, joint_buffer.length);
-				}
-
-				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
-				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
-
-				new_chunk_size = request_buffer_size - old_chunk_size;
-				if (synccontext->stream.buffer.length < new_chunk_size) {
-					new_chunk_size = synccontext->stream.buffer.length;
-					if (synccontext->sync_stage == 4) {
-						end_of_buffer = true;
-					}
-					else {
-						abort();
-					}
-				}
-				else {
-					new_chunk_size = oxcfxics_advance_cutmarks(synccontext, new_chunk_size);
-				}
-
-				if (new_chunk_size > 0) {
-					if (old_chunk_size) {
-						joint_buffer.length += new_chunk_size;
-						joint_buffer.data = talloc_realloc(mem_ctx, joint_buffer.data, uint8_t, joint_buffer.length);
-						memcpy(joint_buffer.data + old_chunk_size, synccontext->stream.buffer.data, new_chunk_size);
-						synccontext->stream.position += new_chunk_size;
-					}
-					else {
-						joint_buffer = emsmdbp_stream_read_buffer(&synccontext->stream, new_chunk_size);
-					}
-				}
-				response->TransferBuffer = joint_buffer;
+	fill_ctx.synccontext = synccontext;
+	fill_ctx.parent_object = parent_object;
+	fill_ctx.owner = emsmdbp_get_owner(parent_object);
 
+	/* chunks are only produced when the current one has been read */
+	DEBUG(5, ("start syncstream: position = %zu, size = %zu\n", synccontext->download.chunk.position, synccontext->download.chunk.buffer.length));
+	response->TransferBuffer = emsmdbp_syncstream_read(mem_ctx, &synccontext->download, request_buffer_size, oxcfxics_syncstream_fill, &fill_ctx);
 
-				DEBUG(5, ("joint buffers of sizes %zu and %zu\n", old_chunk_size, new_chunk_size));
-			}
-		}
-		else {
-			buffer_size = request_buffer_size;
-			if (synccontext->stream.buffer.data) {
-				end_of_buffer = true;
-			}
-			else {
-				oxcfxics_prepare_synccontext_with_folderChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
-				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
-				DEBUG(5, ("synccontext buffer is %u bytes long\n", (uint32_t) synccontext->stream.buffer.length));
-			}
-			response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
-		}
-	}
-	
 	response->TotalStepCount = synccontext->total_steps;
-	/* if (synccontext->stream.position == synccontext->stream.buffer.length) { */
-	if (end_of_buffer) {
+	if (emsmdbp_syncstream_done(&synccontext->download)) {
 		response->TransferStatus = TransferStatus_Done;
 		response->InProgressCount = response->TotalStepCount;
 	}
@@ -1732,7 +1857,7 @@ static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTr
 		response->TransferStatus = TransferStatus_Partial;
 		response->InProgressCount = synccontext->steps;
 	}
- 	DEBUG(5, ("  end syncstream: position = %zu, size = %zu", synccontext->stream.position, synccontext->stream.buffer.length));
+	DEBUG(5, ("  end syncstream: position = %zu, size = %zu\n", synccontext->download.chunk.position, synccontext->download.chunk.buffer.length));
 }
 
 
@@ -2468,6 +2593,9 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncImportDeletes(TALLOC_CTX *mem_ctx,
 				if (ret != MAPISTORE_SUCCESS) {
 					DEBUG(5, ("message deletion failed for fmid: 0x%.16"PRIx64"\n", objectID));
 				}
+				else {
+					mapistore_indexing_record_del_cn(emsmdbp_ctx->mstore_ctx, owner, objectID);
+				}
 				ret = mapistore_indexing_record_del_mid(emsmdbp_ctx->mstore_ctx, contextID, owner, objectID, delete_type);
 				if (ret != MAPISTORE_SUCCESS) {
 					DEBUG(5, ("message deletion of index record failed for fmid: 0x%.16"PRIx64"\n", objectID));
@@ -2931,6 +3059,10 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncImportMessageMove(TALLOC_CTX *mem_ctx,
 	if (mapistore) {
 		/* We invoke the backend method */
 		mapistore_folder_move_copy_messages(emsmdbp_ctx->mstore_ctx, contextID, synccontext_object->parent_object->backend_object, source_folder_object->backend_object, mem_ctx, 1, &sourceMID, &destMID, &change_key, false);
+
+		/* The change number of the new message is only known by the backend */
+		emsmdbp_folder_drop_cn_index(emsmdbp_ctx, owner, synccontext_object->parent_object->object.folder->folderID);
+		mapistore_indexing_record_del_cn(emsmdbp_ctx->mstore_ctx, owner, sourceMID);
 	}
 	else {
 		DEBUG(0, ("["__location__"] - mapistore support not implemented yet - shouldn't occur\n"));
@@ -604,6 +604,9 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSaveChangesMessage(TALLOC_CTX *mem_ctx,
 	case false:
 		retval = openchangedb_message_save(emsmdbp_ctx->oc_ctx, object->backend_object, flags);
 		DEBUG(0, ("[%s:%d]: openchangedb_save_message: retval = 0x%x\n", __FUNCTION__, __LINE__, retval));
+		if (retval == MAPI_E_SUCCESS) {
+			emsmdbp_object_message_index_cn(emsmdbp_ctx, object);
+		}
 		break;
 	case true:
                 contextID = emsmdbp_get_contextID(object);
@@ -615,6 +618,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSaveChangesMessage(TALLOC_CTX *mem_ctx,
 		}
 		owner = emsmdbp_get_owner(object);
 		mapistore_indexing_record_add_mid(emsmdbp_ctx->mstore_ctx, contextID, owner, messageID);
+		emsmdbp_object_message_index_cn(emsmdbp_ctx, object);
 		break;
 	}
 
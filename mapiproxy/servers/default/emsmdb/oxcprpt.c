@@ -622,6 +622,10 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopOpenStream(TALLOC_CTX *mem_ctx,
 			DLIST_REMOVE(parent_object->stream_data, stream_data);
 			talloc_free(stream_data);
 		}
+		else if (emsmdbp_object_stream_open_backend(object)) {
+			/* Large bodies and attachments are read by chunks on demand */
+			DEBUG(5, ("  property 0x%.8x streamed from the backend\n", request->PropertyTag));
+		}
 		else {
 			properties.cValues = 1;
 			properties.aulPropTag = &request->PropertyTag;
@@ -633,9 +637,10 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopOpenStream(TALLOC_CTX *mem_ctx,
 				goto end;
 			}
 			if (retvals[0] == MAPI_E_SUCCESS) {
-				stream_data = emsmdbp_stream_data_from_value(data_pointers, request->PropertyTag, data_pointers[0], object->object.stream->read_write);
+				/* The stream outlives the transaction memory the
+				 * property was fetched on */
+				stream_data = emsmdbp_stream_data_from_value(object->object.stream, request->PropertyTag, data_pointers[0], object->object.stream->read_write);
 				object->object.stream->stream.buffer = stream_data->data;
-				(void) talloc_reference(object, stream_data);
 				talloc_free(data_pointers);
 				talloc_free(retvals);
 			}
@@ -654,7 +659,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopOpenStream(TALLOC_CTX *mem_ctx,
 		object->object.stream->stream.buffer.length = 0;
 	}
 
-	mapi_repl->u.mapi_OpenStream.StreamSize = object->object.stream->stream.buffer.length;
+	mapi_repl->u.mapi_OpenStream.StreamSize = emsmdbp_object_stream_get_size(object);
 
 	retval = mapi_handles_add(emsmdbp_ctx->handles_ctx, handle, &rec);
 	(void) talloc_reference(rec, object);
@@ -741,7 +746,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopReadStream(TALLOC_CTX *mem_ctx,
 		}
 	}
 
-        mapi_repl->u.mapi_ReadStream.data = emsmdbp_stream_read_buffer(&object->object.stream->stream, buffer_size);
+	mapi_repl->u.mapi_ReadStream.data = emsmdbp_object_stream_read(mem_ctx, object, buffer_size);
 
 end:
 	*size += libmapiserver_RopReadStream_size(mapi_repl);
@@ -816,11 +821,14 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopWriteStream(TALLOC_CTX *mem_ctx,
 
 	request = &mapi_req->u.mapi_WriteStream;
 	if (request->data.length > 0) {
-                emsmdbp_stream_write_buffer(object->object.stream, &object->object.stream->stream, request->data);
+		retval = emsmdbp_object_stream_write(object, request->data);
+		if (retval) {
+			mapi_repl->error_code = retval;
+			goto end;
+		}
 		mapi_repl->u.mapi_WriteStream.WrittenSize = request->data.length;
 	}
 
-	object->object.stream->needs_commit = true;
 end:
 	*size += libmapiserver_RopWriteStream_size(mapi_repl);
 
@@ -848,6 +856,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopCommitStream(TALLOC_CTX *mem_ctx,
 						 uint32_t *handles, uint16_t *size)
 {
 	enum MAPISTATUS			retval;
+	int				ret;
 	struct mapi_handles		*rec = NULL;
 	struct emsmdbp_object		*object = NULL;
 	uint32_t			handle;
@@ -889,7 +898,10 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopCommitStream(TALLOC_CTX *mem_ctx,
 		goto end;
 	}
 
-	emsmdbp_object_stream_commit(object);
+	ret = emsmdbp_object_stream_commit(object);
+	if (ret != MAPISTORE_SUCCESS) {
+		mapi_repl->error_code = mapistore_error_to_mapi(ret);
+	}
 
 end:
 	*size += libmapiserver_RopCommitStream_size(mapi_repl);
@@ -954,7 +966,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopGetStreamSize(TALLOC_CTX *mem_ctx,
 		goto end;
 	}
 
-	mapi_repl->u.mapi_GetStreamSize.StreamSize = object->object.stream->stream.buffer.length;
+	mapi_repl->u.mapi_GetStreamSize.StreamSize = emsmdbp_object_stream_get_size(object);
 
 end:
 	*size += libmapiserver_RopGetStreamSize_size(mapi_repl);
@@ -987,7 +999,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSeekStream(TALLOC_CTX *mem_ctx,
 	struct mapi_handles		*parent = NULL;
 	void				*private_data;
 	struct emsmdbp_object		*object = NULL;
-	uint32_t			handle, new_position;
+	uint32_t			handle, new_position, stream_size;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCPRPT] SeekStream (0x2e)\n"));
 
@@ -1019,6 +1031,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSeekStream(TALLOC_CTX *mem_ctx,
 		goto end;
 	}
 
+	stream_size = emsmdbp_object_stream_get_size(object);
 	switch (mapi_req->u.mapi_SeekStream.Origin) {
 	case 0: /* beginning */
 		new_position = 0;
@@ -1027,7 +1040,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSeekStream(TALLOC_CTX *mem_ctx,
 		new_position = object->object.stream->stream.position;
 		break;
 	case 2: /* end */
-		new_position = object->object.stream->stream.buffer.length;
+		new_position = stream_size;
 		break;
 	default:
 		mapi_repl->error_code = MAPI_E_INVALID_PARAMETER;
@@ -1035,7 +1048,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSeekStream(TALLOC_CTX *mem_ctx,
 	}
 
 	new_position += mapi_req->u.mapi_SeekStream.Offset;
-	if (new_position < object->object.stream->stream.buffer.length + 1) {
+	if (new_position < stream_size + 1) {
 		object->object.stream->stream.position = new_position;
 		mapi_repl->u.mapi_SeekStream.NewPosition = new_position;
 	}
@@ -349,9 +349,44 @@ end:
 }
 
 
+struct emsmdbp_QueryRows_ctx {
+	struct emsmdbp_context	*emsmdbp_ctx;
+	struct emsmdbp_object	*object;
+};
+
+/**
+   \details Retrieve and serialize table rows for
+   libmapiserver_RopQueryRows_fill
+ */
+static uint32_t emsmdbp_QueryRows_get_rows(TALLOC_CTX *mem_ctx, void *private_data,
+					   uint32_t start, uint32_t count, DATA_BLOB *rows_data)
+{
+	struct emsmdbp_QueryRows_ctx	*ctx = (struct emsmdbp_QueryRows_ctx *) private_data;
+	struct emsmdbp_object_table	*table = ctx->object->object.table;
+	struct emsmdbp_table_row	*rows;
+	uint32_t			i;
+
+	rows = emsmdbp_object_table_get_rows_props(mem_ctx, ctx->emsmdbp_ctx, ctx->object, start, count, MAPISTORE_PREFILTERED_QUERY);
+	if (!rows) {
+		return 0;
+	}
+
+	for (i = 0; i < count && rows[i].data_pointers; i++) {
+		emsmdbp_fill_table_row_blob(mem_ctx, ctx->emsmdbp_ctx, &rows_data[i],
+					    table->prop_count, table->properties,
+					    rows[i].data_pointers, rows[i].retvals);
+	}
+	talloc_free(rows);
+
+	return i;
+}
+
+
 /**
    \details EcDoRpc QueryRows (0x15) Rop. This operation retrieves
-   rows from a table.
+   rows from a table, forward or backward from the cursor. Fewer rows
+   than requested are returned when the next one would not fit in the
+   ROP output buffer.
 
    \param mem_ctx pointer to the memory context
    \param emsmdbp_ctx pointer to the emsmdb provider context
@@ -372,13 +407,12 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryRows(TALLOC_CTX *mem_ctx,
 	struct emsmdbp_object_table	*table;
 	struct QueryRows_req		*request;
 	struct QueryRows_repl		*response;
+	struct emsmdbp_QueryRows_ctx	rows_ctx;
 	enum MAPISTATUS			retval;
 	void				*data;
-	enum MAPISTATUS			*retvals;
-	void				**data_pointers;
-	uint32_t			count, max;
 	uint32_t			handle;
-	uint32_t			i = 0;
+	uint32_t			position;
+	uint16_t			max_size;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCTABL] QueryRows (0x15)\n"));
 
@@ -426,54 +460,38 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryRows(TALLOC_CTX *mem_ctx,
 
 	table = object->object.table;
 
-	count = 0;
+	mapi_repl->error_code = MAPI_E_SUCCESS;
+	position = table->numerator;
 	if (table->ulType == MAPISTORE_RULE_TABLE) {
 		DEBUG(5, ("  query on rules table are all faked right now\n"));
-		goto finish;
-	}
-
-	/* Ensure we are in a case which we can handle, until the featureset is complete. */
-	if (!request->ForwardRead) {
-		DEBUG(0, ("  !ForwardRead is not supported yet\n"));
-		abort();
-	}
-
-        /* Lookup the properties */
-	max = table->numerator + request->RowCount;
-	if (max > table->denominator) {
-		max = table->denominator;
-	}
-        for (i = table->numerator; i < max; i++) {
-		data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, object, i, MAPISTORE_PREFILTERED_QUERY, &retvals);
-		if (data_pointers) {
-			emsmdbp_fill_table_row_blob(mem_ctx, emsmdbp_ctx,
-						    &response->RowData, table->prop_count,
-						    table->properties, data_pointers, retvals);
-			talloc_free(retvals);
-			talloc_free(data_pointers);
-			count++;
-		}
-		else {
-			count = 0;
-			goto finish;
+		response->RowCount = 0;
+		response->RowData.data = NULL;
+	} else {
+		/* Return as many rows as fit in the ROP output buffer */
+		rows_ctx.emsmdbp_ctx = emsmdbp_ctx;
+		rows_ctx.object = object;
+		max_size = (emsmdbp_ctx->rop_buffer_size > *size) ? (emsmdbp_ctx->rop_buffer_size - *size) : 0;
+		mapi_repl->error_code = libmapiserver_RopQueryRows_fill(mem_ctx, mapi_repl, max_size,
+									request->ForwardRead, request->RowCount,
+									&position, table->denominator,
+									emsmdbp_QueryRows_get_rows, &rows_ctx);
+		if (mapi_repl->error_code != MAPI_E_SUCCESS) {
+			DEBUG(5, ("  unable to fill rows in %d bytes: 0x%.8x\n", max_size, mapi_repl->error_code));
+			goto end;
 		}
 	}
 
-finish:
 	if ((request->QueryRowsFlags & TBL_NOADVANCE) != TBL_NOADVANCE) {
-		table->numerator = i;
+		table->numerator = position;
 	}
 
 	/* QueryRows reply parameters */
-	mapi_repl->error_code = MAPI_E_SUCCESS;
-	response->RowCount = count;
-	if (count) {
-		if ((count < request->RowCount) || (table->numerator > (table->denominator - 2))) {
-			response->Origin = BOOKMARK_END;
+	if (response->RowCount) {
+		if (request->ForwardRead) {
+			response->Origin = (position >= table->denominator) ? BOOKMARK_END : BOOKMARK_CURRENT;
 		} else {
-			response->Origin = BOOKMARK_CURRENT;
+			response->Origin = position ? BOOKMARK_CURRENT : BOOKMARK_BEGINNING;
 		}
-		/* dump_data(0, response.RowData.data, response.RowData.length); */
 	} else {
 		/* useless code for the moment */
 		if (table->restricted) {
@@ -676,6 +694,52 @@ end:
 }
 
 
+/**
+   \details Fetch the next rows matching the FindRow restriction and
+   move the table cursor to the first one
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param object pointer to the table object
+   \param max_count maximum number of rows to fetch
+   \param rowsp pointer on the fetched rows, to be released by the
+   caller
+
+   \return Pointer to the first matching row, otherwise NULL
+ */
+static struct emsmdbp_table_row *oxctabl_findrow_fetch(struct emsmdbp_context *emsmdbp_ctx,
+						       struct emsmdbp_object *object,
+						       uint32_t max_count,
+						       struct emsmdbp_table_row **rowsp)
+{
+	struct emsmdbp_object_table	*table = object->object.table;
+	struct emsmdbp_table_row	*rows;
+	uint32_t			count;
+	uint32_t			i;
+
+	count = table->denominator - table->numerator;
+	if (count > max_count) {
+		count = max_count;
+	}
+
+	*rowsp = NULL;
+	rows = emsmdbp_object_table_get_rows_props(NULL, emsmdbp_ctx, object, table->numerator, count, MAPISTORE_LIVEFILTERED_QUERY);
+	if (!rows) {
+		table->numerator = table->denominator;
+		return NULL;
+	}
+	*rowsp = rows;
+
+	for (i = 0; i < count; i++) {
+		if (rows[i].data_pointers) {
+			table->numerator += i;
+			return &rows[i];
+		}
+	}
+	table->numerator += count;
+
+	return NULL;
+}
+
 /**
    \details EcDoRpc FindRow (0x4f) Rop. This operation moves the
    cursor to a row in a table that matches specific search criteria.
@@ -704,12 +768,15 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 	void				*data = NULL;
 	enum MAPISTATUS			*retvals;
 	void				**data_pointers;
+	struct emsmdbp_table_row	*rows;
+	struct emsmdbp_table_row	*row_data;
 	uint32_t			handle;
 	DATA_BLOB			row;
 	uint32_t			property;
 	uint8_t				flagged;
 	uint8_t				status = 0;
 	uint32_t			i;
+	uint32_t			batch;
 	bool				found = false;
 
 	DEBUG(4, ("exchange_emsmdb: [OXCTABL] FindRow (0x4f)\n"));
@@ -780,14 +847,21 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 		if (mretval != MAPISTORE_SUCCESS) {
 			DEBUG(5, ("[%s:%d] mapistore_table_set_restrictions: %s\n", __FUNCTION__, __LINE__, mapistore_errstr(mretval)));
 		}
-		/* Then fetch rows */
+		/* Then fetch rows. The first row is fetched alone, as it
+		 * often matches, and the next ones in batches when the
+		 * backend can fetch them in a single call */
 		/* Lookup the properties and check if we need to flag the PropertyRow blob */
-
+		batch = 1;
 		while (!found && table->numerator < table->denominator) {
                         flagged = 0;
 
-			data_pointers = emsmdbp_object_table_get_row_props(NULL, emsmdbp_ctx, object, table->numerator, MAPISTORE_LIVEFILTERED_QUERY, &retvals);
-			if (data_pointers) {
+			row_data = oxctabl_findrow_fetch(emsmdbp_ctx, object, batch, &rows);
+			if (!row_data && mapistore_table_get_rows_batched(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(object))) {
+				batch = EMSMDBP_FINDROW_FETCH_BATCH;
+			}
+			if (row_data) {
+				data_pointers = row_data->data_pointers;
+				retvals = row_data->retvals;
 				found = true;
 				for (i = 0; i < table->prop_count; i++) {
 					if (retvals[i] != MAPI_E_SUCCESS) {
@@ -822,12 +896,8 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 								    property, data, &row,
 								    flagged?PT_ERROR:0, flagged, 0);
 				}
-				talloc_free(retvals);
-				talloc_free(data_pointers);
-                        }
-                        else {
-				table->numerator++;
 			}
+			talloc_free(rows);
 		}
 
 		mretval = mapistore_table_set_restrictions(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(object), object->backend_object, NULL, &status);
@@ -851,13 +921,16 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 		DEBUG(0, ("FindRow for openchangedb\n"));
 		/* Restrict rows to be fetched */
 		retval = openchangedb_table_set_restrictions(emsmdbp_ctx->oc_ctx, object->backend_object, &request.res);
-		/* Then fetch rows */
+		/* Then fetch rows, one at a time as each of them opens a
+		 * row object */
 		/* Lookup the properties and check if we need to flag the PropertyRow blob */
 		while (!found && table->numerator < table->denominator) {
                         flagged = 0;
 
-			data_pointers = emsmdbp_object_table_get_row_props(NULL, emsmdbp_ctx, object, table->numerator, MAPISTORE_LIVEFILTERED_QUERY, &retvals);
-			if (data_pointers) {
+			row_data = oxctabl_findrow_fetch(emsmdbp_ctx, object, 1, &rows);
+			if (row_data) {
+				data_pointers = row_data->data_pointers;
+				retvals = row_data->retvals;
 				found = true;
 				for (i = 0; i < table->prop_count; i++) {
 					if (retvals[i] != MAPI_E_SUCCESS) {
@@ -892,11 +965,8 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopFindRow(TALLOC_CTX *mem_ctx,
 								    property, data, &row,
 								    flagged?PT_ERROR:0, flagged, 0);
 				}
-				talloc_free(retvals);
-				talloc_free(data_pointers);
-                        } else {
-				table->numerator++;
 			}
+			talloc_free(rows);
 		}
 		/* Reset restrictions */
 		openchangedb_table_set_restrictions(emsmdbp_ctx->oc_ctx, object->backend_object, NULL);
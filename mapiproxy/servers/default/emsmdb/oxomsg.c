@@ -126,6 +126,7 @@ static void oxomsg_mapistore_handle_message_relocation(struct emsmdbp_context *e
 
 		mapistore_message_save(emsmdbp_ctx->mstore_ctx, contextID, message_object->backend_object, mem_ctx);
 		mapistore_indexing_record_add_mid(emsmdbp_ctx->mstore_ctx, contextID, owner, messageID);
+		emsmdbp_object_message_index_cn(emsmdbp_ctx, message_object);
 	}
 
 	talloc_free(mem_ctx);
@@ -200,21 +201,17 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSubmitMessage(TALLOC_CTX *mem_ctx,
 		{
 			struct mapi_handles 	*handles;
 
-			for (handles = emsmdbp_ctx->handles_ctx->handles; handles; handles = handles->next) {
-				if (handles->parent_handle == rec->handle) {
-					struct emsmdbp_object	*object2 = NULL;
-					void			*private_data2;
-					struct mapi_handles	*rec2 = NULL;
-
-					retval = mapi_handles_search(emsmdbp_ctx->handles_ctx, handles->handle, &rec2);
-					if (retval) {
-						continue;
-					}
-					retval = mapi_handles_get_private_data(rec2, &private_data2);
-					object2 = (struct emsmdbp_object *)private_data2;
-					if (object2->type == EMSMDBP_OBJECT_STREAM) {
-						emsmdbp_object_stream_commit(object2);
-					}
+			for (handles = rec->children; handles; handles = handles->next) {
+				struct emsmdbp_object	*object2 = NULL;
+				void			*private_data2;
+
+				retval = mapi_handles_get_private_data(handles, &private_data2);
+				if (retval) {
+					continue;
+				}
+				object2 = (struct emsmdbp_object *)private_data2;
+				if (object2->type == EMSMDBP_OBJECT_STREAM) {
+					emsmdbp_object_stream_commit(object2);
 				}
 			}
 		}
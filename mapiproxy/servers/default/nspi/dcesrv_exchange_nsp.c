@@ -28,30 +28,18 @@
 #include "mapiproxy/dcesrv_mapiproxy.h"
 #include "dcesrv_exchange_nsp.h"
 
-static struct exchange_nsp_session	*nsp_session = NULL;
+static struct mpm_session_registry	*nsp_sessions = NULL;
 static TDB_CONTEXT			*emsabp_tdb_ctx = NULL;
-
-static struct exchange_nsp_session *dcesrv_find_nsp_session(struct GUID *uuid)
-{
-	struct exchange_nsp_session	*session, *found_session = NULL;
-
-	for (session = nsp_session; !found_session && session; session = session->next) {
-		if (GUID_equal(uuid, &session->uuid)) {
-			found_session = session;
-		}
-	}
-
-	return found_session;
-}
+static struct emsabp_gal		*emsabp_gal_list = NULL;
 
 static struct emsabp_context *dcesrv_find_emsabp_context(struct GUID *uuid)
 {
-	struct exchange_nsp_session	*session;
+	struct mpm_session		*session;
 	struct emsabp_context		*emsabp_ctx = NULL;
 
-	session = dcesrv_find_nsp_session(uuid);
+	session = mpm_session_registry_find(nsp_sessions, uuid);
 	if (session) {
-		emsabp_ctx = (struct emsabp_context *)session->session->private_data;;
+		emsabp_ctx = (struct emsabp_context *)session->private_data;
 	}
 
 	return emsabp_ctx;
@@ -82,6 +70,55 @@ static void dcesrv_make_ptyp_error_property_row(TALLOC_CTX* mem_ctx,
 }
 
 
+/**
+   \details Return the GAL snapshot shared by the NSPI sessions of the
+   user organization, loading it on first use
+
+   \param lp_ctx pointer to the loadparm context
+   \param emsabp_ctx pointer to the EMSABP context of the session
+
+   \return the GAL snapshot on success, NULL if it is disabled or could
+   not be loaded
+ */
+static struct emsabp_gal *dcesrv_nsp_get_gal(struct loadparm_context *lp_ctx,
+					      struct emsabp_context *emsabp_ctx)
+{
+	enum MAPISTATUS		retval;
+	struct emsabp_gal	*gal;
+
+	if (!lpcfg_parm_bool(lp_ctx, NULL, "exchange_nsp", "gal_snapshot", true)) {
+		return NULL;
+	}
+	if (!emsabp_ctx->organization_name) {
+		return NULL;
+	}
+
+	for (gal = emsabp_gal_list; gal; gal = gal->next) {
+		if (!strcmp(gal->organization_name, emsabp_ctx->organization_name)) {
+			return gal;
+		}
+	}
+
+	gal = emsabp_gal_init(NULL);
+	if (!gal) return NULL;
+
+	gal->organization_name = talloc_strdup(gal, emsabp_ctx->organization_name);
+	gal->refresh_interval = lpcfg_parm_int(lp_ctx, NULL, "exchange_nsp", "gal_refresh_interval", 60);
+	gal->reload_interval = lpcfg_parm_int(lp_ctx, NULL, "exchange_nsp", "gal_reload_interval", 3600);
+
+	retval = emsabp_gal_load(emsabp_ctx, gal, true);
+	if (retval != MAPI_E_SUCCESS || !gal->organization_name) {
+		DEBUG(0, ("exchange_nsp: unable to load the GAL snapshot of %s: %s\n",
+			  emsabp_ctx->organization_name, mapi_get_errstr(retval)));
+		talloc_free(gal);
+		return NULL;
+	}
+	DLIST_ADD(emsabp_gal_list, gal);
+
+	return gal;
+}
+
+
 /**
    \details exchange_nsp NspiBind (0x0) function, Initiates a NSPI
    session with the client.
@@ -105,7 +142,7 @@ static void dcesrv_NspiBind(struct dcesrv_call_state *dce_call,
 	struct emsabp_context		*emsabp_ctx;
 	struct dcesrv_handle		*handle;
 	struct policy_handle		wire_handle;
-	struct exchange_nsp_session	*session;
+	struct mpm_session		*session;
 
 	DEBUG(5, ("exchange_nsp: NspiBind (0x0)\n"));
 
@@ -158,6 +195,9 @@ static void dcesrv_NspiBind(struct dcesrv_call_state *dce_call,
 		DCESRV_NSP_RETURN(r, MAPI_E_UNKNOWN_CPID, emsabp_tdb_ctx);
 	}
 
+	/* Browse the GAL from the snapshot shared by the organization sessions */
+	emsabp_ctx->gal = dcesrv_nsp_get_gal(dce_call->conn->dce_ctx->lp_ctx, emsabp_ctx);
+
 	/* Step 4. Retrieve OpenChange server GUID */
 	guid = (struct GUID *) samdb_ntds_objectGUID(emsabp_ctx->samdb_ctx);
 	if (!guid) {
@@ -174,32 +214,36 @@ static void dcesrv_NspiBind(struct dcesrv_call_state *dce_call,
 	*r->out.handle = handle->wire_handle;
 	r->out.mapiuid = guid;
 
+	/* Evict sessions left behind by clients which never unbound */
+	mpm_session_registry_expire(nsp_sessions, time(NULL));
+
 	/* Search for an existing session and increment ref_count, otherwise create it */
-	session = dcesrv_find_nsp_session(&handle->wire_handle.uuid);
+	session = mpm_session_registry_find(nsp_sessions, &handle->wire_handle.uuid);
 	if (session) {
-		mpm_session_increment_ref_count(session->session);
-		DEBUG(5, ("  [unexpected]: existing nsp_session: %p; session: %p (ref++)\n", session, session->session));
+		mpm_session_increment_ref_count(session);
+		DEBUG(5, ("  [unexpected]: existing nsp_session: %p (ref++)\n", session));
 	}
 	else {
 		DEBUG(5, ("%s: Creating new session\n", __func__));
 
 		/* Step 6. Associate this emsabp context to the session */
-		session = talloc((TALLOC_CTX *)nsp_session, struct exchange_nsp_session);
+		session = mpm_session_init((TALLOC_CTX *)nsp_sessions, dce_call);
 		if (!session) {
 			DCESRV_NSP_RETURN(r, MAPI_E_NOT_ENOUGH_RESOURCES, emsabp_ctx);
 		}
 
-		session->session = mpm_session_init((TALLOC_CTX *)nsp_session, dce_call);
-		if (!session->session) {
+		mpm_session_set_private_data(session, (void *) emsabp_ctx);
+		mpm_session_set_destructor(session, emsabp_destructor);
+
+		if (!mpm_session_registry_add(nsp_sessions, &handle->wire_handle.uuid, session)) {
+			talloc_free(session);
 			DCESRV_NSP_RETURN(r, MAPI_E_NOT_ENOUGH_RESOURCES, emsabp_ctx);
 		}
+	}
 
-		session->uuid = handle->wire_handle.uuid;
-
-		mpm_session_set_private_data(session->session, (void *) emsabp_ctx);
-		mpm_session_set_destructor(session->session, emsabp_destructor);
-
-		DLIST_ADD_END(nsp_session, session, struct exchange_nsp_session *);
+	/* The session can't expire while the client holds the handle */
+	if (mpm_session_registry_hold(nsp_sessions, &handle->wire_handle.uuid, handle) != MAPI_E_SUCCESS) {
+		DEBUG(1, ("exchange_nsp: Unable to hold session %p\n", session));
 	}
 
 	DCESRV_NSP_RETURN(r, MAPI_E_SUCCESS, NULL);
@@ -219,8 +263,7 @@ static void dcesrv_NspiUnbind(struct dcesrv_call_state *dce_call,
 					 struct NspiUnbind *r)
 {
 	struct dcesrv_handle		*h;
-	struct exchange_nsp_session	*session;
-	bool				ret;
+	enum MAPISTATUS			retval;
 
 	DEBUG(5, ("exchange_nsp: NspiUnbind (0x1)\n"));
 
@@ -233,20 +276,19 @@ static void dcesrv_NspiUnbind(struct dcesrv_call_state *dce_call,
 	/* Step 1. Retrieve handle and free if emsabp context and session are available */
 	h = dcesrv_handle_fetch(dce_call->context, r->in.handle, DCESRV_HANDLE_ANY);
 	if (h) {
-		session = dcesrv_find_nsp_session(&r->in.handle->uuid);
-		if (session) {
-			ret = mpm_session_release(session->session);
-			if (ret == true) {
-				DLIST_REMOVE(nsp_session, session);
-				DEBUG(5, ("[%s:%d]: Session found and released\n",
-					  __FUNCTION__, __LINE__));
-			} else {
-				DEBUG(5, ("[%s:%d]: Session found and ref_count decreased\n",
-					  __FUNCTION__, __LINE__));
-			}
-		}
-		else {
+		retval = mpm_session_registry_release(nsp_sessions, &r->in.handle->uuid);
+		switch (retval) {
+		case MAPI_E_SUCCESS:
+			DEBUG(5, ("[%s:%d]: Session found and released\n",
+				  __FUNCTION__, __LINE__));
+			break;
+		case MAPI_E_UNABLE_TO_COMPLETE:
+			DEBUG(5, ("[%s:%d]: Session found and ref_count decreased\n",
+				  __FUNCTION__, __LINE__));
+			break;
+		default:
 			DEBUG(5, ("  nsp_session NOT found\n"));
+			break;
 		}
 	}
 
@@ -427,18 +469,27 @@ static void dcesrv_NspiQueryRows(struct dcesrv_call_state *dce_call,
 	/* Step 2. Fill ppRows  */
 	if (r->in.lpETable == NULL) {
 		/* Step 2.1 Fill ppRows for supplied Container ID */
-		struct ldb_result	*ldb_res;
-		
-		retval = emsabp_ab_container_enum(mem_ctx, emsabp_ctx,
-						  r->in.pStat->ContainerID, &ldb_res);
-		if (retval != MAPI_E_SUCCESS)  {
-			goto failure;
+		struct ldb_result	*ldb_res = NULL;
+		struct emsabp_gal	*gal;
+		uint32_t		total;
+
+		/* The GAL is paged from the snapshot, other containers from AD */
+		gal = emsabp_gal_sync(emsabp_ctx, r->in.pStat->ContainerID);
+		if (gal) {
+			total = emsabp_gal_count(gal);
+		} else {
+			retval = emsabp_ab_container_enum(mem_ctx, emsabp_ctx,
+							  r->in.pStat->ContainerID, &ldb_res);
+			if (retval != MAPI_E_SUCCESS)  {
+				goto failure;
+			}
+			total = ldb_res->count;
 		}
-	
-		if ((ldb_res->count - r->in.pStat->NumPos) < 0) {
+
+		if (total <= r->in.pStat->NumPos) {
 			count = 0;
 		} else {
-			count = ldb_res->count - r->in.pStat->NumPos;
+			count = total - r->in.pStat->NumPos;
 		}
 
 		if (r->in.Count < count) {
@@ -451,8 +502,14 @@ static void dcesrv_NspiQueryRows(struct dcesrv_call_state *dce_call,
 
 		/* fetch required attributes for every entry found */
 		for (i = 0; i < count; i++) {
-			retval = emsabp_fetch_attrs_from_msg(mem_ctx, emsabp_ctx, pRows->aRow + i,
-							     ldb_res->msgs[i+r->in.pStat->NumPos], 0, r->in.dwFlags, pPropTags);
+			if (gal) {
+				retval = emsabp_fetch_attrs_from_gal(mem_ctx, emsabp_ctx, pRows->aRow + i,
+								     emsabp_gal_entry_at(gal, i + r->in.pStat->NumPos),
+								     r->in.dwFlags, pPropTags);
+			} else {
+				retval = emsabp_fetch_attrs_from_msg(mem_ctx, emsabp_ctx, pRows->aRow + i,
+								     ldb_res->msgs[i+r->in.pStat->NumPos], 0, r->in.dwFlags, pPropTags);
+			}
 			if (retval != MAPI_E_SUCCESS) {
 				goto failure;
 			}
@@ -511,6 +568,8 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call,
 	uint32_t			row;
 	struct PropertyTagArray_r	*mids, *all_mids;
 	struct Restriction_r		*seek_restriction;
+	struct emsabp_gal		*gal = NULL;
+	uint32_t			count, matches, i;
 
 	DEBUG(3, ("exchange_nsp: NspiSeekEntries (0x4)\n"));
 
@@ -530,34 +589,61 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call,
 		goto end;
 	}
 
-	if (r->in.lpETable) {
-		all_mids = r->in.lpETable;
-	}
-	else {
-		all_mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
-		emsabp_search(mem_ctx, emsabp_ctx, all_mids, NULL, r->in.pStat, 0);
+	if (!r->in.lpETable && ((r->in.pTarget->ulPropTag == PR_DISPLAY_NAME) ||
+				(r->in.pTarget->ulPropTag == PR_DISPLAY_NAME_UNICODE))) {
+		gal = emsabp_gal_sync(emsabp_ctx, r->in.pStat->ContainerID);
 	}
 
-	/* find the records matching the qualifier */
-	seek_restriction = talloc_zero(mem_ctx, struct Restriction_r);
-	seek_restriction->rt = RES_PROPERTY;
-	seek_restriction->res.resProperty.relop = RELOP_GE;
-	seek_restriction->res.resProperty.ulPropTag = r->in.pTarget->ulPropTag;
-	seek_restriction->res.resProperty.lpProp = r->in.pTarget;
+	if (gal) {
+		/* Binary search the snapshot, rows are the entries the target prefixes */
+		count = emsabp_gal_count(gal);
+		row = emsabp_gal_seek(gal, (const char *) get_PropertyValue_data(r->in.pTarget), &matches);
 
-	mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
-	if (emsabp_search(mem_ctx, emsabp_ctx, mids, seek_restriction, r->in.pStat, 0) != MAPI_E_SUCCESS) {
-		mids = all_mids;
-		retval = MAPI_E_NOT_FOUND;
-	}
+		mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+		if (row < count) {
+			r->in.pStat->CurrentRec = emsabp_gal_entry_at(gal, row)->MId;
+			mids->cValues = matches ? matches : 1;
+		} else {
+			r->in.pStat->CurrentRec = MID_END_OF_TABLE;
+			retval = MAPI_E_NOT_FOUND;
+		}
+		r->in.pStat->NumPos = row;
+		r->in.pStat->TotalRecs = count;
 
-	r->in.pStat->CurrentRec = MID_END_OF_TABLE;
-	r->in.pStat->NumPos = r->in.pStat->TotalRecs = all_mids->cValues;
-	for (row = 0; row < all_mids->cValues; row++) {
-		if (all_mids->aulPropTag[row] == mids->aulPropTag[0]) {
-			r->in.pStat->CurrentRec = mids->aulPropTag[0];
-			r->in.pStat->NumPos = row;
-			break;
+		mids->aulPropTag = talloc_array(mids, uint32_t, mids->cValues);
+		for (i = 0; i < mids->cValues; i++) {
+			mids->aulPropTag[i] = emsabp_gal_entry_at(gal, row + i)->MId;
+		}
+	} else {
+		if (r->in.lpETable) {
+			all_mids = r->in.lpETable;
+		}
+		else {
+			all_mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+			emsabp_search(mem_ctx, emsabp_ctx, all_mids, NULL, r->in.pStat, 0);
+		}
+
+		/* find the records matching the qualifier */
+		seek_restriction = talloc_zero(mem_ctx, struct Restriction_r);
+		seek_restriction->rt = RES_PROPERTY;
+		seek_restriction->res.resProperty.relop = RELOP_GE;
+		seek_restriction->res.resProperty.ulPropTag = r->in.pTarget->ulPropTag;
+		seek_restriction->res.resProperty.lpProp = r->in.pTarget;
+
+		mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+		if (emsabp_search(mem_ctx, emsabp_ctx, mids, seek_restriction, r->in.pStat, 0) != MAPI_E_SUCCESS) {
+			mids = all_mids;
+			retval = MAPI_E_NOT_FOUND;
+		}
+
+		r->in.pStat->CurrentRec = MID_END_OF_TABLE;
+		r->in.pStat->NumPos = r->in.pStat->TotalRecs = all_mids->cValues;
+		for (row = 0; row < all_mids->cValues; row++) {
+			if (all_mids->aulPropTag[row] == mids->aulPropTag[0]) {
+				r->in.pStat->CurrentRec = mids->aulPropTag[0];
+				r->in.pStat->NumPos = row;
+				break;
+			}
 		}
 	}
 
@@ -1451,10 +1537,11 @@ static NTSTATUS dcesrv_exchange_nsp_dispatch(struct dcesrv_call_state *dce_call,
 static NTSTATUS dcesrv_exchange_nsp_init(struct dcesrv_context *dce_ctx)
 {
 	DEBUG (0, ("dcesrv_exchange_nsp_init\n"));
-	/* Initialize exchange_nsp session */
-	nsp_session = talloc_zero(dce_ctx, struct exchange_nsp_session);
-	if (!nsp_session) return NT_STATUS_NO_MEMORY;
-	nsp_session->session = NULL;
+	/* Initialize exchange_nsp session registry */
+	nsp_sessions = mpm_session_registry_init(dce_ctx, "exchange_nsp",
+						 lpcfg_parm_int(dce_ctx->lp_ctx, NULL, "dcerpc_mapiproxy",
+								"session_idle_timeout", MPM_SESSION_IDLE_TIMEOUT));
+	if (!nsp_sessions) return NT_STATUS_NO_MEMORY;
 
 	/* Open a read-write pointer on the EMSABP TDB database */
 	emsabp_tdb_ctx = emsabp_tdb_init((TALLOC_CTX *)dce_ctx, dce_ctx->lp_ctx);
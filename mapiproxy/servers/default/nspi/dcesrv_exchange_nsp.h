@@ -49,14 +49,47 @@ struct emsabp_context {
 	void			*ldb_ctx;
 	TDB_CONTEXT		*tdb_ctx;
 	TDB_CONTEXT		*ttdb_ctx;
+	struct emsabp_gal	*gal;
 	TALLOC_CTX		*mem_ctx;
 };
 
-struct exchange_nsp_session {
-	struct mpm_session		*session;
-	struct GUID			uuid;
-	struct exchange_nsp_session	*prev;
-	struct exchange_nsp_session	*next;
+/**
+   Global Address List snapshot entry
+ */
+struct emsabp_gal_entry {
+	uint32_t		MId;
+	uint32_t		position;	/* index in display name order */
+	uint32_t		generation;
+	uint64_t		usn;		/* uSNChanged */
+	const char		*dn;
+	const char		*sort_key;	/* upper cased displayName */
+	struct ldb_message	*msg;
+	struct Binary_r		ephemeral_entryid;
+	struct Binary_r		permanent_entryid;
+};
+
+/**
+   Global Address List snapshot shared by the NSPI sessions of an
+   organization within a process
+ */
+struct emsabp_gal {
+	struct emsabp_gal	*prev;
+	struct emsabp_gal	*next;
+	const char		*organization_name;
+	struct emsabp_gal_entry	**entries;	/* sorted by display name */
+	struct emsabp_gal_entry	**by_dn;	/* sorted by dn, appended entries after sorted_count */
+	struct emsabp_gal_entry	**by_mid;	/* indexed by MId - EMSABP_GAL_MID_START */
+	uint32_t		count;
+	uint32_t		sorted_count;
+	uint32_t		size;
+	uint32_t		next_MId;
+	uint32_t		generation;
+	bool			full_update;
+	uint64_t		highest_usn;
+	time_t			load_time;
+	time_t			refresh_time;
+	uint32_t		refresh_interval;
+	uint32_t		reload_interval;
 };
 
 struct emsabp_MId {
@@ -106,6 +139,16 @@ struct EphemeralEntryID {
 #define	EMSABP_TDB_MID_START		0x1b28
 #define	EMSABP_TDB_TMP_MID_START	0x5000
 #define	EMSABP_TDB_DATA_REC		"MId_index"
+#define	EMSABP_TDB_VERSION_KEY		"MId_version"
+#define	EMSABP_TDB_VERSION		2
+#define	EMSABP_TDB_TMP_HASH_SIZE	10007
+
+/* MId to DN records are keyed by this tag followed by the binary MId */
+#define	EMSABP_TDB_MID_TAG		"MId:"
+#define	EMSABP_TDB_MID_KEY_LEN		(sizeof (EMSABP_TDB_MID_TAG) - 1 + sizeof (uint32_t))
+
+/* GAL snapshot MIds live above the TDB ranges */
+#define	EMSABP_GAL_MID_START		0x40000000
 
 #define DCESRV_NSP_RETURN_IF(x,r,c,ctx)		\
 do {						\
@@ -158,6 +201,20 @@ enum MAPISTATUS		emsabp_search_dn(struct emsabp_context *, const char *, struct
 enum MAPISTATUS		emsabp_search_legacyExchangeDN(struct emsabp_context *, const char *, struct ldb_message **, bool *);
 enum MAPISTATUS		emsabp_ab_fetch_filter(TALLOC_CTX *, struct emsabp_context *, uint32_t, char **);
 enum MAPISTATUS		emsabp_ab_container_enum(TALLOC_CTX *, struct emsabp_context *, uint32_t, struct ldb_result **);
+enum MAPISTATUS		emsabp_fetch_attrs_from_gal(TALLOC_CTX *, struct emsabp_context *, struct PropertyRow_r *, struct emsabp_gal_entry *, uint32_t, struct SPropTagArray *);
+enum MAPISTATUS		emsabp_gal_load(struct emsabp_context *, struct emsabp_gal *, bool);
+struct emsabp_gal	*emsabp_gal_sync(struct emsabp_context *, uint32_t);
+
+/* definitions from emsabp_gal.c */
+struct emsabp_gal	*emsabp_gal_init(TALLOC_CTX *);
+void			emsabp_gal_begin_update(struct emsabp_gal *, bool);
+enum MAPISTATUS		emsabp_gal_set_entry(struct emsabp_gal *, struct ldb_message *, const char *, uint64_t, struct emsabp_gal_entry **);
+enum MAPISTATUS		emsabp_gal_commit(struct emsabp_gal *);
+uint32_t		emsabp_gal_count(struct emsabp_gal *);
+struct emsabp_gal_entry	*emsabp_gal_entry_at(struct emsabp_gal *, uint32_t);
+struct emsabp_gal_entry	*emsabp_gal_lookup_MId(struct emsabp_gal *, uint32_t);
+struct emsabp_gal_entry	*emsabp_gal_lookup_dn(struct emsabp_gal *, const char *);
+uint32_t		emsabp_gal_seek(struct emsabp_gal *, const char *, uint32_t *);
 
 
 /* definitions from emsabp_tdb.c */
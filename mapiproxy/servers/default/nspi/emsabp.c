@@ -642,11 +642,12 @@ _PUBLIC_ enum MAPISTATUS emsabp_fetch_attrs_from_msg(TALLOC_CTX *mem_ctx,
 						     uint32_t MId, uint32_t dwFlags,
 						     struct SPropTagArray *pPropTags)
 {
-	enum MAPISTATUS	retval;
-	const char	*dn;
-	void		*data;
-	uint32_t	ulPropTag;
-	int		i;
+	enum MAPISTATUS			retval;
+	struct emsabp_gal_entry		*entry;
+	const char			*dn;
+	void				*data;
+	uint32_t			ulPropTag;
+	int				i;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!pPropTags, MAPI_E_INVALID_PARAMETER, NULL);
@@ -658,13 +659,19 @@ _PUBLIC_ enum MAPISTATUS emsabp_fetch_attrs_from_msg(TALLOC_CTX *mem_ctx,
 	if (MId == 0) {
 		dn = ldb_msg_find_attr_as_string(ldb_msg, "distinguishedName", NULL);
 		OPENCHANGE_RETVAL_IF(!dn, MAPI_E_CORRUPT_DATA, NULL);
-		retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, &MId);
-		if (retval) {
-			retval = emsabp_tdb_insert(emsabp_ctx->ttdb_ctx, dn);
-			OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, NULL);
-
+		/* Records of the GAL snapshot already have one */
+		entry = emsabp_gal_lookup_dn(emsabp_ctx->gal, dn);
+		if (entry) {
+			MId = entry->MId;
+		} else {
 			retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, &MId);
-			OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, NULL);
+			if (retval) {
+				retval = emsabp_tdb_insert(emsabp_ctx->ttdb_ctx, dn);
+				OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, NULL);
+
+				retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, &MId);
+				OPENCHANGE_RETVAL_IF(retval, MAPI_E_CORRUPT_STORE, NULL);
+			}
 		}
 	}
 
@@ -688,6 +695,74 @@ _PUBLIC_ enum MAPISTATUS emsabp_fetch_attrs_from_msg(TALLOC_CTX *mem_ctx,
 	return MAPI_E_SUCCESS;
 }
 
+
+/**
+   \details Build the SRow array entry for a record of the GAL
+   snapshot. Entry IDs are served from the blobs computed when the
+   snapshot was loaded.
+
+   \param mem_ctx pointer to the memory context
+   \param emsabp_ctx pointer to the EMSABP context
+   \param aRow pointer to the SRow structure where results will be stored
+   \param entry pointer to the GAL snapshot entry
+   \param dwFlags bit flags specifying whether or not the server must
+   return the values of the property PidTagEntryId in the Ephemeral
+   or Permanent Entry ID format
+   \param pPropTags pointer to the property tags array
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_fetch_attrs_from_gal(TALLOC_CTX *mem_ctx,
+						     struct emsabp_context *emsabp_ctx,
+						     struct PropertyRow_r *aRow,
+						     struct emsabp_gal_entry *entry,
+						     uint32_t dwFlags,
+						     struct SPropTagArray *pPropTags)
+{
+	struct Binary_r	*entryid;
+	struct Binary_r	*bin;
+	void		*data;
+	uint32_t	ulPropTag;
+	int		i;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!pPropTags, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!emsabp_ctx, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!aRow, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!entry, MAPI_E_INVALID_PARAMETER, NULL);
+
+	entryid = (dwFlags & fEphID) ? &entry->ephemeral_entryid : &entry->permanent_entryid;
+
+	aRow->Reserved = 0x0;
+	aRow->cValues = pPropTags->cValues;
+	aRow->lpProps = talloc_array(mem_ctx, struct PropertyValue_r, aRow->cValues);
+	OPENCHANGE_RETVAL_IF(!aRow->lpProps, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	for (i = 0; i < aRow->cValues; i++) {
+		ulPropTag = pPropTags->aulPropTag[i];
+		if ((ulPropTag == PR_ENTRYID || ulPropTag == PR_ORIGINAL_ENTRYID) && entryid->cb) {
+			bin = talloc(mem_ctx, struct Binary_r);
+			if (bin) {
+				bin->cb = entryid->cb;
+				bin->lpb = talloc_memdup(bin, entryid->lpb, entryid->cb);
+			}
+			data = bin;
+		} else {
+			data = emsabp_query(mem_ctx, emsabp_ctx, entry->msg, ulPropTag, entry->MId, dwFlags);
+		}
+		if (!data) {
+			ulPropTag = (ulPropTag & 0xFFFF0000) | PT_ERROR;
+		}
+
+		aRow->lpProps[i].ulPropTag = (enum MAPITAGS) ulPropTag;
+		aRow->lpProps[i].dwAlignPad = 0x0;
+		set_PropertyValue(&(aRow->lpProps[i]), data);
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+
 /**
    \details Builds the SRow array entry for the specified MId.
 
@@ -715,6 +790,7 @@ _PUBLIC_ enum MAPISTATUS emsabp_fetch_attrs(TALLOC_CTX *mem_ctx, struct emsabp_c
 					    struct SPropTagArray *pPropTags)
 {
 	enum MAPISTATUS		retval;
+	struct emsabp_gal_entry	*entry;
 	char			*dn;
 	const char * const	recipient_attrs[] = { "*", NULL };
 	struct ldb_result	*res = NULL;
@@ -724,6 +800,12 @@ _PUBLIC_ enum MAPISTATUS emsabp_fetch_attrs(TALLOC_CTX *mem_ctx, struct emsabp_c
 	void			*data;
 	int			i;
 
+	/* Records of the GAL snapshot are served from memory */
+	entry = emsabp_gal_lookup_MId(emsabp_ctx->gal, MId);
+	if (entry) {
+		return emsabp_fetch_attrs_from_gal(mem_ctx, emsabp_ctx, aRow, entry, dwFlags, pPropTags);
+	}
+
 	/* Step 0. Try to Retrieve the dn associated to the MId first from temp TDB (users) */
 	retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, emsabp_ctx->ttdb_ctx, MId, &dn);
 	if (retval != MAPI_E_SUCCESS) {
@@ -1125,6 +1207,9 @@ _PUBLIC_ enum MAPISTATUS emsabp_search(TALLOC_CTX *mem_ctx, struct emsabp_contex
 	char				*fmt_str, *expression = NULL;
 	const char			*fmt_attr;
 	char				*attr;
+	struct emsabp_gal		*gal;
+	struct emsabp_gal_entry		*entry;
+	uint32_t			count;
 
 	/* Step 0. Sanity Checks (MS-NSPI Server Processing Rules) */
 	if (pStat->SortType == SortTypePhoneticDisplayName) {
@@ -1141,6 +1226,27 @@ _PUBLIC_ enum MAPISTATUS emsabp_search(TALLOC_CTX *mem_ctx, struct emsabp_contex
 		return MAPI_E_CALL_FAILED;
 	}
 
+	/* The unrestricted GAL comes from the snapshot, in display name order */
+	gal = restriction ? NULL : emsabp_gal_sync(emsabp_ctx, pStat->ContainerID);
+	if (gal) {
+		count = emsabp_gal_count(gal);
+		if (!count) {
+			return MAPI_E_NOT_FOUND;
+		}
+		if (limit && count > limit) {
+			return MAPI_E_TABLE_TOO_BIG;
+		}
+
+		MIds->aulPropTag = (uint32_t *) talloc_array(mem_ctx, uint32_t, count);
+		OPENCHANGE_RETVAL_IF(!MIds->aulPropTag, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		MIds->cValues = count;
+		for (i = 0; i < count; i++) {
+			MIds->aulPropTag[i] = emsabp_gal_entry_at(gal, i)->MId;
+		}
+
+		return MAPI_E_SUCCESS;
+	}
+
 	/* Step 1. Apply restriction and retrieve results from AD */
 	if (restriction) {
 		/* FIXME: We only support RES_PROPERTY restriction */
@@ -1211,6 +1317,11 @@ _PUBLIC_ enum MAPISTATUS emsabp_search(TALLOC_CTX *mem_ctx, struct emsabp_contex
 	/* Step 2. Create session MId for all fetched records */
 	for (i = 0; i < res->count; i++) {
 		dn = ldb_msg_find_attr_as_string(res->msgs[i], "distinguishedName", NULL);
+		entry = emsabp_gal_lookup_dn(emsabp_ctx->gal, dn);
+		if (entry) {
+			MIds->aulPropTag[i] = entry->MId;
+			continue;
+		}
 		retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, (uint32_t *)&(MIds->aulPropTag[i]));
 		if (retval) {
 			retval = emsabp_tdb_insert(emsabp_ctx->ttdb_ctx, dn);
@@ -1436,3 +1547,148 @@ done:
 
 	return (ldb_ret != LDB_SUCCESS) ? MAPI_E_NOT_FOUND : MAPI_E_SUCCESS;
 }
+
+
+/**
+   \details Load the GAL records of the directory into a snapshot.
+
+   A full load reads the whole GAL and removes the entries which are
+   no longer part of it. Otherwise only the records changed since the
+   previous load, i.e. with a greater uSNChanged, are read: records
+   leaving the GAL are dropped by the next full load.
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param gal pointer to the GAL snapshot
+   \param full whether all records are loaded or only the changed ones
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_gal_load(struct emsabp_context *emsabp_ctx, struct emsabp_gal *gal, bool full)
+{
+	enum MAPISTATUS			retval;
+	TALLOC_CTX			*mem_ctx;
+	struct ldb_result		*res = NULL;
+	struct emsabp_gal_entry		*entry;
+	struct EphemeralEntryID		ephEntryID;
+	struct PermanentEntryID		permEntryID;
+	const char * const		recipient_attrs[] = { "*", NULL };
+	char				*filter = NULL;
+	char				*expression;
+	struct ldb_message		*msg;
+	uint64_t			usn;
+	int				ret;
+	uint32_t			i;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!emsabp_ctx, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!gal, MAPI_E_INVALID_PARAMETER, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "emsabp_gal_load");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	/* Step 1. Build the GAL filter, restricted to changed records if needed */
+	retval = emsabp_ab_fetch_filter(mem_ctx, emsabp_ctx, 0, &filter);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
+	talloc_steal(mem_ctx, filter);
+
+	if (full) {
+		expression = filter;
+	} else {
+		expression = talloc_asprintf(mem_ctx, "(&%s(uSNChanged>=%llu))", filter,
+					     (unsigned long long)(gal->highest_usn + 1));
+		OPENCHANGE_RETVAL_IF(!expression, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	}
+
+	/* Step 2. Retrieve the records from AD */
+	ret = ldb_search(emsabp_ctx->samdb_ctx, mem_ctx, &res,
+			 ldb_get_default_basedn(emsabp_ctx->samdb_ctx),
+			 LDB_SCOPE_SUBTREE, recipient_attrs, "%s", expression);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || !res, MAPI_E_CORRUPT_STORE, mem_ctx);
+
+	/* Step 3. Add them to the snapshot along with their entry IDs */
+	emsabp_gal_begin_update(gal, full);
+	for (i = 0; i < res->count; i++) {
+		msg = res->msgs[i];
+		usn = ldb_msg_find_attr_as_uint64(msg, "uSNChanged", 0);
+		retval = emsabp_gal_set_entry(gal, msg, ldb_msg_find_attr_as_string(msg, "displayName", NULL),
+					      usn, &entry);
+		if (retval != MAPI_E_SUCCESS) {
+			DEBUG(1, ("[%s:%d]: Unable to add %s to the GAL snapshot: %s\n", __FUNCTION__, __LINE__,
+				  ldb_dn_get_linearized(msg->dn), mapi_get_errstr(retval)));
+			continue;
+		}
+
+		talloc_free(entry->ephemeral_entryid.lpb);
+		entry->ephemeral_entryid.cb = 0;
+		entry->ephemeral_entryid.lpb = NULL;
+		retval = emsabp_set_EphemeralEntryID(emsabp_ctx, DT_MAILUSER, entry->MId, &ephEntryID);
+		if (retval == MAPI_E_SUCCESS) {
+			emsabp_EphemeralEntryID_to_Binary_r(entry, &ephEntryID, &entry->ephemeral_entryid);
+		}
+
+		talloc_free(entry->permanent_entryid.lpb);
+		entry->permanent_entryid.cb = 0;
+		entry->permanent_entryid.lpb = NULL;
+		retval = emsabp_set_PermanentEntryID(emsabp_ctx, DT_MAILUSER, entry->msg, &permEntryID);
+		if (retval == MAPI_E_SUCCESS) {
+			emsabp_PermanentEntryID_to_Binary_r(entry, &permEntryID, &entry->permanent_entryid);
+			talloc_free(permEntryID.dn);
+		}
+	}
+
+	if (full || res->count) {
+		retval = emsabp_gal_commit(gal);
+		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
+	}
+
+	gal->refresh_time = time(NULL);
+	if (full) {
+		gal->load_time = gal->refresh_time;
+	}
+
+	DEBUG(5, ("[%s:%d]: %s load of the GAL snapshot: %u records read, %u entries\n", __FUNCTION__, __LINE__,
+		  full ? "full" : "incremental", res->count, emsabp_gal_count(gal)));
+
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Return the GAL snapshot if it can serve the given
+   container, after refreshing it when it is older than the configured
+   intervals
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param ContainerID the container browsed by the client
+
+   \return the GAL snapshot, NULL if the container is not the GAL or
+   the snapshot is disabled
+ */
+_PUBLIC_ struct emsabp_gal *emsabp_gal_sync(struct emsabp_context *emsabp_ctx, uint32_t ContainerID)
+{
+	enum MAPISTATUS		retval;
+	struct emsabp_gal	*gal;
+	time_t			now;
+
+	if (!emsabp_ctx || !emsabp_ctx->gal || ContainerID) return NULL;
+
+	gal = emsabp_ctx->gal;
+	now = time(NULL);
+	if (gal->reload_interval && (now - gal->load_time) >= gal->reload_interval) {
+		retval = emsabp_gal_load(emsabp_ctx, gal, true);
+	} else if ((now - gal->refresh_time) >= gal->refresh_interval) {
+		retval = emsabp_gal_load(emsabp_ctx, gal, false);
+	} else {
+		retval = MAPI_E_SUCCESS;
+	}
+
+	/* A stale snapshot is still better than no answer */
+	if (retval != MAPI_E_SUCCESS) {
+		DEBUG(1, ("[%s:%d]: Unable to refresh the GAL snapshot: %s\n", __FUNCTION__, __LINE__,
+			  mapi_get_errstr(retval)));
+	}
+
+	return gal;
+}
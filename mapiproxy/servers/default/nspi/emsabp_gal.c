@@ -0,0 +1,453 @@
+/*
+   OpenChange Server implementation.
+
+   EMSABP: Address Book Provider implementation
+
+   Copyright (C) agent 2026.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   \file emsabp_gal.c
+
+   \brief In-memory Global Address List snapshot
+
+   The snapshot keeps the GAL records of the directory sorted by
+   display name, so NSPI table browsing and seeking don't need to
+   search AD. Each entry is given a MId which remains the same for the
+   lifetime of the process, and entries are looked up by MId in
+   constant time and by DN with a binary search.
+
+   Updates are applied in batches: emsabp_gal_begin_update(), one
+   emsabp_gal_set_entry() call per new or modified record, then
+   emsabp_gal_commit() which sorts the indexes again. A full update
+   removes the entries which were not set during the batch. New
+   entries are only looked up once committed, so a DN set twice in a
+   batch is merged on commit into the entry it was first given.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "dcesrv_exchange_nsp.h"
+
+#define	EMSABP_GAL_INITIAL_SIZE	1024
+
+
+static int emsabp_gal_cmp_display(const void *a, const void *b)
+{
+	const struct emsabp_gal_entry	*left = *(const struct emsabp_gal_entry **) a;
+	const struct emsabp_gal_entry	*right = *(const struct emsabp_gal_entry **) b;
+	int				ret;
+
+	ret = strcmp(left->sort_key, right->sort_key);
+	if (ret) return ret;
+
+	return strcmp(left->dn, right->dn);
+}
+
+static int emsabp_gal_cmp_dn(const void *a, const void *b)
+{
+	const struct emsabp_gal_entry	*left = *(const struct emsabp_gal_entry **) a;
+	const struct emsabp_gal_entry	*right = *(const struct emsabp_gal_entry **) b;
+
+	return strcmp(left->dn, right->dn);
+}
+
+static int emsabp_gal_cmp_dn_position(const void *a, const void *b)
+{
+	const struct emsabp_gal_entry	*left = *(const struct emsabp_gal_entry **) a;
+	const struct emsabp_gal_entry	*right = *(const struct emsabp_gal_entry **) b;
+	int				ret;
+
+	ret = strcmp(left->dn, right->dn);
+	if (ret) return ret;
+
+	return (left->position > right->position) - (left->position < right->position);
+}
+
+static char *emsabp_gal_sort_key(TALLOC_CTX *mem_ctx, const char *display_name)
+{
+	/* Case insensitive, Unicode aware ordering */
+	return talloc_strdup_upper(mem_ctx, display_name ? display_name : "");
+}
+
+
+/**
+   \details Initialize an empty GAL snapshot
+
+   \param mem_ctx pointer to the memory context
+
+   \return Allocated GAL snapshot on success, otherwise NULL
+ */
+_PUBLIC_ struct emsabp_gal *emsabp_gal_init(TALLOC_CTX *mem_ctx)
+{
+	struct emsabp_gal	*gal;
+
+	gal = talloc_zero(mem_ctx, struct emsabp_gal);
+	if (!gal) return NULL;
+
+	gal->size = EMSABP_GAL_INITIAL_SIZE;
+	gal->entries = talloc_array(gal, struct emsabp_gal_entry *, gal->size);
+	gal->by_dn = talloc_array(gal, struct emsabp_gal_entry *, gal->size);
+	gal->by_mid = talloc_zero_array(gal, struct emsabp_gal_entry *, gal->size);
+	if (!gal->entries || !gal->by_dn || !gal->by_mid) {
+		talloc_free(gal);
+		return NULL;
+	}
+	gal->next_MId = EMSABP_GAL_MID_START;
+
+	return gal;
+}
+
+
+/**
+   \details Start a batch of updates
+
+   \param gal pointer to the GAL snapshot
+   \param full whether the batch sets every record of the GAL, in which
+   case entries which are not set are removed on commit
+ */
+_PUBLIC_ void emsabp_gal_begin_update(struct emsabp_gal *gal, bool full)
+{
+	if (!gal) return;
+
+	gal->generation++;
+	gal->full_update = full;
+}
+
+
+/**
+   \details Add a record to the snapshot or update the entry with the
+   same DN. The snapshot takes ownership of the LDB message. Entries
+   added during a batch are only visible once it is committed.
+
+   \param gal pointer to the GAL snapshot
+   \param msg pointer to the LDB message of the record
+   \param display_name the display name of the record
+   \param usn the uSNChanged value of the record
+   \param entryp pointer on pointer to the entry returned by the
+   function
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_gal_set_entry(struct emsabp_gal *gal, struct ldb_message *msg,
+					      const char *display_name, uint64_t usn,
+					      struct emsabp_gal_entry **entryp)
+{
+	struct emsabp_gal_entry	*entry;
+	struct emsabp_gal_entry	**entries;
+	const char		*dn;
+	char			*sort_key;
+	uint32_t		size;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!gal, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!msg, MAPI_E_INVALID_PARAMETER, NULL);
+
+	dn = ldb_msg_find_attr_as_string(msg, "distinguishedName", NULL);
+	OPENCHANGE_RETVAL_IF(!dn, MAPI_E_CORRUPT_DATA, NULL);
+
+	entry = emsabp_gal_lookup_dn(gal, dn);
+	if (entry) {
+		/* Step 1. Update the existing entry, its MId is kept */
+		sort_key = emsabp_gal_sort_key(entry, display_name);
+		OPENCHANGE_RETVAL_IF(!sort_key, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		talloc_free(entry->msg);
+		talloc_free(discard_const_p(char, entry->sort_key));
+		entry->sort_key = sort_key;
+	} else {
+		/* Step 2. Append a new entry, the snapshot is left
+		 * unchanged if any allocation fails */
+		entry = talloc_zero(gal, struct emsabp_gal_entry);
+		OPENCHANGE_RETVAL_IF(!entry, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		entry->sort_key = emsabp_gal_sort_key(entry, display_name);
+		OPENCHANGE_RETVAL_IF(!entry->sort_key, MAPI_E_NOT_ENOUGH_MEMORY, entry);
+
+		if (gal->count == gal->size) {
+			size = gal->size * 2;
+			entries = talloc_realloc(gal, gal->entries, struct emsabp_gal_entry *, size);
+			OPENCHANGE_RETVAL_IF(!entries, MAPI_E_NOT_ENOUGH_MEMORY, entry);
+			gal->entries = entries;
+			entries = talloc_realloc(gal, gal->by_dn, struct emsabp_gal_entry *, size);
+			OPENCHANGE_RETVAL_IF(!entries, MAPI_E_NOT_ENOUGH_MEMORY, entry);
+			gal->by_dn = entries;
+			gal->size = size;
+		}
+		if (gal->next_MId - EMSABP_GAL_MID_START >= talloc_array_length(gal->by_mid)) {
+			size = talloc_array_length(gal->by_mid) * 2;
+			entries = talloc_realloc(gal, gal->by_mid, struct emsabp_gal_entry *, size);
+			OPENCHANGE_RETVAL_IF(!entries, MAPI_E_NOT_ENOUGH_MEMORY, entry);
+			memset(entries + size / 2, 0, sizeof (struct emsabp_gal_entry *) * (size / 2));
+			gal->by_mid = entries;
+		}
+
+		entry->MId = gal->next_MId++;
+		entry->position = gal->count;
+		gal->by_mid[entry->MId - EMSABP_GAL_MID_START] = entry;
+		gal->entries[gal->count] = entry;
+		gal->by_dn[gal->count] = entry;
+		gal->count++;
+	}
+
+	entry->msg = talloc_steal(entry, msg);
+	entry->dn = dn;
+	entry->usn = usn;
+	entry->generation = gal->generation;
+
+	if (usn > gal->highest_usn) {
+		gal->highest_usn = usn;
+	}
+
+	if (entryp) {
+		*entryp = entry;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Merge the entries appended more than once during the batch
+   in the first one, which keeps its MId and gets the latest record.
+   Merged entries are removed from the display name index.
+
+   \param gal pointer to the GAL snapshot
+ */
+static void emsabp_gal_merge_pending(struct emsabp_gal *gal)
+{
+	struct emsabp_gal_entry	**pending;
+	struct emsabp_gal_entry	*first;
+	struct emsabp_gal_entry	*entry;
+	uint32_t		count;
+	uint32_t		i;
+
+	count = gal->count - gal->sorted_count;
+	if (count < 2) return;
+
+	/* Pending entries are still in the order they were appended,
+	 * their position is their index in both arrays */
+	pending = gal->by_dn + gal->sorted_count;
+	qsort(pending, count, sizeof (struct emsabp_gal_entry *), emsabp_gal_cmp_dn_position);
+
+	first = pending[0];
+	for (i = 1; i < count; i++) {
+		entry = pending[i];
+		if (strcmp(first->dn, entry->dn)) {
+			first = entry;
+			continue;
+		}
+
+		talloc_free(first->msg);
+		talloc_free(discard_const_p(char, first->sort_key));
+		first->msg = talloc_steal(first, entry->msg);
+		first->dn = entry->dn;
+		first->sort_key = talloc_steal(first, entry->sort_key);
+		first->usn = entry->usn;
+		first->generation = entry->generation;
+
+		gal->by_mid[entry->MId - EMSABP_GAL_MID_START] = NULL;
+		gal->entries[entry->position] = NULL;
+		talloc_free(entry);
+	}
+}
+
+
+/**
+   \details Apply the current batch of updates: merge the entries set
+   twice, drop the entries which were not part of a full update and
+   sort the indexes
+
+   \param gal pointer to the GAL snapshot
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_gal_commit(struct emsabp_gal *gal)
+{
+	struct emsabp_gal_entry	*entry;
+	uint32_t		count = 0;
+	uint32_t		i;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!gal, MAPI_E_INVALID_PARAMETER, NULL);
+
+	/* Step 1. Merge the DNs set twice during the batch */
+	emsabp_gal_merge_pending(gal);
+
+	/* Step 2. Remove merged entries and records which are no longer
+	 * in the directory */
+	for (i = 0; i < gal->count; i++) {
+		entry = gal->entries[i];
+		if (!entry) continue;
+		if (gal->full_update && entry->generation != gal->generation) {
+			gal->by_mid[entry->MId - EMSABP_GAL_MID_START] = NULL;
+			talloc_free(entry);
+			continue;
+		}
+		gal->entries[count] = entry;
+		gal->by_dn[count] = entry;
+		count++;
+	}
+	gal->count = count;
+	gal->full_update = false;
+
+	/* Step 3. Sort by display name and DN */
+	qsort(gal->entries, gal->count, sizeof (struct emsabp_gal_entry *), emsabp_gal_cmp_display);
+	qsort(gal->by_dn, gal->count, sizeof (struct emsabp_gal_entry *), emsabp_gal_cmp_dn);
+	for (i = 0; i < gal->count; i++) {
+		gal->entries[i]->position = i;
+	}
+	gal->sorted_count = gal->count;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Return the number of entries in the snapshot
+
+   \param gal pointer to the GAL snapshot
+
+   \return number of entries
+ */
+_PUBLIC_ uint32_t emsabp_gal_count(struct emsabp_gal *gal)
+{
+	if (!gal) return 0;
+
+	return gal->sorted_count;
+}
+
+
+/**
+   \details Return the entry at a given position in display name order
+
+   \param gal pointer to the GAL snapshot
+   \param position the position of the entry
+
+   \return the entry on success, otherwise NULL
+ */
+_PUBLIC_ struct emsabp_gal_entry *emsabp_gal_entry_at(struct emsabp_gal *gal, uint32_t position)
+{
+	if (!gal || position >= gal->sorted_count) return NULL;
+
+	return gal->entries[position];
+}
+
+
+/**
+   \details Search an entry given its MId
+
+   \param gal pointer to the GAL snapshot
+   \param MId the MId to lookup
+
+   \return the entry on success, otherwise NULL
+ */
+_PUBLIC_ struct emsabp_gal_entry *emsabp_gal_lookup_MId(struct emsabp_gal *gal, uint32_t MId)
+{
+	struct emsabp_gal_entry	*entry;
+
+	if (!gal || MId < EMSABP_GAL_MID_START || MId >= gal->next_MId) return NULL;
+
+	entry = gal->by_mid[MId - EMSABP_GAL_MID_START];
+	if (!entry || entry->position >= gal->sorted_count) return NULL;
+
+	return entry;
+}
+
+
+/**
+   \details Search an entry given its distinguishedName
+
+   \param gal pointer to the GAL snapshot
+   \param dn the DN to lookup
+
+   \return the entry on success, otherwise NULL
+ */
+_PUBLIC_ struct emsabp_gal_entry *emsabp_gal_lookup_dn(struct emsabp_gal *gal, const char *dn)
+{
+	uint32_t	low = 0;
+	uint32_t	high;
+	uint32_t	middle;
+	int		ret;
+
+	if (!gal || !dn) return NULL;
+
+	high = gal->sorted_count;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		ret = strcmp(gal->by_dn[middle]->dn, dn);
+		if (ret == 0) {
+			return gal->by_dn[middle];
+		}
+		if (ret < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+   \details Find the position of the first entry whose display name is
+   greater than or equal to the target, ignoring case.
+
+   \param gal pointer to the GAL snapshot
+   \param target the display name to seek
+   \param matches pointer on the number of entries starting at the
+   returned position whose display name begins with target, may be
+   NULL
+
+   \return the position of the entry, or the number of entries if none
+   is greater than target
+ */
+_PUBLIC_ uint32_t emsabp_gal_seek(struct emsabp_gal *gal, const char *target, uint32_t *matches)
+{
+	char		*key;
+	size_t		key_length;
+	uint32_t	low = 0;
+	uint32_t	high;
+	uint32_t	middle;
+	uint32_t	i;
+
+	if (matches) {
+		*matches = 0;
+	}
+	if (!gal) return 0;
+
+	key = emsabp_gal_sort_key(gal, target);
+	if (!key) return gal->sorted_count;
+
+	high = gal->sorted_count;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (strcmp(gal->entries[middle]->sort_key, key) < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	if (matches) {
+		key_length = strlen(key);
+		for (i = low; i < gal->sorted_count; i++) {
+			if (strncmp(gal->entries[i]->sort_key, key, key_length)) break;
+		}
+		*matches = i - low;
+	}
+	talloc_free(key);
+
+	return low;
+}
@@ -23,6 +23,11 @@
    \file emsabp_tdb.c
 
    \brief EMSABP TDB database API
+
+   Each MId is stored as two records: the DN key holds the MId as a
+   32 bits little-endian integer, and EMSABP_TDB_MID_TAG followed by
+   the same integer holds the DN. EMSABP_TDB_DATA_REC holds the last
+   MId allocated.
 */
 
 #include "mapiproxy/dcesrv_mapiproxy.h"
@@ -30,13 +35,183 @@
 #include <util/debug.h>
 
 /**
-   \details Structure to be used for MId traversal within TDB
+   \details State of the conversion of a version 1 database, where
+   MIds were stored as hexadecimal strings and only the DN to MId
+   direction was indexed
  */
-struct traverse_MId {
-	uint32_t	MId;
-	bool		found;
+struct emsabp_tdb_migration {
+	uint32_t	count;
+	bool		failed;
 };
 
+
+static void emsabp_tdb_pack_MId(uint8_t *buf, uint32_t MId)
+{
+	buf[0] = MId & 0xFF;
+	buf[1] = (MId >> 8) & 0xFF;
+	buf[2] = (MId >> 16) & 0xFF;
+	buf[3] = (MId >> 24) & 0xFF;
+}
+
+static uint32_t emsabp_tdb_unpack_MId(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static TDB_DATA emsabp_tdb_string_key(const char *keyname)
+{
+	TDB_DATA	key;
+
+	key.dptr = (unsigned char *) keyname;
+	key.dsize = strlen(keyname);
+
+	return key;
+}
+
+static TDB_DATA emsabp_tdb_MId_key(uint8_t *buf, uint32_t MId)
+{
+	TDB_DATA	key;
+
+	memcpy(buf, EMSABP_TDB_MID_TAG, sizeof (EMSABP_TDB_MID_TAG) - 1);
+	emsabp_tdb_pack_MId(buf + sizeof (EMSABP_TDB_MID_TAG) - 1, MId);
+	key.dptr = buf;
+	key.dsize = EMSABP_TDB_MID_KEY_LEN;
+
+	return key;
+}
+
+static uint32_t emsabp_tdb_version(TDB_CONTEXT *tdb_ctx)
+{
+	TDB_DATA	dbuf;
+	char		*version_str;
+	uint32_t	version = 0;
+
+	dbuf = tdb_fetch(tdb_ctx, emsabp_tdb_string_key(EMSABP_TDB_VERSION_KEY));
+	if (dbuf.dptr) {
+		version_str = talloc_strndup(NULL, (const char *) dbuf.dptr, dbuf.dsize);
+		version = strtoul(version_str, NULL, 10);
+		talloc_free(version_str);
+		free(dbuf.dptr);
+	}
+
+	return version;
+}
+
+static int emsabp_tdb_set_version(TDB_CONTEXT *tdb_ctx)
+{
+	char		version_str[16];
+	TDB_DATA	dbuf;
+
+	snprintf(version_str, sizeof (version_str), "%d", EMSABP_TDB_VERSION);
+	dbuf.dptr = (unsigned char *) version_str;
+	dbuf.dsize = strlen(version_str);
+
+	return tdb_store(tdb_ctx, emsabp_tdb_string_key(EMSABP_TDB_VERSION_KEY), dbuf, TDB_REPLACE);
+}
+
+static int emsabp_tdb_set_index(TDB_CONTEXT *tdb_ctx, uint32_t MId, int flag)
+{
+	uint8_t		buf[sizeof (uint32_t)];
+	TDB_DATA	dbuf;
+
+	emsabp_tdb_pack_MId(buf, MId);
+	dbuf.dptr = buf;
+	dbuf.dsize = sizeof (buf);
+
+	return tdb_store(tdb_ctx, emsabp_tdb_string_key(EMSABP_TDB_DATA_REC), dbuf, flag);
+}
+
+/**
+   \details Convert one version 1 record in place
+
+   Version 1 MIds start at EMSABP_TDB_MID_START, so their "0x"
+   strings are longer than the 4 bytes MIds and can't be mistaken for
+   the DNs either. Records written by the conversion are therefore
+   skipped whether or not the traversal visits them.
+ */
+static int emsabp_tdb_migration_traverse(TDB_CONTEXT *tdb_ctx, TDB_DATA key, TDB_DATA dbuf, void *state)
+{
+	struct emsabp_tdb_migration	*migration = (struct emsabp_tdb_migration *) state;
+	uint8_t				buf[EMSABP_TDB_MID_KEY_LEN];
+	uint8_t				value[sizeof (uint32_t)];
+	char				MId_str[16];
+	TDB_DATA			data;
+	uint32_t			MId;
+
+	if (dbuf.dsize <= sizeof (uint32_t) || dbuf.dsize >= sizeof (MId_str) ||
+	    strncmp((const char *) dbuf.dptr, "0x", 2)) {
+		return 0;
+	}
+	memcpy(MId_str, dbuf.dptr, dbuf.dsize);
+	MId_str[dbuf.dsize] = '\0';
+	MId = strtoul(MId_str, NULL, 16);
+
+	emsabp_tdb_pack_MId(value, MId);
+	data.dptr = value;
+	data.dsize = sizeof (value);
+	if (tdb_store(tdb_ctx, key, data, TDB_REPLACE) == -1) {
+		migration->failed = true;
+		return -1;
+	}
+
+	/* The allocation index has no DN to point back to */
+	if (key.dsize == strlen(EMSABP_TDB_DATA_REC) &&
+	    !strncmp((const char *) key.dptr, EMSABP_TDB_DATA_REC, key.dsize)) {
+		return 0;
+	}
+
+	if (tdb_store(tdb_ctx, emsabp_tdb_MId_key(buf, MId), key, TDB_REPLACE) == -1) {
+		migration->failed = true;
+		return -1;
+	}
+	migration->count++;
+
+	return 0;
+}
+
+
+/**
+   \details Convert a version 1 EMSABP TDB database: MIds are stored
+   in binary form and every MId gets a record leading to its DN
+
+   Records are rewritten in place by a single traversal, within a
+   transaction so that a failure leaves the version 1 database
+   untouched.
+
+   \param tdb_ctx pointer to the EMSABP TDB context
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_tdb_migrate(TDB_CONTEXT *tdb_ctx)
+{
+	struct emsabp_tdb_migration	migration;
+
+	OPENCHANGE_RETVAL_IF(emsabp_tdb_version(tdb_ctx) >= EMSABP_TDB_VERSION, MAPI_E_SUCCESS, NULL);
+	OPENCHANGE_RETVAL_IF(tdb_transaction_start(tdb_ctx), MAPI_E_CORRUPT_STORE, NULL);
+
+	/* Other NSPI processes open the same database: the first one
+	   holding the transaction converts it */
+	if (emsabp_tdb_version(tdb_ctx) >= EMSABP_TDB_VERSION) {
+		tdb_transaction_cancel(tdb_ctx);
+		return MAPI_E_SUCCESS;
+	}
+
+	memset(&migration, 0, sizeof (struct emsabp_tdb_migration));
+	if (tdb_traverse(tdb_ctx, emsabp_tdb_migration_traverse, &migration) == -1 ||
+	    migration.failed || emsabp_tdb_set_version(tdb_ctx) == -1) {
+		DEBUG(0, ("[%s:%d]: unable to convert MId records: %s\n", __FUNCTION__, __LINE__,
+			  tdb_errorstr(tdb_ctx)));
+		tdb_transaction_cancel(tdb_ctx);
+		return MAPI_E_CORRUPT_STORE;
+	}
+	OPENCHANGE_RETVAL_IF(tdb_transaction_commit(tdb_ctx) == -1, MAPI_E_CORRUPT_STORE, NULL);
+
+	DEBUG(3, ("[%s:%d]: %u MId records converted\n", __FUNCTION__, __LINE__, migration.count));
+
+	return MAPI_E_SUCCESS;
+}
+
+
 /**
    \details Open EMSABP TDB database
 
@@ -50,9 +225,6 @@ _PUBLIC_ TDB_CONTEXT *emsabp_tdb_init(TALLOC_CTX *mem_ctx,
 {
 	enum MAPISTATUS			retval;
 	TDB_CONTEXT			*tdb_ctx;
-	TDB_DATA			key;
-	TDB_DATA			dbuf;
-	int				ret;
 
 	/* Sanity checks */
 	if (!lp_ctx) return NULL;
@@ -61,24 +233,20 @@ _PUBLIC_ TDB_CONTEXT *emsabp_tdb_init(TALLOC_CTX *mem_ctx,
 	tdb_ctx = mapiproxy_server_emsabp_tdb_init(lp_ctx);
 	if (!tdb_ctx) return NULL;
 
-	/* Step 1. If EMSABP_TDB_DATA_REC doesn't exist, create it */
-	retval = emsabp_tdb_fetch(tdb_ctx, EMSABP_TDB_DATA_REC, &dbuf);
+	/* Step 1. If EMSABP_TDB_DATA_REC doesn't exist, create it,
+	 * otherwise convert the database if needed */
+	retval = emsabp_tdb_fetch(tdb_ctx, EMSABP_TDB_DATA_REC, NULL);
 	if (retval == MAPI_E_NOT_FOUND) {
-		key.dptr = (unsigned char *) EMSABP_TDB_DATA_REC;
-		key.dsize = strlen(EMSABP_TDB_DATA_REC);
-
-		dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", EMSABP_TDB_MID_START);
-		dbuf.dsize = strlen((const char *)dbuf.dptr);
-
-		ret = tdb_store(tdb_ctx, key, dbuf, TDB_INSERT);
-		if (ret == -1) {
+		if (emsabp_tdb_set_index(tdb_ctx, EMSABP_TDB_MID_START, TDB_INSERT) == -1 ||
+		    emsabp_tdb_set_version(tdb_ctx) == -1) {
 			DEBUG(3, ("[%s:%d]: Unable to create %s record: %s\n", __FUNCTION__, __LINE__,
 				  EMSABP_TDB_DATA_REC, tdb_errorstr(tdb_ctx)));
 			tdb_close(tdb_ctx);
 			return NULL;
 		}
-	} else {
-		free (dbuf.dptr);
+	} else if (emsabp_tdb_migrate(tdb_ctx) != MAPI_E_SUCCESS) {
+		tdb_close(tdb_ctx);
+		return NULL;
 	}
 
 	return tdb_ctx;
@@ -97,22 +265,14 @@ _PUBLIC_ TDB_CONTEXT *emsabp_tdb_init(TALLOC_CTX *mem_ctx,
 _PUBLIC_ TDB_CONTEXT *emsabp_tdb_init_tmp(TALLOC_CTX *mem_ctx)
 {
 	TDB_CONTEXT	*tdb_ctx;
-	TDB_DATA       	key;
-	TDB_DATA       	dbuf;
-	int	       	ret;
 
 	/* Step 0. Initialize the temporary TDB database */
-	tdb_ctx = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
-	
-	/* Step 1. Create EMSABP_TMP_TDB_DATA_REC record */
-	key.dptr = (unsigned char *) EMSABP_TDB_DATA_REC;
-	key.dsize = strlen(EMSABP_TDB_DATA_REC);
+	tdb_ctx = tdb_open(NULL, EMSABP_TDB_TMP_HASH_SIZE, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
+	if (!tdb_ctx) return NULL;
 
-	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", EMSABP_TDB_TMP_MID_START);
-	dbuf.dsize = strlen((const char *)dbuf.dptr);
-	
-	ret = tdb_store(tdb_ctx, key, dbuf, TDB_INSERT);
-	if (ret == -1) {
+	/* Step 1. Create EMSABP_TMP_TDB_DATA_REC record */
+	if (emsabp_tdb_set_index(tdb_ctx, EMSABP_TDB_TMP_MID_START, TDB_INSERT) == -1 ||
+	    emsabp_tdb_set_version(tdb_ctx) == -1) {
 		DEBUG(3, ("[%s:%d]: Unable to create %s record: %s\n", __FUNCTION__, __LINE__,
 			  EMSABP_TDB_DATA_REC, tdb_errorstr(tdb_ctx)));
 		tdb_close(tdb_ctx);
@@ -195,59 +355,30 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_MId(TDB_CONTEXT *tdb_ctx,
 					      const char *keyname,
 					      uint32_t *MId)
 {
-	TALLOC_CTX	*mem_ctx;
-	TDB_DATA	key;
 	TDB_DATA	dbuf;
-	char		*str;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!keyname, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!MId, MAPI_E_INVALID_PARAMETER, NULL);
 
-	key.dptr = (unsigned char *) keyname;
-	key.dsize = strlen(keyname);
-
-	dbuf = tdb_fetch(tdb_ctx, key);
+	dbuf = tdb_fetch(tdb_ctx, emsabp_tdb_string_key(keyname));
 	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, NULL);
-	OPENCHANGE_RETVAL_IF(!dbuf.dsize, MAPI_E_NOT_FOUND, NULL);
+	if (dbuf.dsize != sizeof (uint32_t)) {
+		free(dbuf.dptr);
+		return MAPI_E_NOT_FOUND;
+	}
 
-	mem_ctx = talloc_named(NULL, 0, "emsabp_tdb_fetch_MId");
-	str = talloc_strndup(mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
-	*MId = strtol((const char *)str, NULL, 16);
-	talloc_free(mem_ctx);
+	*MId = emsabp_tdb_unpack_MId(dbuf.dptr);
 	free(dbuf.dptr);
 
 	return MAPI_E_SUCCESS;
 }
 
 
-static int emsabp_tdb_traverse_MId(TDB_CONTEXT *tdb_ctx, 
-				   TDB_DATA key, TDB_DATA dbuf, 
-				   void *state)
-{
-	TALLOC_CTX		*mem_ctx;
-	uint32_t		value;
-	char			*value_str = NULL;
-	struct traverse_MId	*mid_trav = (struct traverse_MId *) state;
-
-	mem_ctx = talloc_named(NULL, 0, "emsabp_tdb_traverse_MId");
-	value_str = talloc_strndup(mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
-	value = strtol((const char *)value_str, NULL, 16);
-	talloc_free(mem_ctx);
-
-	if (value == mid_trav->MId) {
-		mid_trav->found = true;
-		return 1;
-	}
-
-	return 0;
-}
-
-
 /**
-   \details Traverse the EMSABP TDB database and look for the input
-   MId
+   \details Check whether the input MId exists in the EMSABP TDB
+   database
 
    \param tdb_ctx pointer to the EMSABP TDB context
    \param MId MID to lookup
@@ -257,73 +388,47 @@ static int emsabp_tdb_traverse_MId(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ bool emsabp_tdb_lookup_MId(TDB_CONTEXT *tdb_ctx,
 				    uint32_t MId)
 {
-	int			ret;
-	struct traverse_MId	mid_trav = { MId, false };
+	uint8_t		buf[EMSABP_TDB_MID_KEY_LEN];
 
-	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_MId, (void *)&mid_trav);
+	if (!tdb_ctx) return false;
 
-	return (ret > 0) && mid_trav.found;
-}
-
-
-static int emsabp_tdb_traverse_MId_DN(TDB_CONTEXT *tdb_ctx,
-				      TDB_DATA key, TDB_DATA dbuf,
-				      void *state)
-{
-	char			*MId;
-	uint32_t		value;
-	struct emsabp_MId	*emsabp_MId = (struct emsabp_MId *) state;
-
-	if (key.dptr) {
-		if (!strncmp((const char *)key.dptr, "CN=", 3)) {
-			MId = talloc_strndup(emsabp_MId, (char *)dbuf.dptr, dbuf.dsize);
-			value = strtol((const char *)MId, NULL, 16);
-			talloc_free(MId);
-			if (value == emsabp_MId->MId) {
-				emsabp_MId->dn = talloc_strndup(emsabp_MId, (char *)key.dptr, key.dsize);
-				return 1;
-			}
-		}
-	}
-
-	return 0;
+	return tdb_exists(tdb_ctx, emsabp_tdb_MId_key(buf, MId)) == 1;
 }
 
 
 /**
-   \details Traverse the EMSABP TDB and fetch the DN associated with
-   the MId
+   \details Fetch the DN associated with the MId from the EMSABP TDB
+   database
 
    \param mem_ctx pointer to the memory context
    \param tdb_ctx pointer to the EMSABP TDB context
    \param MId MID to search
    \param dn pointer on pointer to the dn to return
 
-   \return MAPI_E_SUCCESS on success, otherwise false
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_FOUND
  */
 _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_dn_from_MId(TALLOC_CTX *mem_ctx,
 						      TDB_CONTEXT *tdb_ctx,
 						      uint32_t MId,
 						      char **dn)
 {
-	int			ret;
-	struct emsabp_MId	*emsabp_MId;
-	
-	emsabp_MId = talloc_zero(mem_ctx, struct emsabp_MId);
-	emsabp_MId->dn = NULL;
-	emsabp_MId->MId = MId;
-	
-	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_MId_DN, (void *)emsabp_MId);
-	if (ret > -1 && emsabp_MId->dn) {
-		*dn = talloc_strdup(mem_ctx, emsabp_MId->dn);
-		talloc_free(emsabp_MId);
-		return MAPI_E_SUCCESS;
-	}
+	uint8_t		buf[EMSABP_TDB_MID_KEY_LEN];
+	TDB_DATA	dbuf;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!dn, MAPI_E_INVALID_PARAMETER, NULL);
 
 	*dn = NULL;
-	talloc_free(emsabp_MId);
+	OPENCHANGE_RETVAL_IF(!tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 
-	return MAPI_E_NOT_FOUND;
+	dbuf = tdb_fetch(tdb_ctx, emsabp_tdb_MId_key(buf, MId));
+	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, NULL);
+
+	*dn = talloc_strndup(mem_ctx, (const char *) dbuf.dptr, dbuf.dsize);
+	free(dbuf.dptr);
+	OPENCHANGE_RETVAL_IF(!*dn, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -338,53 +443,58 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_dn_from_MId(TALLOC_CTX *mem_ctx,
 _PUBLIC_ enum MAPISTATUS emsabp_tdb_insert(TDB_CONTEXT *tdb_ctx,
 					   const char *keyname)
 {
-	enum MAPISTATUS	retval;
-	TALLOC_CTX	*mem_ctx;
+	enum MAPISTATUS	retval = MAPI_E_SUCCESS;
+	uint8_t		buf[EMSABP_TDB_MID_KEY_LEN];
+	uint8_t		value[sizeof (uint32_t)];
 	TDB_DATA	key;
+	TDB_DATA	index_key;
 	TDB_DATA	dbuf;
-	char		*str;
-	int		index;
-	int		ret;
+	uint32_t	MId;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!keyname, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "emsabp_tdb_insert");
-	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+	key = emsabp_tdb_string_key(keyname);
+	index_key = emsabp_tdb_string_key(EMSABP_TDB_DATA_REC);
 
-	/* Step 1. Check if the record already exists */
-	retval = emsabp_tdb_fetch(tdb_ctx, keyname, &dbuf);
-	OPENCHANGE_RETVAL_IF(!retval, ecExiting, mem_ctx);
+	/* Processes sharing the database allocate MIds one at a time */
+	OPENCHANGE_RETVAL_IF(tdb_chainlock(tdb_ctx, index_key) == -1, MAPI_E_CORRUPT_STORE, NULL);
 
-	/* Step 2. Retrieve the latest TDB data value inserted */
-	retval = emsabp_tdb_fetch(tdb_ctx, EMSABP_TDB_DATA_REC, &dbuf);
-	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+	/* Step 1. Check if the record already exists */
+	if (tdb_exists(tdb_ctx, key)) {
+		retval = ecExiting;
+		goto end;
+	}
 
-	str = talloc_strndup(mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
-	index = strtol(str, NULL, 16);
-	index += 1;
-	talloc_free(str);
+	/* Step 2. Retrieve the latest MId allocated */
+	dbuf = tdb_fetch(tdb_ctx, index_key);
+	if (!dbuf.dptr || dbuf.dsize != sizeof (uint32_t)) {
+		free(dbuf.dptr);
+		retval = MAPI_E_CORRUPT_STORE;
+		goto end;
+	}
+	MId = emsabp_tdb_unpack_MId(dbuf.dptr) + 1;
 	free(dbuf.dptr);
 
-	dbuf.dptr = (unsigned char *)talloc_asprintf(mem_ctx, "0x%x", index);
-	dbuf.dsize = strlen((const char *)dbuf.dptr);
+	emsabp_tdb_pack_MId(value, MId);
+	dbuf.dptr = value;
+	dbuf.dsize = sizeof (value);
 
-	/* Step 3. Insert the new record */
-	key.dptr = (unsigned char *)keyname;
-	key.dsize = strlen(keyname);
-	
-	ret = tdb_store(tdb_ctx, key, dbuf, TDB_INSERT);
-	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, mem_ctx);
+	/* Step 3. Insert the DN to MId and MId to DN records */
+	if (tdb_store(tdb_ctx, key, dbuf, TDB_INSERT) == -1 ||
+	    tdb_store(tdb_ctx, emsabp_tdb_MId_key(buf, MId), key, TDB_REPLACE) == -1) {
+		retval = MAPI_E_CORRUPT_STORE;
+		goto end;
+	}
 
 	/* Step 4. Update Data record */
-	key.dptr = (unsigned char *) EMSABP_TDB_DATA_REC;
-	key.dsize = strlen((const char *)key.dptr);
-
-	ret = tdb_store(tdb_ctx, key, dbuf, TDB_MODIFY);
-	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, mem_ctx);
+	if (tdb_store(tdb_ctx, index_key, dbuf, TDB_MODIFY) == -1) {
+		retval = MAPI_E_CORRUPT_STORE;
+	}
 
-	talloc_free(mem_ctx);
+end:
+	tdb_chainunlock(tdb_ctx, index_key);
 
-	return MAPI_E_SUCCESS;
+	return retval;
 }
@@ -28,29 +28,77 @@
 #include "libmapi/mapicode.h"
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
+#include <dlinklist.h>
+#include <mysql/mysqld_error.h>
 
 
-/* Items stored on ht table */
+/* Prepared statement cached on a connection, keyed by its SQL text */
+struct stmt_v {
+	MYSQL_STMT	*stmt;
+	const char	*sql;
+};
+
+/* Connection handed out by create_connection */
 struct conn_v {
 	MYSQL		*conn;
 	const char	*connection_string;
+	uint32_t	refcount;
+	time_t		last_used;
+	unsigned long	thread_id;
+	struct htable	stmts;
+	struct conn_v	*prev;
+	struct conn_v	*next;
+};
+
+/* Items stored on ht table: the connections opened for one connection string */
+struct pool_v {
+	const char	*connection_string;
+	uint32_t	count;
+	struct conn_v	*conns;
 };
 
 /* Rehash function for ht table */
 static size_t _ht_rehash(const void *e, void *unused)
 {
-	return hash_string(((struct conn_v *)e)->connection_string);
+	return hash_string(((struct pool_v *)e)->connection_string);
 }
 
 /* Comparison function to get items from ht table */
 static bool _ht_cmp(const void *e, void *string)
 {
-	return strcmp(((struct conn_v *)e)->connection_string, (const char *)string) == 0;
+	return strcmp(((struct pool_v *)e)->connection_string, (const char *)string) == 0;
+}
+
+/* Rehash function for conns table */
+static size_t _conns_rehash(const void *e, void *unused)
+{
+	return hash_pointer(((struct conn_v *)e)->conn, 0);
+}
+
+/* Comparison function to get items from conns table */
+static bool _conns_cmp(const void *e, void *conn)
+{
+	return ((struct conn_v *)e)->conn == conn;
+}
+
+/* Rehash function for the statements table of a connection */
+static size_t _stmts_rehash(const void *e, void *unused)
+{
+	return hash_string(((struct stmt_v *)e)->sql);
 }
 
-/* This is a dictionary [connection_string] -> [MYSQL *] (actually struct conn_v) */
+/* Comparison function to get items from the statements table of a connection */
+static bool _stmts_cmp(const void *e, void *sql)
+{
+	return strcmp(((struct stmt_v *)e)->sql, (const char *)sql) == 0;
+}
+
+/* This is a dictionary [connection_string] -> [MYSQL *] (actually struct pool_v) */
 static struct htable ht = HTABLE_INITIALIZER(ht, _ht_rehash, NULL);
 
+/* This is a dictionary [MYSQL *] -> struct conn_v */
+static struct htable conns = HTABLE_INITIALIZER(conns, _conns_rehash, NULL);
+
 
 static float timespec_diff_in_seconds(struct timespec *end, struct timespec *start)
 {
@@ -59,21 +107,60 @@ static float timespec_diff_in_seconds(struct timespec *end, struct timespec *sta
 		/ 1000000000;
 }
 
+/**
+   \details Close the prepared statements cached on a connection
+
+   \param entry pointer to the pooled connection
+ */
+static void _connection_close_statements(struct conn_v *entry)
+{
+	struct htable_iter	i;
+	struct stmt_v		*stmt;
+
+	stmt = htable_first(&entry->stmts, &i);
+	while (stmt) {
+		mysql_stmt_close(stmt->stmt);
+		talloc_free(stmt);
+		stmt = htable_next(&entry->stmts, &i);
+	}
+	htable_clear(&entry->stmts);
+}
+
+/**
+   \details Close a pooled connection and remove it from its pool
+
+   \param pool pointer to the pool the connection belongs to
+   \param entry pointer to the pooled connection
+ */
+static void _connection_close(struct pool_v *pool, struct conn_v *entry)
+{
+	DEBUG(3, ("Closing %s\n", entry->connection_string));
+	_connection_close_statements(entry);
+	htable_del(&conns, hash_pointer(entry->conn, 0), entry);
+	mysql_close(entry->conn);
+	DLIST_REMOVE(pool->conns, entry);
+	pool->count--;
+	talloc_free(entry);
+}
+
 /**
     \details Close and delete all mysql connections already open
  */
 void close_all_connections(void)
 {
 	struct htable_iter 	i;
-	struct conn_v		*entry;
+	struct pool_v		*pool;
 
-	entry = htable_first(&ht, &i);
-	while (entry) {
-		DEBUG(3, ("Closing %s\n", entry->connection_string));
-		mysql_close(entry->conn);
-		entry = htable_next(&ht, &i);
+	pool = htable_first(&ht, &i);
+	while (pool) {
+		while (pool->conns) {
+			_connection_close(pool, pool->conns);
+		}
+		talloc_free(pool);
+		pool = htable_next(&ht, &i);
 	}
 	htable_clear(&ht);
+	htable_clear(&conns);
 }
 
 /**
@@ -200,91 +287,212 @@ static bool parse_connection_string(TALLOC_CTX *mem_ctx,
 }
 
 
-MYSQL *create_connection(const char *connection_string, MYSQL **conn)
+/**
+   \details Open a new connection and add it to a pool. The database
+   is created if it does not exist yet.
+
+   \param pool pointer to the pool the connection is opened for
+
+   \return pointer to the pooled connection on success, NULL otherwise
+ */
+static struct conn_v *_connection_open(struct pool_v *pool)
 {
 	TALLOC_CTX	*mem_ctx;
+	MYSQL		*conn;
 	my_bool		reconnect;
 	char		*host, *user, *passwd, *db, *sql;
 	int		port;
 	bool		parsed;
-	struct conn_v	*entry = NULL, *retval = NULL;
-
-	if (conn == NULL) return NULL;
-
-	retval = htable_get(&ht, hash_string(connection_string), _ht_cmp, connection_string);
-	if (retval) {
-		DEBUG(5, ("[MYSQL] Found connection, reusing it %"PRIu32"\n", hash_string(connection_string)));
-		*conn = retval->conn;
-		return *conn;
-	}
-
-	*conn = mysql_init(NULL);
-	reconnect = true;
-	mysql_options(*conn, MYSQL_OPT_RECONNECT, &reconnect);
+	struct conn_v	*entry = NULL;
 
 	mem_ctx = talloc_zero(NULL, TALLOC_CTX);
 	if (!mem_ctx) return NULL;
 
-	parsed = parse_connection_string(mem_ctx, connection_string,
+	parsed = parse_connection_string(mem_ctx, pool->connection_string,
 					 &host, &port, &user, &passwd, &db);
 	if (!parsed) {
-		DEBUG(1, ("[MYSQL] Wrong connection string %s\n", connection_string));
-		*conn = NULL;
+		DEBUG(1, ("[MYSQL] Wrong connection string %s\n", pool->connection_string));
 		goto end;
 	}
 
-	*conn = mysql_init(NULL);
+	conn = mysql_init(NULL);
+	if (!conn) goto end;
+	reconnect = true;
+	mysql_options(conn, MYSQL_OPT_RECONNECT, &reconnect);
 
 	// First try to connect to the database, if it fails try to create it
-	if (mysql_real_connect(*conn, host, user, passwd, db, port, NULL, 0)) {
+	if (mysql_real_connect(conn, host, user, passwd, db, port, NULL, 0)) {
 		DEBUG(5, ("[MYSQL] Connection done\n"));
 		goto connected;
 	}
 
-	reconnect = true;
-	mysql_options(*conn, MYSQL_OPT_RECONNECT, &reconnect);
-
 	// Try to create database
-	if (!mysql_real_connect(*conn, host, user, passwd, NULL, port, NULL, 0)) {
+	if (!mysql_real_connect(conn, host, user, passwd, NULL, port, NULL, 0)) {
 		// Nop
 		DEBUG(1, ("[MYSQL] Can't connect to server using %s, error: %s\n",
-			  connection_string, mysql_error(*conn)));
-		mysql_close(*conn);
-		*conn = NULL;
+			  pool->connection_string, mysql_error(conn)));
+		mysql_close(conn);
 		goto end;
 	} else {
 		DEBUG(5, ("[MYSQL] Connection done, let's create the database\n"));
 		// Connect it!, let's try to create database
 		sql = talloc_asprintf(mem_ctx, "CREATE DATABASE %s", db);
-		if (mysql_query(*conn, sql) != 0 || mysql_select_db(*conn, db) != 0) {
+		if (mysql_query(conn, sql) != 0 || mysql_select_db(conn, db) != 0) {
 			DEBUG(1, ("[MYSQL] Can't connect to server using %s, error: %s\n",
-				  connection_string, mysql_error(*conn)));
-			mysql_close(*conn);
-			*conn = NULL;
+				  pool->connection_string, mysql_error(conn)));
+			mysql_close(conn);
 			goto end;
 		}
 	}
 
 connected:
-	// This entries will never be deallocated
-	entry = talloc_zero(talloc_autofree_context(), struct conn_v);
-	entry->connection_string = talloc_strdup(entry, connection_string);
-	entry->conn = *conn;
-	// Store the new connection in our table
-	if (!htable_add(&ht, hash_string(connection_string), entry)) {
+	entry = talloc_zero(pool, struct conn_v);
+	if (!entry) {
+		mysql_close(conn);
+		goto end;
+	}
+	entry->conn = conn;
+	entry->connection_string = pool->connection_string;
+	entry->thread_id = mysql_thread_id(conn);
+	entry->last_used = time(NULL);
+	htable_init(&entry->stmts, _stmts_rehash, NULL);
+	if (!htable_add(&conns, hash_pointer(conn, 0), entry)) {
 		DEBUG(1, ("[MYSQL] ERROR adding new connection to internal pool of connections\n"));
-	} else {
-		DEBUG(5, ("[MYSQL] Stored new connection %"PRIu32"\n", hash_string(connection_string)));
+		mysql_close(conn);
+		talloc_free(entry);
+		entry = NULL;
+		goto end;
 	}
+	DLIST_ADD(pool->conns, entry);
+	pool->count++;
+	DEBUG(5, ("[MYSQL] Stored new connection %"PRIu32" (%"PRIu32" in pool)\n",
+		  hash_string(pool->connection_string), pool->count));
 
 end:
 	talloc_free(mem_ctx);
+	return entry;
+}
+
+/**
+   \details Check a pooled connection which has been idle for a while
+   is still usable. Statements prepared before an automatic reconnection
+   are discarded, dead connections nobody uses anymore are closed.
+
+   \param pool pointer to the pool the connection belongs to
+   \param entry pointer to the pooled connection
+
+   \return true if the connection can be handed out, false otherwise
+ */
+static bool _connection_check(struct pool_v *pool, struct conn_v *entry)
+{
+	if (time(NULL) - entry->last_used < MYSQL_POOL_PING_INTERVAL) {
+		return true;
+	}
+
+	if (mysql_ping(entry->conn) == 0) {
+		if (entry->thread_id != mysql_thread_id(entry->conn)) {
+			DEBUG(3, ("[MYSQL] Reconnected to %s, discarding prepared statements\n",
+				  entry->connection_string));
+			_connection_close_statements(entry);
+			entry->thread_id = mysql_thread_id(entry->conn);
+		}
+		return true;
+	}
+
+	DEBUG(3, ("[MYSQL] Connection to %s lost: %s\n", entry->connection_string,
+		  mysql_error(entry->conn)));
+	if (entry->refcount == 0) {
+		_connection_close(pool, entry);
+	}
+	return false;
+}
+
+/**
+   \details Get a connection from the pool of a connection string. An
+   idle connection is preferred, a new one is opened while the pool has
+   less than MYSQL_POOL_SIZE connections and the least used one is
+   shared otherwise.
+
+   The connection must be given back with release_connection once the
+   caller is done with it.
+
+   \param connection_string mysql connection string
+   \param conn pointer to the returned connection
+
+   \return the connection on success, NULL otherwise
+ */
+MYSQL *create_connection(const char *connection_string, MYSQL **conn)
+{
+	struct pool_v	*pool;
+	struct conn_v	*entry, *next, *shared = NULL;
+
+	if (conn == NULL) return NULL;
+	*conn = NULL;
+	if (connection_string == NULL) return NULL;
+
+	pool = htable_get(&ht, hash_string(connection_string), _ht_cmp, connection_string);
+	if (!pool) {
+		// Pools are never deallocated but by close_all_connections
+		pool = talloc_zero(talloc_autofree_context(), struct pool_v);
+		if (!pool) return NULL;
+		pool->connection_string = talloc_strdup(pool, connection_string);
+		if (!pool->connection_string ||
+		    !htable_add(&ht, hash_string(connection_string), pool)) {
+			DEBUG(1, ("[MYSQL] ERROR adding new pool of connections\n"));
+			talloc_free(pool);
+			return NULL;
+		}
+	}
+
+	for (entry = pool->conns; entry; entry = next) {
+		next = entry->next;
+		if (entry->refcount == 0) {
+			if (_connection_check(pool, entry)) break;
+			continue;
+		}
+		if (!shared || entry->refcount < shared->refcount) {
+			shared = entry;
+		}
+	}
+
+	if (!entry && pool->count >= MYSQL_POOL_SIZE) {
+		entry = shared;
+	}
+	if (entry) {
+		DEBUG(5, ("[MYSQL] Found connection, reusing it %"PRIu32"\n",
+			  hash_string(connection_string)));
+	} else {
+		entry = _connection_open(pool);
+		if (!entry) return NULL;
+	}
+
+	entry->refcount++;
+	entry->last_used = time(NULL);
+	*conn = entry->conn;
 	return *conn;
 }
 
+/**
+   \details Give a connection obtained with create_connection back to
+   its pool. The connection stays open so it can be handed out again.
+
+   \param conn pointer to the connection
+ */
 void release_connection(MYSQL *conn)
 {
-	// Do nothing
+	struct conn_v	*entry;
+
+	if (conn == NULL) return;
+
+	entry = htable_get(&conns, hash_pointer(conn, 0), _conns_cmp, conn);
+	if (!entry) {
+		// Already closed by close_all_connections
+		return;
+	}
+	if (entry->refcount > 0) {
+		entry->refcount--;
+	}
+	entry->last_used = time(NULL);
 }
 
 enum MYSQLRESULT execute_query(MYSQL *conn, const char *sql)
@@ -441,6 +649,323 @@ enum MYSQLRESULT select_first_uint(MYSQL *conn, const char *sql,
 }
 
 
+/**
+   \details Bind an unsigned 64 bits integer, either as statement
+   parameter or as result column
+
+   \param bind pointer to the bind to fill
+   \param n pointer to the integer
+ */
+void stmt_bind_uint64(MYSQL_BIND *bind, uint64_t *n)
+{
+	memset(bind, 0, sizeof (MYSQL_BIND));
+	bind->buffer_type = MYSQL_TYPE_LONGLONG;
+	bind->buffer = n;
+	bind->is_unsigned = true;
+}
+
+
+/**
+   \details Bind a string as statement parameter, NULL binds a SQL NULL
+
+   \param bind pointer to the bind to fill
+   \param s the string
+ */
+void stmt_bind_string(MYSQL_BIND *bind, const char *s)
+{
+	memset(bind, 0, sizeof (MYSQL_BIND));
+	if (s == NULL) {
+		bind->buffer_type = MYSQL_TYPE_NULL;
+		return;
+	}
+	bind->buffer_type = MYSQL_TYPE_STRING;
+	bind->buffer = discard_const_p(char, s);
+	bind->buffer_length = strlen(s);
+}
+
+
+/**
+   \details Bind a string result column. The buffer is allocated by
+   select_stmt_first_row once the length of the value is known, the
+   string is then available in bind->buffer (NULL for SQL NULL).
+
+   \param bind pointer to the bind to fill
+ */
+void stmt_bind_string_result(MYSQL_BIND *bind)
+{
+	memset(bind, 0, sizeof (MYSQL_BIND));
+	bind->buffer_type = MYSQL_TYPE_STRING;
+}
+
+
+/**
+   \details Get the prepared statement for a SQL template from the cache
+   of the connection, preparing it on first use
+
+   \param conn pointer to a connection returned by create_connection
+   \param sql the statement template, with ? placeholders
+
+   \return the prepared statement, NULL on error
+ */
+static MYSQL_STMT *_stmt_prepare(MYSQL *conn, const char *sql)
+{
+	struct conn_v	*entry;
+	struct stmt_v	*stmt;
+	MYSQL_STMT	*handle;
+
+	entry = htable_get(&conns, hash_pointer(conn, 0), _conns_cmp, conn);
+	if (!entry) {
+		DEBUG(0, ("[MYSQL] Prepared statements require a pooled connection\n"));
+		return NULL;
+	}
+
+	if (entry->thread_id != mysql_thread_id(conn)) {
+		// Automatic reconnection happened, statements are gone on the server
+		_connection_close_statements(entry);
+		entry->thread_id = mysql_thread_id(conn);
+	}
+
+	stmt = htable_get(&entry->stmts, hash_string(sql), _stmts_cmp, sql);
+	if (stmt) {
+		return stmt->stmt;
+	}
+
+	handle = mysql_stmt_init(conn);
+	if (!handle) {
+		DEBUG(0, ("Error preparing `%s`: %s\n", sql, mysql_error(conn)));
+		return NULL;
+	}
+	if (mysql_stmt_prepare(handle, sql, strlen(sql)) != 0) {
+		DEBUG(3, ("Error preparing `%s`: %s\n", sql, mysql_stmt_error(handle)));
+		mysql_stmt_close(handle);
+		return NULL;
+	}
+
+	stmt = talloc_zero(entry, struct stmt_v);
+	if (!stmt) {
+		mysql_stmt_close(handle);
+		return NULL;
+	}
+	stmt->stmt = handle;
+	stmt->sql = talloc_strdup(stmt, sql);
+	if (!stmt->sql || !htable_add(&entry->stmts, hash_string(sql), stmt)) {
+		mysql_stmt_close(handle);
+		talloc_free(stmt);
+		return NULL;
+	}
+
+	return handle;
+}
+
+
+/**
+   \details Execute a prepared statement. If the statement failed
+   because the connection was lost (killed, timed out or restarted
+   server) it is re-established, the statement prepared again and
+   executed once more.
+
+   \param conn pointer to a connection returned by create_connection
+   \param sql the statement template
+   \param params the parameters, one per placeholder
+
+   \return the executed statement, NULL on error
+ */
+static MYSQL_STMT *_stmt_execute(MYSQL *conn, const char *sql, MYSQL_BIND *params)
+{
+	struct timespec	start, end;
+	float		seconds_spent;
+	struct conn_v	*entry;
+	MYSQL_STMT	*stmt;
+	unsigned int	error;
+	unsigned long	thread_id;
+	int		attempt;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (attempt = 0; ; attempt++) {
+		stmt = _stmt_prepare(conn, sql);
+		if (stmt) {
+			if (mysql_stmt_bind_param(stmt, params) == 0 &&
+			    mysql_stmt_execute(stmt) == 0) {
+				break;
+			}
+			error = mysql_stmt_errno(stmt);
+			DEBUG(3, ("Error on statement `%s`: %s\n", sql, mysql_stmt_error(stmt)));
+		} else {
+			error = mysql_errno(conn);
+		}
+		entry = htable_get(&conns, hash_pointer(conn, 0), _conns_cmp, conn);
+		if (attempt > 0 || !entry) {
+			return NULL;
+		}
+
+		// Reconnects if the connection was lost
+		thread_id = mysql_thread_id(conn);
+		if (mysql_ping(conn) != 0) {
+			return NULL;
+		}
+		if (thread_id == mysql_thread_id(conn) && error != ER_UNKNOWN_STMT_HANDLER) {
+			// Nothing to do with the connection, the statement is wrong
+			return NULL;
+		}
+		_connection_close_statements(entry);
+		entry->thread_id = mysql_thread_id(conn);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	seconds_spent = timespec_diff_in_seconds(&end, &start);
+	if (seconds_spent > THRESHOLD_SLOW_QUERIES) {
+		printf("MySQL slow query!\n"
+		       "\tQuery: `%s`\n\tTime: %.3f\n", sql, seconds_spent);
+		DEBUG(5, ("MySQL slow query!\n"
+			  "\tQuery: `%s`\n\tTime: %.3f\n", sql, seconds_spent));
+	}
+	return stmt;
+}
+
+
+/**
+   \details Execute a statement which returns no rows
+
+   \param conn pointer to a connection returned by create_connection
+   \param sql the statement template, with ? placeholders
+   \param params the parameters, one per placeholder
+   \param affected_rows pointer to the returned number of affected rows - optional
+
+   \return MYSQL_SUCCESS on success, MYSQL_ERROR otherwise
+ */
+enum MYSQLRESULT execute_stmt(MYSQL *conn, const char *sql, MYSQL_BIND *params,
+			      uint64_t *affected_rows)
+{
+	MYSQL_STMT	*stmt;
+
+	stmt = _stmt_execute(conn, sql, params);
+	if (!stmt) {
+		return MYSQL_ERROR;
+	}
+	if (affected_rows) {
+		*affected_rows = mysql_stmt_affected_rows(stmt);
+	}
+
+	return MYSQL_SUCCESS;
+}
+
+
+/**
+   \details Execute a query and fetch its first row into binary results.
+   SQL NULL values are returned as 0 for integers and NULL for strings.
+
+   \param mem_ctx pointer to the memory context strings are allocated with
+   \param conn pointer to a connection returned by create_connection
+   \param sql the statement template, with ? placeholders
+   \param params the parameters, one per placeholder
+   \param results the result binds, one per selected column
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if the query
+   returned no rows, MYSQL_ERROR otherwise
+ */
+enum MYSQLRESULT select_stmt_first_row(TALLOC_CTX *mem_ctx, MYSQL *conn,
+				       const char *sql, MYSQL_BIND *params,
+				       MYSQL_BIND *results)
+{
+	TALLOC_CTX		*local_mem_ctx;
+	MYSQL_STMT		*stmt;
+	unsigned long		*lengths;
+	my_bool			*nulls;
+	unsigned int		i, count;
+	int			ret;
+	enum MYSQLRESULT	retval = MYSQL_ERROR;
+
+	stmt = _stmt_execute(conn, sql, params);
+	if (!stmt) {
+		return MYSQL_ERROR;
+	}
+
+	local_mem_ctx = talloc_named(NULL, 0, "select_stmt_first_row");
+	count = mysql_stmt_field_count(stmt);
+	lengths = talloc_zero_array(local_mem_ctx, unsigned long, count);
+	nulls = talloc_zero_array(local_mem_ctx, my_bool, count);
+	if (!lengths || !nulls) goto end;
+	for (i = 0; i < count; i++) {
+		results[i].length = &lengths[i];
+		results[i].is_null = &nulls[i];
+	}
+
+	if (mysql_stmt_bind_result(stmt, results) != 0 ||
+	    mysql_stmt_store_result(stmt) != 0) {
+		DEBUG(0, ("Error getting results of `%s`: %s\n", sql,
+			  mysql_stmt_error(stmt)));
+		goto end;
+	}
+
+	ret = mysql_stmt_fetch(stmt);
+	if (ret == MYSQL_NO_DATA) {
+		retval = MYSQL_NOT_FOUND;
+		goto end;
+	} else if (ret != 0 && ret != MYSQL_DATA_TRUNCATED) {
+		DEBUG(0, ("Error getting row of `%s`: %s\n", sql,
+			  mysql_stmt_error(stmt)));
+		goto end;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (nulls[i]) {
+			if (results[i].buffer_type == MYSQL_TYPE_LONGLONG) {
+				*(uint64_t *)results[i].buffer = 0;
+			}
+			continue;
+		}
+		// String columns bound without buffer are fetched now their length is known
+		if (results[i].buffer_type != MYSQL_TYPE_STRING || results[i].buffer) continue;
+		results[i].buffer = talloc_array(mem_ctx, char, lengths[i] + 1);
+		if (!results[i].buffer) goto end;
+		results[i].buffer_length = lengths[i] + 1;
+		if (mysql_stmt_fetch_column(stmt, &results[i], i, 0) != 0) {
+			DEBUG(0, ("Error getting column %u of `%s`: %s\n", i, sql,
+				  mysql_stmt_error(stmt)));
+			goto end;
+		}
+		((char *)results[i].buffer)[lengths[i]] = '\0';
+	}
+	retval = MYSQL_SUCCESS;
+
+end:
+	for (i = 0; lengths && nulls && i < count; i++) {
+		results[i].length = NULL;
+		results[i].is_null = NULL;
+	}
+	mysql_stmt_free_result(stmt);
+	talloc_free(local_mem_ctx);
+	return retval;
+}
+
+
+enum MYSQLRESULT select_stmt_first_string(TALLOC_CTX *mem_ctx, MYSQL *conn,
+					  const char *sql, MYSQL_BIND *params,
+					  const char **s)
+{
+	MYSQL_BIND		result;
+	enum MYSQLRESULT	ret;
+
+	stmt_bind_string_result(&result);
+	ret = select_stmt_first_row(mem_ctx, conn, sql, params, &result);
+	if (ret == MYSQL_SUCCESS) {
+		*s = (const char *) result.buffer;
+	}
+
+	return ret;
+}
+
+
+enum MYSQLRESULT select_stmt_first_uint(MYSQL *conn, const char *sql,
+					MYSQL_BIND *params, uint64_t *n)
+{
+	MYSQL_BIND	result;
+
+	stmt_bind_uint64(&result, n);
+	return select_stmt_first_row(NULL, conn, sql, params, &result);
+}
+
+
 bool table_exists(MYSQL *conn, char *table_name)
 {
 	MYSQL_RES *res;
@@ -28,6 +28,10 @@
 #include <gen_ndr/exchange.h>
 
 #define THRESHOLD_SLOW_QUERIES 0.25
+/* Connections kept per connection string before they start being shared */
+#define MYSQL_POOL_SIZE 4
+/* Seconds a pooled connection may stay idle before being pinged again */
+#define MYSQL_POOL_PING_INTERVAL 30
 #define _sql(A, B) _sql_escape(A, B, '\'')
 
 const char* _sql_escape(TALLOC_CTX *mem_ctx, const char *s, char c);
@@ -38,6 +42,14 @@ enum MYSQLRESULT select_all_strings(TALLOC_CTX *, MYSQL *, const char *, struct
 enum MYSQLRESULT select_first_string(TALLOC_CTX *, MYSQL *, const char *, const char **);
 enum MYSQLRESULT select_first_uint(MYSQL *conn, const char *sql, uint64_t *n);
 
+void stmt_bind_uint64(MYSQL_BIND *, uint64_t *);
+void stmt_bind_string(MYSQL_BIND *, const char *);
+void stmt_bind_string_result(MYSQL_BIND *);
+enum MYSQLRESULT execute_stmt(MYSQL *, const char *, MYSQL_BIND *, uint64_t *);
+enum MYSQLRESULT select_stmt_first_row(TALLOC_CTX *, MYSQL *, const char *, MYSQL_BIND *, MYSQL_BIND *);
+enum MYSQLRESULT select_stmt_first_string(TALLOC_CTX *, MYSQL *, const char *, MYSQL_BIND *, const char **);
+enum MYSQLRESULT select_stmt_first_uint(MYSQL *, const char *, MYSQL_BIND *, uint64_t *);
+
 bool table_exists(MYSQL *, char *);
 bool create_schema(MYSQL *, const char *);
 bool convert_string_to_ull(const char *, uint64_t *);
@@ -27,6 +27,10 @@
 
 #define MIN(a,b) ((a)<(b)?(a):(b))
 
+/* [MS-OXCRPC] 2.2.2.1: the uncompressed payload following a
+   RPC_HEADER_EXT never exceeds 32KB */
+#define	MAPI_RPC_HEADER_EXT_SIZE_MAX	0x8000
+
 _PUBLIC_ void obfuscate_data(uint8_t *data, uint32_t size, uint8_t salt)
 {
 	uint32_t i;
@@ -36,64 +40,46 @@ _PUBLIC_ void obfuscate_data(uint8_t *data, uint32_t size, uint8_t salt)
 	}
 }
 
-ssize_t lzxpress_compress(const uint8_t *input,
-			  uint32_t input_size,
-			  uint8_t *output,
-			  uint32_t max_output_size);
-
-ssize_t lzxpress_decompress(const uint8_t *input,
-			    uint32_t input_size,
-			    uint8_t *output,
-			    uint32_t max_output_size);
-
 /**
-   \details Compress a LZXPRESS chunk
+   \details Compress a LZXPRESS buffer
+
+   [MS-OXCRPC] payloads are compressed as a single LZ77 stream, so the
+   whole uncompressed buffer is compressed at once.
 
    \param ndrpush pointer to the compressed data to return
    \param ndrpull pointer to the uncompressed data used for compression
-   \param last pointer on boolean to define whether or not this is the
-   last chunk
 
    \return NDR_ERR_SUCCESS on success, otherwise NDR error
  */
 static enum ndr_err_code ndr_push_lxpress_chunk(struct ndr_push *ndrpush,
-						struct ndr_pull *ndrpull,
-						bool *last)
+						struct ndr_pull *ndrpull)
 {
 	DATA_BLOB	comp_chunk;
 	DATA_BLOB	plain_chunk;
-	uint32_t	plain_chunk_size;
-	uint32_t	plain_chunk_offset;
-	uint32_t	max_plain_size = 0x00010000;
-	uint32_t	max_comp_size = 0x00020000 + 2; /* TODO: use the correct value here */
+	uint32_t	max_comp_size;
 	ssize_t		ret;
 
 	/* Step 1. Retrieve the uncompressed buf */
-	plain_chunk_size = MIN(max_plain_size, ndrpull->data_size - ndrpull->offset);
-	plain_chunk_offset = ndrpull->offset;
-	NDR_CHECK(ndr_pull_advance(ndrpull, plain_chunk_size));
-
-	plain_chunk.data = ndrpull->data + plain_chunk_offset;
-	plain_chunk.length = plain_chunk_size;
-	
-	if (plain_chunk_size < max_plain_size) {
-		*last = true;
-	};
+	plain_chunk.data = ndrpull->data + ndrpull->offset;
+	plain_chunk.length = ndrpull->data_size - ndrpull->offset;
+	NDR_CHECK(ndr_pull_advance(ndrpull, plain_chunk.length));
 
+	/* Worst case: literals only plus one flag word every 32 bytes */
+	max_comp_size = plain_chunk.length + ((plain_chunk.length / 32) + 2) * 4;
 	NDR_CHECK(ndr_push_expand(ndrpush, max_comp_size));
 
 	comp_chunk.data = ndrpush->data + ndrpush->offset;
 	comp_chunk.length = max_comp_size;
 
 	/* Compressing the buffer using LZ Xpress algorithm */
-	ret = lzxpress_compress(plain_chunk.data,
+	ret = compress_lzxpress(plain_chunk.data,
 				plain_chunk.length,
 				comp_chunk.data,
 				comp_chunk.length);
 
 	if (ret < 0) {
 		return ndr_pull_error(ndrpull, NDR_ERR_COMPRESSION,
-				      "XPRESS lzxpress_compress() returned %d\n",
+				      "XPRESS compress_lzxpress() returned %d\n",
 				      (int)ret);
 	}
 	comp_chunk.length = ret;
@@ -102,66 +88,58 @@ static enum ndr_err_code ndr_push_lxpress_chunk(struct ndr_push *ndrpush,
 	return NDR_ERR_SUCCESS;
 }
 
-static enum ndr_err_code ndr_pull_lxpress_chunk(struct ndr_pull *ndrpull,
-						struct ndr_push *ndrpush,
-						ssize_t decompressed_len,
-						bool *last)
+/**
+   \details Decompress a LZXPRESS blob
+
+   [MS-OXCRPC] payloads are compressed as a single LZ77 stream, so the
+   whole compressed buffer is decompressed at once.
+
+   \param subndr pointer to the compressed blob
+   \param _comndr pointer on pointer to the uncompressed blob the
+   function returns
+   \param decompressed_len the SizeActual field of the RPC_HEADER_EXT
+
+   \return NDR_ERR_SUCCESS on success, otherwise NDR error
+ */
+_PUBLIC_ enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *subndr,
+							struct ndr_pull **_comndr,
+							ssize_t decompressed_len)
 {
+	struct ndr_pull *comndr;
 	DATA_BLOB	comp_chunk;
 	DATA_BLOB	plain_chunk;
-	uint32_t	plain_chunk_offset;
-	int		ret;
+	ssize_t		ret;
+
+	if (decompressed_len < 0 || decompressed_len > MAPI_RPC_HEADER_EXT_SIZE_MAX) {
+		return ndr_pull_error(subndr, NDR_ERR_COMPRESSION,
+				      "Bad uncompressed_len [%d] (max 0x%x) (PULL)",
+				      (int)decompressed_len, MAPI_RPC_HEADER_EXT_SIZE_MAX);
+	}
 
 	/* Step 1. Retrieve the compressed buf */
-	comp_chunk.length = ndrpull->data_size;
-	comp_chunk.data = ndrpull->data;
+	comp_chunk.data = subndr->data + subndr->offset;
+	comp_chunk.length = subndr->data_size - subndr->offset;
+	NDR_CHECK(ndr_pull_advance(subndr, comp_chunk.length));
 
-	plain_chunk_offset = ndrpush->offset;
-	NDR_CHECK(ndr_push_zero(ndrpush, decompressed_len));
-	plain_chunk.length = decompressed_len;
-	plain_chunk.data = ndrpush->data + plain_chunk_offset;
+	/* Step 2. Decompress it */
+	plain_chunk = data_blob_talloc(subndr, NULL, decompressed_len);
+	if (decompressed_len && !plain_chunk.data) {
+		return NDR_ERR_ALLOC;
+	}
 
-	ret = lzxpress_decompress(comp_chunk.data,
+	ret = uncompress_lzxpress(comp_chunk.data,
 				  comp_chunk.length,
 				  plain_chunk.data,
 				  plain_chunk.length);
 	if (ret < 0) {
-		return ndr_pull_error(ndrpull, NDR_ERR_COMPRESSION,
-				      "XPRESS lzxpress_decompress() returned %d\n",
+		return ndr_pull_error(subndr, NDR_ERR_COMPRESSION,
+				      "XPRESS uncompress_lzxpress() returned %d\n",
 				      (int)ret);
 	}
-	plain_chunk.length = ret;
-	ndrpush->offset = ret;
-
-	if ((decompressed_len < 0x00010000) || (ndrpull->offset+4 >= ndrpull->data_size)) {
-		/* this is the last chunk */
-		*last = true;
-	}
-
-	return NDR_ERR_SUCCESS;
-}
-
-_PUBLIC_ enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *subndr,
-							struct ndr_pull **_comndr,
-							ssize_t decompressed_len)
-{
-	struct ndr_push *ndrpush;
-	struct ndr_pull *comndr;
-	DATA_BLOB	uncompressed;
-	bool		last = false;
-
-	ndrpush = ndr_push_init_ctx(subndr);
-	NDR_ERR_HAVE_NO_MEMORY(ndrpush);
-
-	while (!last) {
-		NDR_CHECK(ndr_pull_lxpress_chunk(subndr, ndrpush, decompressed_len, &last));
-	}
-
-	uncompressed = ndr_push_blob(ndrpush);
-	if (uncompressed.length != decompressed_len) {
+	if (ret != decompressed_len) {
 		return ndr_pull_error(subndr, NDR_ERR_COMPRESSION,
 				      "Bad uncompressed_len [%u] != [%u](0x%08X) (PULL)",
-				      (int)uncompressed.length,
+				      (int)ret,
 				      (int)decompressed_len,
 				      (int)decompressed_len);
 	}
@@ -170,8 +148,8 @@ _PUBLIC_ enum ndr_err_code ndr_pull_lzxpress_decompress(struct ndr_pull *subndr,
 	NDR_ERR_HAVE_NO_MEMORY(comndr);
 	comndr->flags = subndr->flags;
 	comndr->current_mem_ctx = subndr->current_mem_ctx;
-	comndr->data = uncompressed.data;
-	comndr->data_size = uncompressed.length;
+	comndr->data = plain_chunk.data;
+	comndr->data_size = plain_chunk.length;
 	comndr->offset = 0;
 
 	*_comndr = comndr;
@@ -190,7 +168,7 @@ _PUBLIC_ enum ndr_err_code ndr_push_lzxpress_compress(struct ndr_push *subndr,
 						      struct ndr_push *uncomndr)
 {
 	struct ndr_pull	*ndrpull;
-	bool		last = false;
+	enum ndr_err_code	ndr_err;
 
 	ndrpull = talloc_zero(uncomndr, struct ndr_pull);
 	NDR_ERR_HAVE_NO_MEMORY(ndrpull);
@@ -199,9 +177,87 @@ _PUBLIC_ enum ndr_err_code ndr_push_lzxpress_compress(struct ndr_push *subndr,
 	ndrpull->data_size = uncomndr->offset;
 	ndrpull->offset = 0;
 
-	while (!last) {
-		NDR_CHECK(ndr_push_lxpress_chunk(subndr, ndrpull, &last));
-	}
+	ndr_err = ndr_push_lxpress_chunk(subndr, ndrpull);
+	talloc_free(ndrpull);
+
+	return ndr_err;
+}
+
+
+/**
+   \details Push a MAPI payload as a list of extended buffers
+
+   The uncompressed payload following a RPC_HEADER_EXT never exceeds
+   32KB, larger payloads are split in several extended buffers and
+   only the last one has the RHEF_Last flag. Each chunk is compressed
+   on its own, and kept plain when compression does not make it
+   smaller.
+
+   \param ndr pointer to the ndr_push the extended buffers are appended to
+   \param uncomndr pointer to the uncompressed payload
+   \param flags RHEF_Compressed and RHEF_XorMagic flags to apply
+
+   \return NDR_ERR_SUCCESS on success, otherwise NDR error
+ */
+_PUBLIC_ enum ndr_err_code ndr_push_mapi2k7_chunks(struct ndr_push *ndr,
+						   struct ndr_push *uncomndr,
+						   uint16_t flags)
+{
+	struct RPC_HEADER_EXT	header;
+	struct ndr_pull		*ndrpull;
+	struct ndr_push		*comndr;
+	enum ndr_err_code	ndr_err;
+	uint32_t		offset;
+	uint32_t		start = 0;
+
+	offset = 0;
+	do {
+		ndrpull = talloc_zero(ndr, struct ndr_pull);
+		NDR_ERR_HAVE_NO_MEMORY(ndrpull);
+		ndrpull->flags = uncomndr->flags;
+		ndrpull->data = uncomndr->data + offset;
+		ndrpull->data_size = MIN(uncomndr->offset - offset, MAPI_RPC_HEADER_EXT_SIZE_MAX);
+		ndrpull->offset = 0;
+		offset += ndrpull->data_size;
+
+		header.Version = 0x0000;
+		header.Flags = flags & RHEF_XorMagic;
+		if (offset == uncomndr->offset) {
+			header.Flags |= RHEF_Last;
+		}
+		header.SizeActual = ndrpull->data_size;
+		header.Size = ndrpull->data_size;
+
+		comndr = NULL;
+		if (flags & RHEF_Compressed) {
+			comndr = ndr_push_init_ctx(ndrpull);
+			if (!comndr) {
+				talloc_free(ndrpull);
+				return NDR_ERR_ALLOC;
+			}
+			ndr_set_flags(&comndr->flags, LIBNDR_FLAG_NOALIGN);
+			ndr_err = ndr_push_lxpress_chunk(comndr, ndrpull);
+			if (ndr_err == NDR_ERR_SUCCESS && comndr->offset < header.SizeActual) {
+				header.Flags |= RHEF_Compressed;
+				header.Size = comndr->offset;
+			} else {
+				comndr = NULL;
+			}
+		}
+
+		ndr_err = ndr_push_RPC_HEADER_EXT(ndr, NDR_SCALARS, &header);
+		if (ndr_err == NDR_ERR_SUCCESS) {
+			start = ndr->offset;
+			ndr_err = ndr_push_bytes(ndr, comndr ? comndr->data : ndrpull->data, header.Size);
+		}
+		talloc_free(ndrpull);
+		NDR_CHECK(ndr_err);
+
+		/* Obfuscation is applied on top of the compressed payload */
+		if (header.Flags & RHEF_XorMagic) {
+			obfuscate_data(ndr->data + start, header.Size, 0xA5);
+		}
+	} while (offset < uncomndr->offset);
 
 	return NDR_ERR_SUCCESS;
 }
@@ -260,36 +316,59 @@ _PUBLIC_ enum ndr_err_code ndr_pull_mapi2k7_request(struct ndr_pull *ndr, int nd
 
 _PUBLIC_ enum ndr_err_code ndr_pull_mapi2k7_response(struct ndr_pull *ndr, int ndr_flags, struct mapi2k7_response *r)
 {
+	struct RPC_HEADER_EXT	header;
+	struct ndr_pull		*_ndr_buffer;
+	struct ndr_pull		*_ndr_data;
+	struct ndr_pull		*_ndr_payload;
+	DATA_BLOB		payload;
+	uint32_t		_flags_save_mapi_response;
+	uint32_t		count;
+
 	if (ndr_flags & NDR_SCALARS) {
-		NDR_CHECK(ndr_pull_RPC_HEADER_EXT(ndr, NDR_SCALARS, &r->header));
-		{
-			uint32_t _flags_save_mapi_response = ndr->flags;
-			ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REMAINING);
-			{
-				struct ndr_pull *_ndr_buffer;
-				
-				if (ndr->flags & LIBNDR_FLAG_REF_ALLOC) {
-					NDR_PULL_ALLOC(ndr, r->mapi_response);
-				}
-				
-				NDR_CHECK((ndr_pull_subcontext_start(ndr, &_ndr_buffer, 0, r->header.Size)));
-				{
-					if (r->header.Flags & RHEF_Compressed) {
-						struct ndr_pull *_ndr_data_compressed = NULL;
-						
-						NDR_CHECK(ndr_pull_lzxpress_decompress(_ndr_buffer, &_ndr_data_compressed, r->header.SizeActual));
-						NDR_CHECK(ndr_pull_mapi_response(_ndr_data_compressed, NDR_SCALARS|NDR_BUFFERS, r->mapi_response));
-					} else if (r->header.Flags & RHEF_XorMagic) {
-						obfuscate_data(_ndr_buffer->data, _ndr_buffer->data_size, 0xA5);
-						NDR_CHECK(ndr_pull_mapi_response(_ndr_buffer, NDR_SCALARS|NDR_BUFFERS, r->mapi_response));
-					} else {
-						NDR_CHECK(ndr_pull_mapi_response(_ndr_buffer, NDR_SCALARS|NDR_BUFFERS, r->mapi_response));			
-					}
-				}
-				NDR_CHECK(ndr_pull_subcontext_end(ndr, _ndr_buffer, 0, r->header.Size));
-			}
-			ndr->flags = _flags_save_mapi_response;
+		_flags_save_mapi_response = ndr->flags;
+		ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REMAINING);
+
+		if (ndr->flags & LIBNDR_FLAG_REF_ALLOC) {
+			NDR_PULL_ALLOC(ndr, r->mapi_response);
 		}
+
+		/* The server splits responses larger than 32KB in several
+		   extended buffers, join their payloads up to the one
+		   with the RHEF_Last flag */
+		payload = data_blob_talloc(ndr, NULL, 0);
+		count = 0;
+		do {
+			NDR_CHECK(ndr_pull_RPC_HEADER_EXT(ndr, NDR_SCALARS, &header));
+			if (!count++) {
+				r->header = header;
+			}
+
+			NDR_CHECK((ndr_pull_subcontext_start(ndr, &_ndr_buffer, 0, header.Size)));
+			/* Obfuscation is applied on top of the compressed payload */
+			if (header.Flags & RHEF_XorMagic) {
+				obfuscate_data(_ndr_buffer->data, _ndr_buffer->data_size, 0xA5);
+			}
+			if (header.Flags & RHEF_Compressed) {
+				NDR_CHECK(ndr_pull_lzxpress_decompress(_ndr_buffer, &_ndr_data, header.SizeActual));
+			} else {
+				_ndr_data = _ndr_buffer;
+			}
+			if (!data_blob_append(ndr, &payload, _ndr_data->data, _ndr_data->data_size)) {
+				return NDR_ERR_ALLOC;
+			}
+			NDR_CHECK(ndr_pull_subcontext_end(ndr, _ndr_buffer, 0, header.Size));
+		} while (!(header.Flags & RHEF_Last));
+
+		_ndr_payload = talloc_zero(ndr, struct ndr_pull);
+		NDR_ERR_HAVE_NO_MEMORY(_ndr_payload);
+		_ndr_payload->flags = ndr->flags;
+		_ndr_payload->current_mem_ctx = ndr->current_mem_ctx;
+		_ndr_payload->data = payload.data;
+		_ndr_payload->data_size = payload.length;
+		_ndr_payload->offset = 0;
+		NDR_CHECK(ndr_pull_mapi_response(_ndr_payload, NDR_SCALARS|NDR_BUFFERS, r->mapi_response));
+
+		ndr->flags = _flags_save_mapi_response;
 	}
 
 	return NDR_ERR_SUCCESS;
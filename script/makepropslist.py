@@ -438,8 +438,7 @@ def debug_dump():
 	for entry in properties:
 		print entry
 
-extra_private_tags_struct = """\t{ PidTagFolderChildCount,                                             PT_LONG,      \"PidTagFolderChildCount\"                                            },
-"""
+extra_private_tags = [ ("PidTagFolderChildCount", "PT_LONG", 0x66380003) ]
 
 temporary_private_tags = """
 #define openchange_private_ROOT_FOLDER_FID                  PROP_TAG(PT_I8        , 0xd001) /* 0xd0010014 */
@@ -506,38 +505,34 @@ temporary_private_tags = """
 #define openchange_private_PF_LOCAL_OAB_ERROR               PROP_TAG(PT_ERROR     , 0xd01f) /* 0xd01f000a */
 """
 
-temporary_private_tags_struct = """\t{ openchange_private_ROOT_FOLDER_FID,		PT_I8, "openchange_private_ROOT_FOLDER_FID" },
-	{ openchange_private_DEFERRED_ACTIONS_FID,	PT_I8, "openchange_private_DEFERRED_ACTIONS_FID" },
-	{ openchange_private_SPOOLER_QUEUE_FID,		PT_I8, "openchange_private_SPOOLER_QUEUE_FID" },
-	{ openchange_private_IPM_SUBTREE_FID,		PT_I8, "openchange_private_IPM_SUBTREE_FID" },
-	{ openchange_private_INBOX_FID,			PT_I8, "openchange_private_INBOX_FID" },
-	{ openchange_private_OUTBOX_FID,		PT_I8, "openchange_private_OUTBOX_FID" },
-	{ openchange_private_SENT_ITEMS_FID,		PT_I8, "openchange_private_SENT_ITEMS_FID" },
-	{ openchange_private_DELETED_ITEMS_FID,		PT_I8, "openchange_private_DELETED_ITEMS_FID" },
-	{ openchange_private_COMMON_VIEWS_FID,		PT_I8, "openchange_private_COMMON_VIEWS_FID" },
-	{ openchange_private_SCHEDULE_FID,		PT_I8, "openchange_private_SCHEDULE_FID" },
-	{ openchange_private_SEARCH_FID,		PT_I8, "openchange_private_SEARCH_FID" },
-	{ openchange_private_VIEWS_FID,			PT_I8, "openchange_private_VIEWS_FID" },
-	{ openchange_private_SHORTCUTS_FID,		PT_I8, "openchange_private_SHORTCUTS_FID" },
-	{ openchange_private_MailboxGUID,		PT_CLSID, "openchange_private_MailboxGUID" },
-	{ openchange_private_ReplicaID,			PT_SHORT, "openchange_private_ReplicaID" },
-	{ openchange_private_ReplicaGUID,		PT_CLSID, "openchange_private_ReplicaGUID" },
-	{ openchange_private_CONTACT_FID,		PT_I8, "openchange_private_CONTACT_FID" },
-	{ openchange_private_CALENDAR_FID,		PT_I8, "openchange_private_CALENDAR_FID" },
-	{ openchange_private_JOURNAL_FID,		PT_I8, "openchange_private_JOURNAL_FID" },
-	{ openchange_private_NOTE_FID,			PT_I8, "openchange_private_NOTE_FID" },
-	{ openchange_private_TASK_FID,			PT_I8, "openchange_private_TASK_FID" },
-	{ openchange_private_DRAFTS_FID,		PT_I8, "openchange_private_DRAFTS_FID" },
-	{ openchange_private_PF_ROOT,			PT_I8, "openchange_private_PF_ROOT" },
-	{ openchange_private_PF_IPM_SUBTREE,		PT_I8, "openchange_private_PF_IPM_SUBTREE" },
-	{ openchange_private_PF_NONIPM_SUBTREE,		PT_I8, "openchange_private_PF_NONIPM_SUBTREE" },
-	{ openchange_private_PF_EFORMS,			PT_I8, "openchange_private_PF_EFORMS" },
-	{ openchange_private_PF_FREEBUSY,		PT_I8, "openchange_private_PF_FREEBUSY" },
-	{ openchange_private_PF_OAB,			PT_I8, "openchange_private_PF_OAB" },
-	{ openchange_private_PF_LOCAL_EFORMS,		PT_I8, "openchange_private_PF_LOCAL_EFORMS" },
-	{ openchange_private_PF_LOCAL_FREEBUSY,		PT_I8, "openchange_private_PF_LOCAL_FREEBUSY" },
-	{ openchange_private_PF_LOCAL_OAB,		PT_I8, "openchange_private_PF_LOCAL_OAB" },
-"""
+def temporary_private_proptags():
+	proptags = []
+	for define in re.finditer(r"#define (\w+)\s+PROP_TAG\((\w+)\s*, 0x\w+\) /\* (0x\w+) \*/", temporary_private_tags):
+		if define.group(2) != "PT_ERROR":
+			proptags.append((define.group(1), define.group(2), int(define.group(3), 16)))
+	return proptags
+
+def write_index_array(f, name, positions):
+	f.write("static const uint16_t %s[] = {\n" % name)
+	for i in range(0, len(positions), 12):
+		f.write("\t" + ", ".join("%4d" % position for position in positions[i:i + 12]) + ",\n")
+	f.write("};\n")
+
+def write_canonical_property_tags(f, proptags):
+	# proptags is a list of (name, type, tag) tuples
+	sortedproptags = sorted(proptags, key=lambda proptag: proptag[0])
+	f.write("/* Sorted by property name */\n")
+	f.write("static const struct mapi_proptags canonical_property_tags[] = {\n")
+	for (name, proptype, tag) in sortedproptags:
+		propline = "\t{ "
+		propline += string.ljust(name + ",", 68)
+		propline += string.ljust(proptype + ",", 14)
+		propline += string.ljust("\"" + name + "\"" , 68) + "},\n"
+		f.write(propline)
+	f.write("};\n\n")
+	f.write("/* canonical_property_tags positions sorted by property tag */\n")
+	write_index_array(f, "canonical_property_tags_by_tag",
+			  sorted(range(len(sortedproptags)), key=lambda idx: sortedproptags[idx][2]))
 
 def make_mapi_properties_file():
 	proplines = []
@@ -687,6 +682,7 @@ def make_mapi_properties_file():
 	f.write("\tconst char	*propname;\n")
 	f.write("};\n")
 	f.write("\n")
+	proptags = []
 	for entry in properties:
 		if (entry.has_key("CanonicalName") == False):
 			print "Section", entry["OXPROPS_Sect"], "has no canonical name entry"
@@ -695,79 +691,112 @@ def make_mapi_properties_file():
 			print "Section", entry["OXPROPS_Sect"], "has no data type entry"
 			continue
 		if entry.has_key("PropertyId"):
-			propline = "\t{ "
-			propline += string.ljust(entry["CanonicalName"] + ",", 68)
-			propline += string.ljust(datatypemap[entry["DataTypeName"]] + ",", 14)
-			propline += string.ljust("\"" + entry["CanonicalName"] + "\"" , 68) + "},\n"
-			proplines.append(propline)
-			propline = "\t{ "
-			propline += string.ljust(entry["CanonicalName"] + "_Error,", 68)
-			propline += string.ljust("PT_ERROR,", 14)
-			propline += string.ljust("\"" + entry["CanonicalName"] + "_Error" + "\"" , 68) + "},\n"
-			proplines.append(propline)
-	proplines.append(extra_private_tags_struct)
+			proptag = entry["PropertyId"] << 16
+			proptags.append((entry["CanonicalName"], datatypemap[entry["DataTypeName"]],
+					 proptag | int(knowndatatypes[entry["DataTypeName"]], 16)))
+			proptags.append((entry["CanonicalName"] + "_Error", "PT_ERROR", proptag | 0x000A))
+	proptags += extra_private_tags
 	# this is just a temporary hack till we properly support named properties
-	proplines.append(temporary_private_tags_struct)
-	sortedproplines = sorted(proplines)
-	f.write("static struct mapi_proptags canonical_property_tags[] = {\n")
-	for propline in sortedproplines:
-		f.write(propline)
-	f.write("\t{ 0,                                                                  0,            \"NULL\"                                                              }\n")
-	f.write("};\n")
+	proptags += temporary_private_proptags()
+	write_canonical_property_tags(f, proptags)
 	f.write("""
+#define	CANONICAL_PROPERTY_TAGS_COUNT	(sizeof (canonical_property_tags_by_tag) / sizeof (uint16_t))
+
+/**
+   \\details Return the first canonical_property_tags_by_tag position
+   whose property tag is not lower than proptag
+ */
+static uint32_t canonical_property_tags_lower_bound(uint32_t proptag)
+{
+	uint32_t	low = 0;
+	uint32_t	high = CANONICAL_PROPERTY_TAGS_COUNT;
+	uint32_t	mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (canonical_property_tags[canonical_property_tags_by_tag[mid]].proptag < proptag) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+static const char *canonical_property_tags_name(uint32_t proptag)
+{
+	uint32_t	idx;
+
+	idx = canonical_property_tags_lower_bound(proptag);
+	if (idx < CANONICAL_PROPERTY_TAGS_COUNT &&
+	    canonical_property_tags[canonical_property_tags_by_tag[idx]].proptag == proptag) {
+		return canonical_property_tags[canonical_property_tags_by_tag[idx]].propname;
+	}
+
+	return NULL;
+}
+
+static int canonical_property_tags_cmp(const void *propname, const void *entry)
+{
+	return strcmp((const char *) propname, ((const struct mapi_proptags *) entry)->propname);
+}
+
 _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 {
-	uint32_t idx;
+	const char	*propname;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+	propname = canonical_property_tags_name(proptag);
+	if (propname) {
+		return propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
-		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+		/* try as _UNICODE variant */
+		return canonical_property_tags_name(proptag + 1);
 	}
 	return NULL;
 }
 
 _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
-	uint32_t idx;
+	const struct mapi_proptags	*entry;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
-		}
+	if (!propname) {
+		return 0;
 	}
 
-	return 0;
+	entry = bsearch(propname, canonical_property_tags, CANONICAL_PROPERTY_TAGS_COUNT,
+			sizeof (struct mapi_proptags), canonical_property_tags_cmp);
+
+	return entry ? entry->proptag : 0;
 }
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
 	uint32_t	idx;
+	uint32_t	found = CANONICAL_PROPERTY_TAGS_COUNT;
 	uint16_t	current_type;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
+	/* All the types of a property id are adjacent in the tag
+	 * index. The one coming first in the table is returned. */
+	for (idx = canonical_property_tags_lower_bound((uint32_t)untypedtag << 16);
+	     idx < CANONICAL_PROPERTY_TAGS_COUNT &&
+		     (canonical_property_tags[canonical_property_tags_by_tag[idx]].proptag >> 16) == untypedtag;
+	     idx++) {
+		current_type = canonical_property_tags[canonical_property_tags_by_tag[idx]].proptype;
+		if (current_type != PT_ERROR && current_type != PT_STRING8 &&
+		    canonical_property_tags_by_tag[idx] < found) {
+			found = canonical_property_tags_by_tag[idx];
 		}
 	}
+	if (found < CANONICAL_PROPERTY_TAGS_COUNT) {
+		return canonical_property_tags[found].proptype;
+	}
 
 	DEBUG(5, ("%s: type for property '%x' could not be deduced\\n", __FUNCTION__, untypedtag));
 	return 0;
 }
-
-
 """)
 	f.close()
 
@@ -1127,6 +1156,27 @@ def find_key(dic, val):
 	except ValueError:
 		print "Value %s not found" % val
 
+def write_mapi_nameid_indexes(f, nameid_tags, nameid_names):
+	# Positions are sorted by key and then by position, so the first
+	# match of a lookup is the first one in table order
+	f.write("\n/* mapi_nameid_tags positions sorted by proptag, lid, OOM and Name */\n")
+	write_index_array(f, "mapi_nameid_tags_by_proptag",
+			  sorted(range(len(nameid_tags)), key=lambda idx: nameid_tags[idx][0]))
+	write_index_array(f, "mapi_nameid_tags_by_lid",
+			  sorted([idx for idx in range(len(nameid_tags)) if nameid_tags[idx][2]],
+				 key=lambda idx: nameid_tags[idx][2]))
+	write_index_array(f, "mapi_nameid_tags_by_OOM",
+			  sorted([idx for idx in range(len(nameid_tags)) if nameid_tags[idx][1] is not None],
+				 key=lambda idx: nameid_tags[idx][1]))
+	write_index_array(f, "mapi_nameid_tags_by_Name",
+			  sorted([idx for idx in range(len(nameid_tags)) if nameid_tags[idx][3] is not None],
+				 key=lambda idx: nameid_tags[idx][3]))
+	f.write("\n/* mapi_nameid_names positions sorted by proptag and propname */\n")
+	write_index_array(f, "mapi_nameid_names_by_proptag",
+			  sorted(range(len(nameid_names)), key=lambda idx: nameid_names[idx][0]))
+	write_index_array(f, "mapi_nameid_names_by_propname",
+			  sorted(range(len(nameid_names)), key=lambda idx: nameid_names[idx][1]))
+
 def make_mapi_named_properties_file():
 	content = ""
 	attributes = ""
@@ -1320,9 +1370,11 @@ struct mapi_nameid {
 /* MNID_ID named properties */
 """)
 
+	namedproptags = {}
 	for line in sortednamedprops:
 		if line[5] == "MNID_ID":
-			proptag = "0x%.8x" % (int(line[2], 16) << 16 | int(line[4], 16))
+			namedproptags[line[0]] = int(line[2], 16) << 16 | int(line[4], 16)
+			proptag = "0x%.8x" % namedproptags[line[0]]
 			propline = "#define %s %s\n" % (string.ljust(line[0], 60), string.ljust(proptag, 20))
 			f.write(propline)
 
@@ -1330,7 +1382,8 @@ struct mapi_nameid {
 	mnstring_id = 0xa000
 	for line in sortednamedprops:
 		if line[5] == "MNID_STRING":
-			proptag = "0x%.8x" % ((mnstring_id << 16) | int(line[4], 16))
+			namedproptags[line[0]] = (mnstring_id << 16) | int(line[4], 16)
+			proptag = "0x%.8x" % namedproptags[line[0]]
 			propline = "#define %s %s\n" % (string.ljust(line[0], 60), string.ljust(proptag, 20))
 			mnstring_id += 1
 			f.write(propline)
@@ -1352,6 +1405,8 @@ struct mapi_nameid {
 static struct mapi_nameid_tags mapi_nameid_tags[] = {
 """)
 
+	# (proptag, OOM, lid, Name) of each entry for the lookup indexes
+	nameid_tags = []
 	for line in sortednamedprops:
 		if line[5] == "MNID_ID":
 			OOM = "\"%s\"" % line[1]
@@ -1361,6 +1416,7 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 				string.ljust(line[0], 60), string.ljust(OOM, 65), line[2], line[3], 
 				string.ljust(datatype, 15), "MNID_ID", line[6], "0x0")
 			f.write(propline)
+			nameid_tags.append((namedproptags[line[0]], line[1], int(line[2], 16), None))
 
 	for line in sortednamedprops:
 		if line[5] == "MNID_STRING":
@@ -1371,12 +1427,17 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 				string.ljust(line[0], 60), string.ljust(OOM, 65), line[2], line[3], 
 				string.ljust(datatype, 15), "MNID_STRING", line[6], "0x0")
 			f.write(propline)
+			if line[1] == "NULL":
+				nameid_tags.append((namedproptags[line[0]], None, int(line[2], 16), line[3]))
+			else:
+				nameid_tags.append((namedproptags[line[0]], line[1], int(line[2], 16), line[3]))
 
 	# Addtional named properties
 	propline = "{ %s, %s, %s, %s, %s, %s, %s, %s },\n" % (
 		string.ljust("PidLidRemoteTransferSize", 60), string.ljust("\"RemoteTransferSize\"", 65), "0x8f05",
 		"NULL", string.ljust("PT_LONG", 15), "MNID_ID", "PSETID_Remote", "0x0")
 	f.write(propline)
+	nameid_tags.append((0x8f050003, "RemoteTransferSize", 0x8f05, None))
 
 	propline = "{ %s, %s, %s, %s, %s, %s, %s, %s }\n" % (
 		string.ljust("0x00000000", 60), string.ljust("NULL", 65), "0x0000", "NULL",
@@ -1389,9 +1450,11 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 	f.write("""
 static struct mapi_nameid_names mapi_nameid_names[] = {
 """)
+	nameid_names = []
 	for line in sortednamedprops:
 		propline = "{ %s, \"%s\" },\n" % (string.ljust(line[0], 60), line[0])
 		f.write(propline)
+		nameid_names.append((namedproptags[line[0]], line[0]))
 
 	# Additional named properties
 	propline = "{ %s, \"%s\" }\n" % (string.ljust("PidLidRemoteTransferSize", 60), "PidLidRemoteTransferSize")	
@@ -1400,7 +1463,9 @@ static struct mapi_nameid_names mapi_nameid_names[] = {
 	f.write(propline)
 	f.write("""
 };
-
+""")
+	write_mapi_nameid_indexes(f, nameid_tags, nameid_names)
+	f.write("""
 #endif /* !MAPI_NAMEID_PRIVATE_H__ */
 """)
 	f.close()
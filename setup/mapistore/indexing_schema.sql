@@ -20,4 +20,31 @@ CREATE TABLE IF NOT EXISTS `mapistore_indexes` (
   PRIMARY KEY (`id`))
 ENGINE = InnoDB;
 
+-- -----------------------------------------------------
+-- Table `mapistore_cn_index`
+-- -----------------------------------------------------
+CREATE TABLE IF NOT EXISTS `mapistore_cn_index` (
+  `id` INT NOT NULL AUTO_INCREMENT,
+  `username` VARCHAR(255) NOT NULL,
+  `mid` BIGINT UNSIGNED NOT NULL,
+  `folder_id` BIGINT UNSIGNED NOT NULL,
+  `table_type` TINYINT UNSIGNED NOT NULL,
+  `cn` BIGINT UNSIGNED NOT NULL,
+  PRIMARY KEY (`id`),
+  UNIQUE INDEX `mapistore_cn_index_mid` (`username`, `mid`),
+  INDEX `mapistore_cn_index_cn` (`username`, `folder_id`, `table_type`, `cn`))
+ENGINE = InnoDB;
 
+-- -----------------------------------------------------
+-- Table `mapistore_cn_index_state`
+-- -----------------------------------------------------
+CREATE TABLE IF NOT EXISTS `mapistore_cn_index_state` (
+  `id` INT NOT NULL AUTO_INCREMENT,
+  `username` VARCHAR(255) NOT NULL,
+  `folder_id` BIGINT UNSIGNED NOT NULL,
+  `table_type` TINYINT UNSIGNED NOT NULL,
+  `state` TINYINT UNSIGNED NOT NULL,
+  `generation` INT UNSIGNED NOT NULL DEFAULT 0,
+  PRIMARY KEY (`id`),
+  UNIQUE INDEX `mapistore_cn_index_state_folder` (`username`, `folder_id`, `table_type`))
+ENGINE = InnoDB;
@@ -0,0 +1,260 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "libmapi/libmapi.h"
+#include <time.h>
+
+#define	FRAGMENTED_RANGES	100000
+
+/* Global test variables */
+static TALLOC_CTX	*mem_ctx;
+static struct GUID	replica_guid;
+
+
+/* Globcnts are stored in their wire form in idsets */
+static uint64_t make_eid(uint16_t replid, uint64_t globcnt)
+{
+	return (exchange_globcnt(globcnt) << 16) | replid;
+}
+
+static struct idset *make_guid_idset(const uint64_t *globcnts, uint32_t count)
+{
+	struct rawidset	*rawidset;
+	uint32_t	i;
+
+	rawidset = RAWIDSET_make(mem_ctx, false, false);
+	for (i = 0; i < count; i++) {
+		RAWIDSET_push_guid_glob(rawidset, &replica_guid, exchange_globcnt(globcnts[i]));
+	}
+
+	return RAWIDSET_convert_to_idset(mem_ctx, rawidset);
+}
+
+static bool includes_globcnt(const struct idset *idset, uint64_t globcnt)
+{
+	return IDSET_includes_guid_glob(idset, &replica_guid, exchange_globcnt(globcnt));
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_make_and_includes) {
+	const uint64_t	globcnts[] = { 12, 3, 4, 5, 10, 11, 20 };
+	struct idset	*idset;
+
+	idset = make_guid_idset(globcnts, sizeof (globcnts) / sizeof (globcnts[0]));
+	ck_assert(idset != NULL);
+	ck_assert_int_eq(idset->range_count, 3);
+	ck_assert(exchange_globcnt(idset->ranges[0].low) == 3);
+	ck_assert(exchange_globcnt(idset->ranges[0].high) == 5);
+	ck_assert(exchange_globcnt(idset->ranges[1].low) == 10);
+	ck_assert(exchange_globcnt(idset->ranges[1].high) == 12);
+	ck_assert(exchange_globcnt(idset->ranges[2].low) == 20);
+
+	ck_assert(!includes_globcnt(idset, 2));
+	ck_assert(includes_globcnt(idset, 3));
+	ck_assert(includes_globcnt(idset, 5));
+	ck_assert(!includes_globcnt(idset, 6));
+	ck_assert(includes_globcnt(idset, 11));
+	ck_assert(!includes_globcnt(idset, 19));
+	ck_assert(includes_globcnt(idset, 20));
+	ck_assert(!includes_globcnt(idset, 21));
+} END_TEST
+
+START_TEST (test_includes_eid) {
+	struct rawidset	*rawidset;
+	struct idset	*idset;
+	uint64_t	i;
+
+	rawidset = RAWIDSET_make(mem_ctx, true, false);
+	for (i = 1; i <= 100; i++) {
+		RAWIDSET_push_eid(rawidset, make_eid(1, i * 2));
+		RAWIDSET_push_eid(rawidset, make_eid(2, i));
+	}
+	idset = RAWIDSET_convert_to_idset(mem_ctx, rawidset);
+	ck_assert(idset != NULL && idset->next != NULL);
+
+	ck_assert(IDSET_includes_eid(idset, make_eid(1, 42)));
+	ck_assert(!IDSET_includes_eid(idset, make_eid(1, 43)));
+	ck_assert(IDSET_includes_eid(idset, make_eid(2, 43)));
+	ck_assert(!IDSET_includes_eid(idset, make_eid(2, 101)));
+	ck_assert(!IDSET_includes_eid(idset, make_eid(3, 42)));
+} END_TEST
+
+START_TEST (test_serialize_round_trip) {
+	const uint64_t	globcnts[] = { 1, 2, 3, 7, 0x10000, 0x10001, 0x123456789a };
+	struct idset	*idset;
+	struct idset	*parsed;
+	struct Binary_r	*bin;
+	DATA_BLOB	blob;
+	uint32_t	i;
+
+	idset = make_guid_idset(globcnts, sizeof (globcnts) / sizeof (globcnts[0]));
+	bin = IDSET_serialize(mem_ctx, idset);
+	ck_assert(bin != NULL);
+
+	blob.data = bin->lpb;
+	blob.length = bin->cb;
+	parsed = IDSET_parse(mem_ctx, blob, false);
+	ck_assert(parsed != NULL);
+	ck_assert(GUID_equal(&parsed->repl.guid, &replica_guid));
+	ck_assert_int_eq(parsed->range_count, idset->range_count);
+	for (i = 0; i < idset->range_count; i++) {
+		ck_assert(parsed->ranges[i].low == idset->ranges[i].low);
+		ck_assert(parsed->ranges[i].high == idset->ranges[i].high);
+	}
+} END_TEST
+
+START_TEST (test_merge) {
+	const uint64_t	left_globcnts[] = { 1, 2, 10, 11, 30 };
+	const uint64_t	right_globcnts[] = { 3, 4, 20, 29 };
+	struct idset	*left;
+	struct idset	*right;
+	struct idset	*merged;
+
+	left = make_guid_idset(left_globcnts, sizeof (left_globcnts) / sizeof (left_globcnts[0]));
+	right = make_guid_idset(right_globcnts, sizeof (right_globcnts) / sizeof (right_globcnts[0]));
+
+	merged = IDSET_merge_idsets(mem_ctx, left, right);
+	ck_assert(merged != NULL);
+	ck_assert(merged->next == NULL);
+	/* [1:4] [10:11] [20] [29:30] */
+	ck_assert_int_eq(merged->range_count, 4);
+	ck_assert(exchange_globcnt(merged->ranges[0].high) == 4);
+	ck_assert(exchange_globcnt(merged->ranges[3].low) == 29);
+	ck_assert(exchange_globcnt(merged->ranges[3].high) == 30);
+
+	/* Sources are left untouched */
+	ck_assert_int_eq(left->range_count, 3);
+	ck_assert_int_eq(right->range_count, 3);
+} END_TEST
+
+START_TEST (test_remove) {
+	const uint64_t	globcnts[] = { 1, 2, 3, 4, 5, 9 };
+	struct rawidset	*removed;
+	struct idset	*idset;
+
+	idset = make_guid_idset(globcnts, sizeof (globcnts) / sizeof (globcnts[0]));
+	ck_assert_int_eq(idset->range_count, 2);
+
+	removed = RAWIDSET_make(mem_ctx, false, false);
+	RAWIDSET_push_guid_glob(removed, &replica_guid, exchange_globcnt(3));
+	RAWIDSET_push_guid_glob(removed, &replica_guid, exchange_globcnt(5));
+	RAWIDSET_push_guid_glob(removed, &replica_guid, exchange_globcnt(9));
+	RAWIDSET_push_guid_glob(removed, &replica_guid, exchange_globcnt(42));
+	IDSET_remove_rawidset(idset, removed);
+
+	/* [1:2] [4] */
+	ck_assert_int_eq(idset->range_count, 2);
+	ck_assert(includes_globcnt(idset, 2));
+	ck_assert(!includes_globcnt(idset, 3));
+	ck_assert(includes_globcnt(idset, 4));
+	ck_assert(!includes_globcnt(idset, 5));
+	ck_assert(!includes_globcnt(idset, 9));
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_benchmark_fragmented) {
+	struct idset	*odd;
+	struct idset	*even;
+	struct idset	*merged;
+	uint64_t	*globcnts;
+	struct timespec	start;
+	double		make_ms, includes_ms, merge_ms;
+	uint32_t	i;
+	uint32_t	hits = 0;
+
+	/* Every other globcnt, so that each one is a range of its own */
+	globcnts = talloc_array(mem_ctx, uint64_t, FRAGMENTED_RANGES);
+	for (i = 0; i < FRAGMENTED_RANGES; i++) {
+		globcnts[i] = (uint64_t) i * 4 + 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	odd = make_guid_idset(globcnts, FRAGMENTED_RANGES);
+	make_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(odd->range_count, FRAGMENTED_RANGES);
+
+	for (i = 0; i < FRAGMENTED_RANGES; i++) {
+		globcnts[i] += 2;
+	}
+	even = make_guid_idset(globcnts, FRAGMENTED_RANGES);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < FRAGMENTED_RANGES * 2; i++) {
+		if (includes_globcnt(odd, (uint64_t)(i * 7919) % (FRAGMENTED_RANGES * 4))) {
+			hits++;
+		}
+	}
+	includes_ms = testsuite_elapsed_ms(&start);
+	ck_assert(hits > 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	merged = IDSET_merge_idsets(mem_ctx, odd, even);
+	merge_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(merged->range_count, FRAGMENTED_RANGES * 2);
+	ck_assert(includes_globcnt(merged, 3));
+	ck_assert(!includes_globcnt(merged, 4));
+
+	testsuite_benchmark_report("idset %u fragmented ranges: make %.2fms, %u lookups %.2fms, merge %.2fms\n",
+	                           FRAGMENTED_RANGES, make_ms, FRAGMENTED_RANGES * 2, includes_ms, merge_ms);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_idset_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "tc_idset_setup");
+	GUID_from_string("c4d3a1a8-0b2f-4d7e-9a1b-6f3e2d1c0b9a", &replica_guid);
+}
+
+static void tc_idset_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_idset_suite(void)
+{
+	Suite *s = suite_create("libmapi idset");
+
+	TCase *tc = tcase_create("IDSET ranges");
+	tcase_add_checked_fixture(tc, tc_idset_setup, tc_idset_teardown);
+
+	tcase_add_test(tc, test_make_and_includes);
+	tcase_add_test(tc, test_includes_eid);
+	tcase_add_test(tc, test_serialize_round_trip);
+	tcase_add_test(tc, test_merge);
+	tcase_add_test(tc, test_remove);
+
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create("IDSET performance");
+		tcase_add_checked_fixture(tc_perf, tc_idset_setup, tc_idset_teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_fragmented);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
@@ -0,0 +1,225 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "libmapi/libmapi.h"
+#include <time.h>
+
+#define	BENCHMARK_SIZE	(1024 * 1024)
+
+/* Global test variables */
+static TALLOC_CTX *mem_ctx;
+
+/* From MS-OXRTFCP, Section 4.1.1 */
+static const uint8_t rtf_compressed1[] = {
+	0x2d, 0x00, 0x00, 0x00, 0x2b, 0x00, 0x00, 0x00, 0x4c, 0x5a, 0x46, 0x75,
+	0xf1, 0xc5, 0xc7, 0xa7, 0x03, 0x00, 0x0a, 0x00, 0x72, 0x63, 0x70, 0x67,
+	0x31, 0x32, 0x35, 0x42, 0x32, 0x0a, 0xf3, 0x20, 0x68, 0x65, 0x6c, 0x09,
+	0x00, 0x20, 0x62, 0x77, 0x05, 0xb0, 0x6c, 0x64, 0x7d, 0x0a, 0x80, 0x0f,
+	0xa0
+};
+#define	RTF_UNCOMPRESSED1 "{\\rtf1\\ansi\\ansicpg1252\\pard hello world}\r\n"
+
+/* From MS-OXRTFCP, Section 4.1.2 */
+static const uint8_t rtf_compressed2[] = {
+	0x1a, 0x00, 0x00, 0x00, 0x1c, 0x00, 0x00, 0x00, 0x4c, 0x5a, 0x46, 0x75,
+	0xe2, 0xd4, 0x4b, 0x51, 0x41, 0x00, 0x04, 0x20, 0x57, 0x58, 0x59, 0x5a,
+	0x0d, 0x6e, 0x7d, 0x01, 0x0e, 0xb0
+};
+#define	RTF_UNCOMPRESSED2 "{\\rtf1 WXYZWXYZWXYZWXYZWXYZ}"
+
+
+static void check_round_trip(const char *input, size_t input_size)
+{
+	enum MAPISTATUS	retval;
+	uint8_t		*comp;
+	size_t		comp_size;
+	DATA_BLOB	plain;
+
+	retval = compress_rtf(mem_ctx, input, input_size, &comp, &comp_size);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert(comp_size <= 16 + input_size + (input_size + 1) / 8 + 4);
+
+	retval = uncompress_rtf(mem_ctx, comp, comp_size, &plain);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	/* uncompress_rtf NUL terminates its output */
+	ck_assert_int_eq(plain.length, input_size + 1);
+	ck_assert(memcmp(input, plain.data, input_size) == 0);
+
+	talloc_free(comp);
+	talloc_free(plain.data);
+}
+
+static void make_rtf_like(char *buf, size_t size)
+{
+	const char	*words[] = { "\\par ", "\\pard\\plain ", "\\f0\\fs20 ", "{\\b ", "}",
+				     "hello ", "world ", "OpenChange ", "\\tab ", "\r\n" };
+	size_t		i = 0;
+	size_t		len;
+
+	while (i < size) {
+		const char *word = words[random() % (sizeof (words) / sizeof (words[0]))];
+		len = strlen(word);
+		if (len > size - i) len = size - i;
+		memcpy(buf + i, word, len);
+		i += len;
+	}
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_crc) {
+	ck_assert(calculateCRC((uint8_t *)rtf_compressed1, 16, sizeof (rtf_compressed1) - 16) == 0xa7c7c5f1);
+	ck_assert(calculateCRC((uint8_t *)rtf_compressed2, 16, sizeof (rtf_compressed2) - 16) == 0x514bd4e2);
+	/* Unaligned offset and a length which is not a multiple of 8 */
+	ck_assert(calculateCRC((uint8_t *)rtf_compressed1, 17, 0) == 0);
+	ck_assert(calculateCRC((uint8_t *)"123456789", 0, 9) == 0x2dfd2d88);
+} END_TEST
+
+START_TEST (test_compress_spec) {
+	enum MAPISTATUS	retval;
+	uint8_t		*comp;
+	size_t		comp_size;
+
+	retval = compress_rtf(mem_ctx, RTF_UNCOMPRESSED1, sizeof (RTF_UNCOMPRESSED1) - 1, &comp, &comp_size);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(comp_size, sizeof (rtf_compressed1));
+	ck_assert(memcmp(comp, rtf_compressed1, comp_size) == 0);
+
+	retval = compress_rtf(mem_ctx, RTF_UNCOMPRESSED2, sizeof (RTF_UNCOMPRESSED2) - 1, &comp, &comp_size);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(comp_size, sizeof (rtf_compressed2));
+	ck_assert(memcmp(comp, rtf_compressed2, comp_size) == 0);
+} END_TEST
+
+START_TEST (test_round_trip) {
+	char		*input;
+	uint32_t	i;
+
+	input = talloc_array(mem_ctx, char, 0x20000);
+
+	/* Empty and tiny buffers */
+	check_round_trip(input, 0);
+	memset(input, 'x', 0x20000);
+	check_round_trip(input, 1);
+	check_round_trip(input, 2);
+	check_round_trip(input, 3);
+
+	/* Long runs: overlapping references */
+	check_round_trip(input, 0x20000);
+
+	/* Random data, mostly literals */
+	srandom(42);
+	for (i = 0; i < 0x20000; i++) {
+		input[i] = random() & 0xFF;
+	}
+	check_round_trip(input, 0x20000);
+
+	/* Low entropy data, mixing literals and references of any
+	   length and distance, wrapping around the dictionary */
+	for (i = 0; i < 0x20000; i++) {
+		input[i] = (random() % 4) ? input[i / 2] : 'a' + (random() % 8);
+	}
+	check_round_trip(input, 0x20000);
+
+	/* Random sizes around the control byte and dictionary boundaries */
+	for (i = 0; i < 200; i++) {
+		size_t size = random() % 5000;
+		make_rtf_like(input, size);
+		check_round_trip(input, size);
+	}
+
+	talloc_free(input);
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_benchmark_throughput) {
+	enum MAPISTATUS	retval;
+	char		*input;
+	uint8_t		*comp;
+	size_t		comp_size;
+	DATA_BLOB	plain;
+	struct timespec	start;
+	double		compress_ms, uncompress_ms, crc_ms;
+	uint32_t	crc;
+
+	srandom(1);
+	input = talloc_array(mem_ctx, char, BENCHMARK_SIZE);
+	make_rtf_like(input, BENCHMARK_SIZE);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = compress_rtf(mem_ctx, input, BENCHMARK_SIZE, &comp, &comp_size);
+	compress_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = uncompress_rtf(mem_ctx, comp, comp_size, &plain);
+	uncompress_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert(memcmp(input, plain.data, BENCHMARK_SIZE) == 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	crc = calculateCRC((uint8_t *)input, 0, BENCHMARK_SIZE);
+	crc_ms = testsuite_elapsed_ms(&start);
+	ck_assert(crc != 0);
+
+	testsuite_benchmark_report("lzfu %u bytes -> %zu bytes: compress %.2fms (%.1f MB/s), uncompress %.2fms, crc %.2fms\n",
+	                           BENCHMARK_SIZE, comp_size, compress_ms, BENCHMARK_SIZE / 1048.576 / compress_ms,
+	                           uncompress_ms, crc_ms);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_lzfu_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "tc_lzfu_setup");
+}
+
+static void tc_lzfu_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_lzfu_suite(void)
+{
+	Suite *s = suite_create("libmapi lzfu");
+
+	TCase *tc = tcase_create("Compressed RTF");
+	tcase_add_checked_fixture(tc, tc_lzfu_setup, tc_lzfu_teardown);
+
+	tcase_add_test(tc, test_crc);
+	tcase_add_test(tc, test_compress_spec);
+	tcase_add_test(tc, test_round_trip);
+
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create("Compressed RTF performance");
+		tcase_add_checked_fixture(tc_perf, tc_lzfu_setup, tc_lzfu_teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_throughput);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
@@ -0,0 +1,260 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+/* Global test variables */
+static TALLOC_CTX *mem_ctx;
+
+
+static void check_round_trip(const uint8_t *input, uint32_t input_size)
+{
+	uint8_t		*comp;
+	uint8_t		*plain;
+	uint32_t	comp_size = input_size + ((input_size / 32) + 2) * 4;
+	ssize_t		ret;
+
+	comp = talloc_array(mem_ctx, uint8_t, comp_size);
+	plain = talloc_array(mem_ctx, uint8_t, input_size + 1);
+
+	ret = compress_lzxpress(input, input_size, comp, comp_size);
+	ck_assert(ret >= 4);
+
+	ret = uncompress_lzxpress(comp, ret, plain, input_size + 1);
+	ck_assert_int_eq(ret, input_size);
+	ck_assert(memcmp(input, plain, input_size) == 0);
+
+	talloc_free(comp);
+	talloc_free(plain);
+}
+
+// v Unit test ----------------------------------------------------------------
+
+/* [MS-XCA] 3.1 example: no match, 26 literals */
+START_TEST (test_compress_literals) {
+	const char	*input = "abcdefghijklmnopqrstuvwxyz";
+	const uint8_t	expected_flags[] = { 0x3f, 0x00, 0x00, 0x00 };
+	uint8_t		output[64];
+	ssize_t		ret;
+
+	ret = compress_lzxpress((const uint8_t *)input, strlen(input), output, sizeof (output));
+	ck_assert_int_eq(ret, 30);
+	ck_assert(memcmp(output, expected_flags, 4) == 0);
+	ck_assert(memcmp(output + 4, input, 26) == 0);
+} END_TEST
+
+/* [MS-XCA] 3.1 example: "abc" repeated 100 times */
+START_TEST (test_compress_long_match) {
+	const uint8_t	expected[] = { 0xff, 0xff, 0xff, 0x1f, 0x61, 0x62, 0x63,
+				       0x17, 0x00, 0x0f, 0xff, 0x26, 0x01 };
+	uint8_t		input[300];
+	uint8_t		output[64];
+	uint8_t		plain[300];
+	ssize_t		ret;
+	int		i;
+
+	for (i = 0; i < 300; i++) {
+		input[i] = 'a' + (i % 3);
+	}
+
+	ret = compress_lzxpress(input, sizeof (input), output, sizeof (output));
+	ck_assert_int_eq(ret, sizeof (expected));
+	ck_assert(memcmp(output, expected, sizeof (expected)) == 0);
+
+	ret = uncompress_lzxpress(expected, sizeof (expected), plain, sizeof (plain));
+	ck_assert_int_eq(ret, sizeof (input));
+	ck_assert(memcmp(input, plain, sizeof (input)) == 0);
+} END_TEST
+
+START_TEST (test_round_trip) {
+	uint8_t		*input;
+	uint32_t	i;
+
+	input = talloc_array(mem_ctx, uint8_t, 0x40000);
+
+	/* Empty and tiny buffers */
+	check_round_trip(input, 0);
+	memset(input, 'x', 0x40000);
+	check_round_trip(input, 1);
+	check_round_trip(input, 3);
+
+	/* Very long runs exercising the 32-bit length encoding */
+	check_round_trip(input, 0x40000);
+
+	/* Random data, mostly literals */
+	srandom(42);
+	for (i = 0; i < 0x40000; i++) {
+		input[i] = random() & 0xFF;
+	}
+	check_round_trip(input, 0x40000);
+
+	/* Low entropy data, mixing literals and matches of any length */
+	for (i = 0; i < 0x40000; i++) {
+		input[i] = (random() % 4) ? input[i / 2] : 'a' + (random() % 8);
+	}
+	check_round_trip(input, 0x40000);
+
+	talloc_free(input);
+} END_TEST
+
+START_TEST (test_output_too_small) {
+	uint8_t		input[256];
+	uint8_t		output[256];
+	ssize_t		ret;
+	int		i;
+
+	for (i = 0; i < 256; i++) {
+		input[i] = i;
+	}
+
+	ret = compress_lzxpress(input, sizeof (input), output, 128);
+	ck_assert_int_eq(ret, -1);
+
+	ret = compress_lzxpress(input, sizeof (input), output, sizeof (output));
+	ck_assert_int_eq(ret, -1);
+} END_TEST
+
+START_TEST (test_uncompress_malformed) {
+	/* Match referencing data before the start of output */
+	const uint8_t	bad_offset[] = { 0x00, 0x00, 0x00, 0x80, 0x10, 0x00 };
+	/* Truncated flags */
+	const uint8_t	truncated[] = { 0x00, 0x00 };
+	uint8_t		output[64];
+
+	ck_assert_int_eq(uncompress_lzxpress(bad_offset, sizeof (bad_offset), output, sizeof (output)), -1);
+	ck_assert_int_eq(uncompress_lzxpress(truncated, sizeof (truncated), output, sizeof (output)), -1);
+} END_TEST
+
+/* RPC_HEADER_EXT payloads are decompressed in one pass */
+START_TEST (test_ndr_decompress) {
+	struct ndr_push		*plain;
+	struct ndr_push		*comp;
+	struct ndr_pull		*ndr;
+	struct ndr_pull		*uncomp = NULL;
+	DATA_BLOB		blob;
+	uint32_t		i;
+
+	plain = ndr_push_init_ctx(mem_ctx);
+	for (i = 0; i < 0x8000; i++) {
+		ck_assert_int_eq(ndr_push_uint8(plain, NDR_SCALARS, 'a' + (i % 7)), NDR_ERR_SUCCESS);
+	}
+	comp = ndr_push_init_ctx(mem_ctx);
+	ck_assert_int_eq(ndr_push_lzxpress_compress(comp, plain), NDR_ERR_SUCCESS);
+	blob = ndr_push_blob(comp);
+
+	ndr = ndr_pull_init_blob(&blob, mem_ctx);
+	ck_assert_int_eq(ndr_pull_lzxpress_decompress(ndr, &uncomp, 0x8000), NDR_ERR_SUCCESS);
+	ck_assert_int_eq(ndr->offset, blob.length);
+	ck_assert_int_eq(uncomp->data_size, 0x8000);
+	ck_assert(memcmp(uncomp->data, plain->data, 0x8000) == 0);
+
+	/* SizeActual not matching the payload */
+	ndr = ndr_pull_init_blob(&blob, mem_ctx);
+	ck_assert_int_eq(ndr_pull_lzxpress_decompress(ndr, &uncomp, 0x7FFF), NDR_ERR_COMPRESSION);
+
+	/* SizeActual larger than the protocol maximum */
+	ndr = ndr_pull_init_blob(&blob, mem_ctx);
+	ck_assert_int_eq(ndr_pull_lzxpress_decompress(ndr, &uncomp, 0x10000), NDR_ERR_COMPRESSION);
+	ck_assert_int_eq(ndr->offset, 0);
+} END_TEST
+
+/* Payloads larger than 32KB are split in several extended buffers */
+START_TEST (test_ndr_chunks) {
+	struct ndr_push		*plain;
+	struct ndr_push		*chunks;
+	struct ndr_pull		*ndr;
+	struct ndr_pull		*sub;
+	struct ndr_pull		*uncomp;
+	struct RPC_HEADER_EXT	header;
+	DATA_BLOB		blob;
+	uint32_t		i, offset;
+	uint32_t		count = 0;
+
+	/* Two compressible chunks followed by a short random one */
+	plain = ndr_push_init_ctx(mem_ctx);
+	srandom(42);
+	for (i = 0; i < 0x10100; i++) {
+		ck_assert_int_eq(ndr_push_uint8(plain, NDR_SCALARS, (i < 0x10000) ? 'a' + (i % 7) : random() & 0xFF),
+				 NDR_ERR_SUCCESS);
+	}
+
+	chunks = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&chunks->flags, LIBNDR_FLAG_NOALIGN);
+	ck_assert_int_eq(ndr_push_mapi2k7_chunks(chunks, plain, RHEF_Compressed|RHEF_XorMagic), NDR_ERR_SUCCESS);
+	blob = ndr_push_blob(chunks);
+
+	ndr = ndr_pull_init_blob(&blob, mem_ctx);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+	for (offset = 0; offset < plain->offset; offset += header.SizeActual, count++) {
+		ck_assert_int_eq(ndr_pull_RPC_HEADER_EXT(ndr, NDR_SCALARS, &header), NDR_ERR_SUCCESS);
+		ck_assert(header.SizeActual <= 0x8000);
+		ck_assert(header.Flags & RHEF_XorMagic);
+		ck_assert_int_eq(!!(header.Flags & RHEF_Last), offset + header.SizeActual == plain->offset);
+		ck_assert_int_eq(!!(header.Flags & RHEF_Compressed), count < 2);
+
+		ck_assert_int_eq(ndr_pull_subcontext_start(ndr, &sub, 0, header.Size), NDR_ERR_SUCCESS);
+		obfuscate_data(sub->data, sub->data_size, 0xA5);
+		if (header.Flags & RHEF_Compressed) {
+			ck_assert_int_eq(ndr_pull_lzxpress_decompress(sub, &uncomp, header.SizeActual), NDR_ERR_SUCCESS);
+		} else {
+			uncomp = sub;
+		}
+		ck_assert_int_eq(uncomp->data_size, header.SizeActual);
+		ck_assert(memcmp(uncomp->data, plain->data + offset, header.SizeActual) == 0);
+		ck_assert_int_eq(ndr_pull_subcontext_end(ndr, sub, 0, header.Size), NDR_ERR_SUCCESS);
+	}
+	ck_assert_int_eq(count, 3);
+	ck_assert_int_eq(ndr->offset, blob.length);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_lzxpress_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "tc_lzxpress_setup");
+}
+
+static void tc_lzxpress_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_lzxpress_suite(void)
+{
+	Suite *s = suite_create("libmapi lzxpress");
+
+	TCase *tc = tcase_create("LZ77 compression");
+	tcase_add_checked_fixture(tc, tc_lzxpress_setup, tc_lzxpress_teardown);
+
+	tcase_add_test(tc, test_compress_literals);
+	tcase_add_test(tc, test_compress_long_match);
+	tcase_add_test(tc, test_round_trip);
+	tcase_add_test(tc, test_output_too_small);
+	tcase_add_test(tc, test_uncompress_malformed);
+	tcase_add_test(tc, test_ndr_decompress);
+	tcase_add_test(tc, test_ndr_chunks);
+
+	suite_add_tcase(s, tc);
+
+	return s;
+}
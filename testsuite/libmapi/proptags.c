@@ -0,0 +1,256 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include <time.h>
+
+#include "libmapi/property_tags.c"
+#include "libmapi/mapi_nameid.c"
+
+#define	BENCHMARK_LOOKUPS	100000
+
+
+/* What get_proptag_name() used to do */
+static const char *linear_proptag_name(uint32_t proptag)
+{
+	uint32_t	idx;
+
+	for (idx = 0; idx < CANONICAL_PROPERTY_TAGS_COUNT; idx++) {
+		if (canonical_property_tags[idx].proptag == proptag) {
+			return canonical_property_tags[idx].propname;
+		}
+	}
+	return NULL;
+}
+
+/* What get_proptag_value() used to do */
+static uint32_t linear_proptag_value(const char *propname)
+{
+	uint32_t	idx;
+
+	for (idx = 0; idx < CANONICAL_PROPERTY_TAGS_COUNT; idx++) {
+		if (!strcmp(canonical_property_tags[idx].propname, propname)) {
+			return canonical_property_tags[idx].proptag;
+		}
+	}
+	return 0;
+}
+
+/* What mapi_nameid_lid_lookup() used to do */
+static struct mapi_nameid_tags *linear_nameid_lid(uint16_t lid, const char *OLEGUID)
+{
+	uint32_t	i;
+
+	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
+		if (mapi_nameid_tags[i].lid == lid &&
+		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
+			return &mapi_nameid_tags[i];
+		}
+	}
+	return NULL;
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_canonical_sorted) {
+	uint32_t	i;
+	uint32_t	prev;
+	uint32_t	cur;
+
+	for (i = 1; i < CANONICAL_PROPERTY_TAGS_COUNT; i++) {
+		ck_assert(strcmp(canonical_property_tags[i - 1].propname,
+				 canonical_property_tags[i].propname) < 0);
+
+		prev = canonical_property_tags_by_tag[i - 1];
+		cur = canonical_property_tags_by_tag[i];
+		ck_assert(canonical_property_tags[prev].proptag < canonical_property_tags[cur].proptag ||
+			  (canonical_property_tags[prev].proptag == canonical_property_tags[cur].proptag &&
+			   prev < cur));
+	}
+} END_TEST
+
+START_TEST (test_canonical_lookup) {
+	uint32_t	i;
+	const char	*propname;
+
+	for (i = 0; i < CANONICAL_PROPERTY_TAGS_COUNT; i++) {
+		ck_assert_int_eq(get_proptag_value(canonical_property_tags[i].propname),
+				 canonical_property_tags[i].proptag);
+		propname = get_proptag_name(canonical_property_tags[i].proptag);
+		ck_assert_str_eq(propname, linear_proptag_name(canonical_property_tags[i].proptag));
+	}
+
+	ck_assert_str_eq(get_proptag_name(PidTagSubject), "PidTagSubject");
+	ck_assert_str_eq(get_proptag_name(PidTagSubject_Error), "PidTagSubject_Error");
+	ck_assert_int_eq(get_proptag_value("PidTagFolderChildCount"), PidTagFolderChildCount);
+	ck_assert_int_eq(get_proptag_value("openchange_private_MailboxGUID"), openchange_private_MailboxGUID);
+
+	/* PT_STRING8 tags resolve to their _UNICODE name */
+	ck_assert_str_eq(get_proptag_name(PR_SUBJECT), "PidTagSubject");
+	ck_assert_int_eq(get_property_type(PidTagSubject >> 16), PT_UNICODE);
+	ck_assert_int_eq(get_property_type(openchange_private_ReplicaID >> 16), PT_SHORT);
+
+	ck_assert(get_proptag_name(0) == NULL);
+	ck_assert(get_proptag_name(0xFFFFFFFF) == NULL);
+	ck_assert_int_eq(get_proptag_value("PidTagDoesNotExist"), 0);
+	ck_assert_int_eq(get_proptag_value(""), 0);
+	ck_assert_int_eq(get_property_type(0xFFFF), 0);
+} END_TEST
+
+START_TEST (test_nameid_lookup) {
+	enum MAPISTATUS	retval;
+	uint32_t	i;
+	uint32_t	propTag;
+	uint16_t	propType;
+
+	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
+		ck_assert_int_eq(mapi_nameid_property_lookup(mapi_nameid_tags[i].proptag), MAPI_E_SUCCESS);
+
+		if (mapi_nameid_tags[i].ulKind == MNID_ID) {
+			retval = mapi_nameid_lid_lookup_canonical(mapi_nameid_tags[i].lid,
+								  mapi_nameid_tags[i].OLEGUID, &propTag);
+			ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+			ck_assert_int_eq(propTag, linear_nameid_lid(mapi_nameid_tags[i].lid,
+								    mapi_nameid_tags[i].OLEGUID)->proptag);
+		} else {
+			retval = mapi_nameid_string_lookup_canonical(mapi_nameid_tags[i].Name,
+								     mapi_nameid_tags[i].OLEGUID, &propTag);
+			ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+			ck_assert_int_eq(propTag, mapi_nameid_tags[i].proptag);
+		}
+	}
+
+	for (i = 0; mapi_nameid_names[i].proptag; i++) {
+		ck_assert_int_eq(get_namedid_value(mapi_nameid_names[i].propname), mapi_nameid_names[i].proptag);
+		ck_assert_str_eq(get_namedid_name(mapi_nameid_names[i].proptag), mapi_nameid_names[i].propname);
+	}
+
+	retval = mapi_nameid_OOM_lookup("Categories", PS_PUBLIC_STRINGS, &propType);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(propType, PT_MV_UNICODE);
+	retval = mapi_nameid_lid_lookup(0x8f05, PSETID_Remote, &propType);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(propType, PT_LONG);
+
+	/* Right key, wrong property set */
+	retval = mapi_nameid_OOM_lookup("Categories", PSETID_Common, &propType);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	retval = mapi_nameid_lid_lookup(0x8f05, PSETID_Common, &propType);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mapi_nameid_property_lookup(0x00010003), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(get_namedid_value("PidLidDoesNotExist"), 0);
+	ck_assert(get_namedid_name(0xFFFFFFFF) == NULL);
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_benchmark_lookup) {
+	struct timespec	start;
+	double		linear_name_ms, name_ms;
+	double		linear_value_ms, value_ms;
+	double		linear_lid_ms, lid_ms;
+	uint32_t	i;
+	uint32_t	idx;
+	uint32_t	count;
+	uint16_t	propType;
+
+	/* Only the lookup cost differs, go through the same entries */
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		idx = random() % CANONICAL_PROPERTY_TAGS_COUNT;
+		ck_assert(linear_proptag_name(canonical_property_tags[idx].proptag) != NULL);
+	}
+	linear_name_ms = testsuite_elapsed_ms(&start);
+
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		idx = random() % CANONICAL_PROPERTY_TAGS_COUNT;
+		ck_assert(get_proptag_name(canonical_property_tags[idx].proptag) != NULL);
+	}
+	name_ms = testsuite_elapsed_ms(&start);
+
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		idx = random() % CANONICAL_PROPERTY_TAGS_COUNT;
+		ck_assert(linear_proptag_value(canonical_property_tags[idx].propname) != 0);
+	}
+	linear_value_ms = testsuite_elapsed_ms(&start);
+
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		idx = random() % CANONICAL_PROPERTY_TAGS_COUNT;
+		ck_assert(get_proptag_value(canonical_property_tags[idx].propname) != 0);
+	}
+	value_ms = testsuite_elapsed_ms(&start);
+
+	/* Named properties: light ID lookups */
+	count = MAPI_NAMEID_INDEX_COUNT(mapi_nameid_tags_by_lid);
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		idx = mapi_nameid_tags_by_lid[random() % count];
+		ck_assert(linear_nameid_lid(mapi_nameid_tags[idx].lid, mapi_nameid_tags[idx].OLEGUID) != NULL);
+	}
+	linear_lid_ms = testsuite_elapsed_ms(&start);
+
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		idx = mapi_nameid_tags_by_lid[random() % count];
+		ck_assert_int_eq(mapi_nameid_lid_lookup(mapi_nameid_tags[idx].lid,
+							mapi_nameid_tags[idx].OLEGUID, &propType),
+				 MAPI_E_SUCCESS);
+	}
+	lid_ms = testsuite_elapsed_ms(&start);
+
+	testsuite_benchmark_report("property tags %u entries, %u lookups: get_proptag_name %.2fms (linear %.2fms), "
+	                           "get_proptag_value %.2fms (linear %.2fms), mapi_nameid_lid_lookup %.2fms (linear %.2fms)\n",
+	                           (uint32_t) CANONICAL_PROPERTY_TAGS_COUNT, BENCHMARK_LOOKUPS,
+	                           name_ms, linear_name_ms, value_ms, linear_value_ms, lid_ms, linear_lid_ms);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+Suite *libmapi_proptags_suite(void)
+{
+	Suite *s = suite_create("libmapi property tags");
+
+	TCase *tc = tcase_create("property tags lookup");
+	tcase_add_test(tc, test_canonical_sorted);
+	tcase_add_test(tc, test_canonical_lookup);
+	tcase_add_test(tc, test_nameid_lookup);
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create("property tags lookup performance");
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_lookup);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
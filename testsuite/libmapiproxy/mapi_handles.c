@@ -0,0 +1,269 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "libmapi/libmapi.h"
+#include <time.h>
+
+#define CHECK_SUCCESS ck_assert_int_eq(retval, MAPI_E_SUCCESS)
+
+/* Global test variables */
+static TALLOC_CTX			*g_mem_ctx;
+static struct mapi_handles_context	*g_handles_ctx;
+static enum MAPISTATUS			retval;
+
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_add_and_search) {
+	struct mapi_handles	*rec = NULL;
+	struct mapi_handles	*found = NULL;
+
+	retval = mapi_handles_add(g_handles_ctx, 0, &rec);
+	CHECK_SUCCESS;
+	ck_assert(rec != NULL);
+	ck_assert_int_eq(rec->handle, 1);
+	ck_assert_int_eq(g_handles_ctx->count, 1);
+
+	retval = mapi_handles_search(g_handles_ctx, rec->handle, &found);
+	CHECK_SUCCESS;
+	ck_assert(found == rec);
+
+	retval = mapi_handles_search(g_handles_ctx, 0x42, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	retval = mapi_handles_search(g_handles_ctx, MAPI_HANDLES_RESERVED, &found);
+	ck_assert_int_eq(retval, MAPI_E_INVALID_PARAMETER);
+} END_TEST
+
+START_TEST (test_delete_reuses_slot) {
+	struct mapi_handles	*rec = NULL;
+	struct mapi_handles	*found = NULL;
+	uint32_t		handle;
+
+	retval = mapi_handles_add(g_handles_ctx, 0, &rec);
+	CHECK_SUCCESS;
+	handle = rec->handle;
+
+	retval = mapi_handles_delete(g_handles_ctx, handle);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(g_handles_ctx->count, 0);
+
+	retval = mapi_handles_delete(g_handles_ctx, handle);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	/* The slot is reused but the stale handle must not resolve */
+	retval = mapi_handles_add(g_handles_ctx, 0, &rec);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(rec->handle & MAPI_HANDLES_INDEX_MASK, handle & MAPI_HANDLES_INDEX_MASK);
+	ck_assert_int_ne(rec->handle, handle);
+
+	retval = mapi_handles_search(g_handles_ctx, handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	retval = mapi_handles_search(g_handles_ctx, rec->handle, &found);
+	CHECK_SUCCESS;
+	ck_assert(found == rec);
+} END_TEST
+
+START_TEST (test_delete_cascade) {
+	struct mapi_handles	*root = NULL;
+	struct mapi_handles	*child = NULL;
+	struct mapi_handles	*grandchild = NULL;
+	struct mapi_handles	*other = NULL;
+	struct mapi_handles	*found = NULL;
+
+	retval = mapi_handles_add(g_handles_ctx, 0, &root);
+	CHECK_SUCCESS;
+	retval = mapi_handles_add(g_handles_ctx, root->handle, &child);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(child->parent_handle, root->handle);
+	ck_assert(root->children == child);
+	retval = mapi_handles_add(g_handles_ctx, child->handle, &grandchild);
+	CHECK_SUCCESS;
+	retval = mapi_handles_add(g_handles_ctx, 0, &other);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(g_handles_ctx->count, 4);
+
+	retval = mapi_handles_delete(g_handles_ctx, root->handle);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(g_handles_ctx->count, 1);
+
+	retval = mapi_handles_search(g_handles_ctx, other->handle, &found);
+	CHECK_SUCCESS;
+	ck_assert(found == other);
+	ck_assert(g_handles_ctx->handles == other);
+} END_TEST
+
+START_TEST (test_private_data) {
+	struct mapi_handles	*rec = NULL;
+	void			*data = NULL;
+
+	retval = mapi_handles_add(g_handles_ctx, 0, &rec);
+	CHECK_SUCCESS;
+
+	retval = mapi_handles_get_private_data(rec, &data);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	retval = mapi_handles_set_private_data(rec, g_mem_ctx);
+	CHECK_SUCCESS;
+	retval = mapi_handles_set_private_data(rec, g_mem_ctx);
+	ck_assert_int_eq(retval, MAPI_E_UNABLE_TO_COMPLETE);
+
+	retval = mapi_handles_get_private_data(rec, &data);
+	CHECK_SUCCESS;
+	ck_assert(data == g_mem_ctx);
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+/* Lookup path used before the slab allocator: one TDB record per
+   handle keyed by its hexadecimal value, then a walk of all handles */
+static void legacy_tdb_search(TDB_CONTEXT *tdb_ctx, struct mapi_handles **records,
+			      uint32_t count, uint32_t handle)
+{
+	TDB_DATA		key;
+	TDB_DATA		dbuf;
+	uint32_t		i;
+
+	key.dptr = (unsigned char *) talloc_asprintf(g_mem_ctx, "0x%x", handle);
+	key.dsize = strlen((const char *)key.dptr);
+	dbuf = tdb_fetch(tdb_ctx, key);
+	talloc_free(key.dptr);
+	ck_assert(dbuf.dptr != NULL);
+	free(dbuf.dptr);
+
+	for (i = 0; i < count; i++) {
+		if (records[i]->handle == handle) return;
+	}
+	ck_abort();
+}
+
+static void run_benchmark(uint32_t count)
+{
+	TDB_CONTEXT		*tdb_ctx;
+	TDB_DATA		key;
+	TDB_DATA		dbuf;
+	struct mapi_handles	*rec = NULL;
+	struct mapi_handles	*found = NULL;
+	struct mapi_handles	**records;
+	struct timespec		start;
+	double			add_ms, search_ms, delete_ms, legacy_ms;
+	uint32_t		i;
+
+	records = talloc_array(g_mem_ctx, struct mapi_handles *, count);
+	ck_assert(records != NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) {
+		retval = mapi_handles_add(g_handles_ctx, i ? records[i / 2]->handle : 0, &rec);
+		CHECK_SUCCESS;
+		records[i] = rec;
+	}
+	add_ms = testsuite_elapsed_ms(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) {
+		retval = mapi_handles_search(g_handles_ctx, records[(i * 7919) % count]->handle, &found);
+		CHECK_SUCCESS;
+	}
+	search_ms = testsuite_elapsed_ms(&start);
+
+	/* Legacy lookups are quadratic, only sample a fraction of them */
+	tdb_ctx = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
+	ck_assert(tdb_ctx != NULL);
+	for (i = 0; i < count; i++) {
+		key.dptr = (unsigned char *) talloc_asprintf(g_mem_ctx, "0x%x", records[i]->handle);
+		key.dsize = strlen((const char *)key.dptr);
+		dbuf.dptr = (unsigned char *) "root";
+		dbuf.dsize = 4;
+		ck_assert_int_eq(tdb_store(tdb_ctx, key, dbuf, TDB_INSERT), 0);
+		talloc_free(key.dptr);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count / 100; i++) {
+		legacy_tdb_search(tdb_ctx, records, count, records[count - 1 - i]->handle);
+	}
+	legacy_ms = testsuite_elapsed_ms(&start) * 100;
+	tdb_close(tdb_ctx);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = mapi_handles_delete(g_handles_ctx, records[0]->handle);
+	CHECK_SUCCESS;
+	delete_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(g_handles_ctx->count, 0);
+
+	testsuite_benchmark_report("mapi_handles %u handles: add %.2fms, search %.2fms (TDB path ~%.2fms), cascade delete %.2fms\n",
+	                           count, add_ms, search_ms, legacy_ms, delete_ms);
+
+	talloc_free(records);
+}
+
+START_TEST (test_benchmark_10k) {
+	run_benchmark(10000);
+} END_TEST
+
+START_TEST (test_benchmark_100k) {
+	run_benchmark(100000);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void mapi_handles_setup(void)
+{
+	g_mem_ctx = talloc_named(NULL, 0, "mapi_handles_setup");
+	g_handles_ctx = mapi_handles_init(g_mem_ctx);
+	ck_assert(g_handles_ctx != NULL);
+}
+
+static void mapi_handles_teardown(void)
+{
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapiproxy_mapi_handles_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+	TCase	*tc_perf;
+
+	s = suite_create("libmapiproxy: MAPI handles");
+
+	tc = tcase_create("MAPI handles interface");
+	tcase_add_checked_fixture(tc, mapi_handles_setup, mapi_handles_teardown);
+	tcase_add_test(tc, test_add_and_search);
+	tcase_add_test(tc, test_delete_reuses_slot);
+	tcase_add_test(tc, test_delete_cascade);
+	tcase_add_test(tc, test_private_data);
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		tc_perf = tcase_create("MAPI handles performance");
+		tcase_add_checked_fixture(tc_perf, mapi_handles_setup, mapi_handles_teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_10k);
+		tcase_add_test(tc_perf, test_benchmark_100k);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
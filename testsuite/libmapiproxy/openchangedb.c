@@ -6,6 +6,10 @@
 #include "libmapi/libmapi.h"
 #include <inttypes.h>
 #include <mysql/mysql.h>
+#include <param.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
 #define OPENCHANGEDB_SAMPLE_SQL		RESOURCES_DIR "/openchangedb_sample.sql"
 #define OPENCHANGEDB_LDB		RESOURCES_DIR "/openchange.ldb"
@@ -13,6 +17,12 @@
 #define LDB_DEFAULT_CONTEXT 		"CN=First Administrative Group,CN=First Organization,CN=ZENTYAL,DC=zentyal-domain,DC=lan"
 #define LDB_ROOT_CONTEXT 		"CN=ZENTYAL,DC=zentyal-domain,DC=lan"
 
+#define CN_WORKERS			4
+#define CN_PER_WORKER			200
+#define CN_GLOBCNT(cn)			exchange_globcnt((cn) >> 16)
+
+#define TABLE_BENCHMARK_ITERATIONS	200
+
 #define CHECK_SUCCESS ck_assert_int_eq(retval, MAPI_E_SUCCESS)
 #define CHECK_FAILURE ck_assert_int_ne(retval, MAPI_E_SUCCESS)
 
@@ -21,6 +31,7 @@ static struct openchangedb_context 	*g_oc_ctx;
 static enum MAPISTATUS			retval;
 
 #define USER1 "paco"
+
 // v Unit test ----------------------------------------------------------------
 
 START_TEST (test_get_SystemFolderID) {
@@ -1034,6 +1045,85 @@ START_TEST (test_build_table_folders_live_filtering) {
 	ck_assert_str_eq("Schedule", (char *)data);
 } END_TEST
 
+START_TEST (test_table_get_rows) {
+	void				*table, *data;
+	uint64_t			fid;
+	enum MAPITAGS			tags[] = { PidTagFolderId, PidTagDisplayName, PidTagRights, PR_INSTANCE_NUM };
+	struct SPropTagArray		props;
+	struct openchangedb_table_row	*rows;
+	uint32_t			count, i;
+
+	props.cValues = 4;
+	props.aulPropTag = tags;
+
+	fid = 17438782182108692481ul;
+	retval = openchangedb_table_init(g_mem_ctx, g_oc_ctx, USER1, 1, fid, &table);
+	CHECK_SUCCESS;
+	retval = openchangedb_table_get_rows(g_mem_ctx, g_oc_ctx, table, &props, 0, 20, false, &rows, &count);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(count, 12);
+
+	/* Same values as the per property lookups */
+	for (i = 0; i < count; i++) {
+		ck_assert(rows[i].data != NULL);
+		ck_assert_int_eq(rows[i].retvals[0], MAPI_E_SUCCESS);
+		ck_assert(*(uint64_t *)rows[i].data[0] == rows[i].fmid);
+		ck_assert_int_eq(rows[i].retvals[2], MAPI_E_SUCCESS);
+		ck_assert_int_eq(rows[i].retvals[3], MAPI_E_SUCCESS);
+		ck_assert_int_eq(*(uint32_t *)rows[i].data[3], 0);
+
+		retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, table,
+							 PidTagDisplayName, i, false, &data);
+		ck_assert_int_eq(retval, rows[i].retvals[1]);
+		if (retval == MAPI_E_SUCCESS) {
+			ck_assert_str_eq((char *)data, (char *)rows[i].data[1]);
+		}
+	}
+
+	/* Pages in the middle and past the end of the table */
+	retval = openchangedb_table_get_rows(g_mem_ctx, g_oc_ctx, table, &props, 10, 5, false, &rows, &count);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(count, 2);
+	retval = openchangedb_table_get_rows(g_mem_ctx, g_oc_ctx, table, &props, 12, 5, false, &rows, &count);
+	ck_assert_int_eq(retval, MAPI_E_INVALID_OBJECT);
+} END_TEST
+
+START_TEST (test_table_get_rows_live_filtering) {
+	void				*table;
+	uint64_t			fid;
+	enum MAPITAGS			tag = PidTagDisplayName;
+	struct SPropTagArray		props;
+	struct mapi_SRestriction	res;
+	struct openchangedb_table_row	*rows;
+	uint32_t			count, i;
+	int				ok = 0;
+
+	props.cValues = 1;
+	props.aulPropTag = &tag;
+
+	fid = 17438782182108692481ul;
+	retval = openchangedb_table_init(g_mem_ctx, g_oc_ctx, USER1, 1, fid, &table);
+	CHECK_SUCCESS;
+
+	res.rt = RES_PROPERTY;
+	res.res.resProperty.ulPropTag = PidTagDisplayName;
+	res.res.resProperty.lpProp.ulPropTag = PidTagDisplayName;
+	res.res.resProperty.lpProp.value.lpszW = "Schedule";
+	retval = openchangedb_table_set_restrictions(g_oc_ctx, table, &res);
+	CHECK_SUCCESS;
+
+	retval = openchangedb_table_get_rows(g_mem_ctx, g_oc_ctx, table, &props, 0, 20, true, &rows, &count);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(count, 12);
+	for (i = 0; i < count; i++) {
+		if (!rows[i].data) continue;
+		ok++;
+		ck_assert_int_eq(rows[i].retvals[0], MAPI_E_SUCCESS);
+		ck_assert_str_eq("Schedule", (char *)rows[i].data[0]);
+	}
+	ck_assert_int_eq(ok, 1);
+} END_TEST
+
 START_TEST (test_set_locale) {
 	ck_assert(openchangedb_set_locale(g_oc_ctx, USER1, 0x1001));
 	ck_assert(!openchangedb_set_locale(g_oc_ctx, USER1, 0x1001));
@@ -1090,6 +1180,215 @@ START_TEST (test_get_indexing_url) {
 	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
 } END_TEST
 
+/* Each worker opens its own openchangedb context, as a samba worker
+   process would, and allocates change numbers from the shared
+   server counter */
+static struct openchangedb_context *open_worker_context(TALLOC_CTX *mem_ctx)
+{
+	struct openchangedb_context	*oc_ctx = NULL;
+	struct loadparm_context		*lp_ctx;
+	const char			*mysql_pass = getenv("OC_MYSQL_PASS");
+	const char			*database;
+
+	if (strcmp(g_oc_ctx->backend_type, "ldb") == 0) {
+		retval = openchangedb_ldb_initialize(mem_ctx, RESOURCES_DIR, &oc_ctx);
+		return (retval == MAPI_E_SUCCESS) ? oc_ctx : NULL;
+	}
+
+	/* MySQL connections are cached by connection string: spell the
+	   port out so the worker does not reuse the parent socket */
+	if (!mysql_pass || !mysql_pass[0]) {
+		database = talloc_asprintf(mem_ctx, "mysql://" OC_TESTSUITE_MYSQL_USER "@"
+					   OC_TESTSUITE_MYSQL_HOST ":3306/" OC_TESTSUITE_MYSQL_DB);
+	} else {
+		database = talloc_asprintf(mem_ctx, "mysql://%s:%s@%s:3306/%s", OC_TESTSUITE_MYSQL_USER,
+					   mysql_pass, OC_TESTSUITE_MYSQL_HOST, OC_TESTSUITE_MYSQL_DB);
+	}
+	lp_ctx = loadparm_init(mem_ctx);
+	if (!lp_ctx || !lpcfg_set_cmdline(lp_ctx, "mapiproxy:openchangedb", database)) return NULL;
+
+	retval = openchangedb_mysql_initialize(mem_ctx, lp_ctx, &oc_ctx);
+	return (retval == MAPI_E_SUCCESS) ? oc_ctx : NULL;
+}
+
+static void changeNumber_worker(int fd, uint32_t count)
+{
+	TALLOC_CTX			*mem_ctx;
+	struct openchangedb_context	*oc_ctx;
+	struct UI8Array_r		*cns;
+	uint64_t			cn;
+	uint32_t			i = 0;
+
+	mem_ctx = talloc_named(NULL, 0, "changeNumber_worker");
+	oc_ctx = open_worker_context(mem_ctx);
+	if (!oc_ctx) _exit(1);
+
+	while (i < count) {
+		if (i % 100 == 0 && count - i >= 10) {
+			retval = openchangedb_get_new_changeNumbers(oc_ctx, mem_ctx, USER1, 10, &cns);
+			if (retval != MAPI_E_SUCCESS) _exit(2);
+			if (write(fd, cns->lpui8, 10 * sizeof (uint64_t)) != 10 * sizeof (uint64_t)) _exit(3);
+			talloc_free(cns);
+			i += 10;
+		} else {
+			retval = openchangedb_get_new_changeNumber(oc_ctx, USER1, &cn);
+			if (retval != MAPI_E_SUCCESS) _exit(2);
+			if (write(fd, &cn, sizeof (uint64_t)) != sizeof (uint64_t)) _exit(3);
+			i++;
+		}
+	}
+
+	/* Do not run the parent destructors: the ldb and mysql handles
+	   they would close are shared with it */
+	_exit(0);
+}
+
+static int cmp_uint64(const void *a, const void *b)
+{
+	uint64_t	x = *(const uint64_t *) a;
+	uint64_t	y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+START_TEST (test_get_new_changeNumber_concurrency) {
+	uint64_t	*cns;
+	size_t		size = CN_WORKERS * CN_PER_WORKER * sizeof (uint64_t);
+	size_t		offset = 0;
+	ssize_t		len;
+	pid_t		pids[CN_WORKERS];
+	int		fds[CN_WORKERS];
+	int		pipefd[2];
+	int		status;
+	int		i;
+
+	cns = talloc_array(g_mem_ctx, uint64_t, CN_WORKERS * CN_PER_WORKER);
+	ck_assert(cns != NULL);
+
+	for (i = 0; i < CN_WORKERS; i++) {
+		ck_assert_int_eq(pipe(pipefd), 0);
+		pids[i] = fork();
+		ck_assert(pids[i] >= 0);
+		if (pids[i] == 0) {
+			close(pipefd[0]);
+			changeNumber_worker(pipefd[1], CN_PER_WORKER);
+		}
+		close(pipefd[1]);
+		fds[i] = pipefd[0];
+	}
+
+	for (i = 0; i < CN_WORKERS; i++) {
+		while (offset < size && (len = read(fds[i], (uint8_t *)cns + offset, size - offset)) > 0) {
+			offset += len;
+		}
+		close(fds[i]);
+		ck_assert(waitpid(pids[i], &status, 0) == pids[i]);
+		ck_assert(WIFEXITED(status));
+		ck_assert_int_eq(WEXITSTATUS(status), 0);
+	}
+	ck_assert_int_eq(offset, size);
+
+	qsort(cns, CN_WORKERS * CN_PER_WORKER, sizeof (uint64_t), cmp_uint64);
+	for (i = 1; i < CN_WORKERS * CN_PER_WORKER; i++) {
+		ck_assert(cns[i] != cns[i - 1]);
+	}
+
+	talloc_free(cns);
+} END_TEST
+
+/* Change numbers follow the allocation order across processes, so ICS
+   clients syncing through different processes never miss a change */
+START_TEST (test_get_new_changeNumber_two_processes) {
+	uint64_t	before, child, next, after;
+	pid_t		pid;
+	int		pipefd[2];
+	int		status;
+
+	retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &before);
+	CHECK_SUCCESS;
+
+	ck_assert_int_eq(pipe(pipefd), 0);
+	pid = fork();
+	ck_assert(pid >= 0);
+	if (pid == 0) {
+		close(pipefd[0]);
+		changeNumber_worker(pipefd[1], 1);
+	}
+	close(pipefd[1]);
+	ck_assert_int_eq(read(pipefd[0], &child, sizeof (uint64_t)), sizeof (uint64_t));
+	close(pipefd[0]);
+	ck_assert(waitpid(pid, &status, 0) == pid);
+	ck_assert(WIFEXITED(status));
+	ck_assert_int_eq(WEXITSTATUS(status), 0);
+
+	/* The next change number accounts for the other process */
+	retval = openchangedb_get_next_changeNumber(g_oc_ctx, USER1, &next);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &after);
+	CHECK_SUCCESS;
+	ck_assert(next == after);
+
+	ck_assert(CN_GLOBCNT(before) < CN_GLOBCNT(child));
+	ck_assert(CN_GLOBCNT(child) < CN_GLOBCNT(after));
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_benchmark_table_rows) {
+	void				*table, *data;
+	uint64_t			fid;
+	enum MAPITAGS			tags[] = { PidTagFolderId, PidTagDisplayName, PidTagRights,
+						   PidTagContainerClass, PidTagContentCount,
+						   PidTagContentUnreadCount, PidTagFolderChildCount,
+						   PidTagParentFolderId, PidTagChangeNumber,
+						   PidTagComment };
+	struct SPropTagArray		props;
+	struct openchangedb_table_row	*rows;
+	struct timespec			start;
+	double				property_ms, rows_ms;
+	uint32_t			count, i, j, n;
+	TALLOC_CTX			*mem_ctx;
+
+	props.cValues = sizeof (tags) / sizeof (tags[0]);
+	props.aulPropTag = tags;
+	fid = 17438782182108692481ul;
+
+	/* One lookup per property and per row */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < TABLE_BENCHMARK_ITERATIONS; n++) {
+		mem_ctx = talloc_new(g_mem_ctx);
+		retval = openchangedb_table_init(mem_ctx, g_oc_ctx, USER1, 1, fid, &table);
+		CHECK_SUCCESS;
+		for (i = 0; ; i++) {
+			for (j = 0; j < props.cValues; j++) {
+				retval = openchangedb_table_get_property(mem_ctx, g_oc_ctx, table, tags[j], i, true, &data);
+				if (retval == MAPI_E_INVALID_OBJECT) break;
+			}
+			if (retval == MAPI_E_INVALID_OBJECT) break;
+		}
+		ck_assert_int_eq(i, 12);
+		talloc_free(mem_ctx);
+	}
+	property_ms = testsuite_elapsed_ms(&start);
+
+	/* One query for the whole page */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < TABLE_BENCHMARK_ITERATIONS; n++) {
+		mem_ctx = talloc_new(g_mem_ctx);
+		retval = openchangedb_table_init(mem_ctx, g_oc_ctx, USER1, 1, fid, &table);
+		CHECK_SUCCESS;
+		retval = openchangedb_table_get_rows(mem_ctx, g_oc_ctx, table, &props, 0, 50, true, &rows, &count);
+		CHECK_SUCCESS;
+		ck_assert_int_eq(count, 12);
+		talloc_free(mem_ctx);
+	}
+	rows_ms = testsuite_elapsed_ms(&start);
+
+	testsuite_benchmark_report("openchangedb %s hierarchy table of %u columns: per property %.3fms, per page %.3fms\n",
+	                           g_oc_ctx->backend_type, props.cValues,
+	                           property_ms / TABLE_BENCHMARK_ITERATIONS, rows_ms / TABLE_BENCHMARK_ITERATIONS);
+} END_TEST
+
 // ^ Unit test ----------------------------------------------------------------
 
 // v Suite definition ---------------------------------------------------------
@@ -1227,6 +1526,8 @@ static Suite *openchangedb_create_suite(const char *backend_name,
 	tcase_add_test(tc, test_build_table_folders);
 	tcase_add_test(tc, test_build_table_folders_with_restrictions);
 	tcase_add_test(tc, test_build_table_folders_live_filtering);
+	tcase_add_test(tc, test_table_get_rows);
+	tcase_add_test(tc, test_table_get_rows_live_filtering);
 	tcase_add_test(tc, test_get_Transport_folder_when_has_unusual_display_name);
 
 	if (strcmp(backend_name, "MySQL") == 0) {
@@ -1237,8 +1538,22 @@ static Suite *openchangedb_create_suite(const char *backend_name,
 	}
 
 	tcase_add_test(tc, test_set_receive_folder_to_mailbox);
+	tcase_add_test(tc, test_get_new_changeNumber_concurrency);
+	tcase_add_test(tc, test_get_new_changeNumber_two_processes);
 
+	/* Each change number allocated by the concurrency tests is a
+	 * backend transaction */
+	tcase_set_timeout(tc, 20);
 	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create(talloc_asprintf(talloc_autofree_context(), "%s performance", suite_name));
+		tcase_add_unchecked_fixture(tc_perf, setup, teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_table_rows);
+		suite_add_tcase(s, tc_perf);
+	}
+
 	return s;
 }
 
@@ -0,0 +1,232 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "libmapi/libmapi.h"
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define	ROP_STATS_PATH		"/tmp/openchange-testsuite-rop_stats"
+#define	WRITERS			4
+#define	WRITER_CALLS		100000
+
+/* Global test variables */
+static TALLOC_CTX		*g_mem_ctx;
+static struct mpm_rop_stats	*g_stats;
+
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_buckets) {
+	uint64_t	usec;
+	uint64_t	low;
+	uint32_t	bucket;
+	uint32_t	previous = 0;
+
+	/* Small values are exact */
+	for (usec = 0; usec < 8; usec++) {
+		ck_assert_int_eq(mpm_rop_stats_bucket(usec), usec);
+		ck_assert(mpm_rop_stats_bucket_usec(usec) == usec);
+	}
+
+	/* Buckets are monotonic and hold values within 25% of their
+	   lower bound */
+	for (usec = 1; usec < (1ULL << 31); usec = usec * 9 / 8 + 1) {
+		bucket = mpm_rop_stats_bucket(usec);
+		ck_assert(bucket >= previous);
+		ck_assert(bucket < MPM_ROP_STATS_BUCKETS);
+		low = mpm_rop_stats_bucket_usec(bucket);
+		ck_assert(low <= usec);
+		ck_assert(usec - low <= low / 4);
+		ck_assert(mpm_rop_stats_bucket(low) == bucket);
+		ck_assert(mpm_rop_stats_bucket_usec(bucket + 1) > usec);
+		previous = bucket;
+	}
+
+	/* Anything larger lands in the last bucket */
+	ck_assert_int_eq(mpm_rop_stats_bucket(UINT64_MAX), MPM_ROP_STATS_BUCKETS - 1);
+} END_TEST
+
+START_TEST (test_record_and_read) {
+	struct mpm_rop_stats		*reader;
+	struct mpm_rop_stats_entry	entry;
+	uint32_t			i;
+
+	for (i = 1; i <= 100; i++) {
+		mpm_rop_stats_record(g_stats, op_MAPI_QueryRows, i * 10, 20, 1000, (i % 10) == 0);
+	}
+	mpm_rop_stats_record(g_stats, op_MAPI_Release, 1, 7, 0, false);
+
+	/* A read-only mapping sees the counters */
+	reader = mpm_rop_stats_init(g_mem_ctx, ROP_STATS_PATH, false);
+	ck_assert(reader != NULL);
+
+	ck_assert_int_eq(mpm_rop_stats_get(reader, op_MAPI_QueryRows, &entry), MAPI_E_SUCCESS);
+	ck_assert(entry.calls == 100);
+	ck_assert(entry.errors == 10);
+	ck_assert(entry.bytes_in == 2000);
+	ck_assert(entry.bytes_out == 100000);
+	ck_assert(entry.usec_total == 50500);
+	ck_assert(entry.usec_max == 1000);
+
+	/* Percentiles are within the bucket precision */
+	ck_assert(mpm_rop_stats_percentile(&entry, 50) >= 500);
+	ck_assert(mpm_rop_stats_percentile(&entry, 50) <= 500 * 5 / 4);
+	ck_assert(mpm_rop_stats_percentile(&entry, 99) >= 990);
+	ck_assert(mpm_rop_stats_percentile(&entry, 100) == 1000);
+
+	ck_assert_int_eq(mpm_rop_stats_get(reader, op_MAPI_Release, &entry), MAPI_E_SUCCESS);
+	ck_assert(entry.calls == 1);
+	ck_assert(entry.bytes_in == 7);
+
+	/* Read-only mappings cannot record or reset */
+	mpm_rop_stats_record(reader, op_MAPI_Release, 1, 7, 0, false);
+	ck_assert_int_eq(mpm_rop_stats_reset(reader), MAPI_E_INVALID_PARAMETER);
+
+	ck_assert_int_eq(mpm_rop_stats_reset(g_stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mpm_rop_stats_get(reader, op_MAPI_QueryRows, &entry), MAPI_E_SUCCESS);
+	ck_assert(entry.calls == 0);
+	ck_assert(mpm_rop_stats_percentile(&entry, 50) == 0);
+} END_TEST
+
+START_TEST (test_invalid_file) {
+	struct mpm_rop_stats_entry	entry;
+	struct mpm_rop_stats		*stats;
+	struct stat			sb;
+	char				buf[32];
+	FILE				*f;
+
+	f = fopen(ROP_STATS_PATH "-invalid", "w");
+	ck_assert(f != NULL);
+	fputs("not a statistics file", f);
+	fclose(f);
+
+	ck_assert(mpm_rop_stats_init(g_mem_ctx, ROP_STATS_PATH "-invalid", false) == NULL);
+	ck_assert(mpm_rop_stats_init(g_mem_ctx, ROP_STATS_PATH "-missing", false) == NULL);
+
+	/* A writable mapping never takes an unrelated file over */
+	ck_assert(mpm_rop_stats_init(g_mem_ctx, ROP_STATS_PATH "-invalid", true) == NULL);
+	f = fopen(ROP_STATS_PATH "-invalid", "r");
+	ck_assert(f != NULL);
+	ck_assert(fgets(buf, sizeof (buf), f) != NULL);
+	ck_assert_str_eq(buf, "not a statistics file");
+	fclose(f);
+
+	/* Even when it has the size of a statistics file */
+	ck_assert_int_eq(stat(ROP_STATS_PATH, &sb), 0);
+	ck_assert_int_eq(truncate(ROP_STATS_PATH "-invalid", sb.st_size), 0);
+	ck_assert(mpm_rop_stats_init(g_mem_ctx, ROP_STATS_PATH "-invalid", true) == NULL);
+	unlink(ROP_STATS_PATH "-invalid");
+
+	/* Empty files are initialized */
+	f = fopen(ROP_STATS_PATH "-empty", "w");
+	ck_assert(f != NULL);
+	fclose(f);
+	stats = mpm_rop_stats_init(g_mem_ctx, ROP_STATS_PATH "-empty", true);
+	ck_assert(stats != NULL);
+	ck_assert_int_eq(mpm_rop_stats_get(stats, op_MAPI_GetProps, &entry), MAPI_E_SUCCESS);
+	ck_assert(entry.calls == 0);
+	ck_assert(mpm_rop_stats_init(g_mem_ctx, ROP_STATS_PATH "-empty", false) != NULL);
+	unlink(ROP_STATS_PATH "-empty");
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_concurrent_writers) {
+	struct mpm_rop_stats_entry	entry;
+	struct timespec			start;
+	double				record_ms;
+	pid_t				pids[WRITERS];
+	int				status;
+	uint32_t			i;
+	uint32_t			j;
+
+	/* Processes forked by the server share the mapping */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < WRITERS; i++) {
+		pids[i] = fork();
+		ck_assert(pids[i] != -1);
+		if (pids[i] == 0) {
+			for (j = 0; j < WRITER_CALLS; j++) {
+				mpm_rop_stats_record(g_stats, op_MAPI_GetProps, j % 5000, 10, 100, false);
+			}
+			_exit(0);
+		}
+	}
+	for (i = 0; i < WRITERS; i++) {
+		ck_assert(waitpid(pids[i], &status, 0) == pids[i]);
+		ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+	record_ms = testsuite_elapsed_ms(&start);
+
+	ck_assert_int_eq(mpm_rop_stats_get(g_stats, op_MAPI_GetProps, &entry), MAPI_E_SUCCESS);
+	ck_assert(entry.calls == WRITERS * WRITER_CALLS);
+	ck_assert(entry.bytes_out == (uint64_t) WRITERS * WRITER_CALLS * 100);
+	ck_assert(entry.usec_max == 4999);
+
+	testsuite_benchmark_report("rop_stats %u processes x %u records: %.2fms (%.1f ns/record)\n",
+	                           WRITERS, WRITER_CALLS, record_ms, record_ms * 1000000.0 / (WRITERS * WRITER_CALLS));
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void rop_stats_setup(void)
+{
+	g_mem_ctx = talloc_named(NULL, 0, "rop_stats_setup");
+	unlink(ROP_STATS_PATH);
+	g_stats = mpm_rop_stats_init(g_mem_ctx, ROP_STATS_PATH, true);
+	ck_assert(g_stats != NULL);
+}
+
+static void rop_stats_teardown(void)
+{
+	talloc_free(g_mem_ctx);
+	unlink(ROP_STATS_PATH);
+}
+
+Suite *mapiproxy_rop_stats_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+	TCase	*tc_perf;
+
+	s = suite_create("libmapiproxy: ROP statistics");
+
+	tc = tcase_create("ROP statistics interface");
+	tcase_add_checked_fixture(tc, rop_stats_setup, rop_stats_teardown);
+	tcase_add_test(tc, test_buckets);
+	tcase_add_test(tc, test_record_and_read);
+	tcase_add_test(tc, test_invalid_file);
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		tc_perf = tcase_create("ROP statistics performance");
+		tcase_add_checked_fixture(tc_perf, rop_stats_setup, rop_stats_teardown);
+		tcase_set_timeout(tc_perf, 60);
+		tcase_add_test(tc_perf, test_concurrent_writers);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
@@ -0,0 +1,218 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "libmapi/libmapi.h"
+#include <time.h>
+
+#define	SESSIONS_COUNT	10000
+
+/* Global test variables */
+static TALLOC_CTX			*g_mem_ctx;
+static struct mpm_session_registry	*g_registry;
+static uint32_t				g_destructor_calls;
+
+
+static bool session_destructor(void *private_data)
+{
+	g_destructor_calls++;
+	return true;
+}
+
+static struct mpm_session *new_session(uint32_t context_id)
+{
+	struct mpm_session	*session;
+	struct server_id	server_id;
+
+	memset(&server_id, 0, sizeof (struct server_id));
+	session = mpm_session_new(g_mem_ctx, server_id, context_id);
+	ck_assert(session != NULL);
+	mpm_session_set_destructor(session, session_destructor);
+
+	return session;
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_add_find_release) {
+	struct mpm_session_registry_stats	stats;
+	struct mpm_session			*session;
+	struct GUID				uuid;
+	struct GUID				unknown;
+
+	uuid = GUID_random();
+	unknown = GUID_random();
+	session = new_session(1);
+
+	ck_assert(mpm_session_registry_add(g_registry, &uuid, session));
+	ck_assert(mpm_session_registry_find(g_registry, &uuid) == session);
+	ck_assert(mpm_session_registry_find(g_registry, &unknown) == NULL);
+
+	/* A referenced session survives the first release */
+	mpm_session_increment_ref_count(session);
+	ck_assert_int_eq(mpm_session_registry_release(g_registry, &uuid), MAPI_E_UNABLE_TO_COMPLETE);
+	ck_assert(mpm_session_registry_find(g_registry, &uuid) == session);
+	ck_assert_int_eq(mpm_session_registry_release(g_registry, &uuid), MAPI_E_SUCCESS);
+	ck_assert_int_eq(g_destructor_calls, 1);
+
+	ck_assert(mpm_session_registry_find(g_registry, &uuid) == NULL);
+	ck_assert_int_eq(mpm_session_registry_release(g_registry, &uuid), MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mpm_session_registry_get_stats(g_registry, &stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.live, 0);
+	ck_assert_int_eq(stats.lookups, 4);
+	ck_assert_int_eq(stats.misses, 2);
+	ck_assert_int_eq(stats.evictions, 0);
+} END_TEST
+
+START_TEST (test_expire) {
+	struct mpm_session_registry_stats	stats;
+	struct GUID				uuids[3];
+	TALLOC_CTX				*handle;
+	TALLOC_CTX				*wait;
+	time_t					now;
+	int					i;
+
+	for (i = 0; i < 3; i++) {
+		uuids[i] = GUID_random();
+		ck_assert(mpm_session_registry_add(g_registry, &uuids[i], new_session(i)));
+	}
+
+	/* A connected client holds its session, with a reference count
+	 * of 0, the usual case */
+	handle = talloc_new(g_mem_ctx);
+	ck_assert_int_eq(mpm_session_registry_hold(g_registry, &uuids[0], handle), MAPI_E_SUCCESS);
+	/* A session shared by two EcDoConnect calls but held by no one */
+	mpm_session_increment_ref_count(mpm_session_registry_find(g_registry, &uuids[1]));
+	ck_assert_int_eq(mpm_session_registry_hold(g_registry, &uuids[2], NULL), MAPI_E_INVALID_PARAMETER);
+
+	now = time(NULL);
+	ck_assert_int_eq(mpm_session_registry_expire(g_registry, now), 0);
+	ck_assert_int_eq(mpm_session_registry_expire(g_registry, now + 60), 2);
+	ck_assert_int_eq(g_destructor_calls, 2);
+
+	ck_assert_int_eq(mpm_session_registry_get_stats(g_registry, &stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.live, 1);
+	ck_assert_int_eq(stats.evictions, 2);
+	ck_assert(mpm_session_registry_find(g_registry, &uuids[0]) != NULL);
+	ck_assert(mpm_session_registry_find(g_registry, &uuids[1]) == NULL);
+	ck_assert(mpm_session_registry_find(g_registry, &uuids[2]) == NULL);
+
+	/* A parked call keeps the session once the connection is gone */
+	wait = talloc_new(g_mem_ctx);
+	ck_assert_int_eq(mpm_session_registry_hold(g_registry, &uuids[0], wait), MAPI_E_SUCCESS);
+	talloc_free(handle);
+	ck_assert_int_eq(mpm_session_registry_expire(g_registry, now + 120), 0);
+	ck_assert(mpm_session_registry_find(g_registry, &uuids[0]) != NULL);
+
+	/* Without holders, the session expires once idle. Lookups, done
+	 * by every call on the context handle, refresh it */
+	talloc_free(wait);
+	ck_assert(mpm_session_registry_find(g_registry, &uuids[0]) != NULL);
+	ck_assert_int_eq(mpm_session_registry_expire(g_registry, time(NULL) + 10), 0);
+	ck_assert_int_eq(mpm_session_registry_expire(g_registry, time(NULL) + 60), 1);
+	ck_assert_int_eq(g_destructor_calls, 3);
+
+	ck_assert_int_eq(mpm_session_registry_get_stats(g_registry, &stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.live, 0);
+	ck_assert_int_eq(stats.evictions, 3);
+} END_TEST
+
+START_TEST (test_hold_outlives_registry) {
+	struct mpm_session_registry	*registry;
+	struct GUID			uuid;
+	TALLOC_CTX			*handle;
+
+	registry = mpm_session_registry_init(g_mem_ctx, "testsuite", 30);
+	uuid = GUID_random();
+	ck_assert(mpm_session_registry_add(registry, &uuid, new_session(1)));
+
+	handle = talloc_new(g_mem_ctx);
+	ck_assert_int_eq(mpm_session_registry_hold(registry, &uuid, handle), MAPI_E_SUCCESS);
+	talloc_free(registry);
+	talloc_free(handle);
+} END_TEST
+
+START_TEST (test_many_sessions) {
+	struct mpm_session_registry_stats	stats;
+	struct mpm_session			**sessions;
+	struct GUID				*uuids;
+	uint32_t				i;
+
+	sessions = talloc_array(g_mem_ctx, struct mpm_session *, SESSIONS_COUNT);
+	uuids = talloc_array(g_mem_ctx, struct GUID, SESSIONS_COUNT);
+
+	for (i = 0; i < SESSIONS_COUNT; i++) {
+		uuids[i] = GUID_random();
+		sessions[i] = new_session(i);
+		ck_assert(mpm_session_registry_add(g_registry, &uuids[i], sessions[i]));
+	}
+
+	for (i = 0; i < SESSIONS_COUNT; i++) {
+		ck_assert(mpm_session_registry_find(g_registry, &uuids[(i * 7919) % SESSIONS_COUNT]) == sessions[(i * 7919) % SESSIONS_COUNT]);
+	}
+
+	for (i = 0; i < SESSIONS_COUNT; i += 2) {
+		ck_assert_int_eq(mpm_session_registry_release(g_registry, &uuids[i]), MAPI_E_SUCCESS);
+	}
+
+	ck_assert_int_eq(mpm_session_registry_get_stats(g_registry, &stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.live, SESSIONS_COUNT / 2);
+	ck_assert_int_eq(stats.misses, 0);
+
+	for (i = 1; i < SESSIONS_COUNT; i += 2) {
+		ck_assert(mpm_session_registry_find(g_registry, &uuids[i]) == sessions[i]);
+	}
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void session_registry_setup(void)
+{
+	g_mem_ctx = talloc_named(NULL, 0, "session_registry_setup");
+	g_registry = mpm_session_registry_init(g_mem_ctx, "testsuite", 30);
+	ck_assert(g_registry != NULL);
+	g_destructor_calls = 0;
+}
+
+static void session_registry_teardown(void)
+{
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapiproxy_session_registry_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+
+	s = suite_create("libmapiproxy: session registry");
+
+	tc = tcase_create("session registry interface");
+	tcase_add_checked_fixture(tc, session_registry_setup, session_registry_teardown);
+	tcase_add_test(tc, test_add_find_release);
+	tcase_add_test(tc, test_expire);
+	tcase_add_test(tc, test_hold_outlives_registry);
+	tcase_add_test(tc, test_many_sessions);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,339 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include <libmapistore/mapistore.h>
+#include <libmapistore/mapistore_errors.h>
+#include <libmapistore/backends/namedprops_backend.h>
+#include <time.h>
+
+#define	NAMEDPROPS_LDB_PATH		"/tmp/openchange-testsuite-shared_pool.ldb"
+#define	NAMEDPROPS_LDB_SCHEMA_PATH	"setup/mapistore"
+#define	BENCHMARK_CONNECTS		2000
+
+struct shared_object {
+	const char	*config;
+};
+
+/* Global test variables */
+static TALLOC_CTX		*g_mem_ctx;
+static struct mpm_shared_stats	g_stats;
+static uint32_t			g_opens;
+static uint32_t			g_frees;
+static bool			g_open_fails;
+
+
+static int shared_object_destructor(struct shared_object *object)
+{
+	g_frees++;
+	return 0;
+}
+
+static void *shared_object_open(TALLOC_CTX *mem_ctx, void *private_data)
+{
+	struct shared_object	*object;
+
+	if (g_open_fails) return NULL;
+
+	object = talloc_zero(mem_ctx, struct shared_object);
+	object->config = talloc_strdup(object, (const char *) private_data);
+	talloc_set_destructor(object, shared_object_destructor);
+	g_opens++;
+
+	return object;
+}
+
+static struct shared_object *borrow(TALLOC_CTX *mem_ctx, const char *name, const char *config)
+{
+	return mpm_shared_get(mem_ctx, name, config, shared_object_open, (void *) config);
+}
+
+/* Counters are process-wide: compare them with the ones taken by
+   the fixture */
+static void check_stats(uint32_t entries, uint64_t hits, uint64_t misses, uint64_t invalidations)
+{
+	struct mpm_shared_stats	stats;
+
+	ck_assert_int_eq(mpm_shared_get_stats(&stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.entries, entries);
+	ck_assert_int_eq(stats.hits - g_stats.hits, hits);
+	ck_assert_int_eq(stats.misses - g_stats.misses, misses);
+	ck_assert_int_eq(stats.invalidations - g_stats.invalidations, invalidations);
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_get_release) {
+	TALLOC_CTX		*session1;
+	TALLOC_CTX		*session2;
+	struct shared_object	*object;
+
+	session1 = talloc_new(g_mem_ctx);
+	session2 = talloc_new(g_mem_ctx);
+
+	object = borrow(session1, "samdb", "url");
+	ck_assert(object != NULL);
+	ck_assert(borrow(session2, "samdb", "url") == object);
+	ck_assert_int_eq(g_opens, 1);
+	check_stats(1, 1, 1, 0);
+
+	/* The pool keeps the object when no session uses it */
+	ck_assert_int_eq(mpm_shared_release(session1, object), 0);
+	talloc_free(session2);
+	ck_assert_int_eq(g_frees, 0);
+	ck_assert(borrow(session1, "samdb", "url") == object);
+	ck_assert_int_eq(g_opens, 1);
+
+	/* Other names get their own object */
+	ck_assert(borrow(session1, "namedprops", "url") != object);
+	ck_assert_int_eq(g_opens, 2);
+	check_stats(2, 2, 2, 0);
+
+	ck_assert(mpm_shared_get(NULL, "samdb", "url", shared_object_open, NULL) == NULL);
+	ck_assert(mpm_shared_get(session1, NULL, "url", shared_object_open, NULL) == NULL);
+	ck_assert(mpm_shared_get(session1, "samdb", NULL, shared_object_open, NULL) == NULL);
+	ck_assert(mpm_shared_get(session1, "samdb", "url", NULL, NULL) == NULL);
+	ck_assert_int_eq(mpm_shared_get_stats(NULL), MAPI_E_INVALID_PARAMETER);
+} END_TEST
+
+START_TEST (test_config_change) {
+	TALLOC_CTX		*session1;
+	TALLOC_CTX		*session2;
+	struct shared_object	*old;
+	struct shared_object	*new;
+
+	session1 = talloc_new(g_mem_ctx);
+	session2 = talloc_new(g_mem_ctx);
+
+	old = borrow(session1, "samdb", "ldap://old");
+	new = borrow(session2, "samdb", "ldap://new");
+	ck_assert(new != NULL && new != old);
+	ck_assert_str_eq(new->config, "ldap://new");
+	check_stats(1, 0, 2, 1);
+
+	/* Sessions holding the previous object still use it */
+	ck_assert_int_eq(g_frees, 0);
+	ck_assert_str_eq(old->config, "ldap://old");
+	ck_assert(borrow(session1, "samdb", "ldap://new") == new);
+	talloc_free(session1);
+	ck_assert_int_eq(g_frees, 1);
+
+	talloc_free(session2);
+	ck_assert_int_eq(g_frees, 1);
+} END_TEST
+
+START_TEST (test_invalidate) {
+	TALLOC_CTX		*session;
+	struct shared_object	*object;
+
+	session = talloc_new(g_mem_ctx);
+
+	object = borrow(session, "indexing:user1", "tdb");
+	ck_assert(borrow(session, "indexing:user2", "tdb") != NULL);
+	ck_assert(borrow(session, "samdb", "") != NULL);
+	ck_assert_int_eq(mpm_shared_release(session, borrow(session, "indexing:user2", "tdb")), 0);
+
+	ck_assert_int_eq(mpm_shared_invalidate("indexing:"), 2);
+	check_stats(1, 1, 3, 2);
+	ck_assert_str_eq(object->config, "tdb");
+	ck_assert(borrow(session, "indexing:user1", "tdb") != object);
+	ck_assert_int_eq(g_opens, 4);
+
+	ck_assert_int_eq(mpm_shared_invalidate(NULL), 2);
+	ck_assert_int_eq(mpm_shared_invalidate(NULL), 0);
+	talloc_free(session);
+	ck_assert_int_eq(g_frees, 4);
+} END_TEST
+
+START_TEST (test_idle_eviction) {
+	TALLOC_CTX		*session1;
+	TALLOC_CTX		*session2;
+	struct shared_object	*object;
+	struct mpm_shared_stats	stats;
+
+	session1 = talloc_new(g_mem_ctx);
+	session2 = talloc_new(g_mem_ctx);
+
+	/* Evicted with its last borrower */
+	mpm_shared_set_idle_timeout(0);
+	object = borrow(session1, "indexing:user1", "tdb");
+	ck_assert(borrow(session2, "indexing:user1", "tdb") == object);
+	ck_assert_int_eq(mpm_shared_release(session1, object), 0);
+	ck_assert_int_eq(mpm_shared_release(session1, object), -1);
+	check_stats(1, 1, 1, 0);
+	talloc_free(session2);
+	ck_assert_int_eq(g_frees, 1);
+	ck_assert_int_eq(mpm_shared_get_stats(&stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.entries, 0);
+	ck_assert_int_eq(stats.evictions - g_stats.evictions, 1);
+
+	/* Kept for the idle timeout, then evicted by the next lookup */
+	mpm_shared_set_idle_timeout(2);
+	session2 = talloc_new(g_mem_ctx);
+	object = borrow(session2, "indexing:user2", "tdb");
+	talloc_free(session2);
+	session2 = talloc_new(g_mem_ctx);
+	ck_assert(borrow(session2, "indexing:user2", "tdb") == object);
+	talloc_free(session2);
+	ck_assert_int_eq(g_frees, 1);
+	sleep(3);
+	ck_assert(borrow(session1, "samdb", "") != NULL);
+	ck_assert_int_eq(g_frees, 2);
+	ck_assert_int_eq(mpm_shared_get_stats(&stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.entries, 1);
+	ck_assert_int_eq(stats.evictions - g_stats.evictions, 2);
+
+	/* Borrowers of invalidated objects are not counted */
+	ck_assert_int_eq(mpm_shared_invalidate(NULL), 1);
+	talloc_free(session1);
+	ck_assert_int_eq(g_frees, 3);
+	ck_assert_int_eq(mpm_shared_get_stats(&stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.evictions - g_stats.evictions, 2);
+} END_TEST
+
+START_TEST (test_open_failure) {
+	TALLOC_CTX	*session;
+
+	session = talloc_new(g_mem_ctx);
+
+	g_open_fails = true;
+	ck_assert(borrow(session, "samdb", "") == NULL);
+	check_stats(0, 0, 1, 0);
+
+	/* Failures are not cached */
+	g_open_fails = false;
+	ck_assert(borrow(session, "samdb", "") != NULL);
+	check_stats(1, 0, 2, 0);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v Performance test ----------------------------------------------------------
+
+/* Open the named properties LDB store the way sessions do, with and
+   without the pool */
+START_TEST (test_benchmark_namedprops_connect) {
+	struct loadparm_context		*lp_ctx;
+	struct namedprops_context	*nprops;
+	struct namedprops_context	*shared = NULL;
+	TALLOC_CTX			*session;
+	struct timespec			start;
+	struct MAPINAMEID		nameid;
+	uint16_t			mapped_id;
+	double				private_ms, shared_ms;
+	uint32_t			i;
+
+	lp_ctx = loadparm_init(g_mem_ctx);
+	ck_assert(lp_ctx != NULL);
+	unlink(NAMEDPROPS_LDB_PATH);
+	ck_assert(lpcfg_set_cmdline(lp_ctx, "mapistore:namedproperties", "ldb"));
+	ck_assert(lpcfg_set_cmdline(lp_ctx, "namedproperties:ldb_url", NAMEDPROPS_LDB_PATH));
+	ck_assert(lpcfg_set_cmdline(lp_ctx, "namedproperties:ldb_data", NAMEDPROPS_LDB_SCHEMA_PATH));
+
+	/* PidLidPercentComplete */
+	memset(&nameid, 0, sizeof (struct MAPINAMEID));
+	GUID_from_string("00062003-0000-0000-c000-000000000046", &nameid.lpguid);
+	nameid.ulKind = MNID_ID;
+	nameid.kind.lid = 0x8102;
+
+	/* Provision the store */
+	session = talloc_new(g_mem_ctx);
+	ck_assert_int_eq(mapistore_namedprops_init(session, lp_ctx, &nprops), MAPISTORE_SUCCESS);
+	talloc_free(session);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_CONNECTS; i++) {
+		session = talloc_new(g_mem_ctx);
+		ck_assert_int_eq(mapistore_namedprops_init(session, lp_ctx, &nprops), MAPISTORE_SUCCESS);
+		ck_assert_int_eq(mapistore_namedprops_get_mapped_id(nprops, nameid, &mapped_id), MAPISTORE_SUCCESS);
+		talloc_free(session);
+	}
+	private_ms = testsuite_elapsed_ms(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_CONNECTS; i++) {
+		session = talloc_new(g_mem_ctx);
+		ck_assert_int_eq(mapistore_namedprops_borrow(session, lp_ctx, &nprops), MAPISTORE_SUCCESS);
+		ck_assert(!shared || nprops == shared);
+		shared = nprops;
+		ck_assert_int_eq(mapistore_namedprops_get_mapped_id(nprops, nameid, &mapped_id), MAPISTORE_SUCCESS);
+		talloc_free(session);
+	}
+	shared_ms = testsuite_elapsed_ms(&start);
+	check_stats(1, BENCHMARK_CONNECTS - 1, 1, 0);
+
+	testsuite_benchmark_report("named properties LDB %u connects: private %.0f/s, shared %.0f/s\n",
+	                           BENCHMARK_CONNECTS, BENCHMARK_CONNECTS * 1000.0 / private_ms,
+	                           BENCHMARK_CONNECTS * 1000.0 / shared_ms);
+
+	mpm_shared_invalidate(NULL);
+	unlink(NAMEDPROPS_LDB_PATH);
+} END_TEST
+
+// ^ performance tests ---------------------------------------------------------
+
+static void shared_pool_setup(void)
+{
+	g_mem_ctx = talloc_named(NULL, 0, "shared_pool_setup");
+	mpm_shared_invalidate(NULL);
+	ck_assert_int_eq(mpm_shared_get_stats(&g_stats), MAPI_E_SUCCESS);
+	g_opens = 0;
+	g_frees = 0;
+	g_open_fails = false;
+	mpm_shared_set_idle_timeout(MPM_SHARED_IDLE_TIMEOUT);
+}
+
+static void shared_pool_teardown(void)
+{
+	mpm_shared_invalidate(NULL);
+	mpm_shared_set_idle_timeout(MPM_SHARED_IDLE_TIMEOUT);
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapiproxy_shared_pool_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+	TCase	*tc_perf;
+
+	s = suite_create("libmapiproxy: shared pool");
+
+	tc = tcase_create("shared pool interface");
+	tcase_add_checked_fixture(tc, shared_pool_setup, shared_pool_teardown);
+	tcase_add_test(tc, test_get_release);
+	tcase_add_test(tc, test_config_change);
+	tcase_add_test(tc, test_invalidate);
+	tcase_add_test(tc, test_idle_eviction);
+	tcase_add_test(tc, test_open_failure);
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		tc_perf = tcase_create("shared pool performance");
+		tcase_add_checked_fixture(tc_perf, shared_pool_setup, shared_pool_teardown);
+		tcase_set_timeout(tc_perf, 600);
+		tcase_add_test(tc_perf, test_benchmark_namedprops_connect);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
@@ -0,0 +1,286 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapiserver/libmapiserver.h"
+#include "libmapi/libmapi.h"
+
+#define	TABLE_ROWS		2000
+#define	ROP_BUFFER_SIZE		0x8000
+#define	CLIENT_ROW_COUNT	50
+
+/* Synthetic backend: row i is a uint32_t index followed by padding,
+   between 64 and 511 bytes long */
+struct synthetic_table {
+	uint32_t	rows;
+	uint32_t	fixed_size;
+	uint32_t	fail_at;
+	uint32_t	fetch_calls;
+	uint32_t	fetched_rows;
+};
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct synthetic_table	table;
+
+
+static uint32_t synthetic_row_size(uint32_t index)
+{
+	return table.fixed_size ? table.fixed_size : 64 + (index * 37) % 448;
+}
+
+static uint32_t synthetic_get_rows(TALLOC_CTX *ctx, void *private_data,
+				   uint32_t start, uint32_t count, DATA_BLOB *rows)
+{
+	struct synthetic_table	*t = (struct synthetic_table *) private_data;
+	uint32_t		index;
+	uint32_t		i;
+
+	t->fetch_calls++;
+	for (i = 0; i < count; i++) {
+		index = start + i;
+		if (index >= t->rows || index == t->fail_at) break;
+		rows[i].length = synthetic_row_size(index);
+		rows[i].data = talloc_zero_array(ctx, uint8_t, rows[i].length);
+		memcpy(rows[i].data, &index, sizeof (uint32_t));
+		t->fetched_rows++;
+	}
+
+	return i;
+}
+
+static uint32_t row_index(const uint8_t *data)
+{
+	uint32_t	index;
+
+	memcpy(&index, data, sizeof (uint32_t));
+	return index;
+}
+
+/* Check the reply holds consecutive rows starting at first, in the
+   reading direction */
+static void check_rows(struct EcDoRpc_MAPI_REPL *repl, uint32_t first, bool forward)
+{
+	struct QueryRows_repl	*response = &repl->u.mapi_QueryRows;
+	uint32_t		offset = 0;
+	uint32_t		index = first;
+	uint16_t		i;
+
+	for (i = 0; i < response->RowCount; i++) {
+		ck_assert_int_eq(row_index(response->RowData.data + offset), index);
+		offset += synthetic_row_size(index);
+		index = forward ? index + 1 : index - 1;
+	}
+	ck_assert_int_eq(offset, response->RowData.length);
+}
+
+/* Replay a client reading the whole table with QueryRows, returns
+   the number of RPCs issued */
+static uint32_t replay_table_scan(uint16_t row_count, bool forward)
+{
+	struct EcDoRpc_MAPI_REPL	repl;
+	uint32_t			position = forward ? 0 : TABLE_ROWS;
+	uint32_t			first;
+	uint32_t			total = 0;
+	uint32_t			rpcs = 0;
+	enum MAPISTATUS			retval;
+
+	do {
+		memset(&repl, 0, sizeof (repl));
+		first = forward ? position : position - 1;
+		retval = libmapiserver_RopQueryRows_fill(mem_ctx, &repl, ROP_BUFFER_SIZE, forward, row_count,
+							 &position, TABLE_ROWS, synthetic_get_rows, &table);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+		ck_assert(libmapiserver_RopQueryRows_size(&repl) <= ROP_BUFFER_SIZE);
+		check_rows(&repl, first, forward);
+		total += repl.u.mapi_QueryRows.RowCount;
+		talloc_free(repl.u.mapi_QueryRows.RowData.data);
+		rpcs++;
+	} while (repl.u.mapi_QueryRows.RowCount);
+
+	ck_assert_int_eq(total, TABLE_ROWS);
+	ck_assert_int_eq(position, forward ? TABLE_ROWS : 0);
+
+	return rpcs;
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_fill_row_count) {
+	struct EcDoRpc_MAPI_REPL	repl;
+	uint32_t			position = 10;
+
+	memset(&repl, 0, sizeof (repl));
+	ck_assert_int_eq(libmapiserver_RopQueryRows_fill(mem_ctx, &repl, ROP_BUFFER_SIZE, true, 5, &position,
+							 TABLE_ROWS, synthetic_get_rows, &table), MAPI_E_SUCCESS);
+	ck_assert_int_eq(repl.u.mapi_QueryRows.RowCount, 5);
+	ck_assert_int_eq(position, 15);
+	check_rows(&repl, 10, true);
+
+	/* Backward read from the cursor */
+	memset(&repl, 0, sizeof (repl));
+	ck_assert_int_eq(libmapiserver_RopQueryRows_fill(mem_ctx, &repl, ROP_BUFFER_SIZE, false, 20, &position,
+							 TABLE_ROWS, synthetic_get_rows, &table), MAPI_E_SUCCESS);
+	ck_assert_int_eq(repl.u.mapi_QueryRows.RowCount, 15);
+	ck_assert_int_eq(position, 0);
+	check_rows(&repl, 14, false);
+
+	/* Nothing left before the beginning */
+	memset(&repl, 0, sizeof (repl));
+	ck_assert_int_eq(libmapiserver_RopQueryRows_fill(mem_ctx, &repl, ROP_BUFFER_SIZE, false, 20, &position,
+							 TABLE_ROWS, synthetic_get_rows, &table), MAPI_E_SUCCESS);
+	ck_assert_int_eq(repl.u.mapi_QueryRows.RowCount, 0);
+	ck_assert_int_eq(position, 0);
+} END_TEST
+
+START_TEST (test_fill_budget) {
+	struct EcDoRpc_MAPI_REPL	repl;
+	uint32_t			position = 0;
+
+	/* 10 rows of 100 bytes fit in 1100 bytes, not 11 */
+	table.fixed_size = 100;
+	memset(&repl, 0, sizeof (repl));
+	ck_assert_int_eq(libmapiserver_RopQueryRows_fill(mem_ctx, &repl, 1100, true, 0xFFFF, &position,
+							 TABLE_ROWS, synthetic_get_rows, &table), MAPI_E_SUCCESS);
+	ck_assert_int_eq(repl.u.mapi_QueryRows.RowCount, 10);
+	ck_assert_int_eq(libmapiserver_RopQueryRows_size(&repl), 1009);
+	ck_assert_int_eq(position, 10);
+
+	/* Not even a single row fits */
+	memset(&repl, 0, sizeof (repl));
+	ck_assert_int_eq(libmapiserver_RopQueryRows_fill(mem_ctx, &repl, 100, true, 1, &position,
+							 TABLE_ROWS, synthetic_get_rows, &table), ecBufferTooSmall);
+	ck_assert_int_eq(repl.u.mapi_QueryRows.RowCount, 0);
+	ck_assert_int_eq(position, 10);
+} END_TEST
+
+START_TEST (test_fill_backend_failure) {
+	struct EcDoRpc_MAPI_REPL	repl;
+	uint32_t			position = 0;
+
+	/* Rows are returned up to the one which cannot be fetched */
+	table.fail_at = 7;
+	memset(&repl, 0, sizeof (repl));
+	ck_assert_int_eq(libmapiserver_RopQueryRows_fill(mem_ctx, &repl, ROP_BUFFER_SIZE, true, 50, &position,
+							 TABLE_ROWS, synthetic_get_rows, &table), MAPI_E_SUCCESS);
+	ck_assert_int_eq(repl.u.mapi_QueryRows.RowCount, 7);
+	ck_assert_int_eq(position, 7);
+	check_rows(&repl, 0, true);
+} END_TEST
+
+START_TEST (test_fill_short_batch) {
+	struct EcDoRpc_MAPI_REPL	repl;
+	uint32_t			position = 20;
+
+	/* The backend only holds 12 of the 20 rows the table reports:
+	   the batch read backward from 20 starts at row 0 and comes
+	   back short */
+	table.rows = 12;
+	memset(&repl, 0, sizeof (repl));
+	ck_assert_int_eq(libmapiserver_RopQueryRows_fill(mem_ctx, &repl, ROP_BUFFER_SIZE, false, 50, &position,
+							 20, synthetic_get_rows, &table), MAPI_E_SUCCESS);
+	ck_assert_int_eq(repl.u.mapi_QueryRows.RowCount, 12);
+	ck_assert_int_eq(position, 0);
+	check_rows(&repl, 11, false);
+
+	/* Same short batch, cut by the buffer: the cursor stops on the
+	   last row returned */
+	table.fixed_size = 100;
+	position = 20;
+	memset(&repl, 0, sizeof (repl));
+	ck_assert_int_eq(libmapiserver_RopQueryRows_fill(mem_ctx, &repl, 1100, false, 50, &position,
+							 20, synthetic_get_rows, &table), MAPI_E_SUCCESS);
+	ck_assert_int_eq(repl.u.mapi_QueryRows.RowCount, 10);
+	ck_assert_int_eq(position, 2);
+	check_rows(&repl, 11, false);
+
+	/* Forward short batch */
+	position = 5;
+	memset(&repl, 0, sizeof (repl));
+	ck_assert_int_eq(libmapiserver_RopQueryRows_fill(mem_ctx, &repl, ROP_BUFFER_SIZE, true, 50, &position,
+							 20, synthetic_get_rows, &table), MAPI_E_SUCCESS);
+	ck_assert_int_eq(repl.u.mapi_QueryRows.RowCount, 7);
+	ck_assert_int_eq(position, 12);
+	check_rows(&repl, 5, true);
+} END_TEST
+
+START_TEST (test_replay_rpc_count) {
+	uint32_t	fixed_rpcs;
+	uint32_t	forward_rpcs;
+	uint32_t	backward_rpcs;
+	uint32_t	fetched;
+	uint64_t	table_size = 0;
+	uint32_t	i;
+
+	for (i = 0; i < TABLE_ROWS; i++) {
+		table_size += synthetic_row_size(i);
+	}
+
+	/* Client asking for a fixed number of rows per RPC */
+	fixed_rpcs = replay_table_scan(CLIENT_ROW_COUNT, true);
+	ck_assert_int_eq(fixed_rpcs, TABLE_ROWS / CLIENT_ROW_COUNT + 1);
+
+	/* Client asking for as many rows as the server can return */
+	table.fetched_rows = 0;
+	forward_rpcs = replay_table_scan(0xFFFF, true);
+	fetched = table.fetched_rows;
+	ck_assert(forward_rpcs <= table_size / (ROP_BUFFER_SIZE - 512) + 2);
+	ck_assert(forward_rpcs < fixed_rpcs);
+	/* Row size estimates keep over-fetching low */
+	ck_assert(fetched < TABLE_ROWS + forward_rpcs * 8);
+
+	backward_rpcs = replay_table_scan(0xFFFF, false);
+	ck_assert(backward_rpcs <= table_size / (ROP_BUFFER_SIZE - 512) + 2);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void queryrows_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "queryrows_setup");
+	memset(&table, 0, sizeof (table));
+	table.rows = TABLE_ROWS;
+	table.fail_at = UINT32_MAX;
+}
+
+static void queryrows_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapiserver_queryrows_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+
+	s = suite_create("libmapiserver: QueryRows");
+
+	tc = tcase_create("QueryRows fill");
+	tcase_add_checked_fixture(tc, queryrows_setup, queryrows_teardown);
+	tcase_add_test(tc, test_fill_row_count);
+	tcase_add_test(tc, test_fill_budget);
+	tcase_add_test(tc, test_fill_backend_failure);
+	tcase_add_test(tc, test_fill_short_batch);
+	tcase_add_test(tc, test_replay_rpc_count);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
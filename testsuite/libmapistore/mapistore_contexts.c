@@ -0,0 +1,282 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+#include <time.h>
+
+#define	REGISTRY_BACKEND	"registry"
+#define	REGISTRY_NAMESPACE	"registry://"
+#define	RESET_BACKEND		"reset"
+#define	RESET_NAMESPACE		"reset://"
+#define	RESET_BACKENDS_PATH	"/tmp/openchange-testsuite-backends"
+#define	BENCHMARK_CONTEXTS	1000
+#define	BENCHMARK_LOOKUPS	1000000
+
+/* Global test variables */
+static TALLOC_CTX			*g_mem_ctx;
+static struct mapistore_context		*g_mstore_ctx;
+static uint32_t				g_backend_inits;
+
+
+static enum mapistore_error registry_create_context(TALLOC_CTX *mem_ctx, struct mapistore_connection_info *conn_info,
+						    struct indexing_context *ictx, const char *uri, void **backend_object)
+{
+	*backend_object = talloc_strdup(mem_ctx, uri);
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error registry_get_root_folder(void *backend_object, TALLOC_CTX *mem_ctx,
+						     uint64_t fid, void **root_folder)
+{
+	*root_folder = backend_object;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error reset_init(void)
+{
+	g_backend_inits++;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static struct backend_context_list *add_context(uint32_t context_id, const char *uri)
+{
+	struct backend_context_list	*el;
+
+	el = talloc_zero(g_mstore_ctx, struct backend_context_list);
+	el->ctx = talloc_zero(el, struct backend_context);
+	el->ctx->context_id = context_id;
+	el->ctx->uri = talloc_strdup(el->ctx, uri);
+	ck_assert_int_eq(mapistore_register_context(g_mstore_ctx->processing_ctx, el), MAPISTORE_SUCCESS);
+	DLIST_ADD_END(g_mstore_ctx->context_list, el, struct backend_context_list *);
+
+	return el;
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_context_id_allocation) {
+	struct processing_context	*pctx = g_mstore_ctx->processing_ctx;
+	uint32_t			context_id;
+	uint32_t			i;
+
+	/* Identifiers are handed out from 1, across bitmap words */
+	for (i = 1; i <= 100; i++) {
+		ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+		ck_assert_int_eq(context_id, i);
+	}
+
+	/* The lowest released identifier is reused first */
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 70), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 5), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(context_id, 5);
+	ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(context_id, 70);
+	ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(context_id, 101);
+
+	/* Double free and unknown identifiers */
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 42), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 42), MAPISTORE_ERR_CORRUPTED);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 0x10000), MAPISTORE_ERR_CORRUPTED);
+	ck_assert_int_eq(mapistore_free_context_id(pctx, 0), MAPISTORE_ERR_INVALID_PARAMETER);
+} END_TEST
+
+START_TEST (test_lookup) {
+	struct backend_context_list	*el1;
+	struct backend_context_list	*el2;
+
+	el1 = add_context(1, "registry://user/inbox");
+	el2 = add_context(300, "registry://user/calendar");
+
+	ck_assert(mapistore_backend_lookup(g_mstore_ctx, 1) == el1->ctx);
+	ck_assert(mapistore_backend_lookup(g_mstore_ctx, 300) == el2->ctx);
+	ck_assert(mapistore_backend_lookup(g_mstore_ctx, 2) == NULL);
+	ck_assert(mapistore_backend_lookup(g_mstore_ctx, 0xdead) == NULL);
+
+	ck_assert(mapistore_backend_lookup_by_uri(g_mstore_ctx, "registry://user/calendar") == el2->ctx);
+	ck_assert(mapistore_backend_lookup_by_uri(g_mstore_ctx, "registry://user/contacts") == NULL);
+	ck_assert(mapistore_backend_lookup_by_uri(g_mstore_ctx, NULL) == NULL);
+
+	/* An identifier is registered once */
+	ck_assert_int_eq(mapistore_register_context(g_mstore_ctx->processing_ctx, el1), MAPISTORE_ERR_EXIST);
+
+	mapistore_unregister_context(g_mstore_ctx->processing_ctx, el1);
+	ck_assert(mapistore_backend_lookup(g_mstore_ctx, 1) == NULL);
+	ck_assert(mapistore_backend_lookup_by_uri(g_mstore_ctx, "registry://user/inbox") == NULL);
+	ck_assert(mapistore_backend_lookup(g_mstore_ctx, 300) == el2->ctx);
+} END_TEST
+
+START_TEST (test_backend_context_count) {
+	struct mapistore_backend	backend;
+	struct backend_context		*ctx1;
+	struct backend_context		*ctx2;
+	uint32_t			count;
+
+	memset(&backend, 0, sizeof (backend));
+	ck_assert_int_eq(mapistore_backend_init_defaults(&backend), MAPISTORE_SUCCESS);
+	backend.backend.name = REGISTRY_BACKEND;
+	backend.backend.namespace = REGISTRY_NAMESPACE;
+	backend.backend.create_context = registry_create_context;
+	backend.context.get_root_folder = registry_get_root_folder;
+	ck_assert_int_eq(mapistore_backend_register(&backend), MAPISTORE_SUCCESS);
+
+	ck_assert_int_eq(mapistore_backend_get_context_count(REGISTRY_BACKEND, &count), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(count, 0);
+	ck_assert_int_eq(mapistore_backend_get_context_count("unknown", &count), MAPISTORE_ERR_NOT_FOUND);
+
+	ck_assert_int_eq(mapistore_backend_create_context(g_mem_ctx, NULL, NULL, REGISTRY_NAMESPACE, "user/inbox", 0, &ctx1), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_backend_create_context(g_mem_ctx, NULL, NULL, REGISTRY_NAMESPACE, "user/calendar", 0, &ctx2), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_backend_get_context_count(REGISTRY_BACKEND, &count), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(count, 2);
+
+	/* Contexts are only counted out with their last reference */
+	ck_assert_int_eq(mapistore_backend_add_ref_count(ctx1), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_backend_delete_context(ctx1), MAPISTORE_ERR_REF_COUNT);
+	ck_assert_int_eq(mapistore_backend_get_context_count(REGISTRY_BACKEND, &count), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(count, 2);
+	ck_assert_int_eq(mapistore_backend_delete_context(ctx1), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_backend_delete_context(ctx2), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_backend_get_context_count(REGISTRY_BACKEND, &count), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(count, 0);
+} END_TEST
+
+START_TEST (test_backend_init_reset) {
+	struct mapistore_backend	backend;
+	enum mapistore_error		retval;
+
+	memset(&backend, 0, sizeof (backend));
+	ck_assert_int_eq(mapistore_backend_init_defaults(&backend), MAPISTORE_SUCCESS);
+	backend.backend.name = RESET_BACKEND;
+	backend.backend.namespace = RESET_NAMESPACE;
+	backend.backend.init = reset_init;
+	ck_assert_int_eq(mapistore_backend_register(&backend), MAPISTORE_SUCCESS);
+
+	mkdir(RESET_BACKENDS_PATH, 0700);
+	retval = mapistore_backend_init(g_mem_ctx, RESET_BACKENDS_PATH);
+	ck_assert_int_eq(g_backend_inits, 1);
+
+	/* Later sessions get the result of the first initialization */
+	ck_assert_int_eq(mapistore_backend_init(g_mem_ctx, RESET_BACKENDS_PATH), retval);
+	ck_assert_int_eq(g_backend_inits, 1);
+
+	mapistore_backend_reset();
+	ck_assert_int_eq(mapistore_backend_init(g_mem_ctx, RESET_BACKENDS_PATH), retval);
+	ck_assert_int_eq(g_backend_inits, 2);
+
+	mapistore_backend_reset();
+	rmdir(RESET_BACKENDS_PATH);
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_benchmark_lookup) {
+	struct processing_context	*pctx = g_mstore_ctx->processing_ctx;
+	struct timespec			start;
+	double				alloc_ms, id_ms, uri_ms;
+	const char			**uris;
+	uint32_t			context_id;
+	uint32_t			i;
+
+	uris = talloc_array(g_mem_ctx, const char *, BENCHMARK_CONTEXTS);
+
+	/* Open and close contexts as folders are browsed */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_CONTEXTS; i++) {
+		ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+		uris[i] = talloc_asprintf(uris, "registry://user/folder%u", i);
+		add_context(context_id, uris[i]);
+	}
+	for (i = 1; i <= BENCHMARK_CONTEXTS; i += 2) {
+		ck_assert_int_eq(mapistore_free_context_id(pctx, i), MAPISTORE_SUCCESS);
+		ck_assert_int_eq(mapistore_get_context_id(pctx, &context_id), MAPISTORE_SUCCESS);
+		ck_assert_int_eq(context_id, i);
+	}
+	alloc_ms = testsuite_elapsed_ms(&start);
+
+	/* emsmdbp_get_contextID path */
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		ck_assert(mapistore_backend_lookup(g_mstore_ctx, 1 + random() % BENCHMARK_CONTEXTS) != NULL);
+	}
+	id_ms = testsuite_elapsed_ms(&start);
+
+	/* mapistore_search_context_by_uri path */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS / 10; i++) {
+		ck_assert(mapistore_backend_lookup_by_uri(g_mstore_ctx, uris[random() % BENCHMARK_CONTEXTS]) != NULL);
+	}
+	uri_ms = testsuite_elapsed_ms(&start);
+
+	testsuite_benchmark_report("mapistore contexts %u: id churn %.2fms, lookup by id %.3fus, lookup by uri %.3fus\n",
+	                           BENCHMARK_CONTEXTS, alloc_ms, id_ms * 1000.0 / BENCHMARK_LOOKUPS,
+	                           uri_ms * 1000.0 / (BENCHMARK_LOOKUPS / 10));
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_contexts_setup(void)
+{
+	g_mem_ctx = talloc_named(NULL, 0, "tc_contexts_setup");
+	g_backend_inits = 0;
+
+	g_mstore_ctx = talloc_zero(g_mem_ctx, struct mapistore_context);
+	g_mstore_ctx->processing_ctx = talloc_zero(g_mstore_ctx, struct processing_context);
+	ck_assert_int_eq(mapistore_init_context_registry(g_mstore_ctx->processing_ctx), MAPISTORE_SUCCESS);
+}
+
+static void tc_contexts_teardown(void)
+{
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapistore_contexts_suite(void)
+{
+	Suite *s = suite_create("libmapistore contexts");
+
+	TCase *tc = tcase_create("context registry");
+	tcase_add_checked_fixture(tc, tc_contexts_setup, tc_contexts_teardown);
+
+	tcase_add_test(tc, test_context_id_allocation);
+	tcase_add_test(tc, test_lookup);
+	tcase_add_test(tc, test_backend_context_count);
+	tcase_add_test(tc, test_backend_init_reset);
+
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create("context registry performance");
+		tcase_add_checked_fixture(tc_perf, tc_contexts_setup, tc_contexts_teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_lookup);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
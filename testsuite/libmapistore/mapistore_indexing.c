@@ -26,6 +26,7 @@
 #include "mapiproxy/libmapistore/mapistore_private.h"
 #include "mapiproxy/libmapistore/backends/indexing_tdb.h"
 #include "mapiproxy/util/mysql.h"
+#include <time.h>
 
 #undef MAPISTORE_LDIF
 #define MAPISTORE_LDIF "setup/mapistore"
@@ -44,6 +45,13 @@
 #define INDEXING_EXIST_FMID	0xEEEE
 #define INDEXING_EXIST_URL	"idxtest://existing_url"
 
+#define INDEXING_BENCH_RECORDS	1000000
+#define INDEXING_BENCH_FOLDERS	1000
+
+#define INDEXING_TEST_CN_FID	0x10001
+#define INDEXING_TEST_CN_FID_2	0x20001
+#define INDEXING_BENCH_MESSAGES	100000
+
 /* Global test variables */
 static struct mapistore_context	*g_mstore_ctx = NULL;
 static struct indexing_context	*g_ictx = NULL;
@@ -434,6 +442,69 @@ START_TEST(test_get_fmid_with_wildcard) {
 } END_TEST
 
 
+START_TEST(test_get_fmid_with_wildcard_folder) {
+	enum mapistore_error	ret;
+	uint64_t		fid_1, fid_2;
+	uint64_t		fmid_res;
+	bool			soft_deleted = true;
+
+	fid_1 = INDEXING_TEST_FMID;
+	fid_2 = fid_1 + 1;
+	ret = g_ictx->add_fmid(g_ictx, g_test_username, fid_1, "foo://bar/f1/m1.eml");
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->add_fmid(g_ictx, g_test_username, fid_2, "foo://bar/f2/m2.eml");
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "foo://bar/*/m2.eml", true, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(!soft_deleted);
+	ck_assert_int_eq(fmid_res, fid_2);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "foo://baz/*/m2.eml", true, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+} END_TEST
+
+START_TEST(test_get_fmid_after_update) {
+	enum mapistore_error	ret;
+	uint64_t		fmid_res;
+	bool			soft_deleted = true;
+
+	ret = g_ictx->add_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, INDEXING_TEST_URI);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->update_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, INDEXING_TEST_URI_2);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI_2, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(!soft_deleted);
+	ck_assert(fmid_res == INDEXING_TEST_FMID);
+} END_TEST
+
+START_TEST(test_get_fmid_after_delete) {
+	enum mapistore_error	ret;
+	uint64_t		fmid_res;
+	bool			soft_deleted = false;
+
+	ret = g_ictx->add_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, INDEXING_TEST_URI);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+
+	ret = g_ictx->del_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, MAPISTORE_SOFT_DELETE);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(soft_deleted);
+	ck_assert(fmid_res == INDEXING_TEST_FMID);
+
+	ret = g_ictx->del_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, MAPISTORE_PERMANENT_DELETE);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+} END_TEST
+
+
 /* allocate_fmid */
 
 START_TEST (test_allocate_fmid) {
@@ -450,6 +521,489 @@ START_TEST (test_allocate_fmid) {
 	ck_assert(fmid1 != fmid2);
 } END_TEST
 
+
+/* change number index */
+
+static void cn_index_make_ready(uint64_t fid, enum mapistore_table_type table_type)
+{
+	enum mapistore_error	ret;
+	uint32_t		generation = 0;
+
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, fid, table_type,
+					 MAPISTORE_CN_INDEX_SEEDING, &generation);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, fid, table_type,
+					 MAPISTORE_CN_INDEX_READY, &generation);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+}
+
+static void cn_index_set(uint64_t fid, enum mapistore_table_type table_type, uint64_t mid, uint64_t cn)
+{
+	enum mapistore_error	ret;
+
+	ret = g_ictx->set_cns(g_ictx, g_test_username, fid, table_type, 1, &mid, &cn);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+}
+
+static struct UI8Array_r *cn_index_changes(TALLOC_CTX *mem_ctx, uint64_t fid,
+					   enum mapistore_table_type table_type, uint64_t cn)
+{
+	enum mapistore_error	ret;
+	struct UI8Array_r	*mids = NULL;
+
+	ret = g_ictx->get_changes(g_ictx, g_test_username, mem_ctx, fid, table_type, cn, &mids);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(mids != NULL);
+
+	return mids;
+}
+
+START_TEST(test_cn_index_sanity) {
+	enum mapistore_error	ret;
+	struct UI8Array_r	*mids;
+	uint64_t		mid = 1, cn = 0x10001;
+	uint32_t		generation;
+
+	ret = g_ictx->set_cns(NULL, g_test_username, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 1, &mid, &cn);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_INITIALIZED);
+	ret = g_ictx->set_cns(g_ictx, NULL, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 1, &mid, &cn);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_INVALID_PARAMETER);
+	ret = g_ictx->set_cns(g_ictx, g_test_username, 0, MAPISTORE_MESSAGE_TABLE, 1, &mid, &cn);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	ret = g_ictx->del_cn(g_ictx, g_test_username, 0);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_READY + 1, &generation);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	ret = g_ictx->get_changes(g_ictx, g_test_username, g_mstore_ctx, INDEXING_TEST_CN_FID,
+				  MAPISTORE_MESSAGE_TABLE, 0, NULL);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_INVALID_PARAMETER);
+	ret = g_ictx->get_changes(g_ictx, g_test_username, g_mstore_ctx, 0,
+				  MAPISTORE_MESSAGE_TABLE, 0, &mids);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_INVALID_PARAMETER);
+} END_TEST
+
+START_TEST(test_cn_index_not_indexed) {
+	enum mapistore_error	ret;
+	struct UI8Array_r	*mids;
+	uint32_t		generation;
+
+	ret = g_ictx->get_changes(g_ictx, g_test_username, g_mstore_ctx, INDEXING_TEST_CN_FID,
+				  MAPISTORE_MESSAGE_TABLE, 0, &mids);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+
+	/* Changes to a table which isn't indexed are ignored */
+	cn_index_set(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 1, 0x10001);
+
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_SEEDING, &generation);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->get_changes(g_ictx, g_test_username, g_mstore_ctx, INDEXING_TEST_CN_FID,
+				  MAPISTORE_MESSAGE_TABLE, 0, &mids);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_READY, &generation);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0);
+	ck_assert_int_eq(mids->cValues, 0);
+
+	/* Only a seeding table can become ready */
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID_2,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_READY, NULL);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+} END_TEST
+
+START_TEST(test_cn_index_seeding) {
+	enum mapistore_error	ret;
+	struct UI8Array_r	*mids;
+	uint64_t		seed_mids[] = { 1, 2, 3 };
+	uint64_t		seed_cns[] = { 0x30001, 0x10001, 0x20001 };
+	uint32_t		generation;
+
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_SEEDING, &generation);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->set_cns(g_ictx, g_test_username, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE,
+			      3, seed_mids, seed_cns);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_READY, &generation);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+
+	/* Changes come in change number order */
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0);
+	ck_assert_int_eq(mids->cValues, 3);
+	ck_assert(mids->lpui8[0] == 2);
+	ck_assert(mids->lpui8[1] == 3);
+	ck_assert(mids->lpui8[2] == 1);
+
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0x10001);
+	ck_assert_int_eq(mids->cValues, 2);
+	ck_assert(mids->lpui8[0] == 3);
+	ck_assert(mids->lpui8[1] == 1);
+
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0x30001);
+	ck_assert_int_eq(mids->cValues, 0);
+
+	/* The FAI table has its own index */
+	ret = g_ictx->get_changes(g_ictx, g_test_username, g_mstore_ctx, INDEXING_TEST_CN_FID,
+				  MAPISTORE_FAI_TABLE, 0, &mids);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+} END_TEST
+
+START_TEST(test_cn_index_generation) {
+	enum mapistore_error	ret;
+	uint32_t		first, second;
+
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_SEEDING, &first);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_SEEDING, &second);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(first != second);
+
+	/* The first seeding was started again, it can't complete */
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_READY, &first);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+
+	/* A drop doesn't start the generations over */
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_NONE, NULL);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_SEEDING, &first);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(first != second);
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_READY, &second);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_READY, &first);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_READY, &first);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+} END_TEST
+
+START_TEST(test_cn_index_update) {
+	enum mapistore_error	ret;
+	struct UI8Array_r	*mids;
+
+	cn_index_make_ready(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE);
+	cn_index_set(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 1, 0x10001);
+	cn_index_set(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 2, 0x20001);
+	cn_index_set(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 1, 0x30001);
+
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0);
+	ck_assert_int_eq(mids->cValues, 2);
+	ck_assert(mids->lpui8[0] == 2);
+	ck_assert(mids->lpui8[1] == 1);
+
+	/* A change number never goes back within a folder */
+	cn_index_set(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 1, 0x5);
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0x20001);
+	ck_assert_int_eq(mids->cValues, 1);
+	ck_assert(mids->lpui8[0] == 1);
+
+	ret = g_ictx->del_cn(g_ictx, g_test_username, 2);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->del_cn(g_ictx, g_test_username, 0x4242);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0);
+	ck_assert_int_eq(mids->cValues, 1);
+	ck_assert(mids->lpui8[0] == 1);
+} END_TEST
+
+START_TEST(test_cn_index_move) {
+	struct UI8Array_r	*mids;
+
+	cn_index_make_ready(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE);
+	cn_index_make_ready(INDEXING_TEST_CN_FID_2, MAPISTORE_MESSAGE_TABLE);
+	cn_index_set(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 1, 0x20001);
+	cn_index_set(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 2, 0x30001);
+
+	/* The message moves along with its new change number */
+	cn_index_set(INDEXING_TEST_CN_FID_2, MAPISTORE_MESSAGE_TABLE, 1, 0x10001);
+
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0);
+	ck_assert_int_eq(mids->cValues, 1);
+	ck_assert(mids->lpui8[0] == 2);
+
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID_2, MAPISTORE_MESSAGE_TABLE, 0);
+	ck_assert_int_eq(mids->cValues, 1);
+	ck_assert(mids->lpui8[0] == 1);
+} END_TEST
+
+START_TEST(test_cn_index_drop) {
+	enum mapistore_error	ret;
+	struct UI8Array_r	*mids;
+
+	cn_index_make_ready(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE);
+	cn_index_set(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 1, 0x10001);
+
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_NONE, NULL);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->get_changes(g_ictx, g_test_username, g_mstore_ctx, INDEXING_TEST_CN_FID,
+				  MAPISTORE_MESSAGE_TABLE, 0, &mids);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+
+	/* The entries went away with the index */
+	cn_index_make_ready(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE);
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0);
+	ck_assert_int_eq(mids->cValues, 0);
+
+	/* The message can be indexed again elsewhere */
+	cn_index_make_ready(INDEXING_TEST_CN_FID_2, MAPISTORE_MESSAGE_TABLE);
+	cn_index_set(INDEXING_TEST_CN_FID_2, MAPISTORE_MESSAGE_TABLE, 1, 0x10001);
+	mids = cn_index_changes(g_mstore_ctx, INDEXING_TEST_CN_FID_2, MAPISTORE_MESSAGE_TABLE, 0);
+	ck_assert_int_eq(mids->cValues, 1);
+} END_TEST
+
+/* TDB reverse index */
+
+static char *tdb_indexing_path(TALLOC_CTX *mem_ctx)
+{
+	char	*dir;
+
+	dir = talloc_asprintf(mem_ctx, "%s%s", mapistore_get_mapping_path(), g_test_username);
+	mkdir(dir, 0700);
+
+	return talloc_asprintf(mem_ctx, "%s/indexing.tdb", dir);
+}
+
+/* Create an indexing database the way it was stored before the
+   reverse index was introduced */
+static void tdb_populate_legacy(uint32_t count)
+{
+	TALLOC_CTX		*mem_ctx;
+	struct tdb_context	*tdb;
+	TDB_DATA		key;
+	TDB_DATA		dbuf;
+	uint32_t		i;
+
+	mem_ctx = talloc_named(NULL, 0, "tdb_populate_legacy");
+	tdb = tdb_open(tdb_indexing_path(mem_ctx), MAPISTORE_INDEXING_HASH_SIZE, TDB_NOSYNC,
+		       O_RDWR|O_CREAT, 0600);
+	ck_assert(tdb != NULL);
+	ck_assert_int_eq(tdb_transaction_start(tdb), 0);
+
+	for (i = 1; i <= count; i++) {
+		key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s0x%.16"PRIx64,
+							     (i % 100) ? "" : MAPISTORE_SOFT_DELETED_TAG,
+							     (uint64_t) i);
+		key.dsize = strlen((const char *) key.dptr);
+		dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "bench://%s/folder%u/message%u.eml/",
+							      g_test_username, i % INDEXING_BENCH_FOLDERS, i);
+		dbuf.dsize = strlen((const char *) dbuf.dptr);
+		ck_assert_int_eq(tdb_store(tdb, key, dbuf, TDB_INSERT), 0);
+		talloc_free(key.dptr);
+		talloc_free(dbuf.dptr);
+	}
+
+	ck_assert_int_eq(tdb_transaction_commit(tdb), 0);
+	tdb_close(tdb);
+	talloc_free(mem_ctx);
+}
+
+static void tdb_legacy_setup(void)
+{
+	enum mapistore_error	retval;
+
+	retval = mapistore_set_mapping_path("/tmp/");
+	ck_assert(retval == MAPISTORE_SUCCESS);
+
+	g_mstore_ctx = talloc_zero(NULL, struct mapistore_context);
+	ck_assert(g_mstore_ctx != NULL);
+	unlink(tdb_indexing_path(g_mstore_ctx));
+	g_ictx = NULL;
+}
+
+START_TEST(test_tdb_migration) {
+	enum mapistore_error	ret;
+	uint64_t		fmid_res;
+	bool			soft_deleted;
+
+	tdb_populate_legacy(200);
+	ret = mapistore_indexing_tdb_init(g_mstore_ctx, g_test_username, &g_ictx);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+
+	/* Stored with a trailing slash, looked up with or without it */
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "bench://testuser/folder42/message42.eml",
+			       false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(!soft_deleted);
+	ck_assert(fmid_res == 42);
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "bench://testuser/folder42/message42.eml/",
+			       false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(fmid_res == 42);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "bench://testuser/*/message100.eml",
+			       true, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(soft_deleted);
+	ck_assert(fmid_res == 100);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "bench://testuser/folder7/*",
+			       true, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(fmid_res == 7);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "bench://testuser/folder1/message201.eml",
+			       false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+
+	/* The index is kept up to date once the database is reopened */
+	talloc_free(g_ictx);
+	ret = mapistore_indexing_tdb_init(g_mstore_ctx, g_test_username, &g_ictx);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->del_fmid(g_ictx, g_test_username, 42, MAPISTORE_PERMANENT_DELETE);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "bench://testuser/*/message42.eml",
+			       true, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+} END_TEST
+
+START_TEST(test_tdb_benchmark_1m) {
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	ret;
+	struct timespec		start;
+	double			migrate_ms, exact_ms, partial_ms, scan_ms;
+	uint64_t		fmid_res;
+	bool			soft_deleted;
+	char			*uri;
+	uint32_t		i, id;
+
+	mem_ctx = talloc_named(NULL, 0, "test_tdb_benchmark_1m");
+	tdb_populate_legacy(INDEXING_BENCH_RECORDS);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = mapistore_indexing_tdb_init(g_mstore_ctx, g_test_username, &g_ictx);
+	migrate_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < 100000; i++) {
+		id = 1 + (i * 7919) % INDEXING_BENCH_RECORDS;
+		uri = talloc_asprintf(mem_ctx, "bench://%s/folder%u/message%u.eml",
+				      g_test_username, id % INDEXING_BENCH_FOLDERS, id);
+		ret = g_ictx->get_fmid(g_ictx, g_test_username, uri, false, &fmid_res, &soft_deleted);
+		ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+		ck_assert(fmid_res == id);
+		talloc_free(uri);
+	}
+	exact_ms = testsuite_elapsed_ms(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < 100000; i++) {
+		id = 1 + (i * 104729) % INDEXING_BENCH_RECORDS;
+		uri = talloc_asprintf(mem_ctx, "bench://%s/*/message%u.eml", g_test_username, id);
+		ret = g_ictx->get_fmid(g_ictx, g_test_username, uri, true, &fmid_res, &soft_deleted);
+		ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+		ck_assert(fmid_res == id);
+		talloc_free(uri);
+	}
+	partial_ms = testsuite_elapsed_ms(&start);
+
+	/* Patterns the index can't resolve still walk the database */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "bench://*.missing",
+			       true, &fmid_res, &soft_deleted);
+	scan_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+
+	testsuite_benchmark_report("indexing TDB %u records: migration %.2fms, 100000 exact lookups %.2fms, "
+	                           "100000 partial lookups %.2fms, full scan %.2fms\n",
+	                           INDEXING_BENCH_RECORDS, migrate_ms, exact_ms, partial_ms, scan_ms);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
+START_TEST(test_tdb_benchmark_cn_index) {
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	ret;
+	struct timespec		start;
+	double			seed_ms, nochange_ms, full_ms, update_ms;
+	struct UI8Array_r	*mids;
+	uint64_t		*seed_mids, *seed_cns;
+	uint64_t		max_cn;
+	uint32_t		generation;
+	uint32_t		i, batch;
+
+	mem_ctx = talloc_named(NULL, 0, "test_tdb_benchmark_cn_index");
+	seed_mids = talloc_array(mem_ctx, uint64_t, INDEXING_BENCH_MESSAGES);
+	seed_cns = talloc_array(mem_ctx, uint64_t, INDEXING_BENCH_MESSAGES);
+	for (i = 0; i < INDEXING_BENCH_MESSAGES; i++) {
+		seed_mids[i] = ((uint64_t) (i + 1) << 16) | 1;
+		/* table order isn't change number order */
+		seed_cns[i] = ((uint64_t) (1 + (i * 7919) % INDEXING_BENCH_MESSAGES) << 16) | 1;
+	}
+	max_cn = ((uint64_t) INDEXING_BENCH_MESSAGES << 16) | 1;
+
+	/* Seeding, one table window at a time */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_SEEDING, &generation);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	for (i = 0; i < INDEXING_BENCH_MESSAGES; i += batch) {
+		batch = INDEXING_BENCH_MESSAGES - i;
+		if (batch > 150) batch = 150;
+		ret = g_ictx->set_cns(g_ictx, g_test_username, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE,
+				      batch, seed_mids + i, seed_cns + i);
+		ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	}
+	ret = g_ictx->set_cn_index_state(g_ictx, g_test_username, INDEXING_TEST_CN_FID,
+					 MAPISTORE_MESSAGE_TABLE, MAPISTORE_CN_INDEX_READY, &generation);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	seed_ms = testsuite_elapsed_ms(&start);
+
+	/* A synchronization without changes has no message to look at */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < 1000; i++) {
+		mids = cn_index_changes(mem_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, max_cn);
+		ck_assert_int_eq(mids->cValues, 0);
+		talloc_free(mids);
+	}
+	nochange_ms = testsuite_elapsed_ms(&start);
+
+	/* Listing the whole folder, what an unindexed synchronization walks */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	mids = cn_index_changes(mem_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, 0);
+	full_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(mids->cValues, INDEXING_BENCH_MESSAGES);
+	for (i = 1; i < mids->cValues; i++) {
+		ck_assert(mids->lpui8[i] != mids->lpui8[i - 1]);
+	}
+	talloc_free(mids);
+
+	/* Saving messages */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < 100; i++) {
+		cn_index_set(INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, seed_mids[i * 997], max_cn + ((i + 1) << 16));
+	}
+	update_ms = testsuite_elapsed_ms(&start);
+
+	mids = cn_index_changes(mem_ctx, INDEXING_TEST_CN_FID, MAPISTORE_MESSAGE_TABLE, max_cn);
+	ck_assert_int_eq(mids->cValues, 100);
+	ck_assert(mids->lpui8[0] == seed_mids[0]);
+	ck_assert(mids->lpui8[99] == seed_mids[99 * 997]);
+
+	testsuite_benchmark_report("indexing TDB change numbers, %u messages: seeding %.2fms, 1000 synchronizations without "
+	                           "changes %.2fms, full listing %.2fms, 100 saves %.2fms\n",
+	                           INDEXING_BENCH_MESSAGES, seed_ms, nochange_ms, full_ms, update_ms);
+
+	talloc_free(mem_ctx);
+} END_TEST
+
 // ^ unit tests ---------------------------------------------------------------
 
 // v suite definition ---------------------------------------------------------
@@ -541,7 +1095,17 @@ static TCase *create_test_case_indexing_interface(const char *name, SFun setup,
 	tcase_add_test(tc_interface, test_get_fmid_sanity);
 	tcase_add_test(tc_interface, test_get_fmid);
 	tcase_add_test(tc_interface, test_get_fmid_with_wildcard);
+	tcase_add_test(tc_interface, test_get_fmid_with_wildcard_folder);
+	tcase_add_test(tc_interface, test_get_fmid_after_update);
+	tcase_add_test(tc_interface, test_get_fmid_after_delete);
 	tcase_add_test(tc_interface, test_allocate_fmid);
+	tcase_add_test(tc_interface, test_cn_index_sanity);
+	tcase_add_test(tc_interface, test_cn_index_not_indexed);
+	tcase_add_test(tc_interface, test_cn_index_seeding);
+	tcase_add_test(tc_interface, test_cn_index_generation);
+	tcase_add_test(tc_interface, test_cn_index_update);
+	tcase_add_test(tc_interface, test_cn_index_move);
+	tcase_add_test(tc_interface, test_cn_index_drop);
 
 	return tc_interface;
 }
@@ -576,11 +1140,33 @@ Suite *mapistore_indexing_tdb_suite(void)
 {
 	Suite *s;
 	TCase *tc_interface;
+	TCase *tc_index;
+	TCase *tc_perf;
+	TCase *tc_cn_perf;
 
 	s = suite_create("libmapistore indexing: TDB backend");
 
 	tc_interface = create_test_case_indexing_interface("TDB", tdb_setup, tdb_teardown);
 	suite_add_tcase(s, tc_interface);
 
+	tc_index = tcase_create("indexing: TDB reverse index");
+	tcase_add_checked_fixture(tc_index, tdb_legacy_setup, tdb_teardown);
+	tcase_add_test(tc_index, test_tdb_migration);
+	suite_add_tcase(s, tc_index);
+
+	if (testsuite_benchmarks_enabled()) {
+		tc_perf = tcase_create("indexing: TDB reverse index performance");
+		tcase_add_checked_fixture(tc_perf, tdb_legacy_setup, tdb_teardown);
+		tcase_set_timeout(tc_perf, 600);
+		tcase_add_test(tc_perf, test_tdb_benchmark_1m);
+		suite_add_tcase(s, tc_perf);
+
+		tc_cn_perf = tcase_create("indexing: TDB change number index performance");
+		tcase_add_checked_fixture(tc_cn_perf, tdb_setup, tdb_teardown);
+		tcase_set_timeout(tc_cn_perf, 600);
+		tcase_add_test(tc_cn_perf, test_tdb_benchmark_cn_index);
+		suite_add_tcase(s, tc_cn_perf);
+	}
+
 	return s;
 }
@@ -0,0 +1,374 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+#include <time.h>
+
+#define	BENCHMARK_USERS			500
+#define	BENCHMARK_FOLDERS		100
+#define	BENCHMARK_SUBSCRIPTIONS		(BENCHMARK_USERS * BENCHMARK_FOLDERS)
+#define	BENCHMARK_EVENTS		100000
+#define	BENCHMARK_SCAN_EVENTS		1000
+
+/* Global test variables */
+static TALLOC_CTX				*g_mem_ctx;
+static struct mapistore_notification_stats	g_stats;
+
+
+static struct mapistore_context *new_session(const char *username, uint32_t queue_max)
+{
+	struct mapistore_context	*mstore_ctx;
+
+	mstore_ctx = talloc_zero(g_mem_ctx, struct mapistore_context);
+	mstore_ctx->conn_info = talloc_zero(mstore_ctx, struct mapistore_connection_info);
+	mstore_ctx->conn_info->mstore_ctx = mstore_ctx;
+	mstore_ctx->conn_info->username = talloc_strdup(mstore_ctx->conn_info, username);
+	mstore_ctx->notifications_max = queue_max;
+
+	return mstore_ctx;
+}
+
+static struct mapistore_subscription *subscribe_object(struct mapistore_context *mstore_ctx, uint32_t handle,
+						       uint16_t types, bool whole_store, uint64_t fid, uint64_t mid)
+{
+	struct mapistore_subscription_list		*el;
+	struct mapistore_object_subscription_parameters	parameters;
+
+	parameters.whole_store = whole_store;
+	parameters.folder_id = fid;
+	parameters.object_id = mid;
+
+	el = talloc_zero(mstore_ctx, struct mapistore_subscription_list);
+	el->subscription = mapistore_new_subscription(el, mstore_ctx, mstore_ctx->conn_info->username,
+						      handle, types, &parameters);
+	ck_assert(el->subscription != NULL);
+	DLIST_ADD(mstore_ctx->subscriptions, el);
+
+	return el->subscription;
+}
+
+static struct mapistore_subscription *subscribe_table(struct mapistore_context *mstore_ctx, uint32_t handle,
+						      uint8_t table_type, uint64_t fid)
+{
+	struct mapistore_subscription_list		*el;
+	struct mapistore_table_subscription_parameters	parameters;
+
+	parameters.table_type = table_type;
+	parameters.folder_id = fid;
+
+	el = talloc_zero(mstore_ctx, struct mapistore_subscription_list);
+	el->subscription = mapistore_new_subscription(el, mstore_ctx, mstore_ctx->conn_info->username,
+						      handle, fnevTableModified, &parameters);
+	ck_assert(el->subscription != NULL);
+	DLIST_ADD(mstore_ctx->subscriptions, el);
+
+	return el->subscription;
+}
+
+static void push_object(struct mapistore_context *mstore_ctx, uint8_t object_type,
+			enum mapistore_notification_type event, uint64_t fid, uint64_t mid)
+{
+	struct mapistore_object_notification_parameters	parameters;
+
+	memset(&parameters, 0, sizeof (struct mapistore_object_notification_parameters));
+	parameters.folder_id = fid;
+	parameters.object_id = mid;
+	mapistore_push_notification(mstore_ctx, object_type, event, &parameters);
+}
+
+/* Dequeue the next notification of a session and check which
+   subscription it was queued for */
+static void check_next(struct mapistore_context *mstore_ctx, uint32_t handle, uint64_t mid)
+{
+	struct mapistore_notification_list	*nl;
+
+	nl = mapistore_dequeue_notification(g_mem_ctx, mstore_ctx);
+	ck_assert(nl != NULL);
+	ck_assert_int_eq(nl->handle, handle);
+	ck_assert_int_eq(nl->notification->parameters.object_parameters.object_id, mid);
+	talloc_free(nl);
+}
+
+static void check_stats(uint32_t subscriptions, uint32_t buckets, uint64_t deliveries, uint64_t dropped)
+{
+	struct mapistore_notification_stats	stats;
+
+	ck_assert_int_eq(mapistore_notification_get_stats(&stats), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(stats.subscriptions, subscriptions);
+	ck_assert_int_eq(stats.buckets, buckets);
+	ck_assert_int_eq(stats.deliveries - g_stats.deliveries, deliveries);
+	ck_assert_int_eq(stats.dropped - g_stats.dropped, dropped);
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_object_matching) {
+	struct mapistore_context	*session1;
+	struct mapistore_context	*session2;
+	struct mapistore_context	*other;
+
+	session1 = new_session("alice", 0);
+	session2 = new_session("alice", 0);
+	other = new_session("bob", 0);
+
+	subscribe_object(session1, 1, fnevObjectCreated|fnevObjectModified, false, 0x100, 0);
+	subscribe_object(session2, 2, fnevNewMail, true, 0, 0);
+	subscribe_object(session2, 3, fnevObjectModified, false, 0x100, 0x200);
+	subscribe_object(other, 4, 0xfffe, true, 0, 0);
+	check_stats(4, 4, 0, 0);
+
+	/* Folder events match the subscriptions on the folder */
+	push_object(session1, MAPISTORE_FOLDER, MAPISTORE_OBJECT_MODIFIED, 0x1, 0x100);
+	push_object(session1, MAPISTORE_FOLDER, MAPISTORE_OBJECT_DELETED, 0x1, 0x100);
+	ck_assert_int_eq(session1->notifications_count, 1);
+	check_next(session1, 1, 0x100);
+
+	/* Message events are delivered to every session of the owner */
+	push_object(session1, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_MODIFIED, 0x100, 0x200);
+	push_object(session1, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_MODIFIED, 0x100, 0x201);
+	push_object(session2, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_NEWMAIL, 0x100, 0x202);
+	ck_assert_int_eq(session1->notifications_count, 2);
+	ck_assert_int_eq(session2->notifications_count, 2);
+	check_next(session1, 1, 0x200);
+	check_next(session1, 1, 0x201);
+	check_next(session2, 3, 0x200);
+	check_next(session2, 2, 0x202);
+
+	ck_assert(mapistore_dequeue_notification(g_mem_ctx, session1) == NULL);
+	ck_assert(mapistore_dequeue_notification(g_mem_ctx, session2) == NULL);
+	ck_assert(other->notifications == NULL);
+	check_stats(4, 4, 5, 0);
+} END_TEST
+
+START_TEST (test_table_matching) {
+	struct mapistore_context			*session1;
+	struct mapistore_context			*session2;
+	struct mapistore_table_notification_parameters	parameters;
+	struct mapistore_notification			notification;
+	struct mapistore_subscription_list		*matches;
+
+	session1 = new_session("alice", 0);
+	session2 = new_session("alice", 0);
+
+	/* Handles are allocated per session */
+	subscribe_table(session1, 10, MAPISTORE_FOLDER_TABLE, 0x100);
+	subscribe_table(session2, 10, MAPISTORE_FOLDER_TABLE, 0x100);
+	subscribe_table(session1, 11, MAPISTORE_MESSAGE_TABLE, 0x100);
+	check_stats(3, 1, 0, 0);
+
+	memset(&parameters, 0, sizeof (struct mapistore_table_notification_parameters));
+	parameters.table_type = MAPISTORE_FOLDER_TABLE;
+	parameters.handle = 10;
+	parameters.folder_id = 0x100;
+	parameters.object_id = 0x300;
+	mapistore_push_notification(session1, MAPISTORE_TABLE, MAPISTORE_OBJECT_CREATED, &parameters);
+	ck_assert_int_eq(session1->notifications_count, 1);
+	ck_assert_int_eq(session1->notifications->handle, 10);
+	ck_assert(session2->notifications == NULL);
+
+	/* The table type is part of the match */
+	parameters.table_type = MAPISTORE_MESSAGE_TABLE;
+	mapistore_push_notification(session1, MAPISTORE_TABLE, MAPISTORE_OBJECT_CREATED, &parameters);
+	ck_assert_int_eq(session1->notifications_count, 1);
+
+	notification = *session1->notifications->notification;
+	matches = mapistore_find_matching_subscriptions(session1, &notification);
+	ck_assert(matches != NULL);
+	ck_assert_int_eq(matches->subscription->handle, 10);
+	ck_assert(matches->next == NULL);
+	check_stats(3, 1, 1, 0);
+} END_TEST
+
+START_TEST (test_queue_bound) {
+	struct mapistore_context	*session;
+	uint32_t			i;
+
+	session = new_session("alice", 4);
+	subscribe_object(session, 1, fnevObjectCreated, true, 0, 0);
+
+	for (i = 0; i < 6; i++) {
+		push_object(session, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_CREATED, 0x100, 0x200 + i);
+	}
+	ck_assert_int_eq(session->notifications_count, 4);
+	check_stats(1, 1, 4, 2);
+
+	/* Oldest first, the last ones were dropped */
+	check_next(session, 1, 0x200);
+	push_object(session, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_CREATED, 0x100, 0x206);
+	for (i = 1; i < 4; i++) {
+		check_next(session, 1, 0x200 + i);
+	}
+	check_next(session, 1, 0x206);
+	ck_assert_int_eq(session->notifications_count, 0);
+} END_TEST
+
+START_TEST (test_release) {
+	struct mapistore_context		*session;
+	struct mapistore_subscription		*s2;
+	struct mapistore_notification_list	*nl;
+
+	session = new_session("alice", 0);
+	subscribe_object(session, 1, fnevObjectDeleted, false, 0x100, 0);
+	s2 = subscribe_object(session, 2, fnevObjectDeleted, false, 0x100, 0);
+	push_object(session, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_DELETED, 0x100, 0x200);
+	push_object(session, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_DELETED, 0x100, 0x201);
+	ck_assert_int_eq(session->notifications_count, 4);
+	check_stats(2, 1, 4, 0);
+
+	ck_assert_int_eq(mapistore_get_queued_notifications(session, s2, &nl), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(nl->handle, 2);
+	ck_assert_int_eq(nl->next->handle, 2);
+	ck_assert(nl->next->next == NULL);
+	ck_assert_int_eq(session->notifications_count, 2);
+	talloc_free(nl);
+	ck_assert_int_eq(mapistore_get_queued_notifications(session, s2, &nl), MAPISTORE_ERR_NOT_FOUND);
+
+	/* Deleting a subscription discards its pending notifications */
+	ck_assert_int_eq(mapistore_delete_subscription(session, 1, fnevObjectDeleted), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(session->notifications_count, 0);
+	ck_assert(session->notifications == NULL);
+	check_stats(1, 1, 4, 0);
+
+	/* So does releasing the session */
+	push_object(session, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_DELETED, 0x100, 0x202);
+	talloc_free(session);
+	check_stats(0, 0, 5, 0);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v Performance test ----------------------------------------------------------
+
+/* What matching used to cost: check every subscription of the process */
+static uint32_t scan_subscriptions(struct mapistore_subscription **subscriptions, uint32_t count,
+				   const char *owner, uint64_t fid)
+{
+	struct mapistore_object_subscription_parameters	*parameters;
+	uint32_t					i;
+	uint32_t					matches = 0;
+
+	for (i = 0; i < count; i++) {
+		parameters = &subscriptions[i]->parameters.object_parameters;
+		if ((subscriptions[i]->notification_types & fnevObjectModified)
+		    && (parameters->whole_store || parameters->folder_id == fid)
+		    && !strcmp(subscriptions[i]->owner, owner)) {
+			matches++;
+		}
+	}
+
+	return matches;
+}
+
+START_TEST (test_benchmark_dispatch) {
+	struct mapistore_context		*sessions[BENCHMARK_USERS];
+	struct mapistore_subscription		**subscriptions;
+	struct timespec				start;
+	char					username[32];
+	uint32_t				i, j, user, folder;
+	uint32_t				matches = 0;
+	double					register_ms, dispatch_ms, scan_ms;
+
+	subscriptions = talloc_array(g_mem_ctx, struct mapistore_subscription *, BENCHMARK_SUBSCRIPTIONS);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_USERS; i++) {
+		snprintf(username, sizeof (username), "user%u", i);
+		sessions[i] = new_session(username, 0);
+		for (j = 0; j < BENCHMARK_FOLDERS; j++) {
+			subscriptions[i * BENCHMARK_FOLDERS + j] = subscribe_object(sessions[i], j + 1,
+										    fnevObjectModified|fnevObjectDeleted,
+										    false, 0x1000 + j, 0);
+		}
+	}
+	register_ms = testsuite_elapsed_ms(&start);
+	check_stats(BENCHMARK_SUBSCRIPTIONS, BENCHMARK_SUBSCRIPTIONS, 0, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_EVENTS; i++) {
+		user = (i * 7919) % BENCHMARK_USERS;
+		folder = (i * 104729) % BENCHMARK_FOLDERS;
+		push_object(sessions[user], MAPISTORE_MESSAGE, MAPISTORE_OBJECT_MODIFIED, 0x1000 + folder, i + 1);
+		talloc_free(mapistore_dequeue_notification(g_mem_ctx, sessions[user]));
+	}
+	dispatch_ms = testsuite_elapsed_ms(&start);
+	check_stats(BENCHMARK_SUBSCRIPTIONS, BENCHMARK_SUBSCRIPTIONS, BENCHMARK_EVENTS, 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_SCAN_EVENTS; i++) {
+		user = (i * 7919) % BENCHMARK_USERS;
+		folder = (i * 104729) % BENCHMARK_FOLDERS;
+		matches += scan_subscriptions(subscriptions, BENCHMARK_SUBSCRIPTIONS,
+					      sessions[user]->conn_info->username, 0x1000 + folder);
+	}
+	scan_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(matches, BENCHMARK_SCAN_EVENTS);
+
+	testsuite_benchmark_report("%u subscriptions registered in %.1f ms, dispatch: indexed %.0f ns/event, list walk %.0f ns/event\n",
+	                           BENCHMARK_SUBSCRIPTIONS, register_ms, dispatch_ms * 1000000.0 / BENCHMARK_EVENTS,
+	                           scan_ms * 1000000.0 / BENCHMARK_SCAN_EVENTS);
+
+	for (i = 0; i < BENCHMARK_USERS; i++) {
+		talloc_free(sessions[i]);
+	}
+	check_stats(0, 0, BENCHMARK_EVENTS, 0);
+} END_TEST
+
+// ^ performance tests ---------------------------------------------------------
+
+static void tc_notification_setup(void)
+{
+	g_mem_ctx = talloc_named(NULL, 0, "tc_notification_setup");
+	ck_assert_int_eq(mapistore_notification_get_stats(&g_stats), MAPISTORE_SUCCESS);
+}
+
+static void tc_notification_teardown(void)
+{
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapistore_notification_suite(void)
+{
+	Suite *s = suite_create("libmapistore notifications");
+
+	TCase *tc = tcase_create("notification engine");
+	tcase_add_checked_fixture(tc, tc_notification_setup, tc_notification_teardown);
+
+	tcase_add_test(tc, test_object_matching);
+	tcase_add_test(tc, test_table_matching);
+	tcase_add_test(tc, test_queue_bound);
+	tcase_add_test(tc, test_release);
+
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create("notification engine performance");
+		tcase_add_checked_fixture(tc_perf, tc_notification_setup, tc_notification_teardown);
+		tcase_set_timeout(tc_perf, 600);
+		tcase_add_test(tc_perf, test_benchmark_dispatch);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
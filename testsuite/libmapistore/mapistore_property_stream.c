@@ -0,0 +1,469 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+#include <time.h>
+
+#define	STREAM_CONTEXT_ID	0x42
+#define	DEFAULTS_CONTEXT_ID	0x43
+#define	RELEASE_CONTEXT_ID	0x44
+#define	ATTACHMENT_SIZE		(40 * 1024 * 1024)
+#define	SMALL_SIZE		(3 * MAPISTORE_STREAM_CHUNK_SIZE + 123)
+#define	READSTREAM_SIZE		0xFFF0
+#define	SESSIONS		8
+
+/* Synthetic backend: the property content is generated on demand
+   from the offset, writes go to an overlay starting at offset 0 */
+struct synthetic_object {
+	uint64_t	size;
+};
+
+struct synthetic_stream {
+	struct synthetic_object	*object;
+	bool			read_write;
+	uint64_t		size;
+	DATA_BLOB		overlay;
+};
+
+/* Global test variables */
+static TALLOC_CTX		*g_mem_ctx;
+static struct mapistore_context	*g_mstore_ctx;
+static struct mapistore_backend	g_backend;
+static struct mapistore_backend	g_defaults;
+static struct mapistore_backend	g_release;
+static uint32_t			g_read_calls;
+static uint32_t			g_open_calls;
+static uint32_t			g_commit_calls;
+
+
+static uint8_t synthetic_byte(uint64_t offset)
+{
+	return (uint8_t) ((offset * 131) ^ (offset >> 16));
+}
+
+static enum mapistore_error synthetic_open_property_stream(void *object, TALLOC_CTX *mem_ctx, enum MAPITAGS prop_tag,
+							   bool read_write, void **streamp)
+{
+	struct synthetic_stream	*stream;
+
+	if (prop_tag != PidTagAttachDataBinary) {
+		return MAPISTORE_ERR_NOT_FOUND;
+	}
+
+	g_open_calls++;
+	stream = talloc_zero(mem_ctx, struct synthetic_stream);
+	stream->object = (struct synthetic_object *) object;
+	stream->read_write = read_write;
+	stream->size = stream->object->size;
+	*streamp = stream;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error synthetic_read_at(void *backend_stream, TALLOC_CTX *mem_ctx, uint64_t offset,
+					      uint32_t length, DATA_BLOB *data)
+{
+	struct synthetic_stream	*stream = (struct synthetic_stream *) backend_stream;
+	uint64_t		i;
+
+	g_read_calls++;
+	if (offset >= stream->size) {
+		data->data = NULL;
+		data->length = 0;
+		return MAPISTORE_SUCCESS;
+	}
+	if (length > stream->size - offset) {
+		length = stream->size - offset;
+	}
+
+	data->length = length;
+	data->data = talloc_array(mem_ctx, uint8_t, length);
+	for (i = 0; i < length; i++) {
+		data->data[i] = (offset + i < stream->overlay.length) ?
+			stream->overlay.data[offset + i] : synthetic_byte(offset + i);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error synthetic_write_at(void *backend_stream, uint64_t offset, DATA_BLOB data)
+{
+	struct synthetic_stream	*stream = (struct synthetic_stream *) backend_stream;
+	uint64_t		i;
+
+	if (!stream->read_write) {
+		return MAPISTORE_ERR_DENIED;
+	}
+
+	if (offset + data.length > stream->overlay.length) {
+		stream->overlay.data = talloc_realloc(stream, stream->overlay.data, uint8_t, offset + data.length);
+		for (i = stream->overlay.length; i < offset; i++) {
+			stream->overlay.data[i] = synthetic_byte(i);
+		}
+		stream->overlay.length = offset + data.length;
+	}
+	memcpy(stream->overlay.data + offset, data.data, data.length);
+	if (stream->overlay.length > stream->size) {
+		stream->size = stream->overlay.length;
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error synthetic_get_size(void *backend_stream, uint64_t *sizep)
+{
+	*sizep = ((struct synthetic_stream *) backend_stream)->size;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error synthetic_commit_stream(void *backend_stream)
+{
+	g_commit_calls++;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static void add_backend_context(const struct mapistore_backend *backend, uint32_t context_id)
+{
+	struct backend_context_list	*el;
+
+	el = talloc_zero(g_mstore_ctx, struct backend_context_list);
+	el->ctx = talloc_zero(el, struct backend_context);
+	el->ctx->backend = backend;
+	el->ctx->context_id = context_id;
+	ck_assert_int_eq(mapistore_register_context(g_mstore_ctx->processing_ctx, el), MAPISTORE_SUCCESS);
+	DLIST_ADD_END(g_mstore_ctx->context_list, el, struct backend_context_list *);
+}
+
+static void check_data(DATA_BLOB *data, uint64_t offset)
+{
+	uint32_t	i;
+
+	for (i = 0; i < data->length; i++) {
+		if (data->data[i] != synthetic_byte(offset + i)) {
+			ck_assert_int_eq(data->data[i], synthetic_byte(offset + i));
+		}
+	}
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_read_chunks) {
+	struct synthetic_object			object = { SMALL_SIZE };
+	struct mapistore_property_stream	*stream;
+	DATA_BLOB				data;
+	uint64_t				size;
+	uint64_t				offset;
+
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, STREAM_CONTEXT_ID, &object, g_mem_ctx,
+							  PidTagAttachDataBinary, false, &stream), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_property_stream_get_size(stream, &size), MAPISTORE_SUCCESS);
+	ck_assert(size == SMALL_SIZE);
+
+	/* Small reads only reach the backend once per chunk */
+	g_read_calls = 0;
+	for (offset = 0; offset < SMALL_SIZE; offset += data.length) {
+		ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, offset, 1000, &data), MAPISTORE_SUCCESS);
+		ck_assert(data.length == 1000 || offset + data.length == SMALL_SIZE);
+		check_data(&data, offset);
+	}
+	ck_assert(g_read_calls <= SMALL_SIZE / (MAPISTORE_STREAM_CHUNK_SIZE - 1000) + 1);
+
+	/* Reads crossing a chunk boundary and larger than a chunk */
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, MAPISTORE_STREAM_CHUNK_SIZE - 10, 20, &data), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(data.length, 20);
+	check_data(&data, MAPISTORE_STREAM_CHUNK_SIZE - 10);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, 5, 2 * MAPISTORE_STREAM_CHUNK_SIZE, &data), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(data.length, 2 * MAPISTORE_STREAM_CHUNK_SIZE);
+	check_data(&data, 5);
+
+	/* Backward and past the end */
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, 0, 10, &data), MAPISTORE_SUCCESS);
+	check_data(&data, 0);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, SMALL_SIZE, 10, &data), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(data.length, 0);
+
+	/* Read-only streams cannot be written */
+	ck_assert_int_eq(mapistore_property_stream_write(stream, 0, data_blob_const("x", 1)), MAPISTORE_ERR_DENIED);
+
+	talloc_free(stream);
+} END_TEST
+
+START_TEST (test_read_lifetime) {
+	struct synthetic_object			object = { SMALL_SIZE };
+	struct mapistore_property_stream	*stream;
+	TALLOC_CTX				*rpc_ctx;
+	DATA_BLOB				first;
+	DATA_BLOB				second;
+
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, STREAM_CONTEXT_ID, &object, g_mem_ctx,
+							  PidTagAttachDataBinary, false, &stream), MAPISTORE_SUCCESS);
+
+	/* Data returned to a memory context is a copy owned by it, which
+	   survives chunk changes and the stream itself */
+	rpc_ctx = talloc_new(g_mem_ctx);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, rpc_ctx, 0, 100, &first), MAPISTORE_SUCCESS);
+	ck_assert(talloc_parent(first.data) == rpc_ctx);
+	ck_assert_int_eq(talloc_get_size(first.data), 100);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, rpc_ctx, 2 * MAPISTORE_STREAM_CHUNK_SIZE, 100, &second), MAPISTORE_SUCCESS);
+	ck_assert(talloc_parent(second.data) == rpc_ctx);
+	talloc_free(stream);
+	check_data(&first, 0);
+	check_data(&second, 2 * MAPISTORE_STREAM_CHUNK_SIZE);
+
+	/* Freeing a copy leaves the cached chunk alone */
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, STREAM_CONTEXT_ID, &object, g_mem_ctx,
+							  PidTagAttachDataBinary, false, &stream), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, rpc_ctx, 0, 100, &first), MAPISTORE_SUCCESS);
+	talloc_free(first.data);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, 10, 100, &second), MAPISTORE_SUCCESS);
+	check_data(&second, 10);
+	talloc_free(stream);
+	talloc_free(rpc_ctx);
+} END_TEST
+
+START_TEST (test_write) {
+	struct synthetic_object			object = { SMALL_SIZE };
+	struct mapistore_property_stream	*stream;
+	DATA_BLOB				data;
+	uint8_t					buffer[200];
+	uint64_t				size;
+
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, STREAM_CONTEXT_ID, &object, g_mem_ctx,
+							  PidTagAttachDataBinary, true, &stream), MAPISTORE_SUCCESS);
+
+	/* Cache the first chunk, then overwrite part of it */
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, 0, 10, &data), MAPISTORE_SUCCESS);
+	memset(buffer, 0xAB, sizeof (buffer));
+	ck_assert_int_eq(mapistore_property_stream_write(stream, 100, data_blob_const(buffer, sizeof (buffer))), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, 90, 20, &data), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(data.length, 20);
+	ck_assert_int_eq(data.data[9], synthetic_byte(99));
+	ck_assert_int_eq(data.data[10], 0xAB);
+
+	/* Writing past the end grows the stream */
+	ck_assert_int_eq(mapistore_property_stream_write(stream, SMALL_SIZE - 50, data_blob_const(buffer, sizeof (buffer))), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_property_stream_get_size(stream, &size), MAPISTORE_SUCCESS);
+	ck_assert(size == SMALL_SIZE + 150);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, SMALL_SIZE + 100, 100, &data), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(data.length, 50);
+	ck_assert_int_eq(data.data[49], 0xAB);
+
+	talloc_free(stream);
+} END_TEST
+
+START_TEST (test_commit) {
+	struct synthetic_object			object = { SMALL_SIZE };
+	struct mapistore_property_stream	*stream;
+	DATA_BLOB				data;
+	uint64_t				size;
+
+	/* Backends committing their streams keep them open */
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, STREAM_CONTEXT_ID, &object, g_mem_ctx,
+							  PidTagAttachDataBinary, true, &stream), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_property_stream_write(stream, 0, data_blob_const("x", 1)), MAPISTORE_SUCCESS);
+	g_open_calls = 0;
+	g_commit_calls = 0;
+	ck_assert_int_eq(mapistore_property_stream_commit(stream), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(g_commit_calls, 1);
+	ck_assert_int_eq(g_open_calls, 0);
+	talloc_free(stream);
+
+	/* Other backends commit on release, the stream is opened again */
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, RELEASE_CONTEXT_ID, &object, g_mem_ctx,
+							  PidTagAttachDataBinary, true, &stream), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, 0, 10, &data), MAPISTORE_SUCCESS);
+	g_open_calls = 0;
+	g_commit_calls = 0;
+	ck_assert_int_eq(mapistore_property_stream_commit(stream), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(g_commit_calls, 0);
+	ck_assert_int_eq(g_open_calls, 1);
+	ck_assert_int_eq(mapistore_property_stream_get_size(stream, &size), MAPISTORE_SUCCESS);
+	ck_assert(size == SMALL_SIZE);
+	ck_assert_int_eq(mapistore_property_stream_read(stream, NULL, 100, 10, &data), MAPISTORE_SUCCESS);
+	check_data(&data, 100);
+	talloc_free(stream);
+
+	/* Read-only streams have nothing to commit */
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, STREAM_CONTEXT_ID, &object, g_mem_ctx,
+							  PidTagAttachDataBinary, false, &stream), MAPISTORE_SUCCESS);
+	ck_assert_int_eq(mapistore_property_stream_commit(stream), MAPISTORE_ERR_DENIED);
+	talloc_free(stream);
+} END_TEST
+
+START_TEST (test_fallback) {
+	struct synthetic_object			object = { SMALL_SIZE };
+	struct mapistore_property_stream	*stream = NULL;
+
+	/* Backends without property streams let the caller load the property */
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, DEFAULTS_CONTEXT_ID, &object, g_mem_ctx,
+							  PidTagAttachDataBinary, false, &stream), MAPISTORE_ERR_NOT_IMPLEMENTED);
+	ck_assert(stream == NULL);
+
+	/* Backend errors are returned as is */
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, STREAM_CONTEXT_ID, &object, g_mem_ctx,
+							  PidTagBody, false, &stream), MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, 0xdead, &object, g_mem_ctx,
+							  PidTagAttachDataBinary, false, &stream), MAPISTORE_ERR_INVALID_PARAMETER);
+	ck_assert(stream == NULL);
+	ck_assert_int_eq(talloc_total_blocks(g_mem_ctx), 1);
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_concurrent_sessions) {
+	struct synthetic_object			object = { ATTACHMENT_SIZE };
+	struct mapistore_property_stream	*streams[SESSIONS];
+	struct synthetic_stream			buffered_stream;
+	TALLOC_CTX				*buffered_ctx;
+	TALLOC_CTX				*rpc_ctx;
+	DATA_BLOB				property;
+	DATA_BLOB				data;
+	struct timespec				start;
+	double					streamed_ms;
+	double					buffered_ms;
+	uint64_t				offsets[SESSIONS];
+	size_t					peak = 0;
+	size_t					buffered_peak;
+	size_t					current;
+	uint32_t				done = 0;
+	uint32_t				i;
+
+	/* Buffered path: the backend returns the whole property, then
+	   emsmdbp copies it in the stream buffer */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	buffered_ctx = talloc_new(g_mem_ctx);
+	memset(&buffered_stream, 0, sizeof (buffered_stream));
+	buffered_stream.object = &object;
+	buffered_stream.size = ATTACHMENT_SIZE;
+	ck_assert_int_eq(synthetic_read_at(&buffered_stream, buffered_ctx, 0, ATTACHMENT_SIZE, &property), MAPISTORE_SUCCESS);
+	ck_assert(talloc_memdup(buffered_ctx, property.data, property.length) != NULL);
+	buffered_peak = talloc_total_size(buffered_ctx);
+	talloc_free(buffered_ctx);
+	buffered_ms = testsuite_elapsed_ms(&start);
+
+	/* Streamed path: sessions read their attachment concurrently
+	   with maximum sized ReadStream ROPs */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	g_read_calls = 0;
+	for (i = 0; i < SESSIONS; i++) {
+		ck_assert_int_eq(mapistore_properties_open_stream(g_mstore_ctx, STREAM_CONTEXT_ID, &object, g_mem_ctx,
+								  PidTagAttachDataBinary, false, &streams[i]), MAPISTORE_SUCCESS);
+		offsets[i] = 0;
+	}
+	while (done < SESSIONS) {
+		for (i = 0; i < SESSIONS; i++) {
+			if (offsets[i] == ATTACHMENT_SIZE) continue;
+			rpc_ctx = talloc_new(g_mem_ctx);
+			ck_assert_int_eq(mapistore_property_stream_read(streams[i], rpc_ctx, offsets[i], READSTREAM_SIZE, &data), MAPISTORE_SUCCESS);
+			ck_assert(data.length > 0);
+			check_data(&data, offsets[i]);
+			offsets[i] += data.length;
+			if (offsets[i] == ATTACHMENT_SIZE) done++;
+
+			current = talloc_total_size(g_mem_ctx);
+			if (current > peak) peak = current;
+			talloc_free(rpc_ctx);
+		}
+	}
+	for (i = 0; i < SESSIONS; i++) {
+		talloc_free(streams[i]);
+	}
+	streamed_ms = testsuite_elapsed_ms(&start);
+
+	ck_assert(buffered_peak >= 2 * (size_t) ATTACHMENT_SIZE);
+	ck_assert(peak <= SESSIONS * (MAPISTORE_STREAM_CHUNK_SIZE + 1024));
+	ck_assert(g_read_calls <= SESSIONS * (ATTACHMENT_SIZE / READSTREAM_SIZE + 1));
+
+	testsuite_benchmark_report("property streams, %u sessions reading %u bytes: buffered %.1f MB peak (%.2fms/session), streamed %.1f KB peak (%.2fms, %u backend reads)\n",
+	                           SESSIONS, ATTACHMENT_SIZE, SESSIONS * buffered_peak / (1024.0 * 1024.0), buffered_ms,
+	                           peak / 1024.0, streamed_ms, g_read_calls);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void property_stream_setup(void)
+{
+	g_mem_ctx = talloc_named(NULL, 0, "property_stream_setup");
+
+	memset(&g_backend, 0, sizeof (g_backend));
+	ck_assert_int_eq(mapistore_backend_init_defaults(&g_backend), MAPISTORE_SUCCESS);
+	g_backend.backend.name = "synthetic";
+	g_backend.properties.open_property_stream = synthetic_open_property_stream;
+	g_backend.properties.read_at = synthetic_read_at;
+	g_backend.properties.write_at = synthetic_write_at;
+	g_backend.properties.get_size = synthetic_get_size;
+	g_backend.properties.commit_stream = synthetic_commit_stream;
+
+	g_release = g_backend;
+	g_release.backend.name = "synthetic_release";
+	g_release.properties.commit_stream = NULL;
+
+	memset(&g_defaults, 0, sizeof (g_defaults));
+	ck_assert_int_eq(mapistore_backend_init_defaults(&g_defaults), MAPISTORE_SUCCESS);
+
+	/* Streams only need the backend contexts */
+	g_mstore_ctx = talloc_zero(NULL, struct mapistore_context);
+	g_mstore_ctx->processing_ctx = talloc_zero(g_mstore_ctx, struct processing_context);
+	ck_assert_int_eq(mapistore_init_context_registry(g_mstore_ctx->processing_ctx), MAPISTORE_SUCCESS);
+	add_backend_context(&g_backend, STREAM_CONTEXT_ID);
+	add_backend_context(&g_defaults, DEFAULTS_CONTEXT_ID);
+	add_backend_context(&g_release, RELEASE_CONTEXT_ID);
+}
+
+static void property_stream_teardown(void)
+{
+	talloc_free(g_mstore_ctx);
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapistore_property_stream_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+	TCase	*tc_perf;
+
+	s = suite_create("libmapistore: property streams");
+
+	tc = tcase_create("property stream interface");
+	tcase_add_checked_fixture(tc, property_stream_setup, property_stream_teardown);
+	tcase_add_test(tc, test_read_chunks);
+	tcase_add_test(tc, test_read_lifetime);
+	tcase_add_test(tc, test_write);
+	tcase_add_test(tc, test_commit);
+	tcase_add_test(tc, test_fallback);
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		tc_perf = tcase_create("property stream memory");
+		tcase_add_checked_fixture(tc_perf, property_stream_setup, property_stream_teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_concurrent_sessions);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
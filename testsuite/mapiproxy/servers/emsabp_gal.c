@@ -0,0 +1,309 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include <time.h>
+
+#include "mapiproxy/servers/default/nspi/emsabp_gal.c"
+
+#define	BENCHMARK_ENTRIES	100000
+#define	BENCHMARK_PAGE		50
+#define	BENCHMARK_SEEKS		10000
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct emsabp_gal	*gal;
+
+
+static struct emsabp_gal_entry *set_entry(const char *cn, const char *display_name, uint64_t usn)
+{
+	enum MAPISTATUS		retval;
+	struct ldb_message	*msg;
+	struct emsabp_gal_entry	*entry = NULL;
+
+	msg = ldb_msg_new(mem_ctx);
+	ck_assert(msg != NULL);
+	ck_assert_int_eq(ldb_msg_add_string(msg, "distinguishedName",
+					    talloc_asprintf(msg, "CN=%s,CN=Users,DC=example,DC=com", cn)), LDB_SUCCESS);
+	if (display_name) {
+		ck_assert_int_eq(ldb_msg_add_string(msg, "displayName", talloc_strdup(msg, display_name)), LDB_SUCCESS);
+	}
+
+	retval = emsabp_gal_set_entry(gal, msg, display_name, usn, &entry);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert(entry != NULL);
+
+	return entry;
+}
+
+static void load_sample(void)
+{
+	emsabp_gal_begin_update(gal, true);
+	set_entry("jkerihuel", "Julien Kerihuel", 10);
+	set_entry("bwong", "brian wong", 11);
+	set_entry("ajones", "Alice Jones", 12);
+	set_entry("ajonas", "alice jonas", 13);
+	set_entry("zed", "Zed", 14);
+	ck_assert_int_eq(emsabp_gal_commit(gal), MAPI_E_SUCCESS);
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_display_order) {
+	const char	*expected[] = { "ALICE JONAS", "ALICE JONES", "BRIAN WONG", "JULIEN KERIHUEL", "ZED" };
+	uint32_t	i;
+
+	load_sample();
+
+	ck_assert_int_eq(emsabp_gal_count(gal), 5);
+	for (i = 0; i < 5; i++) {
+		ck_assert_str_eq(emsabp_gal_entry_at(gal, i)->sort_key, expected[i]);
+		ck_assert_int_eq(emsabp_gal_entry_at(gal, i)->position, i);
+	}
+	ck_assert(emsabp_gal_entry_at(gal, 5) == NULL);
+	ck_assert_int_eq(gal->highest_usn, 14);
+} END_TEST
+
+START_TEST (test_seek) {
+	uint32_t	matches;
+
+	load_sample();
+
+	/* Case insensitive prefix */
+	ck_assert_int_eq(emsabp_gal_seek(gal, "alice j", &matches), 0);
+	ck_assert_int_eq(matches, 2);
+	ck_assert_int_eq(emsabp_gal_seek(gal, "ALICE JONE", &matches), 1);
+	ck_assert_int_eq(matches, 1);
+
+	/* Positioned on the next entry when nothing matches */
+	ck_assert_int_eq(emsabp_gal_seek(gal, "c", &matches), 3);
+	ck_assert_int_eq(matches, 0);
+
+	/* Past the end */
+	ck_assert_int_eq(emsabp_gal_seek(gal, "zz", &matches), 5);
+	ck_assert_int_eq(matches, 0);
+
+	/* Empty target is the beginning of the table */
+	ck_assert_int_eq(emsabp_gal_seek(gal, "", &matches), 0);
+	ck_assert_int_eq(matches, 5);
+} END_TEST
+
+START_TEST (test_lookup) {
+	struct emsabp_gal_entry	*entry;
+
+	load_sample();
+
+	entry = emsabp_gal_lookup_dn(gal, "CN=bwong,CN=Users,DC=example,DC=com");
+	ck_assert(entry != NULL);
+	ck_assert_str_eq(entry->sort_key, "BRIAN WONG");
+	ck_assert(emsabp_gal_lookup_MId(gal, entry->MId) == entry);
+
+	ck_assert(emsabp_gal_lookup_dn(gal, "CN=nobody,CN=Users,DC=example,DC=com") == NULL);
+	ck_assert(emsabp_gal_lookup_MId(gal, 0x1234) == NULL);
+	ck_assert(emsabp_gal_lookup_MId(gal, gal->next_MId) == NULL);
+} END_TEST
+
+START_TEST (test_incremental_update) {
+	struct emsabp_gal_entry	*entry;
+	uint32_t		MId;
+
+	load_sample();
+	MId = emsabp_gal_lookup_dn(gal, "CN=zed,CN=Users,DC=example,DC=com")->MId;
+
+	emsabp_gal_begin_update(gal, false);
+	/* Renamed entry keeps its MId and moves in the display order */
+	entry = set_entry("zed", "Aaron Zed", 20);
+	ck_assert_int_eq(entry->MId, MId);
+	/* New entries are not visible until committed */
+	entry = set_entry("mmoore", "Mary Moore", 21);
+	ck_assert(emsabp_gal_lookup_MId(gal, entry->MId) == NULL);
+	ck_assert_int_eq(emsabp_gal_count(gal), 5);
+	ck_assert_int_eq(emsabp_gal_commit(gal), MAPI_E_SUCCESS);
+
+	ck_assert_int_eq(emsabp_gal_count(gal), 6);
+	ck_assert_int_eq(emsabp_gal_entry_at(gal, 0)->MId, MId);
+	ck_assert_str_eq(emsabp_gal_entry_at(gal, 5)->sort_key, "MARY MOORE");
+	ck_assert(emsabp_gal_lookup_MId(gal, entry->MId) == entry);
+	ck_assert_int_eq(gal->highest_usn, 21);
+} END_TEST
+
+START_TEST (test_full_update) {
+	struct emsabp_gal_entry	*entry;
+	uint32_t		MId;
+
+	load_sample();
+	MId = emsabp_gal_lookup_dn(gal, "CN=bwong,CN=Users,DC=example,DC=com")->MId;
+
+	/* Records which are not part of a full update are removed */
+	emsabp_gal_begin_update(gal, true);
+	set_entry("jkerihuel", "Julien Kerihuel", 10);
+	entry = set_entry("bwong", "Brian Wong", 11);
+	ck_assert_int_eq(emsabp_gal_commit(gal), MAPI_E_SUCCESS);
+
+	ck_assert_int_eq(emsabp_gal_count(gal), 2);
+	ck_assert_int_eq(entry->MId, MId);
+	ck_assert(emsabp_gal_lookup_dn(gal, "CN=zed,CN=Users,DC=example,DC=com") == NULL);
+	ck_assert_str_eq(emsabp_gal_entry_at(gal, 0)->sort_key, "BRIAN WONG");
+	ck_assert_str_eq(emsabp_gal_entry_at(gal, 1)->sort_key, "JULIEN KERIHUEL");
+} END_TEST
+
+START_TEST (test_duplicate_dn) {
+	struct emsabp_gal_entry	*first;
+	struct emsabp_gal_entry	*entry;
+
+	load_sample();
+
+	/* A new DN set twice in a batch is given a single MId */
+	emsabp_gal_begin_update(gal, false);
+	first = set_entry("mmoore", "Mary Moore", 20);
+	set_entry("mmoore", "Mary Smith", 21);
+	ck_assert_int_eq(emsabp_gal_commit(gal), MAPI_E_SUCCESS);
+
+	ck_assert_int_eq(emsabp_gal_count(gal), 6);
+	entry = emsabp_gal_lookup_dn(gal, "CN=mmoore,CN=Users,DC=example,DC=com");
+	ck_assert(entry == first);
+	ck_assert_str_eq(entry->sort_key, "MARY SMITH");
+	ck_assert_int_eq(entry->usn, 21);
+	ck_assert(emsabp_gal_lookup_MId(gal, entry->MId + 1) == NULL);
+	ck_assert(emsabp_gal_entry_at(gal, entry->position) == entry);
+
+	/* And during a full update */
+	emsabp_gal_begin_update(gal, true);
+	set_entry("jkerihuel", "Julien Kerihuel", 10);
+	first = set_entry("pdoe", "Pat Doe", 22);
+	set_entry("pdoe", "Pat Doe-Smith", 23);
+	ck_assert_int_eq(emsabp_gal_commit(gal), MAPI_E_SUCCESS);
+
+	ck_assert_int_eq(emsabp_gal_count(gal), 2);
+	ck_assert(emsabp_gal_entry_at(gal, 1) == first);
+	ck_assert_str_eq(first->sort_key, "PAT DOE-SMITH");
+	ck_assert(emsabp_gal_lookup_MId(gal, first->MId) == first);
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_benchmark_browse) {
+	struct emsabp_gal_entry	*entry;
+	struct timespec		start;
+	double			load_ms, page_ms, seek_ms, refresh_ms;
+	char			cn[32];
+	char			display_name[64];
+	char			target[4];
+	uint32_t		matches, position;
+	uint32_t		i, j;
+
+	srandom(1);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	emsabp_gal_begin_update(gal, true);
+	for (i = 0; i < BENCHMARK_ENTRIES; i++) {
+		snprintf(cn, sizeof (cn), "user%u", i);
+		snprintf(display_name, sizeof (display_name), "%c%c%c%c User %u",
+			 'A' + (int)(random() % 26), 'a' + (int)(random() % 26),
+			 'a' + (int)(random() % 26), 'a' + (int)(random() % 26), i);
+		set_entry(cn, display_name, i + 1);
+	}
+	ck_assert_int_eq(emsabp_gal_commit(gal), MAPI_E_SUCCESS);
+	load_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(emsabp_gal_count(gal), BENCHMARK_ENTRIES);
+
+	/* QueryRows: page through the whole GAL */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (position = 0; position < BENCHMARK_ENTRIES; position += BENCHMARK_PAGE) {
+		for (j = 0; j < BENCHMARK_PAGE; j++) {
+			entry = emsabp_gal_entry_at(gal, position + j);
+			if (!entry) break;
+			ck_assert(emsabp_gal_lookup_MId(gal, entry->MId) == entry);
+		}
+	}
+	page_ms = testsuite_elapsed_ms(&start);
+
+	/* SeekEntries: random two letters prefixes */
+	target[2] = '\0';
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_SEEKS; i++) {
+		target[0] = 'a' + (int)(random() % 26);
+		target[1] = 'a' + (int)(random() % 26);
+		position = emsabp_gal_seek(gal, target, &matches);
+		ck_assert(position <= BENCHMARK_ENTRIES);
+	}
+	seek_ms = testsuite_elapsed_ms(&start);
+
+	/* Incremental refresh of 1% of the records */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	emsabp_gal_begin_update(gal, false);
+	for (i = 0; i < BENCHMARK_ENTRIES / 100; i++) {
+		snprintf(cn, sizeof (cn), "user%u", i * 100);
+		snprintf(display_name, sizeof (display_name), "Renamed User %u", i);
+		set_entry(cn, display_name, BENCHMARK_ENTRIES + i + 1);
+	}
+	ck_assert_int_eq(emsabp_gal_commit(gal), MAPI_E_SUCCESS);
+	refresh_ms = testsuite_elapsed_ms(&start);
+	ck_assert_int_eq(emsabp_gal_count(gal), BENCHMARK_ENTRIES);
+
+	testsuite_benchmark_report("emsabp_gal %u entries: load %.2fms, QueryRows pages of %u %.2fms, "
+	                           "%u SeekEntries %.2fms (%.2fus each), refresh of %u entries %.2fms\n",
+	                           BENCHMARK_ENTRIES, load_ms, BENCHMARK_PAGE, page_ms,
+	                           BENCHMARK_SEEKS, seek_ms, seek_ms * 1000.0 / BENCHMARK_SEEKS,
+	                           BENCHMARK_ENTRIES / 100, refresh_ms);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_emsabp_gal_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "tc_emsabp_gal_setup");
+	gal = emsabp_gal_init(mem_ctx);
+	ck_assert(gal != NULL);
+}
+
+static void tc_emsabp_gal_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsabp_gal_suite(void)
+{
+	Suite *s = suite_create("mapiproxy NSPI GAL snapshot");
+
+	TCase *tc = tcase_create("GAL snapshot");
+	tcase_add_checked_fixture(tc, tc_emsabp_gal_setup, tc_emsabp_gal_teardown);
+
+	tcase_add_test(tc, test_display_order);
+	tcase_add_test(tc, test_seek);
+	tcase_add_test(tc, test_lookup);
+	tcase_add_test(tc, test_incremental_update);
+	tcase_add_test(tc, test_full_update);
+	tcase_add_test(tc, test_duplicate_dn);
+
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create("GAL snapshot performance");
+		tcase_add_checked_fixture(tc_perf, tc_emsabp_gal_setup, tc_emsabp_gal_teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_browse);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
@@ -0,0 +1,241 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include <time.h>
+
+#include "mapiproxy/servers/default/nspi/emsabp_tdb.c"
+
+#define	EMSABP_TDB_TEST_PATH	"/tmp/openchange_test_emsabp.tdb"
+#define	BENCHMARK_ENTRIES	100000
+#define	BENCHMARK_LOOKUPS	10000
+
+/* Global test variables */
+static TALLOC_CTX	*mem_ctx;
+static TDB_CONTEXT	*tdb_ctx;
+
+
+static const char *test_dn(uint32_t i)
+{
+	return talloc_asprintf(mem_ctx, "CN=user%u,CN=Users,DC=example,DC=com", i);
+}
+
+static void store_v1_record(TDB_CONTEXT *tdb, const char *keyname, uint32_t value)
+{
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+
+	key.dptr = (unsigned char *) keyname;
+	key.dsize = strlen(keyname);
+	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", value);
+	dbuf.dsize = strlen((const char *) dbuf.dptr);
+	ck_assert_int_eq(tdb_store(tdb, key, dbuf, TDB_INSERT), 0);
+}
+
+static int count_records(TDB_CONTEXT *tdb, TDB_DATA key, TDB_DATA dbuf, void *state)
+{
+	return 0;
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_insert_fetch) {
+	enum MAPISTATUS	retval;
+	uint32_t	MId;
+	char		*dn;
+
+	retval = emsabp_tdb_insert(tdb_ctx, test_dn(1));
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	retval = emsabp_tdb_insert(tdb_ctx, test_dn(2));
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+
+	retval = emsabp_tdb_fetch_MId(tdb_ctx, test_dn(1), &MId);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(MId, EMSABP_TDB_TMP_MID_START + 1);
+	retval = emsabp_tdb_fetch_MId(tdb_ctx, test_dn(2), &MId);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(MId, EMSABP_TDB_TMP_MID_START + 2);
+
+	ck_assert(emsabp_tdb_lookup_MId(tdb_ctx, MId));
+	retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, MId, &dn);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_str_eq(dn, test_dn(2));
+
+	/* Inserting twice keeps the MId */
+	retval = emsabp_tdb_insert(tdb_ctx, test_dn(1));
+	ck_assert_int_eq(retval, ecExiting);
+	retval = emsabp_tdb_fetch_MId(tdb_ctx, test_dn(1), &MId);
+	ck_assert_int_eq(MId, EMSABP_TDB_TMP_MID_START + 1);
+} END_TEST
+
+START_TEST (test_not_found) {
+	enum MAPISTATUS	retval;
+	uint32_t	MId;
+	char		*dn;
+
+	retval = emsabp_tdb_fetch_MId(tdb_ctx, test_dn(42), &MId);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	/* Neither the index record value nor an unknown MId match */
+	ck_assert(!emsabp_tdb_lookup_MId(tdb_ctx, EMSABP_TDB_TMP_MID_START));
+	ck_assert(!emsabp_tdb_lookup_MId(tdb_ctx, 0x1234));
+	retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, 0x1234, &dn);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	ck_assert(dn == NULL);
+} END_TEST
+
+START_TEST (test_migration) {
+	enum MAPISTATUS	retval;
+	TDB_CONTEXT	*tdb;
+	uint32_t	MId;
+	char		*dn;
+	int		count;
+
+	unlink(EMSABP_TDB_TEST_PATH);
+	tdb = tdb_open(EMSABP_TDB_TEST_PATH, 0, 0, O_RDWR|O_CREAT, 0600);
+	ck_assert(tdb != NULL);
+
+	/* Version 1 layout */
+	store_v1_record(tdb, EMSABP_TDB_DATA_REC, EMSABP_TDB_MID_START + 2);
+	store_v1_record(tdb, "CN=Default Global Address List,CN=All Global Address Lists", EMSABP_TDB_MID_START + 1);
+	store_v1_record(tdb, "CN=All Address Lists,CN=Address Lists Container", EMSABP_TDB_MID_START + 2);
+
+	retval = emsabp_tdb_migrate(tdb);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(emsabp_tdb_version(tdb), EMSABP_TDB_VERSION);
+
+	retval = emsabp_tdb_fetch_MId(tdb, "CN=All Address Lists,CN=Address Lists Container", &MId);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(MId, EMSABP_TDB_MID_START + 2);
+	ck_assert(emsabp_tdb_lookup_MId(tdb, EMSABP_TDB_MID_START + 1));
+	retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb, EMSABP_TDB_MID_START + 1, &dn);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_str_eq(dn, "CN=Default Global Address List,CN=All Global Address Lists");
+
+	/* Allocation resumes after the converted index */
+	retval = emsabp_tdb_insert(tdb, "CN=Offline Address Book");
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	retval = emsabp_tdb_fetch_MId(tdb, "CN=Offline Address Book", &MId);
+	ck_assert_int_eq(MId, EMSABP_TDB_MID_START + 3);
+
+	/* A converted database is left alone */
+	count = tdb_traverse_read(tdb, count_records, NULL);
+	retval = emsabp_tdb_migrate(tdb);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(tdb_traverse_read(tdb, count_records, NULL), count);
+
+	tdb_close(tdb);
+	unlink(EMSABP_TDB_TEST_PATH);
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_benchmark_lookup) {
+	enum MAPISTATUS	retval;
+	struct timespec	start;
+	double		insert_ms, dn_to_mid_ms, get_props_ms, traverse_ms;
+	const char	**dns;
+	uint32_t	MId;
+	char		*dn;
+	uint32_t	i;
+
+	dns = talloc_array(mem_ctx, const char *, BENCHMARK_ENTRIES);
+	for (i = 0; i < BENCHMARK_ENTRIES; i++) {
+		dns[i] = test_dn(i);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_ENTRIES; i++) {
+		retval = emsabp_tdb_insert(tdb_ctx, dns[i]);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	}
+	insert_ms = testsuite_elapsed_ms(&start);
+
+	/* NspiDNToMId */
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		retval = emsabp_tdb_fetch_MId(tdb_ctx, dns[random() % BENCHMARK_ENTRIES], &MId);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	}
+	dn_to_mid_ms = testsuite_elapsed_ms(&start);
+
+	/* NspiGetProps: container check and MId to DN */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		MId = EMSABP_TDB_TMP_MID_START + 1 + random() % BENCHMARK_ENTRIES;
+		ck_assert(emsabp_tdb_lookup_MId(tdb_ctx, MId));
+		retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, MId, &dn);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+		talloc_free(dn);
+	}
+	get_props_ms = testsuite_elapsed_ms(&start);
+
+	/* What a single lookup used to cost */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	tdb_traverse_read(tdb_ctx, count_records, NULL);
+	traverse_ms = testsuite_elapsed_ms(&start);
+
+	testsuite_benchmark_report("emsabp_tdb %u entries: insert %.2fms, DNToMId %.2fus, GetProps lookups %.2fus, "
+	                           "full traverse %.2fms\n", BENCHMARK_ENTRIES, insert_ms,
+	                           dn_to_mid_ms * 1000.0 / BENCHMARK_LOOKUPS, get_props_ms * 1000.0 / BENCHMARK_LOOKUPS,
+	                           traverse_ms);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_emsabp_tdb_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "tc_emsabp_tdb_setup");
+	tdb_ctx = emsabp_tdb_init_tmp(mem_ctx);
+	ck_assert(tdb_ctx != NULL);
+}
+
+static void tc_emsabp_tdb_teardown(void)
+{
+	tdb_close(tdb_ctx);
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsabp_tdb_suite(void)
+{
+	Suite *s = suite_create("mapiproxy NSPI MId database");
+
+	TCase *tc = tcase_create("MId database");
+	tcase_add_checked_fixture(tc, tc_emsabp_tdb_setup, tc_emsabp_tdb_teardown);
+
+	tcase_add_test(tc, test_insert_fetch);
+	tcase_add_test(tc, test_not_found);
+	tcase_add_test(tc, test_migration);
+
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create("MId database performance");
+		tcase_add_checked_fixture(tc_perf, tc_emsabp_tdb_setup, tc_emsabp_tdb_teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_lookup);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
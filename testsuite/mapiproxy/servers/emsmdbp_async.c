@@ -0,0 +1,340 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include <time.h>
+#include <sys/resource.h>
+
+#include "mapiproxy/servers/default/emsmdb/emsmdbp_async.c"
+
+#define	BENCHMARK_SESSIONS	10000
+#define	BENCHMARK_NOTIFIED	1000
+#define	BENCHMARK_TIMEOUT	2
+
+/* A parked EcDoAsyncWaitEx call */
+struct test_call {
+	bool			done;
+	uint32_t		flags;
+	enum MAPISTATUS		retval;
+};
+
+struct test_session {
+	struct mapistore_context	*mstore_ctx;
+	struct emsmdbp_async_context	*async_ctx;
+	struct test_call		call;
+};
+
+/* Global test variables */
+static TALLOC_CTX		*g_mem_ctx;
+static struct tevent_context	*g_ev;
+static uint32_t			g_completed;
+
+
+static double cpu_time(void)
+{
+	struct rusage	usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+		(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+static void call_done(uint32_t flags, enum MAPISTATUS retval, void *private_data)
+{
+	struct test_call	*call = (struct test_call *) private_data;
+
+	ck_assert(!call->done);
+	call->done = true;
+	call->flags = flags;
+	call->retval = retval;
+	g_completed++;
+}
+
+/* A session of the user, with a whole store subscription to new mails */
+static struct test_session *new_session(const char *username)
+{
+	struct test_session				*session;
+	struct mapistore_subscription_list		*el;
+	struct mapistore_object_subscription_parameters	parameters;
+
+	session = talloc_zero(g_mem_ctx, struct test_session);
+	session->mstore_ctx = talloc_zero(session, struct mapistore_context);
+	session->mstore_ctx->conn_info = talloc_zero(session->mstore_ctx, struct mapistore_connection_info);
+	session->mstore_ctx->conn_info->mstore_ctx = session->mstore_ctx;
+	session->mstore_ctx->conn_info->username = talloc_strdup(session->mstore_ctx->conn_info, username);
+
+	memset(&parameters, 0, sizeof (struct mapistore_object_subscription_parameters));
+	parameters.whole_store = true;
+	el = talloc_zero(session->mstore_ctx, struct mapistore_subscription_list);
+	el->subscription = mapistore_new_subscription(el, session->mstore_ctx, username, 1, fnevNewMail, &parameters);
+	ck_assert(el->subscription != NULL);
+	DLIST_ADD(session->mstore_ctx->subscriptions, el);
+
+	session->async_ctx = emsmdbp_async_init(session->mstore_ctx);
+	ck_assert(session->async_ctx != NULL);
+
+	return session;
+}
+
+static void park(struct test_session *session, uint32_t timeout)
+{
+	memset(&session->call, 0, sizeof (struct test_call));
+	ck_assert_int_eq(emsmdbp_async_wait(session, session->async_ctx, g_ev, timeout,
+					    call_done, &session->call), MAPI_E_SUCCESS);
+}
+
+static void push_newmail(struct test_session *session, uint64_t mid)
+{
+	struct mapistore_object_notification_parameters	parameters;
+
+	memset(&parameters, 0, sizeof (struct mapistore_object_notification_parameters));
+	parameters.folder_id = 0x100;
+	parameters.object_id = mid;
+	mapistore_push_notification(session->mstore_ctx, MAPISTORE_MESSAGE, MAPISTORE_OBJECT_NEWMAIL, &parameters);
+}
+
+static void drain(struct test_session *session)
+{
+	struct mapistore_notification_list	*nl;
+
+	while ((nl = mapistore_dequeue_notification(g_mem_ctx, session->mstore_ctx))) {
+		talloc_free(nl);
+	}
+}
+
+static void loop_until(uint32_t completed)
+{
+	while (g_completed < completed) {
+		ck_assert_int_eq(tevent_loop_once(g_ev), 0);
+	}
+}
+
+static void spin_done(struct tevent_context *ev, struct tevent_timer *te,
+		      struct timeval current_time, void *private_data)
+{
+	*(bool *) private_data = true;
+}
+
+/* Run the event loop for a short while: immediate events run first */
+static void spin(void)
+{
+	bool	expired = false;
+
+	ck_assert(tevent_add_timer(g_ev, g_mem_ctx, tevent_timeval_current_ofs(0, 50000),
+				   spin_done, &expired) != NULL);
+	while (!expired) {
+		ck_assert_int_eq(tevent_loop_once(g_ev), 0);
+	}
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_wakeup) {
+	struct test_session	*session1;
+	struct test_session	*session2;
+	struct test_session	*other;
+
+	session1 = new_session("alice");
+	session2 = new_session("alice");
+	other = new_session("bob");
+
+	park(session1, 60);
+	park(session2, 60);
+	park(other, 60);
+
+	/* The wait is completed from the event loop, not by the push */
+	push_newmail(session1, 0x200);
+	ck_assert(!session1->call.done);
+	loop_until(2);
+	ck_assert(session1->call.done && session2->call.done);
+	ck_assert_int_eq(session1->call.flags, EMSMDBP_ASYNC_NOTIFICATION_PENDING);
+	ck_assert_int_eq(session2->call.retval, MAPI_E_SUCCESS);
+	ck_assert(!other->call.done);
+	ck_assert(session1->async_ctx->wait == NULL);
+
+	/* Only a notification queued on an empty queue wakes the session */
+	park(session1, 60);
+	push_newmail(session1, 0x201);
+	spin();
+	ck_assert(!session1->call.done);
+
+	drain(session1);
+	push_newmail(session1, 0x202);
+	loop_until(3);
+	ck_assert(session1->call.done);
+	ck_assert(!other->call.done);
+} END_TEST
+
+START_TEST (test_timeout) {
+	struct test_session	*session;
+	struct timespec		start;
+
+	session = new_session("alice");
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	park(session, 1);
+	loop_until(1);
+	ck_assert(testsuite_elapsed_ms(&start) >= 900);
+	ck_assert_int_eq(session->call.flags, 0);
+	ck_assert_int_eq(session->call.retval, MAPI_E_SUCCESS);
+	ck_assert(session->async_ctx->wait == NULL);
+} END_TEST
+
+START_TEST (test_supersede) {
+	struct test_session	*session;
+	struct test_call	first;
+
+	session = new_session("alice");
+
+	memset(&first, 0, sizeof (struct test_call));
+	ck_assert_int_eq(emsmdbp_async_wait(session, session->async_ctx, g_ev, 60,
+					    call_done, &first), MAPI_E_SUCCESS);
+	park(session, 60);
+	ck_assert(first.done);
+	ck_assert_int_eq(first.flags, 0);
+	ck_assert(!session->call.done);
+
+	push_newmail(session, 0x200);
+	loop_until(2);
+	ck_assert_int_eq(session->call.flags, EMSMDBP_ASYNC_NOTIFICATION_PENDING);
+
+	ck_assert_int_eq(emsmdbp_async_wait(NULL, session->async_ctx, g_ev, 60, call_done, &first), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(emsmdbp_async_wait(session, NULL, g_ev, 60, call_done, &first), MAPI_E_NOT_INITIALIZED);
+	ck_assert_int_eq(emsmdbp_async_wait(session, session->async_ctx, NULL, 60, call_done, &first), MAPI_E_INVALID_PARAMETER);
+	ck_assert_int_eq(emsmdbp_async_wait(session, session->async_ctx, g_ev, 60, NULL, &first), MAPI_E_INVALID_PARAMETER);
+	ck_assert(emsmdbp_async_init(NULL) == NULL);
+} END_TEST
+
+START_TEST (test_release) {
+	struct test_session	*session;
+	TALLOC_CTX		*call_ctx;
+
+	session = new_session("alice");
+
+	/* Releasing the session rejects the parked wait */
+	park(session, 60);
+	talloc_free(session->mstore_ctx);
+	ck_assert(session->call.done);
+	ck_assert_int_eq(session->call.retval, ecRejected);
+
+	/* Releasing the call cancels the wait */
+	session = new_session("alice");
+	call_ctx = talloc_new(session);
+	memset(&session->call, 0, sizeof (struct test_call));
+	ck_assert_int_eq(emsmdbp_async_wait(call_ctx, session->async_ctx, g_ev, 60,
+					    call_done, &session->call), MAPI_E_SUCCESS);
+	talloc_free(call_ctx);
+	ck_assert(session->async_ctx->wait == NULL);
+	push_newmail(session, 0x200);
+	spin();
+	ck_assert(!session->call.done);
+	ck_assert_int_eq(g_completed, 1);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v Performance test ----------------------------------------------------------
+
+/* Park a wait for many sessions, wake some of them and let the others
+   time out. The event loop sleeps in between: the waits do not use
+   any CPU. */
+START_TEST (test_benchmark_idle_waits) {
+	struct test_session	**sessions;
+	struct timespec		start;
+	double			cpu_start;
+	double			wakeup_ms, wait_ms, cpu_ms;
+	char			username[16];
+	uint32_t		i;
+
+	sessions = talloc_array(g_mem_ctx, struct test_session *, BENCHMARK_SESSIONS);
+	for (i = 0; i < BENCHMARK_SESSIONS; i++) {
+		snprintf(username, sizeof (username), "user%u", i);
+		sessions[i] = new_session(username);
+		park(sessions[i], BENCHMARK_TIMEOUT);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	cpu_start = cpu_time();
+
+	for (i = 0; i < BENCHMARK_NOTIFIED; i++) {
+		push_newmail(sessions[i * (BENCHMARK_SESSIONS / BENCHMARK_NOTIFIED)], i);
+	}
+	loop_until(BENCHMARK_NOTIFIED);
+	wakeup_ms = testsuite_elapsed_ms(&start);
+
+	loop_until(BENCHMARK_SESSIONS);
+	wait_ms = testsuite_elapsed_ms(&start);
+	cpu_ms = cpu_time() - cpu_start;
+
+	for (i = 0; i < BENCHMARK_SESSIONS; i++) {
+		ck_assert(sessions[i]->call.done);
+		ck_assert_int_eq(sessions[i]->call.flags, (i % (BENCHMARK_SESSIONS / BENCHMARK_NOTIFIED)) ?
+				 0 : EMSMDBP_ASYNC_NOTIFICATION_PENDING);
+	}
+	ck_assert(wait_ms >= (BENCHMARK_TIMEOUT * 1000 - 100));
+	ck_assert(cpu_ms < wait_ms / 4);
+
+	testsuite_benchmark_report("%u async waits: %u woken in %.1f ms, all completed in %.0f ms using %.1f ms of CPU\n",
+	                           BENCHMARK_SESSIONS, BENCHMARK_NOTIFIED, wakeup_ms, wait_ms, cpu_ms);
+} END_TEST
+
+// ^ performance tests ---------------------------------------------------------
+
+static void emsmdbp_async_setup(void)
+{
+	g_mem_ctx = talloc_named(NULL, 0, "emsmdbp_async_setup");
+	g_ev = tevent_context_init(g_mem_ctx);
+	ck_assert(g_ev != NULL);
+	g_completed = 0;
+}
+
+static void emsmdbp_async_teardown(void)
+{
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_async_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+	TCase	*tc_perf;
+
+	s = suite_create("mapiproxy: EMSMDBP async waits");
+
+	tc = tcase_create("async waits interface");
+	tcase_add_checked_fixture(tc, emsmdbp_async_setup, emsmdbp_async_teardown);
+	tcase_add_test(tc, test_wakeup);
+	tcase_add_test(tc, test_timeout);
+	tcase_add_test(tc, test_supersede);
+	tcase_add_test(tc, test_release);
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		tc_perf = tcase_create("async waits performance");
+		tcase_add_checked_fixture(tc_perf, emsmdbp_async_setup, emsmdbp_async_teardown);
+		tcase_set_timeout(tc_perf, 600);
+		tcase_add_test(tc_perf, test_benchmark_idle_waits);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
@@ -0,0 +1,500 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+
+#include "mapiproxy/servers/default/emsmdb/emsmdbp_rop.c"
+
+#define	TEST_HANDLES	2
+
+/* Global test variables */
+static TALLOC_CTX	*g_mem_ctx;
+static const char	*g_handler;
+
+/* The ROP handlers only record they were called */
+#define	ROP_STUB(name)							\
+enum MAPISTATUS EcDoRpc_##name(TALLOC_CTX *mem_ctx,			\
+			       struct emsmdbp_context *emsmdbp_ctx,	\
+			       struct EcDoRpc_MAPI_REQ *mapi_req,	\
+			       struct EcDoRpc_MAPI_REPL *mapi_repl,	\
+			       uint32_t *handles, uint16_t *size)	\
+{									\
+	g_handler = #name;						\
+	mapi_repl->opnum = mapi_req->opnum;				\
+	mapi_repl->handle_idx = mapi_req->handle_idx;			\
+	mapi_repl->error_code = MAPI_E_SUCCESS;				\
+	*size += SIZE_DFLT_MAPI_RESPONSE;				\
+	return MAPI_E_SUCCESS;						\
+}
+
+enum MAPISTATUS EcDoRpc_RopRelease(TALLOC_CTX *mem_ctx,
+				   struct emsmdbp_context *emsmdbp_ctx,
+				   struct EcDoRpc_MAPI_REQ *mapi_req,
+				   uint32_t *handles, uint16_t *size)
+{
+	g_handler = "RopRelease";
+	return MAPI_E_SUCCESS;
+}
+
+ROP_STUB(RopCommitStream)
+ROP_STUB(RopCopyFolder)
+ROP_STUB(RopCopyTo)
+ROP_STUB(RopCreateAttach)
+ROP_STUB(RopCreateFolder)
+ROP_STUB(RopCreateMessage)
+ROP_STUB(RopDeleteFolder)
+ROP_STUB(RopDeleteMessages)
+ROP_STUB(RopDeleteProperties)
+ROP_STUB(RopDeletePropertiesNoReplicate)
+ROP_STUB(RopEmptyFolder)
+ROP_STUB(RopFastTransferSourceCopyTo)
+ROP_STUB(RopFastTransferSourceGetBuffer)
+ROP_STUB(RopFindRow)
+ROP_STUB(RopGetAddressTypes)
+ROP_STUB(RopGetAttachmentTable)
+ROP_STUB(RopGetContentsTable)
+ROP_STUB(RopGetHierarchyTable)
+ROP_STUB(RopGetLocalReplicaIds)
+ROP_STUB(RopGetMessageStatus)
+ROP_STUB(RopGetNamesFromIDs)
+ROP_STUB(RopGetPerUserGuid)
+ROP_STUB(RopGetPerUserLongTermIds)
+ROP_STUB(RopGetPermissionsTable)
+ROP_STUB(RopGetPropertiesAll)
+ROP_STUB(RopGetPropertiesList)
+ROP_STUB(RopGetPropertiesSpecific)
+ROP_STUB(RopGetPropertyIdsFromNames)
+ROP_STUB(RopGetReceiveFolder)
+ROP_STUB(RopGetReceiveFolderTable)
+ROP_STUB(RopGetRulesTable)
+ROP_STUB(RopGetSearchCriteria)
+ROP_STUB(RopGetStoreState)
+ROP_STUB(RopGetStreamSize)
+ROP_STUB(RopGetTransportFolder)
+ROP_STUB(RopIdFromLongTermId)
+ROP_STUB(RopLogon)
+ROP_STUB(RopLongTermIdFromId)
+ROP_STUB(RopModifyPermissions)
+ROP_STUB(RopModifyRecipients)
+ROP_STUB(RopModifyRules)
+ROP_STUB(RopMoveCopyMessages)
+ROP_STUB(RopMoveFolder)
+ROP_STUB(RopOpenAttach)
+ROP_STUB(RopOpenEmbeddedMessage)
+ROP_STUB(RopOpenFolder)
+ROP_STUB(RopOpenMessage)
+ROP_STUB(RopOpenStream)
+ROP_STUB(RopOptionsData)
+ROP_STUB(RopQueryPosition)
+ROP_STUB(RopQueryRows)
+ROP_STUB(RopReadPerUserInformation)
+ROP_STUB(RopReadStream)
+ROP_STUB(RopRegisterNotification)
+ROP_STUB(RopReloadCachedInformation)
+ROP_STUB(RopRemoveAllRecipients)
+ROP_STUB(RopResetTable)
+ROP_STUB(RopRestrict)
+ROP_STUB(RopSaveChangesAttachment)
+ROP_STUB(RopSaveChangesMessage)
+ROP_STUB(RopSeekRow)
+ROP_STUB(RopSeekStream)
+ROP_STUB(RopSetColumns)
+ROP_STUB(RopSetLocalReplicaMidsetDeleted)
+ROP_STUB(RopSetMessageReadFlag)
+ROP_STUB(RopSetProperties)
+ROP_STUB(RopSetReceiveFolder)
+ROP_STUB(RopSetSearchCriteria)
+ROP_STUB(RopSetSpooler)
+ROP_STUB(RopSetStreamSize)
+ROP_STUB(RopSortTable)
+ROP_STUB(RopSubmitMessage)
+ROP_STUB(RopSyncConfigure)
+ROP_STUB(RopSyncGetTransferState)
+ROP_STUB(RopSyncImportDeletes)
+ROP_STUB(RopSyncImportHierarchyChange)
+ROP_STUB(RopSyncImportMessageChange)
+ROP_STUB(RopSyncImportMessageMove)
+ROP_STUB(RopSyncImportReadStateChanges)
+ROP_STUB(RopSyncOpenCollector)
+ROP_STUB(RopSyncUploadStateStreamBegin)
+ROP_STUB(RopSyncUploadStateStreamContinue)
+ROP_STUB(RopSyncUploadStateStreamEnd)
+ROP_STUB(RopTransportSend)
+ROP_STUB(RopWriteStream)
+
+/* Every opnum of exchange.idl and the handler it is dispatched to */
+static const struct {
+	uint8_t		opnum;
+	const char	*handler;
+} idl_opnums[] = {
+	{ op_MAPI_Release,				"RopRelease" },
+	{ op_MAPI_OpenFolder,				"RopOpenFolder" },
+	{ op_MAPI_OpenMessage,				"RopOpenMessage" },
+	{ op_MAPI_GetHierarchyTable,			"RopGetHierarchyTable" },
+	{ op_MAPI_GetContentsTable,			"RopGetContentsTable" },
+	{ op_MAPI_CreateMessage,			"RopCreateMessage" },
+	{ op_MAPI_GetProps,				"RopGetPropertiesSpecific" },
+	{ op_MAPI_GetPropsAll,				"RopGetPropertiesAll" },
+	{ op_MAPI_GetPropList,				"RopGetPropertiesList" },
+	{ op_MAPI_SetProps,				"RopSetProperties" },
+	{ op_MAPI_DeleteProps,				"RopDeleteProperties" },
+	{ op_MAPI_SaveChangesMessage,			"RopSaveChangesMessage" },
+	{ op_MAPI_RemoveAllRecipients,			"RopRemoveAllRecipients" },
+	{ op_MAPI_ModifyRecipients,			"RopModifyRecipients" },
+	{ op_MAPI_ReadRecipients,			NULL },
+	{ op_MAPI_ReloadCachedInformation,		"RopReloadCachedInformation" },
+	{ op_MAPI_SetMessageReadFlag,			"RopSetMessageReadFlag" },
+	{ op_MAPI_SetColumns,				"RopSetColumns" },
+	{ op_MAPI_SortTable,				"RopSortTable" },
+	{ op_MAPI_Restrict,				"RopRestrict" },
+	{ op_MAPI_QueryRows,				"RopQueryRows" },
+	{ op_MAPI_GetStatus,				NULL },
+	{ op_MAPI_QueryPosition,			"RopQueryPosition" },
+	{ op_MAPI_SeekRow,				"RopSeekRow" },
+	{ op_MAPI_SeekRowBookmark,			NULL },
+	{ op_MAPI_SeekRowApprox,			NULL },
+	{ op_MAPI_CreateBookmark,			NULL },
+	{ op_MAPI_CreateFolder,				"RopCreateFolder" },
+	{ op_MAPI_DeleteFolder,				"RopDeleteFolder" },
+	{ op_MAPI_DeleteMessages,			"RopDeleteMessages" },
+	{ op_MAPI_GetMessageStatus,			"RopGetMessageStatus" },
+	{ op_MAPI_SetMessageStatus,			NULL },
+	{ op_MAPI_GetAttachmentTable,			"RopGetAttachmentTable" },
+	{ op_MAPI_OpenAttach,				"RopOpenAttach" },
+	{ op_MAPI_CreateAttach,				"RopCreateAttach" },
+	{ op_MAPI_DeleteAttach,				NULL },
+	{ op_MAPI_SaveChangesAttachment,		"RopSaveChangesAttachment" },
+	{ op_MAPI_SetReceiveFolder,			"RopSetReceiveFolder" },
+	{ op_MAPI_GetReceiveFolder,			"RopGetReceiveFolder" },
+	{ op_MAPI_RegisterNotification,			"RopRegisterNotification" },
+	{ op_MAPI_Notify,				NULL },
+	{ op_MAPI_OpenStream,				"RopOpenStream" },
+	{ op_MAPI_ReadStream,				"RopReadStream" },
+	{ op_MAPI_WriteStream,				"RopWriteStream" },
+	{ op_MAPI_SeekStream,				"RopSeekStream" },
+	{ op_MAPI_SetStreamSize,			"RopSetStreamSize" },
+	{ op_MAPI_SetSearchCriteria,			"RopSetSearchCriteria" },
+	{ op_MAPI_GetSearchCriteria,			"RopGetSearchCriteria" },
+	{ op_MAPI_SubmitMessage,			"RopSubmitMessage" },
+	{ op_MAPI_MoveCopyMessages,			"RopMoveCopyMessages" },
+	{ op_MAPI_AbortSubmit,				NULL },
+	{ op_MAPI_MoveFolder,				"RopMoveFolder" },
+	{ op_MAPI_CopyFolder,				"RopCopyFolder" },
+	{ op_MAPI_QueryColumnsAll,			NULL },
+	{ op_MAPI_Abort,				NULL },
+	{ op_MAPI_CopyTo,				"RopCopyTo" },
+	{ op_MAPI_CopyToStream,				NULL },
+	{ op_MAPI_CloneStream,				NULL },
+	{ op_MAPI_GetPermissionsTable,			"RopGetPermissionsTable" },
+	{ op_MAPI_GetRulesTable,			"RopGetRulesTable" },
+	{ op_MAPI_ModifyPermissions,			"RopModifyPermissions" },
+	{ op_MAPI_ModifyRules,				"RopModifyRules" },
+	{ op_MAPI_GetOwningServers,			NULL },
+	{ op_MAPI_LongTermIdFromId,			"RopLongTermIdFromId" },
+	{ op_MAPI_IdFromLongTermId,			"RopIdFromLongTermId" },
+	{ op_MAPI_PublicFolderIsGhosted,		NULL },
+	{ op_MAPI_OpenEmbeddedMessage,			"RopOpenEmbeddedMessage" },
+	{ op_MAPI_SetSpooler,				"RopSetSpooler" },
+	{ op_MAPI_SpoolerLockMessage,			NULL },
+	{ op_MAPI_AddressTypes,				"RopGetAddressTypes" },
+	{ op_MAPI_TransportSend,			"RopTransportSend" },
+	{ op_MAPI_FastTransferSourceCopyMessages,	NULL },
+	{ op_MAPI_FastTransferSourceCopyFolder,		NULL },
+	{ op_MAPI_FastTransferSourceCopyTo,		"RopFastTransferSourceCopyTo" },
+	{ op_MAPI_FastTransferSourceGetBuffer,		"RopFastTransferSourceGetBuffer" },
+	{ op_MAPI_FindRow,				"RopFindRow" },
+	{ op_MAPI_Progress,				NULL },
+	{ op_MAPI_TransportNewMail,			NULL },
+	{ op_MAPI_GetValidAttachments,			NULL },
+	{ op_MAPI_FastTransferDestConfigure,		NULL },
+	{ op_MAPI_FastTransferDestPutBuffer,		NULL },
+	{ op_MAPI_GetNamesFromIDs,			"RopGetNamesFromIDs" },
+	{ op_MAPI_GetIDsFromNames,			"RopGetPropertyIdsFromNames" },
+	{ op_MAPI_UpdateDeferredActionMessages,		NULL },
+	{ op_MAPI_EmptyFolder,				"RopEmptyFolder" },
+	{ op_MAPI_ExpandRow,				NULL },
+	{ op_MAPI_CollapseRow,				NULL },
+	{ op_MAPI_LockRegionStream,			NULL },
+	{ op_MAPI_UnlockRegionStream,			NULL },
+	{ op_MAPI_CommitStream,				"RopCommitStream" },
+	{ op_MAPI_GetStreamSize,			"RopGetStreamSize" },
+	{ op_MAPI_QueryNamedProperties,			NULL },
+	{ op_MAPI_GetPerUserLongTermIds,		"RopGetPerUserLongTermIds" },
+	{ op_MAPI_GetPerUserGuid,			"RopGetPerUserGuid" },
+	{ op_MAPI_ReadPerUserInformation,		"RopReadPerUserInformation" },
+	{ op_MAPI_WritePerUserInformation,		NULL },
+	{ op_MAPI_SetReadFlags,				NULL },
+	{ op_MAPI_CopyProperties,			NULL },
+	{ op_MAPI_GetReceiveFolderTable,		"RopGetReceiveFolderTable" },
+	{ op_MAPI_FastTransferSourceCopyProps,		NULL },
+	{ op_MAPI_GetCollapseState,			NULL },
+	{ op_MAPI_SetCollapseState,			NULL },
+	{ op_MAPI_GetTransportFolder,			"RopGetTransportFolder" },
+	{ op_MAPI_Pending,				NULL },
+	{ op_MAPI_OptionsData,				"RopOptionsData" },
+	{ op_MAPI_SyncConfigure,			"RopSyncConfigure" },
+	{ op_MAPI_SyncImportMessageChange,		"RopSyncImportMessageChange" },
+	{ op_MAPI_SyncImportHierarchyChange,		"RopSyncImportHierarchyChange" },
+	{ op_MAPI_SyncImportDeletes,			"RopSyncImportDeletes" },
+	{ op_MAPI_SyncUploadStateStreamBegin,		"RopSyncUploadStateStreamBegin" },
+	{ op_MAPI_SyncUploadStateStreamContinue,	"RopSyncUploadStateStreamContinue" },
+	{ op_MAPI_SyncUploadStateStreamEnd,		"RopSyncUploadStateStreamEnd" },
+	{ op_MAPI_SyncImportMessageMove,		"RopSyncImportMessageMove" },
+	{ op_MAPI_SetPropertiesNoReplicate,		NULL },
+	{ op_MAPI_DeletePropertiesNoReplicate,		"RopDeletePropertiesNoReplicate" },
+	{ op_MAPI_GetStoreState,			"RopGetStoreState" },
+	{ op_MAPI_SyncOpenCollector,			"RopSyncOpenCollector" },
+	{ op_MAPI_GetLocalReplicaIds,			"RopGetLocalReplicaIds" },
+	{ op_MAPI_SyncImportReadStateChanges,		"RopSyncImportReadStateChanges" },
+	{ op_MAPI_ResetTable,				"RopResetTable" },
+	{ op_MAPI_SyncGetTransferState,			"RopSyncGetTransferState" },
+	{ op_MAPI_SyncOpenAdvisor,			NULL },
+	{ op_MAPI_TellVersion,				NULL },
+	{ op_MAPI_OpenPublicFolderByName,		NULL },
+	{ op_MAPI_SetSyncNotificationGuid,		NULL },
+	{ op_MAPI_FreeBookmark,				NULL },
+	{ op_MAPI_WriteAndCommitStream,			NULL },
+	{ op_MAPI_HardDeleteMessages,			NULL },
+	{ op_MAPI_HardDeleteMessagesAndSubfolders,	NULL },
+	{ op_MAPI_SetLocalReplicaMidsetDeleted,		"RopSetLocalReplicaMidsetDeleted" },
+	{ op_MAPI_Backoff,				NULL },
+	{ op_MAPI_Logon,				"RopLogon" },
+	{ op_MAPI_BufferTooSmall,			NULL },
+	{ op_MAPI_proxypack,				NULL },
+	{ 0,						NULL }
+};
+
+
+static struct EcDoRpc_MAPI_REPL dispatch(uint8_t opnum, uint8_t handle_idx, uint8_t req_handle_idx,
+					 enum MAPISTATUS *retval, uint16_t *size)
+{
+	const struct emsmdbp_rop	*rop;
+	struct EcDoRpc_MAPI_REQ		mapi_req;
+	struct EcDoRpc_MAPI_REPL	mapi_repl;
+	uint32_t			handles[TEST_HANDLES] = { 0x1, 0x2 };
+
+	memset(&mapi_req, 0, sizeof (struct EcDoRpc_MAPI_REQ));
+	memset(&mapi_repl, 0, sizeof (struct EcDoRpc_MAPI_REPL));
+	mapi_req.opnum = opnum;
+	mapi_req.handle_idx = handle_idx;
+	rop = emsmdbp_rop_lookup(opnum);
+	if (rop && rop->handle_idx_fn) {
+		*rop->handle_idx_fn(&mapi_req) = req_handle_idx;
+	}
+
+	g_handler = NULL;
+	*retval = emsmdbp_rop_dispatch(g_mem_ctx, NULL, rop, &mapi_req, &mapi_repl,
+				       handles, TEST_HANDLES, size);
+
+	return mapi_repl;
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_lookup) {
+	const struct emsmdbp_rop	*rop;
+	uint32_t			i;
+	uint32_t			implemented = 0;
+
+	for (i = 0; idl_opnums[i].opnum; i++) {
+		rop = emsmdbp_rop_lookup(idl_opnums[i].opnum);
+		if (!idl_opnums[i].handler) {
+			ck_assert_msg(rop == NULL, "0x%.2x should not be implemented", idl_opnums[i].opnum);
+			continue;
+		}
+		ck_assert_msg(rop != NULL, "0x%.2x should be implemented", idl_opnums[i].opnum);
+		ck_assert_int_eq(rop->opnum, idl_opnums[i].opnum);
+		ck_assert(rop->name != NULL);
+		ck_assert(rop->handler != NULL);
+		implemented++;
+	}
+
+	/* Opnums outside exchange.idl have no entry */
+	for (i = 0; i < EMSMDBP_ROP_OPNUMS; i++) {
+		rop = emsmdbp_rop_lookup(i);
+		if (rop) {
+			ck_assert_int_eq(rop->opnum, i);
+			implemented--;
+		}
+	}
+	ck_assert_int_eq(implemented, 0);
+} END_TEST
+
+START_TEST (test_dispatch) {
+	struct EcDoRpc_MAPI_REPL	mapi_repl;
+	struct ndr_push			*ndr;
+	enum MAPISTATUS			retval;
+	uint16_t			size;
+	uint32_t			i;
+
+	for (i = 0; idl_opnums[i].opnum; i++) {
+		size = 0;
+		mapi_repl = dispatch(idl_opnums[i].opnum, 1, 0, &retval, &size);
+
+		if (idl_opnums[i].handler) {
+			ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+			ck_assert_msg(g_handler && !strcmp(g_handler, idl_opnums[i].handler),
+				      "0x%.2x dispatched to %s instead of %s", idl_opnums[i].opnum,
+				      g_handler, idl_opnums[i].handler);
+			if (idl_opnums[i].opnum != op_MAPI_Release) {
+				ck_assert_int_eq(mapi_repl.opnum, idl_opnums[i].opnum);
+			}
+			continue;
+		}
+
+		/* Uniform error reply */
+		ck_assert(g_handler == NULL);
+		ck_assert_int_eq(retval, MAPI_E_NO_SUPPORT);
+		ck_assert_int_eq(mapi_repl.opnum, idl_opnums[i].opnum);
+		ck_assert_int_eq(mapi_repl.handle_idx, 1);
+		ck_assert_int_eq(mapi_repl.error_code, MAPI_E_NO_SUPPORT);
+		ck_assert_int_eq(size, SIZE_DFLT_MAPI_RESPONSE);
+
+		/* Notify and Pending replies have no error code */
+		if (idl_opnums[i].opnum == op_MAPI_Notify || idl_opnums[i].opnum == op_MAPI_Pending) continue;
+
+		ndr = ndr_push_init_ctx(g_mem_ctx);
+		ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+		ck_assert_int_eq(ndr_push_EcDoRpc_MAPI_REPL(ndr, NDR_SCALARS, &mapi_repl), NDR_ERR_SUCCESS);
+		ck_assert_int_eq(ndr->offset, size);
+		ck_assert_int_eq(ndr->data[0], idl_opnums[i].opnum);
+		ck_assert_int_eq(ndr->data[1], 1);
+		ck_assert_int_eq(ndr->data[2] | (ndr->data[3] << 8) | (ndr->data[4] << 16)
+				 | ((uint32_t) ndr->data[5] << 24), MAPI_E_NO_SUPPORT);
+		talloc_free(ndr);
+	}
+} END_TEST
+
+START_TEST (test_handle_idx) {
+	struct EcDoRpc_MAPI_REQ		mapi_req;
+	struct EcDoRpc_MAPI_REPL	mapi_repl;
+	enum MAPISTATUS			retval;
+	uint16_t			size;
+
+	/* Handle index of the ROP */
+	size = 0;
+	mapi_repl = dispatch(op_MAPI_GetProps, TEST_HANDLES, 0, &retval, &size);
+	ck_assert(g_handler == NULL);
+	ck_assert_int_eq(retval, ecNullObject);
+	ck_assert_int_eq(mapi_repl.opnum, op_MAPI_GetProps);
+	ck_assert_int_eq(mapi_repl.error_code, ecNullObject);
+	ck_assert_int_eq(size, SIZE_DFLT_MAPI_RESPONSE);
+
+	/* Handle index of the request */
+	size = 0;
+	mapi_repl = dispatch(op_MAPI_OpenFolder, 0, TEST_HANDLES, &retval, &size);
+	ck_assert(g_handler == NULL);
+	ck_assert_int_eq(mapi_repl.error_code, ecNullObject);
+
+	size = 0;
+	mapi_repl = dispatch(op_MAPI_OpenFolder, 0, TEST_HANDLES - 1, &retval, &size);
+	ck_assert_str_eq(g_handler, "RopOpenFolder");
+	ck_assert_int_eq(mapi_repl.error_code, MAPI_E_SUCCESS);
+
+	/* Accessors return the field of their own request */
+	memset(&mapi_req, 0, sizeof (struct EcDoRpc_MAPI_REQ));
+	ck_assert(emsmdbp_rop_lookup(op_MAPI_GetProps)->handle_idx_fn == NULL);
+	ck_assert(emsmdbp_rop_lookup(op_MAPI_OpenFolder)->handle_idx_fn(&mapi_req) == &mapi_req.u.mapi_OpenFolder.handle_idx);
+	ck_assert(emsmdbp_rop_lookup(op_MAPI_CopyTo)->handle_idx_fn(&mapi_req) == &mapi_req.u.mapi_CopyTo.handle_idx);
+	ck_assert(emsmdbp_rop_lookup(op_MAPI_SyncConfigure)->handle_idx_fn(&mapi_req) == &mapi_req.u.mapi_SyncConfigure.handle_idx);
+
+	/* RopRelease has no reply */
+	size = 0;
+	mapi_repl = dispatch(op_MAPI_Release, 0xff, 0, &retval, &size);
+	ck_assert(g_handler == NULL);
+	ck_assert_int_eq(retval, ecNullObject);
+	ck_assert_int_eq(mapi_repl.opnum, 0);
+	ck_assert_int_eq(size, 0);
+} END_TEST
+
+START_TEST (test_size) {
+	struct mapi_request	mapi_request;
+	struct EcDoRpc_MAPI_REQ	mapi_req[5];
+	uint32_t		i;
+
+	memset(&mapi_request, 0, sizeof (struct mapi_request));
+	memset(mapi_req, 0, sizeof (mapi_req));
+	mapi_request.mapi_req = mapi_req;
+	mapi_request.length = 2 + 4 * 4;
+	mapi_request.mapi_len = mapi_request.length + sizeof (uint32_t);
+
+	mapi_req[0].opnum = op_MAPI_Release;
+	mapi_req[1].opnum = op_MAPI_GetProps;
+	mapi_req[2].opnum = op_MAPI_QueryRows;
+	mapi_req[2].u.mapi_QueryRows.RowCount = 100;
+	mapi_req[3].opnum = op_MAPI_ReadStream;
+	mapi_req[3].u.mapi_ReadStream.ByteCount = 0xBABE;
+	mapi_req[3].u.mapi_ReadStream.MaximumByteCount.value = 0x10000;
+	ck_assert_int_eq(emsmdbp_rop_size(&mapi_request),
+			 EMSMDBP_ROP_SIZE_SMALL + EMSMDBP_ROP_SIZE_DEFAULT
+			 + EMSMDBP_ROP_SIZE_DEFAULT + 100 * EMSMDBP_ROP_SIZE_PER_ROW
+			 + EMSMDBP_ROP_SIZE_DEFAULT + 0x10000);
+
+	/* Unimplemented ROPs only get an error reply */
+	mapi_req[1].opnum = op_MAPI_SeekRowBookmark;
+	ck_assert_int_eq(emsmdbp_rop_size(&mapi_request),
+			 EMSMDBP_ROP_SIZE_SMALL + EMSMDBP_ROP_SIZE_SMALL
+			 + EMSMDBP_ROP_SIZE_DEFAULT + 100 * EMSMDBP_ROP_SIZE_PER_ROW
+			 + EMSMDBP_ROP_SIZE_DEFAULT + 0x10000);
+
+	/* The estimate is bounded */
+	for (i = 0; i < 4; i++) {
+		mapi_req[i].opnum = op_MAPI_QueryRows;
+		mapi_req[i].u.mapi_QueryRows.RowCount = 0xFFFF;
+	}
+	ck_assert_int_eq(emsmdbp_rop_size(&mapi_request), EMSMDBP_TRANSACTION_POOL_MAX);
+
+	/* Idle requests */
+	mapi_request.length = 2;
+	mapi_request.mapi_len = 2;
+	ck_assert_int_eq(emsmdbp_rop_size(&mapi_request), 0);
+	ck_assert_int_eq(emsmdbp_rop_size(NULL), 0);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void emsmdbp_rop_setup(void)
+{
+	g_mem_ctx = talloc_named(NULL, 0, "emsmdbp_rop_setup");
+}
+
+static void emsmdbp_rop_teardown(void)
+{
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_rop_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+
+	s = suite_create("mapiproxy: EMSMDBP ROP dispatch table");
+
+	tc = tcase_create("ROP dispatch table interface");
+	tcase_add_checked_fixture(tc, emsmdbp_rop_setup, emsmdbp_rop_teardown);
+	tcase_add_test(tc, test_lookup);
+	tcase_add_test(tc, test_dispatch);
+	tcase_add_test(tc, test_handle_idx);
+	tcase_add_test(tc, test_size);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
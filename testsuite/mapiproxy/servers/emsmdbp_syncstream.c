@@ -0,0 +1,369 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include <time.h>
+#include <sys/resource.h>
+
+#include "mapiproxy/servers/default/emsmdb/emsmdbp_syncstream.c"
+
+#define	TEST_MESSAGES		500
+#define	BENCHMARK_MESSAGES	100000
+#define	BENCHMARK_BUFFER_SIZE	0x7fe0
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+
+/*
+  Synthetic message stream: each message is a 4 bytes marker, a 36
+  bytes header and a variable size body, with a cutmark after each of
+  them. A byte value only depends on its offset in the whole stream.
+ */
+struct test_producer {
+	uint32_t	messages;
+	uint32_t	next;
+	bool		eager;
+	bool		scribble;
+
+	uint64_t	chunk_offset;
+	uint8_t		*data;
+	uint32_t	length;
+	uint32_t	*cutmarks;
+	uint32_t	cutmarks_count;
+
+	uint32_t	fills;
+	uint32_t	max_chunk;
+};
+
+
+static long peak_rss(void)
+{
+	struct rusage	usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+static uint8_t stream_byte(uint64_t offset)
+{
+	return (uint8_t) (offset % 251);
+}
+
+static void producer_push(struct test_producer *producer, uint32_t length, uint32_t min_size)
+{
+	uint32_t	i;
+
+	producer->data = talloc_realloc(mem_ctx, producer->data, uint8_t, producer->length + length);
+	for (i = 0; i < length; i++) {
+		producer->data[producer->length + i] = stream_byte(producer->chunk_offset + producer->length + i);
+	}
+	producer->length += length;
+
+	producer->cutmarks = talloc_realloc(mem_ctx, producer->cutmarks, uint32_t, producer->cutmarks_count + 2);
+	producer->cutmarks[producer->cutmarks_count++] = min_size;
+	producer->cutmarks[producer->cutmarks_count++] = producer->length;
+}
+
+static bool producer_fill(struct emsmdbp_syncstream *syncstream, uint32_t min_size, void *private_data)
+{
+	struct test_producer	*producer = private_data;
+	DATA_BLOB		chunk;
+
+	if (producer->next == producer->messages && producer->data) {
+		return false;
+	}
+
+	/* Make sure nothing still points to the previous chunk */
+	if (producer->data) {
+		if (producer->scribble) {
+			memset(producer->data, 0xaa, producer->length);
+		}
+		producer->chunk_offset += producer->length;
+		talloc_free(producer->data);
+		talloc_free(producer->cutmarks);
+	}
+	producer->data = talloc_array(mem_ctx, uint8_t, 0);
+	producer->cutmarks = talloc_array(mem_ctx, uint32_t, 0);
+	producer->length = 0;
+	producer->cutmarks_count = 0;
+
+	while (producer->next < producer->messages && (producer->eager || producer->length < min_size)) {
+		producer_push(producer, 4, 0);
+		producer_push(producer, 36, 0);
+		producer_push(producer, 300 + (producer->next % 200), 8);
+		producer->next++;
+	}
+
+	producer->cutmarks = talloc_realloc(mem_ctx, producer->cutmarks, uint32_t, producer->cutmarks_count + 2);
+	producer->cutmarks[producer->cutmarks_count] = 0;
+	producer->cutmarks[producer->cutmarks_count + 1] = 0xffffffff;
+
+	producer->fills++;
+	if (producer->length > producer->max_chunk) {
+		producer->max_chunk = producer->length;
+	}
+
+	chunk.data = producer->data;
+	chunk.length = producer->length;
+	emsmdbp_syncstream_set_chunk(syncstream, chunk, producer->cutmarks, producer->next == producer->messages);
+
+	return true;
+}
+
+static void producer_init(struct test_producer *producer, uint32_t messages, bool eager)
+{
+	memset(producer, 0, sizeof (struct test_producer));
+	producer->messages = messages;
+	producer->eager = eager;
+}
+
+static void producer_release(struct test_producer *producer)
+{
+	talloc_free(producer->data);
+	talloc_free(producer->cutmarks);
+}
+
+/* Read a whole stream and check it against the synthetic one */
+static uint64_t read_stream(struct test_producer *producer, uint32_t buffer_size)
+{
+	struct emsmdbp_syncstream	syncstream;
+	TALLOC_CTX			*local_mem_ctx;
+	DATA_BLOB			buffer;
+	uint64_t			offset = 0;
+	uint32_t			i;
+
+	memset(&syncstream, 0, sizeof (struct emsmdbp_syncstream));
+	while (!emsmdbp_syncstream_done(&syncstream)) {
+		local_mem_ctx = talloc_new(mem_ctx);
+		buffer = emsmdbp_syncstream_read(local_mem_ctx, &syncstream, buffer_size, producer_fill, producer);
+		ck_assert(buffer.length <= buffer_size);
+		if (!emsmdbp_syncstream_done(&syncstream)) {
+			ck_assert(buffer.length > 0);
+		}
+		for (i = 0; i < buffer.length; i++) {
+			ck_assert_int_eq(buffer.data[i], stream_byte(offset + i));
+		}
+		offset += buffer.length;
+		talloc_free(local_mem_ctx);
+	}
+
+	return offset;
+}
+
+static uint64_t stream_length(uint32_t messages)
+{
+	uint64_t	length = 0;
+	uint32_t	i;
+
+	for (i = 0; i < messages; i++) {
+		length += 4 + 36 + 300 + (i % 200);
+	}
+
+	return length;
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_pull_matches_eager) {
+	struct test_producer	producer;
+	uint32_t		sizes[] = { 16, 100, 1000, 4096, 32768, 1048576 };
+	uint32_t		i;
+
+	producer_init(&producer, TEST_MESSAGES, true);
+	ck_assert(read_stream(&producer, 4096) == stream_length(TEST_MESSAGES));
+	ck_assert_int_eq(producer.fills, 1);
+	producer_release(&producer);
+
+	for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++) {
+		producer_init(&producer, TEST_MESSAGES, false);
+		ck_assert(read_stream(&producer, sizes[i]) == stream_length(TEST_MESSAGES));
+		/* a chunk never holds more than the request and one message */
+		ck_assert(producer.max_chunk < sizes[i] + 4 + 36 + 500);
+		producer_release(&producer);
+	}
+} END_TEST
+
+START_TEST (test_cutmarks) {
+	struct emsmdbp_syncstream	syncstream;
+	struct test_producer		producer;
+	DATA_BLOB			buffer;
+
+	/* 340 bytes message: cutmarks at 4, 40 and 340 */
+	producer_init(&producer, 1, false);
+	memset(&syncstream, 0, sizeof (struct emsmdbp_syncstream));
+
+	/* cut on the header end rather than inside the body */
+	buffer = emsmdbp_syncstream_read(mem_ctx, &syncstream, 45, producer_fill, &producer);
+	ck_assert_int_eq(buffer.length, 40);
+	ck_assert(!emsmdbp_syncstream_done(&syncstream));
+
+	/* no cutmark fits, the body is split */
+	buffer = emsmdbp_syncstream_read(mem_ctx, &syncstream, 100, producer_fill, &producer);
+	ck_assert_int_eq(buffer.length, 100);
+	buffer = emsmdbp_syncstream_read(mem_ctx, &syncstream, 1000, producer_fill, &producer);
+	ck_assert_int_eq(buffer.length, 200);
+	ck_assert(emsmdbp_syncstream_done(&syncstream));
+
+	buffer = emsmdbp_syncstream_read(mem_ctx, &syncstream, 1000, producer_fill, &producer);
+	ck_assert_int_eq(buffer.length, 0);
+	ck_assert_int_eq(producer.fills, 1);
+	producer_release(&producer);
+
+	/* the room left after the header holds the body minimum size */
+	producer_init(&producer, 1, false);
+	memset(&syncstream, 0, sizeof (struct emsmdbp_syncstream));
+	buffer = emsmdbp_syncstream_read(mem_ctx, &syncstream, 50, producer_fill, &producer);
+	ck_assert_int_eq(buffer.length, 50);
+	producer_release(&producer);
+} END_TEST
+
+START_TEST (test_joint_chunks) {
+	struct test_producer	producer;
+
+	/* a producer reusing its memory must not corrupt joint buffers */
+	producer_init(&producer, TEST_MESSAGES, false);
+	producer.scribble = true;
+	ck_assert(read_stream(&producer, 1000) == stream_length(TEST_MESSAGES));
+	ck_assert(producer.fills > 1);
+	producer_release(&producer);
+} END_TEST
+
+static uint32_t	short_fills;
+
+/* Produces chunks of at most 3 bytes, every other one empty */
+static bool short_fill(struct emsmdbp_syncstream *syncstream, uint32_t min_size, void *private_data)
+{
+	static uint8_t	data[3] = { 1, 2, 3 };
+	DATA_BLOB	chunk;
+
+	short_fills++;
+	chunk.data = data;
+	chunk.length = (short_fills % 2) ? 0 : sizeof (data);
+	emsmdbp_syncstream_set_chunk(syncstream, chunk, NULL, short_fills == 10);
+
+	return true;
+}
+
+static bool failing_fill(struct emsmdbp_syncstream *syncstream, uint32_t min_size, void *private_data)
+{
+	return false;
+}
+
+START_TEST (test_short_chunks) {
+	struct emsmdbp_syncstream	syncstream;
+	DATA_BLOB			buffer;
+
+	short_fills = 0;
+	memset(&syncstream, 0, sizeof (struct emsmdbp_syncstream));
+	buffer = emsmdbp_syncstream_read(mem_ctx, &syncstream, 8, short_fill, NULL);
+	ck_assert_int_eq(buffer.length, 8);
+	ck_assert(!emsmdbp_syncstream_done(&syncstream));
+	buffer = emsmdbp_syncstream_read(mem_ctx, &syncstream, 8, short_fill, NULL);
+	ck_assert_int_eq(buffer.length, 7);
+	ck_assert(emsmdbp_syncstream_done(&syncstream));
+	ck_assert_int_eq(short_fills, 10);
+
+	/* a producer giving up ends the stream */
+	memset(&syncstream, 0, sizeof (struct emsmdbp_syncstream));
+	buffer = emsmdbp_syncstream_read(mem_ctx, &syncstream, 8, failing_fill, NULL);
+	ck_assert_int_eq(buffer.length, 0);
+	ck_assert(emsmdbp_syncstream_done(&syncstream));
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+static void benchmark_stream(const char *label, bool eager)
+{
+	struct emsmdbp_syncstream	syncstream;
+	struct test_producer		producer;
+	struct timespec			start;
+	TALLOC_CTX			*local_mem_ctx;
+	DATA_BLOB			buffer;
+	double				first_ms = 0, total_ms;
+	uint64_t			length = 0;
+	uint32_t			calls = 0;
+	long				rss;
+
+	rss = peak_rss();
+	producer_init(&producer, BENCHMARK_MESSAGES, eager);
+	memset(&syncstream, 0, sizeof (struct emsmdbp_syncstream));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (!emsmdbp_syncstream_done(&syncstream)) {
+		local_mem_ctx = talloc_new(mem_ctx);
+		buffer = emsmdbp_syncstream_read(local_mem_ctx, &syncstream, BENCHMARK_BUFFER_SIZE, producer_fill, &producer);
+		if (!calls) {
+			first_ms = testsuite_elapsed_ms(&start);
+		}
+		length += buffer.length;
+		calls++;
+		talloc_free(local_mem_ctx);
+	}
+	total_ms = testsuite_elapsed_ms(&start);
+
+	ck_assert(length == stream_length(BENCHMARK_MESSAGES));
+	testsuite_benchmark_report("%s: %u messages, %"PRIu64" bytes in %u GetBuffer: first buffer %.2fms, total %.2fms, "
+	                           "largest chunk %u bytes, peak RSS +%ldKB\n", label, BENCHMARK_MESSAGES, length, calls,
+	                           first_ms, total_ms, producer.max_chunk, peak_rss() - rss);
+	producer_release(&producer);
+}
+
+START_TEST (test_benchmark_stream) {
+	/* peak RSS only grows, the pull stream has to go first */
+	benchmark_stream("pull sync stream", false);
+	benchmark_stream("eager sync stream", true);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+static void tc_syncstream_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "tc_syncstream_setup");
+}
+
+static void tc_syncstream_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_syncstream_suite(void)
+{
+	Suite *s = suite_create("emsmdbp sync stream");
+
+	TCase *tc = tcase_create("emsmdbp sync stream");
+	tcase_add_checked_fixture(tc, tc_syncstream_setup, tc_syncstream_teardown);
+	tcase_add_test(tc, test_pull_matches_eager);
+	tcase_add_test(tc, test_cutmarks);
+	tcase_add_test(tc, test_joint_chunks);
+	tcase_add_test(tc, test_short_chunks);
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create("emsmdbp sync stream performance");
+		tcase_add_checked_fixture(tc_perf, tc_syncstream_setup, tc_syncstream_teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_stream);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
@@ -0,0 +1,367 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include <time.h>
+
+#include "mapiproxy/servers/default/emsmdb/emsmdbp_transaction.c"
+
+#define	BENCHMARK_ROPS		50
+#define	BENCHMARK_PROPS		12
+#define	BENCHMARK_ROWS		10
+#define	BENCHMARK_ROUNDS	20000
+
+/* Memory estimate of the dispatch table for ROPs of the default size */
+#define	ROPS_SIZE(count)	((count) * EMSMDBP_ROP_SIZE_DEFAULT)
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct emsmdbp_transaction_stats	g_stats;
+
+
+static struct mapi_request *new_request(uint32_t rop_count)
+{
+	struct mapi_request	*mapi_request;
+	uint32_t		i;
+
+	mapi_request = talloc_zero(mem_ctx, struct mapi_request);
+	mapi_request->mapi_req = talloc_zero_array(mapi_request, struct EcDoRpc_MAPI_REQ, rop_count + 1);
+	for (i = 0; i < rop_count; i++) {
+		mapi_request->mapi_req[i].opnum = op_MAPI_GetProps;
+	}
+	mapi_request->length = 2 + rop_count * 8;
+	mapi_request->mapi_len = mapi_request->length + sizeof (uint32_t);
+
+	return mapi_request;
+}
+
+static void check_stats(uint64_t transactions, uint64_t rops, uint64_t overflows, uint64_t reply_resizes)
+{
+	struct emsmdbp_transaction_stats	stats;
+
+	ck_assert_int_eq(emsmdbp_transaction_get_stats(&stats), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stats.transactions - g_stats.transactions, transactions);
+	ck_assert_int_eq(stats.rops - g_stats.rops, rops);
+	ck_assert_int_eq(stats.overflows - g_stats.overflows, overflows);
+	ck_assert_int_eq(stats.reply_resizes - g_stats.reply_resizes, reply_resizes);
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_init_sizing) {
+	struct emsmdbp_transaction	*transaction;
+	struct mapi_request		*mapi_request;
+	uint32_t			i;
+
+	mapi_request = new_request(3);
+
+	transaction = emsmdbp_transaction_init(mem_ctx, mapi_request, EMSMDBP_ROP_BUFFER_MAX, 5, ROPS_SIZE(3));
+	ck_assert(transaction != NULL);
+	ck_assert_int_eq(transaction->rop_count, 3);
+	ck_assert_int_eq(transaction->replies_max, 3 + 5 + 1);
+	ck_assert(transaction->pool_size >= 2 * EMSMDBP_ROP_BUFFER_MAX);
+	ck_assert(talloc_parent(transaction) == transaction->mem_ctx);
+	for (i = 0; i <= transaction->replies_max; i++) {
+		ck_assert_int_eq(transaction->replies[i].opnum, 0);
+	}
+
+	/* Only the notifications which fit in the reply buffer get a reply */
+	transaction = emsmdbp_transaction_init(mem_ctx, new_request(1), 0x40, 1000, ROPS_SIZE(1));
+	ck_assert_int_eq(transaction->replies_max, 1 + 0x40 / SIZE_DFLT_ROPNOTIFY + 1);
+	ck_assert_int_eq(transaction->pool_size, EMSMDBP_TRANSACTION_POOL_MIN);
+
+	/* Idle requests only carry notifications */
+	mapi_request->length = 2;
+	mapi_request->mapi_len = 2;
+	transaction = emsmdbp_transaction_init(mem_ctx, mapi_request, EMSMDBP_ROP_BUFFER_MAX, 0, 0);
+	ck_assert_int_eq(transaction->rop_count, 0);
+	ck_assert_int_eq(transaction->replies_max, 1);
+
+	/* The pool is bounded */
+	transaction = emsmdbp_transaction_init(mem_ctx, new_request(2000), EMSMDBP_ROP_BUFFER_MAX, 0, ROPS_SIZE(2000));
+	ck_assert_int_eq(transaction->pool_size, EMSMDBP_TRANSACTION_POOL_MAX);
+
+	ck_assert(emsmdbp_transaction_init(NULL, mapi_request, 0, 0, 0) == NULL);
+	ck_assert(emsmdbp_transaction_init(mem_ctx, NULL, 0, 0, 0) == NULL);
+} END_TEST
+
+START_TEST (test_replies) {
+	struct emsmdbp_transaction	*transaction;
+	struct EcDoRpc_MAPI_REPL	*replies;
+	uint32_t			i;
+
+	transaction = emsmdbp_transaction_init(mem_ctx, new_request(4), EMSMDBP_ROP_BUFFER_MAX, 0, ROPS_SIZE(4));
+	replies = transaction->replies;
+	for (i = 0; i < transaction->replies_max; i++) {
+		ck_assert(emsmdbp_transaction_replies(transaction, i + 1) == replies);
+		replies[i].opnum = op_MAPI_GetProps;
+	}
+	emsmdbp_transaction_done(transaction);
+	check_stats(1, 4, 0, 0);
+
+	/* More replies than expected grow the array */
+	replies = emsmdbp_transaction_replies(transaction, 20);
+	ck_assert(replies != NULL);
+	ck_assert_int_eq(transaction->replies_max, 20);
+	for (i = 0; i < 5; i++) {
+		ck_assert_int_eq(replies[i].opnum, op_MAPI_GetProps);
+	}
+	for (i = 5; i <= 20; i++) {
+		ck_assert_int_eq(replies[i].opnum, 0);
+	}
+	emsmdbp_transaction_done(transaction);
+	check_stats(2, 8, 0, 1);
+
+	ck_assert(emsmdbp_transaction_replies(NULL, 1) == NULL);
+	ck_assert_int_eq(emsmdbp_transaction_get_stats(NULL), MAPI_E_INVALID_PARAMETER);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v Performance test ----------------------------------------------------------
+
+/*
+  A 50 ROPs buffer shaped like the ones Outlook sends when it opens a
+  folder: properties of the folder and its messages, then a contents
+  table read. It is replayed with simulated handlers allocating their
+  replies the way the ROP handlers do.
+ */
+static DATA_BLOB build_rop_buffer(void)
+{
+	struct ndr_push			*ndr;
+	struct EcDoRpc_MAPI_REQ		req;
+	enum MAPITAGS			properties[BENCHMARK_PROPS];
+	uint32_t			i;
+
+	for (i = 0; i < BENCHMARK_PROPS; i++) {
+		properties[i] = (i % 2) ? PidTagDisplayName_string8 : PidTagMessageFlags;
+	}
+
+	ndr = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+	ndr_push_uint16(ndr, NDR_SCALARS, 0);
+
+	for (i = 0; i < BENCHMARK_ROPS; i++) {
+		memset(&req, 0, sizeof (struct EcDoRpc_MAPI_REQ));
+		req.handle_idx = 0;
+		if (i % 10 == 8) {
+			req.opnum = op_MAPI_SetColumns;
+			req.u.mapi_SetColumns.prop_count = BENCHMARK_PROPS;
+			req.u.mapi_SetColumns.properties = properties;
+		} else if (i % 10 == 9) {
+			req.opnum = op_MAPI_QueryRows;
+			req.u.mapi_QueryRows.ForwardRead = 1;
+			req.u.mapi_QueryRows.RowCount = BENCHMARK_ROWS;
+		} else {
+			req.opnum = op_MAPI_GetProps;
+			req.u.mapi_GetProps.PropertySizeLimit = 0;
+			req.u.mapi_GetProps.WantUnicode = 0;
+			req.u.mapi_GetProps.prop_count = BENCHMARK_PROPS;
+			req.u.mapi_GetProps.properties = properties;
+		}
+		ck_assert_int_eq(ndr_push_EcDoRpc_MAPI_REQ(ndr, NDR_SCALARS, &req), NDR_ERR_SUCCESS);
+	}
+	SSVAL(ndr->data, 0, ndr->offset);
+	ndr_push_uint32(ndr, NDR_SCALARS, 0x1);
+
+	return ndr_push_blob(ndr);
+}
+
+static struct mapi_request *pull_rop_buffer(TALLOC_CTX *call_ctx, DATA_BLOB *blob)
+{
+	struct ndr_pull		*ndr;
+	struct mapi_request	*mapi_request;
+
+	mapi_request = talloc_zero(call_ctx, struct mapi_request);
+	ndr = ndr_pull_init_blob(blob, mapi_request);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC|LIBNDR_FLAG_REMAINING);
+	ck_assert_int_eq(ndr_pull_mapi_request(ndr, NDR_SCALARS|NDR_BUFFERS, mapi_request), NDR_ERR_SUCCESS);
+
+	return mapi_request;
+}
+
+/* Build the reply of a ROP: a property row per requested row */
+static void replay_rop(TALLOC_CTX *rop_ctx, struct EcDoRpc_MAPI_REQ *req, struct EcDoRpc_MAPI_REPL *repl)
+{
+	struct ndr_push		*ndr;
+	void			**data_pointers;
+	enum MAPISTATUS		*retvals;
+	uint32_t		rows;
+	uint32_t		i, j;
+
+	repl->opnum = req->opnum;
+	repl->handle_idx = req->handle_idx;
+	repl->error_code = MAPI_E_SUCCESS;
+
+	if (req->opnum == op_MAPI_SetColumns) {
+		repl->u.mapi_SetColumns.TableStatus = TBLSTAT_COMPLETE;
+		return;
+	}
+
+	rows = (req->opnum == op_MAPI_QueryRows) ? req->u.mapi_QueryRows.RowCount : 1;
+	ndr = ndr_push_init_ctx(rop_ctx);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+	for (i = 0; i < rows; i++) {
+		data_pointers = talloc_array(rop_ctx, void *, BENCHMARK_PROPS);
+		retvals = talloc_array(rop_ctx, enum MAPISTATUS, BENCHMARK_PROPS);
+		for (j = 0; j < BENCHMARK_PROPS; j++) {
+			retvals[j] = MAPI_E_SUCCESS;
+			if (j % 2) {
+				data_pointers[j] = talloc_asprintf(data_pointers, "Message subject %u", i * BENCHMARK_PROPS + j);
+				ndr_push_string(ndr, NDR_SCALARS, (const char *) data_pointers[j]);
+			} else {
+				data_pointers[j] = talloc_zero(data_pointers, uint32_t);
+				ndr_push_uint32(ndr, NDR_SCALARS, *(uint32_t *) data_pointers[j]);
+			}
+		}
+	}
+
+	if (req->opnum == op_MAPI_QueryRows) {
+		repl->u.mapi_QueryRows.Origin = 0;
+		repl->u.mapi_QueryRows.RowCount = rows;
+		repl->u.mapi_QueryRows.RowData = ndr_push_blob(ndr);
+	} else {
+		repl->u.mapi_GetProps.layout = 0;
+		repl->u.mapi_GetProps.prop_data = ndr_push_blob(ndr);
+	}
+}
+
+/* The reply array grown for each ROP, replies allocated on the call */
+static void replay_realloc(TALLOC_CTX *call_ctx, struct mapi_request *mapi_request)
+{
+	struct mapi_response	*mapi_response;
+	uint32_t		i;
+
+	mapi_response = talloc_zero(call_ctx, struct mapi_response);
+	mapi_response->mapi_repl = talloc_zero(call_ctx, struct EcDoRpc_MAPI_REPL);
+	for (i = 0; mapi_request->mapi_req[i].opnum != 0; i++) {
+		mapi_response->mapi_repl = talloc_realloc(call_ctx, mapi_response->mapi_repl,
+							  struct EcDoRpc_MAPI_REPL, i + 2);
+		replay_rop(call_ctx, &mapi_request->mapi_req[i], &mapi_response->mapi_repl[i]);
+	}
+	mapi_response->mapi_repl[i].opnum = 0;
+}
+
+/* The replies allocated on the transaction memory */
+static void replay_transaction(TALLOC_CTX *call_ctx, struct mapi_request *mapi_request)
+{
+	struct mapi_response		*mapi_response;
+	struct emsmdbp_transaction	*transaction;
+	uint32_t			i;
+
+	mapi_response = talloc_zero(call_ctx, struct mapi_response);
+	transaction = emsmdbp_transaction_init(mapi_response, mapi_request, EMSMDBP_ROP_BUFFER_MAX, 0,
+					       ROPS_SIZE(BENCHMARK_ROPS));
+	ck_assert(transaction != NULL);
+	mapi_response->mapi_repl = transaction->replies;
+	for (i = 0; mapi_request->mapi_req[i].opnum != 0; i++) {
+		mapi_response->mapi_repl = emsmdbp_transaction_replies(transaction, i + 1);
+		replay_rop(transaction->mem_ctx, &mapi_request->mapi_req[i], &mapi_response->mapi_repl[i]);
+	}
+	mapi_response->mapi_repl[i].opnum = 0;
+	emsmdbp_transaction_done(transaction);
+}
+
+START_TEST (test_benchmark_replay) {
+	struct emsmdbp_transaction_stats	stats;
+	struct mapi_request			*mapi_request;
+	TALLOC_CTX				*call_ctx;
+	DATA_BLOB				blob;
+	struct timespec				start;
+	double					realloc_ms, transaction_ms;
+	uint32_t				i;
+
+	blob = build_rop_buffer();
+
+	/* Check the replayed buffer */
+	call_ctx = talloc_new(mem_ctx);
+	mapi_request = pull_rop_buffer(call_ctx, &blob);
+	for (i = 0; mapi_request->mapi_req[i].opnum != 0; i++);
+	ck_assert_int_eq(i, BENCHMARK_ROPS);
+	talloc_free(call_ctx);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_ROUNDS; i++) {
+		call_ctx = talloc_new(mem_ctx);
+		replay_realloc(call_ctx, pull_rop_buffer(call_ctx, &blob));
+		talloc_free(call_ctx);
+	}
+	realloc_ms = testsuite_elapsed_ms(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_ROUNDS; i++) {
+		call_ctx = talloc_new(mem_ctx);
+		replay_transaction(call_ctx, pull_rop_buffer(call_ctx, &blob));
+		talloc_free(call_ctx);
+	}
+	transaction_ms = testsuite_elapsed_ms(&start);
+
+	/* Every transaction fitted in its pool */
+	check_stats(BENCHMARK_ROUNDS, BENCHMARK_ROUNDS * BENCHMARK_ROPS, 0, 0);
+	ck_assert_int_eq(emsmdbp_transaction_get_stats(&stats), MAPI_E_SUCCESS);
+
+	testsuite_benchmark_report("%u ROPs buffer x %u: per-ROP allocations %.1f us, transaction pool %.1f us "
+	                           "(%.0f blocks, %.0f of %.0f bytes per transaction)\n",
+	                           BENCHMARK_ROPS, BENCHMARK_ROUNDS, realloc_ms * 1000.0 / BENCHMARK_ROUNDS,
+	                           transaction_ms * 1000.0 / BENCHMARK_ROUNDS,
+	                           (double) (stats.blocks - g_stats.blocks) / BENCHMARK_ROUNDS,
+	                           (double) (stats.used_bytes - g_stats.used_bytes) / BENCHMARK_ROUNDS,
+	                           (double) (stats.pool_bytes - g_stats.pool_bytes) / BENCHMARK_ROUNDS);
+} END_TEST
+
+// ^ performance tests ---------------------------------------------------------
+
+static void emsmdbp_transaction_setup(void)
+{
+	mem_ctx = talloc_named(NULL, 0, "emsmdbp_transaction_setup");
+	ck_assert_int_eq(emsmdbp_transaction_get_stats(&g_stats), MAPI_E_SUCCESS);
+}
+
+static void emsmdbp_transaction_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_transaction_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+	TCase	*tc_perf;
+
+	s = suite_create("mapiproxy: EMSMDBP transaction memory");
+
+	tc = tcase_create("transaction memory interface");
+	tcase_add_checked_fixture(tc, emsmdbp_transaction_setup, emsmdbp_transaction_teardown);
+	tcase_add_test(tc, test_init_sizing);
+	tcase_add_test(tc, test_replies);
+	suite_add_tcase(s, tc);
+
+	if (testsuite_benchmarks_enabled()) {
+		tc_perf = tcase_create("transaction memory performance");
+		tcase_add_checked_fixture(tc_perf, emsmdbp_transaction_setup, emsmdbp_transaction_teardown);
+		tcase_set_timeout(tc_perf, 600);
+		tcase_add_test(tc_perf, test_benchmark_replay);
+		suite_add_tcase(s, tc_perf);
+	}
+
+	return s;
+}
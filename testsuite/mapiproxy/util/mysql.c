@@ -21,6 +21,7 @@
 
 #include "testsuite.h"
 #include "testsuite_common.h"
+#include <time.h>
 #include "mapiproxy/util/mysql.c"
 
 /* Global test variables */
@@ -30,6 +31,52 @@ static MYSQL		*conn;
 #define MYSQL_REAL_SCHEMA_1	"setup/mapistore/named_properties_schema.sql"
 #define MYSQL_REAL_SCHEMA_2	"setup/openchangedb/openchangedb_schema.sql"
 #define MYSQL_TMP_SCHEMA	"/tmp/fake_schema.sql"
+#define BENCHMARK_ROWS		10000
+#define BENCHMARK_LOOKUPS	20000
+
+
+static const char *test_connection_string(void)
+{
+	return "mysql://"OC_TESTSUITE_MYSQL_USER":"OC_TESTSUITE_MYSQL_PASS
+		"@"OC_TESTSUITE_MYSQL_HOST"/"OC_TESTSUITE_MYSQL_DB;
+}
+
+static void create_stmt_table(void)
+{
+	ck_assert_int_eq(execute_query(conn, "DROP TABLE IF EXISTS stmt_test"), MYSQL_SUCCESS);
+	ck_assert_int_eq(execute_query(conn,
+		"CREATE TABLE stmt_test ("
+		"  id BIGINT UNSIGNED NOT NULL PRIMARY KEY,"
+		"  name VARCHAR(255) NULL,"
+		"  INDEX (name))"), MYSQL_SUCCESS);
+}
+
+static void insert_stmt_row(MYSQL *c, uint64_t id, const char *name)
+{
+	MYSQL_BIND	params[2];
+	uint64_t	affected_rows;
+
+	stmt_bind_uint64(&params[0], &id);
+	stmt_bind_string(&params[1], name);
+	ck_assert_int_eq(execute_stmt(c, "INSERT INTO stmt_test (id, name) VALUES (?, ?)",
+				      params, &affected_rows), MYSQL_SUCCESS);
+	ck_assert_int_eq(affected_rows, 1);
+}
+
+static uint32_t cached_statements(MYSQL *c)
+{
+	struct conn_v		*entry;
+	struct htable_iter	i;
+	void			*stmt;
+	uint32_t		count = 0;
+
+	entry = htable_get(&conns, hash_pointer(c, 0), _conns_cmp, c);
+	ck_assert(entry != NULL);
+	for (stmt = htable_first(&entry->stmts, &i); stmt; stmt = htable_next(&entry->stmts, &i)) {
+		count++;
+	}
+	return count;
+}
 
 // v Unit test ----------------------------------------------------------------
 
@@ -233,18 +280,223 @@ START_TEST (test_create_schema) {
 	ck_assert(schema_created);
 } END_TEST
 
+START_TEST (test_statement_cache) {
+	const char	*sql = "SELECT id FROM stmt_test WHERE name = ?";
+	MYSQL		*unpooled;
+	MYSQL_STMT	*stmt;
+	MYSQL_BIND	params[1];
+	uint64_t	id;
+
+	_connection_close_statements(htable_get(&conns, hash_pointer(conn, 0), _conns_cmp, conn));
+	ck_assert_int_eq(cached_statements(conn), 0);
+	create_stmt_table();
+	insert_stmt_row(conn, 1, "one");
+	insert_stmt_row(conn, 2, "two");
+	ck_assert_int_eq(cached_statements(conn), 1);
+
+	stmt_bind_string(&params[0], "two");
+	ck_assert_int_eq(select_stmt_first_uint(conn, sql, params, &id), MYSQL_SUCCESS);
+	ck_assert_int_eq(id, 2);
+	stmt = _stmt_prepare(conn, sql);
+	ck_assert(stmt != NULL);
+
+	/* Same template, same statement */
+	stmt_bind_string(&params[0], "one");
+	ck_assert_int_eq(select_stmt_first_uint(conn, sql, params, &id), MYSQL_SUCCESS);
+	ck_assert_int_eq(id, 1);
+	ck_assert(_stmt_prepare(conn, sql) == stmt);
+	ck_assert_int_eq(cached_statements(conn), 2);
+
+	/* Invalid statements are not cached */
+	ck_assert_int_eq(execute_stmt(conn, "SELECT * FROM no_such_table", NULL, NULL), MYSQL_ERROR);
+	ck_assert_int_eq(cached_statements(conn), 2);
+
+	/* Only pooled connections have a cache */
+	unpooled = mysql_init(NULL);
+	ck_assert(unpooled != NULL);
+	ck_assert(_stmt_prepare(unpooled, sql) == NULL);
+	mysql_close(unpooled);
+} END_TEST
+
+START_TEST (test_statement_binds) {
+	const char	*sql = "SELECT name, id FROM stmt_test WHERE id = ?";
+	MYSQL_BIND	params[1];
+	MYSQL_BIND	results[2];
+	uint64_t	id, result_id;
+	const char	*name;
+	uint64_t	affected_rows;
+
+	create_stmt_table();
+	insert_stmt_row(conn, 0xFFFFFFFFFFFFFFFFULL, "It's a 'quoted' \\ string");
+	insert_stmt_row(conn, 42, NULL);
+
+	/* Values go through untouched, no escaping needed */
+	id = 0xFFFFFFFFFFFFFFFFULL;
+	stmt_bind_uint64(&params[0], &id);
+	stmt_bind_string_result(&results[0]);
+	stmt_bind_uint64(&results[1], &result_id);
+	ck_assert_int_eq(select_stmt_first_row(mem_ctx, conn, sql, params, results), MYSQL_SUCCESS);
+	ck_assert_str_eq((const char *) results[0].buffer, "It's a 'quoted' \\ string");
+	ck_assert(result_id == 0xFFFFFFFFFFFFFFFFULL);
+
+	/* SQL NULL */
+	id = 42;
+	stmt_bind_string_result(&results[0]);
+	ck_assert_int_eq(select_stmt_first_row(mem_ctx, conn, sql, params, results), MYSQL_SUCCESS);
+	ck_assert(results[0].buffer == NULL);
+	ck_assert_int_eq(result_id, 42);
+
+	/* No rows */
+	id = 7;
+	ck_assert_int_eq(select_stmt_first_string(mem_ctx, conn, "SELECT name FROM stmt_test WHERE id = ?",
+						  params, &name), MYSQL_NOT_FOUND);
+	ck_assert_int_eq(execute_stmt(conn, "UPDATE stmt_test SET name = 'x' WHERE id = ?",
+				      params, &affected_rows), MYSQL_SUCCESS);
+	ck_assert_int_eq(affected_rows, 0);
+
+	id = 42;
+	ck_assert_int_eq(execute_stmt(conn, "UPDATE stmt_test SET name = 'forty two' WHERE id = ?",
+				      params, &affected_rows), MYSQL_SUCCESS);
+	ck_assert_int_eq(affected_rows, 1);
+	ck_assert_int_eq(select_stmt_first_string(mem_ctx, conn, "SELECT name FROM stmt_test WHERE id = ?",
+						  params, &name), MYSQL_SUCCESS);
+	ck_assert_str_eq(name, "forty two");
+} END_TEST
+
+START_TEST (test_connection_pool) {
+	MYSQL		*pooled[MYSQL_POOL_SIZE + 1];
+	MYSQL		*other;
+	uint32_t	i, j;
+
+	/* conn from the fixture is the first one of the pool */
+	pooled[0] = conn;
+	for (i = 1; i < MYSQL_POOL_SIZE; i++) {
+		ck_assert(create_connection(test_connection_string(), &pooled[i]) != NULL);
+		for (j = 0; j < i; j++) {
+			ck_assert(pooled[i] != pooled[j]);
+		}
+	}
+
+	/* The pool is full, connections are shared */
+	ck_assert(create_connection(test_connection_string(), &pooled[i]) != NULL);
+	for (j = 0; j < MYSQL_POOL_SIZE; j++) {
+		if (pooled[j] == pooled[i]) break;
+	}
+	ck_assert_int_lt(j, MYSQL_POOL_SIZE);
+	release_connection(pooled[i]);
+
+	/* Released connections are handed out again */
+	release_connection(pooled[1]);
+	ck_assert(create_connection(test_connection_string(), &other) == pooled[1]);
+
+	for (i = 1; i < MYSQL_POOL_SIZE; i++) {
+		release_connection(pooled[i]);
+	}
+} END_TEST
+
+START_TEST (test_statement_reconnect) {
+	const char	*sql = "SELECT COUNT(*) FROM stmt_test";
+	MYSQL		*other;
+	struct conn_v	*entry;
+	unsigned long	thread_id;
+	uint64_t	count;
+	char		*kill;
+
+	create_stmt_table();
+	insert_stmt_row(conn, 1, "one");
+
+	ck_assert(create_connection(test_connection_string(), &other) != NULL);
+	ck_assert(other != conn);
+	ck_assert_int_eq(select_stmt_first_uint(other, sql, NULL, &count), MYSQL_SUCCESS);
+	ck_assert_int_eq(count, 1);
+	thread_id = mysql_thread_id(other);
+
+	/* Server side statements are lost along with the connection */
+	kill = talloc_asprintf(mem_ctx, "KILL %lu", thread_id);
+	ck_assert_int_eq(execute_query(conn, kill), MYSQL_SUCCESS);
+
+	ck_assert_int_eq(select_stmt_first_uint(other, sql, NULL, &count), MYSQL_SUCCESS);
+	ck_assert_int_eq(count, 1);
+	ck_assert(mysql_thread_id(other) != thread_id);
+
+	/* Idle connections are checked before being handed out again */
+	entry = htable_get(&conns, hash_pointer(other, 0), _conns_cmp, other);
+	ck_assert(entry != NULL);
+	release_connection(other);
+	thread_id = mysql_thread_id(other);
+	kill = talloc_asprintf(mem_ctx, "KILL %lu", thread_id);
+	ck_assert_int_eq(execute_query(conn, kill), MYSQL_SUCCESS);
+	entry->last_used -= MYSQL_POOL_PING_INTERVAL;
+	ck_assert(create_connection(test_connection_string(), &other) != NULL);
+	ck_assert_int_eq(select_stmt_first_uint(other, sql, NULL, &count), MYSQL_SUCCESS);
+	ck_assert_int_eq(count, 1);
+	release_connection(other);
+} END_TEST
+
+// v Performance test ----------------------------------------------------------
+
+START_TEST (test_benchmark_statements) {
+	struct timespec	start;
+	double		text_ms, stmt_ms;
+	MYSQL_BIND	params[2];
+	uint64_t	id, value;
+	char		*name, *sql;
+	uint32_t	i;
+
+	create_stmt_table();
+	ck_assert_int_eq(execute_query(conn, "START TRANSACTION"), MYSQL_SUCCESS);
+	for (i = 0; i < BENCHMARK_ROWS; i++) {
+		insert_stmt_row(conn, i, talloc_asprintf(mem_ctx, "user%u", i));
+	}
+	ck_assert_int_eq(execute_query(conn, "COMMIT"), MYSQL_SUCCESS);
+
+	/* What openchangedb and indexing used to do */
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		id = random() % BENCHMARK_ROWS;
+		name = talloc_asprintf(mem_ctx, "user%"PRIu64, id);
+		sql = talloc_asprintf(mem_ctx,
+			"SELECT id FROM stmt_test WHERE name = '%s' AND id = %"PRIu64,
+			_sql(mem_ctx, name), id);
+		ck_assert_int_eq(select_first_uint(conn, sql, &value), MYSQL_SUCCESS);
+		ck_assert(value == id);
+		talloc_free(sql);
+		talloc_free(name);
+	}
+	text_ms = testsuite_elapsed_ms(&start);
+
+	srandom(1);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCHMARK_LOOKUPS; i++) {
+		id = random() % BENCHMARK_ROWS;
+		name = talloc_asprintf(mem_ctx, "user%"PRIu64, id);
+		stmt_bind_string(&params[0], name);
+		stmt_bind_uint64(&params[1], &id);
+		ck_assert_int_eq(select_stmt_first_uint(conn,
+			"SELECT id FROM stmt_test WHERE name = ? AND id = ?",
+			params, &value), MYSQL_SUCCESS);
+		ck_assert(value == id);
+		talloc_free(name);
+	}
+	stmt_ms = testsuite_elapsed_ms(&start);
+
+	testsuite_benchmark_report("mysql %u lookups on %u rows: text queries %.2fms (%.2fus each), "
+	                           "prepared statements %.2fms (%.2fus each)\n",
+	                           BENCHMARK_LOOKUPS, BENCHMARK_ROWS,
+	                           text_ms, text_ms * 1000.0 / BENCHMARK_LOOKUPS,
+	                           stmt_ms, stmt_ms * 1000.0 / BENCHMARK_LOOKUPS);
+} END_TEST
+
 // ^ unit tests ---------------------------------------------------------------
 
 // v suite definition ---------------------------------------------------------
 
 static void unchecked_mysql_util_setup(void)
 {
-	const char	*connection_string;
 	bool		connection_created;
 
-	connection_string = "mysql://"OC_TESTSUITE_MYSQL_USER":"OC_TESTSUITE_MYSQL_PASS
-			    "@"OC_TESTSUITE_MYSQL_HOST"/"OC_TESTSUITE_MYSQL_DB;
-	connection_created = create_connection(connection_string, &conn);
+	connection_created = create_connection(test_connection_string(), &conn);
 	ck_assert(connection_created);
 }
 
@@ -274,8 +526,21 @@ Suite *mapiproxy_util_mysql_suite(void)
 	tcase_add_test(tc, test_parse_connection_string_fail);
 	tcase_add_test(tc, test_parse_connection_string_success);
 	tcase_add_test(tc, test_create_schema);
+	tcase_add_test(tc, test_statement_cache);
+	tcase_add_test(tc, test_statement_binds);
+	tcase_add_test(tc, test_connection_pool);
+	tcase_add_test(tc, test_statement_reconnect);
 
 	suite_add_tcase(s, tc);
 
+	if (testsuite_benchmarks_enabled()) {
+		TCase *tc_perf = tcase_create("mysql utility functions performance");
+		tcase_add_unchecked_fixture(tc_perf, unchecked_mysql_util_setup, unchecked_mysql_util_teardown);
+		tcase_add_checked_fixture(tc_perf, checked_mysql_util_setup, checked_mysql_util_teardown);
+		tcase_set_timeout(tc_perf, 120);
+		tcase_add_test(tc_perf, test_benchmark_statements);
+		suite_add_tcase(s, tc_perf);
+	}
+
 	return s;
 }
@@ -82,18 +82,37 @@ int main(int argc, const char *argv[])
 
 	/* libmapi */
 	srunner_add_suite(sr, libmapi_property_suite());
+	srunner_add_suite(sr, libmapi_lzxpress_suite());
+	srunner_add_suite(sr, libmapi_idset_suite());
+	srunner_add_suite(sr, libmapi_lzfu_suite());
+	srunner_add_suite(sr, libmapi_proptags_suite());
 	/* libmapiproxy */
 	srunner_add_suite(sr, mapiproxy_openchangedb_mysql_suite());
 	srunner_add_suite(sr, mapiproxy_openchangedb_ldb_suite());
 	srunner_add_suite(sr, mapiproxy_openchangedb_multitenancy_mysql_suite());
+	srunner_add_suite(sr, mapiproxy_mapi_handles_suite());
+	srunner_add_suite(sr, mapiproxy_session_registry_suite());
+	srunner_add_suite(sr, mapiproxy_rop_stats_suite());
+	srunner_add_suite(sr, mapiproxy_shared_pool_suite());
 	/* libmapistore */
 	srunner_add_suite(sr, mapistore_namedprops_suite());
 	srunner_add_suite(sr, mapistore_namedprops_mysql_suite());
 	srunner_add_suite(sr, mapistore_namedprops_tdb_suite());
 	srunner_add_suite(sr, mapistore_indexing_mysql_suite());
 	srunner_add_suite(sr, mapistore_indexing_tdb_suite());
+	srunner_add_suite(sr, mapistore_property_stream_suite());
+	srunner_add_suite(sr, mapistore_contexts_suite());
+	srunner_add_suite(sr, mapistore_notification_suite());
+	/* libmapiserver */
+	srunner_add_suite(sr, libmapiserver_queryrows_suite());
 	/* mapiproxy */
 	srunner_add_suite(sr, mapiproxy_util_mysql_suite());
+	srunner_add_suite(sr, mapiproxy_emsabp_gal_suite());
+	srunner_add_suite(sr, mapiproxy_emsabp_tdb_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_syncstream_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_async_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_transaction_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_rop_suite());
 
 	srunner_run_all(sr, CK_NORMAL);
 	nf = srunner_ntests_failed(sr);
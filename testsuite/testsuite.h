@@ -45,18 +45,37 @@ __BEGIN_DECLS
 
 /* libmapi */
 Suite *libmapi_property_suite(void);
+Suite *libmapi_lzxpress_suite(void);
+Suite *libmapi_idset_suite(void);
+Suite *libmapi_lzfu_suite(void);
+Suite *libmapi_proptags_suite(void);
 /* libmapiproxy */
 Suite *mapiproxy_openchangedb_mysql_suite(void);
 Suite *mapiproxy_openchangedb_ldb_suite(void);
 Suite *mapiproxy_openchangedb_multitenancy_mysql_suite(void);
+Suite *mapiproxy_mapi_handles_suite(void);
+Suite *mapiproxy_session_registry_suite(void);
+Suite *mapiproxy_rop_stats_suite(void);
+Suite *mapiproxy_shared_pool_suite(void);
 /* libmapistore */
 Suite *mapistore_namedprops_suite(void);
 Suite *mapistore_namedprops_mysql_suite(void);
 Suite *mapistore_namedprops_tdb_suite(void);
 Suite *mapistore_indexing_mysql_suite(void);
 Suite *mapistore_indexing_tdb_suite(void);
+Suite *mapistore_property_stream_suite(void);
+Suite *mapistore_contexts_suite(void);
+Suite *mapistore_notification_suite(void);
+/* libmapiserver */
+Suite *libmapiserver_queryrows_suite(void);
 /* mapiproxy */
 Suite *mapiproxy_util_mysql_suite(void);
+Suite *mapiproxy_emsabp_gal_suite(void);
+Suite *mapiproxy_emsabp_tdb_suite(void);
+Suite *mapiproxy_emsmdbp_syncstream_suite(void);
+Suite *mapiproxy_emsmdbp_async_suite(void);
+Suite *mapiproxy_emsmdbp_transaction_suite(void);
+Suite *mapiproxy_emsmdbp_rop_suite(void);
 
 __END_DECLS
 
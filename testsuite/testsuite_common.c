@@ -18,6 +18,7 @@
  */
 #include "testsuite_common.h"
 #include "mapiproxy/libmapiproxy/backends/openchangedb_mysql.h"
+#include <stdarg.h>
 #include <string.h>
 #include <check.h>
 #include <param.h>
@@ -99,3 +100,28 @@ void drop_mysql_database(MYSQL *conn, const char *database)
 	talloc_free(sql);
 	close_all_connections();
 }
+
+double testsuite_elapsed_ms(struct timespec *start)
+{
+	struct timespec	end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1000.0 + (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+bool testsuite_benchmarks_enabled(void)
+{
+	const char	*value = getenv(OC_TESTSUITE_BENCHMARK_ENV);
+
+	return value && *value && strcmp(value, "0");
+}
+
+/* Benchmark results go to stderr, they are only produced on demand */
+void testsuite_benchmark_report(const char *format, ...)
+{
+	va_list	ap;
+
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+}
@@ -21,6 +21,7 @@
 
 #include "mapiproxy/libmapiproxy/backends/openchangedb_backends.h"
 #include "mapiproxy/util/mysql.h"
+#include <time.h>
 
 /* MySQL constants to establish a connection */
 #define	OC_TESTSUITE_MYSQL_HOST		"127.0.0.1"
@@ -34,8 +35,15 @@
 /* According to the initial sample data (resources dir) */
 #define NEXT_CHANGE_NUMBER		402
 
+/* Benchmark test cases only run when this environment variable is set */
+#define	OC_TESTSUITE_BENCHMARK_ENV	"OC_TESTSUITE_BENCHMARK"
+
 
 void initialize_mysql_with_file(TALLOC_CTX *, const char *, struct openchangedb_context **);
 void drop_mysql_database(MYSQL *, const char *);
 
+double testsuite_elapsed_ms(struct timespec *);
+bool testsuite_benchmarks_enabled(void);
+void testsuite_benchmark_report(const char *, ...);
+
 #endif /* __TESTSUITE_COMMON_H__ */
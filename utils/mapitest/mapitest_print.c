@@ -94,6 +94,31 @@ _PUBLIC_ void mapitest_print(struct mapitest *mt, const char *format, ...)
 	free(s);
 }
 
+/**
+   \details Print a benchmark figure in the stream
+
+   Unlike mapitest_print, figures are also written when the output is
+   in subunit format: subunit passes non-protocol lines through, so
+   benchmark numbers remain visible in test runs.
+
+   \param mt pointer to the top-level mapitest structure
+   \param format the format string
+   \param ... the format string parameters
+ */
+_PUBLIC_ void mapitest_print_benchmark(struct mapitest *mt, const char *format, ...)
+{
+	va_list		ap;
+
+	if (!mt->subunit_output) {
+		mapitest_print_tab(mt);
+	}
+
+	va_start(ap, format);
+	vfprintf(mt->stream, format, ap);
+	va_end(ap);
+	fflush(mt->stream);
+}
+
 /**
    \details Print newline characters
 
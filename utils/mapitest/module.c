@@ -42,6 +42,7 @@ _PUBLIC_ uint32_t mapitest_register_modules(struct mapitest *mt)
 	ret += module_lcid_init(mt);
 	ret += module_mapidump_init(mt);
 	ret += module_lzxpress_init(mt);
+	ret += module_oxcrops_init(mt);
 	ret += module_zentyal_init(mt);
 
 	return ret;
@@ -187,6 +188,7 @@ _PUBLIC_ uint32_t module_oxctable_init(struct mapitest *mt)
 	mapitest_suite_add_test(suite, "SETCOLUMNS", "Set Table Columns", mapitest_oxctable_SetColumns);
 	mapitest_suite_add_test(suite, "QUERYCOLUMNS", "Query Table Columns", mapitest_oxctable_QueryColumns);
 	mapitest_suite_add_test(suite, "QUERYROWS", "Query Table Rows", mapitest_oxctable_QueryRows);
+	mapitest_suite_add_test(suite, "QUERYROWS-BENCHMARK", "Measure QueryRows latency over the Inbox contents table", mapitest_oxctable_QueryRows_benchmark);
 	mapitest_suite_add_test_flagged(suite, "GETSTATUS", "Get Table Status", mapitest_oxctable_GetStatus, NotInExchange2010);
 	mapitest_suite_add_test(suite, "SEEKROW", "Seek a row", mapitest_oxctable_SeekRow);
 	mapitest_suite_add_test(suite, "RESTRICT", "Apply filters to a table", mapitest_oxctable_Restrict);
@@ -508,6 +510,29 @@ _PUBLIC_ uint32_t module_lzxpress_init(struct mapitest *mt)
 	suite = mapitest_suite_init(mt, "LZXPRESS", "lzxpress algorithm test suite", false);
 
 	mapitest_suite_add_test_flagged(suite, "VALIDATE-001", "Validate LZXPRESS implementation using sample file 001", mapitest_lzxpress_validate_test_001, ExpectedFail);
+	mapitest_suite_add_test(suite, "BENCHMARK", "Measure LZXPRESS throughput and ratio over the sample corpus", mapitest_lzxpress_benchmark);
+
+	mapitest_suite_register(mt, suite);
+
+	return MAPITEST_SUCCESS;
+}
+
+
+/**
+   \details Register the ROP batching test suite
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return MAPITEST_SUCCESS on success, otherwise MAPITEST_ERROR
+ */
+_PUBLIC_ uint32_t module_oxcrops_init(struct mapitest *mt)
+{
+	struct mapitest_suite	*suite = NULL;
+
+	suite = mapitest_suite_init(mt, "OXCROPS", "ROP buffer batching", true);
+
+	mapitest_suite_add_test(suite, "BATCH", "Open a folder, its tables and rows in a single request", mapitest_oxcrops_Batch);
+	mapitest_suite_add_test(suite, "BATCH-BENCHMARK", "Measure RPC count and time of a folder scan with and without batching", mapitest_oxcrops_Batch_benchmark);
 
 	mapitest_suite_register(mt, suite);
 
@@ -24,6 +24,8 @@
 #include "gen_ndr/ndr_exchange.h"
 #include "libmapi/libmapi_private.h"
 
+#include <sys/time.h>
+
 /**
    \file module_lzxpress.c
 
@@ -149,3 +151,86 @@ _PUBLIC_ bool mapitest_lzxpress_validate_test_001(struct mapitest *mt)
 
 	return ret;
 }
+
+
+/**
+   \details Benchmark the LZXPRESS implementation over the sample corpus
+
+   This function:
+   -# Loads each file of the corpus
+   -# Compresses and decompresses it repeatedly
+   -# Checks the round trip and reports throughput and ratio
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool mapitest_lzxpress_benchmark(struct mapitest *mt)
+{
+	const char	*corpus[] = {
+		LZXPRESS_DATADIR "/001_Outlook_2007_in_ModifyRecipients_comp.dat",
+		LZXPRESS_DATADIR "/002_Outlook_2007_in_Tables_operations_comp.dat",
+		LZFU_DATADIR "/testcase.rtf",
+		NULL
+	};
+	const uint32_t	iterations = 1000;
+	uint8_t		*data;
+	uint8_t		*comp;
+	uint8_t		*plain;
+	size_t		size;
+	uint32_t	comp_size;
+	ssize_t		ret = 0;
+	ssize_t		ret2 = 0;
+	struct timeval	tv_start;
+	struct timeval	tv_comp;
+	struct timeval	tv_end;
+	double		comp_time;
+	double		uncomp_time;
+	double		mbytes;
+	uint32_t	i;
+	uint32_t	j;
+
+	for (i = 0; corpus[i]; i++) {
+		data = (uint8_t *)file_load(corpus[i], &size, 0, mt->mem_ctx);
+		if (!data) {
+			mapitest_print_retval_fmt(mt, "lzxpress_benchmark", "Error while loading %s", corpus[i]);
+			return false;
+		}
+
+		comp_size = size + ((size / 32) + 2) * 4;
+		comp = talloc_array(mt->mem_ctx, uint8_t, comp_size);
+		plain = talloc_array(mt->mem_ctx, uint8_t, size);
+
+		gettimeofday(&tv_start, NULL);
+		for (j = 0; j < iterations; j++) {
+			ret = compress_lzxpress(data, size, comp, comp_size);
+		}
+		gettimeofday(&tv_comp, NULL);
+		for (j = 0; j < iterations && ret > 0; j++) {
+			ret2 = uncompress_lzxpress(comp, ret, plain, size);
+		}
+		gettimeofday(&tv_end, NULL);
+
+		if (ret <= 0 || ret2 != size || memcmp(data, plain, size)) {
+			mapitest_print_retval_fmt(mt, "lzxpress_benchmark", "Round trip failed on %s", corpus[i]);
+			talloc_free(data);
+			talloc_free(comp);
+			talloc_free(plain);
+			return false;
+		}
+
+		comp_time = (tv_comp.tv_sec - tv_start.tv_sec) + (tv_comp.tv_usec - tv_start.tv_usec) / 1000000.0;
+		uncomp_time = (tv_end.tv_sec - tv_comp.tv_sec) + (tv_end.tv_usec - tv_comp.tv_usec) / 1000000.0;
+		mbytes = ((double)size * iterations) / (1024 * 1024);
+
+		mapitest_print(mt, "* %-50s: %6zu -> %6zd bytes (ratio %.2f), compress %.1f MB/s, decompress %.1f MB/s\n",
+			       strrchr(corpus[i], '/') + 1, size, ret, (double)ret / size,
+			       comp_time ? mbytes / comp_time : 0, uncomp_time ? mbytes / uncomp_time : 0);
+
+		talloc_free(data);
+		talloc_free(comp);
+		talloc_free(plain);
+	}
+
+	return true;
+}
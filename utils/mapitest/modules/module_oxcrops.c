@@ -0,0 +1,297 @@
+/*
+   Stand-alone MAPI testsuite
+
+   OpenChange Project - ROP BUFFER BATCHING
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/mapitest/mapitest.h"
+#include "utils/mapitest/proto.h"
+
+#include <sys/time.h>
+
+/**
+   \file module_oxcrops.c
+
+   \brief ROP buffer batching test suite
+*/
+
+#define	MT_BATCH_MESSAGES	10
+
+
+static uint32_t mapitest_oxcrops_rpc_count(struct mapitest *mt)
+{
+	return ((struct emsmdb_context *)mt->session->emsmdb->ctx)->transaction_count;
+}
+
+
+static double mapitest_oxcrops_elapsed(struct timeval *tv_start)
+{
+	struct timeval	tv_end;
+
+	gettimeofday(&tv_end, NULL);
+	return (tv_end.tv_sec - tv_start->tv_sec) * 1000.0 + (tv_end.tv_usec - tv_start->tv_usec) / 1000.0;
+}
+
+
+/**
+   \details Read the test folder message identifiers and subjects
+
+   Without batching, this is a GetContentsTable, SetColumns, QueryRows
+   and Release round trip each. With batching, they go in a single
+   request.
+ */
+static bool mapitest_oxcrops_list(struct mapitest *mt, bool batch,
+				  struct SRowSet *SRowSet)
+{
+	enum MAPISTATUS		retval;
+	struct mt_common_tf_ctx	*context = mt->priv;
+	mapi_object_t		obj_ctable;
+	struct SPropTagArray	*SPropTagArray;
+	uint32_t		count = 0;
+
+	SPropTagArray = set_SPropTagArray(mt->mem_ctx, 0x2, PR_MID, PR_SUBJECT);
+	mapi_object_init(&obj_ctable);
+
+	if (batch) {
+		mapi_batch_begin(mt->session);
+		mapi_batch_GetContentsTable(&(context->obj_test_folder), &obj_ctable, 0, &count);
+		mapi_batch_SetColumns(&obj_ctable, SPropTagArray);
+		mapi_batch_QueryRows(&obj_ctable, MT_BATCH_MESSAGES, TBL_ADVANCE, SRowSet);
+		mapi_batch_Release(&obj_ctable);
+		retval = mapi_batch_end(mt->session);
+	} else {
+		retval = GetContentsTable(&(context->obj_test_folder), &obj_ctable, 0, &count);
+		if (retval == MAPI_E_SUCCESS) {
+			retval = SetColumns(&obj_ctable, SPropTagArray);
+		}
+		if (retval == MAPI_E_SUCCESS) {
+			retval = QueryRows(&obj_ctable, MT_BATCH_MESSAGES, TBL_ADVANCE, SRowSet);
+		}
+		mapi_object_release(&obj_ctable);
+	}
+	MAPIFreeBuffer(SPropTagArray);
+
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval(mt, batch ? "mapi_batch_end" : "QueryRows");
+		return false;
+	}
+	if (count != MT_BATCH_MESSAGES || SRowSet->cRows != MT_BATCH_MESSAGES) {
+		mapitest_print(mt, "* %-35s: unexpected count (%u rows of %u)\n",
+			       "GetContentsTable", SRowSet->cRows, count);
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+   \details Open each listed message, read its subject and get its
+   attachment table
+
+   Without batching, this costs five round trips per message.
+ */
+static bool mapitest_oxcrops_scan(struct mapitest *mt, bool batch,
+				  struct SRowSet *SRowSet)
+{
+	enum MAPISTATUS		retval = MAPI_E_SUCCESS;
+	struct mt_common_tf_ctx	*context = mt->priv;
+	mapi_object_t		obj_message[MT_BATCH_MESSAGES];
+	mapi_object_t		obj_atable[MT_BATCH_MESSAGES];
+	struct SPropTagArray	*SPropTagArray;
+	struct SPropValue	*lpProps[MT_BATCH_MESSAGES];
+	uint32_t		cValues[MT_BATCH_MESSAGES];
+	const uint64_t		*mid;
+	const char		*subject;
+	const char		*expected;
+	mapi_id_t		id_folder;
+	uint32_t		i;
+	bool			ret = true;
+
+	SPropTagArray = set_SPropTagArray(mt->mem_ctx, 0x1, PR_SUBJECT);
+	id_folder = mapi_object_get_id(&(context->obj_test_folder));
+
+	if (batch) {
+		mapi_batch_begin(mt->session);
+	}
+
+	for (i = 0; i < SRowSet->cRows && retval == MAPI_E_SUCCESS; i++) {
+		mapi_object_init(&obj_message[i]);
+		mapi_object_init(&obj_atable[i]);
+		lpProps[i] = NULL;
+		mid = (const uint64_t *)find_SPropValue_data(&(SRowSet->aRow[i]), PR_MID);
+		if (batch) {
+			mapi_batch_OpenMessage(&(context->obj_store), id_folder, *mid, &obj_message[i], 0x0);
+			mapi_batch_GetProps(&obj_message[i], 0, SPropTagArray, &lpProps[i], &cValues[i]);
+			mapi_batch_GetAttachmentTable(&obj_message[i], &obj_atable[i]);
+			mapi_batch_Release(&obj_atable[i]);
+			mapi_batch_Release(&obj_message[i]);
+		} else {
+			retval = OpenMessage(&(context->obj_store), id_folder, *mid, &obj_message[i], 0x0);
+			if (retval == MAPI_E_SUCCESS) {
+				retval = GetProps(&obj_message[i], 0, SPropTagArray, &lpProps[i], &cValues[i]);
+			}
+			if (retval == MAPI_E_SUCCESS) {
+				retval = GetAttachmentTable(&obj_message[i], &obj_atable[i]);
+			}
+			mapi_object_release(&obj_atable[i]);
+			mapi_object_release(&obj_message[i]);
+		}
+	}
+
+	if (batch) {
+		retval = mapi_batch_end(mt->session);
+	}
+	MAPIFreeBuffer(SPropTagArray);
+
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval(mt, batch ? "mapi_batch_end" : "OpenMessage");
+		return false;
+	}
+
+	/* Replies must be matched with the right message */
+	for (i = 0; i < SRowSet->cRows; i++) {
+		subject = (const char *)get_SPropValue(lpProps[i], PR_SUBJECT);
+		expected = (const char *)find_SPropValue_data(&(SRowSet->aRow[i]), PR_SUBJECT);
+		if (!subject || !expected || strcmp(subject, expected)) {
+			mapitest_print(mt, "* %-35s: subject mismatch on message %u\n", "GetProps", i);
+			ret = false;
+		}
+		MAPIFreeBuffer(lpProps[i]);
+	}
+
+	return ret;
+}
+
+
+/**
+   \details Test chaining operations in a batch
+
+   This function:
+   -# Creates the test folder
+   -# Gets its contents table, sets the columns, reads the rows and
+      releases the table in one request
+   -# Opens every message, reads its subject, gets and releases its
+      attachment table in one request
+   -# Checks the subjects match the table rows
+   -# Cleans up
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool mapitest_oxcrops_Batch(struct mapitest *mt)
+{
+	mapi_object_t		obj_htable;
+	struct SRowSet		SRowSet;
+	uint32_t		calls;
+	bool			ret = false;
+
+	/* Step 1. Logon and create the test folder */
+	if (! mapitest_common_setup(mt, &obj_htable, NULL)) {
+		return false;
+	}
+	SRowSet.cRows = 0;
+	SRowSet.aRow = NULL;
+
+	/* Step 2. List the folder */
+	calls = mapitest_oxcrops_rpc_count(mt);
+	if (!mapitest_oxcrops_list(mt, true, &SRowSet)) {
+		goto cleanup;
+	}
+	calls = mapitest_oxcrops_rpc_count(mt) - calls;
+	mapitest_print(mt, "* %-35s: %u RPC\n", "List", calls);
+	if (calls != 1) {
+		goto cleanup;
+	}
+
+	/* Step 3. Read the messages */
+	calls = mapitest_oxcrops_rpc_count(mt);
+	if (!mapitest_oxcrops_scan(mt, true, &SRowSet)) {
+		goto cleanup;
+	}
+	calls = mapitest_oxcrops_rpc_count(mt) - calls;
+	mapitest_print(mt, "* %-35s: %u RPC\n", "Scan", calls);
+	ret = (calls == 1);
+
+cleanup:
+	/* Step 4. Release */
+	MAPIFreeBuffer(SRowSet.aRow);
+	mapi_object_release(&obj_htable);
+	mapitest_common_cleanup(mt);
+
+	return ret;
+}
+
+
+/**
+   \details Compare a folder scan with and without batching
+
+   This function:
+   -# Creates the test folder
+   -# Lists the folder and reads every message one operation at a time
+   -# Does the same with batching
+   -# Reports the number of RPC and the time taken by each
+   -# Cleans up
+
+   The gap grows with the latency of the link to the server.
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool mapitest_oxcrops_Batch_benchmark(struct mapitest *mt)
+{
+	mapi_object_t		obj_htable;
+	struct SRowSet		SRowSet;
+	struct timeval		tv_start;
+	uint32_t		calls[2];
+	double			elapsed[2];
+	int			batch;
+	bool			ret = true;
+
+	/* Step 1. Logon and create the test folder */
+	if (! mapitest_common_setup(mt, &obj_htable, NULL)) {
+		return false;
+	}
+
+	/* Step 2. Scan the folder, first without then with batching */
+	for (batch = 0; batch < 2 && ret; batch++) {
+		calls[batch] = mapitest_oxcrops_rpc_count(mt);
+		gettimeofday(&tv_start, NULL);
+		ret = mapitest_oxcrops_list(mt, batch, &SRowSet);
+		if (ret) {
+			ret = mapitest_oxcrops_scan(mt, batch, &SRowSet);
+			MAPIFreeBuffer(SRowSet.aRow);
+		}
+		elapsed[batch] = mapitest_oxcrops_elapsed(&tv_start);
+		calls[batch] = mapitest_oxcrops_rpc_count(mt) - calls[batch];
+	}
+
+	/* Step 3. Report */
+	if (ret) {
+		mapitest_print(mt, "* %-35s: %u RPC, %.2fms\n", "Folder scan", calls[0], elapsed[0]);
+		mapitest_print(mt, "* %-35s: %u RPC, %.2fms\n", "Batched folder scan", calls[1], elapsed[1]);
+	}
+
+	/* Step 4. Release */
+	mapi_object_release(&obj_htable);
+	mapitest_common_cleanup(mt);
+
+	return ret;
+}
@@ -23,6 +23,8 @@
 #include "utils/mapitest/mapitest.h"
 #include "utils/mapitest/proto.h"
 
+#include <sys/time.h>
+
 /**
    \file module_oxctable.c
 
@@ -380,6 +382,127 @@ _PUBLIC_ bool mapitest_oxctable_QueryRows(struct mapitest *mt)
 	return true;
 }
 
+/**
+   \details Measure QueryRows latency on a large contents table
+
+   This function:
+   -# Opens the Inbox contents table
+   -# Sets the columns of a typical message list view
+   -# Reads the whole table with QueryRows, 200 rows at a time
+   -# Reports the minimum, average and maximum time per call
+
+   The Inbox should hold a significant number of messages (e.g. 50k)
+   for the figures to be meaningful.
+
+   \param mt pointer to the top-level mapitest structure
+
+   \return true on success, otherwise false
+ */
+_PUBLIC_ bool mapitest_oxctable_QueryRows_benchmark(struct mapitest *mt)
+{
+	enum MAPISTATUS		retval;
+	mapi_object_t		obj_store;
+	mapi_object_t		obj_folder;
+	mapi_object_t		obj_table;
+	mapi_id_t		id_inbox;
+	struct SPropTagArray	*SPropTagArray;
+	struct SRowSet		SRowSet;
+	struct timeval		tv_start;
+	struct timeval		tv_end;
+	uint32_t		count = 0;
+	uint32_t		rows = 0;
+	uint32_t		calls = 0;
+	double			elapsed;
+	double			total = 0;
+	double			min = 0;
+	double			max = 0;
+	bool			ret = true;
+
+	/* Step 1. Open the Inbox contents table */
+	mapi_object_init(&obj_store);
+	retval = OpenMsgStore(mt->session, &obj_store);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval(mt, "OpenMsgStore");
+		return false;
+	}
+
+	retval = GetDefaultFolder(&obj_store, &id_inbox, olFolderInbox);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval(mt, "GetDefaultFolder");
+		mapi_object_release(&obj_store);
+		return false;
+	}
+
+	mapi_object_init(&obj_folder);
+	mapi_object_init(&obj_table);
+	retval = OpenFolder(&obj_store, id_inbox, &obj_folder);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval(mt, "OpenFolder");
+		ret = false;
+		goto cleanup;
+	}
+
+	retval = GetContentsTable(&obj_folder, &obj_table, 0, &count);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval(mt, "GetContentsTable");
+		ret = false;
+		goto cleanup;
+	}
+
+	/* Step 2. Set Table Columns */
+	SPropTagArray = set_SPropTagArray(mt->mem_ctx, 0x5,
+					  PR_FID,
+					  PR_MID,
+					  PR_SUBJECT_UNICODE,
+					  PR_MESSAGE_DELIVERY_TIME,
+					  PR_MESSAGE_FLAGS);
+	retval = SetColumns(&obj_table, SPropTagArray);
+	MAPIFreeBuffer(SPropTagArray);
+	if (retval != MAPI_E_SUCCESS) {
+		mapitest_print_retval(mt, "SetColumns");
+		ret = false;
+		goto cleanup;
+	}
+
+	/* Step 3. Read the whole table */
+	do {
+		gettimeofday(&tv_start, NULL);
+		retval = QueryRows(&obj_table, 200, TBL_ADVANCE, &SRowSet);
+		gettimeofday(&tv_end, NULL);
+		if (retval != MAPI_E_SUCCESS) {
+			mapitest_print_retval(mt, "QueryRows");
+			ret = false;
+			goto cleanup;
+		}
+
+		elapsed = (tv_end.tv_sec - tv_start.tv_sec) * 1000.0 + (tv_end.tv_usec - tv_start.tv_usec) / 1000.0;
+		if (!calls || elapsed < min) min = elapsed;
+		if (elapsed > max) max = elapsed;
+		total += elapsed;
+		calls++;
+		rows += SRowSet.cRows;
+	} while (SRowSet.cRows > 0);
+
+	/* Step 4. Report */
+	mapitest_print_benchmark(mt, "* %-35s: %u/%u rows in %u calls, %.2fms total\n",
+				 "QueryRows", rows, count, calls, total);
+	mapitest_print_benchmark(mt, "* %-35s: min %.2fms, avg %.2fms, max %.2fms\n",
+				 "QueryRows latency", min, total / calls, max);
+
+	if (rows != count) {
+		mapitest_print(mt, "* %-35s: unexpected row count\n", "QueryRows");
+		ret = false;
+	}
+
+cleanup:
+	mapi_object_release(&obj_table);
+	mapi_object_release(&obj_folder);
+	mapi_object_release(&obj_store);
+
+	return ret;
+}
+
+
 /**
    \details Test the GetStatus (0x16) operation
 
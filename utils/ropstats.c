@@ -0,0 +1,171 @@
+/*
+   Display per-ROP statistics recorded by the OpenChange server
+
+   OpenChange Project
+
+   Copyright (C) agent 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libmapi/libmapi.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include <popt.h>
+#include "openchange-tools.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+struct ropstats_row {
+	uint8_t				opnum;
+	struct mpm_rop_stats_entry	entry;
+};
+
+static bool	opt_sort_calls = false;
+
+static int ropstats_cmp(const void *a, const void *b)
+{
+	const struct ropstats_row	*left = (const struct ropstats_row *) a;
+	const struct ropstats_row	*right = (const struct ropstats_row *) b;
+	uint64_t			lvalue;
+	uint64_t			rvalue;
+
+	lvalue = opt_sort_calls ? left->entry.calls : left->entry.usec_total;
+	rvalue = opt_sort_calls ? right->entry.calls : right->entry.usec_total;
+
+	if (lvalue == rvalue) {
+		return left->opnum - right->opnum;
+	}
+	return (lvalue < rvalue) ? 1 : -1;
+}
+
+static void ropstats_print(struct mpm_rop_stats *stats, bool all)
+{
+	struct ropstats_row	rows[MPM_ROP_STATS_OPNUMS];
+	struct ropstats_row	*row;
+	uint64_t		total_usec = 0;
+	uint64_t		total_calls = 0;
+	time_t			reset_time;
+	uint32_t		count = 0;
+	uint32_t		i;
+
+	for (i = 0; i < MPM_ROP_STATS_OPNUMS; i++) {
+		row = &rows[count];
+		row->opnum = i;
+		mpm_rop_stats_get(stats, i, &row->entry);
+		if (!row->entry.calls && !all) continue;
+		total_usec += row->entry.usec_total;
+		total_calls += row->entry.calls;
+		count++;
+	}
+
+	qsort(rows, count, sizeof (struct ropstats_row), ropstats_cmp);
+
+	reset_time = mpm_rop_stats_reset_time(stats);
+	printf("ROP statistics since %s", ctime(&reset_time));
+	printf("%llu ROPs, %.3f seconds\n\n", (unsigned long long) total_calls, total_usec / 1000000.0);
+
+	printf("%-6s %10s %8s %10s %6s %8s %8s %8s %8s %10s %12s %12s\n",
+	       "ROP", "calls", "errors", "time(ms)", "%time", "avg(us)", "p50(us)",
+	       "p90(us)", "p99(us)", "max(us)", "bytes in", "bytes out");
+
+	for (i = 0; i < count; i++) {
+		row = &rows[i];
+		printf("0x%.2x   %10llu %8llu %10.1f %5.1f%% %8llu %8llu %8llu %8llu %10llu %12llu %12llu\n",
+		       row->opnum,
+		       (unsigned long long) row->entry.calls,
+		       (unsigned long long) row->entry.errors,
+		       row->entry.usec_total / 1000.0,
+		       total_usec ? (row->entry.usec_total * 100.0 / total_usec) : 0.0,
+		       (unsigned long long) (row->entry.calls ? row->entry.usec_total / row->entry.calls : 0),
+		       (unsigned long long) mpm_rop_stats_percentile(&row->entry, 50),
+		       (unsigned long long) mpm_rop_stats_percentile(&row->entry, 90),
+		       (unsigned long long) mpm_rop_stats_percentile(&row->entry, 99),
+		       (unsigned long long) row->entry.usec_max,
+		       (unsigned long long) row->entry.bytes_in,
+		       (unsigned long long) row->entry.bytes_out);
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	struct mpm_rop_stats	*stats;
+	poptContext		pc;
+	int			opt;
+	const char		*opt_file = NULL;
+	bool			opt_reset = false;
+	bool			opt_all = false;
+	int			retcode = EXIT_SUCCESS;
+
+	enum { OPT_FILE=1000, OPT_RESET, OPT_ALL, OPT_SORT_CALLS };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{"file", 'f', POPT_ARG_STRING, NULL, OPT_FILE, "set the ROP statistics file path (dcerpc_mapiproxy:rop_stats)", "PATH"},
+		{"reset", 0, POPT_ARG_NONE, NULL, OPT_RESET, "reset counters after displaying them", NULL},
+		{"all", 'a', POPT_ARG_NONE, NULL, OPT_ALL, "also display ROPs which were never called", NULL},
+		{"sort-calls", 'c', POPT_ARG_NONE, NULL, OPT_SORT_CALLS, "sort by number of calls instead of total time", NULL},
+		POPT_OPENCHANGE_VERSION
+		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
+	};
+
+	mem_ctx = talloc_named(NULL, 0, "ropstats");
+
+	pc = poptGetContext("ropstats", argc, argv, long_options, 0);
+
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_FILE:
+			opt_file = poptGetOptArg(pc);
+			break;
+		case OPT_RESET:
+			opt_reset = true;
+			break;
+		case OPT_ALL:
+			opt_all = true;
+			break;
+		case OPT_SORT_CALLS:
+			opt_sort_calls = true;
+			break;
+		}
+	}
+
+	if (!opt_file) {
+		printf("file argument missing\n");
+		poptPrintUsage(pc, stderr, 0);
+		retcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	stats = mpm_rop_stats_init(mem_ctx, opt_file, opt_reset);
+	if (!stats) {
+		fprintf(stderr, "Unable to open ROP statistics file %s\n", opt_file);
+		retcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	ropstats_print(stats, opt_all);
+
+	if (opt_reset && mpm_rop_stats_reset(stats) != MAPI_E_SUCCESS) {
+		fprintf(stderr, "Unable to reset ROP statistics\n");
+		retcode = EXIT_FAILURE;
+	}
+
+cleanup:
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return retcode;
+}